@@ -896,3 +896,133 @@ std::set<std::string>* AssetTracker::getStorageAssetTrackingCacheData(StorageAss
 		return &(it->second);
 	}
 }
+
+/**
+ * Construct an empty cache of asset shapes
+ */
+AssetShapeCache::AssetShapeCache() : m_lastAsset(NULL), m_lastShapes(NULL)
+{
+}
+
+/**
+ * Check if the shape of a reading has been seen before for the asset of
+ * the reading, adding the shape to the cache if it has not.
+ *
+ * @param reading	The reading to check
+ * @return bool		True if this is a new shape for the asset
+ */
+bool AssetShapeCache::isNewShape(const Reading *reading)
+{
+	Shapes *shapes = find(reading->getAssetName());
+	const vector<Datapoint *>& datapoints = reading->getReadingData();
+	uint64_t hash = shapeHash(datapoints);
+
+	// The most recent shape is held at the end as it is the most likely match
+	for (auto it = shapes->rbegin(); it != shapes->rend(); ++it)
+	{
+		if (it->matches(hash, datapoints))
+		{
+			return false;
+		}
+	}
+	shapes->emplace_back(hash, datapoints);
+	return true;
+}
+
+/**
+ * Empty the cache, the next reading of each asset will be reported as a
+ * new shape.
+ */
+void AssetShapeCache::clear()
+{
+	m_assets.clear();
+	m_lastAsset = NULL;
+	m_lastShapes = NULL;
+}
+
+/**
+ * Return the shapes seen for an asset, creating an empty entry if the
+ * asset has not been seen. Consecutive readings are usually of the same
+ * asset so the last asset is checked before the map lookup.
+ *
+ * @param asset		The asset name
+ * @return Shapes*	The shapes of the asset
+ */
+AssetShapeCache::Shapes *AssetShapeCache::find(const string& asset)
+{
+	if (m_lastAsset && m_lastAsset->compare(asset) == 0)
+	{
+		return m_lastShapes;
+	}
+	auto it = m_assets.find(asset);
+	if (it == m_assets.end())
+	{
+		it = m_assets.emplace(asset, Shapes()).first;
+	}
+	// Pointers to the elements of an unordered_map remain valid as it grows
+	m_lastAsset = &it->first;
+	m_lastShapes = &it->second;
+	return m_lastShapes;
+}
+
+/**
+ * Return the FNV-1a hash of the ordered datapoint names of a reading
+ *
+ * @param datapoints	The datapoints of the reading
+ * @return uint64_t	The hash of the shape
+ */
+uint64_t AssetShapeCache::shapeHash(const vector<Datapoint *>& datapoints)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for (auto dp : datapoints)
+	{
+		const string& name = dp->getName();
+		for (size_t i = 0; i < name.length(); i++)
+		{
+			hash ^= (unsigned char)name[i];
+			hash *= 1099511628211ULL;
+		}
+		// Separate the names so that "ab","c" differs from "a","bc"
+		hash ^= 0xff;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Record a shape in the cache
+ *
+ * @param hash		The hash of the datapoint names
+ * @param datapoints	The datapoints of the reading
+ */
+AssetShapeCache::Shape::Shape(uint64_t hash, const vector<Datapoint *>& datapoints) : m_hash(hash)
+{
+	m_names.reserve(datapoints.size());
+	for (auto dp : datapoints)
+	{
+		m_names.push_back(dp->getName());
+	}
+}
+
+/**
+ * Check if the datapoints of a reading have this shape
+ *
+ * @param hash		The hash of the datapoint names
+ * @param datapoints	The datapoints of the reading
+ * @return bool		True if the datapoints match the shape
+ */
+bool AssetShapeCache::Shape::matches(uint64_t hash, const vector<Datapoint *>& datapoints) const
+{
+	if (hash != m_hash || datapoints.size() != m_names.size())
+	{
+		return false;
+	}
+	for (size_t i = 0; i < m_names.size(); i++)
+	{
+		if (m_names[i].compare(datapoints[i]->getName()) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
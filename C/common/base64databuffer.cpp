@@ -17,15 +17,17 @@ using namespace std;
 Base64DataBuffer::Base64DataBuffer(const string& encoded)
 {
 	m_itemSize = encoded[0] - '0';
+	// The base64 data follows the item size
+	const char *base64 = encoded.c_str() + 1;
 	size_t in_len = encoded.size() - 1;
-	if (in_len % 4 != 0)
+	if (in_len % 4 != 0 || m_itemSize <= 0)
 	{
 		throw runtime_error("Base64DataBuffer string is incorrect length");
 	}
 	size_t maxLen = in_len / 4 * 3;
-	if (encoded[in_len - 1] == '=')
+	if (in_len && base64[in_len - 1] == '=')
 		maxLen--;
-	if (encoded[in_len - 2] == '=')
+	if (in_len && base64[in_len - 2] == '=')
 		maxLen--;
 	m_len = maxLen / m_itemSize;
 	if ((m_data = malloc(maxLen)) == NULL)
@@ -36,10 +38,10 @@ Base64DataBuffer::Base64DataBuffer(const string& encoded)
 
 	for (size_t i = 0, j = 0; i < in_len;)
 	{
-		uint32_t a = encoded[i] == '=' ? 0 & i++ : decodingTable[static_cast<int>(encoded[i++])];
-		uint32_t b = encoded[i] == '=' ? 0 & i++ : decodingTable[static_cast<int>(encoded[i++])];
-		uint32_t c = encoded[i] == '=' ? 0 & i++ : decodingTable[static_cast<int>(encoded[i++])];
-		uint32_t d = encoded[i] == '=' ? 0 & i++ : decodingTable[static_cast<int>(encoded[i++])];
+		uint32_t a = base64[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(base64[i++])];
+		uint32_t b = base64[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(base64[i++])];
+		uint32_t c = base64[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(base64[i++])];
+		uint32_t d = base64[i] == '=' ? 0 & i++ : decodingTable[(uint8_t)(base64[i++])];
 
 		uint32_t triple = (a << 3 * 6) + (b << 2 * 6) + (c << 1 * 6) + (d << 0 * 6);
 
@@ -61,12 +63,12 @@ string Base64DataBuffer::encode()
 
 	size_t nBytes = m_itemSize * m_len;
 	size_t encoded = 4 * ((nBytes + 2) / 3);
-	char *ret = (char *)malloc(encoded + 1);
+	char *ret = (char *)malloc(encoded + 2);
 	char *p = ret;
 	*p++ = m_itemSize + '0';
 	uint8_t *data = (uint8_t *)m_data;
-	int i;
-	for (i = 0; i < m_len - 2; i += 3)
+	size_t i;
+	for (i = 0; i + 2 < nBytes; i += 3)
 	{
 		*p++ = encodingTable[(*data >> 2) & 0x3F];
 		*p++ = encodingTable[((*data & 0x3) << 4) | ((int) (*(data + 1) & 0xF0) >> 4)];
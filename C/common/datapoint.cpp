@@ -84,7 +84,7 @@ std::string DatapointValue::toString() const
 		return ss.str();
 	case T_STRING:
 		ss << "\"";
-		ss << escape(*m_value.str);
+		ss << escape(stringValue());
 		ss << "\"";
 		return ss.str();
 	case T_DATABUFFER:
@@ -129,14 +129,15 @@ std::string DatapointValue::toString() const
 }
 
 /**
- * Delete the DatapointValue along with possibly nested Datapoint objects
+ * Delete the DatapointValue along with possibly nested Datapoint objects.
+ * The value is left as the integer 0.
  */
 void DatapointValue::deleteNestedDPV()
 {
 	if (m_type == T_STRING)
 	{
-		delete m_value.str;
-		m_value.str = NULL;
+		if (m_length == DPV_HEAP_STRING)
+			delete m_value.str;
 	}
 	else if (m_type == T_FLOAT_ARRAY)
 	{
@@ -172,9 +173,34 @@ void DatapointValue::deleteNestedDPV()
 	}
 	else if (m_type == T_2D_FLOAT_ARRAY)
 	{
+		for (auto row : *m_value.a2d)
+		{
+			delete row;
+		}
 		delete m_value.a2d;
 		m_value.a2d = NULL;
 	}
+	m_type = T_INTEGER;
+	m_value.i = 0;
+}
+
+/**
+ * Take the value of another DatapointValue, leaving the other
+ * DatapointValue holding the integer 0. Any heap allocated value
+ * is transferred rather than copied. The current value must already
+ * have been deleted.
+ *
+ * @param obj	The DatapointValue to take the value from
+ */
+void DatapointValue::moveFrom(DatapointValue& obj) noexcept
+{
+	// Every member of the union is either held within the union
+	// or is a pointer whose ownership is transferred
+	m_type = obj.m_type;
+	m_value = obj.m_value;
+	m_length = obj.m_length;
+	obj.m_type = T_INTEGER;
+	obj.m_value.i = 0;
 }
 
 /**
@@ -196,7 +222,11 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 	switch (m_type)
 	{
 		case T_STRING:
-			m_value.str = new std::string(*(obj.m_value.str));
+			if (obj.m_length == DPV_HEAP_STRING)
+				m_value.str = new std::string(*obj.m_value.str);
+			else
+				m_value = obj.m_value;
+			m_length = obj.m_length;
 			break;
 		case T_FLOAT_ARRAY:
 			m_value.a = new std::vector<double>(*(obj.m_value.a));
@@ -235,84 +265,85 @@ DatapointValue::DatapointValue(const DatapointValue& obj)
 			}
 			m_type = T_2D_FLOAT_ARRAY;
 			break;
-		default:
-			m_value = obj.m_value;
+		case T_INTEGER:
+			m_value.i = obj.m_value.i;
+			break;
+		case T_FLOAT:
+			m_value.f = obj.m_value.f;
 			break;
 	}
 }
 
 /**
  * Assignment Operator
+ *
+ * The value is copied before the current value is deleted,
+ * so that assigning a value that is nested within this value
+ * is safe.
  */
 DatapointValue& DatapointValue::operator=(const DatapointValue& rhs)
 {
-	if (m_type == T_STRING)
-	{
-		// Remove previous value
-		delete m_value.str;
-	}
-	if (m_type == T_FLOAT_ARRAY)
-	{
-		// Remove previous value
-		delete m_value.a;
-	}
-	if (m_type == T_DP_DICT || m_type == T_DP_LIST)
+	if (this != &rhs)
 	{
-		// Remove previous value
-		delete m_value.dpa;
+		DatapointValue copy(rhs);
+		deleteNestedDPV();
+		moveFrom(copy);
 	}
-	if (m_type == T_IMAGE)
+	return *this;
+}
+
+/**
+ * Set the value to a string, held within the value if it is short
+ * enough. Any current value must already have been deleted.
+ *
+ * @param str		The characters of the string
+ * @param length	The length of the string
+ */
+void DatapointValue::setString(const char *str, size_t length)
+{
+	if (length <= DPV_INLINE_STRING)
 	{
-		delete m_value.image;
+		memcpy(m_value.s, str, length);
+		m_length = (unsigned char)length;
 	}
-	if (m_type == T_DATABUFFER)
+	else
 	{
-		delete m_value.dataBuffer;
+		m_value.str = new std::string(str, length);
+		m_length = DPV_HEAP_STRING;
 	}
-	if (m_type == T_2D_FLOAT_ARRAY)
+	m_type = T_STRING;
+}
+
+/**
+ * Set the value to a string, a long string is moved to the heap
+ * rather than copied. Any current value must already have been deleted.
+ *
+ * @param str	The string
+ */
+void DatapointValue::setString(std::string&& str)
+{
+	if (str.length() <= DPV_INLINE_STRING)
 	{
-		delete m_value.a2d;
+		setString(str.data(), str.length());
 	}
-
-	m_type = rhs.m_type;
-
-	switch (m_type)
+	else
 	{
-	case T_STRING:
-		m_value.str = new std::string(*(rhs.m_value.str));
-		break;
-	case T_FLOAT_ARRAY:
-		m_value.a = new std::vector<double>(*(rhs.m_value.a));
-		break;
-	case T_DP_DICT:
-	case T_DP_LIST:
-		m_value.dpa = new std::vector<Datapoint*>(*(rhs.m_value.dpa));
-		break;
-	case T_IMAGE:
-		m_value.image = new DPImage(*(rhs.m_value.image));
-		break;
-	case T_DATABUFFER:
-		m_value.dataBuffer = new DataBuffer(*(rhs.m_value.dataBuffer));
-		break;
-	case T_2D_FLOAT_ARRAY:
-		m_value.a2d = new std::vector< std::vector<double>* >;
-		for (auto row : *(rhs.m_value.a2d))
-		{
-			std::vector<double> *nrow = new std::vector<double>;
-			for (auto& d : *row)
-			{
-				nrow->push_back(d);
-			}
-			m_value.a2d->push_back(nrow);
-		}
-		m_type = T_2D_FLOAT_ARRAY;
-		break;
-	default:
-		m_value = rhs.m_value;
-		break;
+		m_value.str = new std::string(std::move(str));
+		m_length = DPV_HEAP_STRING;
+		m_type = T_STRING;
 	}
+}
 
-	return *this;
+/**
+ * Return the value of a string datapoint
+ *
+ * @return	The string
+ */
+std::string DatapointValue::stringValue() const
+{
+	if (m_length == DPV_HEAP_STRING)
+		return *m_value.str;
+	return std::string(m_value.s, m_length);
 }
 
 /**
@@ -387,7 +418,7 @@ std::vector<Datapoint*> *Datapoint::recursiveJson(const rapidjson::Value& docume
 		if (itr->value.IsObject()) {
 			std::vector<Datapoint*> * vec = recursiveJson(itr->value);
 			DatapointValue d(vec, true);
-			p->push_back(new Datapoint(itr->name.GetString(), d));
+			p->push_back(new Datapoint(itr->name.GetString(), std::move(d)));
 		}
 		else if (itr->value.IsString()) {
 			DatapointValue d(itr->value.GetString());
@@ -14,12 +14,14 @@
 #include <set>
 #include <sstream>
 #include <unordered_set>
+#include <unordered_map>
 #include <management_client.h>
 #include <queue>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <storage_client.h>
+#include <reading.h>
 
 #define MIN_ASSET_TRACKER_UPDATE	500 // The minimum interval for asset tracker updates
 
@@ -314,4 +316,41 @@ class AssetTrackingTable {
 				m_tuples;
 };
 
+/**
+ * A cache of the shapes of the readings seen for each asset, the shape
+ * being the ordered names of the datapoints of a reading. The readings of
+ * an asset almost always have the same shape, only readings with a new
+ * shape need the datapoints of the asset to be tracked, saving the building
+ * of sets of datapoint names for every reading.
+ *
+ * Shapes are found by a hash of the datapoint names and then compared by
+ * name, so a hash collision can not hide a new shape. The cache is not
+ * thread safe, it is intended to be owned by the thread that tracks the
+ * assets.
+ */
+class AssetShapeCache {
+	public:
+		AssetShapeCache();
+		bool			isNewShape(const Reading *reading);
+		void			clear();
+		static uint64_t		shapeHash(const std::vector<Datapoint *>& datapoints);
+	private:
+		class Shape {
+			public:
+				Shape(uint64_t hash, const std::vector<Datapoint *>& datapoints);
+				bool		matches(uint64_t hash,
+						const std::vector<Datapoint *>& datapoints) const;
+			private:
+				uint64_t			m_hash;
+				std::vector<std::string>	m_names;
+		};
+		typedef std::vector<Shape>	Shapes;
+		Shapes			*find(const std::string& asset);
+	private:
+		std::unordered_map<std::string, Shapes>
+					m_assets;
+		const std::string	*m_lastAsset;
+		Shapes			*m_lastShapes;
+};
+
 #endif
@@ -10,21 +10,33 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <string>
+#include <cstring>
 #include <sstream>
 #include <iomanip>
 #include <cfloat>
 #include <vector>
+#include <utility>
 #include <logger.h>
 #include <dpimage.h>
 #include <databuffer.h>
 #include <rapidjson/document.h>
 
+#define DPV_INLINE_STRING	8	// Longest string held within a DatapointValue rather than on the heap
+#define DPV_HEAP_STRING		0xFF	// String length marker of a string held on the heap
+
 class Datapoint;
 /**
  * Class to hold an actual reading value.
  * The class is simply a tagged union that also contains
  * methods to return the value as a string for encoding
  * in a JSON document.
+ *
+ * Strings of up to DPV_INLINE_STRING characters are held within
+ * the union and need no allocation, longer strings are held on
+ * the heap. The value therefore stays the size of a pointer and
+ * a tag. Values may be moved as well as copied, a move transfers
+ * any heap allocated value and leaves the source holding the
+ * integer 0.
  */
 class DatapointValue {
 	public:
@@ -33,8 +45,21 @@ class DatapointValue {
 		 */
 		DatapointValue(const std::string& value)
 		{
-			m_value.str = new std::string(value);
-			m_type = T_STRING;
+			setString(value.data(), value.length());
+		};
+		/**
+		 * Construct with a string that is moved into the value
+		 */
+		DatapointValue(std::string&& value)
+		{
+			setString(std::move(value));
+		};
+		/**
+		 * Construct with a C string
+		 */
+		DatapointValue(const char *value)
+		{
+			setString(value, strlen(value));
 		};
 		/**
  		 * Construct with an integer value
@@ -130,11 +155,32 @@ class DatapointValue {
 		 */
 		DatapointValue(const DatapointValue& obj);
 
+		/**
+		 * Move constructor
+		 */
+		DatapointValue(DatapointValue&& obj) noexcept
+		{
+			moveFrom(obj);
+		};
+
 		/**
 		 * Assignment Operator
 		 */
 		DatapointValue& operator=(const DatapointValue& rhs);
 
+		/**
+		 * Move assignment Operator
+		 */
+		DatapointValue& operator=(DatapointValue&& rhs) noexcept
+		{
+			if (this != &rhs)
+			{
+				deleteNestedDPV();
+				moveFrom(rhs);
+			}
+			return *this;
+		};
+
 		/**
 		 * Destructor
 		 */
@@ -147,12 +193,14 @@ class DatapointValue {
                  */
                 void setValue(std::string value)
                 {
-                        if(m_value.str)
-                        {
-                                delete m_value.str;
-                        }
-                        m_value.str = new std::string(value);
-                        m_type = T_STRING;
+			if (m_type == T_STRING && m_length == DPV_HEAP_STRING
+					&& value.length() > DPV_INLINE_STRING)
+			{
+				*m_value.str = std::move(value);
+				return;
+			}
+			deleteNestedDPV();
+			setString(std::move(value));
                 }
 	
 		/**
@@ -162,6 +210,10 @@ class DatapointValue {
 		 */
 		void setValue(long value)
 		{
+			// A dictionary or list is left to the caller, who
+			// may have taken the vector of datapoints
+			if (m_type != T_DP_DICT && m_type != T_DP_LIST)
+				deleteNestedDPV();
 			m_value.i = value;
 			m_type = T_INTEGER;
 		}
@@ -173,6 +225,10 @@ class DatapointValue {
 		 */
 		void setValue(double value)
 		{
+			// A dictionary or list is left to the caller, who
+			// may have taken the vector of datapoints
+			if (m_type != T_DP_DICT && m_type != T_DP_LIST)
+				deleteNestedDPV();
 			m_value.f = value;
 			m_type = T_FLOAT;
 		}
@@ -182,7 +238,9 @@ class DatapointValue {
 		 */
 		void setValue(const DPImage& value)
 		{
-			m_value.image = new DPImage(value);
+			DPImage *image = new DPImage(value);
+			deleteNestedDPV();
+			m_value.image = image;
 			m_type = T_IMAGE;
 		}
 
@@ -192,9 +250,13 @@ class DatapointValue {
 		std::string	toString() const;
 
 		/**
-		 * Return string value without trailing/leading quotes
+		 * Return string value without trailing/leading quotes,
+		 * values of other types are returned as by toString()
 		 */
-		std::string	toStringValue() const { return *m_value.str; };
+		std::string	toStringValue() const
+		{
+			return m_type == T_STRING ? stringValue() : toString();
+		};
 
 		/**
 		 * Return long value
@@ -286,9 +348,14 @@ class DatapointValue {
 
 	private:
 		void deleteNestedDPV();
+		void moveFrom(DatapointValue& obj) noexcept;
+		void setString(const char *str, size_t length);
+		void setString(std::string&& str);
+		std::string	stringValue() const;
 		const std::string	escape(const std::string& str) const;
 		union data_t {
-			std::string*		str;
+			std::string		*str;
+			char			s[DPV_INLINE_STRING];
 			long			i;
 			double			f;
 			std::vector<double>*	a;
@@ -300,6 +367,7 @@ class DatapointValue {
 						*a2d;
 			} m_value;
 		DatapointTag	m_type;
+		unsigned char	m_length;	// Length of a string held in m_value.s, DPV_HEAP_STRING if in m_value.str
 };
 
 /**
@@ -315,6 +383,14 @@ class Datapoint {
 		{
 		}
 
+		/**
+		 * Construct with a data point value that is moved
+		 * into the datapoint
+		 */
+		Datapoint(const std::string& name, DatapointValue&& value) : m_name(name), m_value(std::move(value))
+		{
+		}
+
 		~Datapoint()
 		{
 		}
@@ -334,7 +410,7 @@ class Datapoint {
 		/**
 		 * Return the Datapoint name
 		 */
-		const std::string getName() const
+		const std::string& getName() const
 		{
 			return m_name;
 		}
@@ -350,7 +426,7 @@ class Datapoint {
 		/**
 		 * Return Datapoint value
 		 */
-		const DatapointValue getData() const
+		const DatapointValue& getData() const
 		{
 			return m_value;
 		}
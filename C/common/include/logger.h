@@ -11,6 +11,10 @@
  */
 
 #include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #define PRINT_FUNC	Logger::getLogger()->info("%s:%d", __FUNCTION__, __LINE__);
 
@@ -22,25 +26,71 @@
  * call debug, info, warn etc. using the instance
  * of the class. TO get that instance call the static
  * method getLogger.
+ *
+ * In asynchronous mode the calling thread only formats the message
+ * and places it in a bounded ring buffer, a background thread writes
+ * the messages to syslog. Messages that arrive when the ring buffer is
+ * full are discarded and the number discarded is logged.
  */
+struct LogSlot;
+
 class Logger {
 	public:
 		Logger(const std::string& application);
 		~Logger();
 		static Logger *getLogger();
 		void debug(const std::string& msg, ...);
+		void debug(const char *msg, ...);
 		void printLongString(const std::string&);
 		void info(const std::string& msg, ...);
+		void info(const char *msg, ...);
 		void warn(const std::string& msg, ...);
+		void warn(const char *msg, ...);
 		void error(const std::string& msg, ...);
+		void error(const char *msg, ...);
 		void fatal(const std::string& msg, ...);
+		void fatal(const char *msg, ...);
 		void setMinLevel(const std::string& level);
 		std::string& getMinLevel() { return levelString; }
+		/**
+		 * Return if messages of the given syslog priority would be logged.
+		 * Use to avoid preparing the arguments of a message that
+		 * would be discarded.
+		 *
+		 * @param priority	The syslog priority, e.g. LOG_DEBUG
+		 */
+		bool isEnabled(int priority) const { return priority <= m_level; };
+		void setAsynchronous(bool async);
+		bool isAsynchronous() const { return m_async; };
+		void flush();
+		void drainThread();
 	private:
-		std::string 	*format(const std::string& msg, va_list ap);
+		void		log(int priority, const char *tag, const char *msg, va_list ap);
+		bool		enqueue(int priority, const char *tag, const char *msg);
+		bool		dequeue();
 		static Logger   *instance;
 		std::string     levelString;
 		int		m_level;
+		std::atomic<bool>
+				m_async;
+		LogSlot		*m_ring;
+		std::atomic<size_t>
+				m_head;
+		std::atomic<size_t>
+				m_tail;
+		std::atomic<unsigned long>
+				m_dropped;
+		std::atomic<int>
+				m_producers;	// Threads that may be queuing a message
+		std::thread	*m_thread;
+		std::mutex	m_asyncMutex;
+		std::atomic<bool>
+				m_running;
+		std::atomic<bool>
+				m_waiting;
+		std::mutex	m_mutex;
+		std::condition_variable
+				m_cv;
 };
 
 #endif
@@ -21,6 +21,8 @@
 #define ISO8601_DATE_TIME_FORMAT      "%Y-%m-%d %H:%M:%S +0000"
 #define DATE_TIME_BUFFER_LEN          52
 
+class ReadingArena;
+
 /**
  * An asset reading represented as a class.
  *
@@ -51,7 +53,7 @@ class Reading {
 		unsigned int			getDatapointCount() { return m_values.size(); };
 		void				removeAllDatapoints();
 		// Return Reading datapoints
-		const std::vector<Datapoint *>	getReadingData() const { return m_values; };
+		const std::vector<Datapoint *>&	getReadingData() const { return m_values; };
 		// Return refrerence to Reading datapoints
 		std::vector<Datapoint *>&	getReadingData() { return m_values; };
 		bool				hasId() const { return m_has_id; };
@@ -77,6 +79,7 @@ class Reading {
 		const std::string getAssetDateUserTime(readingTimeFormat datetimeFmt = FMT_DEFAULT, bool addMs = true) const;
 
 	protected:
+		friend class ReadingArena;	// Copies readings into an arena
 		Reading() {};
 		Reading&			operator=(Reading const&);
 		void				stringToTimestamp(const std::string& timestamp, struct timeval *ts);
@@ -88,6 +91,7 @@ class Reading {
 		struct timeval			m_timestamp;
 		struct timeval			m_userTimestamp;
 		std::vector<Datapoint *>	m_values;
+		ReadingArena			*m_arena = NULL;	// The arena holding the reading, NULL if on the heap
 		// Supported date time formats for 'm_timestamp'
 		static std::vector<std::string>	m_dateTypes;
 };
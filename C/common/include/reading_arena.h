@@ -0,0 +1,99 @@
+#ifndef _READING_ARENA_H
+#define _READING_ARENA_H
+/*
+ * Fledge reading arena allocator
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#define ARENA_CHUNK_SIZE	(64 * 1024)	// Size of each chunk of memory of an arena
+#define ARENA_BLOCK_READINGS	1000		// Readings copied into an arena before a thread starts another
+#define ARENA_SPARE_CHUNKS	64		// Chunks of disposed arenas kept for reuse
+
+/**
+ * An arena that holds copies of a block of readings, and their
+ * datapoints, contiguously in chunks of memory rather than allocating
+ * each object individually from the heap. All the memory of the arena
+ * is released in one operation once every reading in the block has
+ * been destroyed, a limited number of chunks are kept to be reused.
+ *
+ * Readings are placed in an arena explicitly by copy() and must be
+ * deleted with destroy(), never with delete. A reading held in an
+ * arena is marked as such, destroy() may therefore be given any
+ * reading and the owner need not track which of its readings are held
+ * in an arena. Readings must be taken out of the arena with copyOut()
+ * before they are passed to filters or plugins, as these may modify
+ * or delete them.
+ *
+ * The datapoints copied with a reading follow it in the arena.
+ * Datapoints later added to the reading with addDatapoint() are heap
+ * objects, owned by the reading and deleted when it is destroyed. A
+ * datapoint removed from the reading is always returned on the heap.
+ *
+ * Each thread copies readings into an arena of its own, after
+ * ARENA_BLOCK_READINGS readings, or when the thread exits, the arena
+ * is sealed and the thread starts another. The readings may be
+ * destroyed on any thread, in any order. Destroying a block of readings
+ * releases the readings of each arena with a single atomic operation.
+ */
+class ReadingArena {
+	public:
+		static Reading	*copy(const Reading& reading);
+		static Reading	*copyOut(Reading *reading);
+		static void	destroy(Reading *reading);
+		static void	destroy(std::vector<Reading *>& readings);
+		/**
+		 * Check if a reading is held in an arena
+		 *
+		 * @param reading	The reading to check
+		 * @return		True if the reading is held in an arena
+		 */
+		static bool	owns(const Reading *reading) { return reading->m_arena != NULL; };
+		static bool	holds(const Reading *reading, const Datapoint *datapoint);
+		static void	deleteDatapoint(const Reading *reading, Datapoint *datapoint);
+		static Datapoint
+				*removeDatapoint(const Reading *reading, Datapoint *datapoint);
+
+	private:
+		class Current {
+			public:
+				Current() : m_arena(NULL) {};
+				~Current();
+				ReadingArena	*m_arena;
+		};
+		class Chunk {
+			public:
+				Chunk		*m_next;
+		};
+		class Header {
+			public:
+				size_t		m_datapoints;	// Datapoints copied with the reading
+		};
+
+		ReadingArena(Chunk *chunk);
+		static ReadingArena
+				*create();
+		void		*allocate(size_t size);
+		void		destruct(Reading *reading);
+		void		seal();
+		void		release(long readings);
+		void		dispose();
+
+		Chunk			*m_chunks;	// The chunks of the arena, most recent first
+		char			*m_next;	// Next free byte in the current chunk
+		size_t			m_remaining;	// Bytes left in the current chunk
+		long			m_allocated;	// Readings copied, only updated by the owning thread
+		std::atomic<long>	m_live;		// Readings copied less those destroyed
+		static thread_local Current
+					m_current;
+};
+
+#endif
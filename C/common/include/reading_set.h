@@ -26,7 +26,9 @@
 class ReadingSet {
 	public:
 		ReadingSet();
-		ReadingSet(const std::string& json);
+		typedef enum parserType { PARSE_DOCUMENT, PARSE_STREAM, PARSE_BINARY } readingSetParser;
+
+		ReadingSet(const std::string& json, readingSetParser parser = PARSE_STREAM);
 		ReadingSet(const std::vector<Reading *>* readings);
 		virtual ~ReadingSet();
 
@@ -56,6 +58,8 @@ class ReadingSet {
 		bool				copy(const ReadingSet& src);
 
 	protected:
+		void				parseStream(const std::string& json);
+		void				parseBinary(const std::string& payload);
 		unsigned long			m_count;
 		ReadingSet(const ReadingSet&);
 		ReadingSet&			operator=(ReadingSet const &);
@@ -78,6 +82,8 @@ class JSONReading : public Reading {
 		unsigned long	getId() const { return m_id; };
 
 	private:
+		friend class ReadingSetHandler;
+		JSONReading() {};
 		Datapoint 	*datapoint(const std::string& name, const rapidjson::Value& json);
                 void 		escapeCharacter(std::string& stringToEvaluate, std::string pattern);
 };
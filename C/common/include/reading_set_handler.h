@@ -0,0 +1,111 @@
+#ifndef _READING_SET_HANDLER_H
+#define _READING_SET_HANDLER_H
+/*
+ * Fledge SAX reading set handler.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_set.h>
+#include <rapidjson/reader.h>
+#include <string>
+#include <vector>
+
+/**
+ * A rapidjson SAX handler that builds the readings of a storage service
+ * query or notification response directly from the JSON text, without
+ * first building a document.
+ *
+ * The scalar values of the readings are converted by the same code as
+ * the JSONReading class, hence the readings are identical to those built
+ * from a document. The handler must be used with the in-situ parser, the
+ * names of the datapoints refer to the JSON text until the enclosing
+ * object is complete.
+ */
+class ReadingSetHandler : public rapidjson::BaseReaderHandler<rapidjson::UTF8<>, ReadingSetHandler> {
+	public:
+		ReadingSetHandler();
+		~ReadingSetHandler();
+
+		bool	Null() { return scalar(rapidjson::Value()); };
+		bool	Bool(bool b) { return scalar(rapidjson::Value(b)); };
+		bool	Int(int i) { return scalar(rapidjson::Value(i)); };
+		bool	Uint(unsigned u) { return scalar(rapidjson::Value(u)); };
+		bool	Int64(int64_t i) { return scalar(rapidjson::Value(i)); };
+		bool	Uint64(uint64_t u) { return scalar(rapidjson::Value(u)); };
+		bool	Double(double d) { return scalar(rapidjson::Value(d)); };
+		bool	String(const char *str, rapidjson::SizeType length, bool copy);
+		bool	StartObject();
+		bool	Key(const char *str, rapidjson::SizeType length, bool copy);
+		bool	EndObject(rapidjson::SizeType memberCount);
+		bool	StartArray();
+		bool	EndArray(rapidjson::SizeType elementCount);
+
+		const std::string&	getError() const { return m_error; };
+		bool			hasRows() const { return m_hasRows; };
+		bool			hasReadings() const { return m_hasReadings; };
+		bool			hasCount() const { return m_hasCount; };
+		unsigned long		getCount() const { return m_count; };
+		bool			isArray() const;
+		void			moveReadings(std::vector<Reading *>& readings);
+
+	private:
+		/**
+		 * The JSON containers that are being parsed
+		 */
+		typedef enum {
+			FrameDocument,		// The response document
+			FrameRows,		// The array of readings
+			FrameReading,		// A reading
+			FrameDatapoints,	// The reading object or a nested datapoint object
+			FrameArray		// A datapoint array
+		} FrameType;
+
+		class Frame {
+			public:
+				Frame(FrameType type, const char *name = NULL) :
+					type(type), name(name), datapoints(NULL) {};
+				FrameType			type;
+				const char			*name;		// Name of the datapoint being built
+				std::vector<Datapoint *>	*datapoints;	// Members of a datapoint object
+				std::vector<double>		values;		// Elements of a datapoint array
+		};
+
+		bool	scalar(rapidjson::Value&& value);
+		bool	container(bool object);
+		bool	endReading();
+		void	addDatapoint(Datapoint *datapoint);
+		bool	fail(const std::string& error);
+
+		std::vector<Frame>	m_stack;
+		int			m_skip;		// Depth of a value that is being skipped
+		const char		*m_key;
+		std::string		m_error;
+
+		bool			m_hasRows;
+		bool			m_hasReadings;
+		bool			m_hasCount;
+		bool			m_rowsArray;
+		bool			m_readingsArray;
+		bool			m_inRows;	// Set while in the rows rather than the readings array
+		unsigned long		m_count;
+		std::vector<Reading *>	m_rows;
+		std::vector<Reading *>	m_readings;
+
+		// The reading being built
+		JSONReading		*m_reading;
+		std::vector<Datapoint *>
+					m_datapoints;
+		const char		*m_userTs;
+		const char		*m_ts;
+		bool			m_hasAsset;
+		rapidjson::Value	m_value;
+		rapidjson::Value	m_readingValue;
+		bool			m_hasReadingMember;
+		bool			m_hasReadingObject;
+};
+
+#endif
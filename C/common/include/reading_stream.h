@@ -10,12 +10,64 @@
  * Author: Mark Riddoch
  */
 
+#include <stdint.h>
+#include <sys/time.h>
+
 #define RDS_CONNECTION_MAGIC	0x344f4e4e
+#define RDS_BINARY_CONNECTION_MAGIC	0x42494e43
 #define	RDS_BLOCK_MAGIC		0x5244424b
 #define	RDS_READING_MAGIC	0x52444947
 #define RDS_ACK_MAGIC		0x4241434b
 #define RDS_NACK_MAGIC		0x4e41434b
 
+/*
+ * Version 1 of the protocol sends the datapoints of each reading as a JSON
+ * object. Version 2 adds binary encoded datapoint payloads. Version 3 adds
+ * images and data buffers to the binary payloads. The storage service
+ * advertises the version it supports when the stream is created and
+ * a client that wishes to send binary payloads connects using the
+ * RDS_BINARY_CONNECTION_MAGIC rather than RDS_CONNECTION_MAGIC.
+ */
+#define RDS_PROTOCOL_VERSION	3
+#define RDS_BINARY_PROTOCOL_VERSION	2
+#define RDS_BINARY_DATA_PROTOCOL_VERSION	3
+
+/*
+ * A binary payload is identified by its first byte, which can never be the
+ * start of a JSON object, followed by the payload encoding version. This
+ * allows binary and JSON payloads to be mixed within a single block.
+ *
+ * The remainder of the payload is the count of datapoints followed by each
+ * datapoint in turn. A datapoint is encoded as a one byte type tag, taken
+ * from DatapointValue::dataTagType, the length of the name, the name and then
+ * the value.
+ *
+ *	T_STRING		length, characters
+ *	T_INTEGER		integer
+ *	T_FLOAT			double
+ *	T_FLOAT_ARRAY		count, doubles
+ *	T_2D_FLOAT_ARRAY	rows, each row as a T_FLOAT_ARRAY
+ *	T_DP_DICT, T_DP_LIST	count, nested datapoints
+ *	T_IMAGE			width, height, depth, byte length, raw pixels
+ *	T_DATABUFFER		item size, item count, byte length, raw data
+ *
+ * Counts and lengths are unsigned varints, seven bits per byte least
+ * significant first, and integers are zigzag encoded varints, so that
+ * the small values typical of readings take a single byte. Doubles are
+ * eight bytes little endian. Version 1 payloads, which held counts and
+ * lengths as uint32 and integers as int64, are still decoded.
+ *
+ * The datapoint names are held in every payload so that each payload
+ * may be decoded on its own, whether it is part of a stream, a row of
+ * a storage plugin or a record in a ring.
+ *
+ * The raw data of images and data buffers is carried without any
+ * encoding, the client passes it to writev directly from the datapoint.
+ */
+#define RDS_BINARY_PAYLOAD_MARKER	0x02
+#define RDS_BINARY_PAYLOAD_VERSION	2
+#define RDS_PAYLOAD_IS_BINARY(p)	(((const unsigned char *)(p))[0] == RDS_BINARY_PAYLOAD_MARKER)
+
 typedef struct {
 	uint32_t	magic;
 	uint32_t	token;
@@ -39,6 +91,29 @@ typedef struct {
 	uint32_t	block;
 } RDSAcknowledge;
 
+/*
+ * Readings fetched from the storage service with the format=binary query
+ * parameter are returned with a content type of application/octet-stream.
+ * The response is an RDSFetchHeader followed by each reading in turn, an
+ * RDSFetchReading followed by the asset code, user timestamp and timestamp,
+ * none of which are null terminated, and then the payload. The payload is
+ * either a binary payload or the JSON text of the reading datapoints.
+ */
+#define RDS_FETCH_MAGIC		0x52444654
+
+typedef struct {
+	uint32_t	magic;
+	uint32_t	count;
+} RDSFetchHeader;
+
+typedef struct {
+	uint64_t	id;
+	uint32_t	assetLength;
+	uint32_t	userTsLength;
+	uint32_t	tsLength;
+	uint32_t	payloadLength;
+} RDSFetchReading;
+
 typedef struct {
 	uint32_t	assetCodeLength;
 	uint32_t 	payloadLength;
@@ -0,0 +1,79 @@
+#ifndef _READING_STREAM_PAYLOAD_H
+#define _READING_STREAM_PAYLOAD_H
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <string>
+#include <vector>
+#include <functional>
+#include <datapoint.h>
+#include <reading_stream.h>
+#include <rapidjson/document.h>
+
+/**
+ * A reference to data that forms part of an encoded payload but is
+ * not copied into it, the data is inserted at the given offset of the
+ * payload when it is sent.
+ */
+typedef struct {
+	size_t		offset;		// Offset in the payload string at which the data belongs
+	const void	*data;
+	size_t		length;
+} PayloadReference;
+
+/**
+ * Encode and decode the binary datapoint payloads carried by
+ * version 2 of the reading stream protocol.
+ *
+ * The encoding is described in reading_stream.h. The decoder can either
+ * produce the JSON representation of the datapoints, as would have been
+ * created by Reading::getDatapointsJSON, or rebuild the datapoints
+ * themselves.
+ *
+ * The same encoding may also be created directly from the JSON
+ * datapoints of a reading, allowing storage plugins to hold readings in
+ * the binary form.
+ *
+ * Numeric datapoints may be read from a payload without decoding the
+ * rest of it, for storage plugins that aggregate readings.
+ *
+ * When encoding, the raw data of images and data buffers may be returned
+ * as references rather than copied into the payload, so that it may be
+ * sent from the datapoint without a copy.
+ */
+class ReadingStreamPayload {
+	public:
+		typedef std::function<void (const char *name, uint32_t nameLength,
+					double value)> NumberVisitor;
+
+		static bool	encode(const std::vector<Datapoint *>& datapoints,
+					std::string& payload,
+					std::vector<PayloadReference> *references = NULL);
+		static bool	fromJSON(const rapidjson::Value& reading,
+					std::string& payload);
+		static bool	toJSON(const char *payload, size_t length,
+					std::string& json);
+		static std::vector<Datapoint *>
+				*toDatapoints(const char *payload, size_t length);
+		static bool	number(const char *payload, size_t length,
+					const std::vector<std::string>& path,
+					double& value);
+		static bool	numbers(const char *payload, size_t length,
+					const NumberVisitor& visitor);
+	private:
+		static bool	encodeDatapoint(Datapoint *datapoint,
+					std::string& payload,
+					std::vector<PayloadReference> *references);
+		static bool	encodeJSON(const char *name, uint32_t nameLength,
+					const rapidjson::Value& value,
+					std::string& payload);
+		static bool	encodeBase64(const char *name, uint32_t nameLength,
+					const char *str, std::string& payload);
+};
+#endif
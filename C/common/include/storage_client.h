@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <sys/uio.h>
 
 using HttpClient = SimpleWeb::Client<SimpleWeb::HTTP>;
 
@@ -90,7 +91,8 @@ class StorageClient {
 		bool		readingAppend(const std::vector<Reading *> & readings);
 		ResultSet	*readingQuery(const Query& query);
 		ReadingSet 	*readingQueryToReadings(const Query& query);
-		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count);
+		ReadingSet	*readingFetch(const unsigned long readingId, const unsigned long count,
+						const unsigned long wait = 0);
 		PurgeResult	readingPurgeByAge(unsigned long age, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeBySize(unsigned long size, unsigned long sent, bool purgeUnsent);
 		PurgeResult	readingPurgeByAsset(const std::string& asset);
@@ -104,6 +106,8 @@ class StorageClient {
 								std::vector<std::string> keyValues, const std::string& operation, const std::string& callbackUrl);
 		void		registerManagement(ManagementClient *mgmnt) { m_management = mgmnt; };
 		bool 		createSchema(const std::string&);
+		void		streamBinaryData(bool stream) { m_streamBinaryData = stream; };
+		void		setBinaryFetch(bool binary) { m_binaryFetch = binary; };
 
 	private:
 		void		handleUnexpectedResponse(const char *operation,
@@ -117,6 +121,7 @@ class StorageClient {
 		HttpClient 	*getHttpClient(void);
 		bool		openStream();
 		bool		streamReadings(const std::vector<Reading *> & readings);
+		bool		writeStream(struct iovec *iovs, int count, ssize_t length);
 
 		std::ostringstream 			m_urlbase;
 		std::string				m_host;
@@ -125,6 +130,11 @@ class StorageClient {
 		Logger					*m_logger;
 		pid_t					m_pid;
 		bool					m_streaming;
+		bool					m_streamBinary;
+		int					m_streamVersion;
+		bool					m_streamBinaryData;
+		bool					m_streamFailed;
+		bool					m_binaryFetch;
 		int					m_stream;
 		uint32_t				m_readingBlock;
 		std::string				m_lastException;
@@ -12,15 +12,33 @@
 #include <unistd.h>
 #include <syslog.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <memory>
 #include <string.h>
 #include <sys/time.h>
+#include <chrono>
 
 using namespace std;
 
 // uncomment line below to get uSec level timestamps
 // #define ADD_USEC_TS
 
+#define LOG_BUFFER_SIZE		1000	// Maximum length of a formatted message
+#define LOG_RING_SIZE		1024	// Number of messages buffered, a power of 2
+
+/**
+ * A message in the asynchronous logging ring buffer. The sequence
+ * is used to pass ownership of the slot between the threads logging
+ * messages and the thread writing them to syslog.
+ */
+struct LogSlot {
+	atomic<size_t>	sequence;
+	int		priority;
+	const char	*tag;
+	long		usec;
+	char		message[LOG_BUFFER_SIZE];
+};
+
 inline long getCurrTimeUsec()
 {
 	struct timeval m_timestamp;
@@ -47,10 +65,21 @@ static char ident[80];
 	openlog(ident, LOG_PID|LOG_CONS, LOG_USER);
 	instance = this;
 	m_level = LOG_WARNING;
+	m_async = false;
+	m_ring = NULL;
+	m_head = 0;
+	m_tail = 0;
+	m_dropped = 0;
+	m_producers = 0;
+	m_thread = NULL;
+	m_running = false;
+	m_waiting = false;
 }
 
 Logger::~Logger()
 {
+	setAsynchronous(false);
+	delete[] m_ring;
 	closelog();
 	// Stop the getLogger() call returning a deleted instance
 	if (instance == this)
@@ -98,17 +127,256 @@ void Logger::setMinLevel(const string& level)
 	}
 }
 
+/**
+ * Flush the messages of the logger instance when the process exits
+ */
+static void flushAtExit()
+{
+	Logger *logger = Logger::getLogger();
+	if (logger)
+		logger->setAsynchronous(false);
+}
+
+/**
+ * Entry point of the thread that writes asynchronous messages to syslog
+ *
+ * @param logger	The logger
+ */
+static void drainLog(Logger *logger)
+{
+	logger->drainThread();
+}
+
+/**
+ * Set the logger to write messages to syslog on a background thread
+ * rather than on the thread that logs them. When returning to
+ * synchronous logging the messages already buffered are written.
+ *
+ * @param async	True to log asynchronously
+ */
+void Logger::setAsynchronous(bool async)
+{
+	lock_guard<mutex> guard(m_asyncMutex);
+	if (async && m_thread == NULL)
+	{
+		if (m_ring == NULL)
+		{
+			m_ring = new LogSlot[LOG_RING_SIZE];
+			for (size_t i = 0; i < LOG_RING_SIZE; i++)
+				m_ring[i].sequence.store(i, memory_order_relaxed);
+			static bool registered = false;
+			if (!registered)
+			{
+				atexit(flushAtExit);
+				registered = true;
+			}
+		}
+		m_running = true;
+		m_thread = new thread(drainLog, this);
+		m_async = true;
+	}
+	else if (!async && m_thread)
+	{
+		m_async = false;
+		// Wait for the threads that saw asynchronous logging still
+		// enabled to finish queuing their messages, the drain thread
+		// is still running so they can not be blocked by a full ring
+		while (m_producers.load() > 0)
+			this_thread::yield();
+		m_running = false;
+		m_cv.notify_all();
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+		// Write anything queued as the thread stopped
+		while (dequeue())
+			;
+	}
+}
+
+/**
+ * Wait for the messages that have been queued to be written to syslog
+ */
+void Logger::flush()
+{
+	if (!m_async)
+		return;
+	size_t head = m_head.load(memory_order_acquire);
+	for (int i = 0; i < 1000 && m_tail.load(memory_order_acquire) < head && m_async; i++)
+	{
+		m_cv.notify_all();
+		this_thread::sleep_for(chrono::milliseconds(1));
+	}
+}
+
+/**
+ * The background thread that writes queued messages to syslog and
+ * reports any messages that were discarded because the ring buffer
+ * was full.
+ */
+void Logger::drainThread()
+{
+	while (m_running)
+	{
+		bool written = false;
+		while (dequeue())
+			written = true;
+		unsigned long dropped = m_dropped.exchange(0);
+		if (dropped)
+		{
+			syslog(LOG_WARNING, "WARNING: %lu log messages were discarded as the log buffer was full",
+					dropped);
+		}
+		if (!written)
+		{
+			// If a message has been claimed but not yet copied into
+			// the ring buffer check again shortly, otherwise wait for
+			// a thread that logs a message to wake us
+			unique_lock<mutex> lk(m_mutex);
+			m_waiting = true;
+			if (m_running)
+				m_cv.wait_for(lk, chrono::milliseconds(
+						m_tail.load() == m_head.load() ? 100 : 1));
+			m_waiting = false;
+		}
+	}
+}
+
+/**
+ * Claim a slot in the ring buffer and copy the message into it. Called
+ * on any thread that logs, without taking a lock.
+ *
+ * @param priority	The syslog priority of the message
+ * @param tag		The level tag, e.g. INFO
+ * @param msg		The formatted message
+ * @return bool		False if the ring buffer is full and the message discarded
+ */
+bool Logger::enqueue(int priority, const char *tag, const char *msg)
+{
+	LogSlot *slot;
+	size_t pos = m_head.load(memory_order_relaxed);
+	for (;;)
+	{
+		slot = &m_ring[pos & (LOG_RING_SIZE - 1)];
+		size_t seq = slot->sequence.load(memory_order_acquire);
+		long diff = (long)seq - (long)pos;
+		if (diff == 0)
+		{
+			if (m_head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			m_dropped++;
+			return false;
+		}
+		else
+		{
+			pos = m_head.load(memory_order_relaxed);
+		}
+	}
+	slot->priority = priority;
+	slot->tag = tag;
+#ifdef ADD_USEC_TS
+	slot->usec = getCurrTimeUsec();
+#endif
+	size_t len = strnlen(msg, LOG_BUFFER_SIZE - 1);
+	memcpy(slot->message, msg, len);
+	slot->message[len] = 0;
+	slot->sequence.store(pos + 1, memory_order_release);
+	if (m_waiting)
+		m_cv.notify_one();
+	return true;
+}
+
+/**
+ * Write the oldest message in the ring buffer to syslog. Only called
+ * on one thread at a time.
+ *
+ * @return bool	False if there is no message ready to be written
+ */
+bool Logger::dequeue()
+{
+	size_t pos = m_tail.load(memory_order_relaxed);
+	LogSlot *slot = &m_ring[pos & (LOG_RING_SIZE - 1)];
+	if (slot->sequence.load(memory_order_acquire) != pos + 1)
+		return false;
+#ifdef ADD_USEC_TS
+	if (slot->priority == LOG_INFO || slot->priority == LOG_ERR)
+		syslog(slot->priority, "[.%06ld] %s: %s", slot->usec, slot->tag, slot->message);
+	else
+#endif
+	syslog(slot->priority, "%s: %s", slot->tag, slot->message);
+	slot->sequence.store(pos + LOG_RING_SIZE, memory_order_release);
+	m_tail.store(pos + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Format a message into a buffer of the calling thread and either
+ * write it to syslog or queue it for the background thread
+ *
+ * @param priority	The syslog priority of the message
+ * @param tag		The level tag, e.g. INFO
+ * @param msg		The printf style format of the message
+ * @param ap		The arguments of the message
+ */
+void Logger::log(int priority, const char *tag, const char *msg, va_list ap)
+{
+	static thread_local char buf[LOG_BUFFER_SIZE];
+
+	vsnprintf(buf, sizeof(buf), msg, ap);
+	if (m_async)
+	{
+		// Register as a producer before checking the mode again, so
+		// that setAsynchronous(false) either waits for this message
+		// to be queued or this message is written synchronously
+		m_producers++;
+		if (m_async && priority != LOG_CRIT)
+		{
+			enqueue(priority, tag, buf);
+			m_producers--;
+			return;
+		}
+		m_producers--;
+		if (priority == LOG_CRIT)
+		{
+			// The process may be about to exit, write all
+			// the buffered messages and this one now
+			flush();
+		}
+	}
+#ifdef ADD_USEC_TS
+	if (priority == LOG_INFO || priority == LOG_ERR)
+	{
+		syslog(priority, "[.%06ld] %s: %s", getCurrTimeUsec(), tag, buf);
+		return;
+	}
+#endif
+	syslog(priority, "%s: %s", tag, buf);
+}
+
 void Logger::debug(const string& msg, ...)
 {
-	if (m_level == LOG_ERR || m_level == LOG_WARNING || m_level == LOG_INFO)
+	if (m_level < LOG_DEBUG)
+	{
+		return;
+	}
+	va_list args;
+	va_start(args, msg);
+	log(LOG_DEBUG, "DEBUG", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::debug(const char *msg, ...)
+{
+	if (m_level < LOG_DEBUG)
 	{
 		return;
 	}
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_DEBUG, "DEBUG: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_DEBUG, "DEBUG", msg, args);
 	va_end(args);
 }
 
@@ -123,19 +391,25 @@ void Logger::printLongString(const string& s)
 
 void Logger::info(const string& msg, ...)
 {
-	if (m_level == LOG_ERR || m_level == LOG_WARNING)
+	if (m_level < LOG_INFO)
 	{
 		return;
 	}
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-	syslog(LOG_INFO, "[.%06ld] INFO: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-	syslog(LOG_INFO, "INFO: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_INFO, "INFO", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::info(const char *msg, ...)
+{
+	if (m_level < LOG_INFO)
+	{
+		return;
+	}
+	va_list args;
+	va_start(args, msg);
+	log(LOG_INFO, "INFO", msg, args);
 	va_end(args);
 }
 
@@ -143,9 +417,15 @@ void Logger::warn(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_WARNING, "WARNING: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_WARNING, "WARNING", msg.c_str(), args);
+	va_end(args);
+}
+
+void Logger::warn(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_WARNING, "WARNING", msg, args);
 	va_end(args);
 }
 
@@ -153,30 +433,30 @@ void Logger::error(const string& msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-#ifdef ADD_USEC_TS
-		syslog(LOG_ERR, "[.%06ld] ERROR: %s", getCurrTimeUsec(), fmt->c_str());
-#else
-		syslog(LOG_ERR, "ERROR: %s", fmt->c_str());
-#endif
-	delete fmt;
+	log(LOG_ERR, "ERROR", msg.c_str(), args);
 	va_end(args);
 }
 
-void Logger::fatal(const string& msg, ...)
+void Logger::error(const char *msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
-	string *fmt = format(msg, args);
-	syslog(LOG_CRIT, "FATAL: %s", fmt->c_str());
-	delete fmt;
+	log(LOG_ERR, "ERROR", msg, args);
 	va_end(args);
 }
 
-string *Logger::format( const std::string& format, va_list args)
+void Logger::fatal(const string& msg, ...)
 {
-char	buf[1000];
+	va_list args;
+	va_start(args, msg);
+	log(LOG_CRIT, "FATAL", msg.c_str(), args);
+	va_end(args);
+}
 
-	  vsnprintf(buf, sizeof(buf), format.c_str(), args);
-	  return new string(buf);
+void Logger::fatal(const char *msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	log(LOG_CRIT, "FATAL", msg, args);
+	va_end(args);
 }
@@ -8,6 +8,7 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <reading.h>
+#include <reading_arena.h>
 #include <ctime>
 #include <string>
 #include <sstream>
@@ -51,12 +52,8 @@ Reading::Reading(const string& asset, Datapoint *value) : m_asset(asset), m_has_
  * Each actual datavalue that relates to that asset is held within an
  * instance of a Datapoint class.
  */
-Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asset), m_has_id(false)
+Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asset), m_has_id(false), m_values(std::move(values))
 {
-	for (auto it = values.cbegin(); it != values.cend(); it++)
-	{
-		m_values.push_back(*it);
-	}
 	// Store seconds and microseconds
 	gettimeofday(&m_timestamp, NULL);
 	// Initialise m_userTimestamp
@@ -70,12 +67,8 @@ Reading::Reading(const string& asset, vector<Datapoint *> values) : m_asset(asse
  * Each actual datavalue that relates to that asset is held within an
  * instance of a Datapoint class.
  */
-Reading::Reading(const string& asset, vector<Datapoint *> values, const string& ts) : m_asset(asset), m_has_id(false)
+Reading::Reading(const string& asset, vector<Datapoint *> values, const string& ts) : m_asset(asset), m_has_id(false), m_values(std::move(values))
 {
-	for (auto it = values.cbegin(); it != values.cend(); it++)
-	{
-		m_values.push_back(*it);
-	}
 	stringToTimestamp(ts, &m_timestamp);
 	// Initialise m_userTimestamp
 	m_userTimestamp = m_timestamp;
@@ -98,26 +91,26 @@ Reading::Reading(const string& asset, const string& datapoints) : m_asset(asset)
 		{
 			long v = itr->value.GetInt64();
 			DatapointValue dpv(v);
-			m_values.push_back(new Datapoint(name, dpv));
+			m_values.push_back(new Datapoint(name, std::move(dpv)));
 		}
 		else if (itr->value.IsDouble())
 		{
 			double v = itr->value.GetDouble();
 			DatapointValue dpv(v);
-			m_values.push_back(new Datapoint(name, dpv));
+			m_values.push_back(new Datapoint(name, std::move(dpv)));
 		}
 		else if (itr->value.IsString())
 		{
 			string v = itr->value.GetString();
 			DatapointValue dpv(v);
-			m_values.push_back(new Datapoint(name, dpv));
+			m_values.push_back(new Datapoint(name, std::move(dpv)));
 		}
 		else if (itr->value.IsObject())
 		{
 			// Map objects as nested datapoints
 			vector<Datapoint *> *values = JSONtoDatapoints(itr->value);
 			DatapointValue dpv(values, true);
-			m_values.push_back(new Datapoint(name, dpv));
+			m_values.push_back(new Datapoint(name, std::move(dpv)));
 		}
 		else if (itr->value.IsArray())
 		{
@@ -131,7 +124,7 @@ Reading::Reading(const string& asset, const string& datapoints) : m_asset(asset)
 			}
 
 			DatapointValue dpv(arr);
-			m_values.emplace_back(new Datapoint(name, dpv));
+			m_values.emplace_back(new Datapoint(name, std::move(dpv)));
 		}
 	}
 	// Store seconds and microseconds
@@ -148,6 +141,7 @@ Reading::Reading(const Reading& orig) : m_asset(orig.m_asset),
 	m_userTimestamp(orig.m_userTimestamp),
 	m_has_id(orig.m_has_id), m_id(orig.m_id)
 {
+	m_values.reserve(orig.m_values.size());
 	for (auto it = orig.m_values.cbegin(); it != orig.m_values.cend(); it++)
 	{
 		m_values.emplace_back(new Datapoint(**it));
@@ -172,7 +166,10 @@ void Reading::removeAllDatapoints()
 {
 	for (auto it = m_values.cbegin(); it != m_values.cend(); it++)
 	{
-		delete(*it);
+		if (m_arena)
+			ReadingArena::deleteDatapoint(this, *it);
+		else
+			delete(*it);
 	}
 	m_values.clear();
 }
@@ -201,6 +198,8 @@ Datapoint *rval;
 		{
 			rval = *it;
 			m_values.erase(it);
+			if (m_arena)
+				rval = ReadingArena::removeDatapoint(this, rval);
 			return rval;
 		}
 	}
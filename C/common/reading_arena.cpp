@@ -0,0 +1,373 @@
+/*
+ * Fledge reading arena allocator
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_arena.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+/**
+ * The alignment of every object carved from a chunk, suitable for any type
+ */
+#define ARENA_ALIGN	alignof(max_align_t)
+
+static_assert((ARENA_ALIGN & (ARENA_ALIGN - 1)) == 0, "arenaRound requires the alignment to be a power of two");
+
+/**
+ * Round a size up to a multiple of the alignment so that each
+ * object in a chunk starts suitably aligned
+ */
+static inline size_t arenaRound(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+/**
+ * Chunks of arenas that have been disposed of, kept to be reused by new
+ * arenas rather than returned to the heap. A chunk is taken or returned
+ * once for every chunk of readings, not for every reading.
+ */
+static mutex		spareMutex;
+static vector<void *>	spareChunks;
+
+/**
+ * Allocate a chunk, reusing a spare chunk if there is one
+ *
+ * @return	The chunk
+ */
+static void *allocateChunk()
+{
+	{
+		lock_guard<mutex> guard(spareMutex);
+		if (!spareChunks.empty())
+		{
+			void *chunk = spareChunks.back();
+			spareChunks.pop_back();
+			return chunk;
+		}
+	}
+	void *chunk = malloc(ARENA_CHUNK_SIZE);
+	if (!chunk)
+		throw bad_alloc();
+	return chunk;
+}
+
+/**
+ * Free a chunk, keeping it as a spare unless there are enough spares
+ *
+ * @param chunk	The chunk to free
+ */
+static void freeChunk(void *chunk)
+{
+	{
+		lock_guard<mutex> guard(spareMutex);
+		if (spareChunks.size() < ARENA_SPARE_CHUNKS)
+		{
+			spareChunks.push_back(chunk);
+			return;
+		}
+	}
+	free(chunk);
+}
+
+thread_local ReadingArena::Current ReadingArena::m_current;
+
+/**
+ * The thread has exited, seal the arena it was copying readings into
+ */
+ReadingArena::Current::~Current()
+{
+	if (m_arena)
+		m_arena->seal();
+}
+
+/**
+ * Construct the arena in its first chunk, the objects are
+ * carved from the remainder of the chunk
+ *
+ * @param chunk	The first chunk of the arena
+ */
+ReadingArena::ReadingArena(Chunk *chunk) : m_chunks(chunk), m_allocated(0), m_live(0)
+{
+	chunk->m_next = NULL;
+	size_t header = arenaRound(sizeof(Chunk)) + arenaRound(sizeof(ReadingArena));
+	m_next = (char *)chunk + header;
+	m_remaining = ARENA_CHUNK_SIZE - header;
+}
+
+/**
+ * Allocate a new arena, the arena is held in its first chunk
+ *
+ * @return	The new arena
+ */
+ReadingArena *ReadingArena::create()
+{
+	Chunk *chunk = (Chunk *)allocateChunk();
+	return new ((char *)chunk + arenaRound(sizeof(Chunk))) ReadingArena(chunk);
+}
+
+/**
+ * Carve memory for an object from the arena, adding a chunk
+ * to the arena if there is not enough room in the current one
+ *
+ * @param size	The size of the object
+ * @return	The memory for the object
+ */
+void *ReadingArena::allocate(size_t size)
+{
+	size = arenaRound(size);
+	if (size > m_remaining)
+	{
+		size_t header = arenaRound(sizeof(Chunk));
+		if (size > ARENA_CHUNK_SIZE - header)
+			throw bad_alloc();
+		Chunk *chunk = (Chunk *)allocateChunk();
+		chunk->m_next = m_chunks;
+		m_chunks = chunk;
+		m_next = (char *)chunk + header;
+		m_remaining = ARENA_CHUNK_SIZE - header;
+	}
+	void *rval = m_next;
+	m_next += size;
+	m_remaining -= size;
+	return rval;
+}
+
+/**
+ * Copy a reading, and its datapoints, into the arena of the calling
+ * thread. The copy must be deleted with destroy().
+ *
+ * The reading is preceded by a header that records the number of
+ * datapoints copied, the datapoints follow the reading. A reading with
+ * too many datapoints to fit in a chunk is copied to the heap.
+ *
+ * @param reading	The reading to copy
+ * @return		The copy of the reading
+ */
+Reading *ReadingArena::copy(const Reading& reading)
+{
+	size_t count = reading.m_values.size();
+	size_t size = arenaRound(sizeof(Header)) + arenaRound(sizeof(Reading))
+			+ count * arenaRound(sizeof(Datapoint));
+	if (size > ARENA_CHUNK_SIZE - arenaRound(sizeof(Chunk)))
+		return new Reading(reading);
+
+	ReadingArena *arena = m_current.m_arena;
+	if (!arena || arena->m_allocated >= ARENA_BLOCK_READINGS)
+	{
+		if (arena)
+			arena->seal();
+		arena = create();
+		m_current.m_arena = arena;
+	}
+	char *block = (char *)arena->allocate(size);
+	Header *header = (Header *)block;
+	header->m_datapoints = count;
+	block += arenaRound(sizeof(Header));
+	Reading *rval = new (block) Reading();
+	rval->m_id = reading.m_id;
+	rval->m_has_id = reading.m_has_id;
+	rval->m_asset = reading.m_asset;
+	rval->m_timestamp = reading.m_timestamp;
+	rval->m_userTimestamp = reading.m_userTimestamp;
+	rval->m_values.reserve(count);
+	block += arenaRound(sizeof(Reading));
+	for (auto& datapoint : reading.m_values)
+	{
+		rval->m_values.emplace_back(new (block) Datapoint(*datapoint));
+		block += arenaRound(sizeof(Datapoint));
+	}
+	rval->m_arena = arena;
+	arena->m_allocated++;
+	return rval;
+}
+
+/**
+ * Check if a datapoint of a reading is one of those copied into the
+ * arena with the reading, rather than one added later from the heap
+ *
+ * @param reading	The reading
+ * @param datapoint	The datapoint of the reading
+ * @return		True if the datapoint is held in the arena
+ */
+bool ReadingArena::holds(const Reading *reading, const Datapoint *datapoint)
+{
+	if (!reading->m_arena)
+		return false;
+	uintptr_t first = (uintptr_t)reading + arenaRound(sizeof(Reading));
+	const Header *header = (const Header *)((const char *)reading - arenaRound(sizeof(Header)));
+	uintptr_t end = first + header->m_datapoints * arenaRound(sizeof(Datapoint));
+	return (uintptr_t)datapoint >= first && (uintptr_t)datapoint < end;
+}
+
+/**
+ * Delete a datapoint of a reading, running only the destructor of
+ * a datapoint held in the arena
+ *
+ * @param reading	The reading the datapoint belongs to
+ * @param datapoint	The datapoint to delete
+ */
+void ReadingArena::deleteDatapoint(const Reading *reading, Datapoint *datapoint)
+{
+	if (holds(reading, datapoint))
+		datapoint->~Datapoint();
+	else
+		delete datapoint;
+}
+
+/**
+ * A datapoint has been removed from a reading and is given to the
+ * caller, who may delete it. A datapoint held in the arena is replaced
+ * by a copy from the heap.
+ *
+ * @param reading	The reading the datapoint was removed from
+ * @param datapoint	The datapoint removed
+ * @return		A datapoint that may be deleted with delete
+ */
+Datapoint *ReadingArena::removeDatapoint(const Reading *reading, Datapoint *datapoint)
+{
+	if (!holds(reading, datapoint))
+		return datapoint;
+	Datapoint *copy = new Datapoint(*datapoint);
+	datapoint->~Datapoint();
+	return copy;
+}
+
+/**
+ * Take a reading out of its arena, for code that may modify or delete
+ * the reading. A reading held in an arena is replaced by a copy from the
+ * heap, a reading that is already on the heap is returned as is.
+ *
+ * @param reading	The reading to take out of the arena
+ * @return		A reading that may be deleted with delete
+ */
+Reading *ReadingArena::copyOut(Reading *reading)
+{
+	if (!reading->m_arena)
+		return reading;
+	Reading *copy = new Reading(*reading);
+	destroy(reading);
+	return copy;
+}
+
+/**
+ * Run the destructors of a reading held in the arena and of its
+ * datapoints, the memory is returned when the arena is disposed of.
+ * Datapoints added to the reading from the heap are deleted.
+ *
+ * @param reading	The reading to destruct
+ */
+void ReadingArena::destruct(Reading *reading)
+{
+	for (auto& datapoint : reading->m_values)
+		deleteDatapoint(reading, datapoint);
+	reading->m_values.clear();
+	reading->~Reading();
+}
+
+/**
+ * Delete a reading that may have been copied into an arena. A reading
+ * allocated from the heap is simply deleted.
+ *
+ * @param reading	The reading to delete
+ */
+void ReadingArena::destroy(Reading *reading)
+{
+	if (!reading)
+		return;
+	ReadingArena *arena = reading->m_arena;
+	if (!arena)
+	{
+		delete reading;
+		return;
+	}
+	arena->destruct(reading);
+	arena->release(1);
+}
+
+/**
+ * Delete a block of readings, any of which may have been copied into
+ * an arena. The readings of an arena are released together, consecutive
+ * readings are usually held in the same arena. The vector is cleared.
+ *
+ * @param readings	The readings to delete
+ */
+void ReadingArena::destroy(vector<Reading *>& readings)
+{
+	ReadingArena *arena = NULL;
+	long count = 0;
+	for (auto& reading : readings)
+	{
+		ReadingArena *readingArena = reading->m_arena;
+		if (!readingArena)
+		{
+			delete reading;
+			continue;
+		}
+		if (readingArena != arena)
+		{
+			if (arena)
+				arena->release(count);
+			arena = readingArena;
+			count = 0;
+		}
+		arena->destruct(reading);
+		count++;
+	}
+	if (arena)
+		arena->release(count);
+	readings.clear();
+}
+
+/**
+ * The thread has moved on to another arena, add the number of readings
+ * copied to the live count. If all the readings have already been
+ * destroyed the arena is disposed of now, otherwise it is disposed of
+ * when the last reading is destroyed.
+ *
+ * Before the arena is sealed the live count can only be zero or negative,
+ * so a release can never see it reach zero until the readings copied
+ * have been added.
+ */
+void ReadingArena::seal()
+{
+	if (m_live.fetch_add(m_allocated) + m_allocated == 0)
+		dispose();
+}
+
+/**
+ * Readings copied into the arena have been destroyed
+ *
+ * @param readings	The number of readings destroyed
+ */
+void ReadingArena::release(long readings)
+{
+	if (m_live.fetch_sub(readings) - readings == 0)
+		dispose();
+}
+
+/**
+ * Return all the chunks of the arena, the arena itself is
+ * held in the last of them
+ */
+void ReadingArena::dispose()
+{
+	Chunk *chunk = m_chunks;
+	this->~ReadingArena();
+	while (chunk)
+	{
+		Chunk *next = chunk->m_next;
+		freeChunk(chunk);
+		chunk = next;
+	}
+}
@@ -8,13 +8,17 @@
  * Author: Mark Riddoch, Massimiliano Pinto
  */
 #include <reading_set.h>
+#include <reading_set_handler.h>
 #include <string>
 #include <rapidjson/document.h>
+#include <rapidjson/reader.h>
 #include <sstream>
 #include <iostream>
 #include <time.h>
 #include <stdlib.h>
 #include <logger.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
 #include <base64databuffer.h>
 #include <base64dpimage.h>
 
@@ -70,10 +74,26 @@ ReadingSet::ReadingSet(const vector<Reading *>* readings) : m_last_id(0)
  * this call is destructive to this string and the conntents
  * of the string should not be used after making this call.
  *
+ * By default the readings are built by a streaming parser directly
+ * from the JSON text, the document parser may be requested in order
+ * to build the complete document before the readings are created.
+ *
  * @param json	The JSON document (as string) with readings data
+ * @param parser	The parser to use to build the readings
  */
-ReadingSet::ReadingSet(const std::string& json) : m_last_id(0)
+ReadingSet::ReadingSet(const std::string& json, readingSetParser parser) : m_last_id(0)
 {
+	if (parser == PARSE_STREAM)
+	{
+		parseStream(json);
+		return;
+	}
+	if (parser == PARSE_BINARY)
+	{
+		parseBinary(json);
+		return;
+	}
+
 	unsigned long rows = 0;
 	Document doc;
 	doc.ParseInsitu((char *)json.c_str());	// Cast away const in order to use in-situ
@@ -149,6 +169,162 @@ ReadingSet::ReadingSet(const std::string& json) : m_last_id(0)
 	}
 }
 
+/**
+ * Build the readings from the JSON document returned by the storage
+ * service using the streaming rapidjson parser. The readings are created
+ * as the JSON text is parsed, avoiding the memory and time required to
+ * build the document. The rules are the same as those of the document
+ * based parser.
+ *
+ * @param json	The JSON document (as string) with readings data
+ */
+void ReadingSet::parseStream(const std::string& json)
+{
+	ReadingSetHandler handler;
+	{
+		Reader reader;
+		InsituStringStream stream((char *)json.c_str());	// Cast away const in order to use in-situ
+		if (reader.Parse<kParseInsituFlag>(stream, handler).IsError())
+		{
+			if (handler.getError().empty())
+			{
+				throw new ReadingSetException("Unable to parse results json document");
+			}
+			throw new ReadingSetException(handler.getError().c_str());
+		}
+	}
+
+	// Check we have "rows" or "readings"
+	if (!handler.hasRows() && !handler.hasReadings())
+	{
+		throw new ReadingSetException("Missing readings or rows array");
+	}
+
+	// Check we have "count" and "rows"
+	if (handler.hasCount() && handler.hasRows())
+	{
+		m_count = handler.getCount();
+		// No readings
+		if (!m_count)
+		{
+			m_last_id = 0;
+			return;
+		}
+	}
+	else
+	{
+		m_count = 0;
+		m_last_id = 0;
+	}
+
+	if (!handler.isArray())
+	{
+		throw new ReadingSetException("Expected array of rows in result set");
+	}
+	handler.moveReadings(m_readings);
+	if (!m_readings.empty())
+	{
+		m_last_id = m_readings.back()->getId();
+	}
+
+	// We don't have count informations with "readings"
+	if (handler.hasReadings())
+	{
+		m_count = m_readings.size();
+	}
+}
+
+/**
+ * Create the readings from the binary form of a reading fetch, as
+ * described in reading_stream.h. Readings with binary payloads are
+ * decoded directly to datapoints, any other readings carry the JSON
+ * text of their datapoints.
+ *
+ * @param payload	The binary result of the reading fetch
+ */
+void ReadingSet::parseBinary(const std::string& payload)
+{
+	const char *ptr = payload.data();
+	const char *end = ptr + payload.length();
+	RDSFetchHeader header;
+
+	m_count = 0;
+	m_last_id = 0;
+	if (payload.length() < sizeof(header))
+	{
+		throw new ReadingSetException("Binary reading set is too short");
+	}
+	memcpy(&header, ptr, sizeof(header));
+	ptr += sizeof(header);
+	if (header.magic != RDS_FETCH_MAGIC)
+	{
+		throw new ReadingSetException("Binary reading set has an invalid header");
+	}
+
+	m_readings.reserve(header.count);
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		RDSFetchReading row;
+		if (end - ptr < (ptrdiff_t)sizeof(row))
+		{
+			throw new ReadingSetException("Binary reading set is truncated");
+		}
+		memcpy(&row, ptr, sizeof(row));
+		ptr += sizeof(row);
+		if ((size_t)(end - ptr) < (size_t)row.assetLength + row.userTsLength
+						+ row.tsLength + row.payloadLength)
+		{
+			throw new ReadingSetException("Binary reading set is truncated");
+		}
+		string asset(ptr, row.assetLength);
+		ptr += row.assetLength;
+		string userTs(ptr, row.userTsLength);
+		ptr += row.userTsLength;
+		string ts(ptr, row.tsLength);
+		ptr += row.tsLength;
+		const char *data = ptr;
+		ptr += row.payloadLength;
+
+		vector<Datapoint *> *datapoints = NULL;
+		if (row.payloadLength && RDS_PAYLOAD_IS_BINARY(data))
+		{
+			datapoints = ReadingStreamPayload::toDatapoints(data, row.payloadLength);
+		}
+		Reading *reading;
+		if (datapoints)
+		{
+			reading = new Reading(asset, *datapoints);
+			delete datapoints;
+		}
+		else
+		{
+			// Not held in binary, parse the JSON datapoints as a JSON reading would be
+			Document doc;
+			string json(data, row.payloadLength);
+			doc.SetObject();
+			Document::AllocatorType& allocator = doc.GetAllocator();
+			Document values(&allocator);
+			if (values.Parse(json.c_str()).HasParseError() || !values.IsObject())
+			{
+				throw new ReadingSetException("Unable to parse reading in binary reading set");
+			}
+			doc.AddMember("asset_code", Value(asset.c_str(), allocator), allocator);
+			doc.AddMember("user_ts", Value(userTs.c_str(), allocator), allocator);
+			doc.AddMember("reading", values, allocator);
+			reading = new JSONReading(doc);
+		}
+		reading->setId(row.id);
+		reading->setUserTimestamp(userTs);
+		reading->setTimestamp(ts);
+		m_readings.push_back(reading);
+	}
+	m_count = m_readings.size();
+	if (!m_readings.empty())
+	{
+		m_last_id = m_readings.back()->getId();
+	}
+}
+
 /**
  * Destructor for a result set
  */
@@ -468,7 +644,11 @@ JSONReading::JSONReading(const Value& json)
 			// Add 'reading' values
 			for (auto &m : json["reading"].GetObject())
 			{
-				addDatapoint(datapoint(m.name.GetString(), m.value));
+				Datapoint *dp = datapoint(m.name.GetString(), m.value);
+				if (dp)
+				{
+					addDatapoint(dp);
+				}
 			}
 		}
 		else
@@ -553,7 +733,7 @@ Datapoint *rval = NULL;
 					try {
 						DataBuffer *databuffer = new Base64DataBuffer(str.substr(pos + 1));
 						DatapointValue value(databuffer);
-						rval = new Datapoint(name, value);
+						rval = new Datapoint(name, std::move(value));
 					} catch (exception& e) {
 						Logger::getLogger()->error("Unable to create datapoint %s as the base 64 encoded data is incorrect, %s",
 								name.c_str(), e.what());
@@ -564,7 +744,7 @@ Datapoint *rval = NULL;
 					try {
 						DPImage *image = new Base64DPImage(str.substr(pos + 1));
 						DatapointValue value(image);
-						rval = new Datapoint(name, value);
+						rval = new Datapoint(name, std::move(value));
 					} catch (exception& e) {
 						Logger::getLogger()->error("Unable to create datapoint %s as the base 64 encoded data is incorrect, %s",
 								name.c_str(), e.what());
@@ -575,7 +755,7 @@ Datapoint *rval = NULL;
 			else
 			{
 				DatapointValue value(item.GetString());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 			}
 			break;
 		}
@@ -586,31 +766,31 @@ Datapoint *rval = NULL;
 			if (item.IsInt())
 			{
 				DatapointValue value((long)item.GetInt());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 				break;
 			}
 			else if (item.IsUint())
 			{
 				DatapointValue value((long)item.GetUint());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 				break;
 			}
 			else if (item.IsInt64())
 			{
 				DatapointValue value((long)item.GetInt64());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 				break;
 			}
 			else if (item.IsUint64())
 			{
 				DatapointValue value((long)item.GetUint64());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 				break;
 			}
 			else if (item.IsDouble())
 			{
 				DatapointValue value(item.GetDouble());
-				rval = new Datapoint(name, value);
+				rval = new Datapoint(name, std::move(value));
 				break;
 			}
 			else
@@ -647,7 +827,7 @@ Datapoint *rval = NULL;
 				}
 			}
 			DatapointValue value(arrayValues);
-			rval = new Datapoint(name, value);
+			rval = new Datapoint(name, std::move(value));
 			break;
 			    
 		}
@@ -665,20 +845,20 @@ Datapoint *rval = NULL;
 				}
 			}
 			DatapointValue value(obj, true);
-			rval = new Datapoint(name, value);
+			rval = new Datapoint(name, std::move(value));
 			break;
 		}
 
 		case kTrueType:
 		{
 			DatapointValue value("true");
-			rval = new Datapoint(name, value);
+			rval = new Datapoint(name, std::move(value));
 			break;
 		}
 		case kFalseType:
 		{
 			DatapointValue value("false");
-			rval = new Datapoint(name, value);
+			rval = new Datapoint(name, std::move(value));
 			break;
 		}
 
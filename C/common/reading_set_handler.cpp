@@ -0,0 +1,461 @@
+/*
+ * Fledge SAX reading set handler.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_set_handler.h>
+#include <logger.h>
+#include <string.h>
+
+#define ASSET_NAME_INVALID_READING "error_invalid_reading"
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Construct the handler for a storage service response
+ */
+ReadingSetHandler::ReadingSetHandler() : m_skip(0), m_key(NULL),
+	m_hasRows(false), m_hasReadings(false), m_hasCount(false),
+	m_rowsArray(false), m_readingsArray(false), m_inRows(false), m_count(0),
+	m_reading(NULL), m_userTs(NULL), m_ts(NULL), m_hasAsset(false),
+	m_hasReadingMember(false), m_hasReadingObject(false)
+{
+}
+
+/**
+ * Destroy the handler, deleting any readings that have not been
+ * moved out of it. This cleans up after a parse that failed.
+ */
+ReadingSetHandler::~ReadingSetHandler()
+{
+	for (auto& frame : m_stack)
+	{
+		if (frame.type == FrameDatapoints && frame.datapoints != &m_datapoints)
+		{
+			for (auto dp : *frame.datapoints)
+			{
+				delete dp;
+			}
+			delete frame.datapoints;
+		}
+	}
+	for (auto dp : m_datapoints)
+	{
+		delete dp;
+	}
+	delete m_reading;
+	for (auto reading : m_rows)
+	{
+		delete reading;
+	}
+	for (auto reading : m_readings)
+	{
+		delete reading;
+	}
+}
+
+/**
+ * Record an error and stop the parse
+ *
+ * @param error	The reason the parse failed
+ * @return bool	Always false
+ */
+bool ReadingSetHandler::fail(const string& error)
+{
+	m_error = error;
+	return false;
+}
+
+/**
+ * Return true if the rows, or readings, of the response were
+ * held in an array
+ */
+bool ReadingSetHandler::isArray() const
+{
+	return m_hasRows ? m_rowsArray : m_readingsArray;
+}
+
+/**
+ * Move the readings out of the handler. The rows of a query are
+ * used in preference to the readings of a notification.
+ *
+ * @param readings	The vector to append the readings to
+ */
+void ReadingSetHandler::moveReadings(vector<Reading *>& readings)
+{
+	vector<Reading *>& source = m_hasRows ? m_rows : m_readings;
+	readings.insert(readings.end(), source.begin(), source.end());
+	source.clear();
+}
+
+/**
+ * Add a datapoint to the datapoint object being built
+ *
+ * @param datapoint	The datapoint to add, this may be NULL
+ */
+void ReadingSetHandler::addDatapoint(Datapoint *datapoint)
+{
+	if (datapoint)
+	{
+		m_stack.back().datapoints->push_back(datapoint);
+	}
+}
+
+/**
+ * Handle a key of an object
+ */
+bool ReadingSetHandler::Key(const char *str, SizeType /*length*/, bool /*copy*/)
+{
+	if (m_skip == 0)
+	{
+		m_key = str;
+	}
+	return true;
+}
+
+/**
+ * Handle a string value
+ */
+bool ReadingSetHandler::String(const char *str, SizeType length, bool /*copy*/)
+{
+	return scalar(Value(StringRef(str, length)));
+}
+
+/**
+ * Handle a scalar value, the meaning of the value depends upon the
+ * container it is in and the key it has
+ *
+ * @param value	The value, strings refer to the JSON text
+ * @return bool	False if the parse should stop
+ */
+bool ReadingSetHandler::scalar(Value&& value)
+{
+	if (m_skip)
+	{
+		return true;
+	}
+	if (m_stack.empty())
+	{
+		return fail("Missing readings or rows array");
+	}
+
+	Frame& frame = m_stack.back();
+	switch (frame.type)
+	{
+		case FrameDocument:
+			if (strcmp(m_key, "count") == 0 && value.IsUint())
+			{
+				m_hasCount = true;
+				m_count = value.GetUint();
+			}
+			else if (strcmp(m_key, "rows") == 0)
+			{
+				m_hasRows = true;
+			}
+			else if (strcmp(m_key, "readings") == 0)
+			{
+				m_hasReadings = true;
+			}
+			break;
+		case FrameRows:
+			return fail("Expected reading to be an object");
+		case FrameReading:
+			if (strcmp(m_key, "id") == 0)
+			{
+				m_reading->m_id = value.GetUint64();
+				m_reading->m_has_id = true;
+			}
+			else if (strcmp(m_key, "asset_code") == 0)
+			{
+				m_reading->m_asset = value.GetString();
+				m_hasAsset = true;
+			}
+			else if (strcmp(m_key, "user_ts") == 0)
+			{
+				m_userTs = value.GetString();
+			}
+			else if (strcmp(m_key, "ts") == 0)
+			{
+				m_ts = value.GetString();
+			}
+			else if (strcmp(m_key, "value") == 0 && value.IsNumber())
+			{
+				m_value = value;
+			}
+			else if (strcmp(m_key, "reading") == 0)
+			{
+				m_hasReadingMember = true;
+				m_readingValue = value;
+			}
+			break;
+		case FrameDatapoints:
+			addDatapoint(m_reading->datapoint(m_key, value));
+			break;
+		case FrameArray:
+			if (value.IsDouble())
+			{
+				frame.values.push_back(value.GetDouble());
+			}
+			else if (value.IsInt() || value.IsUint())
+			{
+				frame.values.push_back((double)value.GetInt());
+			}
+			else if (value.IsInt64() || value.IsUint64())
+			{
+				frame.values.push_back((double)value.GetInt64());
+			}
+			break;
+	}
+	return true;
+}
+
+/**
+ * Handle the start of an object
+ */
+bool ReadingSetHandler::StartObject()
+{
+	return container(true);
+}
+
+/**
+ * Handle the start of an array
+ */
+bool ReadingSetHandler::StartArray()
+{
+	return container(false);
+}
+
+/**
+ * Handle the start of an object or array. Containers that are not
+ * part of the readings are skipped.
+ *
+ * @param object	True for an object, false for an array
+ * @return bool		False if the parse should stop
+ */
+bool ReadingSetHandler::container(bool object)
+{
+	if (m_skip)
+	{
+		m_skip++;
+		return true;
+	}
+	if (m_stack.empty())
+	{
+		if (!object)
+		{
+			return fail("Missing readings or rows array");
+		}
+		m_stack.push_back(Frame(FrameDocument));
+		return true;
+	}
+
+	Frame& frame = m_stack.back();
+	switch (frame.type)
+	{
+		case FrameDocument:
+			if (strcmp(m_key, "rows") == 0 || strcmp(m_key, "readings") == 0)
+			{
+				m_inRows = m_key[0] == 'r' && m_key[1] == 'o';
+				(m_inRows ? m_hasRows : m_hasReadings) = true;
+				if (!object)
+				{
+					(m_inRows ? m_rowsArray : m_readingsArray) = true;
+					m_stack.push_back(Frame(FrameRows));
+					return true;
+				}
+			}
+			m_skip = 1;
+			break;
+		case FrameRows:
+			if (!object)
+			{
+				return fail("Expected reading to be an object");
+			}
+			m_reading = new JSONReading();
+			m_reading->m_id = 0;
+			m_reading->m_has_id = false;
+			m_userTs = NULL;
+			m_ts = NULL;
+			m_hasAsset = false;
+			m_value.SetNull();
+			m_readingValue.SetNull();
+			m_hasReadingMember = false;
+			m_hasReadingObject = false;
+			m_stack.push_back(Frame(FrameReading));
+			break;
+		case FrameReading:
+			if (strcmp(m_key, "reading") == 0)
+			{
+				m_hasReadingMember = true;
+				if (object)
+				{
+					m_hasReadingObject = true;
+					Frame datapoints(FrameDatapoints);
+					datapoints.datapoints = &m_datapoints;
+					m_stack.push_back(datapoints);
+					break;
+				}
+			}
+			m_skip = 1;
+			break;
+		case FrameDatapoints:
+		{
+			Frame datapoint(object ? FrameDatapoints : FrameArray, m_key);
+			if (object)
+			{
+				datapoint.datapoints = new vector<Datapoint *>;
+			}
+			m_stack.push_back(datapoint);
+			break;
+		}
+		case FrameArray:
+			// Only arrays of numbers are supported
+			m_skip = 1;
+			break;
+	}
+	return true;
+}
+
+/**
+ * Handle the end of an object
+ */
+bool ReadingSetHandler::EndObject(SizeType /*memberCount*/)
+{
+	if (m_skip)
+	{
+		m_skip--;
+		return true;
+	}
+
+	Frame frame = std::move(m_stack.back());
+	m_stack.pop_back();
+	switch (frame.type)
+	{
+		case FrameReading:
+			return endReading();
+		case FrameDatapoints:
+			if (frame.datapoints != &m_datapoints)
+			{
+				DatapointValue value(frame.datapoints, true);
+				addDatapoint(new Datapoint(frame.name, std::move(value)));
+			}
+			break;
+		default:
+			break;
+	}
+	return true;
+}
+
+/**
+ * Handle the end of an array
+ */
+bool ReadingSetHandler::EndArray(SizeType /*elementCount*/)
+{
+	if (m_skip)
+	{
+		m_skip--;
+		return true;
+	}
+
+	Frame frame = std::move(m_stack.back());
+	m_stack.pop_back();
+	if (frame.type == FrameArray)
+	{
+		DatapointValue value(frame.values);
+		addDatapoint(new Datapoint(frame.name, std::move(value)));
+	}
+	return true;
+}
+
+/**
+ * Complete the reading whose object has just ended. This follows the
+ * rules of the JSONReading constructor, a numeric "value" property is
+ * used in preference to the "reading" object and a "reading" that is not
+ * an object is reported as an invalid reading.
+ *
+ * @return bool	False if the parse should stop
+ */
+bool ReadingSetHandler::endReading()
+{
+	JSONReading *reading = m_reading;
+
+	if (!m_hasAsset)
+	{
+		return fail("Malformed JSON reading, missing asset_code 'value'");
+	}
+	if (!m_userTs)
+	{
+		return fail("Malformed JSON reading, missing user timestamp 'value'");
+	}
+	reading->stringToTimestamp(m_userTs, &reading->m_userTimestamp);
+	if (m_ts)
+	{
+		reading->stringToTimestamp(m_ts, &reading->m_timestamp);
+	}
+	else
+	{
+		reading->m_timestamp = reading->m_userTimestamp;
+	}
+
+	if (m_value.IsNumber())
+	{
+		for (auto dp : m_datapoints)
+		{
+			delete dp;
+		}
+		if (m_value.IsInt() || m_value.IsUint())
+		{
+			reading->addDatapoint(new Datapoint("value", DatapointValue((long)m_value.GetInt())));
+		}
+		else if (m_value.IsInt64() || m_value.IsUint64())
+		{
+			reading->addDatapoint(new Datapoint("value", DatapointValue((long)m_value.GetInt64())));
+		}
+		else
+		{
+			reading->addDatapoint(new Datapoint("value", DatapointValue(m_value.GetDouble())));
+		}
+	}
+	else if (m_hasReadingObject)
+	{
+		for (auto dp : m_datapoints)
+		{
+			reading->addDatapoint(dp);
+		}
+	}
+	else if (m_hasReadingMember)
+	{
+		if (m_readingValue.IsString())
+		{
+			string value = m_readingValue.GetString();
+			reading->escapeCharacter(value, "\\");
+			reading->escapeCharacter(value, "\"");
+
+			Logger::getLogger()->error(
+				"Invalid reading: Asset name |%s| reading value |%s| converted value |%s|",
+				reading->m_asset.c_str(),
+				m_readingValue.GetString(),
+				value.c_str());
+			reading->addDatapoint(new Datapoint(reading->m_asset, DatapointValue(value)));
+		}
+		else if (m_readingValue.IsNumber())
+		{
+			reading->addDatapoint(reading->datapoint(reading->m_asset, m_readingValue));
+		}
+		reading->m_asset = string(ASSET_NAME_INVALID_READING) + string("_") + reading->m_asset;
+	}
+	else
+	{
+		Logger::getLogger()->error("Missing reading property for JSON reading, %s", reading->m_asset.c_str());
+	}
+	m_datapoints.clear();
+
+	(m_inRows ? m_rows : m_readings).push_back(reading);
+	m_reading = NULL;
+	return true;
+}
@@ -0,0 +1,1168 @@
+/*
+ * Fledge storage reading stream binary payload encoding.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_stream_payload.h>
+#include <base64dpimage.h>
+#include <base64databuffer.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+using namespace std;
+
+/**
+ * Convert a fixed width value between host and payload byte order,
+ * fixed width values are held little endian in the payload
+ *
+ * @param value		The value to convert
+ * @return T		The converted value
+ */
+template<class T> static inline T littleEndian(T value)
+{
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	char *p = (char *)&value;
+	for (size_t i = 0; i < sizeof(T) / 2; i++)
+	{
+		char c = p[i];
+		p[i] = p[sizeof(T) - 1 - i];
+		p[sizeof(T) - 1 - i] = c;
+	}
+#endif
+	return value;
+}
+
+/**
+ * A cursor over a binary payload that bounds checks every
+ * access, a truncated or corrupt payload results in a failed
+ * get rather than a read past the end of the payload.
+ *
+ * The cursor decodes lengths and integers according to the version
+ * of the payload, found by checkHeader.
+ */
+class PayloadCursor {
+	public:
+		PayloadCursor(const char *payload, size_t length) :
+				m_ptr(payload), m_end(payload + length),
+				m_version(RDS_BINARY_PAYLOAD_VERSION)
+		{
+		};
+		template<class T> bool	get(T& value)
+		{
+			if (m_end - m_ptr < (ptrdiff_t)sizeof(T))
+				return false;
+			memcpy(&value, m_ptr, sizeof(T));
+			value = littleEndian(value);
+			m_ptr += sizeof(T);
+			return true;
+		};
+		bool			get(const char **ptr, uint32_t length)
+		{
+			if ((size_t)(m_end - m_ptr) < length)
+				return false;
+			*ptr = m_ptr;
+			m_ptr += length;
+			return true;
+		};
+		bool			skip(size_t length)
+		{
+			if ((size_t)(m_end - m_ptr) < length)
+				return false;
+			m_ptr += length;
+			return true;
+		};
+		/**
+		 * Get a count or length, a varint in version 2 payloads
+		 */
+		bool			getLength(uint32_t& value)
+		{
+			if (m_version == 1)
+				return get(value);
+			uint64_t v;
+			if (!getVarint(v) || v > UINT32_MAX)
+				return false;
+			value = (uint32_t)v;
+			return true;
+		};
+		/**
+		 * Get an integer value, a zigzag encoded varint in version 2 payloads
+		 */
+		bool			getInteger(int64_t& value)
+		{
+			if (m_version == 1)
+				return get(value);
+			uint64_t v;
+			if (!getVarint(v))
+				return false;
+			value = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+			return true;
+		};
+		void			setVersion(uint8_t version)
+		{
+			m_version = version;
+		};
+	private:
+		bool			getVarint(uint64_t& value)
+		{
+			value = 0;
+			for (int shift = 0; shift < 64 && m_ptr < m_end; shift += 7)
+			{
+				uint8_t byte = (uint8_t)*m_ptr++;
+				value |= (uint64_t)(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0)
+					return true;
+			}
+			return false;
+		};
+		const char	*m_ptr;
+		const char	*m_end;
+		uint8_t		m_version;
+};
+
+/**
+ * Append a fixed width value, little endian, to the payload
+ *
+ * @param payload	The payload to append to
+ * @param value		The value to append
+ */
+template<class T> static void put(string& payload, T value)
+{
+	value = littleEndian(value);
+	payload.append((const char *)&value, sizeof(T));
+}
+
+/**
+ * Append an unsigned varint to the payload, seven bits per byte with
+ * the top bit set on all but the last byte
+ *
+ * @param payload	The payload to append to
+ * @param value		The value to append
+ */
+static void putVarint(string& payload, uint64_t value)
+{
+	while (value >= 0x80)
+	{
+		payload += (char)((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	payload += (char)value;
+}
+
+/**
+ * Append a count or length to the payload
+ *
+ * @param payload	The payload to append to
+ * @param value		The count or length
+ */
+static inline void putLength(string& payload, size_t value)
+{
+	putVarint(payload, value);
+}
+
+/**
+ * Append an integer value to the payload, zigzag encoded so that
+ * small negative values are also short
+ *
+ * @param payload	The payload to append to
+ * @param value		The value to append
+ */
+static inline void putInteger(string& payload, int64_t value)
+{
+	putVarint(payload, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * Append an array of doubles to the payload
+ *
+ * @param payload	The payload to append to
+ * @param values	The values to append
+ */
+static void putArray(string& payload, const vector<double>& values)
+{
+	putLength(payload, values.size());
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for (auto value : values)
+		put<double>(payload, value);
+#else
+	if (values.size())
+		payload.append((const char *)values.data(), values.size() * sizeof(double));
+#endif
+}
+
+/**
+ * Append raw data to the payload, or if references are being
+ * collected add a reference to the data in place of a copy
+ *
+ * @param payload	The payload to append to
+ * @param data		The data
+ * @param length	The length of the data
+ * @param references	The references or NULL
+ */
+static void putData(string& payload, const void *data, size_t length, vector<PayloadReference> *references)
+{
+	if (length == 0)
+		return;
+	if (references)
+	{
+		PayloadReference reference;
+		reference.offset = payload.length();
+		reference.data = data;
+		reference.length = length;
+		references->push_back(reference);
+	}
+	else
+	{
+		payload.append((const char *)data, length);
+	}
+}
+
+/**
+ * Escape the double quotes in a string value in the same way as
+ * DatapointValue::toString does.
+ *
+ * @param json	The JSON being created
+ * @param str	The string to escape
+ * @param len	The length of the string
+ */
+static void escapeString(string& json, const char *str, uint32_t len)
+{
+	int bscount = 0;
+
+	for (uint32_t i = 0; i < len; i++)
+	{
+		if (str[i] == '\\')
+		{
+			bscount++;
+		}
+		else if (str[i] == '\"')
+		{
+			if ((bscount & 1) == 0)
+				json += '\\';
+			bscount = 0;
+		}
+		else
+		{
+			bscount = 0;
+		}
+		json += str[i];
+	}
+}
+
+/**
+ * Append a floating point value using the same representation as
+ * DatapointValue::toString. Values that are elements of an array are
+ * formatted as an ostream would format them.
+ *
+ * @param json		The JSON being created
+ * @param value		The value to append
+ * @param element	The value is an array element
+ */
+static void appendDouble(string& json, double value, bool element)
+{
+	char buf[100];
+
+	if (element)
+	{
+		snprintf(buf, sizeof(buf), "%g", value);
+		json += buf;
+		return;
+	}
+	snprintf(buf, sizeof(buf), "%.10f", value);
+	string s = buf;
+	if (s[s.size() - 1] == '0')
+	{
+		s.erase(s.find_last_not_of('0') + 1, string::npos);
+		if (s[s.size() - 1] == '.')
+			s.append("0");
+	}
+	json += s;
+}
+
+/**
+ * Append a JSON array of doubles from the payload
+ *
+ * @param cursor	The payload cursor
+ * @param json		The JSON being created
+ * @return bool		True if the array was decoded
+ */
+static bool arrayToJSON(PayloadCursor& cursor, string& json)
+{
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return false;
+	json += '[';
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double value;
+		if (!cursor.get(value))
+			return false;
+		if (i)
+			json += ", ";
+		appendDouble(json, value, true);
+	}
+	json += ']';
+	return true;
+}
+
+/**
+ * Decode an array of doubles from the payload
+ *
+ * @param cursor	The payload cursor
+ * @param values	The vector to populate
+ * @return bool		True if the array was decoded
+ */
+static bool arrayToVector(PayloadCursor& cursor, vector<double>& values)
+{
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return false;
+	values.reserve(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double value;
+		if (!cursor.get(value))
+			return false;
+		values.push_back(value);
+	}
+	return true;
+}
+
+/**
+ * Decode an image or data buffer from the payload
+ *
+ * @param cursor	The payload cursor
+ * @param tag		The type of the value
+ * @return DatapointValue*	The value, owned by the caller, or NULL if
+ *			it could not be decoded
+ */
+static DatapointValue *binaryValue(PayloadCursor& cursor, uint8_t tag)
+{
+	uint32_t a, b, c, length;
+	const char *data;
+
+	if (tag == DatapointValue::T_IMAGE)
+	{
+		if (!cursor.getLength(a) || !cursor.getLength(b) || !cursor.getLength(c) || !cursor.getLength(length)
+				|| length != a * b * (c / 8) || !cursor.get(&data, length))
+			return NULL;
+		return new DatapointValue(new DPImage(a, b, c, (void *)data));
+	}
+	if (!cursor.getLength(a) || !cursor.getLength(b) || !cursor.getLength(length)
+			|| length != a * b || !cursor.get(&data, length))
+		return NULL;
+	DataBuffer *buffer = new DataBuffer(a, b);
+	if (length)
+		memcpy(buffer->getData(), data, length);
+	return new DatapointValue(buffer);
+}
+
+static bool datapointToJSON(PayloadCursor& cursor, string& json, bool withName);
+
+/**
+ * Decode a set of datapoints from the payload into their JSON
+ * representation.
+ *
+ * @param cursor	The payload cursor
+ * @param json		The JSON being created
+ * @param separator	The separator to place between datapoints
+ * @param withName	Include the datapoint names
+ * @return bool		True if the datapoints were decoded
+ */
+static bool datapointsToJSON(PayloadCursor& cursor, string& json, const char *separator, bool withName)
+{
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (i)
+			json += separator;
+		if (!datapointToJSON(cursor, json, withName))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Decode a single datapoint from the payload into JSON
+ *
+ * @param cursor	The payload cursor
+ * @param json		The JSON being created
+ * @param withName	Include the name of the datapoint
+ * @return bool		True if the datapoint was decoded
+ */
+static bool datapointToJSON(PayloadCursor& cursor, string& json, bool withName)
+{
+	uint8_t tag;
+	uint32_t nameLength;
+	const char *name;
+
+	if (!cursor.get(tag) || !cursor.getLength(nameLength) || !cursor.get(&name, nameLength))
+		return false;
+	if (withName)
+	{
+		json += '"';
+		json.append(name, nameLength);
+		json += "\":";
+	}
+	switch (tag)
+	{
+		case DatapointValue::T_STRING:
+		{
+			uint32_t length;
+			const char *str;
+			if (!cursor.getLength(length) || !cursor.get(&str, length))
+				return false;
+			json += '"';
+			escapeString(json, str, length);
+			json += '"';
+			return true;
+		}
+		case DatapointValue::T_INTEGER:
+		{
+			int64_t value;
+			if (!cursor.getInteger(value))
+				return false;
+			json += to_string((long)value);
+			return true;
+		}
+		case DatapointValue::T_FLOAT:
+		{
+			double value;
+			if (!cursor.get(value))
+				return false;
+			appendDouble(json, value, false);
+			return true;
+		}
+		case DatapointValue::T_FLOAT_ARRAY:
+			return arrayToJSON(cursor, json);
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			uint32_t rows;
+			if (!cursor.getLength(rows))
+				return false;
+			json += "[ ";
+			for (uint32_t i = 0; i < rows; i++)
+			{
+				if (i)
+					json += ", ";
+				if (!arrayToJSON(cursor, json))
+					return false;
+			}
+			json += " ]";
+			return true;
+		}
+		case DatapointValue::T_DP_DICT:
+			json += '{';
+			if (!datapointsToJSON(cursor, json, ", ", true))
+				return false;
+			json += '}';
+			return true;
+		case DatapointValue::T_DP_LIST:
+			json += '[';
+			if (!datapointsToJSON(cursor, json, ", ", false))
+				return false;
+			json += ']';
+			return true;
+		case DatapointValue::T_IMAGE:
+		case DatapointValue::T_DATABUFFER:
+		{
+			// Images and data buffers are base64 encoded in JSON
+			DatapointValue *value = binaryValue(cursor, tag);
+			if (!value)
+				return false;
+			json += value->toString();
+			delete value;
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+static vector<Datapoint *> *datapointsToVector(PayloadCursor& cursor);
+
+/**
+ * Decode a single datapoint from the payload
+ *
+ * @param cursor	The payload cursor
+ * @return Datapoint*	The new datapoint or NULL if it could not be decoded
+ */
+static Datapoint *decodeDatapoint(PayloadCursor& cursor)
+{
+	uint8_t tag;
+	uint32_t nameLength;
+	const char *name;
+
+	if (!cursor.get(tag) || !cursor.getLength(nameLength) || !cursor.get(&name, nameLength))
+		return NULL;
+	string dpName(name, nameLength);
+	switch (tag)
+	{
+		case DatapointValue::T_STRING:
+		{
+			uint32_t length;
+			const char *str;
+			if (!cursor.getLength(length) || !cursor.get(&str, length))
+				return NULL;
+			DatapointValue value(string(str, length));
+			return new Datapoint(dpName, value);
+		}
+		case DatapointValue::T_INTEGER:
+		{
+			int64_t i;
+			if (!cursor.getInteger(i))
+				return NULL;
+			DatapointValue value((long)i);
+			return new Datapoint(dpName, value);
+		}
+		case DatapointValue::T_FLOAT:
+		{
+			double f;
+			if (!cursor.get(f))
+				return NULL;
+			DatapointValue value(f);
+			return new Datapoint(dpName, value);
+		}
+		case DatapointValue::T_FLOAT_ARRAY:
+		{
+			vector<double> values;
+			if (!arrayToVector(cursor, values))
+				return NULL;
+			DatapointValue value(values);
+			return new Datapoint(dpName, value);
+		}
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+		{
+			uint32_t rows;
+			if (!cursor.getLength(rows))
+				return NULL;
+			vector<vector<double> *> array;
+			bool ok = true;
+			for (uint32_t i = 0; ok && i < rows; i++)
+			{
+				vector<double> *row = new vector<double>;
+				array.push_back(row);
+				ok = arrayToVector(cursor, *row);
+			}
+			Datapoint *dp = NULL;
+			if (ok)
+			{
+				DatapointValue value(array);
+				dp = new Datapoint(dpName, value);
+			}
+			for (auto row : array)
+				delete row;
+			return dp;
+		}
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+		{
+			vector<Datapoint *> *values = datapointsToVector(cursor);
+			if (!values)
+				return NULL;
+			DatapointValue value(values, tag == DatapointValue::T_DP_DICT);
+			return new Datapoint(dpName, value);
+		}
+		case DatapointValue::T_IMAGE:
+		case DatapointValue::T_DATABUFFER:
+		{
+			DatapointValue *value = binaryValue(cursor, tag);
+			if (!value)
+				return NULL;
+			// Move the value to avoid copying the image or buffer again
+			Datapoint *dp = new Datapoint(dpName, std::move(*value));
+			delete value;
+			return dp;
+		}
+		default:
+			return NULL;
+	}
+}
+
+/**
+ * Decode a set of datapoints from the payload
+ *
+ * @param cursor	The payload cursor
+ * @return vector*	The datapoints or NULL if they could not be decoded
+ */
+static vector<Datapoint *> *datapointsToVector(PayloadCursor& cursor)
+{
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return NULL;
+	vector<Datapoint *> *datapoints = new vector<Datapoint *>;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		Datapoint *dp = decodeDatapoint(cursor);
+		if (!dp)
+		{
+			for (auto d : *datapoints)
+				delete d;
+			delete datapoints;
+			return NULL;
+		}
+		datapoints->push_back(dp);
+	}
+	return datapoints;
+}
+
+static bool skipDatapoints(PayloadCursor& cursor);
+
+/**
+ * Skip over the value of a datapoint in the payload
+ *
+ * @param cursor	The payload cursor, positioned after the datapoint name
+ * @param tag		The type of the value
+ * @return bool		True if the value was skipped
+ */
+static bool skipValue(PayloadCursor& cursor, uint8_t tag)
+{
+	uint32_t a, b, c, length;
+
+	switch (tag)
+	{
+		case DatapointValue::T_STRING:
+			return cursor.getLength(length) && cursor.skip(length);
+		case DatapointValue::T_INTEGER:
+		{
+			int64_t value;
+			return cursor.getInteger(value);
+		}
+		case DatapointValue::T_FLOAT:
+			return cursor.skip(sizeof(double));
+		case DatapointValue::T_FLOAT_ARRAY:
+			return cursor.getLength(length) && cursor.skip((size_t)length * sizeof(double));
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+			if (!cursor.getLength(a))
+				return false;
+			for (uint32_t i = 0; i < a; i++)
+			{
+				if (!cursor.getLength(length) || !cursor.skip((size_t)length * sizeof(double)))
+					return false;
+			}
+			return true;
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+			return skipDatapoints(cursor);
+		case DatapointValue::T_IMAGE:
+			return cursor.getLength(a) && cursor.getLength(b) && cursor.getLength(c)
+				&& cursor.getLength(length) && cursor.skip(length);
+		case DatapointValue::T_DATABUFFER:
+			return cursor.getLength(a) && cursor.getLength(b) && cursor.getLength(length) && cursor.skip(length);
+		default:
+			return false;
+	}
+}
+
+/**
+ * Skip over a set of datapoints in the payload
+ *
+ * @param cursor	The payload cursor
+ * @return bool		True if the datapoints were skipped
+ */
+static bool skipDatapoints(PayloadCursor& cursor)
+{
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint8_t tag;
+		uint32_t nameLength;
+		if (!cursor.get(tag) || !cursor.getLength(nameLength) || !cursor.skip(nameLength)
+				|| !skipValue(cursor, tag))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Get a numeric value from the payload
+ *
+ * @param cursor	The payload cursor, positioned after the datapoint name
+ * @param tag		The type of the value
+ * @param value		The value as a double
+ * @return bool		True if the value is an integer or floating point number
+ */
+static bool numericValue(PayloadCursor& cursor, uint8_t tag, double& value)
+{
+	if (tag == DatapointValue::T_INTEGER)
+	{
+		int64_t i;
+		if (!cursor.getInteger(i))
+			return false;
+		value = (double)i;
+		return true;
+	}
+	if (tag == DatapointValue::T_FLOAT)
+	{
+		return cursor.get(value);
+	}
+	return false;
+}
+
+/**
+ * Check the marker and version at the start of a binary payload
+ *
+ * @param cursor	The payload cursor
+ * @return bool		True if the payload is a binary payload we understand
+ */
+static bool checkHeader(PayloadCursor& cursor)
+{
+	uint8_t marker, version;
+	if (!cursor.get(marker) || !cursor.get(version))
+		return false;
+	if (marker != RDS_BINARY_PAYLOAD_MARKER || version < 1 || version > RDS_BINARY_PAYLOAD_VERSION)
+		return false;
+	cursor.setVersion(version);
+	return true;
+}
+
+/**
+ * Encode a set of datapoints as a binary payload
+ *
+ * @param datapoints	The datapoints to encode
+ * @param payload	The string to hold the encoded payload
+ * @return bool		False if the datapoints contain a type that has no
+ *			binary encoding, in which case JSON should be used
+ */
+bool ReadingStreamPayload::encode(const vector<Datapoint *>& datapoints, string& payload,
+				vector<PayloadReference> *references)
+{
+	payload.clear();
+	if (references)
+		references->clear();
+	put<uint8_t>(payload, RDS_BINARY_PAYLOAD_MARKER);
+	put<uint8_t>(payload, RDS_BINARY_PAYLOAD_VERSION);
+	putLength(payload, datapoints.size());
+	for (auto dp : datapoints)
+	{
+		if (!encodeDatapoint(dp, payload, references))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Encode a single datapoint, recursing into nested datapoints
+ *
+ * @param datapoint	The datapoint to encode
+ * @param payload	The payload to append to
+ * @param references	If not NULL the raw data of images and data buffers is
+ *			added to the references rather than the payload
+ * @return bool		False if the datapoint can not be encoded
+ */
+bool ReadingStreamPayload::encodeDatapoint(Datapoint *datapoint, string& payload,
+				vector<PayloadReference> *references)
+{
+	DatapointValue& value = datapoint->getData();
+	const string name = datapoint->getName();
+
+	put<uint8_t>(payload, (uint8_t)value.getType());
+	putLength(payload, name.length());
+	payload.append(name);
+	switch (value.getType())
+	{
+		case DatapointValue::T_STRING:
+		{
+			const string str = value.toStringValue();
+			putLength(payload, str.length());
+			payload.append(str);
+			return true;
+		}
+		case DatapointValue::T_INTEGER:
+			putInteger(payload, value.toInt());
+			return true;
+		case DatapointValue::T_FLOAT:
+			put<double>(payload, value.toDouble());
+			return true;
+		case DatapointValue::T_FLOAT_ARRAY:
+			putArray(payload, *value.getDpArr());
+			return true;
+		case DatapointValue::T_2D_FLOAT_ARRAY:
+			putLength(payload, value.getDp2DArr()->size());
+			for (auto row : *value.getDp2DArr())
+				putArray(payload, *row);
+			return true;
+		case DatapointValue::T_DP_DICT:
+		case DatapointValue::T_DP_LIST:
+			putLength(payload, value.getDpVec()->size());
+			for (auto dp : *value.getDpVec())
+			{
+				if (!encodeDatapoint(dp, payload, references))
+					return false;
+			}
+			return true;
+		case DatapointValue::T_IMAGE:
+		{
+			DPImage *image = value.getImage();
+			size_t length = image->getWidth() * image->getHeight() * (image->getDepth() / 8);
+			putLength(payload, image->getWidth());
+			putLength(payload, image->getHeight());
+			putLength(payload, image->getDepth());
+			putLength(payload, length);
+			putData(payload, image->getData(), length, references);
+			return true;
+		}
+		case DatapointValue::T_DATABUFFER:
+		{
+			DataBuffer *buffer = value.getDataBuffer();
+			size_t length = buffer->getItemSize() * buffer->getItemCount();
+			putLength(payload, buffer->getItemSize());
+			putLength(payload, buffer->getItemCount());
+			putLength(payload, length);
+			putData(payload, buffer->getData(), length, references);
+			return true;
+		}
+		default:
+			return false;
+	}
+}
+
+/**
+ * Test if a floating point value survives being formatted by toJSON.
+ * Values with more precision than DatapointValue::toString keeps are
+ * not binary encoded, so that the JSON returned for them is unchanged.
+ *
+ * @param value		The value to test
+ * @param element	The value is an array element
+ * @return bool		True if toJSON will return the same value
+ */
+static bool exactDouble(double value, bool element)
+{
+	char buf[400];
+
+	snprintf(buf, sizeof(buf), element ? "%g" : "%.10f", value);
+	return strtod(buf, NULL) == value;
+}
+
+/**
+ * Test if a string can be returned by toJSON unchanged. Strings that
+ * contain escape sequences or control characters are not binary encoded
+ * as toJSON only escapes double quotes.
+ *
+ * @param str		The string to test
+ * @param length	The length of the string
+ * @return bool		True if the string may be encoded
+ */
+static bool plainString(const char *str, uint32_t length)
+{
+	for (uint32_t i = 0; i < length; i++)
+	{
+		if (str[i] == '\\' || (unsigned char)str[i] < 0x20)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Encode a datapoint whose JSON value is a string holding a base64
+ * encoded image or data buffer. Other strings that begin with the
+ * special prefix are not binary encoded.
+ *
+ * @param name		The datapoint name
+ * @param nameLength	The length of the name
+ * @param str		The string value
+ * @param payload	The payload to append to
+ * @return bool		True if the datapoint was encoded
+ */
+bool ReadingStreamPayload::encodeBase64(const char *name, uint32_t nameLength, const char *str, string& payload)
+{
+	const char *data = strchr(str, ':');
+	if (!data)
+		return false;
+	try {
+		DatapointValue *value;
+		if (strncmp(str, "__DPIMAGE:", 10) == 0)
+			value = new DatapointValue(new Base64DPImage(data + 1));
+		else if (strncmp(str, "__DATABUFFER:", 13) == 0)
+			value = new DatapointValue(new Base64DataBuffer(data + 1));
+		else
+			return false;
+		Datapoint datapoint(string(name, nameLength), std::move(*value));
+		delete value;
+		return encodeDatapoint(&datapoint, payload, NULL);
+	} catch (exception& e) {
+		return false;
+	}
+}
+
+/**
+ * Test if a JSON array holds only numbers that may be encoded as an
+ * array of doubles.
+ *
+ * @param array		The JSON array
+ * @return bool		True if the array is an array of numbers
+ */
+static bool numberArray(const rapidjson::Value& array)
+{
+	for (auto& element : array.GetArray())
+	{
+		if (!element.IsNumber() || !exactDouble(element.GetDouble(), true))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Encode the JSON datapoints of a reading as a binary payload. This is
+ * the encoding produced by encode for the equivalent datapoints, toJSON
+ * returns an equivalent JSON object.
+ *
+ * @param reading	The JSON object holding the datapoints of the reading
+ * @param payload	The string to hold the encoded payload
+ * @return bool		False if the reading contains a value that has no
+ *			binary encoding, in which case the JSON should be used
+ */
+bool ReadingStreamPayload::fromJSON(const rapidjson::Value& reading, string& payload)
+{
+	payload.clear();
+	if (!reading.IsObject())
+		return false;
+	put<uint8_t>(payload, RDS_BINARY_PAYLOAD_MARKER);
+	put<uint8_t>(payload, RDS_BINARY_PAYLOAD_VERSION);
+	putLength(payload, reading.MemberCount());
+	for (auto& member : reading.GetObject())
+	{
+		if (!encodeJSON(member.name.GetString(), member.name.GetStringLength(),
+					member.value, payload))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Encode a single JSON value as a datapoint, recursing into objects
+ * and arrays
+ *
+ * @param name		The name of the datapoint
+ * @param nameLength	The length of the name
+ * @param value		The JSON value
+ * @param payload	The payload to append to
+ * @return bool		False if the value can not be encoded
+ */
+bool ReadingStreamPayload::encodeJSON(const char *name, uint32_t nameLength,
+				const rapidjson::Value& value, string& payload)
+{
+	if (!plainString(name, nameLength))
+		return false;
+	if (value.IsString())
+	{
+		if (value.GetStringLength() > 2 && strncmp(value.GetString(), "__", 2) == 0)
+		{
+			// Base64 encoded images and data buffers are held as raw data
+			return encodeBase64(name, nameLength, value.GetString(), payload);
+		}
+		if (!plainString(value.GetString(), value.GetStringLength()))
+			return false;
+		put<uint8_t>(payload, DatapointValue::T_STRING);
+		putLength(payload, nameLength);
+		payload.append(name, nameLength);
+		putLength(payload, value.GetStringLength());
+		payload.append(value.GetString(), value.GetStringLength());
+		return true;
+	}
+	if (value.IsInt64())
+	{
+		put<uint8_t>(payload, DatapointValue::T_INTEGER);
+		putLength(payload, nameLength);
+		payload.append(name, nameLength);
+		putInteger(payload, value.GetInt64());
+		return true;
+	}
+	if (value.IsDouble())
+	{
+		if (!exactDouble(value.GetDouble(), false))
+			return false;
+		put<uint8_t>(payload, DatapointValue::T_FLOAT);
+		putLength(payload, nameLength);
+		payload.append(name, nameLength);
+		put<double>(payload, value.GetDouble());
+		return true;
+	}
+	if (value.IsObject())
+	{
+		put<uint8_t>(payload, DatapointValue::T_DP_DICT);
+		putLength(payload, nameLength);
+		payload.append(name, nameLength);
+		putLength(payload, value.MemberCount());
+		for (auto& member : value.GetObject())
+		{
+			if (!encodeJSON(member.name.GetString(), member.name.GetStringLength(),
+						member.value, payload))
+				return false;
+		}
+		return true;
+	}
+	if (value.IsArray())
+	{
+		bool twoD = value.Size() > 0;
+		for (auto& row : value.GetArray())
+		{
+			if (!row.IsArray() || !numberArray(row))
+			{
+				twoD = false;
+				break;
+			}
+		}
+		uint8_t tag = twoD ? DatapointValue::T_2D_FLOAT_ARRAY :
+				(numberArray(value) ? DatapointValue::T_FLOAT_ARRAY : DatapointValue::T_DP_LIST);
+		put<uint8_t>(payload, tag);
+		putLength(payload, nameLength);
+		payload.append(name, nameLength);
+		putLength(payload, value.Size());
+		for (auto& element : value.GetArray())
+		{
+			if (tag == DatapointValue::T_FLOAT_ARRAY)
+			{
+				put<double>(payload, element.GetDouble());
+			}
+			else if (tag == DatapointValue::T_2D_FLOAT_ARRAY)
+			{
+				putLength(payload, element.Size());
+				for (auto& v : element.GetArray())
+					put<double>(payload, v.GetDouble());
+			}
+			else if (!encodeJSON("", 0, element, payload))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	// Booleans, nulls and integers too large for an int64 have no encoding
+	return false;
+}
+
+/**
+ * Convert a binary payload into the JSON representation of the datapoints
+ * without creating the intermediate datapoints.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @param json		The string to hold the JSON object
+ * @return bool		True if the payload could be decoded
+ */
+bool ReadingStreamPayload::toJSON(const char *payload, size_t length, string& json)
+{
+	PayloadCursor cursor(payload, length);
+
+	json.clear();
+	if (!checkHeader(cursor))
+		return false;
+	json += '{';
+	if (!datapointsToJSON(cursor, json, ",", true))
+		return false;
+	json += '}';
+	return true;
+}
+
+/**
+ * Rebuild the datapoints encoded in a binary payload
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @return vector*	The datapoints, owned by the caller, or NULL
+ *			if the payload could not be decoded
+ */
+vector<Datapoint *> *ReadingStreamPayload::toDatapoints(const char *payload, size_t length)
+{
+	PayloadCursor cursor(payload, length);
+
+	if (!checkHeader(cursor))
+		return NULL;
+	return datapointsToVector(cursor);
+}
+
+/**
+ * Find a numeric datapoint, possibly nested within dictionaries, in a
+ * binary payload without decoding the other datapoints.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @param path		The names of the datapoint and the dictionaries that hold it
+ * @param value		The value of the datapoint
+ * @return bool		True if the datapoint was found and is a number
+ */
+bool ReadingStreamPayload::number(const char *payload, size_t length,
+				const vector<string>& path, double& value)
+{
+	PayloadCursor cursor(payload, length);
+
+	if (path.empty() || !checkHeader(cursor))
+		return false;
+	for (size_t depth = 0; depth < path.size(); depth++)
+	{
+		const string& want = path[depth];
+		uint32_t count;
+		if (!cursor.getLength(count))
+			return false;
+		uint32_t i;
+		uint8_t tag;
+		for (i = 0; i < count; i++)
+		{
+			uint32_t nameLength;
+			const char *name;
+			if (!cursor.get(tag) || !cursor.getLength(nameLength) || !cursor.get(&name, nameLength))
+				return false;
+			if (nameLength == want.length() && memcmp(name, want.data(), nameLength) == 0)
+				break;
+			if (!skipValue(cursor, tag))
+				return false;
+		}
+		if (i == count)
+			return false;
+		if (depth + 1 == path.size())
+			return numericValue(cursor, tag, value);
+		if (tag != DatapointValue::T_DP_DICT)
+			return false;
+	}
+	return false;
+}
+
+/**
+ * Call a function for each of the numeric datapoints at the top level
+ * of a binary payload, other datapoints are skipped.
+ *
+ * @param payload	The binary payload
+ * @param length	The length of the payload
+ * @param visitor	The function to call with the name and value of each number
+ * @return bool		True if the payload could be decoded
+ */
+bool ReadingStreamPayload::numbers(const char *payload, size_t length, const NumberVisitor& visitor)
+{
+	PayloadCursor cursor(payload, length);
+
+	if (!checkHeader(cursor))
+		return false;
+	uint32_t count;
+	if (!cursor.getLength(count))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint8_t tag;
+		uint32_t nameLength;
+		const char *name;
+		if (!cursor.get(tag) || !cursor.getLength(nameLength) || !cursor.get(&name, nameLength))
+			return false;
+		if (tag == DatapointValue::T_INTEGER || tag == DatapointValue::T_FLOAT)
+		{
+			double value;
+			if (!numericValue(cursor, tag, value))
+				return false;
+			visitor(name, nameLength, value);
+		}
+		else if (!skipValue(cursor, tag))
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -11,6 +11,7 @@
 #include <reading.h>
 #include <reading_set.h>
 #include <reading_stream.h>
+#include <reading_stream_payload.h>
 #include <rapidjson/document.h>
 #include <rapidjson/error/en.h>
 #include <management_client.h>
@@ -22,6 +23,7 @@
 #include <map>
 #include <string_utils.h>
 #include <sys/uio.h>
+#include <limits.h>
 #include <errno.h>
 #include <stdarg.h>
 
@@ -46,7 +48,8 @@ std::mutex sto_mtx_client_map;
 /**
  * Storage Client constructor
  */
-StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(const string& hostname, const unsigned short port) : m_streaming(false), m_streamBinary(false), m_streamVersion(1),
+	m_streamBinaryData(true), m_streamFailed(false), m_binaryFetch(true), m_management(NULL)
 {
 	m_host = hostname;
 	m_pid = getpid();
@@ -58,7 +61,8 @@ StorageClient::StorageClient(const string& hostname, const unsigned short port)
  * Storage Client constructor
  * stores the provided HttpClient into the map
  */
-StorageClient::StorageClient(HttpClient *client) : m_streaming(false), m_management(NULL)
+StorageClient::StorageClient(HttpClient *client) : m_streaming(false), m_streamBinary(false), m_streamVersion(1),
+	m_streamBinaryData(true), m_streamFailed(false), m_binaryFetch(true), m_management(NULL)
 {
 
 	std::thread::id thread_id = std::this_thread::get_id();
@@ -141,6 +145,39 @@ bool StorageClient::readingAppend(Reading& reading)
 	return false;
 }
 
+/**
+ * Return true if the reading contains an image or data buffer
+ * datapoint. These are sent via the reading stream as the binary
+ * payload of the stream carries them without base64 encoding.
+ *
+ * @param reading	The reading to check
+ */
+static bool hasBinaryData(const Reading *reading)
+{
+	for (auto dp : reading->getReadingData())
+	{
+		DatapointValue::dataTagType type = dp->getData().getType();
+		if (type == DatapointValue::T_IMAGE || type == DatapointValue::T_DATABUFFER)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Return true if any of the readings contain an image or data buffer
+ *
+ * @param readings	The readings to check
+ */
+static bool hasBinaryData(const vector<Reading *>& readings)
+{
+	for (auto reading : readings)
+	{
+		if (hasBinaryData(reading))
+			return true;
+	}
+	return false;
+}
+
 /**
  * Append multiple readings
  *
@@ -175,6 +212,17 @@ bool StorageClient::readingAppend(const vector<Reading *>& readings)
 		m_logger->warn("Failed to switch to streaming mode");
 	}
 #endif
+	// Images and data buffers are streamed to avoid base64 encoding them
+	if (m_streamBinaryData && !m_streamFailed && hasBinaryData(readings))
+	{
+		if (openStream())
+		{
+			m_logger->info("Switched to stream mode for readings that contain images or data buffers");
+			return streamReadings(readings);
+		}
+		m_logger->warn("Failed to switch to stream mode, images and data buffers will be sent as JSON");
+		m_streamFailed = true;
+	}
 	static HttpClient *httpClient = this->getHttpClient(); // to initialize m_seqnum_map[thread_id] for this thread
 	try {
 		std::thread::id thread_id = std::this_thread::get_id();
@@ -307,23 +355,44 @@ ReadingSet *StorageClient::readingQueryToReadings(const Query& query)
  * Retrieve a set of readings for sending on the northbound
  * interface of Fledge
  *
+ * If wait is non-zero and there are no readings to return the storage
+ * service will wait up to that number of milliseconds for new readings
+ * to be appended before returning.
+ *
  * @param readingId	The ID of the reading which should be the first one to send
  * @param count		Maximum number if readings to return
+ * @param wait		Time in milliseconds to wait for readings
  * @return ReadingSet	The set of readings
  */
-ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const unsigned long count)
+ReadingSet *StorageClient::readingFetch(const unsigned long readingId, const unsigned long count,
+					const unsigned long wait)
 {
 	try {
 
 		char url[256];
-		snprintf(url, sizeof(url), "/storage/reading?id=%ld&count=%ld",
-				readingId, count);
+		if (wait)
+		{
+			snprintf(url, sizeof(url), "/storage/reading?id=%ld&count=%ld&wait=%ld%s",
+					readingId, count, wait, m_binaryFetch ? "&format=binary" : "");
+		}
+		else
+		{
+			snprintf(url, sizeof(url), "/storage/reading?id=%ld&count=%ld%s",
+					readingId, count, m_binaryFetch ? "&format=binary" : "");
+		}
 
 		auto res = this->getHttpClient()->request("GET", url);
 		if (res->status_code.compare("200 OK") == 0)
 		{
 			ostringstream resultPayload;
 			resultPayload << res->content.rdbuf();
+			// Storage plugins that do not support binary fetch return JSON
+			auto contentType = res->header.find("Content-Type");
+			if (contentType != res->header.end()
+					&& contentType->second.compare("application/octet-stream") == 0)
+			{
+				return new ReadingSet(resultPayload.str(), ReadingSet::PARSE_BINARY);
+			}
 			ReadingSet *result = new ReadingSet(resultPayload.str());
 			return result;
 		}
@@ -1415,6 +1484,10 @@ bool StorageClient::openStream()
 			}
 		       	port = doc["port"].GetInt();
 			token = doc["token"].GetInt();
+			// Storage services that support version 2 of the protocol accept binary payloads
+			m_streamVersion = doc.HasMember("version") && doc["version"].IsInt()
+					? doc["version"].GetInt() : 1;
+			m_streamBinary = m_streamVersion >= RDS_BINARY_PROTOCOL_VERSION;
 			if ((m_stream = socket(AF_INET, SOCK_STREAM, 0)) == -1)
         		{
 				m_logger->error("Unable to create socket");
@@ -1437,7 +1510,7 @@ bool StorageClient::openStream()
 				return false;
 			}
 			RDSConnectHeader conhdr;
-			conhdr.magic = RDS_CONNECTION_MAGIC;
+			conhdr.magic = m_streamBinary ? RDS_BINARY_CONNECTION_MAGIC : RDS_CONNECTION_MAGIC;
 			conhdr.token = token;
 			if (write(m_stream, &conhdr, sizeof(conhdr)) != sizeof(conhdr))
 			{
@@ -1445,7 +1518,8 @@ bool StorageClient::openStream()
 				return false;
 			}
 			m_streaming = true;
-			m_logger->info("Storage stream succesfully created");
+			m_logger->info("Storage stream succesfully created, using %s payloads",
+					m_streamBinary ? "binary" : "JSON");
 			return true;
 		}
 		ostringstream resultPayload;
@@ -1480,6 +1554,11 @@ bool StorageClient::openStream()
  * is 0 then no asset name is sent and the name of the asset is the same
  * as the previous asset in the block. Following this the paylod is included.
  *
+ * If the storage service supports it the payload is the binary encoding
+ * of the datapoints described in reading_stream.h, otherwise, or if the
+ * reading contains datapoint types that have no binary encoding, it is
+ * the JSON representation of the datapoints.
+ *
  * Each block is sent to the storage layer in a number of chunks rather
  * that a single write per block. The implementation make use of the
  * Linux scatter/gather IO calls to reduce the number of copies of data
@@ -1502,6 +1581,7 @@ register RDSReadingHeader	*phdr;
 struct iovec			iovs[STREAM_BLK_SIZE * 4], *iovp;
 string				payloads[STREAM_BLK_SIZE];
 struct timeval			tm[STREAM_BLK_SIZE];
+vector<PayloadReference>	references;
 ssize_t				n, length = 0;
 string				lastAsset;
 
@@ -1537,7 +1617,10 @@ string				lastAsset;
 	/*
 	 * Use the writev scatter/gather interface to send the reading headers and reading data.
 	 * We sent chunks of data in order to allow the parallel sending and unpacking process
-	 * at the two ends. The chunk size is STREAM_BLK_SIZE readings.
+	 * at the two ends. The chunk size is STREAM_BLK_SIZE readings, or fewer if the
+	 * readings contain images or data buffers, since the raw data of these is sent
+	 * directly from the datapoints with an iovec of its own rather than being copied
+	 * into the payload.
 	 */
 	iovp = iovs;
 	phdr = rdhdrs;
@@ -1559,9 +1642,45 @@ string				lastAsset;
 			phdr->assetLength = assetCode.length() + 1;
 		}
 
-		// Always generate the JSON variant of the data points and send
-		payloads[offset] = readings[i]->getDatapointsJSON();
-		phdr->payloadLength = payloads[offset].length() + 1;
+		references.clear();
+		// Storage services before version 3 of the protocol can not decode binary images
+		if (m_streamBinary && (m_streamVersion >= RDS_BINARY_DATA_PROTOCOL_VERSION
+					|| !hasBinaryData(readings[i]))
+				&& ReadingStreamPayload::encode(readings[i]->getReadingData(),
+					payloads[offset], &references))
+		{
+			if (references.size() * 2 + 4 > STREAM_BLK_SIZE * 4)
+			{
+				// Too many images to reference, copy them into the payload
+				ReadingStreamPayload::encode(readings[i]->getReadingData(), payloads[offset]);
+				references.clear();
+			}
+			phdr->payloadLength = payloads[offset].length();
+			for (auto& reference : references)
+				phdr->payloadLength += reference.length;
+		}
+		else
+		{
+			references.clear();
+			payloads[offset] = readings[i]->getDatapointsJSON();
+			phdr->payloadLength = payloads[offset].length() + 1;
+		}
+
+		if (iovp - iovs + references.size() * 2 + 4 > STREAM_BLK_SIZE * 4)
+		{
+			// Not enough room for this reading, send what we have so far
+			if (!writeStream(iovs, iovp - iovs, length))
+				return false;
+			if (offset)
+			{
+				rdhdrs[0] = *phdr;
+				payloads[0].swap(payloads[offset]);
+			}
+			length = 0;
+			iovp = iovs;
+			phdr = rdhdrs;
+			offset = 0;
+		}
 
 		// Add the reading header
 		iovp->iov_base = phdr;
@@ -1585,40 +1704,41 @@ string				lastAsset;
 			iovp++;
 		}
 
-		// Add the data points themselves
-		iovp->iov_base = (void *)(payloads[offset].c_str()); // Cast away const due to iovec definition
-		iovp->iov_len = phdr->payloadLength;
-		length += iovp->iov_len;
-		iovp++;
+		// Add the data points themselves, interleaved with any referenced raw data
+		const char *payload = payloads[offset].c_str();
+		size_t sent = 0;
+		for (auto& reference : references)
+		{
+			if (reference.offset > sent)
+			{
+				iovp->iov_base = (void *)(payload + sent); // Cast away const due to iovec definition
+				iovp->iov_len = reference.offset - sent;
+				length += iovp->iov_len;
+				iovp++;
+				sent = reference.offset;
+			}
+			iovp->iov_base = (void *)reference.data;
+			iovp->iov_len = reference.length;
+			length += iovp->iov_len;
+			iovp++;
+		}
+		size_t payloadLength = phdr->payloadLength;
+		for (auto& reference : references)
+			payloadLength -= reference.length;
+		if (payloadLength > sent)
+		{
+			iovp->iov_base = (void *)(payload + sent); // Cast away const due to iovec definition
+			iovp->iov_len = payloadLength - sent;
+			length += iovp->iov_len;
+			iovp++;
+		}
 
 		offset++;
 		if (offset == STREAM_BLK_SIZE - 1)
 		{
-			if (iovp - iovs > STREAM_BLK_SIZE * 4)
-				Logger::getLogger()->error("Too many iov blocks %d", iovp - iovs);
 			// Send a chunk of readings in the block
-			n = writev(m_stream, (const iovec *)iovs, iovp - iovs);
-			if (n == -1)
-			{
-				if (errno == EPIPE || errno == ECONNRESET)
-				{
-					Logger::getLogger()->error("Stream has been closed by the storage service");
-					m_streaming = false;
-				}
-				Logger::getLogger()->error("Write of block %d filed: %s",
-							m_readingBlock - 1, strerror(errno));
+			if (!writeStream(iovs, iovp - iovs, length))
 				return false;
-			}
-			else if (n < length)
-			{
-				Logger::getLogger()->error("Write of block short, %d < %d: %s",
-							n, length, strerror(errno));
-				return false;
-			}
-			else if (n > length)
-			{
-				Logger::getLogger()->fatal("Long write %d < %d", length, n);
-			}
 			offset = 0;
 			length = 0;
 			iovp = iovs;
@@ -1632,30 +1752,61 @@ string				lastAsset;
 
 	if (length)	// Remaining data to be sent to finish the block
 	{
-		n = writev(m_stream, (const iovec *)iovs, iovp - iovs);
+		if (!writeStream(iovs, iovp - iovs, length))
+			return false;
+	}
+	Logger::getLogger()->info("Written block of %d readings via streaming connection", readings.size());
+	return true;
+}
+
+/**
+ * Write a chunk of a block of readings to the reading stream. Large
+ * chunks, such as those that contain images, may be only partially
+ * written by a single writev call, in which case the remainder of the
+ * chunk is written by subsequent calls.
+ *
+ * @param iovs		The iovecs that describe the chunk, these are updated
+ * @param count		The number of iovecs
+ * @param length	The total length of the chunk
+ * @return bool		True if the chunk was written
+ */
+bool StorageClient::writeStream(struct iovec *iovs, int count, ssize_t length)
+{
+	while (count > 0)
+	{
+		ssize_t n = writev(m_stream, (const iovec *)iovs, count > IOV_MAX ? IOV_MAX : count);
 		if (n == -1)
 		{
+			if (errno == EINTR)
+				continue;
 			if (errno == EPIPE || errno == ECONNRESET)
 			{
 				Logger::getLogger()->error("Stream has been closed by the storage service");
 				m_streaming = false;
 			}
-			Logger::getLogger()->error("Write of block %d filed: %s",
+			Logger::getLogger()->error("Write of block %d failed: %s",
 						m_readingBlock - 1, strerror(errno));
 			return false;
 		}
-		else if (n < length)
+		length -= n;
+		// Skip the iovecs that have been written and adjust a partially written one
+		while (count > 0 && n >= (ssize_t)iovs->iov_len)
 		{
-			Logger::getLogger()->error("Write of block short, %d < %d: %s",
-						n, length, strerror(errno));
-			return false;
+			n -= iovs->iov_len;
+			iovs++;
+			count--;
 		}
-		else if (n > length)
+		if (count > 0)
 		{
-			Logger::getLogger()->fatal("Long write %d < %d", length, n);
+			iovs->iov_base = (char *)iovs->iov_base + n;
+			iovs->iov_len -= n;
 		}
 	}
-	Logger::getLogger()->info("Written block of %d readings via streaming connection", readings.size());
+	if (length != 0)
+	{
+		Logger::getLogger()->fatal("Reading stream write length mismatch of %d bytes", length);
+		return false;
+	}
 	return true;
 }
 
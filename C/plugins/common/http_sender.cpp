@@ -9,6 +9,7 @@
  */
 
 #include <http_sender.h>
+#include <stdexcept>
 
 using namespace std;
 
@@ -25,3 +26,49 @@ HttpSender::HttpSender()
 HttpSender::~HttpSender()
 {
 }
+
+/**
+ * Send a set of independent requests. This sends the requests one
+ * after another using sendRequest, senders that are able to have
+ * several requests in flight override it.
+ *
+ * The HTTP status code and response of each request are returned in
+ * the request, a request that fails without an HTTP status code, or
+ * with a code the sender does not report, has a code of 0.
+ *
+ * @param requests	The requests to send
+ */
+void HttpSender::sendRequests(vector<HttpRequest>& requests)
+{
+	for (auto& request : requests)
+	{
+		try
+		{
+			request.httpCode = sendRequest(request.method,
+						       request.path,
+						       request.headers,
+						       request.payload);
+			request.response = getHTTPResponse();
+		}
+		catch (const BadRequest& e)
+		{
+			request.httpCode = 400;
+			request.response = e.what();
+		}
+		catch (const Unauthorized& e)
+		{
+			request.httpCode = 401;
+			request.response = e.what();
+		}
+		catch (const Conflict& e)
+		{
+			request.httpCode = 409;
+			request.response = e.what();
+		}
+		catch (const exception& e)
+		{
+			request.httpCode = 0;
+			request.response = e.what();
+		}
+	}
+}
@@ -12,11 +12,35 @@
 
 #include <string>
 #include <vector>
+#include <utility>
 
 #define HTTP_SENDER_USER_AGENT     "Fledge http sender"
 #define HTTP_SENDER_DEFAULT_METHOD "GET"
 #define HTTP_SENDER_DEFAULT_PATH   "/"
 
+/**
+ * A request sent, together with other requests, by
+ * HttpSender::sendRequests. The outcome is returned in the request.
+ */
+class HttpRequest
+{
+	public:
+		HttpRequest(const std::string& method,
+			    const std::string& path,
+			    const std::vector<std::pair<std::string, std::string>>& headers,
+			    std::string payload) :
+				method(method), path(path), headers(headers),
+				payload(std::move(payload)), httpCode(0) {};
+
+		std::string	method;
+		std::string	path;
+		std::vector<std::pair<std::string, std::string>>
+				headers;
+		std::string	payload;
+		int		httpCode;	// HTTP status code, 0 if no response was received
+		std::string	response;	// HTTP response or the reason the request failed
+};
+
 class HttpSender
 {
 	public:
@@ -43,6 +67,13 @@ class HttpSender
 				const std::string& payload = std::string()
 		) = 0;
 
+		/**
+		 * Send a set of independent requests, the default sends them
+		 * one after another. Requests are not guaranteed to complete
+		 * in order.
+		 */
+		virtual void sendRequests(std::vector<HttpRequest>& requests);
+
 		virtual std::string getHostPort() = 0;
 		virtual std::string getHTTPResponse() = 0;
 
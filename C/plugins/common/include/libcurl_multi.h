@@ -0,0 +1,112 @@
+#ifndef _LIBCURL_MULTI_H
+#define _LIBCURL_MULTI_H
+/*
+ * Fledge HTTP Sender wrapper.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <string>
+#include <vector>
+#include <http_sender.h>
+#include <curl/curl.h>
+#include <fstream>
+
+#define HTTP_MULTI_HEADER_LINE	255
+
+/**
+ * An HTTP and HTTPS sender that uses the libcurl multi interface to
+ * have a number of requests in flight at the same time. The easy handles
+ * and the connections of the multi handle are kept between requests so
+ * that the connections to the server are reused.
+ */
+class LibcurlMulti : public HttpSender
+{
+	public:
+		LibcurlMulti(const std::string& protocol,
+			     const std::string& host_port,
+			     unsigned int connect_timeout = 0,
+			     unsigned int request_timeout = 0,
+			     unsigned int retry_sleep_Time = 1,
+			     unsigned int max_retry = 4,
+			     unsigned int concurrency = 4);
+		~LibcurlMulti();
+
+		void		setProxy(const std::string& proxy) { m_proxy = proxy; };
+		int		sendRequest(
+					const std::string& method = std::string(HTTP_SENDER_DEFAULT_METHOD),
+					const std::string& path = std::string(HTTP_SENDER_DEFAULT_PATH),
+					const std::vector<std::pair<std::string, std::string>>& headers = {},
+					const std::string& payload = std::string());
+		void		sendRequests(std::vector<HttpRequest>& requests);
+
+		std::string	getHostPort() { return m_host_port; };
+		std::string	getHTTPResponse() { return m_HTTPResponse; };
+		unsigned int	getConcurrency() const { return m_concurrency; };
+
+		void setAuthMethod          (std::string& authMethod)           { m_authMethod = authMethod; };
+		void setAuthBasicCredentials(std::string& authBasicCredentials) { m_authBasicCredentials = authBasicCredentials; };
+
+		// OCS configurations
+		void setOCSNamespace        (std::string& OCSNamespace)         { m_OCSNamespace = OCSNamespace; };
+		void setOCSTenantId         (std::string& OCSTenantId)          { m_OCSTenantId = OCSTenantId; };
+		void setOCSClientId         (std::string& OCSClientId)          { m_OCSClientId = OCSClientId; };
+		void setOCSClientSecret     (std::string& OCSClientSecret)      { m_OCSClientSecret = OCSClientSecret; };
+		void setOCSToken            (std::string& OCSToken)             { m_OCSToken = OCSToken; };
+
+	private:
+		/**
+		 * A request that is in flight
+		 */
+		class Transfer {
+			public:
+				Transfer(CURL *handle, HttpRequest *request) :
+					handle(handle), request(request), headers(NULL)
+				{
+					status[0] = '\0';
+				};
+				CURL			*handle;
+				HttpRequest		*request;
+				struct curl_slist	*headers;
+				std::string		body;
+				char			status[HTTP_MULTI_HEADER_LINE];
+		};
+
+		LibcurlMulti(const LibcurlMulti&);
+		LibcurlMulti&	operator=(LibcurlMulti const &);
+
+		void		perform(std::vector<HttpRequest *>& requests);
+		Transfer	*start(HttpRequest *request);
+		void		complete(Transfer *transfer, CURLcode result);
+		CURL		*getHandle();
+
+	private:
+		CURLM			*m_multi;
+		std::vector<CURL *>	m_idle;			// Easy handles not in use
+		std::string		m_protocol;
+		std::string		m_host_port;
+		std::string		m_proxy;
+		std::string		m_HTTPResponse;
+		unsigned int		m_connect_timeout;
+		unsigned int		m_request_timeout;
+		unsigned int		m_retry_sleep_time;	// Seconds between each retry
+		unsigned int		m_max_retry;		// Max number of attempts of a request
+		unsigned int		m_concurrency;		// Max number of requests in flight
+		std::string		m_authMethod;
+		std::string		m_authBasicCredentials;
+
+		// OCS configurations
+		std::string		m_OCSNamespace;
+		std::string		m_OCSTenantId;
+		std::string		m_OCSClientId;
+		std::string		m_OCSClientSecret;
+		std::string		m_OCSToken;
+		std::ofstream		m_ofs;
+		bool			m_log;
+};
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ * Fledge HTTP Sender implementation using the multi interface of
+ * the libcurl library
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <thread>
+#include <chrono>
+#include <logger.h>
+#include <string.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <set>
+
+#include "libcurl_multi.h"
+#include "string_utils.h"
+
+using namespace std;
+
+/**
+ * Accumulate the body of the response to a request
+ */
+static size_t cb_body(char *buffer, size_t size, size_t nmemb, void *userp)
+{
+	((string *)userp)->append(buffer, size * nmemb);
+	return size * nmemb;
+}
+
+/**
+ * Keep the status line of the response. The last status line is kept
+ * as with Kerberos the final status line holds the real outcome.
+ *
+ * @param buffer	Header line, this is not zero terminated
+ * @param size		(nitems * size) is the size of buffer
+ * @param nitems
+ * @param userdata	The buffer for the status line
+ */
+static size_t cb_status(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	char *status = (char *)userdata;
+	size_t length = size * nitems;
+
+	if (*status == '\0' || (length >= 4 && strncasecmp(buffer, "HTTP", 4) == 0))
+	{
+		if (length > HTTP_MULTI_HEADER_LINE - 1)
+			length = HTTP_MULTI_HEADER_LINE - 1;
+		memcpy(status, buffer, length);
+		status[length] = '\0';
+	}
+	return size * nitems;
+}
+
+/**
+ * Constructor: protocol, host:port, connect_timeout, request_timeout,
+ *              retry_sleep_Time, max_retry and the maximum number of
+ *              requests in flight
+ *
+ * Logs the messages into omf.log if the file is present
+ */
+LibcurlMulti::LibcurlMulti(const string& protocol,
+			   const string& host_port,
+			   unsigned int connect_timeout,
+			   unsigned int request_timeout,
+			   unsigned int retry_sleep_Time,
+			   unsigned int max_retry,
+			   unsigned int concurrency) :
+			HttpSender(),
+			m_protocol(protocol),
+			m_host_port(host_port),
+			m_connect_timeout(connect_timeout),
+			m_request_timeout(request_timeout),
+			m_retry_sleep_time(retry_sleep_Time),
+			m_max_retry(max_retry),
+			m_concurrency(concurrency ? concurrency : 1)
+{
+	if (curl_global_init(CURL_GLOBAL_DEFAULT) != 0)
+	{
+		Logger::getLogger()->error("libcurl_multi - curl_global_init failed, the libcurl library cannot be initialized.");
+	}
+	m_multi = curl_multi_init();
+	if (!m_multi)
+	{
+		string errorMessage = "libcurl_multi - curl_multi_init failed, the libcurl library cannot be initialized.";
+		Logger::getLogger()->error(errorMessage);
+		throw runtime_error(errorMessage);
+	}
+	// Keep a connection for each request that may be in flight and
+	// multiplex requests over HTTP/2 connections when the server allows
+	curl_multi_setopt(m_multi, CURLMOPT_MAXCONNECTS, (long)m_concurrency);
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)m_concurrency);
+	curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+	char fname[180];
+	fname[0] = '\0';
+	if (getenv("FLEDGE_DATA"))
+		snprintf(fname, sizeof(fname), "%s/omf.log", getenv("FLEDGE_DATA"));
+	else if (getenv("FLEDGE_ROOT"))
+		snprintf(fname, sizeof(fname), "%s/data/omf.log", getenv("FLEDGE_ROOT"));
+	if (fname[0] && access(fname, W_OK) == 0)
+	{
+		m_log = true;
+		m_ofs.open(fname, ofstream::app);
+	}
+	else
+	{
+		m_log = false;
+	}
+}
+
+/**
+ * Destructor
+ */
+LibcurlMulti::~LibcurlMulti()
+{
+	for (CURL *handle : m_idle)
+	{
+		curl_easy_cleanup(handle);
+	}
+	curl_multi_cleanup(m_multi);
+	if (m_log)
+	{
+		m_ofs.close();
+	}
+	curl_global_cleanup();
+}
+
+/**
+ * Return an easy handle to use for a request. Handles are reused, once
+ * reset they keep their DNS and TLS session caches.
+ */
+CURL *LibcurlMulti::getHandle()
+{
+	if (m_idle.empty())
+	{
+		CURL *handle = curl_easy_init();
+		if (!handle)
+		{
+			string errorMessage = "libcurl_multi - curl_easy_init failed, the libcurl library cannot be initialized.";
+			Logger::getLogger()->error(errorMessage);
+			throw runtime_error(errorMessage);
+		}
+		return handle;
+	}
+	CURL *handle = m_idle.back();
+	m_idle.pop_back();
+	curl_easy_reset(handle);
+	return handle;
+}
+
+/**
+ * Set up the easy handle for a request and add it to the multi handle
+ *
+ * @param request	The request to start
+ * @return Transfer*	The request in flight
+ */
+LibcurlMulti::Transfer *LibcurlMulti::start(HttpRequest *request)
+{
+	Transfer *transfer = new Transfer(getHandle(), request);
+	CURL *handle = transfer->handle;
+
+	curl_easy_setopt(handle, CURLOPT_PRIVATE, transfer);
+	curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 1L);
+	curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(handle, CURLOPT_TIMEOUT, (long)m_request_timeout);
+	curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, (long)m_connect_timeout);
+	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, cb_body);
+	curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer->body);
+	curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, cb_status);
+	curl_easy_setopt(handle, CURLOPT_HEADERDATA, transfer->status);
+	if (!m_proxy.empty())
+	{
+		curl_easy_setopt(handle, CURLOPT_PROXY, m_proxy.c_str());
+	}
+
+	// HTTP headers handling
+	transfer->headers = curl_slist_append(transfer->headers, "User-Agent: " HTTP_SENDER_USER_AGENT);
+
+	// To let PI Web API having Cross-Site Request Forgery (CSRF) enabled as by default configuration
+	transfer->headers = curl_slist_append(transfer->headers, "X-Requested-With: XMLHttpRequest");
+
+	for (auto& header : request->headers)
+	{
+		string httpHeader = header.first + ": " + header.second;
+		transfer->headers = curl_slist_append(transfer->headers, httpHeader.c_str());
+	}
+	if (m_authMethod == "b")
+	{
+		string httpHeader = "Authorization: Basic " + m_authBasicCredentials;
+		transfer->headers = curl_slist_append(transfer->headers, httpHeader.c_str());
+	}
+	else if (!m_OCSToken.empty())
+	{
+		string httpHeader = "Authorization: Bearer " + m_OCSToken;
+		transfer->headers = curl_slist_append(transfer->headers, httpHeader.c_str());
+	}
+	curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer->headers);
+
+	if (m_authMethod == "k")
+	{
+		curl_easy_setopt(handle, CURLOPT_HTTPAUTH, CURLAUTH_GSSNEGOTIATE);
+		// The empty user should be defined for Kerberos authentication
+		curl_easy_setopt(handle, CURLOPT_USERPWD, ":");
+	}
+
+	string url = m_protocol + "://" + m_host_port + request->path;
+	curl_easy_setopt(handle, CURLOPT_URL, url.c_str());
+	if (m_protocol.compare("https") == 0)
+	{
+		curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, 0L);
+		curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, 0L);
+		curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+	}
+
+	if (request->method.compare("GET") == 0)
+	{
+		curl_easy_setopt(handle, CURLOPT_HTTPGET, 1L);
+	}
+	else
+	{
+		if (request->method.compare("POST") != 0)
+		{
+			curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request->method.c_str());
+		}
+		// The payload is not copied, the request outlives the transfer
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request->payload.c_str());
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, (long)request->payload.length());
+	}
+
+	if (m_log)
+	{
+		m_ofs << endl << request->method << " " << request->path << endl;
+		m_ofs << "Headers" << endl;
+		for (auto& header : request->headers)
+		{
+			m_ofs << "    " << header.first << ": " << header.second << endl;
+		}
+		m_ofs << "Payload:" << endl;
+		m_ofs << request->payload << endl;
+	}
+
+	curl_multi_add_handle(m_multi, handle);
+	return transfer;
+}
+
+/**
+ * Record the outcome of a transfer in its request and return the
+ * easy handle to the idle list
+ *
+ * @param transfer	The transfer that has completed
+ * @param result	The libcurl result of the transfer
+ */
+void LibcurlMulti::complete(Transfer *transfer, CURLcode result)
+{
+	HttpRequest *request = transfer->request;
+	long httpCode = 0;
+
+	curl_easy_getinfo(transfer->handle, CURLINFO_RESPONSE_CODE, &httpCode);
+
+	string status = transfer->status;
+	StringStripCRLF(status);
+	if (result != CURLE_OK)
+	{
+		request->httpCode = 0;
+		request->response = curl_easy_strerror(result);
+		if (!status.empty())
+			request->response += " - " + status;
+	}
+	else
+	{
+		request->httpCode = (int)httpCode;
+		request->response = transfer->body.empty() ? status : transfer->body;
+	}
+
+	if (m_log)
+	{
+		m_ofs << "Response:" << endl;
+		m_ofs << "   Path: " << request->path << endl;
+		m_ofs << "   Code: " << request->httpCode << endl;
+		m_ofs << "   Content: " << request->response << endl << endl;
+	}
+
+	curl_multi_remove_handle(m_multi, transfer->handle);
+	curl_slist_free_all(transfer->headers);
+	m_idle.push_back(transfer->handle);
+	delete transfer;
+}
+
+/**
+ * Make one attempt at each of the requests, keeping at most
+ * m_concurrency of them in flight
+ *
+ * @param requests	The requests to send
+ */
+void LibcurlMulti::perform(vector<HttpRequest *>& requests)
+{
+	set<Transfer *> inFlight;
+	size_t next = 0;
+
+	while (next < requests.size() || !inFlight.empty())
+	{
+		while (next < requests.size() && inFlight.size() < m_concurrency)
+		{
+			inFlight.insert(start(requests[next++]));
+		}
+
+		int running = 0;
+		CURLMcode rc = curl_multi_perform(m_multi, &running);
+
+		CURLMsg *msg;
+		int remaining;
+		while ((msg = curl_multi_info_read(m_multi, &remaining)) != NULL)
+		{
+			if (msg->msg == CURLMSG_DONE)
+			{
+				Transfer *transfer;
+				curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&transfer);
+				inFlight.erase(transfer);
+				complete(transfer, msg->data.result);
+			}
+		}
+
+		if (rc != CURLM_OK)
+		{
+			Logger::getLogger()->error("libcurl_multi - %s", curl_multi_strerror(rc));
+			break;
+		}
+		if (running > 0)
+		{
+			curl_multi_wait(m_multi, NULL, 0, 1000, NULL);
+		}
+	}
+
+	// Only reached with requests in flight if the multi handle failed
+	for (Transfer *transfer : inFlight)
+	{
+		complete(transfer, CURLE_SEND_ERROR);
+	}
+}
+
+/**
+ * Send a set of requests, with up to the configured number of requests
+ * in flight at the same time. Requests that fail are retried
+ * m_max_retry times, waiting m_retry_sleep_time*2 at each attempt.
+ *
+ * The HTTP status code and response of each request are returned in
+ * the request, a code of 0 means no response was received.
+ *
+ * @param requests	The requests to send
+ */
+void LibcurlMulti::sendRequests(vector<HttpRequest>& requests)
+{
+	vector<HttpRequest *> pending;
+	for (auto& request : requests)
+	{
+		pending.push_back(&request);
+	}
+
+	unsigned int retryCount = 1;
+	unsigned int sleepTime = m_retry_sleep_time;
+	while (true)
+	{
+		perform(pending);
+
+		vector<HttpRequest *> failed;
+		for (auto request : pending)
+		{
+			if (request->httpCode < 200 || request->httpCode > 399)
+			{
+				failed.push_back(request);
+			}
+		}
+		if (failed.empty() || retryCount >= m_max_retry)
+		{
+			break;
+		}
+		Logger::getLogger()->debug("libcurl_multi - %lu of %lu requests failed, retry %u",
+				(unsigned long)failed.size(), (unsigned long)pending.size(), retryCount);
+		this_thread::sleep_for(chrono::seconds(sleepTime));
+		sleepTime *= 2;
+		retryCount++;
+		pending = failed;
+	}
+
+	if (!requests.empty())
+	{
+		m_HTTPResponse = requests.back().response;
+	}
+}
+
+/**
+ * Send a single request, it retries the operation m_max_retry times
+ * waiting m_retry_sleep_time*2 at each attempt
+ *
+ * @param method    The HTTP method (GET, POST, ...)
+ * @param path      The URL path
+ * @param headers   The optional headers to send
+ * @param payload   The optional data payload (for POST, PUT)
+ * @return          The HTTP code for the cases : 1xx Informational /
+ *                                                2xx Success /
+ *                                                3xx Redirection
+ * @throw	    BadRequest for HTTP 400 error
+ *		    std::exception as generic exception for all the
+ *		    cases >= 401 Client errors / 5xx Server errors
+ */
+int LibcurlMulti::sendRequest(
+		const string& method,
+		const string& path,
+		const vector<pair<string, string>>& headers,
+		const string& payload
+)
+{
+	vector<HttpRequest> requests;
+	requests.emplace_back(method, path, headers, payload);
+	sendRequests(requests);
+
+	const HttpRequest& request = requests.front();
+	if (request.httpCode == 0)
+	{
+		throw runtime_error(request.response);
+	}
+	else if (request.httpCode == 400)
+	{
+		throw BadRequest(request.response);
+	}
+	else if (request.httpCode == 401)
+	{
+		throw Unauthorized(request.response);
+	}
+	else if (request.httpCode == 409)
+	{
+		throw Conflict(request.response);
+	}
+	else if (request.httpCode > 401)
+	{
+		throw runtime_error("HTTP code |" + to_string(request.httpCode) + "| - HTTP error |" + request.response + "|");
+	}
+	return request.httpCode;
+}
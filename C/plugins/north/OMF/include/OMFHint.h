@@ -1,8 +1,18 @@
 #ifndef _OMF_HINT_H
 #define _OMF_HINT_H
 
+#include <string>
+#include <vector>
+#include <map>
+#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <rapidjson/document.h>
 
+#define OMF_HINT_CACHE_SIZE	64	// The initial number of distinct parsed hints held by the hint cache
+#define OMF_HINT_CACHE_MAX	16384	// The number of distinct hints the hint cache may grow to
+
 /**
  * Virtual base class for an OMF Hint
  */
@@ -158,11 +168,50 @@ class OMFHints
 		const std::vector<OMFHint *>&
 					getHints(const std::string&) const;
 		const unsigned short	getChecksum() { return m_chksum; };
-		static string          	getHintForChecksum(const string &hint);
+		static std::string     	getHintForChecksum(const std::string &hint);
 	private:
 		rapidjson::Document	m_doc;
 		unsigned short		m_chksum;
 		std::vector<OMFHint *>	m_hints;
 		std::map<std::string, std::vector<OMFHint *> > m_datapointHints;
 };
+
+/**
+ * A least recently used cache of parsed OMF hints keyed by the hint
+ * string. The readings of an asset usually carry the same OMFHint
+ * datapoint, the cache saves parsing the same hint for every reading.
+ *
+ * The hints are shared so that a hint evicted from the cache remains
+ * valid for a reading that is still using it. The cache is not thread
+ * safe, it belongs to the OMF instance of the sending thread.
+ *
+ * The cache grows with the number of distinct hints in use: a miss on a
+ * hint that the cache has evicted doubles the size of the cache, up to a
+ * maximum. Without this a block that cycles through more distinct hints
+ * than the cache holds would never hit.
+ */
+class OMFHintCache
+{
+	public:
+		OMFHintCache(size_t size = OMF_HINT_CACHE_SIZE,
+				size_t maxSize = OMF_HINT_CACHE_MAX);
+		std::shared_ptr<OMFHints>
+					find(const std::string& hint);
+		void			clear();
+		unsigned long		getHits() const { return m_hits; };
+		unsigned long		getMisses() const { return m_misses; };
+		size_t			getSize() const { return m_size; };
+	private:
+		typedef std::list<std::pair<std::string, std::shared_ptr<OMFHints> > >
+					HintList;
+		size_t			m_size;
+		size_t			m_maxSize;
+		HintList		m_lru;		// Most recently used first
+		std::unordered_map<std::string, HintList::iterator>
+					m_index;
+		std::unordered_set<std::string>
+					m_evicted;	// Hints evicted while the cache may grow
+		unsigned long		m_hits;
+		unsigned long		m_misses;
+};
 #endif
@@ -28,6 +28,8 @@ typedef enum {
 class LALookup {
 	public:
 		LALookup()	{ m_sentState = 0; m_baseType = OMFBT_UNKNOWN; };
+		LALookup(uint8_t sentState, OMFBaseType baseType, const std::string& tagName) :
+				m_sentState(sentState), m_baseType(baseType), m_tagName(tagName) {};
 		bool		assetState(const std::string& tagName)
 				{
 					return ((m_sentState & LAL_ASSET_SENT) != 0)
@@ -45,7 +47,10 @@ class LALookup {
 				};
 		bool		afLinkState() { return (m_sentState & LAL_AFLINK_SENT) != 0; };
 		void		setBaseType(const std::string& baseType);
-		OMFBaseType	getBaseType() { return m_baseType; };
+		OMFBaseType	getBaseType() const { return m_baseType; };
+		uint8_t		getSentState() const { return m_sentState; };
+		const std::string&
+				getTagName() const { return m_tagName; };
 		std::string	getBaseTypeString();
 		void		assetSent(const std::string& tagName)
 				{
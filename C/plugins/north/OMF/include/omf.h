@@ -13,12 +13,16 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include <unordered_set>
+#include <memory>
 #include <reading.h>
 #include <http_sender.h>
 #include <zlib.h>
 #include <rapidjson/document.h>
 #include <omfbuffer.h>
 #include <linkedlookup.h>
+#include <OMFHint.h>
+#include <omfcompressor.h>
 
 #define	OMF_HINT	"OMFHint"
 
@@ -86,6 +90,7 @@ class OMFDataTypes
 };
 
 class OMFHints;
+class OMFDataChunk;
 
 /**
  * The OMF class.
@@ -193,6 +198,9 @@ class OMF
 
 		void setSendFullStructure(const bool sendFullStructure) {m_sendFullStructure = sendFullStructure;};
 
+		// Set the number of data messages that may be in flight at once, a block of readings is split by asset when more than one
+		void setConcurrentRequests(unsigned int concurrentRequests) {m_concurrentRequests = concurrentRequests ? concurrentRequests : 1;};
+
 		void setPrefixAFAsset(const std::string &prefixAFAsset);
 
 		// Get saved OMF formats
@@ -214,7 +222,8 @@ class OMF
 
 		// Map object types found in input data
 		void setMapObjectTypes(const std::vector<Reading *>& data,
-					std::map<std::string, Reading*>& dataSuperSet);
+					std::map<std::string, Reading*>& dataSuperSet,
+					const std::vector<std::shared_ptr<OMFHints>> *hints = NULL);
 		// Removed mapped object types found in input data
 		void unsetMapObjectTypes(std::map<std::string, Reading*>& dataSuperSet) const;
 
@@ -234,6 +243,16 @@ class OMF
 
 		void setLegacyMode(bool legacy) { m_legacy = legacy; };
 
+		// Restore the linked data state persisted by a previous execution
+		void		setLinkedState(const std::unordered_map<std::string, LALookup>& linkedState,
+					bool baseTypesSent);
+		const std::unordered_map<std::string, LALookup>&
+				getLinkedState() const { return m_linkedAssetState; };
+		bool		getBaseTypesSent() const { return m_baseTypesSent; };
+
+		// Report the sizes of the compressed payloads to the performance monitor
+		void		setPerfMonitor(PerformanceMonitor *perfMonitor) { m_compressor.setPerfMonitor(perfMonitor); };
+
 		static std::string ApplyPIServerNamingRulesObj(const std::string &objName, bool *changed);
 		static std::string ApplyPIServerNamingRulesPath(const std::string &objName, bool *changed);
 		static std::string ApplyPIServerNamingRulesInvalidChars(const std::string &objName, bool *changed);
@@ -355,6 +374,16 @@ private:
 		// Start of support for using linked containers
 		bool sendBaseTypes();
 		bool sendAFLinks(Reading& reading, OMFHints *hints);
+		bool sendBlockAFLinks(const std::vector<Reading *>& readings,
+					const std::vector<std::shared_ptr<OMFHints>>& hints,
+					bool& AFHierarchySent);
+		std::shared_ptr<OMFHints>
+		     readingHints(const Reading& reading);
+		uint32_t sendDataChunks(const std::vector<std::unique_ptr<OMFDataChunk>>& chunks,
+					const std::vector<std::pair<std::string, std::string>>& header,
+					bool compression, uint32_t count);
+		void linkedStateAccepted(const std::unordered_set<std::string>& assets);
+		void linkedStateRejected(const std::unordered_set<std::string>& assets);
 		// End of support for using linked containers
 		//
 		string createAFLinks(Reading &reading, OMFHints *hints);
@@ -492,6 +521,11 @@ private:
 		std::unordered_map<std::string, LALookup>
 					m_linkedAssetState;
 
+		/**
+		 * The parsed OMFHints of recent readings
+		 */
+		OMFHintCache		m_hintCache;
+
 		/**
 		 * Force the data to be sent using the legacy, complex OMF types
 		 */
@@ -512,6 +546,29 @@ private:
 		 * Have base types been sent to the PI Server
 		 */
 		bool			m_baseTypesSent;
+
+		/**
+		 * The number of data messages that may be in flight at once
+		 */
+		unsigned int		m_concurrentRequests;
+
+		/**
+		 * The keys of the restored linked data state of each asset
+		 * whose data the endpoint has not yet accepted
+		 */
+		std::unordered_map<std::string, std::vector<std::string>>
+					m_restoredAssets;
+
+		/**
+		 * The base types were restored and the endpoint has not
+		 * yet accepted data that relies on them
+		 */
+		bool			m_baseTypesRestored;
+
+		/**
+		 * The compressor used for all the payloads sent to the endpoint
+		 */
+		OMFCompressor		m_compressor;
 };
 
 /**
@@ -537,4 +594,23 @@ class OMFData
 		bool	m_hasData;
 };
 
+/**
+ * The data messages for the readings of a single asset within a block.
+ * A block is split into chunks when several data messages may be in
+ * flight at once.
+ */
+class OMFDataChunk
+{
+	public:
+		OMFDataChunk(const std::string& assetName, uint32_t first) :
+			assetName(assetName), first(first), pendingSeparator(false)
+		{
+			payload.append('[');
+		};
+		std::string	assetName;
+		uint32_t	first;		// Index in the block of the first reading of the chunk
+		bool		pendingSeparator;
+		OMFBuffer	payload;
+};
+
 #endif
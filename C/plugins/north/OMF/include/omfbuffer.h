@@ -12,6 +12,7 @@
 
 #include <string>
 #include <list>
+#include <zlib.h>
 
 #define BUFFER_CHUNK	8192
 
@@ -19,7 +20,8 @@
  * Buffer class designed to hold OMF payloads that can
  * grow as required but have minimal copy semantics.
  *
- * TODO Add a coalesce and compress public entry point
+ * The payload may be taken as a string, with a single copy, or compressed
+ * directly from the chunks of the buffer without first being coalesced.
  */
 class OMFBuffer {
 	class Buffer {
@@ -49,6 +51,10 @@ class OMFBuffer {
 		void			append(const std::string&);
 		void			quote(const std::string&);
 		const char		*coalesce();
+		void			coalesce(std::string& payload);
+		std::string		compress(int level = Z_DEFAULT_COMPRESSION);
+		std::string		compress(z_stream& stream);
+		size_t			length();
 		void			clear();
 
 	private:
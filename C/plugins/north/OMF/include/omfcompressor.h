@@ -0,0 +1,56 @@
+#ifndef _OMF_COMPRESSOR_H
+#define _OMF_COMPRESSOR_H
+/*
+ * Fledge OMF North plugin payload compressor
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <string>
+#include <atomic>
+#include <zlib.h>
+#include <omfbuffer.h>
+
+class PerformanceMonitor;
+class PerfMon;
+
+/**
+ * Compressor for the payloads sent to an OMF endpoint using gzip encoding.
+ *
+ * The deflate stream is created once and reset between payloads, rather
+ * than being created and destroyed for every message, this saves the
+ * allocation and initialisation of the compression state for each request.
+ * The number of bytes before and after compression are counted and may be
+ * reported as performance monitors.
+ */
+class OMFCompressor {
+	public:
+		OMFCompressor(int level = Z_DEFAULT_COMPRESSION);
+		~OMFCompressor();
+		std::string	compress(OMFBuffer& payload);
+		std::string	compress(const std::string& payload);
+		void		setPerfMonitor(PerformanceMonitor *perfMonitor);
+		uint64_t	getUncompressedBytes() const { return m_uncompressed; };
+		uint64_t	getCompressedBytes() const { return m_compressed; };
+	private:
+		void		resetStream();
+		void		countPayload(size_t uncompressed, size_t compressed);
+	private:
+		z_stream	m_stream;
+		int		m_level;
+		bool		m_initialised;
+		std::atomic<uint64_t>
+				m_uncompressed;
+		std::atomic<uint64_t>
+				m_compressed;
+		PerformanceMonitor
+				*m_perfMonitor;
+		PerfMon		*m_uncompressedMon;
+		PerfMon		*m_compressedMon;
+};
+
+#endif
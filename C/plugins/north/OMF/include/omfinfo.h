@@ -27,6 +27,7 @@
 #include "rapidjson/stringbuffer.h"
 #include "json_utils.h"
 #include "libcurl_https.h"
+#include "libcurl_multi.h"
 #include "utils.h"
 #include "string_utils.h"
 #include <version.h>
@@ -44,6 +45,10 @@
 #define AFH_HASH "afhHash"
 #define AF_HIERARCHY "afHierarchy"
 #define AF_HIERARCHY_ORIG "afHierarchyOrig"
+#define LINKED_STATE_KEY "linkedState"
+#define LINKED_ENDPOINT_KEY "endpoint"
+#define LINKED_BASE_TYPES_KEY "baseTypes"
+#define LINKED_ASSETS_KEY "assets"
 
 
 #define PROPERTY_TYPE   "type"
@@ -108,8 +113,12 @@ class OMFInformation {
 		void		start(const std::string& storedData);
 		uint32_t	send(const vector<Reading *>& readings);
 		std::string	saveData();
+		void		setPerfMonitor(PerformanceMonitor *perfMonitor);
 	private:
 		void 		loadSentDataTypes(rapidjson::Document& JSONData);
+		void		loadLinkedState(rapidjson::Document& JSONData);
+		std::string	saveLinkedState();
+		std::string	linkedStateEndpoint();
 		long		getMaxTypeId();
 		int		PIWebAPIGetVersion(bool logMessage = true);
 		int		EDSGetVersion();
@@ -136,6 +145,7 @@ class OMFInformation {
 		unsigned int	m_retrySleepTime;     	// Seconds between each retry
 		unsigned int	m_maxRetry;	        // Max number of retries in the communication
 		unsigned int	m_timeout;	        // connect and operation timeout
+		unsigned int	m_concurrentRequests;	// Data messages that may be in flight at once
 		string		m_path;		        // PI Server application path
 		long		m_typeId;		        // OMF protocol type-id prefix
 		string		m_producerToken;	        // PI Server connector token
@@ -176,9 +186,15 @@ class OMFInformation {
 		// Per asset DataTypes
 		std::map<std::string, OMFDataTypes>
 				m_assetsDataTypes;
+		// Linked data state loaded from the data persisted by a previous execution
+		std::unordered_map<std::string, LALookup>
+				m_linkedAssetState;
+		bool		m_baseTypesSent;
 		string		m_omfversion;
 		bool		m_legacy;
 		string		m_name;
 		bool		m_connected;
+		PerformanceMonitor
+				*m_perfMonitor;
 };
 #endif
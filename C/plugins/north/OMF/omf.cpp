@@ -246,7 +246,9 @@ OMF::OMF(const string& name,
 	 m_legacy(false),
 	 m_name(name),
 	 m_baseTypesSent(false),
-	 m_linkedProperties(true)
+	 m_linkedProperties(true),
+	 m_concurrentRequests(1),
+	 m_baseTypesRestored(false)
 {
 	m_lastError = false;
 	m_changeTypeId = false;
@@ -269,7 +271,9 @@ OMF::OMF(const string& name,
 	 m_sender(sender),
 	 m_name(name),
 	 m_baseTypesSent(false),
-	 m_linkedProperties(true)
+	 m_linkedProperties(true),
+	 m_concurrentRequests(1),
+	 m_baseTypesRestored(false)
 {
 	// Get starting type-id sequence or set the default value
 	auto it = (*m_OMFDataTypes).find(FAKE_ASSET_KEY);
@@ -1132,7 +1136,15 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	// the superset[assetName] is then passed to routines which handles
 	// creation of OMF data types. This is used for the initial type
 	// handling of complex data types.
-	OMF::setMapObjectTypes(readings, m_SuperSetDataPoints);
+	//
+	// The OMFHints of each reading are resolved once for the block
+	vector<shared_ptr<OMFHints>> blockHints;
+	blockHints.reserve(readings.size());
+	for (Reading *reading : readings)
+	{
+		blockHints.push_back(readingHints(*reading));
+	}
+	OMF::setMapObjectTypes(readings, m_SuperSetDataPoints, &blockHints);
 
 #if INSTRUMENT
 	gettimeofday(&t1, NULL);
@@ -1177,6 +1189,15 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 	OMFBuffer payload;
 	payload.append('[');
+
+	// When several data messages may be in flight the data of each
+	// asset is built as a chunk that is sent as a separate message
+	vector<unique_ptr<OMFDataChunk>> chunks;
+	unordered_map<string, OMFDataChunk *> assetChunks;
+
+	// The assets of the block whose restored linked data state is unconfirmed
+	unordered_set<string> restoredAssets;
+
 	// Fetch Reading* data
 	for (vector<Reading *>::const_iterator elem = readings.begin();
 						    elem != readings.end();
@@ -1185,15 +1206,13 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 		Reading *reading = *elem;
 		OMFHintAFHierarchy = "";
 
-		// Fetch and parse any OMFHint for this reading
-		Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-		OMFHints *hints = NULL;
+		// The parsed OMFHint for this reading
+		OMFHints *hints = blockHints[elem - readings.begin()].get();
 		bool usingTagHint = false;
 		long typeId = 0;
-		if (hintsdp)
+		if (hints)
 		{
-			hints = new OMFHints(hintsdp->getData().toString());
-			const vector<OMFHint *> omfHints = hints->getHints();
+			const vector<OMFHint *>& omfHints = hints->getHints();
 			for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 			{
 				if (typeid(**it) == typeid(OMFTagHint))
@@ -1232,6 +1251,24 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 				Logger::getLogger()->info("%s -  3 Asset name changed to follow PI-Server naming rules from :%s: to :%s:", __FUNCTION__, assetNameFledge.c_str(), m_assetName.c_str() );
 			}
 		}
+		if (m_restoredAssets.count(m_assetName))
+		{
+			restoredAssets.insert(m_assetName);
+		}
+
+		OMFBuffer *out = &payload;
+		bool *separator = &pendingSeparator;
+		if (m_concurrentRequests > 1)
+		{
+			auto chunk = assetChunks.find(m_assetName);
+			if (chunk == assetChunks.end())
+			{
+				chunks.emplace_back(new OMFDataChunk(m_assetName, elem - readings.begin()));
+				chunk = assetChunks.emplace(m_assetName, chunks.back().get()).first;
+			}
+			out = &chunk->second->payload;
+			separator = &chunk->second->pendingSeparator;
+		}
 
 		// Since hints are attached to individual readings that are processed by the north plugin if an AFLocation
 		// hint is present it will override any default AFLocation or AF Location rules defined in the north plugin configuration.
@@ -1383,9 +1420,9 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 			measurementId = generateMeasurementId(m_assetName);
 
-			if (OMFData(payload, *reading, measurementId, pendingSeparator, m_PIServerEndpoint, AFHierarchyPrefix, hints).hasData())
+			if (OMFData(*out, *reading, measurementId, *separator, m_PIServerEndpoint, AFHierarchyPrefix, hints).hasData())
 			{
-				pendingSeparator = true;
+				*separator = true;
 			}
 
 			sendLinkedTypes = false;
@@ -1396,16 +1433,11 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			// in the processReading call
 			auto lookup = m_linkedAssetState.find(m_assetName + ".");
 			// Send data for this reading using the new mechanism
-			if (linkedData.processReading(payload, pendingSeparator, *reading, AFHierarchyPrefix, hints))
-				pendingSeparator = true;
+			if (linkedData.processReading(*out, *separator, *reading, AFHierarchyPrefix, hints))
+				*separator = true;
 
 			sendLinkedTypes = true;
 		}
-
-		if (hints)
-		{
-			delete hints;
-		}
 	}
 
 #if INSTRUMENT
@@ -1417,14 +1449,6 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 	payload.append(']');
 
-	// TODO Improve this with coalesceCompressed call and avoid string on the stack
-	// and avoid copy into a string
-	const char *omfData = payload.coalesce();
-
-#if INSTRUMENT
-	gettimeofday(&t3, NULL);
-#endif
-
 	vector<pair<string, string>> containerHeader = OMF::createMessageHeader("Container");
 	linkedData.flushContainers(m_sender, m_path, containerHeader);
 
@@ -1441,15 +1465,47 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 	if (compression)
 		readingData.push_back(pair<string, string>("compression", "gzip"));
 
+	if (m_concurrentRequests > 1)
+	{
+		// The data is in the chunks
+		uint32_t sent = sendDataChunks(chunks, readingData, compression, readings.size());
+		if (sent < readings.size())
+		{
+			return sent;
+		}
+		if (sendLinkedTypes && m_sendFullStructure && !sendBlockAFLinks(readings, blockHints, AFHierarchySent))
+		{
+			return 0;
+		}
+		return sent;
+	}
+
 	// Build an HTTPS POST with 'readingData headers
 	// and 'allReadings' JSON payload
 	// Then get HTTPS POST ret code and return 0 to client on error
+	string omfData;
 	try
 	{
+		// The payload is compressed, or copied into the string that is
+		// sent, directly from the buffer chain without coalescing it first
+		if (compression)
+		{
+			omfData = m_compressor.compress(payload);
+		}
+		else
+		{
+			payload.coalesce(omfData);
+		}
+		payload.clear();
+
+#if INSTRUMENT
+		gettimeofday(&t3, NULL);
+#endif
+
 		int res = m_sender.sendRequest("POST",
 					       m_path,
 					       readingData,
-					       compression ? compress_string(omfData) : omfData);
+					       omfData);
 		if  ( ! (res >= 200 && res <= 299) )
 		{
 			Logger::getLogger()->error("Sending JSON readings , "
@@ -1458,12 +1514,13 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 						   m_sender.getHostPort().c_str(),
 						   m_path.c_str()
 						   );
-			delete[] omfData;
 			m_lastError = true;
 			return 0;
 		}
 		// Reset error indicator
 		m_lastError = false;
+		// The endpoint has the containers the restored linked data state refers to
+		linkedStateAccepted(restoredAssets);
 
 #if INSTRUMENT
 		gettimeofday(&t4, NULL);
@@ -1495,13 +1552,12 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 								   timeT3,
 								   timeT4,
 								   readings.size(),
-								   strlen(omfData)
+								   omfData.length()
 		);
 
 #endif
 
 
-		delete[] omfData;
 	}
 	// Exception raised for HTTP 400 Bad Request
 	catch (const BadRequest& e)
@@ -1572,7 +1628,6 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 							  );
 			}
 
-			delete[] omfData;
 			// Reset error indicator
 			m_lastError = false;
 
@@ -1589,7 +1644,7 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 			                           m_sender.getHostPort().c_str(),
 			                           m_path.c_str()
 									   );
-			delete[] omfData;
+			linkedStateRejected(restoredAssets);
 		}
 		// Failure
 		m_lastError = true;
@@ -1607,53 +1662,287 @@ uint32_t OMF::sendToServer(const vector<Reading *>& readings,
 
 		// Failure
 		m_lastError = true;
-		delete[] omfData;
 		return 0;
 	}
 
 	// Create the AF Links between assets if AF structure creation with linked types is requested
-	if (sendLinkedTypes && m_sendFullStructure)
+	if (sendLinkedTypes && m_sendFullStructure && !sendBlockAFLinks(readings, blockHints, AFHierarchySent))
+	{
+		return 0;
+	}
+
+	// Return number of sent readings to the caller
+	return readings.size();
+}
+
+/**
+ * Create the AF Links between the assets of a block of readings and
+ * the AF hierarchy for those assets whose links have not yet been sent
+ *
+ * @param readings		The block of readings
+ * @param hints			The parsed OMFHints of each reading
+ * @param AFHierarchySent	Set if the AF hierarchy has been sent
+ * @return			True if the links have been sent
+ */
+bool OMF::sendBlockAFLinks(const vector<Reading *>& readings,
+			   const vector<shared_ptr<OMFHints>>& blockHints,
+			   bool& AFHierarchySent)
+{
+	for (size_t i = 0; i < readings.size(); i++)
 	{
-		for (Reading *reading : readings)
+		Reading *reading = readings[i];
+		OMFHints *hints = blockHints[i].get();
+
+		m_assetName = ApplyPIServerNamingRulesObj(reading->getAssetName(), nullptr);
+		auto lookup = m_linkedAssetState.find(m_assetName + ".");
+		if (lookup->second.afLinkState() == false)
 		{
-			OMFHints *hints = NULL;
-			Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-			if (hintsdp)
+			// If the hierarchy has not already been sent then send it
+			if (!AFHierarchySent)
 			{
-				hints = new OMFHints(hintsdp->getData().toString());
+				if (!handleAFHierarchy())
+				{
+					m_lastError = true;
+					return false;
+				}
+				AFHierarchySent = true;
 			}
 
-			m_assetName = ApplyPIServerNamingRulesObj(reading->getAssetName(), nullptr);
-			auto lookup = m_linkedAssetState.find(m_assetName + ".");
-			if (lookup->second.afLinkState() == false)
+			if (!sendAFLinks(*reading, hints))
 			{
-				// If the hierarchy has not already been sent then send it
-				if (!AFHierarchySent)
-				{
-					if (!handleAFHierarchy())
-					{
-						m_lastError = true;
-						delete hints;
-						return 0;
-					}
-					AFHierarchySent = true;
-				}
+				m_lastError = true;
+				return false;
+			}
+			lookup->second.afLinkSent();
+		}
+	}
+	return true;
+}
 
-				if (!sendAFLinks(*reading, hints))
+/**
+ * Return the parsed OMFHint of a reading. The hint cache means the hint
+ * is only parsed the first time it is seen.
+ *
+ * @param reading	The reading
+ * @return		The parsed hints or an empty pointer if the reading has no OMFHint
+ */
+shared_ptr<OMFHints> OMF::readingHints(const Reading& reading)
+{
+	Datapoint *hintsdp = reading.getDatapoint(OMF_HINT);
+	if (!hintsdp)
+	{
+		return shared_ptr<OMFHints>();
+	}
+	return m_hintCache.find(hintsdp->getData().toString());
+}
+
+/**
+ * Send the data messages of a block of readings that has been split
+ * into a chunk per asset. The chunks are sent as independent requests so
+ * that the sender may have several of them in flight at once. The types
+ * and containers have already been created.
+ *
+ * As the chunks may fail independently the number of readings returned
+ * is the number of readings at the start of the block whose chunks have
+ * all been sent. Readings beyond this point may have been sent and will
+ * be sent again with the remainder of the block.
+ *
+ * @param chunks	The chunks, in the order of their first reading
+ * @param header	The HTTP headers for the data messages
+ * @param compression	If true, compress the payload of each message
+ * @param count		The number of readings in the block
+ * @return		The number of readings sent
+ */
+uint32_t OMF::sendDataChunks(const vector<unique_ptr<OMFDataChunk>>& chunks,
+			     const vector<pair<string, string>>& header,
+			     bool compression, uint32_t count)
+{
+	vector<HttpRequest> requests;
+	vector<OMFDataChunk *> sending;
+	requests.reserve(chunks.size());
+	for (auto& chunk : chunks)
+	{
+		if (!chunk->pendingSeparator)
+		{
+			// No data for this asset
+			continue;
+		}
+		sending.push_back(chunk.get());
+		chunk->payload.append(']');
+		string omfData;
+		if (compression)
+		{
+			omfData = m_compressor.compress(chunk->payload);
+		}
+		else
+		{
+			chunk->payload.coalesce(omfData);
+		}
+		chunk->payload.clear();
+		requests.emplace_back("POST", m_path, header, std::move(omfData));
+	}
+
+	m_sender.sendRequests(requests);
+
+	uint32_t sent = count;
+	for (unsigned int i = 0; i < requests.size(); i++)
+	{
+		const HttpRequest& request = requests[i];
+		if (request.httpCode >= 200 && request.httpCode <= 299)
+		{
+			continue;
+		}
+
+		string errorMsg = errorMessageHandler(request.response);
+		if (request.httpCode == 400 && OMF::isDataTypeError(request.response.c_str()))
+		{
+			// Some assets have invalid or redefined data type, this is
+			// a not blocking issue, the readings are considered as sent
+			Logger::getLogger()->warn("Sending JSON readings of asset %s, "
+						  "not blocking issue: %s - %s %s",
+						  sending[i]->assetName.c_str(),
+						  errorMsg.c_str(),
+						  m_sender.getHostPort().c_str(),
+						  m_path.c_str());
+			if (m_PIServerEndpoint == ENDPOINT_CR)
+			{
+				string assetName = OMF::getAssetNameFromError(request.response.c_str());
+				if (!assetName.empty())
 				{
-					m_lastError = true;
-					delete hints;
-					return 0;
+					// Remove data and keep type-id
+					OMF::clearCreatedTypes(assetName);
 				}
-				lookup->second.afLinkSent();
 			}
+			continue;
+		}
 
-			delete hints;
+		Logger::getLogger()->error("Sending JSON data of asset %s error : HTTP code |%d| %s - %s %s",
+					   sending[i]->assetName.c_str(),
+					   request.httpCode,
+					   errorMsg.c_str(),
+					   m_sender.getHostPort().c_str(),
+					   m_path.c_str());
+		if (request.httpCode == 400)
+		{
+			linkedStateRejected({ sending[i]->assetName });
+		}
+		if (sending[i]->first < sent)
+		{
+			sent = sending[i]->first;
 		}
 	}
 
-	// Return number of sent readings to the caller
-	return readings.size();
+	// The data of the remaining chunks was accepted
+	for (unsigned int i = 0; i < requests.size(); i++)
+	{
+		if (requests[i].httpCode >= 200 && requests[i].httpCode <= 299)
+		{
+			linkedStateAccepted({ sending[i]->assetName });
+		}
+	}
+
+	m_lastError = (sent < count);
+	return sent;
+}
+
+/**
+ * Restore the linked data state persisted by a previous execution of
+ * the plugin. The containers, links and base types it records as sent
+ * are not sent again unless the endpoint rejects the data that relies
+ * on them.
+ *
+ * The keys of the state are the asset name followed by a dot, and the
+ * asset name, a dot and a datapoint name. The keys are grouped by asset
+ * so that the state of an asset may be discarded on its own.
+ *
+ * @param linkedState	The linked data state of each asset and datapoint
+ * @param baseTypesSent	The base types have been sent to the endpoint
+ */
+void OMF::setLinkedState(const unordered_map<string, LALookup>& linkedState, bool baseTypesSent)
+{
+	m_linkedAssetState = linkedState;
+	m_baseTypesSent = baseTypesSent;
+	m_baseTypesRestored = baseTypesSent;
+	m_restoredAssets.clear();
+
+	for (auto& item : linkedState)
+	{
+		const string& key = item.first;
+		if (!key.empty() && key.back() == '.')
+		{
+			m_restoredAssets[key.substr(0, key.length() - 1)].push_back(key);
+		}
+	}
+	for (auto& item : linkedState)
+	{
+		// The asset names may themselves contain dots, the datapoint
+		// belongs to the longest asset name that prefixes the key
+		const string& key = item.first;
+		if (key.empty() || key.back() == '.')
+		{
+			continue;
+		}
+		size_t dot = key.rfind('.');
+		while (dot != string::npos && dot > 0)
+		{
+			auto asset = m_restoredAssets.find(key.substr(0, dot));
+			if (asset != m_restoredAssets.end())
+			{
+				asset->second.push_back(key);
+				break;
+			}
+			dot = key.rfind('.', dot - 1);
+		}
+	}
+}
+
+/**
+ * The endpoint has accepted data of a number of assets, the restored
+ * linked data state of those assets and the base types is confirmed.
+ *
+ * @param assets	The assets whose data was accepted
+ */
+void OMF::linkedStateAccepted(const unordered_set<string>& assets)
+{
+	m_baseTypesRestored = false;
+	for (auto& asset : assets)
+	{
+		m_restoredAssets.erase(asset);
+	}
+}
+
+/**
+ * The endpoint has rejected data of a number of assets. The endpoint may
+ * have been reset or the data deleted from it since the linked data state
+ * was restored, so discard the unconfirmed restored state of those assets
+ * in order that their containers and links are sent again with the next
+ * block of data. The base types are also sent again if the endpoint has
+ * not accepted any data since they were restored.
+ *
+ * @param assets	The assets whose data was rejected
+ */
+void OMF::linkedStateRejected(const unordered_set<string>& assets)
+{
+	if (m_baseTypesRestored)
+	{
+		Logger::getLogger()->warn("The OMF endpoint rejected data sent using the base types restored from a previous execution, the base types will be sent again");
+		m_baseTypesSent = false;
+		m_baseTypesRestored = false;
+	}
+	for (auto& asset : assets)
+	{
+		auto restored = m_restoredAssets.find(asset);
+		if (restored == m_restoredAssets.end())
+		{
+			continue;
+		}
+		Logger::getLogger()->warn("The OMF endpoint rejected data of asset '%s' sent using the linked data state restored from a previous execution, its containers and links will be sent again", asset.c_str());
+		for (auto& key : restored->second)
+		{
+			m_linkedAssetState.erase(key);
+		}
+		m_restoredAssets.erase(restored);
+	}
 }
 
 /**
@@ -1704,13 +1993,8 @@ uint32_t OMF::sendToServer(const vector<Reading>& readings,
 						    ++elem)
 	{
 		bool sendDataTypes;
-		OMFHints *hints = NULL;
-
-		Datapoint *hintsdp = elem->getDatapoint(OMF_HINT);
-		if (hintsdp)
-		{
-			hints = new OMFHints(hintsdp->getData().toString());
-		}
+		shared_ptr<OMFHints> readingHint = readingHints(*elem);
+		OMFHints *hints = readingHint.get();
 
 		// Create the key for dataTypes sending once
 		m_assetName = ApplyPIServerNamingRulesObj((*elem).getAssetName(), nullptr);
@@ -1817,12 +2101,8 @@ uint32_t OMF::sendToServer(const Reading* reading,
 	measurementId = generateMeasurementId(m_assetName);
 
 
-	Datapoint *hintsdp = reading->getDatapoint("OMFHint");
-	OMFHints *hints = NULL;
-	if (hintsdp)
-	{
-		hints = new OMFHints(hintsdp->getData().toString());
-	}
+	shared_ptr<OMFHints> readingHint = readingHints(*reading);
+	OMFHints *hints = readingHint.get();
 	if (!OMF::handleDataTypes(key, *reading, skipSentDataTypes, hints))
 	{
 		// Failure
@@ -3616,9 +3896,11 @@ bool OMF::handleTypeErrors(const string& keyComplete, const Reading& reading, OM
  *  
  * @param    readings		Current input readings data
  * @param    dataSuperSet	Map to store all datapoints for an assetname
+ * @param    hints		The parsed OMFHints of each reading, if already resolved
  */
 void OMF::setMapObjectTypes(const vector<Reading*>& readings,
-			    std::map<std::string, Reading*>& dataSuperSet)
+			    std::map<std::string, Reading*>& dataSuperSet,
+			    const vector<shared_ptr<OMFHints>> *hints)
 {
 	// Temporary map for [asset][datapoint] = type
 	std::map<string, map<string, string>> readingAllDataPoints;
@@ -3634,6 +3916,10 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 
 		//string assetName = (**elem).getAssetName();
 
+		// The OMFHint of the reading, resolved once for all its datapoints
+		shared_ptr<OMFHints> readingHint = hints ? (*hints)[elem - readings.begin()]
+							 : readingHints(**elem);
+
 		// Get all datapoints
 		const vector<Datapoint*> data = (**elem).getReadingData();
 		// Iterate through datapoints
@@ -3654,27 +3940,17 @@ void OMF::setMapObjectTypes(const vector<Reading*>& readings,
 				omfType = omfTypes[((*it)->getData()).getType()];
 
 				// if an OMF hint is applied the type may change
+				if (readingHint && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
 				{
-					Reading *reading = *elem;
-
-					// Fetch and parse any OMFHint for this reading
-					Datapoint *hintsdp = reading->getDatapoint("OMFHint");
+					const vector<OMFHint *>& omfHints = readingHint->getHints();
 
-					if (hintsdp && (omfType == OMF_TYPE_FLOAT || omfType == OMF_TYPE_INTEGER))
+					for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
 					{
-						OMFHints *hints = new OMFHints(hintsdp->getData().toString());
-						const vector<OMFHint *> omfHints = hints->getHints();
-
-						for (auto it = omfHints.cbegin(); it != omfHints.cend(); it++)
+						if (typeid(**it) == typeid(OMFIntegerHint))
 						{
-							if (typeid(**it) == typeid(OMFIntegerHint))
-							{
-								omfType = OMF_TYPE_INTEGER;
-								break;
-							}
+							omfType = OMF_TYPE_INTEGER;
+							break;
 						}
-
-						delete hints;
 					}
 				}
 
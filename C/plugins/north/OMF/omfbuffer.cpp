@@ -10,6 +10,7 @@
 #include <omfbuffer.h>
 #include <string.h>
 #include <string_utils.h>
+#include <stdexcept>
 
 using namespace std;
 /**
@@ -295,6 +296,114 @@ char	     *buffer = 0;
 	return buffer;
 }
 
+/**
+ * Return the length of the payload held in the buffer chain
+ *
+ * @return size_t	The length of the payload
+ */
+size_t OMFBuffer::length()
+{
+size_t length = 0;
+
+	for (list<OMFBuffer::Buffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		length += (*it)->offset;
+	}
+	return length;
+}
+
+/**
+ * Coalesce the buffer chain into a string. The payload is copied once,
+ * directly into the string that is sent.
+ *
+ * @param payload	The string to populate with the OMF payload
+ */
+void OMFBuffer::coalesce(string& payload)
+{
+	payload.clear();
+	payload.reserve(length());
+	for (list<OMFBuffer::Buffer *>::iterator it = buffers.begin(); it != buffers.end(); ++it)
+	{
+		payload.append((*it)->data, (*it)->offset);
+	}
+}
+
+/**
+ * Compress the payload using gzip encoding with a deflate stream that
+ * is created for this payload alone.
+ *
+ * @param level		The zlib compression level
+ * @return string	The gzip compressed payload
+ */
+string OMFBuffer::compress(int level)
+{
+	const int windowBits = 15;
+	const int GZIP_ENCODING = 16;
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+
+	if (deflateInit2(&zs, level, Z_DEFLATED,
+			windowBits | GZIP_ENCODING, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw runtime_error("deflateInit failed while compressing.");
+	}
+
+	string compressed;
+	try {
+		compressed = compress(zs);
+	} catch (...) {
+		deflateEnd(&zs);
+		throw;
+	}
+	deflateEnd(&zs);
+	return compressed;
+}
+
+/**
+ * Compress the payload using a deflate stream that has been initialised,
+ * or reset, by the caller. Each buffer in the chain is passed to zlib in
+ * turn, the payload is never coalesced.
+ *
+ * @param zs		The deflate stream
+ * @return string	The compressed payload
+ */
+string OMFBuffer::compress(z_stream& zs)
+{
+	string compressed;
+	char outbuffer[32768];
+	int ret = Z_OK;
+	list<OMFBuffer::Buffer *>::iterator it = buffers.begin();
+	zs.avail_in = 0;
+	do {
+		int flush = Z_NO_FLUSH;
+		if (zs.avail_in == 0)
+		{
+			if (it != buffers.end())
+			{
+				zs.next_in = (Bytef *)(*it)->data;
+				zs.avail_in = (*it)->offset;
+				++it;
+			}
+		}
+		if (it == buffers.end())
+		{
+			flush = Z_FINISH;
+		}
+		zs.next_out = (Bytef *)outbuffer;
+		zs.avail_out = sizeof(outbuffer);
+		ret = deflate(&zs, flush);
+		compressed.append(outbuffer, sizeof(outbuffer) - zs.avail_out);
+	} while (ret == Z_OK || ret == Z_BUF_ERROR);
+
+	if (ret != Z_STREAM_END)
+	{
+		throw runtime_error("Exception during zlib compression: (" + to_string(ret) + ")");
+	}
+	return compressed;
+}
+
 /**
  * Construct a buffer with a standard size initial buffer.
  */
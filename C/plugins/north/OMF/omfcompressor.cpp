@@ -0,0 +1,143 @@
+/*
+ * Fledge OMF north plugin payload compressor
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <omfcompressor.h>
+#include <perfmonitors.h>
+#include <string.h>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ * OMFCompressor constructor
+ *
+ * @param level	The zlib compression level
+ */
+OMFCompressor::OMFCompressor(int level) : m_level(level), m_initialised(false),
+	m_uncompressed(0), m_compressed(0), m_perfMonitor(NULL),
+	m_uncompressedMon(NULL), m_compressedMon(NULL)
+{
+	memset(&m_stream, 0, sizeof(m_stream));
+}
+
+/**
+ * OMFCompressor destructor, release the deflate stream
+ */
+OMFCompressor::~OMFCompressor()
+{
+	if (m_initialised)
+	{
+		deflateEnd(&m_stream);
+	}
+}
+
+/**
+ * Prepare the deflate stream for a new payload. The stream is created
+ * when the first payload is compressed and reset for each payload after
+ * that, a reset stream writes a new gzip header and keeps no history of
+ * the previous payload, so each payload can be decompressed alone.
+ */
+void OMFCompressor::resetStream()
+{
+	const int windowBits = 15;
+	const int GZIP_ENCODING = 16;
+
+	if (m_initialised)
+	{
+		if (deflateReset(&m_stream) == Z_OK)
+		{
+			return;
+		}
+		deflateEnd(&m_stream);
+		m_initialised = false;
+	}
+	memset(&m_stream, 0, sizeof(m_stream));
+	if (deflateInit2(&m_stream, m_level, Z_DEFLATED,
+			windowBits | GZIP_ENCODING, 8,
+			Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw runtime_error("deflateInit failed while compressing.");
+	}
+	m_initialised = true;
+}
+
+/**
+ * Compress the payload held in an OMF buffer using gzip encoding
+ *
+ * @param payload	The payload to compress
+ * @return string	The gzip compressed payload
+ */
+string OMFCompressor::compress(OMFBuffer& payload)
+{
+	resetStream();
+	string result = payload.compress(m_stream);
+	countPayload(m_stream.total_in, result.length());
+	return result;
+}
+
+/**
+ * Compress a payload using gzip encoding
+ *
+ * @param payload	The payload to compress
+ * @return string	The gzip compressed payload
+ */
+string OMFCompressor::compress(const string& payload)
+{
+	resetStream();
+
+	m_stream.next_in = (Bytef *)payload.data();
+	m_stream.avail_in = payload.length();
+
+	string result;
+	char outbuffer[32768];
+	int ret;
+	do {
+		m_stream.next_out = (Bytef *)outbuffer;
+		m_stream.avail_out = sizeof(outbuffer);
+		ret = deflate(&m_stream, Z_FINISH);
+		result.append(outbuffer, sizeof(outbuffer) - m_stream.avail_out);
+	} while (ret == Z_OK);
+
+	if (ret != Z_STREAM_END)
+	{
+		throw runtime_error("Exception during zlib compression: (" + to_string(ret) + ")");
+	}
+	countPayload(payload.length(), result.length());
+	return result;
+}
+
+/**
+ * Set the performance monitor to which the sizes of the payloads
+ * before and after compression are reported
+ *
+ * @param perfMonitor	The performance monitor
+ */
+void OMFCompressor::setPerfMonitor(PerformanceMonitor *perfMonitor)
+{
+	m_uncompressedMon = perfMonitor->getMonitor("Uncompressed payload bytes");
+	m_compressedMon = perfMonitor->getMonitor("Compressed payload bytes");
+	m_perfMonitor = perfMonitor;
+}
+
+/**
+ * Count a compressed payload
+ *
+ * @param uncompressed	The size of the payload before compression
+ * @param compressed	The size of the compressed payload
+ */
+void OMFCompressor::countPayload(size_t uncompressed, size_t compressed)
+{
+	m_uncompressed += uncompressed;
+	m_compressed += compressed;
+	if (m_perfMonitor)
+	{
+		m_perfMonitor->collect(m_uncompressedMon, uncompressed);
+		m_perfMonitor->collect(m_compressedMon, compressed);
+	}
+}
@@ -338,3 +338,82 @@ const vector<OMFHint *>& OMFHints::getHints(const string& datapoint) const
 	}
 	return m_hints;
 }
+
+/**
+ * Construct a cache of parsed OMF hints
+ *
+ * @param size		The initial number of hints to hold
+ * @param maxSize	The number of hints the cache may grow to hold
+ */
+OMFHintCache::OMFHintCache(size_t size, size_t maxSize) : m_size(size),
+	m_maxSize(maxSize), m_hits(0), m_misses(0)
+{
+	if (m_size == 0)
+	{
+		m_size = 1;
+	}
+	if (m_maxSize < m_size)
+	{
+		m_maxSize = m_size;
+	}
+}
+
+/**
+ * Return the parsed form of an OMF hint, parsing the hint only if it is
+ * not already in the cache. If the cache is full it grows when the hint is
+ * one it has evicted, otherwise the least recently used hint is discarded.
+ *
+ * @param hint	The OMFHint datapoint value
+ * @return	The parsed hints
+ */
+shared_ptr<OMFHints> OMFHintCache::find(const string& hint)
+{
+	auto it = m_index.find(hint);
+	if (it != m_index.end())
+	{
+		m_hits++;
+		if (it->second != m_lru.begin())
+		{
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+		}
+		return it->second->second;
+	}
+	m_misses++;
+	if (m_lru.size() >= m_size && m_size < m_maxSize
+			&& m_evicted.find(hint) != m_evicted.end())
+	{
+		// The distinct hints in use do not fit in the cache
+		m_size = m_size * 2 < m_maxSize ? m_size * 2 : m_maxSize;
+		m_evicted.erase(hint);
+		if (m_size == m_maxSize)
+		{
+			m_evicted.clear();
+		}
+	}
+	if (m_lru.size() >= m_size)
+	{
+		if (m_size < m_maxSize)
+		{
+			if (m_evicted.size() >= m_maxSize)
+			{
+				m_evicted.clear();
+			}
+			m_evicted.insert(m_lru.back().first);
+		}
+		m_index.erase(m_lru.back().first);
+		m_lru.pop_back();
+	}
+	m_lru.emplace_front(hint, make_shared<OMFHints>(hint));
+	m_index.emplace(hint, m_lru.begin());
+	return m_lru.front().second;
+}
+
+/**
+ * Discard all the cached hints
+ */
+void OMFHintCache::clear()
+{
+	m_index.clear();
+	m_lru.clear();
+	m_evicted.clear();
+}
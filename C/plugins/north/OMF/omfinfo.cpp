@@ -16,7 +16,7 @@ using namespace SimpleWeb;
 /**
  * Constructor for the OMFInformation class
  */
-OMFInformation::OMFInformation(ConfigCategory *config) : m_sender(NULL), m_omf(NULL), m_connected(false)
+OMFInformation::OMFInformation(ConfigCategory *config) : m_sender(NULL), m_omf(NULL), m_baseTypesSent(false), m_connected(false), m_perfMonitor(NULL)
 {
 
 	m_logger = Logger::getLogger();
@@ -102,6 +102,11 @@ OMFInformation::OMFInformation(ConfigCategory *config) : m_sender(NULL), m_omf(N
 	unsigned int retrySleepTime = atoi(config->getValue("OMFRetrySleepTime").c_str());
 	unsigned int maxRetry = atoi(config->getValue("OMFMaxRetry").c_str());
 	unsigned int timeout = atoi(config->getValue("OMFHttpTimeout").c_str());
+	unsigned int concurrentRequests = 1;
+	if (config->itemExists("OMFConcurrentRequests"))
+	{
+		concurrentRequests = atoi(config->getValue("OMFConcurrentRequests").c_str());
+	}
 
 	string producerToken = config->getValue("producerToken");
 
@@ -151,6 +156,7 @@ OMFInformation::OMFInformation(ConfigCategory *config) : m_sender(NULL), m_omf(N
 	m_retrySleepTime = retrySleepTime;
 	m_maxRetry = maxRetry;
 	m_timeout = timeout;
+	m_concurrentRequests = concurrentRequests ? concurrentRequests : 1;
 	m_typeId = TYPE_ID_DEFAULT;
 	m_producerToken = producerToken;
 	m_formatNumber = formatNumber;
@@ -328,6 +334,9 @@ void OMFInformation::start(const string& storedData)
 	// Load sentdataTypes
 	loadSentDataTypes(JSONData);
 
+	// Load the linked data state
+	loadLinkedState(JSONData);
+
 	// Log default type-id
 	if (m_assetsDataTypes.size() == 1 &&
 	    m_assetsDataTypes.find(FAKE_ASSET_KEY) != m_assetsDataTypes.end())
@@ -417,10 +426,23 @@ uint32_t OMFInformation::send(const vector<Reading *>& readings)
 		 * SimpleHttps, as appropriate for the URL given, if not using Kerberos
 		 *
 		 *
+		 * LibcurlMulti is used, for all authentication methods, when more than one data
+		 * message may be in flight at once.
+		 *
 		 * The handler is allocated using "Hostname : port", connect_timeout and request_timeout.
 		 * Default is no timeout
 		 */
-		if (m_PIWebAPIAuthMethod.compare("k") == 0)
+		if (m_concurrentRequests > 1)
+		{
+			m_sender = new LibcurlMulti(m_protocol,
+						    m_hostAndPort,
+						    m_timeout,
+						    m_timeout,
+						    m_retrySleepTime,
+						    m_maxRetry,
+						    m_concurrentRequests);
+		}
+		else if (m_PIWebAPIAuthMethod.compare("k") == 0)
 		{
 			m_sender = new LibcurlHttps(m_hostAndPort,
 							    m_timeout,
@@ -479,6 +501,7 @@ uint32_t OMFInformation::send(const vector<Reading *>& readings)
 				m_producerToken);
 
 		m_omf->setSendFullStructure(m_sendFullStructure);
+		m_omf->setConcurrentRequests(m_concurrentRequests);
 
 		// Set PIServerEndpoint configuration
 		m_omf->setNamingScheme(m_NamingScheme);
@@ -512,6 +535,16 @@ uint32_t OMFInformation::send(const vector<Reading *>& readings)
 		{
 			m_omf->setLegacyMode(m_legacy);
 		}
+
+		if (!m_linkedAssetState.empty())
+		{
+			m_omf->setLinkedState(m_linkedAssetState, m_baseTypesSent);
+			m_linkedAssetState.clear();
+		}
+		if (m_perfMonitor)
+		{
+			m_omf->setPerfMonitor(m_perfMonitor);
+		}
 	}
 	// Send the readings data to the PI Server
 	uint32_t ret = m_omf->sendToServer(readings, m_compression);
@@ -536,6 +569,21 @@ uint32_t OMFInformation::send(const vector<Reading *>& readings)
 	return ret;
 }
 
+/**
+ * Set the performance monitor of the north service, the plugin reports
+ * the sizes of the payloads it compresses
+ *
+ * @param perfMonitor	The performance monitor
+ */
+void OMFInformation::setPerfMonitor(PerformanceMonitor *perfMonitor)
+{
+	m_perfMonitor = perfMonitor;
+	if (m_omf)
+	{
+		m_omf->setPerfMonitor(perfMonitor);
+	}
+}
+
 /**
  * Return the data to be persisted
  * @return string	The data to persist
@@ -563,6 +611,13 @@ string OMFInformation::saveData()
 		saveData << "\"" << TYPE_ID_KEY << "\": " << to_string(m_typeId);
 	}
 
+	// Add the linked data state
+	string linkedState = saveLinkedState();
+	if (!linkedState.empty())
+	{
+		saveData << ", " << linkedState;
+	}
+
 	saveData << "}";
 
         // Log saving the plugin configuration
@@ -1141,6 +1196,146 @@ string OMFInformation::saveSentDataTypes()
 }
 
 
+/**
+ * Load the linked data state persisted by a previous execution of the
+ * plugin. This records the containers, links and base types that have
+ * already been sent to the endpoint, restoring it means a restart does not
+ * send them again for every asset and datapoint.
+ *
+ * The state is discarded if it was saved when sending to a different
+ * endpoint or with a different Asset Framework configuration.
+ *
+ * @param   JSONData	The JSON document containing all saved data
+ */
+void OMFInformation::loadLinkedState(Document& JSONData)
+{
+	if (!JSONData.HasMember(LINKED_STATE_KEY) ||
+	    !JSONData[LINKED_STATE_KEY].IsObject())
+	{
+		return;
+	}
+	const Value& linkedState = JSONData[LINKED_STATE_KEY];
+	if (!linkedState.HasMember(LINKED_ENDPOINT_KEY) ||
+	    !linkedState[LINKED_ENDPOINT_KEY].IsString() ||
+	    linkedStateEndpoint().compare(linkedState[LINKED_ENDPOINT_KEY].GetString()) != 0)
+	{
+		m_logger->info("The OMF endpoint configuration has changed, the linked data containers and links will be sent again");
+		return;
+	}
+	if (!linkedState.HasMember(LINKED_ASSETS_KEY) ||
+	    !linkedState[LINKED_ASSETS_KEY].IsObject())
+	{
+		return;
+	}
+
+	const Value& assets = linkedState[LINKED_ASSETS_KEY];
+	for (Value::ConstMemberIterator it = assets.MemberBegin();
+					it != assets.MemberEnd();
+					++it)
+	{
+		const Value& item = it->value;
+		if (!item.IsArray() || item.Size() != 3 ||
+		    !item[0].IsUint() || !item[1].IsUint() || !item[2].IsString() ||
+		    item[1].GetUint() > OMFBT_FLEDGEASSET)
+		{
+			m_logger->warn("Ignoring the saved linked data state of '%s', it is not valid",
+					it->name.GetString());
+			continue;
+		}
+		m_linkedAssetState.emplace(string(it->name.GetString(), it->name.GetStringLength()),
+				LALookup((uint8_t)item[0].GetUint(),
+					(OMFBaseType)item[1].GetUint(),
+					item[2].GetString()));
+	}
+	m_baseTypesSent = linkedState.HasMember(LINKED_BASE_TYPES_KEY) &&
+			linkedState[LINKED_BASE_TYPES_KEY].IsBool() &&
+			linkedState[LINKED_BASE_TYPES_KEY].GetBool();
+
+	m_logger->info("%s plugin has restored the linked data state of %lu assets and datapoints",
+			PLUGIN_NAME,
+			m_linkedAssetState.size());
+}
+
+/**
+ * Return the linked data state to persist as a JSON object member. Only
+ * the assets and datapoints for which something has been sent are saved.
+ *
+ * @return	The JSON linked data state or an empty string if there is none
+ */
+string OMFInformation::saveLinkedState()
+{
+	const unordered_map<string, LALookup>& state = m_omf ?
+				m_omf->getLinkedState() : m_linkedAssetState;
+	bool baseTypesSent = m_omf ? m_omf->getBaseTypesSent() : m_baseTypesSent;
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	writer.StartObject();
+	writer.Key(LINKED_ENDPOINT_KEY);
+	writer.String(linkedStateEndpoint().c_str());
+	writer.Key(LINKED_BASE_TYPES_KEY);
+	writer.Bool(baseTypesSent);
+	writer.Key(LINKED_ASSETS_KEY);
+	writer.StartObject();
+	bool found = false;
+	for (auto& item : state)
+	{
+		if (item.second.getSentState() == 0)
+		{
+			continue;
+		}
+		writer.Key(item.first.c_str(), item.first.length());
+		writer.StartArray();
+		writer.Uint(item.second.getSentState());
+		writer.Uint(item.second.getBaseType());
+		writer.String(item.second.getTagName().c_str(), item.second.getTagName().length());
+		writer.EndArray();
+		found = true;
+	}
+	writer.EndObject();
+	writer.EndObject();
+
+	if (!found)
+	{
+		return "";
+	}
+	return string("\"") + LINKED_STATE_KEY + "\": " + buffer.GetString();
+}
+
+/**
+ * Return the 64 bit FNV-1a hash of a string. Unlike std::hash the value
+ * is the same for every build, so it may be persisted.
+ *
+ * @param str	The string to hash
+ * @return	The hash of the string
+ */
+static uint64_t fnv1aHash(const string& str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (unsigned char c : str)
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+/**
+ * Return an identifier of the endpoint and of the configuration that
+ * determines the containers and links that are created in it. The linked
+ * data state is only valid for the same identifier.
+ *
+ * @return	The endpoint identifier
+ */
+string OMFInformation::linkedStateEndpoint()
+{
+	string configuration = m_path + "|" + m_OCSNamespace + "|"
+		+ to_string(m_NamingScheme) + "|" + m_DefaultAFLocation + "|" + m_AFMap;
+	std::stringstream endpoint;
+	endpoint << m_hostAndPort << "/" << std::hex << fnv1aHash(configuration);
+	return endpoint.str();
+}
+
 /**
  * Calculate the TypeShort in the case it is missing loading type definition
  *
@@ -204,6 +204,16 @@ const char *PLUGIN_DEFAULT_CONFIG_INFO = QUOTE(
 			"group": "Formats & Types",
 			"displayName": "Number Format"
 		},
+		"OMFConcurrentRequests": {
+			"description": "The number of data messages that may be in flight at once, a block of readings is split into a message per asset when this is more than one",
+			"type": "integer",
+			"default": "1",
+			"minimum": "1",
+			"maximum": "32",
+			"order": "30",
+			"group": "Connection",
+			"displayName": "Concurrent Requests"
+		},
 		"compression": {
 			"description": "Compress readings data before sending to PI server",
 			"type": "boolean",
@@ -354,7 +364,7 @@ extern "C" {
 static PLUGIN_INFORMATION info = {
 	PLUGIN_NAME,			   // Name
 	VERSION,			   // Version
-	SP_PERSIST_DATA | SP_BUILTIN,	   // Flags
+	SP_PERSIST_DATA | SP_BUILTIN | SP_PERFMON,	   // Flags
 	PLUGIN_TYPE_NORTH,		   // Type
 	"1.0.0",			   // Interface version
 	PLUGIN_DEFAULT_CONFIG_INFO	   // Configuration
@@ -425,6 +435,18 @@ void plugin_start(const PLUGIN_HANDLE handle,
 #endif
 }
 
+/**
+ * Register the performance monitor of the north service with the plugin
+ *
+ * @param handle	The plugin handle
+ * @param perfMonitor	The performance monitor
+ */
+void plugin_perfmon(const PLUGIN_HANDLE handle, PerformanceMonitor *perfMonitor)
+{
+	OMFInformation *info = (OMFInformation *)handle;
+	info->setPerfMonitor(perfMonitor);
+}
+
 /**
  * Send Readings data to historian server
  */
@@ -27,6 +27,9 @@
 #include <algorithm>
 #include <math.h>
 #include <sys/time.h>
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <reading_stream_payload.h>
 
 #include "json_utils.h"
 
@@ -1572,14 +1575,226 @@ bool Connection::formatDate(char *formatted_date, size_t buffer_size, const char
 
 
 /**
- * Append a set of readings to the readings table
+ * The signature that starts a binary format COPY stream
+ */
+static const char copySignature[] = { 'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0' };
+
+/**
+ * The number of seconds between the Unix epoch and the
+ * Postgres epoch of 2000-01-01 00:00:00 UTC
+ */
+#define POSTGRES_EPOCH_OFFSET	946684800L
+
+/**
+ * Append integers to a binary COPY stream in network byte order
+ */
+static inline void copyInt16(string& buffer, int16_t value)
+{
+	uint16_t n = htons((uint16_t)value);
+	buffer.append((const char *)&n, sizeof(n));
+}
+
+static inline void copyInt32(string& buffer, int32_t value)
+{
+	uint32_t n = htonl((uint32_t)value);
+	buffer.append((const char *)&n, sizeof(n));
+}
+
+static inline void copyInt64(string& buffer, int64_t value)
+{
+	copyInt32(buffer, (int32_t)((uint64_t)value >> 32));
+	copyInt32(buffer, (int32_t)((uint64_t)value & 0xffffffff));
+}
+
+/**
+ * Convert a date, as formatted by formatDate, to a Postgres binary
+ * timestamp, the number of microseconds since the Postgres epoch.
+ *
+ * @param date		The date in the form YYYY-MM-DD HH:MM:SS.ffffff+HH:MM
+ * @param timestamp	The Postgres timestamp
+ * @return		False if the date could not be converted
+ */
+bool Connection::postgresTimestamp(const char *date, int64_t& timestamp)
+{
+struct tm	tm;
+
+	memset(&tm, 0, sizeof(tm));
+	const char *p = strptime(date, "%Y-%m-%d %H:%M:%S", &tm);
+	if (!p)
+	{
+		return false;
+	}
+
+	long usec = 0;
+	if (*p == '.')
+	{
+		int digits = 0;
+		for (p++; isdigit(*p); p++)
+		{
+			if (digits < 6)
+			{
+				usec = usec * 10 + (*p - '0');
+				digits++;
+			}
+		}
+		while (digits++ < 6)
+			usec *= 10;
+	}
+
+	long offset = 0;
+	if (*p == '+' || *p == '-')
+	{
+		int hours = 0, minutes = 0;
+		sscanf(p + 1, "%d:%d", &hours, &minutes);
+		offset = (hours * 60 + minutes) * 60;
+		if (*p == '-')
+			offset = -offset;
+	}
+
+	timestamp = ((int64_t)(timegm(&tm) - offset) - POSTGRES_EPOCH_OFFSET) * 1000000 + usec;
+	return true;
+}
+
+/**
+ * Start a binary format COPY into the readings table
+ *
+ * @param operation	The operation, used to report errors
+ * @return		False if the COPY could not be started
+ */
+bool Connection::copyReadingsStart(const char *operation)
+{
+	const char *query = "COPY fledge.readings ( asset_code, reading, user_ts ) FROM STDIN WITH ( FORMAT binary );";
+
+	logSQL("ReadingsCopy", query);
+	PGresult *res = PQexec(dbConnection, query);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+	{
+		raiseError(operation, PQerrorMessage(dbConnection));
+		PQclear(res);
+		return false;
+	}
+	PQclear(res);
+
+	m_copyBuffer.clear();
+	m_copyBuffer.append(copySignature, sizeof(copySignature));
+	copyInt32(m_copyBuffer, 0);	// Flags
+	copyInt32(m_copyBuffer, 0);	// Header extension length
+	return true;
+}
+
+/**
+ * Add a reading to the binary COPY buffer. The asset code and the
+ * reading are passed as they are, no quoting or escaping is required.
+ *
+ * @param assetCode		The asset code of the reading
+ * @param assetCodeLength	The length of the asset code
+ * @param reading		The JSON datapoints of the reading
+ * @param readingLength		The length of the JSON
+ * @param userTs		The user timestamp as a Postgres timestamp
+ */
+void Connection::copyReading(const char *assetCode, size_t assetCodeLength,
+			const char *reading, size_t readingLength,
+			int64_t userTs)
+{
+	copyInt16(m_copyBuffer, 3);	// Number of columns
+
+	copyInt32(m_copyBuffer, assetCodeLength);
+	m_copyBuffer.append(assetCode, assetCodeLength);
+
+	// The binary jsonb format is a version number followed by the JSON text
+	copyInt32(m_copyBuffer, readingLength + 1);
+	m_copyBuffer.push_back('\001');
+	m_copyBuffer.append(reading, readingLength);
+
+	copyInt32(m_copyBuffer, sizeof(int64_t));
+	copyInt64(m_copyBuffer, userTs);
+}
+
+/**
+ * Send the buffered readings to the server
+ *
+ * @param operation	The operation, used to report errors
+ * @return		False if the data could not be sent
+ */
+bool Connection::copyReadingsFlush(const char *operation)
+{
+	if (m_copyBuffer.empty())
+	{
+		return true;
+	}
+	if (PQputCopyData(dbConnection, m_copyBuffer.data(), m_copyBuffer.size()) != 1)
+	{
+		raiseError(operation, PQerrorMessage(dbConnection));
+		copyReadingsAbort("Failed to send readings");
+		return false;
+	}
+	m_copyBuffer.clear();
+	return true;
+}
+
+/**
+ * Complete the COPY into the readings table
+ *
+ * @param operation	The operation, used to report errors
+ * @return		False if the readings could not be stored
+ */
+bool Connection::copyReadingsEnd(const char *operation)
+{
+	copyInt16(m_copyBuffer, -1);	// Trailer
+	if (!copyReadingsFlush(operation))
+	{
+		return false;
+	}
+	if (PQputCopyEnd(dbConnection, NULL) != 1)
+	{
+		raiseError(operation, PQerrorMessage(dbConnection));
+		copyReadingsAbort(NULL);
+		return false;
+	}
+
+	bool rval = true;
+	PGresult *res;
+	while ((res = PQgetResult(dbConnection)) != NULL)
+	{
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		{
+			raiseError(operation, PQresultErrorMessage(res));
+			rval = false;
+		}
+		PQclear(res);
+	}
+	return rval;
+}
+
+/**
+ * Abandon a COPY that is in progress, none of the readings
+ * that have been sent will be stored.
+ *
+ * @param reason	The reason for abandoning the COPY or NULL if it has already ended
+ */
+void Connection::copyReadingsAbort(const char *reason)
+{
+	if (reason)
+	{
+		PQputCopyEnd(dbConnection, reason);
+	}
+	PGresult *res;
+	while ((res = PQgetResult(dbConnection)) != NULL)
+	{
+		PQclear(res);
+	}
+	m_copyBuffer.clear();
+}
+
+/**
+ * Append a set of readings to the readings table. The readings are
+ * sent to Postgres using a binary COPY, which avoids the cost of
+ * building and parsing a large INSERT statement.
  */
 int Connection::appendReadings(const char *readings)
 {
 Document 	doc;
-SQLBuffer	sql;
 int		row = 0;
-bool 		add_row = false;
 
 	ParseResult ok = doc.Parse(readings);
 	if (!ok)
@@ -1599,132 +1814,154 @@ bool 		add_row = false;
 		raiseError("appendReadings", "Payload is missing the readings array");
 		return -1;
 	}
-
-	const char *head = "INSERT INTO fledge.readings ( user_ts, asset_code, reading ) VALUES ";
-	sql.append(head);
-
-	int count = 0;
 	for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
 	{
-		if (count == m_maxReadingRows)
-		{
-			sql.append(';');
-
-			const char *query = sql.coalesce();
-			logSQL("ReadingsAppend", query);
-			PGresult *res = PQexec(dbConnection, query);
-			delete[] query;
-			if (PQresultStatus(res) != PGRES_COMMAND_OK)
-			{
-				raiseError("appendReadings", PQerrorMessage(dbConnection));
-				PQclear(res);
-				return -1;
-			}
-			PQclear(res);
-
-			sql.clear();
-			sql.append(head);
-			count = 0;
-		}
 		if (!itr->IsObject())
 		{
 			raiseError("appendReadings",
 					"Each reading in the readings array must be an object");
 			return -1;
 		}
-		add_row = true;
-		const char *asset_code = (*itr)["asset_code"].GetString();
-		if (strlen(asset_code) == 0)
+	}
+
+	if (!copyReadingsStart("appendReadings"))
+	{
+		return -1;
+	}
+
+	StringBuffer buffer;
+	int count = 0;
+	for (Value::ConstValueIterator itr = rdings.Begin(); itr != rdings.End(); ++itr)
+	{
+		const Value& asset_code = (*itr)["asset_code"];
+		if (asset_code.GetStringLength() == 0)
 		{
 			Logger::getLogger()->warn("Postgres appendReadings - empty asset code value, row is ignored");
 			continue;
 		}
 
+		int64_t user_ts;
 		const char *str = (*itr)["user_ts"].GetString();
 		// Check if the string is a function
 		if (isFunction(str))
 		{
-			if (count)
-				sql.append(", (");
-			else
-				sql.append('(');
-
-			sql.append(str);
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			user_ts = ((int64_t)now.tv_sec - POSTGRES_EPOCH_OFFSET) * 1000000 + now.tv_usec;
 		}
 		else
 		{
 			char formatted_date[LEN_BUFFER_DATE] = {0};
-			if (! formatDate(formatted_date, sizeof(formatted_date), str) )
+			if (! formatDate(formatted_date, sizeof(formatted_date), str) ||
+					! postgresTimestamp(formatted_date, user_ts))
 			{
 				raiseError("appendReadings", "Invalid date |%s|", str);
-				add_row = false;
-			}
-			else
-			{
-				if (count)
-				{
-					sql.append(", (");
-				}
-				else
-				{
-					sql.append('(');
-				}
-
-				sql.append('\'');
-				sql.append(formatted_date);
-				sql.append('\'');
+				continue;
 			}
 		}
 
-		if (add_row)
-		{
-			row++;
-			count++;
-
-			// Handles - asset_code
-			sql.append(",\'");
-			sql.append(asset_code);
-			sql.append("', '");
+		// Handles - reading
+		buffer.Clear();
+		Writer<StringBuffer> writer(buffer);
+		(*itr)["reading"].Accept(writer);
 
-			// Handles - reading
-			StringBuffer buffer;
-			Writer<StringBuffer> writer(buffer);
-			(*itr)["reading"].Accept(writer);
-			sql.append(escape(buffer.GetString()));
-			sql.append("\' ");
+		copyReading(asset_code.GetString(), asset_code.GetStringLength(),
+				buffer.GetString(), buffer.GetSize(), user_ts);
+		row++;
 
-			sql.append(')');
+		if (++count == m_maxReadingRows)
+		{
+			if (!copyReadingsFlush("appendReadings"))
+			{
+				return -1;
+			}
+			count = 0;
 		}
 	}
 
-	if (count == 0)
+	if (!copyReadingsEnd("appendReadings"))
 	{
-		// No rows in final block
-		return 0;
+		return -1;
 	}
-	sql.append(';');
+	return row;
+}
 
-	const char *query = sql.coalesce();
+/**
+ * Append a block of readings received on a reading stream to the
+ * readings table. The readings are sent using a binary COPY, the
+ * asset codes and timestamps are passed to Postgres as they are held
+ * in the stream.
+ *
+ * Each call uses a connection from the pool and so the readings are
+ * always committed when the call completes, regardless of the
+ * commit flag.
+ *
+ * @param readings	A NULL terminated array of readings
+ * @param commit	Commit the readings, ignored
+ * @return		The number of readings stored or -1 on error
+ */
+int Connection::readingStream(ReadingStream **readings, bool commit)
+{
+int	row = 0;
+string	json;
 
-	if (row > 0)
+	if (!copyReadingsStart("readingStream"))
 	{
-		logSQL("ReadingsAppend", query);
-		PGresult *res = PQexec(dbConnection, query);
-		delete[] query;
-		if (PQresultStatus(res) == PGRES_COMMAND_OK)
+		return -1;
+	}
+
+	int count = 0;
+	for (int i = 0; readings[i]; i++)
+	{
+		ReadingStream *reading = readings[i];
+		const char *payload = &reading->assetCode[0] + reading->assetCodeLength;
+		size_t payloadLength = reading->payloadLength;
+
+		// The asset code and payload lengths include the terminating null
+		size_t assetCodeLength = strnlen(reading->assetCode, reading->assetCodeLength);
+		if (assetCodeLength == 0)
 		{
-			PQclear(res);
-			return atoi(PQcmdTuples(res));
+			Logger::getLogger()->warn("Postgres readingStream - empty asset code value, row is ignored");
+			continue;
+		}
+
+		// Binary payloads are converted directly to the stored JSON
+		if (RDS_PAYLOAD_IS_BINARY(payload))
+		{
+			if (!ReadingStreamPayload::toJSON(payload, payloadLength, json))
+			{
+				raiseError("readingStream", "Unable to decode binary payload for asset '%s'",
+						reading->assetCode);
+				continue;
+			}
+			payload = json.c_str();
+			payloadLength = json.length();
+		}
+		else
+		{
+			payloadLength = strnlen(payload, payloadLength);
+		}
+
+		int64_t user_ts = ((int64_t)reading->userTs.tv_sec - POSTGRES_EPOCH_OFFSET) * 1000000
+					+ reading->userTs.tv_usec;
+		copyReading(reading->assetCode, assetCodeLength, payload, payloadLength, user_ts);
+		row++;
+
+		if (++count == m_maxReadingRows)
+		{
+			if (!copyReadingsFlush("readingStream"))
+			{
+				return -1;
+			}
+			count = 0;
 		}
- 		raiseError("appendReadings", PQerrorMessage(dbConnection));
-		PQclear(res);
-		return -1;
 	}
-	else
+
+	if (!copyReadingsEnd("readingStream"))
 	{
-		delete[] query;
-		return 0;
+		return -1;
 	}
+	return row;
 }
 
 /**
@@ -14,6 +14,8 @@
 #include <string>
 #include <rapidjson/document.h>
 #include <libpq-fe.h>
+#include <reading_stream.h>
+#include <stdint.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <functional>
@@ -24,8 +26,8 @@
 #define STORAGE_PURGE_SIZE	 0x0004U
 
 /**
- * Maximum number of readings to insert in a single 
- * insert statement
+ * Maximum number of readings to buffer before passing
+ * them to the COPY of the readings table
  */
 #define INSERT_ROW_LIMIT	5000
 
@@ -41,6 +43,7 @@ class Connection {
 		int		update(const std::string& table, const std::string& data);
 		int		deleteRows(const std::string& table, const std::string& condition);
 		int		appendReadings(const char *readings);
+		int		readingStream(ReadingStream **readings, bool commit);
 		bool		fetchReadings(unsigned long id, unsigned int blksize, std::string& resultSet);
 		unsigned int	purgeReadings(unsigned long age, unsigned int flags, unsigned long sent, std::string& results);
 		unsigned int	purgeReadingsByRows(unsigned long rowcount, unsigned int flags,unsigned long sent, std::string& results);
@@ -49,6 +52,7 @@ class Connection {
 		long		tableSize(const std::string& table);
 		void		setTrace(bool flag) { m_logSQL = flag; };
     		static bool 	formatDate(char *formatted_date, size_t formatted_date_size, const char *date);
+		static bool	postgresTimestamp(const char *date, int64_t& timestamp);
 		int		create_table_snapshot(const std::string& table, const std::string& id);
 		int		load_table_snapshot(const std::string& table, const std::string& id);
 		int		delete_table_snapshot(const std::string& table, const std::string& id);
@@ -98,7 +102,15 @@ class Connection {
 
 		std::string getIndexName(std::string s);
 		bool 		checkValidDataType(const std::string &s);
+		bool		copyReadingsStart(const char *operation);
+		void		copyReading(const char *assetCode, size_t assetCodeLength,
+						const char *reading, size_t readingLength,
+						int64_t userTs);
+		bool		copyReadingsFlush(const char *operation);
+		bool		copyReadingsEnd(const char *operation);
+		void		copyReadingsAbort(const char *reason);
 		long		m_maxReadingRows;
+		std::string	m_copyBuffer;
 
 
 		typedef	struct{
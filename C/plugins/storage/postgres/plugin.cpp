@@ -46,7 +46,7 @@ const char *default_config = QUOTE({
                         "order" : "1"
                         },
                 "maxReadingRows" : {
-                        "description" : "The maximum numebnr of readings to insert in a single statement",
+                        "description" : "The maximum number of readings to buffer before they are sent to the database",
                         "type" : "integer",
                         "default" : "5000",
                         "displayName" : "Max. Insert Rows",
@@ -60,7 +60,7 @@ const char *default_config = QUOTE({
 static PLUGIN_INFORMATION info = {
 	"PostgresSQL",            // Name
 	"1.2.0",                  // Version
-	SP_COMMON|SP_READINGS,    // Flags
+	SP_COMMON|SP_READINGS|SP_BINARY_STREAM,    // Flags
 	PLUGIN_TYPE_STORAGE,      // Type
 	"1.6.0",                  // Interface version
 	default_config
@@ -200,6 +200,25 @@ Connection        *connection = manager->allocate();
 	return result;
 }
 
+/**
+ * Append a stream of readings to the readings buffer
+ */
+int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
+{
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+
+	if (connection == NULL)
+	{
+		Logger::getLogger()->fatal("No database connections available");
+		return 0;
+	}
+
+	int result = connection->readingStream(readings, commit);
+	manager->release(connection);
+	return result;
+}
+
 /**
  * Fetch a block of readings from the readings buffer
  */
@@ -0,0 +1,128 @@
+#ifndef _READING_RING_H
+#define _READING_RING_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+/**
+ * The header of each reading held in the ring. The datapoints of the
+ * reading immediately follow the header as a typed binary payload, in
+ * the encoding described in reading_stream.h. Readings whose datapoints
+ * have no binary encoding are held as JSON text instead, the two are
+ * told apart by the first byte. Timestamps are held as microseconds
+ * since the epoch.
+ */
+typedef struct {
+	uint64_t	id;
+	int64_t		userTs;
+	int64_t		ts;
+	uint32_t	assetId;	// Index into the asset dictionary, 0 once removed
+	uint32_t	length;		// Length of the datapoints payload
+} RingRecord;
+
+#define RING_REMOVED_ASSET	0	// Asset id of a reading that has been removed
+
+/**
+ * The result of purging readings from the ring
+ */
+typedef struct {
+	unsigned long	removed;
+	unsigned long	unsentPurged;
+	unsigned long	unsentRetained;
+	unsigned long	readings;
+} RingPurgeResult;
+
+/**
+ * A fixed capacity ring of readings held in memory.
+ *
+ * Readings are written as binary records into a single contiguous
+ * buffer in the order of their reading id, with the datapoints held in
+ * their typed binary encoding. When the buffer is full the
+ * oldest readings are discarded to make room for new ones. Asset codes
+ * are held once, in a dictionary, and referenced from the records by
+ * index.
+ *
+ * The offset of each record is held in an index ordered by reading id,
+ * so fetching a block of readings is a lookup followed by a contiguous
+ * scan, and purging readings simply moves the tail of the ring.
+ * Removing the readings of an asset marks them as removed, the space
+ * is reclaimed when the tail of the ring passes them.
+ */
+class ReadingRing {
+	public:
+		typedef std::function<bool (const RingRecord *record,
+					const char *reading,
+					const std::string& assetCode)> Visitor;
+
+		ReadingRing(size_t capacity);
+		~ReadingRing();
+		uint64_t	append(const char *assetCode, size_t assetCodeLength,
+					const char *reading, size_t readingLength,
+					int64_t userTs);
+		bool		fetch(uint64_t id, unsigned int blksize, std::string& resultSet);
+		bool		fetchBinary(uint64_t id, unsigned int blksize, std::string& resultSet);
+		void		scan(bool reverse, const Visitor& visitor);
+		void		lookup(const std::vector<uint64_t>& ids, const Visitor& visitor);
+		void		purge(int64_t olderThan, unsigned long maxReadings,
+					unsigned long sent, bool retain,
+					RingPurgeResult& result);
+		unsigned int	removeAsset(const std::string& assetCode);
+		unsigned long	readings();
+		size_t		used();
+		size_t		capacity() const { return m_capacity; };
+
+		static bool	parseTimestamp(const char *str, int64_t& timestamp);
+		static void	formatTimestamp(int64_t timestamp, char *buffer, size_t size);
+		static int64_t	now();
+
+	private:
+		friend class RingSnapshot;
+
+		RingRecord	*record(size_t offset) const
+				{
+					return (RingRecord *)(m_data + offset);
+				};
+		bool		reserve(size_t size, size_t& offset);
+		void		copyRecords(uint64_t id, unsigned int blksize,
+					std::string& records,
+					std::vector<std::string>& assets);
+		void		discardOldest();
+		uint32_t	assetId(const char *assetCode, size_t length);
+		void		restoreAsset(uint32_t id, const std::string& assetCode);
+		bool		restore(const RingRecord *record, const char *reading);
+		void		discardBefore(uint64_t id);
+		void		removeAsset(uint32_t id);
+
+		std::mutex	m_mutex;
+		char		*m_data;
+		size_t		m_capacity;
+		size_t		m_head;		// Offset at which the next record is written
+		size_t		m_used;		// Bytes used by the records in the ring
+		std::deque<size_t>
+				m_index;	// Offsets of the records in id order
+		uint64_t	m_nextId;
+		unsigned long	m_live;		// Readings in the ring that have not been removed
+		unsigned long	m_discarded;	// Readings discarded because the ring was full
+		time_t		m_discardReport;
+		std::unordered_map<std::string, uint32_t>
+				m_assetIds;
+		std::vector<std::string>
+				m_assets;
+		std::vector<uint32_t>
+				m_removedAssets;	// Assets removed since the last snapshot
+};
+
+#endif
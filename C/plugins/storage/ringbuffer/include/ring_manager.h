@@ -0,0 +1,69 @@
+#ifndef _RING_MANAGER_H
+#define _RING_MANAGER_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <reading_ring.h>
+#include <ring_snapshot.h>
+#include <reading_stream.h>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#define	STORAGE_PURGE_RETAIN_ANY 0x0001U
+#define	STORAGE_PURGE_RETAIN_ALL 0x0002U
+#define STORAGE_PURGE_SIZE	 0x0004U
+
+/**
+ * The handle of the ringbuffer readings plugin. It owns the ring of
+ * readings and, if the readings are persisted, the snapshot of the
+ * ring and the thread that periodically saves it.
+ */
+class RingManager {
+	public:
+		RingManager(size_t capacity);
+		~RingManager();
+		void		setPersist(const std::string& filename, unsigned int interval);
+		int		appendReadings(const char *readings);
+		int		readingStream(ReadingStream **readings, bool commit);
+		bool		fetchReadings(unsigned long id, unsigned int blksize,
+						std::string& resultSet);
+		bool		fetchReadingsBinary(unsigned long id, unsigned int blksize,
+						std::string& resultSet);
+		bool		retrieveReadings(const std::string& condition,
+						std::string& resultSet);
+		unsigned int	purgeReadings(unsigned long age, unsigned int flags,
+						unsigned long sent, std::string& result);
+		unsigned int	purgeReadingsByRows(unsigned long rows, unsigned int flags,
+						unsigned long sent, std::string& result);
+		unsigned int	purgeReadingsAsset(const std::string& assetCode);
+		void		shutdown();
+		PLUGIN_ERROR	*getError() { return &m_lastError; };
+		ReadingRing&	ring() { return m_ring; };
+
+	private:
+		void		snapshotThread();
+		void		purgeResult(const RingPurgeResult& purged, const char *method,
+						long duration, std::string& result);
+		void		raiseError(const char *operation, const char *reason, ...);
+
+		ReadingRing		m_ring;
+		RingSnapshot		*m_snapshot;
+		unsigned int		m_snapshotInterval;
+		std::thread		*m_thread;
+		std::mutex		m_shutdownMutex;
+		std::condition_variable	m_shutdownCV;
+		bool			m_shutdown;
+		std::mutex		m_errorLock;
+		PLUGIN_ERROR		m_lastError;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef _RING_QUERY_H
+#define _RING_QUERY_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <string>
+#include <vector>
+
+/**
+ * Execute a storage service query against the readings held in a
+ * ReadingRing.
+ *
+ * The subset of the query language used by the API to browse readings
+ * is supported: where clauses on the id, asset_code, user_ts and ts
+ * columns, the selection of columns and reading properties with
+ * aliases, the aggregates count, min, max, avg and sum with an optional
+ * group and timebucket, the aggregate all with a timebucket, sort,
+ * limit and skip.
+ *
+ * Timebuckets follow the SQLite plugin. Buckets of the aggregates start
+ * at multiples of the bucket size, while the buckets of the aggregate
+ * all operation are centred on them.
+ */
+class RingQuery {
+	public:
+		RingQuery(ReadingRing& ring);
+		~RingQuery();
+		bool			execute(const std::string& query, std::string& resultSet);
+		const std::string&	error() const { return m_error; };
+
+	private:
+		enum Column { ID, ASSET_CODE, READING, USER_TS, TS, STAR };
+
+		/**
+		 * A where clause condition
+		 */
+		class Condition {
+			public:
+				Condition() : m_and(NULL), m_or(NULL) {};
+				~Condition() { delete m_and; delete m_or; };
+				Column			m_column;
+				std::string		m_condition;
+				int64_t			m_number;
+				std::string		m_string;
+				std::vector<int64_t>	m_numbers;
+				std::vector<std::string>
+							m_strings;
+				Condition		*m_and;
+				Condition		*m_or;
+		};
+
+		/**
+		 * A column, or reading property, to return or aggregate
+		 */
+		typedef struct {
+			Column			column;
+			std::vector<std::string>
+						properties;	// Path of a reading property
+			std::string		alias;
+			std::string		operation;	// The aggregate operation
+		} Selection;
+
+		/**
+		 * The state of an aggregate operation
+		 */
+		typedef struct {
+			unsigned long	count;
+			double		sum;
+			double		min;
+			double		max;
+		} Aggregate;
+
+		/**
+		 * A reading that matches the where clause
+		 */
+		typedef struct {
+			uint64_t	id;
+			int64_t		userTs;
+			int64_t		ts;
+			std::string	assetCode;
+		} Match;
+
+		bool		parseWhere(const rapidjson::Value& where, Condition *condition);
+		bool		parseColumn(const char *name, Column& column);
+		bool		parseSelection(const rapidjson::Value& value, Selection& selection);
+		bool		parseSort(const rapidjson::Value& sort);
+		bool		parseTimebucket(const rapidjson::Value& timebucket);
+		bool		matches(const Condition *condition, const RingRecord *record,
+						const std::string& assetCode) const;
+		bool		compare(const Condition *condition, int64_t value) const;
+		bool		compare(const Condition *condition, const std::string& value) const;
+		bool		lessThan(const Match& a, const Match& b) const;
+		bool		executeSelect(std::string& resultSet);
+		bool		executeAggregate(std::string& resultSet);
+		bool		executeAggregateAll(std::string& resultSet);
+		int64_t		bucket(const RingRecord *record) const;
+		void		formatBucket(int64_t bucket, char *buffer, size_t size) const;
+		const rapidjson::Value
+				*property(const rapidjson::Value& reading,
+						const std::vector<std::string>& properties) const;
+		bool		number(const RingRecord *record, const char *reading,
+						const rapidjson::Document& doc,
+						const std::vector<std::string>& properties,
+						double& value) const;
+		void		raiseError(const char *reason, ...);
+
+		ReadingRing&		m_ring;
+		Condition		*m_where;
+		std::vector<Selection>	m_returns;
+		std::vector<Selection>	m_aggregates;
+		bool			m_group;
+		Column			m_groupColumn;
+		std::string		m_groupAlias;
+		bool			m_aggregateAll;	// The aggregate all operation
+		bool			m_timebucket;
+		Column			m_bucketColumn;
+		double			m_bucketSize;	// Size of a timebucket in seconds
+		const char		*m_bucketFormat;	// strftime format of the bucket or NULL
+		bool			m_bucketMs;	// Add the milliseconds to the bucket
+		std::string		m_bucketAlias;
+		std::vector<std::pair<std::string, bool> >
+					m_sort;		// Sort column and descending flag
+		long			m_limit;
+		long			m_skip;
+		std::string		m_error;
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _RING_SNAPSHOT_H
+#define _RING_SNAPSHOT_H
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring.h>
+#include <string>
+
+/**
+ * Persist the contents of a ReadingRing to a file.
+ *
+ * The file is a journal of the changes made to the ring. Each snapshot
+ * appends the assets and readings added since the previous snapshot,
+ * together with the removal of assets and the current tail of the ring,
+ * so the cost of a snapshot is proportional to the readings ingested
+ * since the last one. When the journal grows much larger than the data
+ * held in the ring it is rewritten with just the current contents.
+ *
+ * On startup the journal is replayed into the ring, limiting the data
+ * lost by an unclean shutdown to the readings ingested since the last
+ * snapshot.
+ */
+class RingSnapshot {
+	public:
+		RingSnapshot(const std::string& filename);
+		bool		load(ReadingRing& ring);
+		bool		save(ReadingRing& ring);
+	private:
+		void		collect(ReadingRing& ring, bool full, std::string& journal);
+		bool		write(const std::string& filename, const std::string& journal, bool truncate);
+
+		std::string	m_filename;
+		uint64_t	m_savedId;	// Id of the last reading in the journal
+		uint64_t	m_savedFirst;	// Id of the tail of the ring in the journal
+		uint32_t	m_savedAssets;	// Number of assets in the journal
+		size_t		m_size;		// Size of the journal file
+		uint64_t	m_collectedId;
+		uint64_t	m_collectedFirst;
+		uint32_t	m_collectedAssets;
+};
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <ring_manager.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <reading_stream.h>
+#include <logger.h>
+#include <utils.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+/**
+ * The ringbuffer readings plugin interface
+ */
+extern "C" {
+
+const char *default_config = QUOTE({
+		"capacity" : {
+			"description" : "The amount of memory in megabytes to use for readings. The oldest readings are discarded when it is full",
+			"type" : "integer",
+			"default" : "100",
+			"displayName" : "Capacity (MB)",
+			"order" : "1",
+			"minimum" : "1"
+		},
+		"persist" : {
+			"description" : "Persist the readings between executions",
+			"type" : "boolean",
+			"default" : "true",
+			"displayName" : "Persist Data",
+			"order" : "2"
+		},
+		"filename" : {
+			"description" : "The name of the file to which the readings should be persisted",
+			"type" : "string",
+			"default" : "ringbuffer",
+			"displayName" : "Persist File",
+			"order" : "3",
+			"validity": "persist == \"true\""
+		},
+		"snapshotInterval" : {
+			"description" : "The number of seconds between saving the readings that have been added to the persist file",
+			"type" : "integer",
+			"default" : "30",
+			"displayName" : "Snapshot Interval",
+			"order" : "4",
+			"minimum" : "1",
+			"validity": "persist == \"true\""
+		}
+});
+
+/**
+ * The plugin information structure
+ */
+static PLUGIN_INFORMATION info = {
+	"ringbuffer",		// Name
+	"1.0.0",		// Version
+	SP_READINGS|SP_BINARY_STREAM,	// Flags
+	PLUGIN_TYPE_STORAGE,	// Type
+	"1.6.0",		// Interface version
+	default_config
+};
+
+/**
+ * Return the information about this plugin
+ */
+PLUGIN_INFORMATION *plugin_info()
+{
+	return &info;
+}
+
+/**
+ * Initialise the plugin, called to get the plugin handle.
+ * The memory for the ring is allocated and, if the readings are
+ * persisted, the readings of the previous execution are loaded.
+ *
+ * @param category	The plugin configuration category
+ */
+PLUGIN_HANDLE plugin_init(ConfigCategory *category)
+{
+size_t	capacity = 100;
+
+	if (category->itemExists("capacity"))
+	{
+		capacity = strtoul(category->getValue("capacity").c_str(), NULL, 10);
+		if (capacity == 0)
+			capacity = 1;
+	}
+	RingManager *manager = new RingManager(capacity * 1024 * 1024);
+
+	if (category->itemExists("persist") && category->getValue("persist").compare("true") == 0)
+	{
+		string filename = "ringbuffer";
+		if (category->itemExists("filename"))
+			filename = category->getValue("filename");
+		unsigned int interval = 30;
+		if (category->itemExists("snapshotInterval"))
+			interval = strtoul(category->getValue("snapshotInterval").c_str(), NULL, 10);
+		manager->setPersist(getDataDir() + "/" + filename + ".ring", interval);
+	}
+	return manager;
+}
+
+/**
+ * Append a sequence of readings to the readings buffer
+ */
+int plugin_reading_append(PLUGIN_HANDLE handle, char *readings)
+{
+RingManager *manager = (RingManager *)handle;
+
+	return manager->appendReadings(readings);
+}
+
+/**
+ * Append a stream of readings to the readings buffer
+ */
+int plugin_readingStream(PLUGIN_HANDLE handle, ReadingStream **readings, bool commit)
+{
+RingManager *manager = (RingManager *)handle;
+
+	return manager->readingStream(readings, commit);
+}
+
+/**
+ * Fetch a block of readings from the readings buffer
+ */
+char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize)
+{
+RingManager *manager = (RingManager *)handle;
+std::string	  resultSet;
+
+	manager->fetchReadings(id, blksize, resultSet);
+	return strdup(resultSet.c_str());
+}
+
+/**
+ * Fetch a block of readings from the readings buffer in binary form,
+ * the result is returned in a malloc'd buffer and its length in length
+ */
+char *plugin_reading_fetch_binary(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize, size_t *length)
+{
+RingManager *manager = (RingManager *)handle;
+std::string	  resultSet;
+
+	if (!manager->fetchReadingsBinary(id, blksize, resultSet))
+	{
+		return NULL;
+	}
+	char *result = (char *)malloc(resultSet.length());
+	if (result)
+	{
+		memcpy(result, resultSet.data(), resultSet.length());
+		*length = resultSet.length();
+	}
+	return result;
+}
+
+/**
+ * Retrieve some readings from the readings buffer
+ */
+char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition)
+{
+RingManager *manager = (RingManager *)handle;
+std::string results;
+
+	if (!manager->retrieveReadings(std::string(condition ? condition : ""), results))
+	{
+		return NULL;
+	}
+	return strdup(results.c_str());
+}
+
+/**
+ * Purge readings from the buffer
+ */
+char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent)
+{
+RingManager *manager = (RingManager *)handle;
+std::string 	  results;
+
+	if (flags & STORAGE_PURGE_SIZE)	// Purge by size
+	{
+		(void)manager->purgeReadingsByRows(param, flags, sent, results);
+	}
+	else
+	{
+		(void)manager->purgeReadings(param, flags, sent, results);
+	}
+	return strdup(results.c_str());
+}
+
+/**
+ * Release a previously returned result set
+ */
+void plugin_release(PLUGIN_HANDLE handle, char *results)
+{
+	(void)handle;
+	free(results);
+}
+
+/**
+ * Return details on the last error that occured.
+ */
+PLUGIN_ERROR *plugin_last_error(PLUGIN_HANDLE handle)
+{
+RingManager *manager = (RingManager *)handle;
+
+	return manager->getError();
+}
+
+/**
+ * Shutdown the plugin, saving the readings if they are persisted
+ */
+bool plugin_shutdown(PLUGIN_HANDLE handle)
+{
+RingManager *manager = (RingManager *)handle;
+
+	manager->shutdown();
+	delete manager;
+	return true;
+}
+
+/**
+ * Purge given readings asset or all readings from the buffer
+ */
+unsigned int plugin_reading_purge_asset(PLUGIN_HANDLE handle, char *asset)
+{
+RingManager *manager = (RingManager *)handle;
+
+	return manager->purgeReadingsAsset(asset);
+}
+};
@@ -0,0 +1,656 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_ring.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <logger.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/time.h>
+
+using namespace std;
+using namespace rapidjson;
+
+#define DISCARD_REPORT_INTERVAL	60	// Minimum number of seconds between discard warnings
+
+/**
+ * The space taken in the ring by a record with the given length of
+ * reading data. Records are kept aligned on 8 byte boundaries.
+ */
+static inline size_t recordSize(size_t length)
+{
+	return (sizeof(RingRecord) + length + 7) & ~(size_t)7;
+}
+
+/**
+ * Construct a ring of readings
+ *
+ * @param capacity	The number of bytes of memory to use for the readings
+ */
+ReadingRing::ReadingRing(size_t capacity) : m_capacity(capacity & ~(size_t)7),
+	m_head(0), m_used(0), m_nextId(1), m_live(0), m_discarded(0),
+	m_discardReport(0)
+{
+	m_data = (char *)malloc(m_capacity);
+	if (!m_data)
+	{
+		throw runtime_error("Unable to allocate memory for the readings ring");
+	}
+	m_assets.push_back("");		// Asset id 0 is used for removed readings
+}
+
+/**
+ * Destructor for the ring
+ */
+ReadingRing::~ReadingRing()
+{
+	free(m_data);
+}
+
+/**
+ * Append a reading to the ring
+ *
+ * @param assetCode		The asset code of the reading
+ * @param assetCodeLength	The length of the asset code
+ * @param reading		The datapoints of the reading, a binary payload or JSON
+ * @param readingLength		The length of the datapoints
+ * @param userTs		The user timestamp of the reading
+ * @return			The id of the reading or 0 if it is too large for the ring
+ */
+uint64_t ReadingRing::append(const char *assetCode, size_t assetCodeLength,
+			const char *reading, size_t readingLength,
+			int64_t userTs)
+{
+	int64_t ts = now();
+	lock_guard<mutex> guard(m_mutex);
+
+	size_t size = recordSize(readingLength);
+	size_t offset;
+	if (!reserve(size, offset))
+	{
+		return 0;
+	}
+	RingRecord *rec = record(offset);
+	rec->id = m_nextId++;
+	rec->userTs = userTs;
+	rec->ts = ts;
+	rec->assetId = assetId(assetCode, assetCodeLength);
+	rec->length = readingLength;
+	memcpy(rec + 1, reading, readingLength);
+
+	m_index.push_back(offset);
+	m_head = offset + size;
+	m_used += size;
+	m_live++;
+	return rec->id;
+}
+
+/**
+ * Find space in the ring for a record, discarding the oldest readings
+ * if the ring is full. If the record does not fit in the space between
+ * the head and the end of the buffer it is written at the start of
+ * the buffer and the space at the end is left unused.
+ *
+ * Must be called with the ring locked.
+ *
+ * @param size		The size of the record
+ * @param offset	The offset at which to write the record
+ * @return		False if the record is larger than the ring
+ */
+bool ReadingRing::reserve(size_t size, size_t& offset)
+{
+	if (size > m_capacity)
+	{
+		Logger::getLogger()->error("Reading of %ld bytes is too large for the readings ring", size);
+		return false;
+	}
+	while (true)
+	{
+		if (m_index.empty())
+		{
+			m_head = 0;
+			m_used = 0;
+			offset = 0;
+			return true;
+		}
+		size_t tail = m_index.front();
+		if (m_head > tail)
+		{
+			// The records occupy the space from the tail to the head
+			if (m_capacity - m_head >= size)
+			{
+				offset = m_head;
+				return true;
+			}
+			if (tail > size)
+			{
+				offset = 0;
+				return true;
+			}
+		}
+		else if (tail - m_head > size)
+		{
+			// The records have wrapped, the free space is between the head and the tail
+			offset = m_head;
+			return true;
+		}
+		discardOldest();
+	}
+}
+
+/**
+ * Discard the oldest record in the ring to make space for a new
+ * reading. Must be called with the ring locked.
+ */
+void ReadingRing::discardOldest()
+{
+	RingRecord *rec = record(m_index.front());
+	if (rec->assetId != RING_REMOVED_ASSET)
+	{
+		m_live--;
+		m_discarded++;
+		time_t now = time(0);
+		if (now - m_discardReport > DISCARD_REPORT_INTERVAL)
+		{
+			Logger::getLogger()->warn("The readings ring is full, %ld unpurged readings have been discarded",
+					m_discarded);
+			m_discardReport = now;
+		}
+	}
+	m_used -= recordSize(rec->length);
+	m_index.pop_front();
+}
+
+/**
+ * Return the id of an asset code in the asset dictionary, adding the
+ * asset code if it has not been seen before. Must be called with the
+ * ring locked.
+ *
+ * @param assetCode	The asset code
+ * @param length	The length of the asset code
+ * @return		The id of the asset code
+ */
+uint32_t ReadingRing::assetId(const char *assetCode, size_t length)
+{
+	string asset(assetCode, length);
+	auto it = m_assetIds.find(asset);
+	if (it != m_assetIds.end())
+	{
+		return it->second;
+	}
+	uint32_t id = m_assets.size();
+	m_assets.push_back(asset);
+	m_assetIds.insert(make_pair(asset, id));
+	return id;
+}
+
+/**
+ * Copy the records of a block of readings, starting at a given reading
+ * id, out of the ring so that they can be formatted once the ring is
+ * unlocked.
+ *
+ * @param id		The id of the first reading to copy
+ * @param blksize	The maximum number of readings to copy
+ * @param records	The copied records
+ * @param assets	The asset code of each of the copied records
+ */
+void ReadingRing::copyRecords(uint64_t id, unsigned int blksize, string& records, vector<string>& assets)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = lower_bound(m_index.begin(), m_index.end(), id,
+			[this](size_t offset, uint64_t id) { return record(offset)->id < id; });
+	for ( ; it != m_index.end() && assets.size() < blksize; ++it)
+	{
+		RingRecord *rec = record(*it);
+		if (rec->assetId == RING_REMOVED_ASSET)
+			continue;
+		records.append((const char *)rec, sizeof(RingRecord) + rec->length);
+		assets.push_back(m_assets[rec->assetId]);
+	}
+}
+
+/**
+ * Fetch a block of readings, starting at a given reading id, in the
+ * JSON format used by the north services.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The JSON result set
+ * @return		True if the readings were fetched
+ */
+bool ReadingRing::fetch(uint64_t id, unsigned int blksize, string& resultSet)
+{
+string		records;
+vector<string>	assets;
+
+	copyRecords(id, blksize, records, assets);
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	char timestamp[40];
+	string json;
+	const char *p = records.data();
+
+	writer.StartObject();
+	writer.Key("count");
+	writer.Uint(assets.size());
+	writer.Key("rows");
+	writer.StartArray();
+	for (auto& asset : assets)
+	{
+		const RingRecord *rec = (const RingRecord *)p;
+		const char *reading = (const char *)(rec + 1);
+		size_t length = rec->length;
+		if (RDS_PAYLOAD_IS_BINARY(reading))
+		{
+			if (!ReadingStreamPayload::toJSON(reading, length, json))
+				json = "{}";
+			reading = json.c_str();
+			length = json.length();
+		}
+		writer.StartObject();
+		writer.Key("id");
+		writer.Uint64(rec->id);
+		writer.Key("asset_code");
+		writer.String(asset.c_str(), asset.length());
+		writer.Key("reading");
+		writer.RawValue(reading, length, kObjectType);
+		writer.Key("user_ts");
+		formatTimestamp(rec->userTs, timestamp, sizeof(timestamp));
+		writer.String(timestamp);
+		writer.Key("ts");
+		formatTimestamp(rec->ts, timestamp, sizeof(timestamp));
+		writer.String(timestamp);
+		writer.EndObject();
+		p += sizeof(RingRecord) + rec->length;
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	resultSet.assign(buffer.GetString(), buffer.GetSize());
+	return true;
+}
+
+/**
+ * Fetch a block of readings, starting at a given reading id, in the
+ * binary form described in reading_stream.h. The payloads are returned
+ * as they are held in the ring, without conversion to JSON.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The binary result
+ * @return		True if the readings were fetched
+ */
+bool ReadingRing::fetchBinary(uint64_t id, unsigned int blksize, string& resultSet)
+{
+string		records;
+vector<string>	assets;
+
+	copyRecords(id, blksize, records, assets);
+
+	RDSFetchHeader header;
+	header.magic = RDS_FETCH_MAGIC;
+	header.count = assets.size();
+	resultSet.assign((const char *)&header, sizeof(header));
+
+	char userTs[40], ts[40];
+	const char *p = records.data();
+	for (auto& asset : assets)
+	{
+		const RingRecord *rec = (const RingRecord *)p;
+		formatTimestamp(rec->userTs, userTs, sizeof(userTs));
+		formatTimestamp(rec->ts, ts, sizeof(ts));
+		RDSFetchReading reading;
+		reading.id = rec->id;
+		reading.assetLength = asset.length();
+		reading.userTsLength = strlen(userTs);
+		reading.tsLength = strlen(ts);
+		reading.payloadLength = rec->length;
+		resultSet.append((const char *)&reading, sizeof(reading));
+		resultSet.append(asset);
+		resultSet.append(userTs, reading.userTsLength);
+		resultSet.append(ts, reading.tsLength);
+		resultSet.append((const char *)(rec + 1), rec->length);
+		p += sizeof(RingRecord) + rec->length;
+	}
+	return true;
+}
+
+/**
+ * Call a visitor for each of the readings in the ring, in id order.
+ * The ring is locked for the duration of the scan, the visitor may
+ * return false to end the scan early.
+ *
+ * @param reverse	Visit the newest readings first
+ * @param visitor	The function to call for each reading
+ */
+void ReadingRing::scan(bool reverse, const Visitor& visitor)
+{
+	lock_guard<mutex> guard(m_mutex);
+	if (reverse)
+	{
+		for (auto it = m_index.rbegin(); it != m_index.rend(); ++it)
+		{
+			RingRecord *rec = record(*it);
+			if (rec->assetId != RING_REMOVED_ASSET &&
+					!visitor(rec, (const char *)(rec + 1), m_assets[rec->assetId]))
+				break;
+		}
+	}
+	else
+	{
+		for (auto it = m_index.begin(); it != m_index.end(); ++it)
+		{
+			RingRecord *rec = record(*it);
+			if (rec->assetId != RING_REMOVED_ASSET &&
+					!visitor(rec, (const char *)(rec + 1), m_assets[rec->assetId]))
+				break;
+		}
+	}
+}
+
+/**
+ * Call a visitor for each of a set of readings. Readings that are
+ * no longer in the ring are skipped. The ring is locked while the
+ * visitor is called.
+ *
+ * @param ids		The ids of the readings
+ * @param visitor	The function to call for each reading
+ */
+void ReadingRing::lookup(const vector<uint64_t>& ids, const Visitor& visitor)
+{
+	lock_guard<mutex> guard(m_mutex);
+	for (auto& id : ids)
+	{
+		auto it = lower_bound(m_index.begin(), m_index.end(), id,
+				[this](size_t offset, uint64_t id) { return record(offset)->id < id; });
+		if (it == m_index.end())
+			continue;
+		RingRecord *rec = record(*it);
+		if (rec->id != id || rec->assetId == RING_REMOVED_ASSET)
+			continue;
+		if (!visitor(rec, (const char *)(rec + 1), m_assets[rec->assetId]))
+			break;
+	}
+}
+
+/**
+ * Purge readings by moving the tail of the ring. Readings are removed
+ * from the tail while they are older than a given time or while there
+ * are more than a given number of readings in the ring.
+ *
+ * @param olderThan	Remove readings with a user timestamp before this time, 0 to ignore the age
+ * @param maxReadings	Remove readings while there are more than this many, 0 to ignore the number
+ * @param sent		The id of the last reading sent north
+ * @param retain	Do not remove readings that have not been sent
+ * @param result	The result of the purge
+ */
+void ReadingRing::purge(int64_t olderThan, unsigned long maxReadings,
+			unsigned long sent, bool retain, RingPurgeResult& result)
+{
+	memset(&result, 0, sizeof(result));
+
+	lock_guard<mutex> guard(m_mutex);
+	while (!m_index.empty())
+	{
+		RingRecord *rec = record(m_index.front());
+		if (rec->assetId != RING_REMOVED_ASSET)
+		{
+			if (retain && rec->id > sent)
+				break;
+			bool old = olderThan && rec->userTs < olderThan;
+			bool excess = maxReadings && m_live > maxReadings;
+			if (!old && !excess)
+				break;
+			m_live--;
+			result.removed++;
+			if (rec->id > sent)
+				result.unsentPurged++;
+		}
+		m_used -= recordSize(rec->length);
+		m_index.pop_front();
+	}
+	if (m_index.empty())
+	{
+		m_head = 0;
+	}
+	else
+	{
+		uint64_t first = record(m_index.front())->id;
+		uint64_t last = m_nextId - 1;
+		if (last > sent)
+			result.unsentRetained = last - max((uint64_t)sent, first - 1);
+	}
+	result.readings = m_live;
+}
+
+/**
+ * Remove all of the readings of an asset from the ring
+ *
+ * @param assetCode	The asset code to remove
+ * @return		The number of readings removed
+ */
+unsigned int ReadingRing::removeAsset(const string& assetCode)
+{
+	lock_guard<mutex> guard(m_mutex);
+	auto it = m_assetIds.find(assetCode);
+	if (it == m_assetIds.end())
+	{
+		return 0;
+	}
+	unsigned long live = m_live;
+	removeAsset(it->second);
+	m_removedAssets.push_back(it->second);
+	return live - m_live;
+}
+
+/**
+ * Mark the readings of an asset as removed. Must be called with
+ * the ring locked.
+ *
+ * @param id	The id of the asset
+ */
+void ReadingRing::removeAsset(uint32_t id)
+{
+	for (auto& offset : m_index)
+	{
+		RingRecord *rec = record(offset);
+		if (rec->assetId == id)
+		{
+			rec->assetId = RING_REMOVED_ASSET;
+			m_live--;
+		}
+	}
+}
+
+/**
+ * Return the number of readings in the ring
+ */
+unsigned long ReadingRing::readings()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_live;
+}
+
+/**
+ * Return the number of bytes of the ring used by the readings
+ */
+size_t ReadingRing::used()
+{
+	lock_guard<mutex> guard(m_mutex);
+	return m_used;
+}
+
+/**
+ * Add an asset to the asset dictionary with a given id. Used when
+ * restoring the ring from a snapshot, must be called with the ring locked.
+ *
+ * @param id		The asset id
+ * @param assetCode	The asset code
+ */
+void ReadingRing::restoreAsset(uint32_t id, const string& assetCode)
+{
+	if (id >= m_assets.size())
+	{
+		m_assets.resize(id + 1);
+	}
+	m_assets[id] = assetCode;
+	m_assetIds[assetCode] = id;
+}
+
+/**
+ * Add a reading read from a snapshot to the ring, keeping the id and
+ * timestamps of the reading. Must be called with the ring locked.
+ *
+ * @param rec		The record header
+ * @param reading	The datapoints of the reading
+ * @return		False if the reading could not be restored
+ */
+bool ReadingRing::restore(const RingRecord *rec, const char *reading)
+{
+	if (rec->id < m_nextId || rec->assetId >= m_assets.size())
+	{
+		return false;
+	}
+	size_t size = recordSize(rec->length);
+	size_t offset;
+	if (!reserve(size, offset))
+	{
+		return false;
+	}
+	memcpy(record(offset), rec, sizeof(RingRecord));
+	memcpy(record(offset) + 1, reading, rec->length);
+	m_index.push_back(offset);
+	m_head = offset + size;
+	m_used += size;
+	m_live++;
+	m_nextId = rec->id + 1;
+	return true;
+}
+
+/**
+ * Discard the readings with an id before a given id. Used when
+ * restoring the ring from a snapshot, must be called with the ring locked.
+ *
+ * @param id	The id of the first reading to keep
+ */
+void ReadingRing::discardBefore(uint64_t id)
+{
+	while (!m_index.empty() && record(m_index.front())->id < id)
+	{
+		RingRecord *rec = record(m_index.front());
+		if (rec->assetId != RING_REMOVED_ASSET)
+			m_live--;
+		m_used -= recordSize(rec->length);
+		m_index.pop_front();
+	}
+	if (m_nextId < id)
+	{
+		m_nextId = id;
+	}
+}
+
+/**
+ * Parse a timestamp of the form YYYY-MM-DD HH:MM:SS.ffffff+HH:MM, the
+ * fractional seconds and the timezone are optional. The string now()
+ * is interpreted as the current time.
+ *
+ * @param str		The timestamp to parse
+ * @param timestamp	The number of microseconds since the epoch
+ * @return		False if the timestamp could not be parsed
+ */
+bool ReadingRing::parseTimestamp(const char *str, int64_t& timestamp)
+{
+struct tm	tm;
+
+	if (strcmp(str, "now()") == 0)
+	{
+		timestamp = now();
+		return true;
+	}
+
+	memset(&tm, 0, sizeof(tm));
+	const char *p = strptime(str, "%Y-%m-%d %H:%M:%S", &tm);
+	if (!p)
+	{
+		p = strptime(str, "%Y-%m-%dT%H:%M:%S", &tm);
+		if (!p)
+			return false;
+	}
+
+	long usec = 0;
+	if (*p == '.')
+	{
+		int digits = 0;
+		for (p++; isdigit(*p); p++)
+		{
+			if (digits < 6)
+			{
+				usec = usec * 10 + (*p - '0');
+				digits++;
+			}
+		}
+		while (digits++ < 6)
+			usec *= 10;
+	}
+
+	long offset = 0;
+	if (*p == '+' || *p == '-')
+	{
+		int hours = 0, minutes = 0;
+		sscanf(p + 1, "%2d:%2d", &hours, &minutes);
+		offset = (hours * 60 + minutes) * 60;
+		if (*p == '-')
+			offset = -offset;
+	}
+
+	timestamp = ((int64_t)(timegm(&tm) - offset)) * 1000000 + usec;
+	return true;
+}
+
+/**
+ * Format a timestamp as a UTC date and time with microseconds,
+ * in the form YYYY-MM-DD HH:MM:SS.ffffff
+ *
+ * @param timestamp	The number of microseconds since the epoch
+ * @param buffer	The buffer to format the timestamp into
+ * @param size		The size of the buffer
+ */
+void ReadingRing::formatTimestamp(int64_t timestamp, char *buffer, size_t size)
+{
+struct tm	tm;
+
+	time_t seconds = timestamp / 1000000;
+	long usec = timestamp % 1000000;
+	if (usec < 0)
+	{
+		seconds--;
+		usec += 1000000;
+	}
+	gmtime_r(&seconds, &tm);
+	size_t len = strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buffer + len, size - len, ".%06ld", usec);
+}
+
+/**
+ * Return the current time in microseconds since the epoch
+ */
+int64_t ReadingRing::now()
+{
+struct timeval	tv;
+
+	gettimeofday(&tv, NULL);
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
@@ -0,0 +1,400 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <ring_manager.h>
+#include <ring_query.h>
+#include <reading_stream_payload.h>
+#include <logger.h>
+#include <rapidjson/document.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <rapidjson/error/en.h>
+#include <chrono>
+#include <sstream>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/time.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Construct the plugin handle
+ *
+ * @param capacity	The number of bytes of memory to use for readings
+ */
+RingManager::RingManager(size_t capacity) : m_ring(capacity), m_snapshot(NULL),
+	m_snapshotInterval(0), m_thread(NULL), m_shutdown(false)
+{
+	m_lastError.message = NULL;
+	m_lastError.entryPoint = NULL;
+	m_lastError.retryable = false;
+}
+
+/**
+ * Destructor for the plugin handle
+ */
+RingManager::~RingManager()
+{
+	shutdown();
+	delete m_snapshot;
+	if (m_lastError.entryPoint)
+		free(m_lastError.entryPoint);
+	if (m_lastError.message)
+		free(m_lastError.message);
+}
+
+/**
+ * Persist the readings in the ring. Any readings persisted by a previous
+ * execution are loaded and a thread is started to save the ring
+ * periodically.
+ *
+ * @param filename	The full path of the file to persist the readings to
+ * @param interval	The number of seconds between snapshots
+ */
+void RingManager::setPersist(const string& filename, unsigned int interval)
+{
+	m_snapshot = new RingSnapshot(filename);
+	m_snapshot->load(m_ring);
+	m_snapshotInterval = interval;
+	if (m_snapshotInterval)
+	{
+		m_thread = new thread(&RingManager::snapshotThread, this);
+	}
+}
+
+/**
+ * The thread that periodically saves a snapshot of the ring
+ */
+void RingManager::snapshotThread()
+{
+	unique_lock<mutex> lck(m_shutdownMutex);
+	while (!m_shutdown)
+	{
+		m_shutdownCV.wait_for(lck, chrono::seconds(m_snapshotInterval));
+		if (!m_shutdown)
+		{
+			lck.unlock();
+			m_snapshot->save(m_ring);
+			lck.lock();
+		}
+	}
+}
+
+/**
+ * Stop the snapshot thread and take a final snapshot of the ring
+ */
+void RingManager::shutdown()
+{
+	{
+		lock_guard<mutex> guard(m_shutdownMutex);
+		if (m_shutdown)
+			return;
+		m_shutdown = true;
+	}
+	m_shutdownCV.notify_all();
+	if (m_thread)
+	{
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+	}
+	if (m_snapshot)
+	{
+		m_snapshot->save(m_ring);
+	}
+}
+
+/**
+ * Append a set of readings in JSON format to the ring
+ *
+ * @param readings	The JSON readings payload
+ * @return		The number of readings appended or -1 on error
+ */
+int RingManager::appendReadings(const char *readings)
+{
+Document	doc;
+int		row = 0;
+
+	if (doc.Parse(readings).HasParseError())
+	{
+		raiseError("appendReadings", GetParseError_En(doc.GetParseError()));
+		return -1;
+	}
+	if (!doc.HasMember("readings") || !doc["readings"].IsArray())
+	{
+		raiseError("appendReadings", "Payload is missing a readings array");
+		return -1;
+	}
+
+	StringBuffer buffer;
+	string payload;
+	for (auto& reading : doc["readings"].GetArray())
+	{
+		if (!reading.IsObject() || !reading.HasMember("asset_code") ||
+				!reading["asset_code"].IsString() || !reading.HasMember("reading") ||
+				!reading.HasMember("user_ts") || !reading["user_ts"].IsString())
+		{
+			raiseError("appendReadings", "Each reading in the readings array must be an object with an asset_code, user_ts and reading");
+			return -1;
+		}
+		const Value& assetCode = reading["asset_code"];
+		if (assetCode.GetStringLength() == 0)
+		{
+			Logger::getLogger()->warn("Ringbuffer appendReadings - empty asset code value, row ignored");
+			continue;
+		}
+		int64_t userTs;
+		if (!ReadingRing::parseTimestamp(reading["user_ts"].GetString(), userTs))
+		{
+			raiseError("appendReadings", "Invalid date |%s|", reading["user_ts"].GetString());
+			return -1;
+		}
+		const char *datapoints;
+		size_t length;
+		if (ReadingStreamPayload::fromJSON(reading["reading"], payload))
+		{
+			datapoints = payload.data();
+			length = payload.length();
+		}
+		else
+		{
+			// No binary encoding for the datapoints, hold the JSON text
+			buffer.Clear();
+			Writer<StringBuffer> writer(buffer);
+			reading["reading"].Accept(writer);
+			datapoints = buffer.GetString();
+			length = buffer.GetSize();
+		}
+		if (m_ring.append(assetCode.GetString(), assetCode.GetStringLength(),
+				datapoints, length, userTs) == 0)
+		{
+			raiseError("appendReadings", "Reading for asset %s is too large for the ring buffer",
+					assetCode.GetString());
+			continue;
+		}
+		row++;
+	}
+	return row;
+}
+
+/**
+ * Append a stream of readings to the ring. Binary payloads are held
+ * as they are received, JSON payloads are converted to the binary
+ * encoding where the datapoints allow it.
+ *
+ * @param readings	A NULL terminated array of readings
+ * @param commit	Commit the readings, ignored as readings are visible immediately
+ * @return		The number of readings appended
+ */
+int RingManager::readingStream(ReadingStream **readings, bool commit)
+{
+int	row = 0;
+string	binary;
+
+	(void)commit;
+	for (int i = 0; readings[i]; i++)
+	{
+		ReadingStream *reading = readings[i];
+		const char *payload = &reading->assetCode[0] + reading->assetCodeLength;
+		size_t payloadLength = reading->payloadLength;
+
+		// The asset code and JSON payload lengths include the terminating null
+		size_t assetCodeLength = strnlen(reading->assetCode, reading->assetCodeLength);
+		if (assetCodeLength == 0)
+		{
+			Logger::getLogger()->warn("Ringbuffer readingStream - empty asset code value, row ignored");
+			continue;
+		}
+
+		if (!RDS_PAYLOAD_IS_BINARY(payload))
+		{
+			payloadLength = strnlen(payload, payloadLength);
+			Document doc;
+			if (!doc.Parse(payload, payloadLength).HasParseError() &&
+					ReadingStreamPayload::fromJSON(doc, binary))
+			{
+				payload = binary.data();
+				payloadLength = binary.length();
+			}
+		}
+
+		int64_t userTs = (int64_t)reading->userTs.tv_sec * 1000000 + reading->userTs.tv_usec;
+		if (m_ring.append(reading->assetCode, assetCodeLength, payload, payloadLength, userTs) == 0)
+		{
+			raiseError("readingStream", "Reading for asset %s is too large for the ring buffer",
+					reading->assetCode);
+			continue;
+		}
+		row++;
+	}
+	return row;
+}
+
+/**
+ * Fetch a block of readings
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The readings as a JSON result set
+ * @return		True if the readings were fetched
+ */
+bool RingManager::fetchReadings(unsigned long id, unsigned int blksize, string& resultSet)
+{
+	return m_ring.fetch(id, blksize, resultSet);
+}
+
+/**
+ * Fetch a block of readings in binary form
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The readings in the binary form of reading_stream.h
+ * @return		True if the readings were fetched
+ */
+bool RingManager::fetchReadingsBinary(unsigned long id, unsigned int blksize, string& resultSet)
+{
+	return m_ring.fetchBinary(id, blksize, resultSet);
+}
+
+/**
+ * Retrieve readings that match a query
+ *
+ * @param condition	The JSON query
+ * @param resultSet	The JSON result set
+ * @return		True if the query succeeded
+ */
+bool RingManager::retrieveReadings(const string& condition, string& resultSet)
+{
+	RingQuery query(m_ring);
+
+	if (condition.empty())
+	{
+		return query.execute("{}", resultSet);
+	}
+	if (!query.execute(condition, resultSet))
+	{
+		raiseError("retrieve", "%s", query.error().c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Purge readings older than a given age
+ *
+ * @param age		The age in hours of the readings to purge
+ * @param flags		The purge flags
+ * @param sent		The id of the last reading sent north
+ * @param result	The JSON result of the purge
+ * @return		The number of readings removed
+ */
+unsigned int RingManager::purgeReadings(unsigned long age, unsigned int flags,
+					unsigned long sent, string& result)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	RingPurgeResult purged;
+	int64_t olderThan = ReadingRing::now() - (int64_t)age * 3600 * 1000000;
+	bool retain = (flags & (STORAGE_PURGE_RETAIN_ANY | STORAGE_PURGE_RETAIN_ALL)) != 0;
+	m_ring.purge(olderThan, 0, sent, retain, purged);
+
+	gettimeofday(&end, NULL);
+	long duration = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+	purgeResult(purged, "age", duration, result);
+	return purged.removed;
+}
+
+/**
+ * Purge readings to leave at most a given number of readings
+ *
+ * @param rows		The number of readings to leave
+ * @param flags		The purge flags
+ * @param sent		The id of the last reading sent north
+ * @param result	The JSON result of the purge
+ * @return		The number of readings removed
+ */
+unsigned int RingManager::purgeReadingsByRows(unsigned long rows, unsigned int flags,
+					unsigned long sent, string& result)
+{
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+
+	RingPurgeResult purged;
+	bool retain = (flags & (STORAGE_PURGE_RETAIN_ANY | STORAGE_PURGE_RETAIN_ALL)) != 0;
+	if (rows == 0)
+	{
+		// Purge everything, subject to the retain flags
+		m_ring.purge(INT64_MAX, 0, sent, retain, purged);
+	}
+	else
+	{
+		m_ring.purge(0, rows, sent, retain, purged);
+	}
+
+	gettimeofday(&end, NULL);
+	long duration = (end.tv_sec - start.tv_sec) * 1000000 + end.tv_usec - start.tv_usec;
+	purgeResult(purged, "rows", duration, result);
+	return purged.removed;
+}
+
+/**
+ * Remove the readings of an asset
+ *
+ * @param assetCode	The asset code to remove
+ * @return		The number of readings removed
+ */
+unsigned int RingManager::purgeReadingsAsset(const string& assetCode)
+{
+	return m_ring.removeAsset(assetCode);
+}
+
+/**
+ * Build the JSON result of a purge
+ */
+void RingManager::purgeResult(const RingPurgeResult& purged, const char *method,
+				long duration, string& result)
+{
+	ostringstream convert;
+
+	convert << "{ \"removed\" : " << purged.removed << ", ";
+	convert << " \"unsentPurged\" : " << purged.unsentPurged << ", ";
+	convert << " \"unsentRetained\" : " << purged.unsentRetained << ", ";
+	convert << " \"readings\" : " << purged.readings << ", ";
+	convert << " \"method\" : \"" << method << "\", ";
+	convert << " \"duration\" : " << duration << " }";
+	result = convert.str();
+}
+
+/**
+ * Record an error so that it can be returned by plugin_last_error
+ *
+ * @param operation	The operation that failed
+ * @param reason	The printf format of the reason
+ */
+void RingManager::raiseError(const char *operation, const char *reason, ...)
+{
+char	tmpbuf[512];
+
+	va_list ap;
+	va_start(ap, reason);
+	vsnprintf(tmpbuf, sizeof(tmpbuf), reason, ap);
+	va_end(ap);
+	Logger::getLogger()->error("Ringbuffer storage plugin raising error: %s", tmpbuf);
+
+	lock_guard<mutex> guard(m_errorLock);
+	if (m_lastError.entryPoint)
+		free(m_lastError.entryPoint);
+	if (m_lastError.message)
+		free(m_lastError.message);
+	m_lastError.retryable = false;
+	m_lastError.entryPoint = strdup(operation);
+	m_lastError.message = strdup(tmpbuf);
+}
@@ -0,0 +1,1255 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <ring_query.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <logger.h>
+#include <rapidjson/error/en.h>
+#include <algorithm>
+#include <map>
+#include <float.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * The timebucket formats supported, as supported by the SQLite plugin
+ */
+static const struct {
+	const char	*format;
+	const char	*strftime;
+	bool		milliseconds;
+} bucketFormats[] = {
+	{ "HH24:MI:SS",			"%H:%M:%S",		false },
+	{ "YYYY-MM-DD HH24:MI:SS.MS",	"%Y-%m-%d %H:%M:%S",	true },
+	{ "YYYY-MM-DD HH24:MI:SS",	"%Y-%m-%d %H:%M:%S",	false },
+	{ "YYYY-MM-DD HH24:MI",		"%Y-%m-%d %H:%M",	false },
+	{ "YYYY-MM-DD HH24",		"%Y-%m-%d %H",		false },
+	{ NULL,				NULL,			false }
+};
+
+/**
+ * Construct a query against a ring of readings
+ *
+ * @param ring	The ring to query
+ */
+RingQuery::RingQuery(ReadingRing& ring) : m_ring(ring), m_where(NULL), m_group(false),
+	m_groupColumn(ASSET_CODE), m_aggregateAll(false), m_timebucket(false),
+	m_bucketColumn(USER_TS), m_bucketSize(1), m_bucketFormat(NULL), m_bucketMs(false),
+	m_limit(-1), m_skip(0)
+{
+}
+
+/**
+ * Destructor for the query
+ */
+RingQuery::~RingQuery()
+{
+	delete m_where;
+}
+
+/**
+ * Execute a query
+ *
+ * @param query		The JSON query
+ * @param resultSet	The JSON result set
+ * @return		False if the query could not be executed, error() returns the reason
+ */
+bool RingQuery::execute(const string& query, string& resultSet)
+{
+Document	document;
+
+	if (document.Parse(query.c_str()).HasParseError())
+	{
+		raiseError("Failed to parse JSON payload: %s", GetParseError_En(document.GetParseError()));
+		return false;
+	}
+	if (!document.IsObject())
+	{
+		raiseError("The query must be a JSON object");
+		return false;
+	}
+	if (document.HasMember("join"))
+	{
+		raiseError("The query uses features not supported by the ringbuffer plugin");
+		return false;
+	}
+	if (document.HasMember("where"))
+	{
+		m_where = new Condition();
+		if (!parseWhere(document["where"], m_where))
+			return false;
+	}
+	if (document.HasMember("return"))
+	{
+		const Value& returns = document["return"];
+		if (!returns.IsArray())
+		{
+			raiseError("The property return must be an array");
+			return false;
+		}
+		for (auto& item : returns.GetArray())
+		{
+			Selection selection;
+			if (!parseSelection(item, selection))
+				return false;
+			m_returns.push_back(selection);
+		}
+	}
+	if (document.HasMember("timebucket"))
+	{
+		if (!parseTimebucket(document["timebucket"]))
+			return false;
+	}
+	if (document.HasMember("aggregate") && document["aggregate"].IsObject() &&
+			document["aggregate"].HasMember("operation") &&
+			document["aggregate"]["operation"].IsString() &&
+			strcmp(document["aggregate"]["operation"].GetString(), "all") == 0)
+	{
+		// The minimum, maximum, average, count and sum of every datapoint
+		m_aggregateAll = true;
+	}
+	else if (document.HasMember("aggregate"))
+	{
+		const Value& aggregate = document["aggregate"];
+		vector<const Value *> items;
+		if (aggregate.IsArray())
+		{
+			for (auto& item : aggregate.GetArray())
+				items.push_back(&item);
+		}
+		else
+		{
+			items.push_back(&aggregate);
+		}
+		for (auto item : items)
+		{
+			Selection selection;
+			if (!item->IsObject() || !item->HasMember("operation") ||
+					!(*item)["operation"].IsString())
+			{
+				raiseError("Each aggregate must be an object with an operation");
+				return false;
+			}
+			if (!parseSelection(*item, selection))
+				return false;
+			selection.operation = (*item)["operation"].GetString();
+			if (selection.operation.compare("count") && selection.operation.compare("min") &&
+					selection.operation.compare("max") && selection.operation.compare("avg") &&
+					selection.operation.compare("sum"))
+			{
+				raiseError("Unsupported aggregate operation %s", selection.operation.c_str());
+				return false;
+			}
+			if (selection.column == STAR && selection.operation.compare("count"))
+			{
+				raiseError("Only the count aggregate may be applied to *");
+				return false;
+			}
+			if (!item->HasMember("alias"))
+			{
+				selection.alias = selection.operation + "_";
+				if (selection.properties.empty())
+					selection.alias += (*item)["column"].GetString();
+				else
+					selection.alias += selection.properties.back();
+			}
+			m_aggregates.push_back(selection);
+		}
+	}
+	if (document.HasMember("group"))
+	{
+		const Value& group = document["group"];
+		const char *column = NULL;
+		if (group.IsString())
+		{
+			column = group.GetString();
+		}
+		else if (group.IsObject() && group.HasMember("column") && group["column"].IsString())
+		{
+			column = group["column"].GetString();
+			if (group.HasMember("alias") && group["alias"].IsString())
+				m_groupAlias = group["alias"].GetString();
+			if (group.HasMember("format"))
+			{
+				raiseError("Formatting of the group column is not supported");
+				return false;
+			}
+		}
+		if (!column || !parseColumn(column, m_groupColumn) || m_groupColumn == READING)
+		{
+			raiseError("Unsupported group column");
+			return false;
+		}
+		if (m_groupAlias.empty())
+			m_groupAlias = column;
+		m_group = true;
+	}
+	if (document.HasMember("sort"))
+	{
+		if (!parseSort(document["sort"]))
+			return false;
+	}
+	if (document.HasMember("limit"))
+	{
+		if (!document["limit"].IsInt())
+		{
+			raiseError("Limit must be specfied as an integer");
+			return false;
+		}
+		m_limit = document["limit"].GetInt();
+	}
+	if (document.HasMember("skip"))
+	{
+		if (!document["skip"].IsInt())
+		{
+			raiseError("Skip must be specfied as an integer");
+			return false;
+		}
+		m_skip = document["skip"].GetInt();
+	}
+
+	if (m_timebucket && !m_sort.empty())
+	{
+		raiseError("Sort and timebucket modifiers can not be used in the same payload");
+		return false;
+	}
+	if (m_aggregateAll)
+	{
+		if (!m_timebucket || m_group)
+		{
+			raiseError("The aggregate all operation requires a timebucket and may not be grouped");
+			return false;
+		}
+		return executeAggregateAll(resultSet);
+	}
+	if (m_aggregates.empty())
+	{
+		if (m_group || m_timebucket)
+		{
+			raiseError("A group or timebucket may only be used with an aggregate");
+			return false;
+		}
+		return executeSelect(resultSet);
+	}
+	return executeAggregate(resultSet);
+}
+
+/**
+ * Map a column name to a column of the readings
+ *
+ * @param name		The column name
+ * @param column	The column
+ * @return		False if the column is not a column of the readings
+ */
+bool RingQuery::parseColumn(const char *name, Column& column)
+{
+	if (strcmp(name, "id") == 0)
+		column = ID;
+	else if (strcmp(name, "asset_code") == 0)
+		column = ASSET_CODE;
+	else if (strcmp(name, "reading") == 0)
+		column = READING;
+	else if (strcmp(name, "user_ts") == 0)
+		column = USER_TS;
+	else if (strcmp(name, "ts") == 0)
+		column = TS;
+	else if (strcmp(name, "*") == 0)
+		column = STAR;
+	else
+		return false;
+	return true;
+}
+
+/**
+ * Parse a where clause, with any and or or clauses it contains
+ *
+ * @param where		The JSON where clause
+ * @param condition	The condition to populate
+ * @return		False if the where clause is not supported
+ */
+bool RingQuery::parseWhere(const Value& where, Condition *condition)
+{
+	if (!where.IsObject() || !where.HasMember("column") || !where["column"].IsString() ||
+			!where.HasMember("condition") || !where["condition"].IsString())
+	{
+		raiseError("The where clause must be an object with a column and a condition");
+		return false;
+	}
+	if (!parseColumn(where["column"].GetString(), condition->m_column) ||
+			condition->m_column == READING || condition->m_column == STAR)
+	{
+		raiseError("Unsupported column %s in where clause", where["column"].GetString());
+		return false;
+	}
+	condition->m_condition = where["condition"].GetString();
+	const string& cond = condition->m_condition;
+	bool isTime = condition->m_column == USER_TS || condition->m_column == TS;
+
+	if (cond.compare("isnull") && cond.compare("notnull"))
+	{
+		if (!where.HasMember("value"))
+		{
+			raiseError("The where clause is missing a value");
+			return false;
+		}
+		const Value& value = where["value"];
+		if (!cond.compare("older") || !cond.compare("newer"))
+		{
+			if (!isTime || !value.IsInt())
+			{
+				raiseError("The value of an %s condition must be an integer number of seconds", cond.c_str());
+				return false;
+			}
+			condition->m_number = ReadingRing::now() - (int64_t)value.GetInt() * 1000000;
+		}
+		else if (!cond.compare("in") || !cond.compare("not in"))
+		{
+			if (!value.IsArray() || value.Size() == 0)
+			{
+				raiseError("The value of an %s condition must be a non empty array", cond.c_str());
+				return false;
+			}
+			for (auto& item : value.GetArray())
+			{
+				if (condition->m_column == ASSET_CODE && item.IsString())
+				{
+					condition->m_strings.push_back(item.GetString());
+				}
+				else if (condition->m_column == ID && item.IsInt64())
+				{
+					condition->m_numbers.push_back(item.GetInt64());
+				}
+				else
+				{
+					raiseError("Unsupported value in %s condition", cond.c_str());
+					return false;
+				}
+			}
+		}
+		else if (!cond.compare("=") || !cond.compare("!=") || !cond.compare("<") ||
+				!cond.compare(">") || !cond.compare("<=") || !cond.compare(">="))
+		{
+			if (condition->m_column == ASSET_CODE && value.IsString())
+			{
+				condition->m_string = value.GetString();
+			}
+			else if (condition->m_column == ID && value.IsInt64())
+			{
+				condition->m_number = value.GetInt64();
+			}
+			else if (isTime && value.IsString())
+			{
+				if (!ReadingRing::parseTimestamp(value.GetString(), condition->m_number))
+				{
+					raiseError("Invalid timestamp %s in where clause", value.GetString());
+					return false;
+				}
+			}
+			else
+			{
+				raiseError("Unsupported value for column %s in where clause", where["column"].GetString());
+				return false;
+			}
+		}
+		else
+		{
+			raiseError("Unsupported condition %s in where clause", cond.c_str());
+			return false;
+		}
+	}
+
+	if (where.HasMember("and"))
+	{
+		condition->m_and = new Condition();
+		if (!parseWhere(where["and"], condition->m_and))
+			return false;
+	}
+	if (where.HasMember("or"))
+	{
+		condition->m_or = new Condition();
+		if (!parseWhere(where["or"], condition->m_or))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Parse a column, or reading property, to return or aggregate
+ *
+ * @param value		The JSON column definition
+ * @param selection	The selection to populate
+ * @return		False if the selection is not supported
+ */
+bool RingQuery::parseSelection(const Value& value, Selection& selection)
+{
+	if (value.IsString())
+	{
+		if (!parseColumn(value.GetString(), selection.column))
+		{
+			raiseError("Unsupported column %s", value.GetString());
+			return false;
+		}
+		selection.alias = value.GetString();
+		return true;
+	}
+	if (!value.IsObject())
+	{
+		raiseError("Columns must be strings or objects");
+		return false;
+	}
+	if (value.HasMember("column") && value["column"].IsString())
+	{
+		if (!parseColumn(value["column"].GetString(), selection.column))
+		{
+			raiseError("Unsupported column %s", value["column"].GetString());
+			return false;
+		}
+	}
+	else if (value.HasMember("json") && value["json"].IsObject() &&
+			value["json"].HasMember("properties"))
+	{
+		const Value& properties = value["json"]["properties"];
+		selection.column = READING;
+		if (properties.IsString())
+		{
+			selection.properties.push_back(properties.GetString());
+		}
+		else if (properties.IsArray() && properties.Size() > 0)
+		{
+			for (auto& property : properties.GetArray())
+			{
+				if (!property.IsString())
+				{
+					raiseError("Reading properties must be strings");
+					return false;
+				}
+				selection.properties.push_back(property.GetString());
+			}
+		}
+		else
+		{
+			raiseError("Invalid reading properties");
+			return false;
+		}
+	}
+	else
+	{
+		raiseError("A column or json property must be given");
+		return false;
+	}
+	if (value.HasMember("alias") && value["alias"].IsString())
+	{
+		selection.alias = value["alias"].GetString();
+	}
+	else if (selection.properties.empty() && value.HasMember("column"))
+	{
+		selection.alias = value["column"].GetString();
+	}
+	else if (!selection.properties.empty())
+	{
+		selection.alias = selection.properties.back();
+	}
+	return true;
+}
+
+/**
+ * Parse the sort order of the query
+ *
+ * @param sort	A sort object or an array of sort objects
+ * @return	False if the sort is not supported
+ */
+bool RingQuery::parseSort(const Value& sort)
+{
+	vector<const Value *> items;
+	if (sort.IsArray())
+	{
+		for (auto& item : sort.GetArray())
+			items.push_back(&item);
+	}
+	else
+	{
+		items.push_back(&sort);
+	}
+	for (auto item : items)
+	{
+		if (!item->IsObject() || !item->HasMember("column") || !(*item)["column"].IsString())
+		{
+			raiseError("The sort property must be an object with a column");
+			return false;
+		}
+		bool descending = false;
+		if (item->HasMember("direction") && (*item)["direction"].IsString())
+		{
+			descending = strcasecmp((*item)["direction"].GetString(), "desc") == 0;
+		}
+		m_sort.push_back(make_pair(string((*item)["column"].GetString()), descending));
+	}
+	return true;
+}
+
+/**
+ * Parse the timebucket of the query
+ *
+ * @param timebucket	The timebucket object
+ * @return		False if the timebucket is not supported
+ */
+bool RingQuery::parseTimebucket(const Value& timebucket)
+{
+	if (!timebucket.IsObject() || !timebucket.HasMember("timestamp") ||
+			!timebucket["timestamp"].IsString())
+	{
+		raiseError("The timebucket property must be an object with a timestamp property");
+		return false;
+	}
+	const char *column = timebucket["timestamp"].GetString();
+	if (!parseColumn(column, m_bucketColumn) || (m_bucketColumn != USER_TS && m_bucketColumn != TS))
+	{
+		raiseError("Unsupported timebucket timestamp %s", column);
+		return false;
+	}
+	if (timebucket.HasMember("size"))
+	{
+		const Value& size = timebucket["size"];
+		if (size.IsString())
+			m_bucketSize = atof(size.GetString());
+		else if (size.IsNumber())
+			m_bucketSize = size.GetDouble();
+		if (m_bucketSize <= 0)
+			m_bucketSize = 1;
+	}
+	if (timebucket.HasMember("format") && timebucket["format"].IsString())
+	{
+		for (int i = 0; bucketFormats[i].format; i++)
+		{
+			if (strcmp(bucketFormats[i].format, timebucket["format"].GetString()) == 0)
+			{
+				m_bucketFormat = bucketFormats[i].strftime;
+				m_bucketMs = bucketFormats[i].milliseconds;
+			}
+		}
+	}
+	if (timebucket.HasMember("alias") && timebucket["alias"].IsString())
+		m_bucketAlias = timebucket["alias"].GetString();
+	else
+		m_bucketAlias = "timestamp";
+	m_timebucket = true;
+	return true;
+}
+
+/**
+ * Return the timebucket of a reading. Buckets of the aggregate all
+ * operation are centred on a multiple of the bucket size, otherwise
+ * a bucket starts at a multiple of the bucket size.
+ *
+ * @param record	The reading
+ * @return		The bucket number, the bucket time divided by the bucket size
+ */
+int64_t RingQuery::bucket(const RingRecord *record) const
+{
+	int64_t timestamp = m_bucketColumn == USER_TS ? record->userTs : record->ts;
+	if (m_aggregateAll)
+	{
+		return llround((double)timestamp / 1000000 / m_bucketSize);
+	}
+	// Whole seconds, as the SQLite plugin uses
+	int64_t seconds = timestamp / 1000000;
+	if (timestamp % 1000000 < 0)
+		seconds--;
+	return (int64_t)floor(seconds / m_bucketSize);
+}
+
+/**
+ * Format the time of a timebucket. The buckets of the aggregate all
+ * operation are given in local time if formatted or smaller than a
+ * second, as they are by the SQLite plugin, other buckets in UTC.
+ *
+ * @param bucket	The bucket number
+ * @param buffer	The buffer to format the time into
+ * @param size		The size of the buffer
+ */
+void RingQuery::formatBucket(int64_t bucket, char *buffer, size_t size) const
+{
+struct tm	tm;
+
+	int64_t timestamp = llround(bucket * m_bucketSize * 1000000);
+	time_t seconds = timestamp / 1000000;
+	long usec = timestamp % 1000000;
+	if (usec < 0)
+	{
+		seconds--;
+		usec += 1000000;
+	}
+	bool subSecond = m_aggregateAll && m_bucketSize < 1;
+	if (m_aggregateAll && (m_bucketFormat || subSecond))
+		localtime_r(&seconds, &tm);
+	else
+		gmtime_r(&seconds, &tm);
+	size_t len = strftime(buffer, size,
+			m_bucketFormat && !subSecond ? m_bucketFormat : "%Y-%m-%d %H:%M:%S", &tm);
+	if (subSecond)
+		snprintf(buffer + len, size - len, ".%06ld", usec);
+	else if (m_bucketMs)
+		snprintf(buffer + len, size - len, ".%03ld", usec / 1000);
+}
+
+/**
+ * Test if a reading matches a where clause
+ *
+ * @param condition	The where clause
+ * @param record	The reading
+ * @param assetCode	The asset code of the reading
+ * @return		True if the reading matches
+ */
+bool RingQuery::matches(const Condition *condition, const RingRecord *record,
+			const string& assetCode) const
+{
+	bool match;
+	switch (condition->m_column)
+	{
+		case ASSET_CODE:
+			match = compare(condition, assetCode);
+			break;
+		case ID:
+			match = compare(condition, (int64_t)record->id);
+			break;
+		case USER_TS:
+			match = compare(condition, record->userTs);
+			break;
+		case TS:
+			match = compare(condition, record->ts);
+			break;
+		default:
+			match = false;
+			break;
+	}
+	if (match && condition->m_and)
+	{
+		match = matches(condition->m_and, record, assetCode);
+	}
+	if (!match && condition->m_or)
+	{
+		match = matches(condition->m_or, record, assetCode);
+	}
+	return match;
+}
+
+/**
+ * Compare a numeric column with a condition
+ */
+bool RingQuery::compare(const Condition *condition, int64_t value) const
+{
+	const string& cond = condition->m_condition;
+	int64_t operand = condition->m_number;
+
+	if (!cond.compare("="))
+		return value == operand;
+	if (!cond.compare("!="))
+		return value != operand;
+	if (!cond.compare("<") || !cond.compare("older"))
+		return value < operand;
+	if (!cond.compare(">") || !cond.compare("newer"))
+		return value > operand;
+	if (!cond.compare("<="))
+		return value <= operand;
+	if (!cond.compare(">="))
+		return value >= operand;
+	if (!cond.compare("in") || !cond.compare("not in"))
+	{
+		bool found = find(condition->m_numbers.begin(), condition->m_numbers.end(), value)
+				!= condition->m_numbers.end();
+		return cond.compare("in") == 0 ? found : !found;
+	}
+	return !cond.compare("notnull");
+}
+
+/**
+ * Compare a string column with a condition
+ */
+bool RingQuery::compare(const Condition *condition, const string& value) const
+{
+	const string& cond = condition->m_condition;
+
+	if (!cond.compare("in") || !cond.compare("not in"))
+	{
+		bool found = find(condition->m_strings.begin(), condition->m_strings.end(), value)
+				!= condition->m_strings.end();
+		return cond.compare("in") == 0 ? found : !found;
+	}
+	if (!cond.compare("isnull"))
+		return false;
+	if (!cond.compare("notnull"))
+		return true;
+
+	int rval = value.compare(condition->m_string);
+	if (!cond.compare("="))
+		return rval == 0;
+	if (!cond.compare("!="))
+		return rval != 0;
+	if (!cond.compare("<"))
+		return rval < 0;
+	if (!cond.compare(">"))
+		return rval > 0;
+	if (!cond.compare("<="))
+		return rval <= 0;
+	return rval >= 0;
+}
+
+/**
+ * Compare two matching readings using the sort order of the query
+ */
+bool RingQuery::lessThan(const Match& a, const Match& b) const
+{
+	for (auto& sort : m_sort)
+	{
+		int rval = 0;
+		if (sort.first.compare("asset_code") == 0)
+			rval = a.assetCode.compare(b.assetCode);
+		else if (sort.first.compare("user_ts") == 0)
+			rval = a.userTs < b.userTs ? -1 : (a.userTs > b.userTs ? 1 : 0);
+		else if (sort.first.compare("ts") == 0)
+			rval = a.ts < b.ts ? -1 : (a.ts > b.ts ? 1 : 0);
+		else
+			rval = a.id < b.id ? -1 : (a.id > b.id ? 1 : 0);
+		if (rval != 0)
+			return sort.second ? rval > 0 : rval < 0;
+	}
+	return a.id < b.id;
+}
+
+/**
+ * Execute a query that returns readings. The matching readings are found
+ * in a first pass over the ring, then sorted and limited, and only the
+ * readings that are returned are formatted.
+ *
+ * @param resultSet	The JSON result set
+ * @return		True if the query succeeded
+ */
+bool RingQuery::executeSelect(string& resultSet)
+{
+	for (auto& sort : m_sort)
+	{
+		if (sort.first.compare("id") && sort.first.compare("asset_code") &&
+				sort.first.compare("user_ts") && sort.first.compare("ts"))
+		{
+			raiseError("Unsupported sort column %s", sort.first.c_str());
+			return false;
+		}
+	}
+
+	// Readings are held in id order, if that is the order required the
+	// scan can stop as soon as enough readings have been found
+	bool idOrder = m_sort.empty() || m_sort[0].first.compare("id") == 0;
+	bool reverse = idOrder && !m_sort.empty() && m_sort[0].second;
+	size_t required = m_limit >= 0 && idOrder ? (size_t)(m_skip + m_limit) : SIZE_MAX;
+
+	vector<Match> found;
+	if (required > 0)
+	{
+		m_ring.scan(reverse, [this, &found, required](const RingRecord *record,
+				const char *, const string& assetCode) -> bool {
+			if (m_where && !matches(m_where, record, assetCode))
+				return true;
+			Match match;
+			match.id = record->id;
+			match.userTs = record->userTs;
+			match.ts = record->ts;
+			match.assetCode = assetCode;
+			found.push_back(match);
+			return found.size() < required;
+		});
+	}
+
+	if (!idOrder)
+	{
+		size_t n = m_limit >= 0 ? min(found.size(), (size_t)(m_skip + m_limit)) : found.size();
+		partial_sort(found.begin(), found.begin() + n, found.end(),
+				[this](const Match& a, const Match& b) { return lessThan(a, b); });
+		found.resize(n);
+	}
+
+	vector<uint64_t> ids;
+	for (size_t i = m_skip; i < found.size(); i++)
+	{
+		if (m_limit >= 0 && ids.size() >= (size_t)m_limit)
+			break;
+		ids.push_back(found[i].id);
+	}
+
+	bool needReading = m_returns.empty();
+	for (auto& selection : m_returns)
+	{
+		if (selection.column == READING)
+			needReading = true;
+	}
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	unsigned long count = 0;
+	char timestamp[40];
+
+	string json;
+	writer.StartArray();
+	m_ring.lookup(ids, [&](const RingRecord *record, const char *reading,
+				const string& assetCode) -> bool {
+		size_t length = record->length;
+		if (needReading && RDS_PAYLOAD_IS_BINARY(reading))
+		{
+			if (!ReadingStreamPayload::toJSON(reading, length, json))
+				json = "{}";
+			reading = json.c_str();
+			length = json.length();
+		}
+		writer.StartObject();
+		if (m_returns.empty())
+		{
+			writer.Key("id");
+			writer.Uint64(record->id);
+			writer.Key("asset_code");
+			writer.String(assetCode.c_str(), assetCode.length());
+			writer.Key("reading");
+			writer.RawValue(reading, length, kObjectType);
+			writer.Key("user_ts");
+			ReadingRing::formatTimestamp(record->userTs, timestamp, sizeof(timestamp));
+			writer.String(timestamp);
+			writer.Key("ts");
+			ReadingRing::formatTimestamp(record->ts, timestamp, sizeof(timestamp));
+			writer.String(timestamp);
+		}
+		else
+		{
+			Document doc;
+			if (needReading)
+				doc.Parse(reading, length);
+			for (auto& selection : m_returns)
+			{
+				writer.Key(selection.alias.c_str());
+				switch (selection.column)
+				{
+					case ID:
+						writer.Uint64(record->id);
+						break;
+					case ASSET_CODE:
+						writer.String(assetCode.c_str(), assetCode.length());
+						break;
+					case USER_TS:
+						ReadingRing::formatTimestamp(record->userTs, timestamp, sizeof(timestamp));
+						writer.String(timestamp);
+						break;
+					case TS:
+						ReadingRing::formatTimestamp(record->ts, timestamp, sizeof(timestamp));
+						writer.String(timestamp);
+						break;
+					default:
+					{
+						const Value *value = doc.HasParseError() ? NULL :
+								(selection.properties.empty() ? &doc : property(doc, selection.properties));
+						if (value)
+							value->Accept(writer);
+						else
+							writer.Null();
+						break;
+					}
+				}
+			}
+		}
+		writer.EndObject();
+		count++;
+		return true;
+	});
+	writer.EndArray();
+
+	resultSet = "{\"count\":" + to_string(count) + ",\"rows\":";
+	resultSet.append(buffer.GetString(), buffer.GetSize());
+	resultSet += "}";
+	return true;
+}
+
+/**
+ * Execute a query with aggregates, optionally grouped by a column and
+ * a timebucket. The aggregates are calculated in a single pass over
+ * the ring.
+ *
+ * @param resultSet	The JSON result set
+ * @return		True if the query succeeded
+ */
+bool RingQuery::executeAggregate(string& resultSet)
+{
+	bool needReading = false;
+	for (auto& aggregate : m_aggregates)
+	{
+		if (aggregate.column == READING)
+		{
+			if (aggregate.properties.empty())
+			{
+				raiseError("Aggregates of the reading column must name a property");
+				return false;
+			}
+			needReading = true;
+		}
+	}
+
+	// Groups are keyed by the timebucket and the value of the group column
+	typedef pair<int64_t, string> Key;
+	Aggregate initial = { 0, 0.0, DBL_MAX, -DBL_MAX };
+	map<Key, vector<Aggregate> > groups;
+	if (!m_group && !m_timebucket)
+	{
+		groups[Key(0, "")] = vector<Aggregate>(m_aggregates.size(), initial);
+	}
+
+	m_ring.scan(false, [&](const RingRecord *record, const char *reading,
+				const string& assetCode) -> bool {
+		if (m_where && !matches(m_where, record, assetCode))
+			return true;
+		Key key(m_timebucket ? bucket(record) : 0, "");
+		if (m_group)
+		{
+			switch (m_groupColumn)
+			{
+				case ASSET_CODE:
+					key.second = assetCode;
+					break;
+				case ID:
+					key.second = to_string(record->id);
+					break;
+				default:
+				{
+					char timestamp[40];
+					ReadingRing::formatTimestamp(m_groupColumn == USER_TS ? record->userTs : record->ts,
+							timestamp, sizeof(timestamp));
+					key.second = timestamp;
+					break;
+				}
+			}
+		}
+		auto it = groups.find(key);
+		if (it == groups.end())
+			it = groups.insert(make_pair(key, vector<Aggregate>(m_aggregates.size(), initial))).first;
+
+		// Readings held as JSON are parsed once for all of the aggregates
+		Document doc;
+		if (needReading && !RDS_PAYLOAD_IS_BINARY(reading))
+			doc.Parse(reading, record->length);
+		for (size_t i = 0; i < m_aggregates.size(); i++)
+		{
+			const Selection& selection = m_aggregates[i];
+			Aggregate& state = it->second[i];
+			double value;
+			switch (selection.column)
+			{
+				case STAR:
+				case ASSET_CODE:
+					state.count++;
+					continue;
+				case ID:
+					value = record->id;
+					break;
+				case USER_TS:
+					value = record->userTs;
+					break;
+				case TS:
+					value = record->ts;
+					break;
+				default:
+					if (!number(record, reading, doc, selection.properties, value))
+						continue;
+					break;
+			}
+			state.count++;
+			state.sum += value;
+			if (value < state.min)
+				state.min = value;
+			if (value > state.max)
+				state.max = value;
+		}
+		return true;
+	});
+
+	// Order the groups, by the group column or an aggregate. Timebuckets
+	// are returned newest first.
+	vector<pair<const Key *, vector<Aggregate> *> > rows;
+	for (auto& group : groups)
+		rows.push_back(make_pair(&group.first, &group.second));
+	if (m_timebucket)
+	{
+		stable_sort(rows.begin(), rows.end(), [](const pair<const Key *, vector<Aggregate> *>& a,
+				const pair<const Key *, vector<Aggregate> *>& b) -> bool {
+			return a.first->first > b.first->first;
+		});
+	}
+	for (auto sort = m_sort.rbegin(); sort != m_sort.rend(); ++sort)
+	{
+		int index = -1;
+		for (size_t i = 0; i < m_aggregates.size(); i++)
+		{
+			if (m_aggregates[i].alias.compare(sort->first) == 0)
+				index = i;
+		}
+		bool descending = sort->second;
+		stable_sort(rows.begin(), rows.end(), [index, descending, this](
+				const pair<const Key *, vector<Aggregate> *>& a,
+				const pair<const Key *, vector<Aggregate> *>& b) -> bool {
+			if (index < 0)
+				return descending ? a.first->second > b.first->second : a.first->second < b.first->second;
+			const Aggregate& x = (*a.second)[index];
+			const Aggregate& y = (*b.second)[index];
+			double vx = m_aggregates[index].operation.compare("count") ? x.sum : x.count;
+			double vy = m_aggregates[index].operation.compare("count") ? y.sum : y.count;
+			return descending ? vx > vy : vx < vy;
+		});
+	}
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	unsigned long count = 0;
+	char timestamp[40];
+
+	writer.StartArray();
+	for (size_t row = m_skip; row < rows.size(); row++)
+	{
+		if (m_limit >= 0 && count >= (unsigned long)m_limit)
+			break;
+		writer.StartObject();
+		if (m_group)
+		{
+			writer.Key(m_groupAlias.c_str());
+			writer.String(rows[row].first->second.c_str());
+		}
+		for (size_t i = 0; i < m_aggregates.size(); i++)
+		{
+			const Selection& selection = m_aggregates[i];
+			const Aggregate& state = (*rows[row].second)[i];
+			writer.Key(selection.alias.c_str());
+			if (selection.operation.compare("count") == 0)
+			{
+				writer.Uint64(state.count);
+			}
+			else if (state.count == 0)
+			{
+				writer.Null();
+			}
+			else
+			{
+				double value;
+				if (selection.operation.compare("min") == 0)
+					value = state.min;
+				else if (selection.operation.compare("max") == 0)
+					value = state.max;
+				else if (selection.operation.compare("avg") == 0)
+					value = state.sum / state.count;
+				else
+					value = state.sum;
+				if ((selection.column == USER_TS || selection.column == TS) &&
+						selection.operation.compare("sum") && selection.operation.compare("avg"))
+				{
+					ReadingRing::formatTimestamp((int64_t)value, timestamp, sizeof(timestamp));
+					writer.String(timestamp);
+				}
+				else
+				{
+					writer.Double(value);
+				}
+			}
+		}
+		if (m_timebucket)
+		{
+			writer.Key(m_bucketAlias.c_str());
+			formatBucket(rows[row].first->first, timestamp, sizeof(timestamp));
+			writer.String(timestamp);
+		}
+		writer.EndObject();
+		count++;
+	}
+	writer.EndArray();
+
+	resultSet = "{\"count\":" + to_string(count) + ",\"rows\":";
+	resultSet.append(buffer.GetString(), buffer.GetSize());
+	resultSet += "}";
+	return true;
+}
+
+/**
+ * Execute a timebucket query for the aggregate all operation. The
+ * minimum, maximum, average, count and sum of each numeric datapoint
+ * are returned for each asset in each timebucket, newest first.
+ *
+ * @param resultSet	The JSON result set
+ * @return		True if the query succeeded
+ */
+bool RingQuery::executeAggregateAll(string& resultSet)
+{
+	typedef pair<int64_t, string> Key;
+	map<Key, map<string, Aggregate> > buckets;
+
+	m_ring.scan(false, [&](const RingRecord *record, const char *reading,
+				const string& assetCode) -> bool {
+		if (m_where && !matches(m_where, record, assetCode))
+			return true;
+		map<string, Aggregate>& datapoints = buckets[Key(bucket(record), assetCode)];
+		auto add = [&datapoints](const string& name, double value) {
+			auto it = datapoints.find(name);
+			if (it == datapoints.end())
+			{
+				Aggregate initial = { 0, 0.0, DBL_MAX, -DBL_MAX };
+				it = datapoints.insert(make_pair(name, initial)).first;
+			}
+			Aggregate& state = it->second;
+			state.count++;
+			state.sum += value;
+			if (value < state.min)
+				state.min = value;
+			if (value > state.max)
+				state.max = value;
+		};
+		if (RDS_PAYLOAD_IS_BINARY(reading))
+		{
+			ReadingStreamPayload::numbers(reading, record->length,
+				[&add](const char *name, uint32_t length, double value) {
+					add(string(name, length), value);
+				});
+		}
+		else
+		{
+			Document doc;
+			if (!doc.Parse(reading, record->length).HasParseError() && doc.IsObject())
+			{
+				for (auto& member : doc.GetObject())
+				{
+					if (member.value.IsNumber())
+						add(member.name.GetString(), member.value.GetDouble());
+				}
+			}
+		}
+		return true;
+	});
+
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	unsigned long count = 0;
+	long skip = m_skip;
+	char timestamp[40];
+
+	writer.StartArray();
+	for (auto it = buckets.rbegin(); it != buckets.rend(); ++it)
+	{
+		if (it->second.empty())
+			continue;
+		if (skip > 0)
+		{
+			skip--;
+			continue;
+		}
+		if (m_limit >= 0 && count >= (unsigned long)m_limit)
+			break;
+		writer.StartObject();
+		writer.Key("asset_code");
+		writer.String(it->first.second.c_str(), it->first.second.length());
+		writer.Key(m_bucketAlias.c_str());
+		formatBucket(it->first.first, timestamp, sizeof(timestamp));
+		writer.String(timestamp);
+		writer.Key("reading");
+		writer.StartObject();
+		for (auto& datapoint : it->second)
+		{
+			const Aggregate& state = datapoint.second;
+			writer.Key(datapoint.first.c_str(), datapoint.first.length());
+			writer.StartObject();
+			writer.Key("min");
+			writer.Double(state.min);
+			writer.Key("max");
+			writer.Double(state.max);
+			writer.Key("average");
+			writer.Double(state.sum / state.count);
+			writer.Key("count");
+			writer.Uint64(state.count);
+			writer.Key("sum");
+			writer.Double(state.sum);
+			writer.EndObject();
+		}
+		writer.EndObject();
+		writer.EndObject();
+		count++;
+	}
+	writer.EndArray();
+
+	resultSet = "{\"count\":" + to_string(count) + ",\"rows\":";
+	resultSet.append(buffer.GetString(), buffer.GetSize());
+	resultSet += "}";
+	return true;
+}
+
+/**
+ * Find a property, possibly nested, within a reading
+ *
+ * @param reading	The parsed reading
+ * @param properties	The path of the property
+ * @return		The property or NULL if the reading does not have the property
+ */
+const Value *RingQuery::property(const Value& reading, const vector<string>& properties) const
+{
+	const Value *value = &reading;
+	for (auto& name : properties)
+	{
+		if (!value->IsObject())
+			return NULL;
+		Value::ConstMemberIterator it = value->FindMember(name.c_str());
+		if (it == value->MemberEnd())
+			return NULL;
+		value = &it->value;
+	}
+	return value;
+}
+
+/**
+ * Get a numeric reading property. Readings held as binary payloads are
+ * read directly, readings held as JSON use the parsed document.
+ *
+ * @param record	The reading
+ * @param reading	The datapoints of the reading
+ * @param doc		The parsed JSON of a reading held as JSON
+ * @param properties	The path of the property
+ * @param value		The value of the property
+ * @return		False if the reading does not have the property or it is not a number
+ */
+bool RingQuery::number(const RingRecord *record, const char *reading, const Document& doc,
+			const vector<string>& properties, double& value) const
+{
+	if (RDS_PAYLOAD_IS_BINARY(reading))
+	{
+		return ReadingStreamPayload::number(reading, record->length, properties, value);
+	}
+	const Value *v = doc.HasParseError() ? NULL : property(doc, properties);
+	if (!v || !v->IsNumber())
+		return false;
+	value = v->GetDouble();
+	return true;
+}
+
+/**
+ * Record the reason a query failed
+ *
+ * @param reason	The printf format of the reason
+ */
+void RingQuery::raiseError(const char *reason, ...)
+{
+char	tmpbuf[512];
+
+	va_list ap;
+	va_start(ap, reason);
+	vsnprintf(tmpbuf, sizeof(tmpbuf), reason, ap);
+	va_end(ap);
+	m_error = tmpbuf;
+}
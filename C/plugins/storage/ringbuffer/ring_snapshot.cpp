@@ -0,0 +1,348 @@
+/*
+ * Fledge storage service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <ring_snapshot.h>
+#include <logger.h>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define	JOURNAL_MAGIC		"FLRING1\n"
+#define JOURNAL_MAGIC_LEN	8
+
+/*
+ * The entries in the journal, each is a single byte type followed
+ * by the data of the entry
+ */
+#define	JOURNAL_ASSET	'A'	// uint32 asset id, uint32 length, asset code
+#define	JOURNAL_READING	'R'	// RingRecord, reading
+#define	JOURNAL_REMOVE	'X'	// uint32 asset id of an asset that has been removed
+#define	JOURNAL_TAIL	'T'	// uint64 id of the oldest reading in the ring, uint64 id of the next reading
+
+#define JOURNAL_COMPACT_MIN	(1024 * 1024)	// Minimum journal size before it is rewritten
+
+/**
+ * Construct a snapshot
+ *
+ * @param filename	The full path of the journal file
+ */
+RingSnapshot::RingSnapshot(const string& filename) : m_filename(filename),
+	m_savedId(0), m_savedFirst(0), m_savedAssets(0), m_size(0)
+{
+}
+
+/**
+ * Load the journal into the ring. If the end of the journal is
+ * incomplete, as a result of the system stopping during a snapshot,
+ * the complete entries are loaded and the journal is rewritten by
+ * the next snapshot.
+ *
+ * @param ring	The ring to load the readings into
+ * @return	True if readings were loaded from the journal
+ */
+bool RingSnapshot::load(ReadingRing& ring)
+{
+	FILE *fp = fopen(m_filename.c_str(), "r");
+	if (!fp)
+	{
+		if (errno != ENOENT)
+		{
+			Logger::getLogger()->warn("Unable to open readings snapshot %s: %s",
+					m_filename.c_str(), strerror(errno));
+		}
+		return false;
+	}
+	string journal;
+	char buffer[65536];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+	{
+		journal.append(buffer, n);
+	}
+	fclose(fp);
+
+	if (journal.length() < JOURNAL_MAGIC_LEN ||
+			journal.compare(0, JOURNAL_MAGIC_LEN, JOURNAL_MAGIC) != 0)
+	{
+		Logger::getLogger()->error("The readings snapshot %s is not valid and will be replaced",
+				m_filename.c_str());
+		return false;
+	}
+
+	lock_guard<mutex> guard(ring.m_mutex);
+	const char *p = journal.data() + JOURNAL_MAGIC_LEN;
+	const char *end = journal.data() + journal.length();
+	bool complete = true;
+	unsigned long failed = 0;
+	while (p < end && complete)
+	{
+		char type = *p++;
+		size_t remaining = end - p;
+		switch (type)
+		{
+			case JOURNAL_ASSET:
+			{
+				uint32_t id, length;
+				if (remaining < 2 * sizeof(uint32_t))
+				{
+					complete = false;
+					break;
+				}
+				memcpy(&id, p, sizeof(id));
+				memcpy(&length, p + sizeof(id), sizeof(length));
+				if (remaining < 2 * sizeof(uint32_t) + length)
+				{
+					complete = false;
+					break;
+				}
+				ring.restoreAsset(id, string(p + 2 * sizeof(uint32_t), length));
+				p += 2 * sizeof(uint32_t) + length;
+				break;
+			}
+			case JOURNAL_READING:
+			{
+				RingRecord record;
+				if (remaining < sizeof(RingRecord))
+				{
+					complete = false;
+					break;
+				}
+				memcpy(&record, p, sizeof(record));
+				if (remaining < sizeof(RingRecord) + record.length)
+				{
+					complete = false;
+					break;
+				}
+				if (!ring.restore(&record, p + sizeof(RingRecord)))
+					failed++;
+				p += sizeof(RingRecord) + record.length;
+				break;
+			}
+			case JOURNAL_REMOVE:
+			{
+				uint32_t id;
+				if (remaining < sizeof(id))
+				{
+					complete = false;
+					break;
+				}
+				memcpy(&id, p, sizeof(id));
+				ring.removeAsset(id);
+				p += sizeof(id);
+				break;
+			}
+			case JOURNAL_TAIL:
+			{
+				uint64_t id, next;
+				if (remaining < 2 * sizeof(uint64_t))
+				{
+					complete = false;
+					break;
+				}
+				memcpy(&id, p, sizeof(id));
+				memcpy(&next, p + sizeof(id), sizeof(next));
+				ring.discardBefore(id);
+				// Readings removed before they were journalled still used an id
+				if (ring.m_nextId < next)
+					ring.m_nextId = next;
+				p += 2 * sizeof(uint64_t);
+				break;
+			}
+			default:
+				complete = false;
+				break;
+		}
+	}
+
+	if (failed)
+	{
+		Logger::getLogger()->warn("%ld readings in the snapshot %s could not be restored",
+				failed, m_filename.c_str());
+	}
+	m_savedId = ring.m_nextId - 1;
+	m_savedFirst = ring.m_index.empty() ? ring.m_nextId : ring.record(ring.m_index.front())->id;
+	m_savedAssets = ring.m_assets.size();
+	if (complete)
+	{
+		m_size = journal.length();
+	}
+	else
+	{
+		Logger::getLogger()->warn("The readings snapshot %s is incomplete, the readings before the incomplete entry have been restored",
+				m_filename.c_str());
+		m_size = 0;	// Force the journal to be rewritten
+	}
+	ring.m_removedAssets.clear();
+	Logger::getLogger()->info("Restored %ld readings from %s", ring.m_live, m_filename.c_str());
+	return true;
+}
+
+/**
+ * Take a snapshot of the ring. The changes since the last snapshot
+ * are appended to the journal, or the journal is rewritten if it has
+ * become much larger than the data in the ring.
+ *
+ * @param ring	The ring to snapshot
+ * @return	True if the snapshot was written
+ */
+bool RingSnapshot::save(ReadingRing& ring)
+{
+	string journal;
+	bool full = m_size == 0 || m_size > 2 * ring.used() + JOURNAL_COMPACT_MIN;
+
+	collect(ring, full, journal);
+	if (journal.empty())
+	{
+		return true;	// Nothing has changed
+	}
+
+	bool rval;
+	if (full)
+	{
+		string tmpname = m_filename + ".tmp";
+		rval = write(tmpname, journal, true);
+		if (rval && rename(tmpname.c_str(), m_filename.c_str()) != 0)
+		{
+			Logger::getLogger()->error("Unable to rename readings snapshot %s: %s",
+					tmpname.c_str(), strerror(errno));
+			rval = false;
+		}
+		if (rval)
+			m_size = journal.length();
+	}
+	else
+	{
+		rval = write(m_filename, journal, false);
+		if (rval)
+			m_size += journal.length();
+	}
+	if (!rval)
+	{
+		m_size = 0;	// Entries may have been lost, rewrite the journal next time
+	}
+	else
+	{
+		m_savedId = m_collectedId;
+		m_savedFirst = m_collectedFirst;
+		m_savedAssets = m_collectedAssets;
+	}
+	return rval;
+}
+
+/**
+ * Collect the journal entries for a snapshot with the ring locked.
+ *
+ * @param ring		The ring to snapshot
+ * @param full		Collect the entire contents of the ring rather than the changes
+ * @param journal	The journal entries, empty if nothing has changed
+ */
+void RingSnapshot::collect(ReadingRing& ring, bool full, string& journal)
+{
+	lock_guard<mutex> guard(ring.m_mutex);
+
+	uint64_t first = ring.m_index.empty() ? ring.m_nextId : ring.record(ring.m_index.front())->id;
+	m_collectedId = ring.m_nextId - 1;
+	m_collectedFirst = first;
+	m_collectedAssets = ring.m_assets.size();
+
+	if (!full && m_savedId == m_collectedId && m_savedFirst == first &&
+			m_savedAssets == m_collectedAssets && ring.m_removedAssets.empty())
+	{
+		return;
+	}
+
+	uint32_t fromAsset = 1;
+	uint64_t fromId = 0;
+	if (full)
+	{
+		journal.append(JOURNAL_MAGIC, JOURNAL_MAGIC_LEN);
+	}
+	else
+	{
+		fromAsset = m_savedAssets;
+		fromId = m_savedId + 1;
+	}
+
+	for (uint32_t id = fromAsset; id < ring.m_assets.size(); id++)
+	{
+		uint32_t length = ring.m_assets[id].length();
+		journal.push_back(JOURNAL_ASSET);
+		journal.append((const char *)&id, sizeof(id));
+		journal.append((const char *)&length, sizeof(length));
+		journal.append(ring.m_assets[id]);
+	}
+	if (!full)
+	{
+		for (auto& id : ring.m_removedAssets)
+		{
+			journal.push_back(JOURNAL_REMOVE);
+			journal.append((const char *)&id, sizeof(id));
+		}
+	}
+	ring.m_removedAssets.clear();
+
+	auto it = lower_bound(ring.m_index.begin(), ring.m_index.end(), fromId,
+			[&ring](size_t offset, uint64_t id) { return ring.record(offset)->id < id; });
+	for ( ; it != ring.m_index.end(); ++it)
+	{
+		RingRecord *record = ring.record(*it);
+		if (record->assetId == RING_REMOVED_ASSET)
+			continue;
+		journal.push_back(JOURNAL_READING);
+		journal.append((const char *)record, sizeof(RingRecord) + record->length);
+	}
+
+	journal.push_back(JOURNAL_TAIL);
+	journal.append((const char *)&first, sizeof(first));
+	journal.append((const char *)&ring.m_nextId, sizeof(ring.m_nextId));
+}
+
+/**
+ * Write journal entries to a file and flush them to the storage device
+ *
+ * @param filename	The file to write
+ * @param journal	The journal entries
+ * @param truncate	Replace the contents of the file rather than appending
+ * @return		True if the entries were written
+ */
+bool RingSnapshot::write(const string& filename, const string& journal, bool truncate)
+{
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | (truncate ? O_TRUNC : O_APPEND), 0644);
+	if (fd == -1)
+	{
+		Logger::getLogger()->error("Unable to open readings snapshot %s: %s",
+				filename.c_str(), strerror(errno));
+		return false;
+	}
+	const char *p = journal.data();
+	size_t remaining = journal.length();
+	while (remaining > 0)
+	{
+		ssize_t n = ::write(fd, p, remaining);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			Logger::getLogger()->error("Unable to write readings snapshot %s: %s",
+					filename.c_str(), strerror(errno));
+			close(fd);
+			return false;
+		}
+		p += n;
+		remaining -= n;
+	}
+	fdatasync(fd);
+	close(fd);
+	return true;
+}
@@ -14,6 +14,7 @@
 #include <unistd.h>
 
 #include "readings_catalogue.h"
+#include <reading_stream_payload.h>
 
 /*
  * Control the way purge deletes readings. The block size sets a limit as to how many rows
@@ -424,6 +425,53 @@ bool retCode;
 	}
 }
 
+/**
+ * The SQLite function reading_json(reading). Readings may be stored as
+ * binary payloads, this returns the JSON text of a binary payload so that
+ * the SQLite JSON functions can be used on the reading column. Any other
+ * value is returned unchanged.
+ *
+ * @param context	The SQLite function context
+ * @param argc		The number of arguments, always 1
+ * @param argv		The arguments
+ */
+static void readingJSON(sqlite3_context *context, int argc, sqlite3_value **argv)
+{
+	if (sqlite3_value_type(argv[0]) == SQLITE_BLOB)
+	{
+		const char *payload = (const char *)sqlite3_value_blob(argv[0]);
+		int length = sqlite3_value_bytes(argv[0]);
+		string json;
+		if (length > 0 && RDS_PAYLOAD_IS_BINARY(payload) &&
+				ReadingStreamPayload::toJSON(payload, length, json))
+		{
+			sqlite3_result_text(context, json.c_str(), json.length(), SQLITE_TRANSIENT);
+			return;
+		}
+	}
+	sqlite3_result_value(context, argv[0]);
+}
+
+/**
+ * Append a column that is used with the SQLite JSON functions. The
+ * reading column is passed through reading_json as it may hold
+ * binary payloads.
+ *
+ * @param sql		The SQL being built
+ * @param column	The column name
+ */
+static void appendJsonColumn(SQLBuffer& sql, const char *column)
+{
+	if (strcmp(column, "reading") == 0)
+	{
+		sql.append("reading_json(reading)");
+	}
+	else
+	{
+		sql.append(column);
+	}
+}
+
 #ifndef SQLITE_SPLIT_READINGS
 /**
  * Create a SQLite3 database connection
@@ -437,6 +485,7 @@ Connection::Connection()
 	m_logSQL = false;
 	m_queuing = 0;
 	m_streamOpenTransaction = true;
+	m_stmtsGeneration = 0;
 
 	if (defaultConnection == NULL)
 	{
@@ -501,6 +550,11 @@ Connection::Connection()
 		int rc;
 		char *zErrMsg = NULL;
 
+		// Allow the JSON functions to be used on binary readings
+		sqlite3_create_function(dbHandle, "reading_json", 1,
+				SQLITE_UTF8 | SQLITE_DETERMINISTIC, NULL,
+				readingJSON, NULL, NULL);
+
 		// Enable the WAL for the fledge DB
 		rc = sqlite3_exec(dbHandle, DB_CONFIGURATION, NULL, NULL, &zErrMsg);
 		if (rc != SQLITE_OK)
@@ -647,6 +701,7 @@ Connection::Connection()
  */
 Connection::~Connection()
 {
+	clearStatementCache();
 	sqlite3_close_v2(dbHandle);
 }
 
@@ -704,11 +759,13 @@ unsigned long nRows = 0, nCols = 0;
 			Document d;
 			// Set object name as the column name
 			Value name(sqlite3_column_name(pStmt, i), allocator);
+			// Get the column datatype before any conversion to text
+			int type = sqlite3_column_type(pStmt, i);
 			// Get the "TEXT" value of the column value
 			char* str = (char *)sqlite3_column_text(pStmt, i);
 
 			// Check the column value datatype
-			switch (sqlite3_column_type(pStmt, i))
+			switch (type)
 			{
 				case (SQLITE_NULL):
 				{
@@ -765,6 +822,26 @@ unsigned long nRows = 0, nCols = 0;
 					row.AddMember(name, dblVal, allocator);
 					break;
 				}
+				case (SQLITE_BLOB):
+				{
+					// Readings held as binary payloads are returned as JSON
+					const char *payload = (const char *)sqlite3_column_blob(pStmt, i);
+					int length = sqlite3_column_bytes(pStmt, i);
+					string json;
+					Value value;
+					if (length > 0 && RDS_PAYLOAD_IS_BINARY(payload) &&
+							ReadingStreamPayload::toJSON(payload, length, json) &&
+							!d.Parse(json.c_str()).HasParseError())
+					{
+						value = Value(d, allocator);
+					}
+					else
+					{
+						value = Value(str != NULL ? str : "", allocator);
+					}
+					row.AddMember(name, value, allocator);
+					break;
+				}
 				default:
 				{
 					// Default: use  (char *) value
@@ -2122,7 +2199,7 @@ bool Connection::jsonAggregates(const Value& payload,
 			}
 			// Use json_extract(field, '$.key1.key2') AS value
 			sql.append("json_extract(");
-			sql.append(json["column"].GetString());
+			appendJsonColumn(sql, json["column"].GetString());
 			sql.append(", '$.");
 
 			if (!json.HasMember("properties"))
@@ -2143,7 +2220,7 @@ bool Connection::jsonAggregates(const Value& payload,
 				// json_type(field, '$.key1.key2') IS NOT NULL
 				// Build the Json keys NULL check
 				jsonConstraint.append("json_type(");
-				jsonConstraint.append(json["column"].GetString());
+				appendJsonColumn(jsonConstraint, json["column"].GetString());
 				jsonConstraint.append(", '$.");
 
 				int field = 0;
@@ -2184,7 +2261,7 @@ bool Connection::jsonAggregates(const Value& payload,
 				// json_type(field, '$.key1.key2') IS NOT NULL
 				// Build the Json key NULL check
 				jsonConstraint.append("json_type(");
-				jsonConstraint.append(json["column"].GetString());
+				appendJsonColumn(jsonConstraint, json["column"].GetString());
 				jsonConstraint.append(", '$.");
 				jsonConstraint.append(jsonFields.GetString());
 
@@ -2283,14 +2360,14 @@ bool Connection::jsonAggregates(const Value& payload,
 				// Use json_extract(field, '$.key1.key2') AS value
 				sql.append("json_extract(");
 				column_name=json["column"].GetString();
-				sql.append(column_name);
+				appendJsonColumn(sql, column_name.c_str());
 				sql.append(", '$.");
 
 				// JSON1 SQLite3 extension 'json_type' object check:
 				// json_type(field, '$.key1.key2') IS NOT NULL
 				// Build the Json keys NULL check
 				jsonConstraint.append("json_type(");
-				jsonConstraint.append(json["column"].GetString());
+				appendJsonColumn(jsonConstraint, json["column"].GetString());
 				jsonConstraint.append(", '$.");
 
 				if (jsonFields.IsArray())
@@ -2929,7 +3006,7 @@ bool Connection::returnJson(const Value& json,
 	// Call JSON1 SQLite3 extension routine 'json_extract'
 	// json_extract(field, '$.key1.key2') AS value
 	sql.append("json_extract(");
-	sql.append(json["column"].GetString());
+	appendJsonColumn(sql, json["column"].GetString());
 	sql.append(", '$.");
 	if (!json.HasMember("properties"))
 	{
@@ -2947,7 +3024,7 @@ bool Connection::returnJson(const Value& json,
 		// json_type(field, '$.key1.key2') IS NOT NULL
 		// Build the Json keys NULL check
 		jsonConstraint.append("json_type(");
-		jsonConstraint.append(json["column"].GetString());
+		appendJsonColumn(jsonConstraint, json["column"].GetString());
 		jsonConstraint.append(", '$.");
 		int field = 0;
 		string prev;
@@ -2985,7 +3062,7 @@ bool Connection::returnJson(const Value& json,
 		// json_type(field, '$.key1.key2') IS NOT NULL
 		// Build the Json key NULL check
 		jsonConstraint.append("json_type(");
-		jsonConstraint.append(json["column"].GetString());
+		appendJsonColumn(jsonConstraint, json["column"].GetString());
 		jsonConstraint.append(", '$.");
 		jsonConstraint.append(jsonFields.GetString());
 
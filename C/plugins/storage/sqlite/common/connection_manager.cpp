@@ -33,7 +33,8 @@ static void managerBackground(void *arg)
  */
 ConnectionManager::ConnectionManager() : m_shutdown(false),
 					m_vacuumInterval(6 * 60 * 60),
-					m_attachedDatabases(0)
+					m_attachedDatabases(0),
+					m_binaryReadings(false)
 {
 	lastError.message = NULL;
 	lastError.entryPoint = NULL;
@@ -20,6 +20,7 @@
 #include <map>
 #include <vector>
 #include <atomic>
+#include <functional>
 
 #define TRACK_CONNECTION_USER		0 // Set to 1 to get dianositcs about connection pool use
 
@@ -127,6 +128,8 @@ class Connection {
 		int 		readingStream(ReadingStream **readings, bool commit);
 		bool		fetchReadings(unsigned long id, unsigned int blksize,
 						std::string& resultSet);
+		bool		fetchReadingsBinary(unsigned long id, unsigned int blksize,
+						std::string& resultSet);
 		bool		retrieveReadings(const std::string& condition,
 						 std::string& resultSet);
 		unsigned int	purgeReadings(unsigned long age, unsigned int flags,
@@ -161,6 +164,17 @@ class Connection {
 		int		m_queuing;
 		std::mutex	m_qMutex;
 		int		SQLPrepare(sqlite3 *dbHandle, const char *sqlCmd, sqlite3_stmt **readingsStmt);
+		sqlite3_stmt	*getAppendStatement(int dbId, int tableId);
+		sqlite3_stmt	*getFetchStatement(int dbId, int tableId);
+		bool		fetchReadingRows(unsigned long id, unsigned int blksize,
+				const std::function<void(sqlite3_stmt *, const char *)>& row);
+		void		checkStatementCache();
+		void		clearStatementCache();
+		std::map<std::pair<int, int>, sqlite3_stmt *>
+				m_appendStmts;		// Cached readings insert statements keyed by database and table id
+		std::map<std::pair<int, int>, sqlite3_stmt *>
+				m_fetchStmts;		// Cached readings fetch statements keyed by database and table id
+		unsigned long	m_stmtsGeneration;	// Readings catalogue generation the cached statements belong to
 		int		SQLexec(sqlite3 *db, const std::string& table, const char *sql,
 				int (*callback)(void*,int,char**,char**),
 					void *cbArg, char **errmsg);
@@ -173,6 +187,11 @@ class Connection {
 		int		mapResultSet(void *res, std::string& resultSet, unsigned long *rowsCount = nullptr);
 #ifndef SQLITE_SPLIT_READINGS
 		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, std::vector<std::string>  &asset_codes, bool convertLocaltime = false, std::string prefix = "");
+		bool		rollupAggregate(const rapidjson::Value& payload, const std::string& timeColumn, double size, std::string& sql);
+		bool		rollupTimebucket(const rapidjson::Value& payload, std::string& sql);
+		bool		rollupEdges(const rapidjson::Value& where, const std::vector<std::string>& assets,
+					time_t start, time_t end, bool hasUpper,
+					std::string& readings, std::string& rawWhere, std::string& assetList);
 #else
 		bool		jsonWhereClause(const rapidjson::Value& whereClause, SQLBuffer&, bool convertLocaltime = false, std::string prefix = "");
 #endif
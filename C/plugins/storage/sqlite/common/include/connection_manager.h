@@ -47,6 +47,14 @@ class ConnectionManager {
 						m_vacuumInterval = 60 * 60 * hours;
 					  };
 		bool			  allowMoreDatabases();
+		void			  setBinaryReadings(bool binary)
+					  {
+						m_binaryReadings = binary;
+					  };
+		bool			  binaryReadings() const
+					  {
+						return m_binaryReadings;
+					  };
 
 	protected:
 		ConnectionManager();
@@ -70,6 +78,7 @@ class ConnectionManager {
 		long                         m_vacuumInterval;
 		unsigned int		     m_descriptorLimit;
 		unsigned int		     m_attachedDatabases;
+		bool			     m_binaryReadings;	// Store readings as binary payloads
 };
 
 #endif
@@ -18,6 +18,7 @@ class PurgeConfiguration {
 		void				exclude(const std::string& asset);
 		bool				hasExclusions() { return m_exclude.size() != 0; };
 		bool				isExcluded(const std::string& asset);
+		const std::vector<std::string>&	getExclusions() { return m_exclude; };
 		void				minimumRetained(uint32_t minimum);
 		uint32_t			getMinimumRetained() { return m_minimum; };
 	private:
@@ -12,8 +12,16 @@
 
 #include "connection.h"
 #include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <climits>
 
 #define	OVERFLOW_TABLE_ID	0	// Table ID to use for the overflow table
+#define	PARTITION_DB_ID		0	// Database ID of the time partitioned readings tables
+#define	PARTITION_CLOSE_DELAY	60	// Seconds after the next partition starts before a partition is closed
+#define	PARTITION_RECLAIM_PAGES	256	// Free pages of dropped partitions returned to the file system in each step
+#define	PARTITION_RECLAIM_PAUSE	100	// Milliseconds between the steps that reclaim the free pages
+#define	UNKNOWN_MAX_ID		ULONG_MAX	// The highest reading id in a table has not yet been found
 
 /**
  * This class handles per thread started transaction boundaries:
@@ -39,6 +47,7 @@ class TransactionBoundary {
  * - nDbPreallocate            = Number of databases to allocate in advance
  * - nDbLeftFreeBeforeAllocate = Number of free databases before a new allocation is executed
  * - nDbToAllocate             = Number of database to allocate each time
+ * - partitionInterval         = Minutes of readings in each time partition, 0 to not partition
  *
  */
 typedef struct
@@ -48,6 +57,7 @@ typedef struct
 	int nDbPreallocate = 3;
 	int nDbLeftFreeBeforeAllocate = 1;
 	int nDbToAllocate = 2;
+	int partitionInterval = 0;
 
 } STORAGE_CONFIGURATION;
 
@@ -56,10 +66,14 @@ typedef struct
  */
 class TableReference {
 	public:
-		TableReference(int dbId, int tableId) : m_dbId(dbId), m_tableId(tableId)
+		TableReference(int dbId, int tableId) : m_dbId(dbId), m_tableId(tableId), m_maxId(UNKNOWN_MAX_ID)
 				{
 					m_issued = time(0);
 				};
+		TableReference(const TableReference& rhs) : m_dbId(rhs.m_dbId), m_tableId(rhs.m_tableId),
+				m_issued(rhs.m_issued), m_maxId(rhs.m_maxId.load())
+				{
+				};
 		time_t		lastIssued()
 	       			{
 					return m_issued;
@@ -76,10 +90,23 @@ class TableReference {
 				{
 					m_issued = time(0);
 				};
+		/**
+		 * Return true if the table may hold readings with an id
+		 * of at least the given id
+		 */
+		bool		mayHoldFrom(unsigned long id)
+				{
+					unsigned long maxId = m_maxId;
+					return maxId == UNKNOWN_MAX_ID || maxId >= id;
+				};
+		void		appended(unsigned long id);
+		void		noReadingsFrom(unsigned long id);
 	private:
 		int		m_dbId;
 		int		m_tableId;
 		time_t		m_issued;
+		std::atomic<unsigned long>
+				m_maxId;	// Upper bound of the reading ids in the table
 };
 
 /**
@@ -109,6 +136,16 @@ class TableReference {
  * The readings tables are allocated in sequence starting from the readings_1_1 and proceeding with the other tables available in the first database.
  * The tables in the 2nd database (readings_2.db) will be used when all the tables in the first db are allocated.
  *
+ * Time partitioned readings:
+ *
+ * When a partition interval is configured the readings of all the assets are instead written
+ * to a table set that is replaced at every interval. The tables are held in the database
+ * readings_0 and named readings_0_<partition id>, they have the same layout as the overflow
+ * tables. Purging readings by age or by size drops the partitions that are wholly purged rather
+ * than deleting their rows, only the partition at the purge boundary is deleted row by row.
+ * The table readings_0.partitions records the start of each partition and, once no more readings
+ * can be written to it, the range of reading ids and user timestamps it holds.
+ *
  * Implementation notes:
  *
  * 1) Many functions receive the database connection as an input parameter:
@@ -170,10 +207,28 @@ public:
 	int           preallocateNewDbsRange(int dbIdStart, int dbIdEnd);
 	tyReadingReference getEmptyReadingTableReference(std::string& asset);
 	tyReadingReference getReadingReference(Connection *connection, const char *asset_code);
+	tyReadingReference getAppendReference(Connection *connection, const char *asset_code);
+	bool          findReadingReference(const char *asset_code, tyReadingReference& ref);
+	static bool   isSharedTable(int dbId, int tableId)
+			{
+				return tableId == OVERFLOW_TABLE_ID || dbId == PARTITION_DB_ID;
+			};
+	void          getSharedTables(std::vector<tyReadingReference> &tables, unsigned long minId = 0);
+	bool          hasPartitions() { return m_partitionDb; };
+	unsigned long purgePartitionsByAge(sqlite3 *dbHandle, unsigned long age, bool retain,
+				unsigned long sent, unsigned long& unsentPurged);
+	unsigned long purgePartitionsByRows(sqlite3 *dbHandle, unsigned long rows, unsigned long total,
+				bool retain, unsigned long sent, unsigned long& unsentPurged);
+	unsigned long purgeAssetPartitions(sqlite3 *dbHandle, const std::string& asset);
+	void          shutdownPartitions();
 	bool          attachDbsToAllConnections();
 	std::string   sqlConstructMultiDb(std::string &sqlCmdBase, std::vector<std::string>  &assetCodes, bool considerExclusion=false);
 	std::string   sqlConstructOverflow(std::string &sqlCmdBase, std::vector<std::string>  &assetCodes, bool considerExclusion=false, bool groupBy = false);
 	int           purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBase, char **errMsg = NULL, unsigned long *rowsAffected = NULL);
+	void          getAssetTables(std::vector<std::pair<std::string, tyReadingReference>> &tables, unsigned long minId = 0);
+	void          readingsAppended(const std::string& asset_code, unsigned long maxId);
+	void          noReadingsFrom(const std::string& asset_code, unsigned long id);
+	int           getMaxOverflowUsed() { return m_maxOverflowUsed; };
 
 	bool          connectionAttachAllDbs(sqlite3 *dbHandle);
 	bool          connectionAttachDbList(sqlite3 *dbHandle, std::vector<int> &dbIdList);
@@ -184,8 +239,10 @@ public:
 	int           extractReadingsIdFromName(std::string tableName);
 	int           extractDbIdFromName(std::string tableName);
 	int           SQLExec(sqlite3 *dbHandle, const char *sqlCmd,  char **errMsg = NULL);
+	int           SQLStep(sqlite3_stmt *statement);
 	bool	      createReadingsOverflowTable(sqlite3 *dbHandle, int dbId);
 	int	      getMaxAttached() { return m_attachLimit; };
+	unsigned long getGeneration() { return m_generation; };
 
 
 private:
@@ -214,6 +271,19 @@ private:
 
 	} tyReadingsAvailable;
 
+	/**
+	 * A time partition of the readings. The id range and the newest
+	 * user timestamp are only known once the partition is closed.
+	 */
+	typedef struct ReadingsPartition {
+		int		id;		// The table id of the partition
+		time_t		start;		// The time from which readings are written to the partition
+		bool		closed;		// No more readings can be written to the partition
+		unsigned long	maxId;		// The highest reading id in a closed partition
+		std::string	maxUserTs;	// The newest user_ts in a closed partition
+		unsigned long	rows;		// The number of readings in a closed partition
+	} tyReadingsPartition;
+
 	ReadingsCatalogue();
 
 	bool          createNewDB(sqlite3 *dbHandle, int newDbId,  int startId, NEW_DB_OPERATION attachAllDb);
@@ -227,8 +297,8 @@ private:
 	std::string   generateDbFilePah(int dbId);
 
 	void		  raiseError(const char *operation, const char *reason,...);
-	int			  SQLStep(sqlite3_stmt *statement);
 	bool          enableWAL(std::string &dbPathReadings);
+	bool          createPartitionDatabase(std::string &dbPath);
 
 	bool          configurationRetrieve(sqlite3 *dbHandle);
 	void          prepareAllDbs();
@@ -248,6 +318,16 @@ private:
 	int           calcMaxReadingUsed();
 	void          dropReadingsTables(sqlite3 *dbHandle, int dbId, int idStart, int idEnd);
 
+	bool          preparePartitions(sqlite3 *dbHandle);
+	bool          createPartition(sqlite3 *dbHandle, time_t start);
+	void          createNextPartition();
+	void          partitionWorker();
+	bool          reclaimPartitionSpace();
+	void          closePartitions(sqlite3 *dbHandle);
+	void          partitionRowsRemoved(int partitionId, unsigned long rows);
+	bool          partitionHasExclusions(sqlite3 *dbHandle, int partitionId);
+	bool          dropPartition(sqlite3 *dbHandle, int partitionId);
+
 
 	int           m_dbIdCurrent;            // Current database in use
 	int           m_dbIdLast;               // Last database available not already in use
@@ -272,7 +352,19 @@ private:
 	int	       m_attachLimit;
 	int	       m_maxOverflowUsed;
 	int	       m_compounds; 	// Max number of compound statements
+	std::atomic<unsigned long>
+		       m_generation;	// Incremented whenever databases or tables are attached, detached, created or dropped
 	std::mutex     m_emptyReadingTableMutex;
+	bool           m_partitionDb;	// The partition database is attached
+	std::vector<tyReadingsPartition>
+		       m_partitions;	// The time partitions, oldest first
+	bool           m_partitionPending; // The next partition is being created
+	bool           m_reclaimPending; // The space of dropped partitions is to be reclaimed
+	std::mutex     m_partitionMutex;
+	std::condition_variable
+		       m_partitionCV;	// Signals the partition thread
+	std::thread    *m_partitionThread; // Creates the next partition ahead of time
+	bool           m_partitionShutdown; // The partition thread should exit
 public:
 	TransactionBoundary				m_tx;
 
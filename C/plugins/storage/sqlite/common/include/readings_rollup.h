@@ -0,0 +1,114 @@
+#ifndef _READINGS_ROLLUP_H
+#define _READINGS_ROLLUP_H
+/*
+ * Fledge storage service - Readings rollups
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sqlite3.h>
+#include <rapidjson/document.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <tuple>
+#include <mutex>
+#include <time.h>
+
+#define ROLLUP_MINUTE_GRANULE	30	// Granule, in seconds, of the rollup that answers minute buckets
+#define ROLLUP_HOUR_GRANULE	1800	// Granule, in seconds, of the rollup that answers hourly buckets
+#define ROLLUP_ALL_ASSETS	"*"	// Validity entry used for assets not yet seen by the rollups
+
+/**
+ * Continuously maintained, pre-aggregated rollups of the numeric and
+ * string datapoints of the readings. These are used to answer timebucket
+ * queries without scanning the raw readings.
+ *
+ * Timebucket queries round the timestamp of a reading to the nearest
+ * multiple of the bucket size, hence a bucket of size S covers the
+ * interval [(K - 0.5) * S, (K + 0.5) * S). The rollups are therefore
+ * held at half the rollup interval, 30 seconds for the minute rollup and
+ * 30 minutes for the hour rollup, so that any bucket whose size is a
+ * multiple of 60 seconds, or of one hour, is made of whole granules.
+ *
+ * The rollups hold the count, sum, minimum and maximum of each datapoint
+ * of each asset per granule. They are updated within the transaction that
+ * appends the readings. The validity table records, for each asset, the
+ * time from which the rollups hold every reading; it moves forward as
+ * the readings are purged.
+ */
+class ReadingsRollup {
+	public:
+		/**
+		 * The aggregates of the values of a datapoint, collected
+		 * with the ordering rules SQLite uses for min and max
+		 */
+		class Aggregate {
+			public:
+				Aggregate() : count(0), intSum(0), realSum(0.0), approx(false) {};
+				void		add(const rapidjson::Value& value);
+				void		bindSum(sqlite3_stmt *stmt, int col) const;
+				void		bindMin(sqlite3_stmt *stmt, int col) const { bindValue(stmt, col, minimum); };
+				void		bindMax(sqlite3_stmt *stmt, int col) const { bindValue(stmt, col, maximum); };
+				long		count;
+			private:
+				class Value {
+					public:
+						Value() : type(SQLITE_NULL), intValue(0), realValue(0.0) {};
+						int		compare(const Value& rhs) const;
+						int		type;
+						long long	intValue;
+						double		realValue;
+						std::string	text;
+				};
+				void		bindValue(sqlite3_stmt *stmt, int col, const Value& value) const;
+				long long	intSum;
+				double		realSum;
+				bool		approx;
+				Value		minimum;
+				Value		maximum;
+		};
+
+		/**
+		 * The rollup changes caused by a block of readings, applied
+		 * in the transaction that appends them
+		 */
+		class Batch {
+			public:
+				bool		add(const char *asset, const char *userTs, const rapidjson::Value& reading);
+				bool		empty() const { return m_aggregates.empty(); };
+			private:
+				friend class ReadingsRollup;
+				std::map<std::tuple<std::string, std::string, long>, Aggregate>
+						m_aggregates;	// Keyed by asset, datapoint and minute granule
+		};
+
+		static ReadingsRollup	*getInstance();
+		bool			init(sqlite3 *dbHandle, bool enabled);
+		bool			isEnabled() const { return m_enabled; };
+		bool			apply(sqlite3 *dbHandle, const Batch& batch);
+		bool			validFrom(sqlite3 *dbHandle, const std::vector<std::string>& assets, time_t& from);
+		void			purged(sqlite3 *dbHandle);
+		void			purgedAsset(sqlite3 *dbHandle, const std::string& asset);
+		static long		granule(double bucketSize);
+		static std::string	tableName(long granule);
+		static bool		parseTimestamp(const char *timestamp, time_t& seconds, bool& fraction);
+	private:
+		ReadingsRollup();
+		~ReadingsRollup();
+		bool			applyTable(sqlite3 *dbHandle, long granuleSize, const Batch& batch);
+		bool			addAssets(sqlite3 *dbHandle, const Batch& batch);
+		bool			execute(sqlite3 *dbHandle, const std::string& sql);
+		bool			discardBefore(sqlite3 *dbHandle, const std::string& asset, time_t from);
+	private:
+		static ReadingsRollup	*m_instance;
+		bool			m_enabled;
+		std::set<std::string>	m_assets;	// Assets known to have a validity entry
+		std::mutex		m_mutex;
+};
+
+#endif
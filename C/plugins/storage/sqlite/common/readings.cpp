@@ -13,6 +13,7 @@
 #include <connection.h>
 #include <connection_manager.h>
 #include <reading_stream.h>
+#include <reading_stream_payload.h>
 #include <random>
 #include <utils.h>
 
@@ -21,8 +22,10 @@
 #include <string_utils.h>
 #include <algorithm>
 #include <vector>
+#include <queue>
 
 #include <readings_catalogue.h>
+#include <readings_rollup.h>
 
 // 1 enable performance tracking
 #define INSTRUMENT	0
@@ -83,6 +86,12 @@ static time_t connectErrorTime = 0;
 static std::atomic<int> m_appendCount(0);
 static bool				m_shutdown=false;
 
+// Statistics for the cache of prepared insert statements used by appendReadings
+#define STMT_CACHE_REPORT_INTERVAL	10000	// Report the cache hit rate every X calls
+static std::atomic<unsigned long> m_appendCalls(0);
+static std::atomic<unsigned long> m_stmtCacheHits(0);
+static std::atomic<unsigned long> m_stmtCacheMisses(0);
+
 #ifndef SQLITE_SPLIT_READINGS
 /**
  * Check whether to compute timebucket query with min,max,avg for all datapoints
@@ -107,6 +116,457 @@ bool aggregateAll(const Value& payload)
 #endif
 
 #ifndef SQLITE_SPLIT_READINGS
+/**
+ * Check that the where clause of a timebucket query only selects a set of
+ * assets and a range of user timestamps, the rollups can then be used to
+ * answer the query. Timestamps must be in the UTC form held in the readings
+ * so that the comparisons made by SQLite match those made here.
+ *
+ * @param where		The where clause of the query
+ * @param assets	Populated with the selected asset codes
+ * @param lower		Raised to the earliest bucket start the range allows
+ * @param upper		Lowered to the latest bucket end the range allows
+ * @param hasUpper	Set if the range has an upper limit
+ * @return		True if the rollups can be used for the where clause
+ */
+static bool rollupWhere(const Value& where, vector<string>& assets, time_t& lower, time_t& upper, bool& hasUpper)
+{
+	if (!where.IsObject() || where.HasMember("or") ||
+	    !where.HasMember("column") || !where["column"].IsString() ||
+	    !where.HasMember("condition") || !where["condition"].IsString() ||
+	    !where.HasMember("value"))
+	{
+		return false;
+	}
+	string column = where["column"].GetString();
+	string condition = where["condition"].GetString();
+	const Value& value = where["value"];
+
+	if (column.compare("asset_code") == 0 && assets.empty())
+	{
+		if (condition.compare("=") == 0 && value.IsString())
+		{
+			assets.push_back(value.GetString());
+		}
+		else if (condition.compare("in") == 0 && value.IsArray())
+		{
+			for (auto& asset : value.GetArray())
+			{
+				if (!asset.IsString())
+				{
+					return false;
+				}
+				assets.push_back(asset.GetString());
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (column.compare("user_ts") == 0 && value.IsString())
+	{
+		time_t seconds;
+		bool fraction;
+		char utc[40];
+		struct tm tm;
+
+		if (!ReadingsRollup::parseTimestamp(value.GetString(), seconds, fraction))
+		{
+			return false;
+		}
+		strftime(utc, sizeof(utc), "%Y-%m-%d %H:%M:%S", gmtime_r(&seconds, &tm));
+		if (strncmp(value.GetString(), utc, strlen(utc)) != 0)
+		{
+			return false;
+		}
+		if (condition.compare(">=") == 0)
+		{
+			lower = max(lower, fraction ? seconds + 1 : seconds);
+		}
+		else if (condition.compare(">") == 0)
+		{
+			lower = max(lower, seconds + 1);
+		}
+		else if (condition.compare("<=") == 0 || condition.compare("<") == 0)
+		{
+			upper = hasUpper ? min(upper, seconds) : seconds;
+			hasUpper = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else
+	{
+		return false;
+	}
+
+	if (where.HasMember("and"))
+	{
+		return rollupWhere(where["and"], assets, lower, upper, hasUpper);
+	}
+	return true;
+}
+
+/**
+ * Build the inner query of a timebucket query with min, max, avg for all
+ * datapoints that uses the readings rollups. The buckets that lie wholly
+ * within the time the rollups are valid for are taken from the rollup,
+ * the readings outside of those buckets are aggregated from the raw readings.
+ * The query returns the same columns as the raw query of aggregateQuery.
+ *
+ * @param payload	JSON object for timebucket query
+ * @param timeColumn	The timestamp column of the timebucket
+ * @param size		The size of the timebucket in seconds
+ * @param sql		The SQL of the inner query
+ * @return		True if the rollups can answer the query
+ */
+bool Connection::rollupAggregate(const Value& payload, const string& timeColumn, double size, string& sql)
+{
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
+	long granule = ReadingsRollup::granule(size);
+
+	if (!rollup->isEnabled() || granule == 0 || timeColumn.compare("user_ts") != 0)
+	{
+		return false;
+	}
+
+	vector<string> assets;
+	time_t lower = 0, upper = 0, validFrom;
+	bool hasUpper = false;
+	if (!rollupWhere(payload["where"], assets, lower, upper, hasUpper) || assets.empty() ||
+	    !rollup->validFrom(dbHandle, assets, validFrom))
+	{
+		return false;
+	}
+	lower = max(lower, validFrom);
+
+	// The buckets held by the rollup, bucket K covers [K * size - size / 2, K * size + size / 2)
+	long bucket = (long)size;
+	long half = bucket / 2;
+	long first = (lower + half + bucket - 1) / bucket;
+	long last = 0;
+	if (hasUpper)
+	{
+		last = (upper - half) / bucket;
+		if (upper < half || first > last)
+		{
+			return false;
+		}
+	}
+	time_t start = first * bucket - half;
+	time_t end = last * bucket + half;
+
+	// Select the raw readings outside of those buckets
+	string readings, rawWhere, assetList;
+	if (!rollupEdges(payload["where"], assets, start, end, hasUpper, readings, rawWhere, assetList))
+	{
+		return false;
+	}
+
+	string sizeFormat = to_string(bucket);
+	string granuleFormat = to_string(granule);
+
+	sql = "SELECT x, asset_code, datetime(k * " + sizeFormat + ", 'unixepoch') AS timestamp, "
+		"'{\"min\" : ' || min(mn) || ', \"max\" : ' || max(mx) || ', "
+		"\"average\" : ' || (sum(sm) * 1.0 / sum(cnt)) || ', \"count\" : ' || sum(cnt) || ', "
+		"\"sum\" : ' || sum(sm) || '}' AS resd FROM ( ";
+
+	// Granules held by the rollup, mapped to the bucket that contains them
+	sql += "SELECT asset_code, datapoint AS x, ((2 * granule + 1) * " + granuleFormat + " + " + sizeFormat +
+		") / (2 * " + sizeFormat + ") AS k, readings AS cnt, total AS sm, minimum AS mn, maximum AS mx FROM " +
+		ReadingsRollup::tableName(granule) + " WHERE asset_code IN (" + assetList + ") AND granule >= " +
+		to_string(start / granule);
+	if (hasUpper)
+	{
+		sql += " AND granule < " + to_string(end / granule);
+	}
+
+	// Raw readings in the partial buckets at either end of the range. The bucket is
+	// computed from the whole seconds, as the bucket boundaries are whole seconds,
+	// to avoid the rounding errors of julianday placing a reading differently
+	// from the rollup
+	sql += " UNION ALL SELECT asset_code, x, (2 * CAST(strftime('%s', user_ts) AS INTEGER) + " + sizeFormat +
+		") / (2 * " + sizeFormat + ") AS k, "
+		"count(theval), sum(theval), min(theval), max(theval) FROM ( "
+		"SELECT asset_code, user_ts, json_each.key AS x, json_each.value AS theval FROM ( " + readings +
+		" ) AS reading_table, json_each(reading_json(reading_table.reading)) WHERE " + rawWhere +
+		" ) GROUP BY asset_code, x, k";
+
+	sql += " ) GROUP BY x, asset_code, k ";
+	return true;
+}
+
+/**
+ * Build the parts of a query answered from the readings rollups that select
+ * the raw readings outside of the buckets held by the rollups.
+ *
+ * @param where		The where clause of the query
+ * @param assets	The assets selected by the where clause
+ * @param start		The start of the first bucket held by the rollups
+ * @param end		The end of the last bucket held by the rollups
+ * @param hasUpper	Set if the query has an upper limit, otherwise the rollups hold every bucket from start
+ * @param readings	The union of the readings tables of the assets
+ * @param rawWhere	The condition that selects the raw readings outside of the buckets
+ * @param assetList	The quoted list of the assets
+ * @return		True if the where clause could be converted
+ */
+bool Connection::rollupEdges(const Value& where, const vector<string>& assets, time_t start, time_t end,
+			bool hasUpper, string& readings, string& rawWhere, string& assetList)
+{
+	SQLBuffer whereSql;
+	vector<string> asset_codes;
+	if (!jsonWhereClause(where, whereSql, asset_codes))
+	{
+		return false;
+	}
+	const char *condition = whereSql.coalesce();
+	rawWhere = condition;
+	delete[] condition;
+
+	char startTs[40], endTs[40];
+	struct tm tm;
+	strftime(startTs, sizeof(startTs), "%Y-%m-%d %H:%M:%S", gmtime_r(&start, &tm));
+	strftime(endTs, sizeof(endTs), "%Y-%m-%d %H:%M:%S", gmtime_r(&end, &tm));
+	rawWhere += " AND (user_ts < '" + string(startTs) + "'";
+	if (hasUpper)
+	{
+		rawWhere += " OR user_ts >= '" + string(endTs) + "'";
+	}
+	rawWhere += ")";
+
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	string sqlBase = " SELECT  ROWID, id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+	string sqlOverflow = " SELECT  ROWID, id, asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+	readings = readCat->sqlConstructMultiDb(sqlBase, asset_codes);
+	readings += readCat->sqlConstructOverflow(sqlOverflow, asset_codes);
+
+	assetList.clear();
+	for (auto& asset : assets)
+	{
+		string quoted = asset;
+		StringReplaceAll(quoted, "'", "''");
+		assetList += (assetList.empty() ? "'" : ", '") + quoted + "'";
+	}
+	return true;
+}
+
+/**
+ * Build a timebucket query of the minimum, maximum and average of a single
+ * datapoint, as used for the series of an asset, that uses the readings
+ * rollups. These queries place a reading in the bucket that its timestamp
+ * truncated to the bucket size falls in, so bucket K covers
+ * [K * size, (K + 1) * size). As with rollupAggregate, the buckets that lie
+ * wholly within the time the rollups are valid for are taken from the
+ * rollup and the readings of the partial buckets at either end of the range
+ * are aggregated from the raw readings. The query returns the same columns,
+ * in the same order, as the raw query built by jsonAggregates and jsonModifiers.
+ *
+ * @param payload	JSON object of the query
+ * @param sql		The SQL of the query
+ * @return		True if the rollups can answer the query
+ */
+bool Connection::rollupTimebucket(const Value& payload, string& sql)
+{
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
+
+	if (!rollup->isEnabled() || !payload.HasMember("where") ||
+	    !payload.HasMember("timebucket") || !payload.HasMember("aggregate") ||
+	    payload.HasMember("group") || payload.HasMember("sort") ||
+	    payload.HasMember("return") || payload.HasMember("modifier") ||
+	    (payload.HasMember("limit") && !payload["limit"].IsInt()) ||
+	    (payload.HasMember("skip") && !payload["skip"].IsInt()))
+	{
+		return false;
+	}
+
+	const Value& tb = payload["timebucket"];
+	if (!tb.IsObject() || !tb.HasMember("timestamp") || !tb["timestamp"].IsString() ||
+	    strcmp(tb["timestamp"].GetString(), "user_ts") != 0 ||
+	    !tb.HasMember("size") || !tb["size"].IsString())
+	{
+		return false;
+	}
+	// The raw query divides the whole seconds by the size, it must be an integer
+	const char *sizeStr = tb["size"].GetString();
+	if (*sizeStr == 0 || strspn(sizeStr, "0123456789") != strlen(sizeStr))
+	{
+		return false;
+	}
+	long bucket = atol(sizeStr);
+	long granule = ReadingsRollup::granule(bucket);
+	if (granule == 0)
+	{
+		return false;
+	}
+
+	string format;
+	if (tb.HasMember("format") && (!tb["format"].IsString() || !applyDateFormat(tb["format"].GetString(), format)))
+	{
+		return false;
+	}
+
+	// Only the minimum, maximum and average of the same datapoint
+	const Value& aggregates = payload["aggregate"];
+	if (!aggregates.IsArray() && !aggregates.IsObject())
+	{
+		return false;
+	}
+	string datapoint, columns;
+	vector<const Value *> items;
+	if (aggregates.IsArray())
+	{
+		for (auto& aggregate : aggregates.GetArray())
+		{
+			items.push_back(&aggregate);
+		}
+	}
+	else
+	{
+		items.push_back(&aggregates);
+	}
+	for (auto item : items)
+	{
+		const Value& aggregate = *item;
+		if (!aggregate.IsObject() || !aggregate.HasMember("operation") || !aggregate["operation"].IsString() ||
+		    !aggregate.HasMember("alias") || !aggregate["alias"].IsString() ||
+		    !aggregate.HasMember("json") || !aggregate["json"].IsObject())
+		{
+			return false;
+		}
+		const Value& json = aggregate["json"];
+		if (!json.HasMember("column") || !json["column"].IsString() ||
+		    strcmp(json["column"].GetString(), "reading") != 0 || !json.HasMember("properties"))
+		{
+			return false;
+		}
+		const Value *property = &json["properties"];
+		if (property->IsArray())
+		{
+			if (property->Size() != 1)
+			{
+				return false;
+			}
+			property = &(*property)[0];
+		}
+		// A property that is a JSON path does not name a datapoint of the rollups
+		if (!property->IsString() || strpbrk(property->GetString(), ".[]\"'") ||
+		    (!datapoint.empty() && datapoint.compare(property->GetString()) != 0))
+		{
+			return false;
+		}
+		datapoint = property->GetString();
+
+		string operation = aggregate["operation"].GetString();
+		if (!columns.empty())
+		{
+			columns += ", ";
+		}
+		if (operation.compare("min") == 0)
+		{
+			columns += "min(mn)";
+		}
+		else if (operation.compare("max") == 0)
+		{
+			columns += "max(mx)";
+		}
+		else if (operation.compare("avg") == 0)
+		{
+			columns += "sum(sm) * 1.0 / sum(cnt)";
+		}
+		else
+		{
+			return false;
+		}
+		columns += " AS \"" + string(aggregate["alias"].GetString()) + "\"";
+	}
+	if (datapoint.empty())
+	{
+		return false;
+	}
+
+	vector<string> assets;
+	time_t lower = 0, upper = 0, validFrom;
+	bool hasUpper = false;
+	if (!rollupWhere(payload["where"], assets, lower, upper, hasUpper) || assets.empty() ||
+	    !rollup->validFrom(dbHandle, assets, validFrom))
+	{
+		return false;
+	}
+	lower = max(lower, validFrom);
+
+	// The buckets held by the rollup
+	long first = (lower + bucket - 1) / bucket;
+	long last = 0;
+	if (hasUpper)
+	{
+		last = upper / bucket - 1;
+		if (first > last)
+		{
+			return false;
+		}
+	}
+	time_t start = first * bucket;
+	time_t end = (last + 1) * bucket;
+
+	string readings, rawWhere, assetList;
+	if (!rollupEdges(payload["where"], assets, start, end, hasUpper, readings, rawWhere, assetList))
+	{
+		return false;
+	}
+
+	string sizeFormat = to_string(bucket);
+	string granuleFormat = to_string(granule);
+	string path = "'$." + datapoint + "'";
+
+	sql = "SELECT " + columns + ", ";
+	if (format.empty())
+	{
+		sql += "datetime(";
+	}
+	else
+	{
+		sql += format;
+	}
+	sql += "k * " + sizeFormat + ", 'unixepoch') AS \"" +
+		string(tb.HasMember("alias") && tb["alias"].IsString() ? tb["alias"].GetString() : "timestamp") +
+		"\" FROM ( ";
+
+	// Granules held by the rollup, mapped to the bucket that contains them
+	sql += "SELECT granule * " + granuleFormat + " / " + sizeFormat + " AS k, readings AS cnt, "
+		"total AS sm, minimum AS mn, maximum AS mx FROM " + ReadingsRollup::tableName(granule) +
+		" WHERE asset_code IN (" + assetList + ") AND datapoint = '" + datapoint +
+		"' AND granule >= " + to_string(start / granule);
+	if (hasUpper)
+	{
+		sql += " AND granule < " + to_string(end / granule);
+	}
+
+	// Raw readings in the partial buckets at either end of the range
+	sql += " UNION ALL SELECT CAST(strftime('%s', user_ts) AS INTEGER) / " + sizeFormat + " AS k, "
+		"count(theval), sum(theval), min(theval), max(theval) FROM ( "
+		"SELECT user_ts, json_extract(reading_json(reading_table.reading), " + path + ") AS theval FROM ( " +
+		readings + " ) AS reading_table WHERE " + rawWhere +
+		" AND json_type(reading_json(reading_table.reading), " + path + ") IS NOT NULL ) GROUP BY k";
+
+	sql += " ) GROUP BY k ORDER BY k DESC";
+	if (payload.HasMember("limit"))
+	{
+		sql += " LIMIT " + to_string(payload["limit"].GetInt());
+	}
+	if (payload.HasMember("skip"))
+	{
+		if (!payload.HasMember("limit"))
+		{
+			sql += " LIMIT -1";
+		}
+		sql += " OFFSET " + to_string(payload["skip"].GetInt());
+	}
+	return true;
+}
+
 /**
  * Build, exucute and return data of a timebucket query with min,max,avg for all datapoints
  *
@@ -196,132 +656,146 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
 	// JSON format aggregated data
 	sql.append(", '{' || group_concat('\"' || x || '\" : ' || resd, ', ') || '}' AS reading ");
 
-	// subquery
-	sql.append("FROM ( SELECT  x, asset_code, max(timestamp) AS timestamp, ");
-	// Add min
-	sql.append("'{\"min\" : ' || min(theval) || ', ");
-	// Add max
-	sql.append("\"max\" : ' || max(theval) || ', ");
-	// Add avg
-	sql.append("\"average\" : ' || avg(theval) || ', ");
-	// Add count
-	sql.append("\"count\" : ' || count(theval) || ', ");
-	// Add sum
-	sql.append("\"sum\" : ' || sum(theval) || '}' AS resd ");
-
-	if (size < 1)
+	string rollupSql;
+	if (rollupAggregate(payload, timeColumn, size, rollupSql))
 	{
-		// Add max(user_ts)
-		sql.append(", max(" + timeColumn + ") AS " + timeColumn + " ");
-	}
-
-	// subquery
-	sql.append("FROM ( SELECT asset_code, ");
-	sql.append(timeColumn);
-
-	if (size >= 1)
-	{
-		sql.append(", datetime(");
+		// subquery answered from the readings rollups
+		sql.append("FROM ( ");
+		sql.append(rollupSql.c_str());
 	}
 	else
 	{
-		sql.append(", (");
-	}
-
-	// Size formatted string
-	string size_format;
-	if (fmod(size, 1.0) == 0.0)
-	{
-		size_format = to_string(int(size));
-	}
-	else
-	{
-		size_format = to_string(size);
-	}
+		// subquery
+		sql.append("FROM ( SELECT  x, asset_code, max(timestamp) AS timestamp, ");
+		// Add min
+		sql.append("'{\"min\" : ' || min(theval) || ', ");
+		// Add max
+		sql.append("\"max\" : ' || max(theval) || ', ");
+		// Add avg
+		sql.append("\"average\" : ' || avg(theval) || ', ");
+		// Add count
+		sql.append("\"count\" : ' || count(theval) || ', ");
+		// Add sum
+		sql.append("\"sum\" : ' || sum(theval) || '}' AS resd ");
+
+		if (size < 1)
+		{
+			// Add max(user_ts)
+			sql.append(", max(" + timeColumn + ") AS " + timeColumn + " ");
+		}
 
-	// Add timebucket size
-	// Unix Time is (Julian Day - JulianDay(1/1/1970 0:00 UTC) * Seconds_per_day
-	if (size != 1)
-	{
-		sql.append(size_format);
-		sql.append(" * round((julianday(");
+		// subquery
+		sql.append("FROM ( SELECT asset_code, ");
 		sql.append(timeColumn);
-		sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / ");
-		sql.append(size_format);
-		sql.append(")");
-	}
-	else
-	{
-		sql.append("round((julianday(");
-		sql.append(timeColumn);
-		sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / 1)");
-	}
-	if (size >= 1)
-	{
-		sql.append(", 'unixepoch') AS \"timestamp\", reading, ");
-	}
-	else
-	{
-		sql.append(") AS \"timestamp\", reading, ");
-	}
 
-	// Get all datapoints in 'reading' field
-	sql.append("json_each.key AS x, json_each.value AS theval FROM ");
+		if (size >= 1)
+		{
+			sql.append(", datetime(");
+		}
+		else
+		{
+			sql.append(", (");
+		}
+
+		// Size formatted string
+		string size_format;
+		if (fmod(size, 1.0) == 0.0)
+		{
+			size_format = to_string(int(size));
+		}
+		else
+		{
+			size_format = to_string(size);
+		}
 
-	{
-		string sql_cmd;
-		ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+		// Add timebucket size
+		// Unix Time is (Julian Day - JulianDay(1/1/1970 0:00 UTC) * Seconds_per_day
+		if (size != 1)
+		{
+			sql.append(size_format);
+			sql.append(" * round((julianday(");
+			sql.append(timeColumn);
+			sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / ");
+			sql.append(size_format);
+			sql.append(")");
+		}
+		else
+		{
+			sql.append("round((julianday(");
+			sql.append(timeColumn);
+			sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / 1)");
+		}
+		if (size >= 1)
+		{
+			sql.append(", 'unixepoch') AS \"timestamp\", reading, ");
+		}
+		else
+		{
+			sql.append(") AS \"timestamp\", reading, ");
+		}
 
-		// SQL - start
-		sql_cmd = R"(
-			(
-			)";
+		// Get all datapoints in 'reading' field
+		sql.append("json_each.key AS x, json_each.value AS theval FROM ");
 
-		// SQL - union of all the readings tables
-		string sql_cmd_base;
-		string sql_cmd_tmp;
-		sql_cmd_base = " SELECT  ROWID, id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
-		sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, asset_codes);
-		sql_cmd += sql_cmd_tmp;
+		{
+			string sql_cmd;
+			ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 
-		// SQL - end
-		sql_cmd += R"(
-				) as reading_table
-			)";
-		sql.append(sql_cmd.c_str());
+			// SQL - start
+			sql_cmd = R"(
+				(
+				)";
 
-		sql.append(", json_each(reading_table.reading) ");
+			// SQL - union of all the readings tables
+			string sql_cmd_base;
+			string sql_cmd_tmp;
+			sql_cmd_base = " SELECT  ROWID, id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+			sql_cmd_tmp = readCat->sqlConstructMultiDb(sql_cmd_base, asset_codes);
+			sql_cmd += sql_cmd_tmp;
 
-	}
+			// SQL - union of the overflow tables and time partitions
+			sql_cmd_base = " SELECT  ROWID, id, asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ ";
+			sql_cmd += readCat->sqlConstructOverflow(sql_cmd_base, asset_codes);
 
+			// SQL - end
+			sql_cmd += R"(
+					) as reading_table
+				)";
+			sql.append(sql_cmd.c_str());
 
-	// Add where condition
-	sql.append("WHERE ");
-	if (!jsonWhereClause(payload["where"], sql, asset_codes))
-	{
-		raiseError("retrieve", "aggregateQuery: failure while building WHERE clause");
-		return false;
-	}
+			sql.append(", json_each(reading_json(reading_table.reading)) ");
 
-	// close subquery
-	sql.append(") tmp ");
+		}
 
-	// Add group by
-	// Unix Time is (Julian Day - JulianDay(1/1/1970 0:00 UTC) * Seconds_per_day
-	sql.append(" GROUP BY x, asset_code, ");
-	sql.append("round((julianday(");
-	sql.append(timeColumn);
-	sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / ");
 
-	if (size != 1)
-	{
-		sql.append(size_format);
-	}
-	else
-	{
-		sql.append('1');
+		// Add where condition
+		sql.append("WHERE ");
+		if (!jsonWhereClause(payload["where"], sql, asset_codes))
+		{
+			raiseError("retrieve", "aggregateQuery: failure while building WHERE clause");
+			return false;
+		}
+
+		// close subquery
+		sql.append(") tmp ");
+
+		// Add group by
+		// Unix Time is (Julian Day - JulianDay(1/1/1970 0:00 UTC) * Seconds_per_day
+		sql.append(" GROUP BY x, asset_code, ");
+		sql.append("round((julianday(");
+		sql.append(timeColumn);
+		sql.append(") - " + string(JULIAN_DAY_START_UNIXTIME) + ") * " + string(SECONDS_PER_DAY) + " / ");
+
+		if (size != 1)
+		{
+			sql.append(size_format);
+		}
+		else
+		{
+			sql.append('1');
+		}
+		sql.append(") ");
 	}
-	sql.append(") ");
 
 	// close subquery
 	sql.append(") tbl ");
@@ -390,8 +864,8 @@ bool Connection::aggregateQuery(const Value& payload, string& resultSet)
  * @param readings  readings to store into the SQLite db
  * @param commit    if true a database commit is executed and a new transaction will be opened at the next execution
  *
- * TODO: the current code should be adapted to use the multi databases/tables implementation
- *
+ * The readings are written to the table assigned to their asset in the
+ * readings catalogue, as they are by appendReadings.
  */
 int Connection::readingStream(ReadingStream **readings, bool commit)
 {
@@ -406,15 +880,24 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	const char *asset_code;
 	const char *payload;
 	string reading;
+	string json;
+	bool binary = ConnectionManager::getInstance()->binaryReadings();
+	string lastAsset;
+	bool overflow = false;
+	unsigned long appendedId = 0;
+	ReadingsRollup *rollup = ReadingsRollup::getInstance();
+	bool rollups = rollup->isEnabled();
+	ReadingsRollup::Batch rollupBatch;
 
 	// Retry mechanism
 	int retries = 0;
 	int sleep_time_ms = 0;
 
 	// SQLite related
-	sqlite3_stmt *stmt;
+	sqlite3_stmt *stmt = NULL;
 	int sqlite3_resut;
 	int rowNumber = -1;
+	std::thread::id tid = std::this_thread::get_id();
 
 	if (m_noReadings)
 	{
@@ -438,19 +921,12 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		attachSync->unlock();
 	}
 
+	checkStatementCache();
+
 #if INSTRUMENT
 	struct timeval start, t1, t2, t3, t4, t5;
 #endif
 
-	// * TODO: the current code should be adapted to use the multi databases/tables implementation
-	const char *sql_cmd = "INSERT INTO  " READINGS_DB ".readings_1 ( asset_code, reading, user_ts ) VALUES  (?,?,?)";
-
-	if (sqlite3_prepare_v2(dbHandle, sql_cmd, strlen(sql_cmd), &stmt, NULL) != SQLITE_OK)
-	{
-		raiseError("readingStream", sqlite3_errmsg(dbHandle));
-		return -1;
-	}
-
 	// The handling of the commit parameter is overridden as using a pool of connections every execution receives
 	// a differen one, so a commit at every run is executed.
 	m_streamOpenTransaction = true;
@@ -476,12 +952,54 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		{
 			add_row = true;
 
-			// Handles - asset_code
+			// Handles - asset_code, a different asset from the previous
+			// reading is looked up in the readings catalogue
 			asset_code = RDS_ASSET_CODE(readings, i);
+			if (lastAsset.compare(asset_code) != 0)
+			{
+				ReadingsCatalogue::tyReadingReference ref;
+
+				if (appendedId)
+				{
+					readCatalogue->readingsAppended(lastAsset, appendedId);
+					appendedId = 0;
+				}
+
+				ref = readCatalogue->getAppendReference(this, asset_code);
+				if (ref.tableId == -1)
+				{
+					Logger::getLogger()->warn("readingStream - It was not possible to insert the row for the asset_code '%s' into the readings, row ignored.", asset_code);
+					stmt = NULL;
+				}
+				else
+				{
+					stmt = getAppendStatement(ref.dbId, ref.tableId);
+					overflow = ReadingsCatalogue::isSharedTable(ref.dbId, ref.tableId);
+				}
+				lastAsset = asset_code;
+			}
 
-			// Handles - reading
+			// Handles - reading, binary payloads are stored as they are if the
+			// readings are held in binary, otherwise they are converted directly
+			// to the stored JSON
 			payload = RDS_PAYLOAD(readings, i);
-			reading = escape(payload);
+			if (RDS_PAYLOAD_IS_BINARY(payload) && binary)
+			{
+				// Bound directly from the stream buffer below
+			}
+			else if (RDS_PAYLOAD_IS_BINARY(payload))
+			{
+				if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, json))
+				{
+					raiseError("readingStream", "Unable to decode binary payload for asset '%s'", asset_code);
+					add_row = false;
+				}
+				reading = escape(json);
+			}
+			else
+			{
+				reading = escape(payload);
+			}
 
 			// Handles - user_ts
 			memset(&timeinfo, 0, sizeof(struct tm));
@@ -514,9 +1032,22 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			{
 				if (stmt != NULL)
 				{
-					sqlite3_bind_text(stmt, 1, asset_code,      -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 2, reading.c_str(), -1, SQLITE_STATIC);
-					sqlite3_bind_text(stmt, 3, user_ts,         -1, SQLITE_STATIC);
+					unsigned long id = readCatalogue->getIncGlobalId();
+					if (rowNumber == -1)
+					{
+						// Mark the transaction start for this thread
+						readCatalogue->m_tx.SetThreadTransactionStart(tid, id);
+					}
+					sqlite3_bind_int(stmt, 1, id);
+					sqlite3_bind_text(stmt, 2, user_ts,         -1, SQLITE_STATIC);
+					if (binary && RDS_PAYLOAD_IS_BINARY(payload))
+						sqlite3_bind_blob(stmt, 3, payload, readings[i]->payloadLength, SQLITE_STATIC);
+					else
+						sqlite3_bind_text(stmt, 3, reading.c_str(), -1, SQLITE_STATIC);
+					if (overflow)
+					{
+						sqlite3_bind_text(stmt, 4, asset_code, -1, SQLITE_STATIC);
+					}
 
 					retries =0;
 					sleep_time_ms = 0;
@@ -560,6 +1091,25 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 					if (sqlite3_resut == SQLITE_DONE)
 					{
 						rowNumber++;
+						if (!overflow)
+						{
+							appendedId = id;
+						}
+						if (rollups)
+						{
+							// Binary payloads held as they are have not been decoded above
+							if (binary && RDS_PAYLOAD_IS_BINARY(payload) &&
+							    !ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, json))
+							{
+								json.clear();
+							}
+							Document doc;
+							doc.Parse(RDS_PAYLOAD_IS_BINARY(payload) ? json.c_str() : payload);
+							if (doc.HasParseError() || !rollupBatch.add(asset_code, user_ts, doc))
+							{
+								Logger::getLogger()->warn("readingStream - The reading of asset '%s' could not be added to the rollups", asset_code);
+							}
+						}
 
 						sqlite3_clear_bindings(stmt);
 						sqlite3_reset(stmt);
@@ -572,7 +1122,10 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 								   sqlite3_errmsg(dbHandle),
 								   reading.c_str());
 
+						sqlite3_clear_bindings(stmt);
+						sqlite3_reset(stmt);
 						sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+						readCatalogue->m_tx.ClearThreadTransaction(tid);
 						m_streamOpenTransaction = true;
 						return -1;
 					}
@@ -580,12 +1133,22 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 			}
 		}
 		rowNumber = i;
+		if (appendedId)
+		{
+			readCatalogue->readingsAppended(lastAsset, appendedId);
+		}
 
 	} catch (exception e) {
 
 		raiseError("appendReadings", "Inserting a row into SQLIte using a prepared command - error '%s'", e.what());
 
+		if (stmt != NULL)
+		{
+			sqlite3_clear_bindings(stmt);
+			sqlite3_reset(stmt);
+		}
 		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		readCatalogue->m_tx.ClearThreadTransaction(tid);
 		m_streamOpenTransaction = true;
 		return -1;
 	}
@@ -594,6 +1157,16 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 	gettimeofday(&t1, NULL);
 #endif
 
+	// Maintain the rollups in the same transaction as the readings
+	if (rollups && !rollup->apply(dbHandle, rollupBatch))
+	{
+		raiseError("readingStream", "Failed to update the readings rollups");
+		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		readCatalogue->m_tx.ClearThreadTransaction(tid);
+		m_streamOpenTransaction = true;
+		return -1;
+	}
+
 	if (commit)
 	{
 		sqlite3_resut = sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL);
@@ -605,13 +1178,8 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 		m_streamOpenTransaction = true;
 	}
 
-	if(stmt != NULL)
-	{
-		if (sqlite3_finalize(stmt) != SQLITE_OK)
-		{
-			raiseError("appendReadings","freeing SQLite in memory structure - error '%s'", sqlite3_errmsg(dbHandle));
-		}
-	}
+	// The insert statements are held in the statement cache of the connection
+	readCatalogue->m_tx.ClearThreadTransaction(tid);
 
 #if INSTRUMENT
 	gettimeofday(&t2, NULL);
@@ -639,6 +1207,136 @@ int Connection::readingStream(ReadingStream **readings, bool commit)
 }
 
 
+/**
+ * Return the prepared insert statement for a readings table, preparing
+ * and caching it if this connection has not used the table before.
+ *
+ * The overflow tables and time partitions hold readings for many assets,
+ * their statement takes the asset code as a fourth parameter.
+ *
+ * @param dbId		The database id of the readings table
+ * @param tableId	The id of the readings table, OVERFLOW_TABLE_ID for the overflow table
+ * @return		The prepared statement or NULL if it could not be prepared
+ */
+sqlite3_stmt *Connection::getAppendStatement(int dbId, int tableId)
+{
+	auto key = make_pair(dbId, tableId);
+	auto it = m_appendStmts.find(key);
+	if (it != m_appendStmts.end())
+	{
+		m_stmtCacheHits++;
+		return it->second;
+	}
+	m_stmtCacheMisses++;
+
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+	string dbName = readCatalogue->generateDbName(dbId);
+	string sql_cmd;
+	if (ReadingsCatalogue::isSharedTable(dbId, tableId))
+	{
+		sql_cmd = "INSERT INTO  " + dbName + "." + readCatalogue->generateReadingsName(dbId, tableId) + " ( id, user_ts, reading, asset_code ) VALUES  (?,?,?,?)";
+	}
+	else
+	{
+		sql_cmd = "INSERT INTO  " + dbName + "." + readCatalogue->generateReadingsName(dbId, tableId) + " ( id, user_ts, reading ) VALUES  (?,?,?)";
+	}
+
+	sqlite3_stmt *stmt = NULL;
+	if (SQLPrepare(dbHandle, sql_cmd.c_str(), &stmt) != SQLITE_OK)
+	{
+		raiseError("appendReadings", sqlite3_errmsg(dbHandle));
+		return NULL;
+	}
+	Logger::getLogger()->debug("appendReadings: prepared '%s'", sql_cmd.c_str());
+	m_appendStmts.insert(make_pair(key, stmt));
+	return stmt;
+}
+
+/**
+ * Return the prepared fetch statement for a readings table, preparing
+ * and caching it if this connection has not used the table before.
+ *
+ * The statement takes the first id to return, the id at which to stop
+ * and the maximum number of rows as parameters. The statement for the
+ * overflow tables and time partitions also returns the asset code.
+ *
+ * @param dbId		The database id of the readings table
+ * @param tableId	The id of the readings table, OVERFLOW_TABLE_ID for the overflow table
+ * @return		The prepared statement or NULL if it could not be prepared
+ */
+sqlite3_stmt *Connection::getFetchStatement(int dbId, int tableId)
+{
+	auto key = make_pair(dbId, tableId);
+	auto it = m_fetchStmts.find(key);
+	if (it != m_fetchStmts.end())
+	{
+		return it->second;
+	}
+
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+	string sql_cmd = R"(
+		SELECT
+			id,
+			reading,
+			strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
+			substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
+			strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts)";
+	if (ReadingsCatalogue::isSharedTable(dbId, tableId))
+	{
+		sql_cmd += ", asset_code";
+	}
+	sql_cmd += " FROM " + readCatalogue->generateDbName(dbId) + "." +
+		readCatalogue->generateReadingsName(dbId, tableId) +
+		" WHERE id >= ? AND id < ? ORDER BY id ASC LIMIT ?";
+
+	sqlite3_stmt *stmt = NULL;
+	if (SQLPrepare(dbHandle, sql_cmd.c_str(), &stmt) != SQLITE_OK)
+	{
+		raiseError("retrieve", sqlite3_errmsg(dbHandle));
+		return NULL;
+	}
+	logSQL("ReadingsFetch", sql_cmd.c_str());
+	m_fetchStmts.insert(make_pair(key, stmt));
+	return stmt;
+}
+
+/**
+ * Discard the cached readings statements if the readings catalogue
+ * has changed since they were prepared
+ */
+void Connection::checkStatementCache()
+{
+	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
+	if (m_stmtsGeneration != readCatalogue->getGeneration())
+	{
+		clearStatementCache();
+		m_stmtsGeneration = readCatalogue->getGeneration();
+	}
+}
+
+/**
+ * Finalize and discard the cached readings insert and fetch statements
+ */
+void Connection::clearStatementCache()
+{
+	for (auto& item : m_appendStmts)
+	{
+		if (sqlite3_finalize(item.second) != SQLITE_OK)
+		{
+			raiseError("appendReadings","freeing SQLite in memory structure - error '%s'", sqlite3_errmsg(dbHandle));
+		}
+	}
+	m_appendStmts.clear();
+	for (auto& item : m_fetchStmts)
+	{
+		if (sqlite3_finalize(item.second) != SQLITE_OK)
+		{
+			raiseError("retrieve","freeing SQLite in memory structure - error '%s'", sqlite3_errmsg(dbHandle));
+		}
+	}
+	m_fetchStmts.clear();
+}
+
 /**
  * Append a set of readings to the readings table
  */
@@ -687,19 +1385,24 @@ const char   *asset_code;
 string        reading,
               msg;
 sqlite3_stmt *stmt;
-int rc;
 int           sqlite3_resut;
 int           readingsId;
 string        now;
 
-std::pair<int, sqlite3_stmt *> pairValue;
 string lastAsset;
+bool overflow = false;
+unsigned long appendId = 0, appendedId = 0;
+bool binary = ConnectionManager::getInstance()->binaryReadings();
+bool isBinary = false;
+
+ReadingsRollup *rollup = ReadingsRollup::getInstance();
+bool rollups = rollup->isEnabled();
+ReadingsRollup::Batch rollupBatch;
 
 // Retry mechanism
 int retries = 0;
 int sleep_time_ms = 0;
 
-int stmtArraySize;
 std::thread::id tid = std::this_thread::get_id();
 ostringstream threadId;
 
@@ -735,8 +1438,7 @@ ostringstream threadId;
 	}
 	attachSync->unlock();
 
-	stmtArraySize = readCatalogue->getReadingPosition(0, 0);
-	vector<sqlite3_stmt *> readingsStmt(stmtArraySize + 1, nullptr);
+	checkStatementCache();
 
 #if INSTRUMENT
 	Logger::getLogger()->debug("appendReadings start thread '%s'", threadId.str().c_str());
@@ -770,9 +1472,6 @@ ostringstream threadId;
 		return -1;
 	}
 
-	int tableIdx;
-	string sql_cmd;
-
 	{
 	m_writeAccessOngoing.fetch_add(1);
 	//unique_lock<mutex> lck(db_mutex);
@@ -832,7 +1531,13 @@ ostringstream threadId;
 			{
 				ReadingsCatalogue::tyReadingReference ref;
 
-				ref = readCatalogue->getReadingReference(this, asset_code);
+				if (appendedId)
+				{
+					readCatalogue->readingsAppended(lastAsset, appendedId);
+					appendedId = 0;
+				}
+
+				ref = readCatalogue->getAppendReference(this, asset_code);
 				readingsId = ref.tableId;
 
 				Logger::getLogger()->debug("tyReadingReference '%s' %d %d ", asset_code, ref.dbId, ref.tableId);
@@ -844,81 +1549,58 @@ ostringstream threadId;
 				}
 				else
 				{
-					int nReadings, idxReadings;
-
-					nReadings = readCatalogue->getReadingsCount();
-					idxReadings = readCatalogue->getReadingPosition(ref.dbId, ref.tableId);
-
-					Logger::getLogger()->debug("tyReadingReference '%s' %d %d idxReadings %d", asset_code, ref.dbId, ref.tableId, idxReadings);
-
-					if (idxReadings >= stmtArraySize)
-					{
-						stmtArraySize = idxReadings + 1;
-						readingsStmt.resize(stmtArraySize, nullptr);
-
-						Logger::getLogger()->debug("appendReadings: thread '%s' resize size %d idx %d ", threadId.str().c_str(), stmtArraySize, readingsId);
-					}
-
-					if (readingsStmt[idxReadings] == nullptr)
-					{
-						string dbName = readCatalogue->generateDbName(ref.dbId);
-						string dbReadingsName = readCatalogue->generateReadingsName(ref.dbId, readingsId);
-
-						if (readingsId == 0)
-						{
-							// Overflow table
-							sql_cmd = "INSERT INTO  " + dbName + ".readings_" + to_string(ref.dbId) + "_overflow ( id, asset_code, user_ts, reading ) VALUES  (?,'" + asset_code + "',?,?)";
-						}
-						else
-						{
-							sql_cmd = "INSERT INTO  " + dbName + "." + dbReadingsName + " ( id, user_ts, reading ) VALUES  (?,?,?)";
-						}
-						rc = SQLPrepare(dbHandle, sql_cmd.c_str(), &readingsStmt[idxReadings]);
-
-						Logger::getLogger()->debug("tyReadingReference sql_cmd  '%s' '%s' %d %d ", sql_cmd.c_str(), asset_code, ref.dbId, ref.tableId);
-
-						if (rc != SQLITE_OK)
-						{
-							raiseError("appendReadings", sqlite3_errmsg(dbHandle));
-						}
-					}
-					stmt = readingsStmt[idxReadings];
+					stmt = getAppendStatement(ref.dbId, ref.tableId);
+					overflow = ReadingsCatalogue::isSharedTable(ref.dbId, ref.tableId);
 
 					lastAsset = asset_code;
 				}
 			}
 
-			// Handles - reading
-			StringBuffer buffer;
-			Writer<StringBuffer> writer(buffer);
-			(*itr)["reading"].Accept(writer);
-			reading = escape(buffer.GetString());
+			// Handles - reading, held as a binary payload if possible
+			isBinary = binary && ReadingStreamPayload::fromJSON((*itr)["reading"], reading);
+			if (!isBinary)
+			{
+				StringBuffer buffer;
+				Writer<StringBuffer> writer(buffer);
+				(*itr)["reading"].Accept(writer);
+				reading = escape(buffer.GetString());
+			}
 
 			if(stmt != NULL) {
 				// First reading, use the id as transaction start
 				if (itr == readingsValue.Begin())
 				{
 					// Get current reading global id
-					unsigned long startTransactionId = readCatalogue->getIncGlobalId();
+					appendId = readCatalogue->getIncGlobalId();
 
 					// Mark transaction srtart fot this thread
 					readCatalogue->m_tx.SetThreadTransactionStart(tid,
-							startTransactionId);
+							appendId);
 
 					// Bind first parameter with reading id
-					sqlite3_bind_int (stmt, 1, startTransactionId);
+					sqlite3_bind_int (stmt, 1, appendId);
 				}
 				else
 				{
 					// Bind first parameter with reading id
-					sqlite3_bind_int (stmt, 1, readCatalogue->getIncGlobalId());
+					appendId = readCatalogue->getIncGlobalId();
+					sqlite3_bind_int (stmt, 1, appendId);
 				}
 
 				// Set parameter for user timestamp
 				sqlite3_bind_text(stmt, 2, user_ts         ,-1, SQLITE_STATIC);
 
-				// Set parameter for reading JSON data
-				sqlite3_bind_text(stmt, 3, reading.c_str(), -1, SQLITE_STATIC);
+				// Set parameter for reading data
+				if (isBinary)
+					sqlite3_bind_blob(stmt, 3, reading.data(), reading.length(), SQLITE_STATIC);
+				else
+					sqlite3_bind_text(stmt, 3, reading.c_str(), -1, SQLITE_STATIC);
+
+				// The overflow tables are shared by many assets so the asset code is also bound
+				if (overflow)
+				{
+					sqlite3_bind_text(stmt, 4, asset_code, -1, SQLITE_STATIC);
+				}
 
 				retries =0;
 				sleep_time_ms = 0;
@@ -976,6 +1658,14 @@ ostringstream threadId;
 				if (sqlite3_resut == SQLITE_DONE)
 				{
 					row++;
+					if (!overflow)
+					{
+						appendedId = appendId;
+					}
+					if (rollups)
+					{
+						rollupBatch.add(asset_code, user_ts, (*itr)["reading"]);
+					}
 
 					sqlite3_clear_bindings(stmt);
 					sqlite3_reset(stmt);
@@ -999,25 +1689,28 @@ ostringstream threadId;
 					// Clear transaction boundary for this thread
 					readCatalogue->m_tx.ClearThreadTransaction(tid);
 
-					// Finalize sqlite structures
-					for (auto &item : readingsStmt)
-					{
-						if(item != nullptr)
-						{
-
-							if (sqlite3_finalize(item) != SQLITE_OK)
-							{
-								raiseError("appendReadings","freeing SQLite in memory structure - error '%s'", sqlite3_errmsg(dbHandle));
-							}
-						}
-
-					}
 					return -1;
 				}
 			}
 		}
 	}
 
+	if (appendedId)
+	{
+		readCatalogue->readingsAppended(lastAsset, appendedId);
+	}
+
+	// Maintain the rollups in the same transaction as the readings
+	if (rollups && !rollup->apply(dbHandle, rollupBatch))
+	{
+		raiseError("appendReadings", "Failed to update the readings rollups");
+		sqlite3_exec(dbHandle, "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+		m_appendCount--;
+		readCatalogue->m_tx.ClearThreadTransaction(tid);
+		m_writeAccessOngoing.fetch_sub(1);
+		return -1;
+	}
+
 	sqlite3_resut = sqlite3_exec(dbHandle, "END TRANSACTION", NULL, NULL, NULL);
 	if (sqlite3_resut != SQLITE_OK)
 	{
@@ -1037,24 +1730,20 @@ ostringstream threadId;
 		gettimeofday(&t2, NULL);
 #endif
 
-	// Finalize sqlite structures
-	for (auto &item : readingsStmt)
-	{
-		if(item != nullptr)
-		{
-
-			if (sqlite3_finalize(item) != SQLITE_OK)
-			{
-				raiseError("appendReadings","freeing SQLite in memory structure - error '%s'", sqlite3_errmsg(dbHandle));
-			}
-		}
-
-	}
-
 #if INSTRUMENT
 		gettimeofday(&t3, NULL);
 #endif
 
+	if ((++m_appendCalls % STMT_CACHE_REPORT_INTERVAL) == 0)
+	{
+		unsigned long hits = m_stmtCacheHits;
+		unsigned long misses = m_stmtCacheMisses;
+		Logger::getLogger()->info("appendReadings: %lu calls, insert statement cache hit rate %.1f%% (%lu hits, %lu prepares)",
+				(unsigned long)m_appendCalls,
+				(hits + misses) ? (100.0 * hits) / (hits + misses) : 0.0,
+				hits, misses);
+	}
+
 #if INSTRUMENT
 		struct timeval tm;
 		double timeT1, timeT2, timeT3;
@@ -1087,30 +1776,38 @@ ostringstream threadId;
 
 #ifndef SQLITE_SPLIT_READINGS
 /**
- * Fetch a block of readings from the reading table
- * It might not work with SQLite 3
+ * A cursor over one of the readings tables, used by fetchReadings
+ * to merge the rows of all the tables in id order
+ */
+typedef struct {
+	sqlite3_stmt	*stmt;
+	std::string	assetCode;	// Empty for the overflow tables that return the asset code
+} FetchCursor;
+
+/**
+ * Fetch a block of readings from the reading table, calling the
+ * row function for each reading in id order
  *
- * Fetch, used by the north side, returns timestamp in UTC.
+ * Each readings table is read by a cursor limited to blksize rows and the
+ * cursors are merged on the reading id, this avoids a single UNION ALL over
+ * all the tables that SQLite can not limit per table. The block ends after
+ * blksize readings or at the first reading still to be committed.
  *
- * NOTE : it expects to handle a date having a fixed format
- * with milliseconds, microseconds and timezone expressed,
- * like for example :
+ * The statement passed to the row function returns the id, reading,
+ * user_ts and ts columns and the asset code is passed separately.
  *
- *    2019-01-11 15:45:01.123456+01:00
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param row		The function to call for each reading
+ * @return bool		True if the readings were fetched
  */
-bool Connection::fetchReadings(unsigned long id,
-			       unsigned int blksize,
-			       std::string& resultSet)
+bool Connection::fetchReadingRows(unsigned long id,
+				  unsigned int blksize,
+				  const std::function<void(sqlite3_stmt *, const char *)>& row)
 {
-char sqlbuffer[5120];
-char *zErrMsg = NULL;
+vector<FetchCursor>	cursors;
+vector<pair<string, ReadingsCatalogue::tyReadingReference>> tables;
 int rc;
-int retrieve;
-vector<string>  asset_codes;
-string sql_cmd;
-unsigned int minGlobalId;
-unsigned int idWindow;
-unsigned long rowsCount;
 
 	if (m_noReadings)
 	{
@@ -1118,8 +1815,6 @@ unsigned long rowsCount;
 		return false;
 	}
 
-	ostringstream threadId;
-	threadId << std::this_thread::get_id();
 	ReadingsCatalogue *readCatalogue = ReadingsCatalogue::getInstance();
 
 	{
@@ -1133,183 +1828,282 @@ unsigned long rowsCount;
 		}
 		attachSync->unlock();
 	}
-
-	if (id == 1)
-	{
-		// at the first extract, Verifies if there are data having id above the current searched window
-		minGlobalId = readCatalogue->getMinGlobalId(this->getDbHandle());
-		idWindow = id + blksize;
-
-		if (idWindow < minGlobalId)
-		{
-			id = minGlobalId;
-			Logger::getLogger()->debug("%s - first extraction, data extracted from the id :%lu:", __FUNCTION__, id);
-		}
-	}
-
-	// Generate a single SQL statement that using a set of UNION considers all the readings table in handling
-	// SQL - start
-	sql_cmd = R"(
-		SELECT
-			id,
-			asset_code,
-			reading,
-			strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
-			substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
-			strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts
-		FROM
-		(
-	)";
-
-	// SQL - union of all the readings tables
-	string sql_cmd_base;
-	string sql_cmd_tmp;
-	// Would like to add a LIMIT on each sub-query in the union all, however SQLITE
-	// does not support this. Note we can not use id + blocksize as this fail if we 
-	// have holes in the id space
-	sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts " \
-			"FROM _dbname_._tablename_ WHERE id >= " +
-			to_string(id) + " ";
+	checkStatementCache();
 
 	// Check for any uncommitted transactions:
 	// fetch the minimum reading id among all per thread transactions
 	// an use it as a boundary limit.
 	// If no pending transactions just use current global reading id as limit
 	unsigned long safe_id = readCatalogue->m_tx.GetMinReadingId();
-	if (safe_id)
+	if (safe_id == 0)
+	{
+		safe_id = readCatalogue->getGlobalId();
+	}
+
+	// Open a cursor on each of the asset tables, the overflow tables and
+	// the time partitions that may hold readings from the requested id,
+	// the tables the catalogue knows only hold older readings are omitted.
+	// Each cursor returns at most blksize rows in id order, the cursors
+	// are then merged on the id so that only the rows that are returned
+	// are ever read from the databases.
+	//
+	// Holes in the id space, left by purges or by a restart that moved
+	// the global id on, are skipped by the id >= condition of each
+	// cursor. There is therefore no need to move the requested id up to
+	// the minimum global id when a block comes back empty, as was done
+	// when the readings were fetched by a single query over an id window.
+	// The asset tables are read under the lock that the catalogue is
+	// updated under, as a new asset may be added by an append
+	AttachDbSync *attachSync = AttachDbSync::getInstance();
+	attachSync->lock();
+	readCatalogue->getAssetTables(tables, id);
+	attachSync->unlock();
+	for (auto& table : tables)
 	{
-		sql_cmd_base += "AND id < " + to_string(safe_id) + " ";
+		FetchCursor cursor;
+		cursor.stmt = getFetchStatement(table.second.dbId, table.second.tableId);
+		cursor.assetCode = table.first;
+		cursors.push_back(cursor);
 	}
-	else
+	vector<ReadingsCatalogue::tyReadingReference> sharedTables;
+	readCatalogue->getSharedTables(sharedTables, id);
+	for (auto& table : sharedTables)
 	{
-		sql_cmd_base += "AND id < " + to_string(readCatalogue->getGlobalId()) + " ";
+		FetchCursor cursor;
+		cursor.stmt = getFetchStatement(table.dbId, table.tableId);
+		cursors.push_back(cursor);
 	}
 
-	sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes);
-	sql_cmd += sql_cmd_tmp;
+	// Min heap of the next id available in each cursor
+	priority_queue<pair<sqlite3_int64, size_t>,
+		vector<pair<sqlite3_int64, size_t>>,
+		greater<pair<sqlite3_int64, size_t>>> heap;
 
-	// Now add in ther overflow tables
-	sql_cmd_base = " SELECT  id, asset_code, reading, user_ts, ts " \
-			"FROM _dbname_._tablename_ WHERE id >= " +
-			to_string(id) + " ";
-	if (safe_id)
+	vector<string> emptyAssets;
+	bool failed = false;
+	for (size_t i = 0; i < cursors.size() && !failed; i++)
 	{
-		sql_cmd_base += "AND id < " + to_string(safe_id) + " ";
+		sqlite3_stmt *stmt = cursors[i].stmt;
+		if (!stmt)
+		{
+			failed = true;
+			break;
+		}
+		sqlite3_bind_int64(stmt, 1, id);
+		sqlite3_bind_int64(stmt, 2, safe_id);
+		sqlite3_bind_int(stmt, 3, blksize);
+		rc = SQLstep(stmt);
+		if (rc == SQLITE_ROW)
+		{
+			heap.push(make_pair(sqlite3_column_int64(stmt, 0), i));
+		}
+		else if (rc == SQLITE_DONE)
+		{
+			// All the readings before safe_id are committed, so an asset
+			// table with none of them from id has no readings from id
+			// until the next append to it
+			if (!cursors[i].assetCode.empty() && id < safe_id)
+			{
+				emptyAssets.push_back(cursors[i].assetCode);
+			}
+		}
+		else
+		{
+			failed = true;
+		}
 	}
-	else
+
+	if (!emptyAssets.empty())
 	{
-		sql_cmd_base += "AND id < " + to_string(readCatalogue->getGlobalId()) + " ";
+		attachSync->lock();
+		for (auto& asset : emptyAssets)
+		{
+			readCatalogue->noReadingsFrom(asset, id);
+		}
+		attachSync->unlock();
 	}
 
-	sql_cmd_tmp = readCatalogue->sqlConstructOverflow(sql_cmd_base, asset_codes);
-	sql_cmd += sql_cmd_tmp;
+	unsigned long rowsCount = 0;
 
-	// SQL - end
-	sql_cmd += R"(
-		) as tb
-		ORDER BY id ASC
-		LIMIT
-	)" + to_string(blksize);
+	while (!failed && !heap.empty() && rowsCount < blksize)
+	{
+		size_t i = heap.top().second;
+		heap.pop();
 
-	logSQL("ReadingsFetch", sql_cmd.c_str());
+		FetchCursor& cursor = cursors[i];
+		sqlite3_stmt *stmt = cursor.stmt;
+		const char *assetCode = cursor.assetCode.empty() ?
+				(const char *)sqlite3_column_text(stmt, 4) : cursor.assetCode.c_str();
+		row(stmt, assetCode ? assetCode : "");
+		rowsCount++;
 
-	sqlite3_stmt *stmt;
-	// Prepare the SQL statement and get the result set
-	rc = sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(),-1,&stmt,NULL);
-	if (rc != SQLITE_OK)
+		rc = SQLstep(stmt);
+		if (rc == SQLITE_ROW)
+		{
+			heap.push(make_pair(sqlite3_column_int64(stmt, 0), i));
+		}
+		else if (rc != SQLITE_DONE)
+		{
+			failed = true;
+		}
+	}
+
+	if (failed)
 	{
 		raiseError("retrieve", sqlite3_errmsg(dbHandle));
+	}
+
+	// Reset the cursors so that no read transaction is left open
+	for (auto& cursor : cursors)
+	{
+		if (cursor.stmt)
+		{
+			sqlite3_reset(cursor.stmt);
+			sqlite3_clear_bindings(cursor.stmt);
+		}
+	}
 
+	if (failed)
+	{
 		// Failure
 		return false;
 	}
-	else
-	{
-		// Call result set mapping
-		rc = mapResultSet(stmt, resultSet, &rowsCount);
 
-		if (rowsCount == 0)
-		{
-			// If no data were processed, it verifies if there are data having id above the current searched window
-			minGlobalId = readCatalogue->getMinGlobalId(this->getDbHandle());
-			idWindow = id + blksize;
+	return true;
+}
 
-			if (idWindow < minGlobalId)
+/**
+ * Fetch a block of readings from the reading table
+ *
+ * Fetch, used by the north side, returns timestamp in UTC.
+ *
+ * NOTE : it expects to handle a date having a fixed format
+ * with milliseconds, microseconds and timezone expressed,
+ * like for example :
+ *
+ *    2019-01-11 15:45:01.123456+01:00
+ */
+bool Connection::fetchReadings(unsigned long id,
+			       unsigned int blksize,
+			       std::string& resultSet)
+{
+	StringBuffer buffer;
+	Writer<StringBuffer> writer(buffer);
+	unsigned long rowsCount = 0;
+	string json;
+
+	writer.StartArray();
+	bool fetched = fetchReadingRows(id, blksize, [&](sqlite3_stmt *stmt, const char *assetCode) {
+		bool binaryReading = false;
+		const char *reading = NULL;
+		if (sqlite3_column_type(stmt, 1) == SQLITE_BLOB)
+		{
+			const char *payload = (const char *)sqlite3_column_blob(stmt, 1);
+			int length = sqlite3_column_bytes(stmt, 1);
+			if (length > 0 && RDS_PAYLOAD_IS_BINARY(payload) &&
+					ReadingStreamPayload::toJSON(payload, length, json))
 			{
-				id = minGlobalId;
-
-				// Delete result set
-				sqlite3_finalize(stmt);
-
-				// Generate a single SQL statement that using a set of UNION considers all the readings table in handling
-				{
-					// SQL - start
-					sql_cmd = R"(
-						SELECT
-							id,
-							asset_code,
-							reading,
-							strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc')  ||
-							substr(user_ts, instr(user_ts, '.'), 7) AS user_ts,
-							strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts
-						FROM
-						(
-					)";
-
-					// SQL - union of all the readings tables
-					string sql_cmd_base;
-					string sql_cmd_tmp;
-					sql_cmd_base = " SELECT  id, \"_assetcode_\" asset_code, reading, user_ts, ts  FROM _dbname_._tablename_ WHERE id >= " + to_string(id) + " and id <=  " + to_string(id) + " + " + to_string(blksize) + " ";
-					sql_cmd_tmp = readCatalogue->sqlConstructMultiDb(sql_cmd_base, asset_codes);
-					sql_cmd += sql_cmd_tmp;
-
-					// SQL - end
-					sql_cmd += R"(
-					) as tb
-					ORDER BY id ASC
-					LIMIT
-				)" + to_string(blksize);
-
-				}
-
-				logSQL("ReadingsFetch", sql_cmd.c_str());
-
-				// Prepare the SQL statement and get the result set
-				rc = sqlite3_prepare_v2(dbHandle, sql_cmd.c_str(),-1,&stmt,NULL);
-				if (rc != SQLITE_OK)
-				{
-					raiseError("retrieve", sqlite3_errmsg(dbHandle));
-
-					// Failure
-					return false;
-				}
-				// Call result set mapping
-				rc = mapResultSet(stmt, resultSet, &rowsCount);
-
-				if (rowsCount != 0)
-				{
-					Logger::getLogger()->debug("%s - following extractions, data extracted from the id :%lu:", __FUNCTION__, id);
-				}
+				binaryReading = true;
 			}
 		}
-
-		// Delete result set
-		sqlite3_finalize(stmt);
-
-		// Check result set errors
-		if (rc != SQLITE_DONE)
+		if (!binaryReading)
 		{
-			raiseError("retrieve", sqlite3_errmsg(dbHandle));
-
-			// Failure
-			return false;
+			reading = (const char *)sqlite3_column_text(stmt, 1);
+		}
+		const char *userTs = (const char *)sqlite3_column_text(stmt, 2);
+		const char *ts = (const char *)sqlite3_column_text(stmt, 3);
+
+		writer.StartObject();
+		writer.Key("id");
+		writer.Int64(sqlite3_column_int64(stmt, 0));
+		writer.Key("asset_code");
+		writer.String(assetCode);
+		writer.Key("reading");
+		Document doc;
+		if (binaryReading)
+		{
+			// The JSON created from a binary payload is always an object
+			writer.RawValue(json.c_str(), json.length(), kObjectType);
+		}
+		else if (reading && !doc.Parse(reading).HasParseError() && !doc.IsNumber())
+		{
+			doc.Accept(writer);
 		}
 		else
 		{
-			// Success
-			return true;
+			writer.String(reading ? reading : "");
 		}
+		writer.Key("user_ts");
+		writer.String(userTs ? userTs : "");
+		writer.Key("ts");
+		writer.String(ts ? ts : "");
+		writer.EndObject();
+		rowsCount++;
+	});
+	writer.EndArray();
+
+	if (!fetched)
+	{
+		return false;
+	}
+
+	resultSet = "{\"count\":" + to_string(rowsCount) + ",\"rows\":";
+	resultSet.append(buffer.GetString(), buffer.GetSize());
+	resultSet += "}";
+
+	// Success
+	return true;
+}
+
+/**
+ * Fetch a block of readings from the reading table in the binary form
+ * described in reading_stream.h. Readings held as binary payloads are
+ * returned as they are stored, avoiding the conversion to JSON and in
+ * particular the base64 encoding of images and data buffers. Other
+ * readings are returned as the JSON text of their datapoints.
+ *
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param resultSet	The binary result
+ * @return bool		True if the readings were fetched
+ */
+bool Connection::fetchReadingsBinary(unsigned long id,
+				     unsigned int blksize,
+				     std::string& resultSet)
+{
+	RDSFetchHeader header;
+	header.magic = RDS_FETCH_MAGIC;
+	header.count = 0;
+	resultSet.assign((const char *)&header, sizeof(header));
+
+	bool fetched = fetchReadingRows(id, blksize, [&](sqlite3_stmt *stmt, const char *assetCode) {
+		const char *payload;
+		RDSFetchReading reading;
+		if (sqlite3_column_type(stmt, 1) == SQLITE_BLOB)
+			payload = (const char *)sqlite3_column_blob(stmt, 1);
+		else
+			payload = (const char *)sqlite3_column_text(stmt, 1);
+		const char *userTs = (const char *)sqlite3_column_text(stmt, 2);
+		const char *ts = (const char *)sqlite3_column_text(stmt, 3);
+
+		reading.id = sqlite3_column_int64(stmt, 0);
+		reading.assetLength = strlen(assetCode);
+		reading.userTsLength = userTs ? strlen(userTs) : 0;
+		reading.tsLength = ts ? strlen(ts) : 0;
+		reading.payloadLength = payload ? sqlite3_column_bytes(stmt, 1) : 0;
+		resultSet.append((const char *)&reading, sizeof(reading));
+		resultSet.append(assetCode, reading.assetLength);
+		resultSet.append(userTs ? userTs : "", reading.userTsLength);
+		resultSet.append(ts ? ts : "", reading.tsLength);
+		resultSet.append(payload ? payload : "", reading.payloadLength);
+		header.count++;
+	});
+	if (!fetched)
+	{
+		return false;
 	}
+	memcpy(&resultSet[0], &header, sizeof(header));
+	return true;
 }
 #endif
 
@@ -1428,7 +2222,13 @@ vector<string>  asset_codes;
 				return aggregateQuery(document, resultSet);
 			}
 
-			if (document.HasMember("aggregate"))
+			string rollupSql;
+			if (rollupTimebucket(document, rollupSql))
+			{
+				// timebucket of a single datapoint answered from the readings rollups
+				sql.append(rollupSql.c_str());
+			}
+			else if (document.HasMember("aggregate"))
 			{
 				isAggregate = true;
 				sql.append("SELECT ");
@@ -1665,6 +2465,7 @@ vector<string>  asset_codes;
 				sql.append(timezone);
 				sql.append("') AS ts FROM  ");
 			}
+			if (rollupSql.empty())
 			{
 
 				// Identifies the asset_codes used in the query
@@ -1729,7 +2530,7 @@ vector<string>  asset_codes;
 
 
 
-			if (document.HasMember("where"))
+			if (rollupSql.empty() && document.HasMember("where"))
 			{
 				sql.append(" WHERE ");
 			 
@@ -1762,7 +2563,7 @@ vector<string>  asset_codes;
 				 */
 				sql.append(" WHERE id = id");
 			}
-			if (!jsonModifiers(document, sql, true))
+			if (rollupSql.empty() && !jsonModifiers(document, sql, true))
 			{
 				return false;
 			}
@@ -1809,6 +2610,38 @@ vector<string>  asset_codes;
 }
 #endif
 
+#ifndef SQLITE_SPLIT_READINGS
+/**
+ * Create the JSON result of a purge operation
+ *
+ * @param removed		The number of readings removed
+ * @param unsentPurged		The number of unsent readings removed
+ * @param unsentRetained	The number of unsent readings retained
+ * @param readings		The number of readings that remain
+ * @param method		The purge method, age or rows
+ * @param startTv		The time the purge started
+ * @return			The JSON result
+ */
+static string purgeResult(unsigned long removed, unsigned long unsentPurged, unsigned long unsentRetained,
+			unsigned long readings, const char *method, const struct timeval& startTv)
+{
+	struct timeval endTv;
+	gettimeofday(&endTv, NULL);
+	unsigned long duration = (1000000 * (endTv.tv_sec - startTv.tv_sec)) + endTv.tv_usec - startTv.tv_usec;
+
+	ostringstream convert;
+
+	convert << "{ \"removed\" : " << removed << ", ";
+	convert << " \"unsentPurged\" : " << unsentPurged << ", ";
+	convert << " \"unsentRetained\" : " << unsentRetained << ", ";
+	convert << " \"readings\" : " << readings << ", ";
+	convert << " \"method\" : \"" << method << "\", ";
+	convert << " \"duration\" : " << duration << " }";
+
+	return convert.str();
+}
+#endif
+
 #ifndef SQLITE_SPLIT_READINGS
 /**
  * Purge readings from the reading table
@@ -1822,7 +2655,7 @@ long unsentPurged = 0;
 long unsentRetained = 0;
 long numReadings = 0;
 unsigned long rowidLimit = 0, minrowidLimit = 0, maxrowidLimit = 0, rowidMin;
-struct timeval startTv, endTv;
+struct timeval startTv;
 int blocks = 0;
 bool flag_retain;
 char *zErrMsg = NULL;
@@ -2017,6 +2850,51 @@ vector<string>  assetCodes;
 
 		Logger::getLogger()->debug("purgeReadings purge_readings %d age %d", purge_readings, age);
 	}
+
+	unsigned long partitionRows = 0, partitionUnsent = 0;
+	if (readCat->hasPartitions())
+	{
+		// Drop the time partitions that only hold readings older than age hours,
+		// the remaining readings are then purged row by row
+		partitionRows = readCat->purgePartitionsByAge(dbHandle, age, flag_retain, sent, partitionUnsent);
+		if (partitionRows)
+		{
+			sql_cmd = R"(
+				SELECT MIN(rowid)
+				FROM
+				(
+			)";
+			sql_cmd_base = " SELECT  MIN(rowid) rowid FROM _dbname_._tablename_ ";
+			sql_cmd += readCat->sqlConstructMultiDb(sql_cmd_base, assetCodes, true);
+			sql_cmd += readCat->sqlConstructOverflow(sql_cmd_base, assetCodes, true);
+			sql_cmd += R"(
+				) as readings_1
+			)";
+
+			minrowidLimit = 0;
+			rc = SQLexec(dbHandle, "readings",
+					 sql_cmd.c_str(),
+			     rowidCallback,
+			     &minrowidLimit,
+			     &zErrMsg);
+			if (rc != SQLITE_OK)
+			{
+				raiseError("purge - phase 0, fetching minrowid limit ", zErrMsg);
+				sqlite3_free(zErrMsg);
+				return partitionRows;
+			}
+			if (minrowidLimit == 0)		// No readings remain
+			{
+				minrowidLimit = maxrowidLimit + 1;
+			}
+
+			// The result if no further readings are purged
+			result = purgeResult(partitionRows, sent ? partitionUnsent : partitionRows,
+					maxrowidLimit + 1 - minrowidLimit, maxrowidLimit + 1 - minrowidLimit,
+					"age", startTv);
+			Logger::getLogger()->info("Purge dropped partitions holding %lu readings", partitionRows);
+		}
+	}
 	Logger::getLogger()->debug("%s - rowidLimit :%lu: maxrowidLimit :%lu: maxrowidLimit :%lu: age :%lu:", __FUNCTION__, rowidLimit, maxrowidLimit, minrowidLimit, age);
 
 
@@ -2041,7 +2919,7 @@ vector<string>  assetCodes;
 		if (l == r)
 		{
  			logger->info("No data to purge: min_id == max_id == %u", minrowidLimit);
-			return 0;
+			return partitionRows;
 		}
 
 		unsigned long m=l;
@@ -2126,7 +3004,7 @@ vector<string>  assetCodes;
 		if (minrowidLimit == rowidLimit)
 		{
 			logger->info("No data to purge");
-			return 0;
+			return partitionRows;
 		}
 
 		rowidMin = minrowidLimit;
@@ -2295,26 +3173,16 @@ vector<string>  assetCodes;
 
 	numReadings = maxrowidLimit +1 - minrowidLimit - deletedRows;
 
+	unsentPurged += partitionUnsent;
+	deletedRows += partitionRows;
 	if (sent == 0)	// Special case when not north process is used
 	{
 		unsentPurged = deletedRows;
 	}
 
-	gettimeofday(&endTv, NULL);
-	unsigned long duration = (1000000 * (endTv.tv_sec - startTv.tv_sec)) + endTv.tv_usec - startTv.tv_usec;
-
-	ostringstream convert;
-
-	convert << "{ \"removed\" : " << deletedRows << ", ";
-	convert << " \"unsentPurged\" : " << unsentPurged << ", ";
-	convert << " \"unsentRetained\" : " << unsentRetained << ", ";
-    	convert << " \"readings\" : " << numReadings << ", ";
-	convert << " \"method\" : \"age\", ";
-	convert << " \"duration\" : " << duration << " }";
-
-	result = convert.str();
+	result = purgeResult(deletedRows, unsentPurged, unsentRetained, numReadings, "age", startTv);
 
-	logger->info("Purge process complete in %d blocks in %lduS", blocks, duration);
+	logger->info("Purge process complete in %d blocks", blocks);
 
 	Logger::getLogger()->debug("%s - age :%lu: flag_retain :%x: sent :%lu: result '%s'", __FUNCTION__, age, flags, flag_retain, result.c_str() );
 
@@ -2337,7 +3205,7 @@ unsigned long limit = 0;
 string sql_cmd;
 vector<string>  assetCodes;
 bool flag_retain;
-struct timeval startTv, endTv;
+struct timeval startTv;
 
 
 	// rowidCallback expects unsigned long
@@ -2479,6 +3347,17 @@ struct timeval startTv, endTv;
 
 	numReadings = rowcount;
 	rowsAffected = 0;
+
+	if (readCatalogue->hasPartitions() && rowcount > rows)
+	{
+		// Drop the oldest time partitions that can be removed whole
+		unsigned long dropped = readCatalogue->purgePartitionsByRows(dbHandle, rows, rowcount,
+				flag_retain, sent, unsentPurged);
+		deletedRows += dropped;
+		numReadings -= dropped;
+		rowcount    -= dropped;
+	}
+
 	do
 	{
 		if (rowcount <= rows)
@@ -2590,19 +3469,7 @@ struct timeval startTv, endTv;
 		unsentRetained = numReadings - rows;
 	}
 
-	gettimeofday(&endTv, NULL);
-	unsigned long duration = (1000000 * (endTv.tv_sec - startTv.tv_sec)) + endTv.tv_usec - startTv.tv_usec;
-
-	ostringstream convert;
-
-	convert << "{ \"removed\" : " << deletedRows << ", ";
-	convert << " \"unsentPurged\" : " << unsentPurged << ", ";
-	convert << " \"unsentRetained\" : " << unsentRetained << ", ";
-    	convert << " \"readings\" : " << numReadings << ", ";
-	convert << " \"method\" : \"rows\", ";
-	convert << " \"duration\" : " << duration << " }";
-
-	result = convert.str();
+	result = purgeResult(deletedRows, unsentPurged, unsentRetained, numReadings, "rows", startTv);
 
 	Logger::getLogger()->debug("%s - Purge by Rows complete - rows :%lu: flag :%x: sent :%lu:  numReadings :%lu:  rowsAffected :%u:  result '%s'", __FUNCTION__, rows, flags, sent, numReadings, rowsAffected, result.c_str() );
 
@@ -2707,13 +3574,29 @@ sqlite3_stmt *stmt;
 	}
 	else
 	{
+		unsigned int removed = 0;
+
+		// The readings of the asset written to the time partitions
+		if (readCat->hasPartitions())
+		{
+			removed += readCat->purgeAssetPartitions(dbHandle, asset);
+		}
+
 		ReadingsCatalogue::tyReadingReference ref;
-		ref = readCat->getReadingReference(this, asset.c_str());
-		string dbReadingsName;
-		string dbName;
+		if (!readCat->findReadingReference(asset.c_str(), ref))
+		{
+			return removed;
+		}
 
 		string query = "DELETE FROM " + readCat->generateDbName(ref.dbId);
-		query += "." + readCat->generateReadingsName(ref.dbId, ref.tableId) + ";";
+		query += "." + readCat->generateReadingsName(ref.dbId, ref.tableId);
+		if (ReadingsCatalogue::isSharedTable(ref.dbId, ref.tableId))
+		{
+			string quoted = asset;
+			StringReplaceAll(quoted, "'", "''");
+			query += " WHERE asset_code = '" + quoted + "'";
+		}
+		query += ";";
 
 		// Execute SQL statement via SQLExec wrapper
 		rc = readCat->SQLExec(dbHandle, query.c_str(), &zErrMsg);
@@ -2721,10 +3604,10 @@ sqlite3_stmt *stmt;
 		{
 			raiseError("ReadingsAssetPurge", sqlite3_errmsg(dbHandle));
 			sqlite3_free(zErrMsg);
-			return 0;
+			return removed;
 		}
 		readCat->loadEmptyAssetReadingCatalogue();
 		// Get numbwer of affected rows
-                return (unsigned int)sqlite3_changes(dbHandle);
+		return removed + (unsigned int)sqlite3_changes(dbHandle);
 	}
 }
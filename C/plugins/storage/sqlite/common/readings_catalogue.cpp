@@ -33,7 +33,8 @@ using namespace rapidjson;
  * This is never explicitly called as the ReadingsCatalogue is a
  * singleton class.
  */
-ReadingsCatalogue::ReadingsCatalogue() : m_nextOverflow(1), m_maxOverflowUsed(0)
+ReadingsCatalogue::ReadingsCatalogue() : m_nextOverflow(1), m_maxOverflowUsed(0), m_generation(1),
+	m_partitionDb(false), m_partitionPending(false), m_reclaimPending(false), m_partitionThread(NULL), m_partitionShutdown(false)
 {
 }
 
@@ -273,6 +274,7 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 		string dbReadingsName = generateReadingsName(1, 1);
 
 		sql_cmd += " SELECT max(id) id FROM " READINGS_DB "." + dbReadingsName + " ";
+		firstRow = false;
 	}
 	else
 	{
@@ -292,18 +294,20 @@ int ReadingsCatalogue::calculateGlobalId (sqlite3 *dbHandle)
 				firstRow = false;
 			}
 		}
-		// Now add overflow tables
-		for (int i = 1; i <= m_maxOverflowUsed; i++)
+	}
+	// Now add overflow tables and time partitions
+	vector<tyReadingReference> sharedTables;
+	getSharedTables(sharedTables);
+	for (auto& table : sharedTables)
+	{
+		if (!firstRow)
 		{
-			if (!firstRow)
-			{
-				sql_cmd += " UNION ";
-			}
-			dbName = generateDbName(i);
-			dbReadingsName = generateReadingsName(i, 0);
-			sql_cmd += " SELECT max(id) id FROM " + dbName + "." + dbReadingsName + " ";
-			firstRow = false;
+			sql_cmd += " UNION ";
 		}
+		dbName = generateDbName(table.dbId);
+		dbReadingsName = generateReadingsName(table.dbId, table.tableId);
+		sql_cmd += " SELECT max(id) id FROM " + dbName + "." + dbReadingsName + " ";
+		firstRow = false;
 	}
 	sql_cmd += ") AS tb";
 
@@ -367,6 +371,7 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 			string dbReadingsName = generateReadingsName(1, 1);
 
 			sql_cmd += " SELECT min(id) id FROM " READINGS_DB "." + dbReadingsName + " ";
+			firstRow = false;
 		}
 		else
 		{
@@ -386,18 +391,20 @@ int ReadingsCatalogue::getMinGlobalId (sqlite3 *dbHandle)
 					firstRow = false;
 				}
 			}
-			// Now add overflow tables
-			for (int i = 1; i <= m_maxOverflowUsed; i++)
+		}
+		// Now add overflow tables and time partitions
+		vector<tyReadingReference> sharedTables;
+		getSharedTables(sharedTables);
+		for (auto& table : sharedTables)
+		{
+			if (!firstRow)
 			{
-				if (!firstRow)
-				{
-					sql_cmd += " UNION ";
-				}
-				dbName = generateDbName(i);
-				dbReadingsName = generateReadingsName(i, 0);
-				sql_cmd += " SELECT min(id) id FROM " + dbName + "." + dbReadingsName + " ";
-				firstRow = false;
+				sql_cmd += " UNION ";
 			}
+			dbName = generateDbName(table.dbId);
+			dbReadingsName = generateReadingsName(table.dbId, table.tableId);
+			sql_cmd += " SELECT min(id) id FROM " + dbName + "." + dbReadingsName + " ";
+			firstRow = false;
 		}
 		sql_cmd += ") AS tb";
 	}
@@ -622,6 +629,11 @@ void ReadingsCatalogue::getAllDbs(vector<int> &dbIdList)
 
 	Logger::getLogger()->debug("getAllDbs - created db");
 
+	if (m_partitionDb)
+	{
+		dbIdList.push_back(PARTITION_DB_ID);
+	}
+
 	for (auto &dbId : m_dbIdList) {
 
 		if (std::find(dbIdList.begin(), dbIdList.end(), dbId) ==  dbIdList.end() )
@@ -706,6 +718,7 @@ bool	result = true;
 char	*zErrMsg = NULL;
 
 	sqlCmd = "ATTACH DATABASE '" + path + "' AS " + alias + ";";
+	m_generation++;
 
 	Logger::getLogger()->debug("attachDb  - path '%s' alias '%s' cmd '%s'" , path.c_str(), alias.c_str() , sqlCmd.c_str() );
 	rc = SQLExec (dbHandle, sqlCmd.c_str(), &zErrMsg);
@@ -719,7 +732,10 @@ char	*zErrMsg = NULL;
 	// See if the overflow table exists and if not create it
 	// This is a workaround as the schema update mechanism can't cope
 	// with multiple readings tables
-	createReadingsOverflowTable(dbHandle, id);
+	if (id != PARTITION_DB_ID)
+	{
+		createReadingsOverflowTable(dbHandle, id);
+	}
 
 	return result;
 }
@@ -737,6 +753,7 @@ void ReadingsCatalogue::detachDb(sqlite3 *dbHandle, std::string &alias)
 	char *zErrMsg = nullptr;
 
 	sqlCmd = "DETACH  DATABASE " + alias + ";";
+	m_generation++;
 
 	Logger::getLogger()->debug("%s - db '%s' cmd '%s'" ,__FUNCTION__,  alias.c_str() , sqlCmd.c_str() );
 	rc = SQLExec (dbHandle, sqlCmd.c_str(), &zErrMsg);
@@ -918,6 +935,7 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 
 	m_storageConfigCurrent.nDbLeftFreeBeforeAllocate = storageConfig.nDbLeftFreeBeforeAllocate;
 	m_storageConfigCurrent.nDbToAllocate = storageConfig.nDbToAllocate;
+	m_storageConfigCurrent.partitionInterval = storageConfig.partitionInterval;
 
 	try
 	{
@@ -944,6 +962,8 @@ void ReadingsCatalogue::multipleReadingsInit(STORAGE_CONFIGURATION &storageConfi
 
 		preallocateReadingsTables(0);   // on the last database
 
+		preparePartitions(dbHandle);
+
 		evaluateGlobalId();
 		std::thread th(&ReadingsCatalogue::loadEmptyAssetReadingCatalogue,this,true);
 		th.detach();
@@ -1186,6 +1206,7 @@ void  ReadingsCatalogue::dropReadingsTables(sqlite3 *dbHandle, int dbId, int idS
 	Logger::getLogger()->debug("%s - dropping tales on database id %dform id %d to %d", __FUNCTION__, dbId, idStart, idEnd);
 
 	dbName = generateDbName(dbId);
+	m_generation++;
 
 	for (idx = idStart ; idx <= idEnd; ++idx)
 	{
@@ -2401,26 +2422,31 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 	string sqlCmdTmp;
 	string sqlCmd;
 	bool firstRow;
-	int rc;
+	int rc = SQLITE_OK;
+
+	PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
+	bool exclusions = purgeConfig->hasExclusions();
+
+	if  (rowsAffected != nullptr)
+		*rowsAffected = 0;
 
 	if (m_AssetReadingCatalogue.empty())
 	{
 		Logger::getLogger()->debug("purgeAllReadings: no tables defined");
-		rc = SQLITE_OK;
 	}
 	else
 	{
 		Logger::getLogger()->debug("purgeAllReadings tables defined");
 
-		PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
-		bool exclusions = purgeConfig->hasExclusions();
-
 		firstRow = true;
-		if  (rowsAffected != nullptr)
-			*rowsAffected = 0;
 
 		for (auto &item : m_AssetReadingCatalogue)
 		{
+			// The overflow tables are purged once below
+			if (item.second.getTable() == OVERFLOW_TABLE_ID)
+			{
+				continue;
+			}
 			if (exclusions && purgeConfig->isExcluded(item.first))
 			{
 				Logger::getLogger()->info("Asset %s excluded from purge", item.first.c_str());
@@ -2443,7 +2469,6 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 
 			if (rc != SQLITE_OK)
 			{
-				sqlite3_free(zErrMsg);
 				break;
 			}
 			if  (rowsAffected != nullptr) {
@@ -2454,6 +2479,66 @@ int  ReadingsCatalogue::purgeAllReadings(sqlite3 *dbHandle, const char *sqlCmdBa
 		}
 	}
 
+	if (rc == SQLITE_OK)
+	{
+		// The overflow tables and the time partitions hold the readings of
+		// many assets, the excluded assets are skipped by the SQL command
+		string exclude;
+		if (exclusions)
+		{
+			exclude = "asset_code NOT IN (";
+			bool first = true;
+			for (auto& asset : purgeConfig->getExclusions())
+			{
+				string quoted = asset;
+				StringReplaceAll(quoted, "'", "''");
+				if (!first)
+					exclude += ", ";
+				exclude += "'" + quoted + "'";
+				first = false;
+			}
+			exclude += ")";
+		}
+
+		vector<tyReadingReference> sharedTables;
+		getSharedTables(sharedTables);
+		for (auto& table : sharedTables)
+		{
+			sqlCmdTmp = sqlCmdBase;
+
+			StringReplaceAll (sqlCmdTmp, "_dbname_", generateDbName(table.dbId));
+			StringReplaceAll (sqlCmdTmp, "_tablename_", generateReadingsName(table.dbId, table.tableId));
+			if (!exclude.empty())
+			{
+				// Add the exclusion to the condition of the command
+				while (!sqlCmdTmp.empty() && (sqlCmdTmp.back() == ';' || isspace(sqlCmdTmp.back())))
+					sqlCmdTmp.pop_back();
+				if (sqlCmdTmp.find(" WHERE ") != string::npos)
+					sqlCmdTmp += " AND " + exclude;
+				else
+					sqlCmdTmp += " WHERE " + exclude;
+			}
+
+			rc = SQLExec(dbHandle, sqlCmdTmp.c_str(), zErrMsg);
+
+			Logger::getLogger()->debug("purgeAllReadings:  rc %d cmd '%s'", rc ,sqlCmdTmp.c_str() );
+
+			if (rc != SQLITE_OK)
+			{
+				break;
+			}
+			unsigned long changes = (unsigned long) sqlite3_changes(dbHandle);
+			if (table.dbId == PARTITION_DB_ID && changes > 0)
+			{
+				partitionRowsRemoved(table.tableId, changes);
+			}
+			if  (rowsAffected != nullptr)
+			{
+				*rowsAffected += changes;
+			}
+		}
+	}
+
 	std::thread th(&ReadingsCatalogue::loadEmptyAssetReadingCatalogue,this,false);
 	th.detach();
 	return(rc);
@@ -2567,8 +2652,8 @@ string  ReadingsCatalogue::sqlConstructMultiDb(string &sqlCmdBase, vector<string
 }
 
 /**
- * Add union all clauses for all the overflow tables based on tempalted SQL that is passed
- * in and a set of assets codes
+ * Add union all clauses for all the overflow tables and time partitions based on tempalted
+ * SQL that is passed in and a set of assets codes
  *
  * @param sqlCmdBase        Base Sql command
  * @param assetCodes        Asset codes to evaluate for the operation
@@ -2584,18 +2669,16 @@ string  ReadingsCatalogue::sqlConstructOverflow(string &sqlCmdBase, vector<strin
 	string sqlCmdTmp;
 	string sqlCmd;
 
-	string assetCode;
-	bool addTable;
-	bool addedOne;
-
-	for (int dbId = 1; dbId <= m_maxOverflowUsed; dbId++)
+	vector<tyReadingReference> sharedTables;
+	getSharedTables(sharedTables);
+	for (auto& table : sharedTables)
 	{
-		dbReadingsName = generateReadingsName(dbId, 0);
+		dbReadingsName = generateReadingsName(table.dbId, table.tableId);
 		sqlCmdTmp = sqlCmdBase;
 
 		sqlCmd += " UNION ALL ";
 
-		dbName = generateDbName(dbId);
+		dbName = generateDbName(table.dbId);
 
 		StringReplaceAll (sqlCmdTmp, ".assetcode.", "asset_code");
 		StringReplaceAll(sqlCmdTmp, "_dbname_", dbName);
@@ -2610,8 +2693,8 @@ string  ReadingsCatalogue::sqlConstructOverflow(string &sqlCmdBase, vector<strin
 				if (!first)
 				{
 					sqlCmd += " or ";
-					first = false;
 				}
+				first = false;
 				sqlCmd += "asset_code = \'";
 				sqlCmd += code;
 				sqlCmd += "\'";
@@ -2628,6 +2711,882 @@ string  ReadingsCatalogue::sqlConstructOverflow(string &sqlCmdBase, vector<strin
 }
 
 
+/**
+ * Record that a reading has been written to the table. The reading ids
+ * are allocated in increasing order, so the id of the newest reading is
+ * an upper bound of all the ids in the table even if the bound was not
+ * previously known.
+ *
+ * @param id	The id of the reading written to the table
+ */
+void TableReference::appended(unsigned long id)
+{
+	unsigned long maxId = m_maxId;
+	while ((maxId == UNKNOWN_MAX_ID || maxId < id) &&
+			!m_maxId.compare_exchange_weak(maxId, id))
+		;
+}
+
+/**
+ * Record that the table holds no committed readings from the given id.
+ * This is only used to set the bound when it is not already known, an
+ * append that races with the caller has either set the bound already or
+ * will raise it afterwards.
+ *
+ * @param id	The id from which the table has no readings
+ */
+void TableReference::noReadingsFrom(unsigned long id)
+{
+	unsigned long maxId = UNKNOWN_MAX_ID;
+	if (id > 0)
+	{
+		m_maxId.compare_exchange_strong(maxId, id - 1);
+	}
+}
+
+/**
+ * Return the readings tables currently assigned to an asset, the
+ * overflow tables are not included.
+ *
+ * @param tables	Populated with the asset code and table reference of each table
+ * @param minId		Omit the tables known to only hold readings before this id
+ */
+void ReadingsCatalogue::getAssetTables(vector<pair<string, tyReadingReference>> &tables, unsigned long minId)
+{
+	tables.clear();
+	for (auto &item : m_AssetReadingCatalogue)
+	{
+		if (item.second.getTable() == OVERFLOW_TABLE_ID || !item.second.mayHoldFrom(minId))
+		{
+			continue;
+		}
+		tyReadingReference ref;
+		ref.dbId = item.second.getDatabase();
+		ref.tableId = item.second.getTable();
+		tables.push_back(make_pair(item.first, ref));
+	}
+}
+
+/**
+ * Raise the upper bound of the reading ids held in the table of an asset.
+ * Called by the appends before the readings are committed, so that a
+ * fetch never omits a table that holds readings it can see.
+ *
+ * @param asset_code	The asset the readings were appended for
+ * @param maxId		The highest id of the readings appended
+ */
+void ReadingsCatalogue::readingsAppended(const string& asset_code, unsigned long maxId)
+{
+	auto item = m_AssetReadingCatalogue.find(asset_code);
+	if (item != m_AssetReadingCatalogue.end())
+	{
+		item->second.appended(maxId);
+	}
+}
+
+/**
+ * Record that the table of an asset has no committed readings from an id,
+ * the table is then omitted by getAssetTables for fetches from that id.
+ *
+ * @param asset_code	The asset code of the table
+ * @param id		The id from which the table has no readings
+ */
+void ReadingsCatalogue::noReadingsFrom(const string& asset_code, unsigned long id)
+{
+	auto item = m_AssetReadingCatalogue.find(asset_code);
+	if (item != m_AssetReadingCatalogue.end())
+	{
+		item->second.noReadingsFrom(id);
+	}
+}
+
+/**
+ * Return the tables that hold the readings of many assets, the overflow
+ * tables and the time partitions. The readings in these tables carry
+ * their asset code.
+ *
+ * @param tables	Populated with the table reference of each table
+ * @param minId		Omit the closed partitions that only hold readings before this id
+ */
+void ReadingsCatalogue::getSharedTables(vector<tyReadingReference> &tables, unsigned long minId)
+{
+	tables.clear();
+	for (int dbId = 1; dbId <= m_maxOverflowUsed; dbId++)
+	{
+		tyReadingReference ref;
+		ref.dbId = dbId;
+		ref.tableId = OVERFLOW_TABLE_ID;
+		tables.push_back(ref);
+	}
+
+	lock_guard<mutex> guard(m_partitionMutex);
+	for (auto& partition : m_partitions)
+	{
+		if (partition.closed && (partition.rows == 0 || partition.maxId < minId))
+		{
+			continue;
+		}
+		tyReadingReference ref;
+		ref.dbId = PARTITION_DB_ID;
+		ref.tableId = partition.id;
+		tables.push_back(ref);
+	}
+}
+
+/**
+ * Lookup the readings table allocated to an asset without allocating
+ * a table if the asset has none.
+ *
+ * @param asset_code	The asset code to lookup
+ * @param ref		Populated with the table reference if the asset has a table
+ * @return		True if the asset has a readings table
+ */
+bool ReadingsCatalogue::findReadingReference(const char *asset_code, tyReadingReference& ref)
+{
+	auto item = m_AssetReadingCatalogue.find(asset_code);
+	if (item == m_AssetReadingCatalogue.end())
+	{
+		return false;
+	}
+	ref.dbId = item->second.getDatabase();
+	ref.tableId = item->second.getTable();
+	return true;
+}
+
+/**
+ * Return the start of the partition interval that contains the given time
+ *
+ * @param when		The time
+ * @param interval	The partition interval in minutes
+ */
+static time_t partitionWindowStart(time_t when, int interval)
+{
+	time_t window = (time_t)interval * 60;
+	return when - (when % window);
+}
+
+/**
+ * Return the readings table to which new readings of an asset should be
+ * appended. If the readings are partitioned by time this is the current
+ * partition, otherwise it is the table allocated to the asset.
+ *
+ * The next partition is created ahead of time by the partition thread,
+ * the caller is inside a transaction and must not be delayed by the creation.
+ *
+ * @param connection	Db connection to be used for the operations
+ * @param asset_code	The asset code of the readings to append
+ * @return		The readings table to use
+ */
+ReadingsCatalogue::tyReadingReference ReadingsCatalogue::getAppendReference(Connection *connection, const char *asset_code)
+{
+	if (m_partitionDb && m_storageConfigCurrent.partitionInterval > 0)
+	{
+		tyReadingReference ref = {-1, -1};
+		bool createNext = false;
+		time_t now = time(0);
+		{
+			lock_guard<mutex> guard(m_partitionMutex);
+			for (auto it = m_partitions.rbegin(); it != m_partitions.rend(); ++it)
+			{
+				if (it->start <= now)
+				{
+					ref.dbId = PARTITION_DB_ID;
+					ref.tableId = it->id;
+					break;
+				}
+			}
+			if (m_partitionThread && !m_partitionPending &&
+					(m_partitions.empty() || m_partitions.back().start <= now))
+			{
+				m_partitionPending = true;
+				createNext = true;
+			}
+		}
+		if (createNext)
+		{
+			m_partitionCV.notify_all();
+		}
+		if (ref.tableId != -1)
+		{
+			return ref;
+		}
+	}
+	return getReadingReference(connection, asset_code);
+}
+
+/**
+ * Attach the database that holds the time partitions and load the
+ * partitions. The database is only created if a partition interval
+ * is configured, but is attached whenever it exists so that the
+ * readings in the partitions remain available until they are purged.
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @return		True if the partitions are ready for use
+ */
+bool ReadingsCatalogue::preparePartitions(sqlite3 *dbHandle)
+{
+	int interval = m_storageConfigCurrent.partitionInterval;
+	string dbPath = generateDbFilePah(PARTITION_DB_ID);
+	string dbAlias = generateDbAlias(PARTITION_DB_ID);
+	string dbName = generateDbName(PARTITION_DB_ID);
+	struct stat st;
+
+	if (stat(dbPath.c_str(), &st) != 0)
+	{
+		if (interval <= 0)
+		{
+			return true;
+		}
+		if (!createPartitionDatabase(dbPath))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		enableWAL(dbPath);
+	}
+	ConnectionManager *manager = ConnectionManager::getInstance();
+	if (!manager->attachNewDb(dbPath, dbAlias))
+	{
+		raiseError("preparePartitions", "Unable to attach the readings partition database");
+		return false;
+	}
+	m_partitionDb = true;
+	m_generation++;
+
+	string sqlCmd = "CREATE TABLE IF NOT EXISTS " + dbName + R"(.partitions (
+			id          INTEGER PRIMARY KEY,
+			start_ts    INTEGER NOT NULL,
+			max_id      INTEGER,
+			max_user_ts TEXT,
+			rows        INTEGER
+		);)";
+	if (SQLExec(dbHandle, sqlCmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("preparePartitions", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	sqlite3_stmt *stmt;
+	sqlCmd = "SELECT id, start_ts, max_id, max_user_ts, rows FROM " + dbName + ".partitions ORDER BY id;";
+	if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("preparePartitions", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		m_partitions.clear();
+		while (SQLStep(stmt) == SQLITE_ROW)
+		{
+			tyReadingsPartition partition;
+			partition.id = sqlite3_column_int(stmt, 0);
+			partition.start = (time_t)sqlite3_column_int64(stmt, 1);
+			partition.closed = sqlite3_column_type(stmt, 4) != SQLITE_NULL;
+			partition.maxId = (unsigned long)sqlite3_column_int64(stmt, 2);
+			const unsigned char *maxUserTs = sqlite3_column_text(stmt, 3);
+			partition.maxUserTs = maxUserTs ? (const char *)maxUserTs : "";
+			partition.rows = (unsigned long)sqlite3_column_int64(stmt, 4);
+			m_partitions.push_back(partition);
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	Logger::getLogger()->info("Readings partition database has %d partitions, partition interval %d minutes",
+			m_partitions.size(), interval);
+
+	if (interval > 0)
+	{
+		time_t start = partitionWindowStart(time(0), interval);
+		if ((m_partitions.empty() || m_partitions.back().start < start) &&
+				!createPartition(dbHandle, start))
+		{
+			return false;
+		}
+	}
+
+	// The thread also reclaims the space of dropped partitions, it is
+	// needed while there are partitions left to purge
+	lock_guard<mutex> guard(m_partitionMutex);
+	if (!m_partitionThread)
+	{
+		m_partitionShutdown = false;
+		m_partitionThread = new std::thread(&ReadingsCatalogue::partitionWorker, this);
+	}
+	return true;
+}
+
+/**
+ * Create the database that holds the time partitions. The database is
+ * set to allow the pages of dropped partitions to be reclaimed
+ * incrementally, which must be done before any table is created in it.
+ *
+ * @param dbPath	The path of the partition database
+ * @return		True if the database was created
+ */
+bool ReadingsCatalogue::createPartitionDatabase(string &dbPath)
+{
+	sqlite3 *dbHandle;
+	if (sqlite3_open(dbPath.c_str(), &dbHandle) != SQLITE_OK)
+	{
+		raiseError("createPartitionDatabase", sqlite3_errmsg(dbHandle));
+		sqlite3_close(dbHandle);
+		return false;
+	}
+
+	bool rval = true;
+	if (sqlite3_exec(dbHandle, "PRAGMA auto_vacuum = INCREMENTAL; " DB_CONFIGURATION, NULL, NULL, NULL) != SQLITE_OK)
+	{
+		raiseError("createPartitionDatabase", sqlite3_errmsg(dbHandle));
+		rval = false;
+	}
+	sqlite3_close(dbHandle);
+	return rval;
+}
+
+/**
+ * Create a new time partition that receives the readings from a given time.
+ * The partition has the same layout as an overflow table, without the
+ * autoincrement as the ids are allocated by the storage service.
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param start		The time from which readings are written to the partition
+ * @return		True if the partition was created
+ */
+bool ReadingsCatalogue::createPartition(sqlite3 *dbHandle, time_t start)
+{
+	int id;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		id = m_partitions.empty() ? 1 : m_partitions.back().id + 1;
+	}
+
+	string dbName = generateDbName(PARTITION_DB_ID);
+	string tableName = generateReadingsName(PARTITION_DB_ID, id);
+
+	string sqlCmd = "CREATE TABLE IF NOT EXISTS " + dbName + "." + tableName + R"( (
+			id         INTEGER                     PRIMARY KEY,
+			asset_code CHARACTER varying(50)       NOT NULL,
+			reading    JSON                        NOT NULL DEFAULT '{}',
+			user_ts    DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW')),
+			ts         DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW'))
+		);)";
+	sqlCmd += "CREATE INDEX IF NOT EXISTS " + dbName + "." + tableName + "_ix1 ON " + tableName + " (asset_code, user_ts desc);";
+	sqlCmd += "CREATE INDEX IF NOT EXISTS " + dbName + "." + tableName + "_ix3 ON " + tableName + " (user_ts);";
+	sqlCmd += "INSERT OR REPLACE INTO " + dbName + ".partitions (id, start_ts) VALUES (" +
+		to_string(id) + ", " + to_string((long)start) + ");";
+
+	if (SQLExec(dbHandle, sqlCmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("createPartition", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	tyReadingsPartition partition;
+	partition.id = id;
+	partition.start = start;
+	partition.closed = false;
+	partition.maxId = 0;
+	partition.rows = 0;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		m_partitions.push_back(partition);
+	}
+	// The queries of the connections must now include the partition
+	m_generation++;
+	Logger::getLogger()->info("Created readings partition %s", tableName.c_str());
+	return true;
+}
+
+/**
+ * The partition thread, creates the partition that follows the current
+ * one whenever getAppendReference finds the newest partition has started
+ * to receive readings.
+ *
+ * When idle the thread returns the pages of dropped partitions to the
+ * file system, a few at a time with a pause between each step, so that
+ * the appends to the partitions are not held back by a long vacuum.
+ */
+void ReadingsCatalogue::partitionWorker()
+{
+	unique_lock<mutex> lock(m_partitionMutex);
+	while (!m_partitionShutdown)
+	{
+		m_partitionCV.wait(lock, [this] { return m_partitionPending || m_reclaimPending || m_partitionShutdown; });
+		if (m_partitionShutdown)
+		{
+			break;
+		}
+		if (m_partitionPending)
+		{
+			lock.unlock();
+			createNextPartition();
+			lock.lock();
+			continue;
+		}
+
+		// A partition dropped during the step sets the flag again
+		m_reclaimPending = false;
+		lock.unlock();
+		bool more = reclaimPartitionSpace();
+		lock.lock();
+		if (more)
+		{
+			m_reclaimPending = true;
+			m_partitionCV.wait_for(lock, std::chrono::milliseconds(PARTITION_RECLAIM_PAUSE),
+					[this] { return m_partitionPending || m_partitionShutdown; });
+		}
+	}
+}
+
+/**
+ * Return a bounded number of the free pages of the partition database
+ * to the file system. Each step is a short transaction of its own.
+ *
+ * @return	True if free pages remain to be reclaimed
+ */
+bool ReadingsCatalogue::reclaimPartitionSpace()
+{
+	string dbName = generateDbName(PARTITION_DB_ID);
+	ConnectionManager *manager = ConnectionManager::getInstance();
+	Connection *connection = manager->allocate();
+#if TRACK_CONNECTION_USER
+	string usage = "Reclaim readings partition space";
+	connection->setUsage(usage);
+#endif
+	sqlite3 *dbHandle = connection->getDbHandle();
+
+	string sqlCmd = "PRAGMA " + dbName + ".incremental_vacuum(" + to_string(PARTITION_RECLAIM_PAGES) + ");";
+	bool more = false;
+	if (SQLExec(dbHandle, sqlCmd.c_str()) != SQLITE_OK)
+	{
+		Logger::getLogger()->warn("Unable to reclaim the space of dropped readings partitions: %s",
+				sqlite3_errmsg(dbHandle));
+	}
+	else
+	{
+		sqlite3_stmt *stmt;
+		sqlCmd = "PRAGMA " + dbName + ".freelist_count;";
+		if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) == SQLITE_OK)
+		{
+			if (SQLStep(stmt) == SQLITE_ROW)
+			{
+				more = sqlite3_column_int(stmt, 0) > 0;
+			}
+			sqlite3_finalize(stmt);
+		}
+	}
+	manager->release(connection);
+	return more;
+}
+
+/**
+ * Stop the partition thread, waiting for the creation of a partition
+ * that is in progress to complete
+ */
+void ReadingsCatalogue::shutdownPartitions()
+{
+	std::thread *thread;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		m_partitionShutdown = true;
+		thread = m_partitionThread;
+		m_partitionThread = NULL;
+	}
+	m_partitionCV.notify_all();
+	if (thread)
+	{
+		thread->join();
+		delete thread;
+	}
+}
+
+/**
+ * Create the partition that follows the current one. Called on the
+ * partition thread when the newest partition starts to receive readings.
+ */
+void ReadingsCatalogue::createNextPartition()
+{
+	int interval = m_storageConfigCurrent.partitionInterval;
+	time_t start = partitionWindowStart(time(0), interval);
+	bool create = true;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		if (!m_partitions.empty() && m_partitions.back().start >= start)
+		{
+			// The current interval has a partition, create the next one
+			start += (time_t)interval * 60;
+			create = m_partitions.back().start < start;
+		}
+	}
+
+	if (create)
+	{
+		ConnectionManager *manager = ConnectionManager::getInstance();
+		Connection *connection = manager->allocate();
+#if TRACK_CONNECTION_USER
+		string usage = "Create readings partition";
+		connection->setUsage(usage);
+#endif
+		createPartition(connection->getDbHandle(), start);
+		manager->release(connection);
+	}
+
+	lock_guard<mutex> guard(m_partitionMutex);
+	m_partitionPending = false;
+}
+
+/**
+ * Close the partitions that can no longer receive readings, recording
+ * the range of readings they hold. A partition is closed once the next
+ * partition has been receiving readings for a short time, so that any
+ * append that started before the switch to the next partition is complete.
+ *
+ * @param dbHandle	Database connection to use for the operations
+ */
+void ReadingsCatalogue::closePartitions(sqlite3 *dbHandle)
+{
+	int interval = m_storageConfigCurrent.partitionInterval;
+	time_t now = time(0);
+	vector<int> toClose;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		for (int i = 0; i < m_partitions.size(); i++)
+		{
+			if (m_partitions[i].closed)
+				continue;
+			if (interval <= 0 || (i + 1 < m_partitions.size() &&
+					now >= m_partitions[i + 1].start + PARTITION_CLOSE_DELAY))
+			{
+				toClose.push_back(m_partitions[i].id);
+			}
+		}
+	}
+
+	string dbName = generateDbName(PARTITION_DB_ID);
+	for (int id : toClose)
+	{
+		string tableName = dbName + "." + generateReadingsName(PARTITION_DB_ID, id);
+		string sqlCmd = "SELECT MAX(id), MAX(user_ts), COUNT(*) FROM " + tableName + ";";
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("closePartitions", sqlite3_errmsg(dbHandle));
+			return;
+		}
+		if (SQLStep(stmt) != SQLITE_ROW)
+		{
+			raiseError("closePartitions", sqlite3_errmsg(dbHandle));
+			sqlite3_finalize(stmt);
+			return;
+		}
+		unsigned long maxId = (unsigned long)sqlite3_column_int64(stmt, 0);
+		const unsigned char *text = sqlite3_column_text(stmt, 1);
+		string maxUserTs = text ? (const char *)text : "";
+		unsigned long rows = (unsigned long)sqlite3_column_int64(stmt, 2);
+		sqlite3_finalize(stmt);
+
+		sqlCmd = "UPDATE " + dbName + ".partitions SET max_id = ?, max_user_ts = ?, rows = ? WHERE id = ?;";
+		if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("closePartitions", sqlite3_errmsg(dbHandle));
+			return;
+		}
+		sqlite3_bind_int64(stmt, 1, maxId);
+		sqlite3_bind_text(stmt, 2, maxUserTs.c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int64(stmt, 3, rows);
+		sqlite3_bind_int(stmt, 4, id);
+		int rc = SQLStep(stmt);
+		sqlite3_finalize(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			raiseError("closePartitions", sqlite3_errmsg(dbHandle));
+			return;
+		}
+
+		lock_guard<mutex> guard(m_partitionMutex);
+		for (auto& partition : m_partitions)
+		{
+			if (partition.id == id)
+			{
+				partition.closed = true;
+				partition.maxId = maxId;
+				partition.maxUserTs = maxUserTs;
+				partition.rows = rows;
+			}
+		}
+		Logger::getLogger()->debug("Closed readings partition %d, %lu readings up to id %lu",
+				id, rows, maxId);
+	}
+}
+
+/**
+ * Account for readings that have been deleted from a partition
+ *
+ * @param partitionId	The partition the readings were deleted from
+ * @param rows		The number of readings deleted
+ */
+void ReadingsCatalogue::partitionRowsRemoved(int partitionId, unsigned long rows)
+{
+	lock_guard<mutex> guard(m_partitionMutex);
+	for (auto& partition : m_partitions)
+	{
+		if (partition.id == partitionId && partition.closed)
+		{
+			partition.rows = partition.rows > rows ? partition.rows - rows : 0;
+		}
+	}
+}
+
+/**
+ * Check if a partition holds readings of any of the assets that
+ * are excluded from purging
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param partitionId	The partition to check
+ * @return		True if the partition holds excluded readings
+ */
+bool ReadingsCatalogue::partitionHasExclusions(sqlite3 *dbHandle, int partitionId)
+{
+	PurgeConfiguration *purgeConfig = PurgeConfiguration::getInstance();
+	if (!purgeConfig->hasExclusions())
+	{
+		return false;
+	}
+
+	string sqlCmd = "SELECT 1 FROM " + generateDbName(PARTITION_DB_ID) + "." +
+		generateReadingsName(PARTITION_DB_ID, partitionId) + " WHERE asset_code = ? LIMIT 1;";
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("partitionHasExclusions", sqlite3_errmsg(dbHandle));
+		return true;
+	}
+	bool found = false;
+	for (auto& asset : purgeConfig->getExclusions())
+	{
+		sqlite3_bind_text(stmt, 1, asset.c_str(), -1, SQLITE_STATIC);
+		found = SQLStep(stmt) == SQLITE_ROW;
+		sqlite3_reset(stmt);
+		if (found)
+		{
+			break;
+		}
+	}
+	sqlite3_finalize(stmt);
+	return found;
+}
+
+/**
+ * Drop a partition and all the readings it holds
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param partitionId	The partition to drop
+ * @return		True if the partition was dropped
+ */
+bool ReadingsCatalogue::dropPartition(sqlite3 *dbHandle, int partitionId)
+{
+	string dbName = generateDbName(PARTITION_DB_ID);
+	string sqlCmd = "DROP TABLE IF EXISTS " + dbName + "." + generateReadingsName(PARTITION_DB_ID, partitionId) + ";";
+	sqlCmd += "DELETE FROM " + dbName + ".partitions WHERE id = " + to_string(partitionId) + ";";
+
+	// Drop the cached statements of the connections that refer to the partition
+	m_generation++;
+
+	if (SQLExec(dbHandle, sqlCmd.c_str()) != SQLITE_OK)
+	{
+		raiseError("dropPartition", sqlite3_errmsg(dbHandle));
+		return false;
+	}
+
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		for (auto it = m_partitions.begin(); it != m_partitions.end(); ++it)
+		{
+			if (it->id == partitionId)
+			{
+				m_partitions.erase(it);
+				break;
+			}
+		}
+		// The pages of the partition are returned to the file system by
+		// the partition thread rather than holding up the purge
+		m_reclaimPending = true;
+	}
+	m_partitionCV.notify_all();
+	Logger::getLogger()->info("Dropped readings partition %d", partitionId);
+	return true;
+}
+
+/**
+ * Drop the closed partitions in which all the readings are older than
+ * a given age.
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param age		The age in hours of the readings to purge
+ * @param retain	Retain the readings that have not been sent
+ * @param sent		The id of the last reading sent
+ * @param unsentPurged	Incremented by the number of unsent readings purged
+ * @return		The number of readings removed
+ */
+unsigned long ReadingsCatalogue::purgePartitionsByAge(sqlite3 *dbHandle, unsigned long age, bool retain,
+			unsigned long sent, unsigned long& unsentPurged)
+{
+	unsigned long removed = 0;
+
+	closePartitions(dbHandle);
+
+	string cutoff;
+	string sqlCmd = "SELECT datetime('now', '-" + to_string(age) + " hours');";
+	sqlite3_stmt *stmt;
+	if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		raiseError("purgePartitionsByAge", sqlite3_errmsg(dbHandle));
+		return 0;
+	}
+	if (SQLStep(stmt) == SQLITE_ROW)
+	{
+		cutoff = (const char *)sqlite3_column_text(stmt, 0);
+	}
+	sqlite3_finalize(stmt);
+	if (cutoff.empty())
+	{
+		return 0;
+	}
+
+	vector<tyReadingsPartition> partitions;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		partitions = m_partitions;
+	}
+	for (auto& partition : partitions)
+	{
+		if (!partition.closed || partition.maxUserTs.compare(cutoff) >= 0)
+		{
+			continue;
+		}
+		if (retain && partition.maxId > sent)
+		{
+			continue;
+		}
+		if (partitionHasExclusions(dbHandle, partition.id))
+		{
+			continue;
+		}
+		unsigned long unsent = 0;
+		if (sent != 0 && partition.maxId > sent)
+		{
+			sqlCmd = "SELECT COUNT(*) FROM " + generateDbName(PARTITION_DB_ID) + "." +
+				generateReadingsName(PARTITION_DB_ID, partition.id) + " WHERE id > " + to_string(sent) + ";";
+			if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) == SQLITE_OK)
+			{
+				if (SQLStep(stmt) == SQLITE_ROW)
+				{
+					unsent = (unsigned long)sqlite3_column_int64(stmt, 0);
+				}
+				sqlite3_finalize(stmt);
+			}
+		}
+		if (dropPartition(dbHandle, partition.id))
+		{
+			removed += partition.rows;
+			unsentPurged += unsent;
+		}
+	}
+	return removed;
+}
+
+/**
+ * Drop the oldest closed partitions while the readings that remain
+ * is at least a given number of readings.
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param rows		The number of readings to retain
+ * @param total		The number of readings currently stored
+ * @param retain	Retain the readings that have not been sent
+ * @param sent		The id of the last reading sent
+ * @param unsentPurged	Incremented by the number of unsent readings purged
+ * @return		The number of readings removed
+ */
+unsigned long ReadingsCatalogue::purgePartitionsByRows(sqlite3 *dbHandle, unsigned long rows, unsigned long total,
+			bool retain, unsigned long sent, unsigned long& unsentPurged)
+{
+	unsigned long removed = 0;
+
+	closePartitions(dbHandle);
+
+	vector<tyReadingsPartition> partitions;
+	{
+		lock_guard<mutex> guard(m_partitionMutex);
+		partitions = m_partitions;
+	}
+	for (auto& partition : partitions)
+	{
+		if (!partition.closed || total - removed < rows + partition.rows)
+		{
+			break;
+		}
+		if (retain && partition.maxId > sent)
+		{
+			break;
+		}
+		if (partitionHasExclusions(dbHandle, partition.id))
+		{
+			break;
+		}
+		if (!dropPartition(dbHandle, partition.id))
+		{
+			break;
+		}
+		removed += partition.rows;
+		if (!retain)
+		{
+			unsentPurged += partition.rows;
+		}
+	}
+	return removed;
+}
+
+/**
+ * Delete the readings of an asset from all the partitions
+ *
+ * @param dbHandle	Database connection to use for the operations
+ * @param asset		The asset code of the readings to delete
+ * @return		The number of readings deleted
+ */
+unsigned long ReadingsCatalogue::purgeAssetPartitions(sqlite3 *dbHandle, const string& asset)
+{
+	unsigned long removed = 0;
+
+	vector<tyReadingReference> tables;
+	getSharedTables(tables);
+	for (auto& table : tables)
+	{
+		if (table.dbId != PARTITION_DB_ID)
+		{
+			continue;
+		}
+		string sqlCmd = "DELETE FROM " + generateDbName(PARTITION_DB_ID) + "." +
+			generateReadingsName(PARTITION_DB_ID, table.tableId) + " WHERE asset_code = ?;";
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(dbHandle, sqlCmd.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			raiseError("purgeAssetPartitions", sqlite3_errmsg(dbHandle));
+			break;
+		}
+		sqlite3_bind_text(stmt, 1, asset.c_str(), -1, SQLITE_STATIC);
+		if (SQLStep(stmt) == SQLITE_DONE)
+		{
+			unsigned long changes = (unsigned long)sqlite3_changes(dbHandle);
+			partitionRowsRemoved(table.tableId, changes);
+			removed += changes;
+		}
+		sqlite3_finalize(stmt);
+	}
+	return removed;
+}
+
 /**
  * Generates a SQLite db alias from the database id
  *
@@ -0,0 +1,775 @@
+/*
+ * Fledge storage service - Readings rollups
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sqlite_common.h>
+#include <readings_rollup.h>
+#include <readings_catalogue.h>
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+#include <logger.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+using namespace std;
+using namespace rapidjson;
+
+ReadingsRollup *ReadingsRollup::m_instance = 0;
+
+/**
+ * Integer division that rounds towards minus infinity
+ */
+static long floorDiv(long value, long divisor)
+{
+	long q = value / divisor;
+	if ((value % divisor) != 0 && (value < 0))
+	{
+		q--;
+	}
+	return q;
+}
+
+/**
+ * Constructor for the readings rollups
+ */
+ReadingsRollup::ReadingsRollup() : m_enabled(false)
+{
+}
+
+/**
+ * Destructor for the readings rollups
+ */
+ReadingsRollup::~ReadingsRollup()
+{
+}
+
+/**
+ * Return the singleton instance of the ReadingsRollup class
+ * for this plugin
+ *
+ * @return ReadingsRollup* singleton instance
+ */
+ReadingsRollup *ReadingsRollup::getInstance()
+{
+	if (m_instance == 0)
+	{
+		m_instance = new ReadingsRollup();
+	}
+	return m_instance;
+}
+
+/**
+ * Create the rollup tables if the rollups are enabled. If they are
+ * disabled the tables are removed, as they are no longer maintained,
+ * and will be built afresh if the rollups are enabled again.
+ *
+ * @param dbHandle	Database connection to use
+ * @param enabled	True if the rollups should be maintained
+ * @return bool		True if the rollup tables were created or removed
+ */
+bool ReadingsRollup::init(sqlite3 *dbHandle, bool enabled)
+{
+	string sql;
+	long granules[] = { ROLLUP_MINUTE_GRANULE, ROLLUP_HOUR_GRANULE };
+
+	m_enabled = false;
+	m_assets.clear();
+	if (!enabled)
+	{
+		for (auto granule : granules)
+		{
+			sql += "DROP TABLE IF EXISTS " + tableName(granule) + ";";
+		}
+		sql += "DROP TABLE IF EXISTS " READINGS_DB ".rollup_valid;";
+		return execute(dbHandle, sql);
+	}
+
+	for (auto granule : granules)
+	{
+		sql += "CREATE TABLE IF NOT EXISTS " + tableName(granule) + R"( (
+				asset_code character varying(50) NOT NULL,
+				datapoint  TEXT NOT NULL,
+				granule    INTEGER NOT NULL,
+				readings   INTEGER NOT NULL,
+				total,
+				minimum,
+				maximum,
+				PRIMARY KEY (asset_code, datapoint, granule) ) WITHOUT ROWID;)";
+	}
+	sql += "CREATE TABLE IF NOT EXISTS " READINGS_DB R"(.rollup_valid (
+				asset_code character varying(50) PRIMARY KEY,
+				valid_from INTEGER NOT NULL );)";
+	sql += "INSERT OR IGNORE INTO " READINGS_DB ".rollup_valid VALUES ('" ROLLUP_ALL_ASSETS "', "
+		+ to_string(time(0)) + ");";
+	if (!execute(dbHandle, sql))
+	{
+		return false;
+	}
+	m_enabled = true;
+	Logger::getLogger()->info("Readings rollups are enabled");
+	return true;
+}
+
+/**
+ * Execute one or more SQL statements that return no data
+ *
+ * @param dbHandle	Database connection to use
+ * @param sql		The SQL to execute
+ * @return bool		True if the statements were executed
+ */
+bool ReadingsRollup::execute(sqlite3 *dbHandle, const string& sql)
+{
+	char *zErrMsg = NULL;
+
+	int rc = ReadingsCatalogue::getInstance()->SQLExec(dbHandle, sql.c_str(), &zErrMsg);
+	if (rc != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to execute '%s': %s",
+				sql.c_str(), zErrMsg ? zErrMsg : sqlite3_errmsg(dbHandle));
+		if (zErrMsg)
+		{
+			sqlite3_free(zErrMsg);
+		}
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Return the granule of the rollup that can answer a timebucket query
+ *
+ * @param bucketSize	The size of the timebucket in seconds
+ * @return long		The rollup granule in seconds or 0 if no rollup can be used
+ */
+long ReadingsRollup::granule(double bucketSize)
+{
+	if (bucketSize < 60 || fmod(bucketSize, 60.0) != 0.0)
+	{
+		return 0;
+	}
+	if (fmod(bucketSize, 3600.0) == 0.0)
+	{
+		return ROLLUP_HOUR_GRANULE;
+	}
+	return ROLLUP_MINUTE_GRANULE;
+}
+
+/**
+ * Return the qualified name of the rollup table for a granule
+ *
+ * @param granule	The granule of the rollup in seconds
+ * @return string	The table name
+ */
+string ReadingsRollup::tableName(long granule)
+{
+	return string(READINGS_DB) + ".rollup_" + to_string(granule);
+}
+
+/**
+ * Parse a timestamp of the form YYYY-MM-DD HH:MM:SS.ffffff+HH:MM into
+ * the number of seconds since the epoch. The fraction and the time zone
+ * are optional.
+ *
+ * @param timestamp	The timestamp to parse
+ * @param seconds	The whole seconds since the epoch
+ * @param fraction	Set if the timestamp has a non zero fraction of a second
+ * @return bool		True if the timestamp could be parsed
+ */
+bool ReadingsRollup::parseTimestamp(const char *timestamp, time_t& seconds, bool& fraction)
+{
+	struct tm tm;
+	int consumed = 0;
+	char sep;
+
+	memset(&tm, 0, sizeof(tm));
+	if (sscanf(timestamp, "%4d-%2d-%2d%c%2d:%2d:%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+			&sep, &tm.tm_hour, &tm.tm_min, &tm.tm_sec, &consumed) != 7
+			|| consumed == 0 || (sep != ' ' && sep != 'T'))
+	{
+		return false;
+	}
+	tm.tm_year -= 1900;
+	tm.tm_mon -= 1;
+	seconds = timegm(&tm);
+
+	const char *p = timestamp + consumed;
+	fraction = false;
+	if (*p == '.')
+	{
+		for (p++; isdigit(*p); p++)
+		{
+			if (*p != '0')
+			{
+				fraction = true;
+			}
+		}
+	}
+	if (*p == '+' || *p == '-')
+	{
+		int hours, minutes;
+		if (sscanf(p + 1, "%2d:%2d", &hours, &minutes) != 2)
+		{
+			return false;
+		}
+		long offset = hours * 3600 + minutes * 60;
+		seconds += (*p == '+') ? -offset : offset;
+		p += 6;
+	}
+	else if (*p == 'Z')
+	{
+		p++;
+	}
+	return *p == 0;
+}
+
+/**
+ * Add the value of a datapoint to the aggregates. Values are classified
+ * as SQLite would classify the values returned by json_each, booleans
+ * are integers and nested objects are compared as their JSON text.
+ *
+ * @param value	The value of the datapoint
+ */
+void ReadingsRollup::Aggregate::add(const rapidjson::Value& value)
+{
+	Value v;
+
+	if (value.IsNull())
+	{
+		return;
+	}
+	else if (value.IsBool())
+	{
+		v.type = SQLITE_INTEGER;
+		v.intValue = value.GetBool() ? 1 : 0;
+	}
+	else if (value.IsInt64())
+	{
+		v.type = SQLITE_INTEGER;
+		v.intValue = value.GetInt64();
+	}
+	else if (value.IsNumber())
+	{
+		v.type = SQLITE_FLOAT;
+		v.realValue = value.GetDouble();
+	}
+	else if (value.IsString())
+	{
+		v.type = SQLITE_TEXT;
+		v.text.assign(value.GetString(), value.GetStringLength());
+	}
+	else
+	{
+		StringBuffer buffer;
+		Writer<StringBuffer> writer(buffer);
+		value.Accept(writer);
+		v.type = SQLITE_TEXT;
+		v.text = buffer.GetString();
+	}
+
+	// Follow the rules of the SQLite sum, which remains an integer until
+	// a value that is not an integer is added
+	if (v.type == SQLITE_INTEGER)
+	{
+		intSum += v.intValue;
+	}
+	else
+	{
+		approx = true;
+		realSum += (v.type == SQLITE_FLOAT) ? v.realValue : strtod(v.text.c_str(), NULL);
+	}
+
+	if (count == 0 || v.compare(minimum) < 0)
+	{
+		minimum = v;
+	}
+	if (count == 0 || v.compare(maximum) > 0)
+	{
+		maximum = v;
+	}
+	count++;
+}
+
+/**
+ * Compare two values using the ordering of SQLite, numeric values
+ * sort before text values
+ *
+ * @param rhs	The value to compare with
+ * @return int	Negative, zero or positive as this value is less, equal or greater
+ */
+int ReadingsRollup::Aggregate::Value::compare(const Value& rhs) const
+{
+	bool numeric = type != SQLITE_TEXT;
+	bool rhsNumeric = rhs.type != SQLITE_TEXT;
+
+	if (numeric != rhsNumeric)
+	{
+		return numeric ? -1 : 1;
+	}
+	if (!numeric)
+	{
+		return text.compare(rhs.text);
+	}
+	if (type == SQLITE_INTEGER && rhs.type == SQLITE_INTEGER)
+	{
+		return (intValue < rhs.intValue) ? -1 : (intValue > rhs.intValue);
+	}
+	double l = (type == SQLITE_INTEGER) ? (double)intValue : realValue;
+	double r = (rhs.type == SQLITE_INTEGER) ? (double)rhs.intValue : rhs.realValue;
+	return (l < r) ? -1 : (l > r);
+}
+
+/**
+ * Bind the sum of the values to a statement parameter
+ *
+ * @param stmt	The statement
+ * @param col	The parameter index
+ */
+void ReadingsRollup::Aggregate::bindSum(sqlite3_stmt *stmt, int col) const
+{
+	if (approx)
+	{
+		sqlite3_bind_double(stmt, col, realSum + (double)intSum);
+	}
+	else
+	{
+		sqlite3_bind_int64(stmt, col, intSum);
+	}
+}
+
+/**
+ * Bind a value to a statement parameter
+ *
+ * @param stmt	The statement
+ * @param col	The parameter index
+ * @param value	The value to bind
+ */
+void ReadingsRollup::Aggregate::bindValue(sqlite3_stmt *stmt, int col, const Value& value) const
+{
+	switch (value.type)
+	{
+		case SQLITE_INTEGER:
+			sqlite3_bind_int64(stmt, col, value.intValue);
+			break;
+		case SQLITE_FLOAT:
+			sqlite3_bind_double(stmt, col, value.realValue);
+			break;
+		case SQLITE_TEXT:
+			sqlite3_bind_text(stmt, col, value.text.c_str(), value.text.length(), SQLITE_STATIC);
+			break;
+		default:
+			sqlite3_bind_null(stmt, col);
+			break;
+	}
+}
+
+/**
+ * Add the datapoints of a reading to the batch
+ *
+ * @param asset		The asset code of the reading
+ * @param userTs	The user timestamp of the reading
+ * @param reading	The reading object
+ * @return bool		False if the reading could not be added to the rollups
+ */
+bool ReadingsRollup::Batch::add(const char *asset, const char *userTs, const rapidjson::Value& reading)
+{
+	time_t seconds;
+	bool fraction;
+
+	if (!reading.IsObject() || !ReadingsRollup::parseTimestamp(userTs, seconds, fraction))
+	{
+		return false;
+	}
+	long granule = floorDiv(seconds, ROLLUP_MINUTE_GRANULE);
+	for (auto& dp : reading.GetObject())
+	{
+		m_aggregates[make_tuple(string(asset), string(dp.name.GetString()), granule)].add(dp.value);
+	}
+	return true;
+}
+
+/**
+ * Apply a batch of rollup changes. This is called within the transaction
+ * that appends the readings, any failure should cause that transaction to
+ * be rolled back.
+ *
+ * @param dbHandle	Database connection to use
+ * @param batch		The rollup changes
+ * @return bool		True if the rollups were updated
+ */
+bool ReadingsRollup::apply(sqlite3 *dbHandle, const Batch& batch)
+{
+	if (batch.empty())
+	{
+		return true;
+	}
+	return addAssets(dbHandle, batch)
+		&& applyTable(dbHandle, ROLLUP_MINUTE_GRANULE, batch)
+		&& applyTable(dbHandle, ROLLUP_HOUR_GRANULE, batch);
+}
+
+/**
+ * Create the validity entries of the assets in the batch that have not
+ * been seen before. They inherit the time the rollups were enabled.
+ *
+ * @param dbHandle	Database connection to use
+ * @param batch		The rollup changes
+ * @return bool		True if the entries were created
+ */
+bool ReadingsRollup::addAssets(sqlite3 *dbHandle, const Batch& batch)
+{
+	vector<string> assets;
+	{
+		lock_guard<mutex> guard(m_mutex);
+		for (auto& item : batch.m_aggregates)
+		{
+			const string& asset = get<0>(item.first);
+			if (m_assets.find(asset) == m_assets.end()
+					&& (assets.empty() || assets.back() != asset))
+			{
+				assets.push_back(asset);
+			}
+		}
+	}
+	if (assets.empty())
+	{
+		return true;
+	}
+
+	sqlite3_stmt *stmt;
+	string sql = "INSERT OR IGNORE INTO " READINGS_DB ".rollup_valid SELECT ?, valid_from FROM "
+		READINGS_DB ".rollup_valid WHERE asset_code = '" ROLLUP_ALL_ASSETS "';";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	bool ok = true;
+	for (auto& asset : assets)
+	{
+		sqlite3_bind_text(stmt, 1, asset.c_str(), -1, SQLITE_STATIC);
+		if (readCat->SQLStep(stmt) != SQLITE_DONE)
+		{
+			Logger::getLogger()->error("Readings rollups, failed to add asset '%s': %s",
+					asset.c_str(), sqlite3_errmsg(dbHandle));
+			ok = false;
+			break;
+		}
+		sqlite3_reset(stmt);
+	}
+	sqlite3_finalize(stmt);
+
+	if (ok)
+	{
+		lock_guard<mutex> guard(m_mutex);
+		m_assets.insert(assets.begin(), assets.end());
+	}
+	return ok;
+}
+
+/**
+ * Apply a batch of rollup changes to the rollup of a given granule
+ *
+ * @param dbHandle	Database connection to use
+ * @param granuleSize	The granule of the rollup in seconds
+ * @param batch		The rollup changes
+ * @return bool		True if the rollup was updated
+ */
+bool ReadingsRollup::applyTable(sqlite3 *dbHandle, long granuleSize, const Batch& batch)
+{
+	sqlite3_stmt *update, *insert;
+	string table = tableName(granuleSize);
+	string sql = "UPDATE " + table + " SET readings = readings + ?1, total = total + ?2, "
+			"minimum = min(minimum, ?3), maximum = max(maximum, ?4) "
+			"WHERE asset_code = ?5 AND datapoint = ?6 AND granule = ?7;";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &update, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	sql = "INSERT INTO " + table + " (readings, total, minimum, maximum, asset_code, datapoint, granule) "
+			"VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7);";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &insert, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		sqlite3_finalize(update);
+		return false;
+	}
+
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	long scale = granuleSize / ROLLUP_MINUTE_GRANULE;
+	bool ok = true;
+	for (auto& item : batch.m_aggregates)
+	{
+		const Aggregate& aggregate = item.second;
+		if (aggregate.count == 0)
+		{
+			continue;
+		}
+		const string& asset = get<0>(item.first);
+		const string& datapoint = get<1>(item.first);
+		long granule = floorDiv(get<2>(item.first), scale);
+
+		sqlite3_stmt *stmts[] = { update, insert };
+		for (auto stmt : stmts)
+		{
+			sqlite3_bind_int64(stmt, 1, aggregate.count);
+			aggregate.bindSum(stmt, 2);
+			aggregate.bindMin(stmt, 3);
+			aggregate.bindMax(stmt, 4);
+			sqlite3_bind_text(stmt, 5, asset.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_text(stmt, 6, datapoint.c_str(), -1, SQLITE_STATIC);
+			sqlite3_bind_int64(stmt, 7, granule);
+			int rc = readCat->SQLStep(stmt);
+			sqlite3_reset(stmt);
+			if (rc != SQLITE_DONE)
+			{
+				Logger::getLogger()->error("Readings rollups, failed to update %s for asset '%s': %s",
+						table.c_str(), asset.c_str(), sqlite3_errmsg(dbHandle));
+				ok = false;
+				break;
+			}
+			if (stmt == update && sqlite3_changes(dbHandle) > 0)
+			{
+				break;
+			}
+		}
+		if (!ok)
+		{
+			break;
+		}
+	}
+	sqlite3_finalize(update);
+	sqlite3_finalize(insert);
+	return ok;
+}
+
+/**
+ * Return the time from which the rollups hold every reading of a set
+ * of assets
+ *
+ * @param dbHandle	Database connection to use
+ * @param assets	The asset codes
+ * @param from		The time, in seconds since the epoch
+ * @return bool		False if the validity of the rollups could not be determined
+ */
+bool ReadingsRollup::validFrom(sqlite3 *dbHandle, const vector<string>& assets, time_t& from)
+{
+	sqlite3_stmt *stmt;
+	string sql = "SELECT asset_code, valid_from FROM " READINGS_DB ".rollup_valid WHERE asset_code IN (?";
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		sql += ", ?";
+	}
+	sql += ");";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		return false;
+	}
+	sqlite3_bind_text(stmt, 1, ROLLUP_ALL_ASSETS, -1, SQLITE_STATIC);
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		sqlite3_bind_text(stmt, i + 2, assets[i].c_str(), -1, SQLITE_STATIC);
+	}
+
+	bool all = false;
+	time_t allFrom = 0;
+	size_t found = 0;
+	from = 0;
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		time_t t = sqlite3_column_int64(stmt, 1);
+		if (strcmp((const char *)sqlite3_column_text(stmt, 0), ROLLUP_ALL_ASSETS) == 0)
+		{
+			all = true;
+			allFrom = t;
+		}
+		else
+		{
+			found++;
+			from = max(from, t);
+		}
+	}
+	sqlite3_finalize(stmt);
+
+	if (!all)
+	{
+		return false;
+	}
+	// Assets without a validity entry have had no readings since the rollups were enabled
+	if (found < assets.size())
+	{
+		from = max(from, allFrom);
+	}
+	return true;
+}
+
+/**
+ * Discard the rollups of an asset that only hold readings from before a
+ * given time and record that time as the start of the validity of the
+ * rollups of the asset
+ *
+ * @param dbHandle	Database connection to use
+ * @param asset		The asset code
+ * @param from		The time the rollups of the asset are valid from
+ * @return bool		True if the rollups were discarded
+ */
+bool ReadingsRollup::discardBefore(sqlite3 *dbHandle, const string& asset, time_t from)
+{
+	long granules[] = { ROLLUP_MINUTE_GRANULE, ROLLUP_HOUR_GRANULE };
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	vector<string> sqls;
+
+	sqls.push_back("INSERT OR REPLACE INTO " READINGS_DB ".rollup_valid VALUES (?1, ?2);");
+	for (auto granule : granules)
+	{
+		sqls.push_back("DELETE FROM " + tableName(granule) + " WHERE asset_code = ?1 AND granule < "
+				+ to_string(floorDiv(from, granule)) + ";");
+	}
+	for (auto& sql : sqls)
+	{
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+		{
+			Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+					sql.c_str(), sqlite3_errmsg(dbHandle));
+			return false;
+		}
+		sqlite3_bind_text(stmt, 1, asset.c_str(), -1, SQLITE_STATIC);
+		if (sqlite3_bind_parameter_count(stmt) > 1)
+		{
+			sqlite3_bind_int64(stmt, 2, from);
+		}
+		int rc = readCat->SQLStep(stmt);
+		sqlite3_finalize(stmt);
+		if (rc != SQLITE_DONE)
+		{
+			Logger::getLogger()->error("Readings rollups, failed to purge asset '%s': %s",
+					asset.c_str(), sqlite3_errmsg(dbHandle));
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Called after readings have been purged. The validity of the rollups
+ * of each asset is moved forward to the oldest remaining reading of the
+ * asset and the rollups before that time are discarded.
+ *
+ * @param dbHandle	Database connection to use
+ */
+void ReadingsRollup::purged(sqlite3 *dbHandle)
+{
+	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+	sqlite3_stmt *stmt;
+	map<string, time_t> validity;
+	map<string, time_t> oldest;
+
+	if (!m_enabled)
+	{
+		return;
+	}
+
+	string sql = "SELECT asset_code, valid_from FROM " READINGS_DB ".rollup_valid WHERE asset_code <> '"
+			ROLLUP_ALL_ASSETS "';";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		return;
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+	{
+		validity[(const char *)sqlite3_column_text(stmt, 0)] = sqlite3_column_int64(stmt, 1);
+	}
+	sqlite3_finalize(stmt);
+	if (validity.empty())
+	{
+		return;
+	}
+
+	// The oldest remaining reading of each asset
+	vector<string> assetCodes;
+	string sqlBase = " SELECT '_assetcode_' AS asset_code, MIN(user_ts) AS user_ts FROM _dbname_._tablename_ ";
+	string sqlOverflow = " SELECT asset_code, MIN(user_ts) AS user_ts FROM _dbname_._tablename_ ";
+	sql = "SELECT asset_code, MIN(user_ts) FROM (" + readCat->sqlConstructMultiDb(sqlBase, assetCodes)
+		+ readCat->sqlConstructOverflow(sqlOverflow, assetCodes, false, true)
+		+ ") WHERE user_ts IS NOT NULL GROUP BY asset_code;";
+	if (sqlite3_prepare_v2(dbHandle, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to prepare '%s': %s",
+				sql.c_str(), sqlite3_errmsg(dbHandle));
+		return;
+	}
+	int rc;
+	while ((rc = readCat->SQLStep(stmt)) == SQLITE_ROW)
+	{
+		time_t seconds;
+		bool fraction;
+		if (parseTimestamp((const char *)sqlite3_column_text(stmt, 1), seconds, fraction))
+		{
+			oldest[(const char *)sqlite3_column_text(stmt, 0)] = fraction ? seconds + 1 : seconds;
+		}
+	}
+	sqlite3_finalize(stmt);
+	if (rc != SQLITE_DONE)
+	{
+		Logger::getLogger()->error("Readings rollups, failed to find the oldest readings: %s",
+				sqlite3_errmsg(dbHandle));
+		return;
+	}
+
+	time_t now = time(0);
+	for (auto& item : validity)
+	{
+		auto it = oldest.find(item.first);
+		time_t from = (it == oldest.end()) ? now : it->second;
+		if (from > item.second)
+		{
+			discardBefore(dbHandle, item.first, from);
+		}
+	}
+}
+
+/**
+ * Called after the readings of an asset, or all the readings, have been
+ * purged. The rollups of the asset are discarded.
+ *
+ * @param dbHandle	Database connection to use
+ * @param asset		The asset code, or an empty string for all assets
+ */
+void ReadingsRollup::purgedAsset(sqlite3 *dbHandle, const string& asset)
+{
+	if (!m_enabled)
+	{
+		return;
+	}
+	time_t now = time(0);
+	if (!asset.empty())
+	{
+		if (discardBefore(dbHandle, asset, now))
+		{
+			lock_guard<mutex> guard(m_mutex);
+			m_assets.insert(asset);
+		}
+		return;
+	}
+
+	string sql = "DELETE FROM " + tableName(ROLLUP_MINUTE_GRANULE) + ";"
+		+ "DELETE FROM " + tableName(ROLLUP_HOUR_GRANULE) + ";"
+		+ "UPDATE " READINGS_DB ".rollup_valid SET valid_from = " + to_string(now)
+		+ " WHERE asset_code <> '" ROLLUP_ALL_ASSETS "';";
+	execute(dbHandle, sql);
+}
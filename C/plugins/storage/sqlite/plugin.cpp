@@ -27,6 +27,7 @@
 #include <config_category.h>
 #include <readings_catalogue.h>
 #include <purge_configuration.h>
+#include <readings_rollup.h>
 #include <string_utils.h>
 
 using namespace std;
@@ -97,6 +98,29 @@ const char *default_config = QUOTE({
 			"default" : "6",
 			"displayName" : "Vacuum Interval",
 			"order" : "7"
+		},
+		"readingFormat" : {
+			"description" : "The format in which the datapoints of each reading are stored. Binary is more compact and quicker to store and fetch, readings with values that have no binary form are stored as JSON",
+			"type" : "enumeration",
+			"options" : [ "JSON", "Binary" ],
+			"default" : "JSON",
+			"displayName" : "Reading Format",
+			"order" : "8"
+		},
+		"partitionInterval" : {
+			"description" : "The number of minutes of readings to hold in each time partition. Purging drops whole partitions rather than deleting readings one by one. A value of 0 disables partitioning",
+			"type" : "integer",
+			"default" : "0",
+			"minimum" : "0",
+			"displayName" : "Partition Interval (minutes)",
+			"order" : "9"
+		},
+		"rollups" : {
+			"description" : "Maintain per minute and per hour rollups of the readings as they are appended. Timebucket queries with a bucket size that is a multiple of a minute are answered from the rollups",
+			"type" : "boolean",
+			"default" : "false",
+			"displayName" : "Readings Rollups",
+			"order" : "10"
 		}
 
 });
@@ -107,7 +131,7 @@ const char *default_config = QUOTE({
 static PLUGIN_INFORMATION info = {
 	"SQLite3",                // Name
 	"1.2.0",                  // Version
-	SP_COMMON|SP_READINGS,    // Flags
+	SP_COMMON|SP_READINGS|SP_BINARY_STREAM,    // Flags
 	PLUGIN_TYPE_STORAGE,      // Type
 	"1.6.0",                  // Interface version
 	default_config
@@ -160,9 +184,22 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 		storageConfig.nDbToAllocate = strtol(category->getValue("nDbToAllocate").c_str(), NULL, 10);
 	}
 
+	if (category->itemExists("partitionInterval"))
+	{
+		storageConfig.partitionInterval = strtol(category->getValue("partitionInterval").c_str(), NULL, 10);
+	}
+
 	ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
 	readCat->multipleReadingsInit(storageConfig);
 
+	if (category->itemExists("rollups"))
+	{
+		Connection *connection = manager->allocate();
+		ReadingsRollup::getInstance()->init(connection->getDbHandle(),
+				category->getValue("rollups").compare("true") == 0);
+		manager->release(connection);
+	}
+
 	if (category->itemExists("purgeExclude"))
 	{
 		string exclusions = category->getValue("purgeExclude");
@@ -181,6 +218,11 @@ PLUGIN_HANDLE plugin_init(ConfigCategory *category)
 		manager->setVacuumInterval(strtol(category->getValue("vacuumInterval").c_str(), NULL, 10));
 	}
 
+	if (category->itemExists("readingFormat"))
+	{
+		manager->setBinaryReadings(category->getValue("readingFormat").compare("Binary") == 0);
+	}
+
 	return manager;
 }
 
@@ -314,6 +356,36 @@ std::string	  resultSet;
 	return strdup(resultSet.c_str());
 }
 
+/**
+ * Fetch a block of readings from the readings buffer in binary form,
+ * the result is returned in a malloc'd buffer and its length in length
+ */
+char *plugin_reading_fetch_binary(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize, size_t *length)
+{
+ConnectionManager *manager = (ConnectionManager *)handle;
+Connection        *connection = manager->allocate();
+std::string	  resultSet;
+
+#if TRACK_CONNECTION_USER
+	string usage = "Fetch readings binary";
+	connection->setUsage(usage);
+#endif
+
+	if (!connection->fetchReadingsBinary(id, blksize, resultSet))
+	{
+		manager->release(connection);
+		return NULL;
+	}
+	manager->release(connection);
+	char *result = (char *)malloc(resultSet.length());
+	if (result)
+	{
+		memcpy(result, resultSet.data(), resultSet.length());
+		*length = resultSet.length();
+	}
+	return result;
+}
+
 /**
  * Retrieve some readings from the readings buffer
  */
@@ -356,6 +428,7 @@ unsigned long	  age, size;
 		age = param;
 		(void)connection->purgeReadings(age, flags, sent, results);
 	}
+	ReadingsRollup::getInstance()->purged(connection->getDbHandle());
 	manager->release(connection);
 	return strdup(results.c_str());
 }
@@ -397,6 +470,7 @@ ConnectionManager *manager = (ConnectionManager *)handle;
 		connection->shutdownAppendReadings();
 
 		ReadingsCatalogue *readCat = ReadingsCatalogue::getInstance();
+		readCat->shutdownPartitions();
 		readCat->storeGlobalId();
 	}
 	manager->release(connection);
@@ -546,6 +620,7 @@ Connection        *connection = manager->allocate();
 	connection->setUsage(usage);
 #endif
 	unsigned int deleted = connection->purgeReadingsAsset(asset);
+	ReadingsRollup::getInstance()->purgedAsset(connection->getDbHandle(), asset);
 	manager->release(connection);
 	return deleted;
 }
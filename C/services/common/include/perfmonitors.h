@@ -14,20 +14,67 @@
 #include <unordered_map>
 #include <insert.h>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
+/*
+ * Values below PERFMON_SUB_BUCKETS are counted exactly, above that each
+ * power of two is divided into PERFMON_SUB_BUCKETS buckets, giving a
+ * relative error of no more than 1 in PERFMON_SUB_BUCKETS. Values beyond
+ * the range of the last bucket are counted in it.
+ */
+#define PERFMON_SUB_BUCKET_BITS	5
+#define PERFMON_SUB_BUCKETS	(1 << PERFMON_SUB_BUCKET_BITS)
+#define PERFMON_MAX_SHIFT	31
+#define PERFMON_BUCKETS		((PERFMON_MAX_SHIFT + 2) * PERFMON_SUB_BUCKETS)
+
+/*
+ * The number of histograms a monitor spreads the threads that record
+ * values across, so that threads rarely update the same counters
+ */
+#define PERFMON_STRIPES		8
+
+/**
+ * A log-linear histogram of the values recorded for a performance
+ * monitor in the current collection period. Values are recorded with
+ * atomic operations only, and the histogram is drained by the
+ * thread that writes the monitors.
+ */
+class PerfHistogram {
+	public:
+		PerfHistogram();
+		void		record(long value);
+		long		drain(uint64_t *counts, long& sum, long& min, long& max);
+		static unsigned int
+				bucket(long value);
+		static long	bucketValue(unsigned int bucket);
+	private:
+		std::atomic<uint64_t>	m_counts[PERFMON_BUCKETS];
+		std::atomic<long>	m_samples;
+		std::atomic<long>	m_sum;
+		std::atomic<long>	m_min;
+		std::atomic<long>	m_max;
+};
+
+/**
+ * An individual performance monitor. The minimum, maximum, average and
+ * percentiles of the values collected are reported at the end of each
+ * collection period.
+ */
 class PerfMon {
 	public:
 		PerfMon(const std::string& name);
+		~PerfMon();
 		void		addValue(long value);
 		int		getValues(InsertValues& values);
+		const std::string&
+				getName() const { return m_name; };
+	private:
+		PerfHistogram	*getHistogram();
 	private:
 		std::string	m_name;
-		long		m_average;
-		long		m_min;
-		long		m_max;
-		int		m_samples;
-		std::mutex	m_mutex;
+		std::atomic<PerfHistogram *>
+				m_stripes[PERFMON_STRIPES];
 };
 /**
  * Class to handle the performance monitors
@@ -49,6 +96,22 @@ class PerformanceMonitor {
 							doCollection(name, value);
 						}
 					};
+					/**
+					 * Collect a performance monitor using the
+					 * monitor returned by getMonitor, avoiding
+					 * the lookup of the monitor by name
+					 *
+					 * @param monitor	The monitor
+					 * @param value		Value of the monitor
+					 */
+		inline void		collect(PerfMon *monitor, long value)
+					{
+						if (m_collecting)
+						{
+							monitor->addValue(value);
+						}
+					};
+		PerfMon			*getMonitor(const std::string& name);
 		void			setCollecting(bool state);
 		void			writeThread();
 	private:
@@ -60,6 +123,7 @@ class PerformanceMonitor {
 		bool			m_collecting;
 		std::unordered_map<std::string, PerfMon *>
 					m_monitors;
+		std::mutex		m_monitorsMutex;
 		std::condition_variable m_cv;
 		std::mutex		m_mutex;
 };
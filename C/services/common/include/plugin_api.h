@@ -97,6 +97,10 @@ typedef enum controlDestination {
 #define SP_BUILTIN		0x0100
 /** The plugin supports control data */
 #define SP_CONTROL		0x1000
+/** The storage plugin accepts binary datapoint payloads in reading streams */
+#define SP_BINARY_STREAM	0x2000
+/** The north plugin records performance monitors of its own */
+#define SP_PERFMON		0x4000
 
 /**
  * Plugin types
@@ -9,16 +9,165 @@
  */
 #include <perfmonitors.h>
 #include <chrono>
+#include <climits>
+#include <cmath>
 
 using namespace std;
 
+/**
+ * The percentiles reported for each monitor and the columns
+ * of the monitors table they are written to
+ */
+static const struct {
+	const char	*column;
+	double		fraction;
+} percentiles[] = {
+	{ "p50", 0.5 },
+	{ "p90", 0.9 },
+	{ "p99", 0.99 },
+	{ "p999", 0.999 }
+};
+
+static atomic<unsigned int> nextStripe(0);
+
+/**
+ * Return the histogram stripe used by the calling thread. Each thread
+ * is allocated a stripe the first time it records a value.
+ */
+static unsigned int threadStripe()
+{
+	static thread_local unsigned int stripe = nextStripe++ % PERFMON_STRIPES;
+	return stripe;
+}
+
+/**
+ * Constructor for an empty histogram
+ */
+PerfHistogram::PerfHistogram() : m_samples(0), m_sum(0), m_min(LONG_MAX), m_max(LONG_MIN)
+{
+	for (int i = 0; i < PERFMON_BUCKETS; i++)
+		m_counts[i].store(0, memory_order_relaxed);
+}
+
+/**
+ * Return the bucket a value is counted in. Negative values are
+ * counted in the first bucket.
+ *
+ * @param value	The value
+ * @return unsigned int	The bucket index
+ */
+unsigned int PerfHistogram::bucket(long value)
+{
+	if (value < PERFMON_SUB_BUCKETS)
+		return value < 0 ? 0 : (unsigned int)value;
+	unsigned int msb = 63 - __builtin_clzl((unsigned long)value);
+	unsigned int shift = msb - PERFMON_SUB_BUCKET_BITS;
+	if (shift > PERFMON_MAX_SHIFT)
+		return PERFMON_BUCKETS - 1;
+	unsigned int mantissa = (unsigned int)(value >> shift);
+	return (shift + 1) * PERFMON_SUB_BUCKETS + (mantissa - PERFMON_SUB_BUCKETS);
+}
+
+/**
+ * Return the highest value that is counted in a bucket
+ *
+ * @param bucket	The bucket index
+ * @return long		The highest value of the bucket
+ */
+long PerfHistogram::bucketValue(unsigned int bucket)
+{
+	if (bucket < PERFMON_SUB_BUCKETS)
+		return bucket;
+	unsigned int shift = bucket / PERFMON_SUB_BUCKETS - 1;
+	long mantissa = PERFMON_SUB_BUCKETS + bucket % PERFMON_SUB_BUCKETS;
+	return ((mantissa + 1) << shift) - 1;
+}
+
+/**
+ * Record a value in the histogram
+ *
+ * @param value	The value to record
+ */
+void PerfHistogram::record(long value)
+{
+	m_counts[bucket(value)].fetch_add(1, memory_order_relaxed);
+	m_sum.fetch_add(value, memory_order_relaxed);
+	long current = m_min.load(memory_order_relaxed);
+	while (value < current && !m_min.compare_exchange_weak(current, value, memory_order_relaxed))
+		;
+	current = m_max.load(memory_order_relaxed);
+	while (value > current && !m_max.compare_exchange_weak(current, value, memory_order_relaxed))
+		;
+	m_samples.fetch_add(1, memory_order_relaxed);
+}
+
+/**
+ * Add the content of the histogram to the counts, sum, minimum and
+ * maximum passed in and reset the histogram for the next period
+ *
+ * @param counts	The per bucket counts to add to
+ * @param sum		The sum of the values to add to
+ * @param min		The minimum value to update
+ * @param max		The maximum value to update
+ * @return long		The number of samples that were in the histogram
+ */
+long PerfHistogram::drain(uint64_t *counts, long& sum, long& min, long& max)
+{
+	long samples = m_samples.exchange(0, memory_order_relaxed);
+	if (samples == 0)
+		return 0;
+	for (int i = 0; i < PERFMON_BUCKETS; i++)
+	{
+		if (m_counts[i].load(memory_order_relaxed))
+			counts[i] += m_counts[i].exchange(0, memory_order_relaxed);
+	}
+	sum += m_sum.exchange(0, memory_order_relaxed);
+	long value = m_min.exchange(LONG_MAX, memory_order_relaxed);
+	if (value < min)
+		min = value;
+	value = m_max.exchange(LONG_MIN, memory_order_relaxed);
+	if (value > max)
+		max = value;
+	return samples;
+}
+
 /**
  * Constructor for an individual performance monitor
  *
  * @param name	The name of the performance monitor
  */
-PerfMon::PerfMon(const string& name) : m_name(name), m_samples(0)
+PerfMon::PerfMon(const string& name) : m_name(name)
+{
+	for (int i = 0; i < PERFMON_STRIPES; i++)
+		m_stripes[i].store(NULL);
+}
+
+/**
+ * Destructor for an individual performance monitor
+ */
+PerfMon::~PerfMon()
+{
+	for (int i = 0; i < PERFMON_STRIPES; i++)
+		delete m_stripes[i].load();
+}
+
+/**
+ * Return the histogram the calling thread records values in,
+ * creating it if this is the first thread to use the stripe
+ */
+PerfHistogram *PerfMon::getHistogram()
 {
+	atomic<PerfHistogram *>& stripe = m_stripes[threadStripe()];
+	PerfHistogram *histogram = stripe.load(memory_order_acquire);
+	if (histogram == NULL)
+	{
+		PerfHistogram *created = new PerfHistogram();
+		if (stripe.compare_exchange_strong(histogram, created, memory_order_acq_rel))
+			histogram = created;
+		else
+			delete created;	// Another thread created it first
+	}
+	return histogram;
 }
 
 /**
@@ -28,44 +177,60 @@ PerfMon::PerfMon(const string& name) : m_name(name), m_samples(0)
  */
 void PerfMon::addValue(long value)
 {
-	lock_guard<mutex> guard(m_mutex);
-	if (m_samples)
-	{
-		if (value < m_min)
-			m_min = value;
-		else if (value > m_max)
-			m_max = value;
-		m_average = ((m_samples * m_average) + value) / (m_samples + 1);
-		m_samples++;
-	}
-	else
-	{
-		m_min = value;
-		m_max = value;
-		m_average = value;
-		m_samples = 1;
-	}
+	getHistogram()->record(value);
 }
 
 /**
- * Return the performance values to insert
+ * Return the performance values to insert and reset the
+ * monitor for the next collection period
  *
+ * @param values	The values to add the columns to
+ * @return int		The number of samples collected
  */
 int PerfMon::getValues(InsertValues& values)
 {
-	lock_guard<mutex> guard(m_mutex);
-	if (m_samples == 0)
+	vector<uint64_t> counts(PERFMON_BUCKETS, 0);
+	long samples = 0, sum = 0, min = LONG_MAX, max = LONG_MIN;
+	for (int i = 0; i < PERFMON_STRIPES; i++)
+	{
+		PerfHistogram *histogram = m_stripes[i].load(memory_order_acquire);
+		if (histogram)
+			samples += histogram->drain(counts.data(), sum, min, max);
+	}
+	if (samples == 0)
 		return 0;
-	values.push_back(InsertValue("minimum", m_min));
-	values.push_back(InsertValue("maximum", m_max));
-	values.push_back(InsertValue("average", m_average));
-	values.push_back(InsertValue("samples", m_samples));
-	m_min = 0;
-	m_max = 0;
-	m_average = 0;
-	int samples = m_samples;
-	m_samples = 0;
-	return samples;
+	values.push_back(InsertValue("minimum", min));
+	values.push_back(InsertValue("maximum", max));
+	values.push_back(InsertValue("average", (long)llround((double)sum / samples)));
+	values.push_back(InsertValue("samples", samples));
+
+	// Values recorded while draining may be in the counts but not samples
+	uint64_t total = 0;
+	for (auto count : counts)
+		total += count;
+	for (auto& percentile : percentiles)
+	{
+		uint64_t rank = (uint64_t)ceil(percentile.fraction * total);
+		if (rank == 0)
+			rank = 1;
+		uint64_t seen = 0;
+		long value = max;
+		for (unsigned int i = 0; i < PERFMON_BUCKETS; i++)
+		{
+			seen += counts[i];
+			if (seen >= rank)
+			{
+				value = PerfHistogram::bucketValue(i);
+				break;
+			}
+		}
+		if (value > max)
+			value = max;
+		if (value < min)
+			value = min;
+		values.push_back(InsertValue(percentile.column, value));
+	}
+	return (int)samples;
 }
 
 /**
@@ -75,7 +240,7 @@ int PerfMon::getValues(InsertValues& values)
  * @param storage	Point to the storage client class for the service
  */
 PerformanceMonitor::PerformanceMonitor(const string& service, StorageClient *storage) :
-	m_service(service), m_storage(storage), m_collecting(false), m_thread(NULL)
+	m_service(service), m_storage(storage), m_thread(NULL), m_collecting(false)
 {
 }
 
@@ -139,19 +304,30 @@ void PerformanceMonitor::setCollecting(bool state)
  */
 void PerformanceMonitor::doCollection(const string& name, long value)
 {
-	PerfMon *mon;
+	getMonitor(name)->addValue(value);
+}
+
+/**
+ * Return the named performance monitor, creating it if it does
+ * not exist. The monitor remains valid for the lifetime of the
+ * performance monitors and may be passed to collect in place
+ * of the name to avoid the lookup of the name for each value.
+ *
+ * @param name	The name of the performance monitor
+ * @return PerfMon*	The performance monitor
+ */
+PerfMon *PerformanceMonitor::getMonitor(const string& name)
+{
+	lock_guard<mutex> guard(m_monitorsMutex);
 	auto it = m_monitors.find(name);
-	if (it == m_monitors.end())
-	{
-		// Create a new monitor
-		mon = new PerfMon(name);
-		m_monitors[name] = mon;
-	}
-	else
+	if (it != m_monitors.end())
 	{
-		mon = it->second;
+		return it->second;
 	}
-	mon->addValue(value);
+	// Create a new monitor
+	PerfMon *mon = new PerfMon(name);
+	m_monitors[name] = mon;
+	return mon;
 }
 
 /**
@@ -166,15 +342,21 @@ void PerformanceMonitor::writeThread()
 		if (m_collecting)
 		{
 			// Write to the database
-			for (const auto& it : m_monitors)
+			vector<PerfMon *> monitors;
+			{
+				lock_guard<mutex> guard(m_monitorsMutex);
+				for (const auto& it : m_monitors)
+				{
+					monitors.push_back(it.second);
+				}
+			}
+			for (auto mon : monitors)
 			{
-				string name = it.first;
-				PerfMon *mon = it.second;
 				InsertValues values;
 			       	if (mon->getValues(values) > 0)
 				{
 					values.push_back(InsertValue("service", m_service));
-					values.push_back(InsertValue("monitor", name));
+					values.push_back(InsertValue("monitor", mon->getName()));
 					m_storage->insertTable("monitors", values);
 				}
 			}
@@ -29,6 +29,7 @@ DataLoad::DataLoad(const string& name, long streamId, StorageClient *storage) :
 	m_readRequest(0), m_dataSource(SourceReadings), m_pipeline(NULL), m_perfMonitor(NULL)
 {
 	m_blockSize = DEFAULT_BLOCK_SIZE;
+	m_pipelineDepth = DEFAULT_PIPELINE_DEPTH;
 
 	if (m_streamId == 0)
 	{
@@ -62,7 +63,7 @@ DataLoad::~DataLoad()
 	unique_lock<mutex> lck(m_qMutex);	// Should not need to do this
 	while (! m_queue.empty())
 	{
-		ReadingSet *readings = m_queue.front();
+		ReadingSet *readings = m_queue.front().first;
 		delete readings;
 		m_queue.pop_front();
 	}
@@ -111,6 +112,11 @@ bool DataLoad::setDataSource(const string& source)
 
 /**
  * The background thread that loads data from the database
+ *
+ * Blocks are read and passed through the filter pipeline ahead of
+ * the block being sent, until the pipeline depth has been reached.
+ * A block counts towards the depth while it is in the ingest call of
+ * the filter pipeline.
  */
 void DataLoad::loadThread()
 {
@@ -118,9 +124,27 @@ void DataLoad::loadThread()
 	{
 		unsigned int block = waitForReadRequest();
 		readBlock(block);
+
+		unique_lock<mutex> lck(m_qMutex);
+		if (m_pipelineBlocks.readAhead(m_queue.size(), m_pipelineDepth))
+		{
+			triggerRead(m_blockSize);
+		}
 	}
 }
 
+/**
+ * Set the number of blocks to read and filter ahead of the block
+ * being sent
+ *
+ * @param depth	The pipeline depth
+ */
+void DataLoad::setPipelineDepth(unsigned int depth)
+{
+	lock_guard<mutex> guard(m_qMutex);
+	m_pipelineDepth = depth;
+}
+
 /**
  * Wait for a read request to be made
  *
@@ -160,13 +184,14 @@ void DataLoad::readBlock(unsigned int blockSize)
 	do
 	{
 		ReadingSet* readings = nullptr;
+		auto start = chrono::steady_clock::now();
 		try
 		{
 			switch (m_dataSource)
 			{
 				case SourceReadings:
 					// Logger::getLogger()->debug("Fetch %d readings from %d", blockSize, m_lastFetched + 1);
-					readings = m_storage->readingFetch(m_lastFetched + 1, blockSize);
+					readings = m_storage->readingFetch(m_lastFetched + 1, blockSize, FETCH_WAIT_TIME);
 					break;
 				case SourceStatistics:
 					readings = fetchStatistics(blockSize);
@@ -195,12 +220,14 @@ void DataLoad::readBlock(unsigned int blockSize)
 		{
 			Logger::getLogger()->debug("DataLoad::readBlock(): Got %d readings from storage client", readings->getCount());
 			m_lastFetched = readings->getLastId();
-			bufferReadings(readings);
 			if (m_perfMonitor)
 			{
-				m_perfMonitor->collect("No of waits for data", n_waits);
-				m_perfMonitor->collect("Block utilisation %", (readings->getCount() * 100) / blockSize);
+				m_perfMonitor->collect(m_waitsMon, n_waits);
+				m_perfMonitor->collect(m_utilisationMon, (readings->getCount() * 100) / blockSize);
+				m_perfMonitor->collect(m_fetchTimeMon,
+					chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
 			}
+			bufferReadings(readings);
 			return;
 		}
 		else if (readings)
@@ -214,8 +241,15 @@ void DataLoad::readBlock(unsigned int blockSize)
 		}
 		if (!m_shutdown)
 		{
-			// TODO improve this
-			this_thread::sleep_for(chrono::milliseconds(250));
+			// The storage service waits for new readings before returning
+			// an empty block, only poll if it returned without waiting.
+			// Statistics and audit data, a failed fetch or an older storage
+			// service that does not support waiting will all return early.
+			auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+			if (elapsed.count() < FETCH_WAIT_TIME / 2)
+			{
+				this_thread::sleep_for(chrono::milliseconds(FETCH_POLL_TIME));
+			}
 			n_waits++;
 		}
 	} while (m_shutdown == false);
@@ -348,20 +382,34 @@ void DataLoad::bufferReadings(ReadingSet *readings)
 				std::this_thread::sleep_for(std::chrono::milliseconds(150));
 			}
 			// Pass readingSet to filter chain
+			auto start = chrono::steady_clock::now();
+			{
+				lock_guard<mutex> guard(m_qMutex);
+				m_pipelineBlocks.ingest(readings->getLastId());
+			}
 			firstFilter->ingest(readings);
+			{
+				lock_guard<mutex> guard(m_qMutex);
+				m_pipelineBlocks.ingested();
+			}
+			if (m_perfMonitor)
+			{
+				m_perfMonitor->collect(m_filterTimeMon,
+					chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+			}
 			return;
 		}
 	}
 	unique_lock<mutex> lck(m_qMutex);
-	m_queue.push_back(readings);
+	m_queue.push_back(make_pair(readings, readings->getLastId()));
 	if (m_perfMonitor)
 	{
-		m_perfMonitor->collect("Readings added to buffer", readings->getCount());
-		m_perfMonitor->collect("Reading sets buffered", m_queue.size());
+		m_perfMonitor->collect(m_addedMon, readings->getCount());
+		m_perfMonitor->collect(m_setsBufferedMon, m_queue.size());
 		long i = 0;
 		for (auto& set : m_queue)
-			i += set->getCount();
-		m_perfMonitor->collect("Total readings buffered", i);
+			i += set.first->getCount();
+		m_perfMonitor->collect(m_readingsBufferedMon, i);
 	}
 	Logger::getLogger()->debug("Buffered %d readings for north processing", readings->getCount());
 	m_fetchCV.notify_all();
@@ -370,10 +418,15 @@ void DataLoad::bufferReadings(ReadingSet *readings)
 /**
  * Fetch Readings
  *
+ * The last reading id fetched from the storage service for the block may
+ * be greater than the last id in the block if the filter pipeline has
+ * removed readings.
+ *
  * @param wait		Boolean to determine if the call should block the calling thread
+ * @param lastFetched	If not NULL set to the last reading id fetched for the block
  * @return ReadingSet*	Return a block of readings from the buffer
  */
-ReadingSet *DataLoad::fetchReadings(bool wait)
+ReadingSet *DataLoad::fetchReadings(bool wait, unsigned long *lastFetched)
 {
 	unique_lock<mutex> lck(m_qMutex);
 	while (m_queue.empty())
@@ -388,9 +441,17 @@ ReadingSet *DataLoad::fetchReadings(bool wait)
 			return NULL;
 		}
 	}
-	ReadingSet *rval = m_queue.front();
+	ReadingSet *rval = m_queue.front().first;
+	if (lastFetched)
+	{
+		*lastFetched = m_queue.front().second;
+	}
 	m_queue.pop_front();
-	if (m_queue.size() < 5)	// Read another block if we have less than 5 already queued
+	if (m_perfMonitor)
+	{
+		m_perfMonitor->collect(m_blocksQueuedMon, (long)m_queue.size());
+	}
+	if (m_pipelineBlocks.readAhead(m_queue.size(), m_pipelineDepth))	// Read another block if the pipeline is not full
 	{
 		triggerRead(m_blockSize);
 	}
@@ -550,13 +611,17 @@ void DataLoad::pipelineEnd(OUTPUT_HANDLE *outHandle,
 {
 
 	DataLoad *load = (DataLoad *)outHandle;
-	if (readingSet->getCount() == 0)	// Special case when all filtered out
-	{
-		load->updateLastSentId(load->m_lastFetched);
-	}
 
 	unique_lock<mutex> lck(load->m_qMutex);
-	load->m_queue.push_back(readingSet);
+
+	// Filters may hold readings back and pass them on with a later
+	// block, the last sent id is taken from the readings that come out
+	bool loadThread = this_thread::get_id() == load->m_thread->get_id();
+	unsigned long lastId = load->m_pipelineBlocks.outputLastId(readingSet->getLastId(), loadThread);
+
+	// A block that has been completely filtered out is still queued so
+	// that the data sender updates the last sent id in order
+	load->m_queue.push_back(make_pair(readingSet, lastId));
 	load->m_fetchCV.notify_all();
 }
 
@@ -11,6 +11,7 @@
 #include <data_load.h>
 #include <north_service.h>
 #include <reading.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -25,18 +26,36 @@ static void startSenderThread(void *data)
 	sender->sendThread();
 }
 
+/**
+ * Start the thread that updates the last sent id and statistics
+ *
+ * @param data	The instance of the class DataSender
+ */
+static void startUpdateThread(void *data)
+{
+	DataSender *sender = (DataSender *)data;
+	sender->updateThread();
+}
+
 /**
  * Constructor for the data sending class
+ *
+ * @param plugin	The north plugin
+ * @param loader	The data loader the blocks are taken from
+ * @param service	The north service
  */
 DataSender::DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *service) :
-	m_plugin(plugin), m_loader(loader), m_service(service), m_shutdown(false), m_paused(false), m_perfMonitor(NULL)
+	m_plugin(plugin), m_loader(loader), m_service(service), m_shutdown(false), m_paused(false),
+	m_sending(false), m_perfMonitor(NULL), m_updateShutdown(false), m_lastSentId(0),
+	m_pipelineDepth(DEFAULT_PIPELINE_DEPTH)
 {
 	m_logger = Logger::getLogger();
 
 	/*
-	 * Fianlly start the thread. Everything mus tbe initialsied
-	 * before the thread is started
+	 * Fianlly start the threads. Everything mus tbe initialsied
+	 * before the threads are started
 	 */
+	m_updateThread = new thread(startUpdateThread, this);
 	m_thread = new thread(startSenderThread, this);
 }
 
@@ -46,24 +65,54 @@ DataSender::DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *serv
 DataSender::~DataSender()
 {
 	m_logger->info("DataSender shutdown in progress");
-	m_shutdown = true;
+	{
+		lock_guard<mutex> guard(m_sentMutex);
+		m_shutdown = true;
+	}
+	m_sentCV.notify_all();
 	m_thread->join();
 	delete m_thread;
+
+	// Flush the updates for the blocks already sent
+	{
+		lock_guard<mutex> guard(m_sentMutex);
+		m_updateShutdown = true;
+	}
+	m_sentCV.notify_all();
+	m_updateThread->join();
+	delete m_updateThread;
 	m_logger->info("DataSender shutdown complete");
 }
 
+/**
+ * Set the number of blocks that may be taken from the loader before
+ * the update thread has recorded them as sent
+ *
+ * @param depth	The pipeline depth
+ */
+void DataSender::setPipelineDepth(unsigned int depth)
+{
+	{
+		lock_guard<mutex> guard(m_sentMutex);
+		m_pipelineDepth = depth;
+	}
+	m_sentCV.notify_all();
+}
+
 /**
  * The sending thread entry point
  */
 void DataSender::sendThread()
 {
 	ReadingSet *readings = nullptr;
+	unsigned long block = 0;
+	unsigned long lastFetched = 0;
 
 	while (!m_shutdown)
 	{
 		if (readings == NULL) {
 
-			readings = m_loader->fetchReadings(true);
+			readings = fetchBlock(block, lastFetched);
 		}
 		if (!readings)
 		{
@@ -74,11 +123,9 @@ void DataSender::sendThread()
 		bool removeReadings = false;
 		if (readings->getCount() > 0)
 		{
-			unsigned long lastSent = send(readings);
+			unsigned long lastSent = send(readings, block, lastFetched);
 			if (lastSent)
 			{
-				m_loader->updateLastSentId(lastSent);
-
 				// Check all readings sent
 				vector<Reading *> *vec = readings->getAllReadingsPtr();
 
@@ -89,11 +136,8 @@ void DataSender::sendThread()
 			// All readings filtered out
 			Logger::getLogger()->debug("All readings filtered out");
 
-			// Get last read item from the readings database
-			unsigned long lastRead = m_loader->getLastFetched();
-
-			// Update LastSentId in streams table
-			m_loader->updateLastSentId(lastRead);
+			// Update LastSentId in streams table with the last reading read for this block
+			blockSent(block, lastFetched, 0, true);
 
 			// Set readings removal
 			removeReadings = true;
@@ -114,44 +158,96 @@ void DataSender::sendThread()
 	m_logger->info("Sending thread shutdown");
 }
 
+/**
+ * Fetch the next block to send from the loader. Blocks if the update
+ * thread has not yet moved past as many blocks as the pipeline depth.
+ *
+ * @param block		Set to the sequence number of the block
+ * @param lastFetched	Set to the last reading id fetched for the block
+ * @return ReadingSet*	The block or NULL if the loader is shutting down
+ */
+ReadingSet *DataSender::fetchBlock(unsigned long& block, unsigned long& lastFetched)
+{
+	{
+		unique_lock<mutex> lck(m_sentMutex);
+		m_sentCV.wait(lck, [this]{
+				return m_shutdown || m_sentBlocks.outstanding() < m_pipelineDepth; });
+		if (m_shutdown)
+		{
+			return NULL;
+		}
+	}
+	ReadingSet *readings = m_loader->fetchReadings(true, &lastFetched);
+	if (readings)
+	{
+		lock_guard<mutex> guard(m_sentMutex);
+		block = m_sentBlocks.issue();
+	}
+	return readings;
+}
+
 /**
  * Send a block of readings
  *
+ * The update of the last sent id and the statistics is queued for the
+ * update thread, so that the next block can be sent without waiting
+ * for the storage service.
+ *
  * @param readings	The readings to send
+ * @param block		The sequence number of the block
+ * @param lastFetched	The last reading id fetched from storage for the block
  * @return long		The ID of the last reading sent
  */
-unsigned long DataSender::send(ReadingSet *readings)
+unsigned long DataSender::send(ReadingSet *readings, unsigned long block, unsigned long lastFetched)
 {
 	blockPause();
 	uint32_t to_send = readings->getCount();
+	auto start = chrono::steady_clock::now();
 	uint32_t sent = m_plugin->send(readings->getAllReadings());
+	auto end = chrono::steady_clock::now();
 	releasePause();
-	unsigned long lastSent = readings->getReadingId(sent);
 	if (m_perfMonitor)
 	{
-		m_perfMonitor->collect("Readings sent", sent);
-		m_perfMonitor->collect("Percentage readings sent", (100 * sent) / to_send);
+		m_perfMonitor->collect(m_sentMon, sent);
+		m_perfMonitor->collect(m_percentSentMon, (100 * sent) / to_send);
+		m_perfMonitor->collect(m_sendTimeMon,
+				chrono::duration_cast<chrono::milliseconds>(end - start).count());
 	}
 
 	if (sent > 0)
 	{
-		lastSent = readings->getLastId();
+		unsigned long lastSent;
+		if (sent < to_send)
+		{
+			// Only part of the block was sent, the remainder will be retried
+			lastSent = (*readings)[sent - 1]->getId();
+		}
+		else
+		{
+			// Include any readings removed from the end of the block by filters
+			lastSent = max(readings->getLastId(), lastFetched);
+		}
 
 		// Update asset tracker table/cache, if required
 		vector<Reading *> *vec = readings->getAllReadingsPtr();
 
+		string lastAsset;
 		for (vector<Reading *>::iterator it = vec->begin(); it != vec->end(); )
 		{
 			Reading *reading = *it;
 
 			if (reading->getId() <= lastSent)
 			{
-
-				AssetTrackingTuple tuple(m_service->getName(), m_service->getPluginName(), reading->getAssetName(), "Egress");
-				if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
+				// Consecutive readings of the same asset are only checked once
+				if (lastAsset.compare(reading->getAssetName()))
 				{
-					AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
-					m_logger->info("sendDataThread:  Adding new asset tracking tuple - egress: %s", tuple.assetToString().c_str());
+					AssetTrackingTuple tuple(m_service->getName(), m_service->getPluginName(), reading->getAssetName(), "Egress");
+					if (!AssetTracker::getAssetTracker()->checkAssetTrackingCache(tuple))
+					{
+						AssetTracker::getAssetTracker()->addAssetTrackingTuple(tuple);
+						m_logger->info("sendDataThread:  Adding new asset tracking tuple - egress: %s", tuple.assetToString().c_str());
+					}
+					lastAsset = reading->getAssetName();
 				}
 
 				// Remove current reading
@@ -166,12 +262,74 @@ unsigned long DataSender::send(ReadingSet *readings)
 				break;
 			}
 		}
-		m_loader->updateStatistics(sent);
+		blockSent(block, lastSent, sent, sent == to_send);
 		return lastSent;
 	}
 	return 0;
 }
 
+/**
+ * Record that some or all of a block has been sent, or that a block
+ * has been completely removed by the filters, for the update thread
+ *
+ * @param block		The sequence number of the block
+ * @param lastId	The id of the last reading sent
+ * @param sent		The number of readings sent
+ * @param complete	All of the block has been sent
+ */
+void DataSender::blockSent(unsigned long block, unsigned long lastId, uint32_t sent, bool complete)
+{
+	{
+		lock_guard<mutex> guard(m_sentMutex);
+		m_sentBlocks.progress(block, lastId, sent, complete);
+	}
+	m_sentCV.notify_all();
+}
+
+/**
+ * The update thread entry point
+ *
+ * Update the last sent id in the streams table and the sent statistics
+ * for the blocks the sending thread has sent. All the blocks sent since
+ * the last update are combined into a single update. The last sent id
+ * only moves past a block once all the blocks before it have been sent.
+ */
+void DataSender::updateThread()
+{
+	while (true)
+	{
+		unique_lock<mutex> lck(m_sentMutex);
+		m_sentCV.wait(lck, [this]{ return m_updateShutdown || m_sentBlocks.pending(); });
+		if (!m_sentBlocks.pending())
+		{
+			break;
+		}
+		uint32_t sent = 0;
+		unsigned long lastId = m_sentBlocks.collect(sent);
+		size_t depth = m_sentBlocks.outstanding();
+		lck.unlock();
+		m_sentCV.notify_all();
+
+		auto start = chrono::steady_clock::now();
+		if (lastId > m_lastSentId)
+		{
+			m_loader->updateLastSentId(lastId);
+			m_lastSentId = lastId;
+		}
+		if (sent)
+		{
+			m_loader->updateStatistics(sent);
+		}
+		if (m_perfMonitor)
+		{
+			m_perfMonitor->collect(m_updateQueueMon, (long)depth);
+			m_perfMonitor->collect(m_updateTimeMon,
+				chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+		}
+	}
+	m_logger->info("Update thread shutdown");
+}
+
 /**
  * Cause the data sender process to pause sending data until a corresponding release call is made.
  *
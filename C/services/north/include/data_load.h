@@ -11,8 +11,13 @@
 #include <filter_pipeline.h>
 #include <service_handler.h>
 #include <perfmonitors.h>
+#include <pipeline_blocks.h>
 
 #define DEFAULT_BLOCK_SIZE 100
+#define DEFAULT_PIPELINE_DEPTH 5	// Number of blocks to read ahead of the block being sent
+
+#define FETCH_WAIT_TIME	500	// Time in milliseconds the storage service may wait for new readings
+#define FETCH_POLL_TIME	250	// Time in milliseconds to sleep between polls for data
 
 /**
  * A class used in the North service to load data from the buffer
@@ -31,7 +36,7 @@ class DataLoad : public ServiceHandler {
 		bool			setDataSource(const std::string& source);
 		void			triggerRead(unsigned int blockSize);
 		void			updateLastSentId(unsigned long id);
-		ReadingSet		*fetchReadings(bool wait);
+		ReadingSet		*fetchReadings(bool wait, unsigned long *lastFetched = NULL);
 		void			updateStatistics(uint32_t increment);
 		static void		passToOnwardFilter(OUTPUT_HANDLE *outHandle,
 						READINGSET* readings);
@@ -48,7 +53,19 @@ class DataLoad : public ServiceHandler {
 					{
 						m_blockSize = blockSize;
 					};
-		void			setPerfMonitor(PerformanceMonitor *perfMonitor) { m_perfMonitor = perfMonitor; };
+		void			setPipelineDepth(unsigned int depth);
+		void			setPerfMonitor(PerformanceMonitor *perfMonitor)
+						{
+							m_perfMonitor = perfMonitor;
+							m_waitsMon = perfMonitor->getMonitor("No of waits for data");
+							m_utilisationMon = perfMonitor->getMonitor("Block utilisation %");
+							m_fetchTimeMon = perfMonitor->getMonitor("Fetch time (ms)");
+							m_filterTimeMon = perfMonitor->getMonitor("Filter time (ms)");
+							m_addedMon = perfMonitor->getMonitor("Readings added to buffer");
+							m_setsBufferedMon = perfMonitor->getMonitor("Reading sets buffered");
+							m_readingsBufferedMon = perfMonitor->getMonitor("Total readings buffered");
+							m_blocksQueuedMon = perfMonitor->getMonitor("Blocks queued for sending");
+						};
 
 	private:
 		void			readBlock(unsigned int blockSize);
@@ -73,12 +90,22 @@ class DataLoad : public ServiceHandler {
 		enum { SourceReadings, SourceStatistics, SourceAudit }
 					m_dataSource;
 		unsigned long		m_lastFetched;
-		std::deque<ReadingSet *>
-					m_queue;
+		std::deque<std::pair<ReadingSet *, unsigned long> >
+					m_queue;	// Blocks to send and the last reading id fetched for each
+		PipelineBlocks		m_pipelineBlocks;	// Blocks in the filter pipeline, guarded by m_qMutex
 		std::mutex		m_qMutex;
 		FilterPipeline		*m_pipeline;
 		std::mutex		m_pipelineMutex;
 		unsigned long		m_blockSize;
+		unsigned int		m_pipelineDepth;	// Guarded by m_qMutex
 		PerformanceMonitor	*m_perfMonitor;
+		PerfMon			*m_waitsMon;
+		PerfMon			*m_utilisationMon;
+		PerfMon			*m_fetchTimeMon;
+		PerfMon			*m_filterTimeMon;
+		PerfMon			*m_addedMon;
+		PerfMon			*m_setsBufferedMon;
+		PerfMon			*m_readingsBufferedMon;
+		PerfMon			*m_blocksQueuedMon;
 };
 #endif
@@ -8,6 +8,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <perfmonitors.h>
+#include <sent_blocks.h>
 
 class DataLoad;
 class NorthService;
@@ -17,12 +18,24 @@ class DataSender {
 		DataSender(NorthPlugin *plugin, DataLoad *loader, NorthService *north);
 		~DataSender();
 		void			sendThread();
+		void			updateThread();
 		void			updatePlugin(NorthPlugin *plugin) { m_plugin = plugin; };
 		void			pause();
 		void			release();
-		void			setPerfMonitor(PerformanceMonitor *perfMonitor) { m_perfMonitor = perfMonitor; };
+		void			setPerfMonitor(PerformanceMonitor *perfMonitor)
+						{
+							m_perfMonitor = perfMonitor;
+							m_sentMon = perfMonitor->getMonitor("Readings sent");
+							m_percentSentMon = perfMonitor->getMonitor("Percentage readings sent");
+							m_sendTimeMon = perfMonitor->getMonitor("Send time (ms)");
+							m_updateQueueMon = perfMonitor->getMonitor("Sent update queue length");
+							m_updateTimeMon = perfMonitor->getMonitor("Sent update time (ms)");
+						};
+		void			setPipelineDepth(unsigned int depth);
 	private:
-		unsigned long		send(ReadingSet *readings);
+		ReadingSet		*fetchBlock(unsigned long& block, unsigned long& lastFetched);
+		unsigned long		send(ReadingSet *readings, unsigned long block, unsigned long lastFetched);
+		void			blockSent(unsigned long block, unsigned long lastId, uint32_t sent, bool complete);
 		void			blockPause();
 		void			releasePause();
 	private:
@@ -37,6 +50,17 @@ class DataSender {
 		std::mutex		m_pauseMutex;
 		std::condition_variable m_pauseCV;
 		PerformanceMonitor	*m_perfMonitor;
-
+		PerfMon			*m_sentMon;
+		PerfMon			*m_percentSentMon;
+		PerfMon			*m_sendTimeMon;
+		PerfMon			*m_updateQueueMon;
+		PerfMon			*m_updateTimeMon;
+		std::thread		*m_updateThread;
+		bool			m_updateShutdown;
+		SentBlocks		m_sentBlocks;	// Blocks taken from the loader that the update thread has not moved past
+		std::mutex		m_sentMutex;	// Guards m_sentBlocks, m_updateShutdown and m_pipelineDepth
+		std::condition_variable m_sentCV;
+		unsigned long		m_lastSentId;	// Last sent id written to the streams table
+		unsigned int		m_pipelineDepth;
 };
 #endif
@@ -16,6 +16,8 @@
 #include <string>
 #include <reading.h>
 
+class PerformanceMonitor;
+
 typedef void (*INGEST_CB)(void *, Reading);
 typedef void (*INGEST_CB2)(void *, std::vector<Reading *>*);
 
@@ -46,6 +48,8 @@ public:
 	bool		hasControl() { return info->options & SP_CONTROL; };
 	void		pluginRegister(bool ( *write)(char *name, char *value, ControlDestination destination, ...),
 				int (* operation)(char *operation, int paramCount, char *names[], char *parameters[], ControlDestination destination, ...));
+	bool		hasPerfMonitor() { return info->options & SP_PERFMON; };
+	void		pluginPerfMonitor(PerformanceMonitor *perfMonitor);
 
 private:
 	PLUGIN_HANDLE	m_instance;
@@ -60,6 +64,7 @@ private:
 	void		(*pluginRegisterPtr)(PLUGIN_HANDLE handle,
 				bool ( *write)(char *name, char *value, ControlDestination destination, ...),
 				int (* operation)(char *operation, int paramCount, char *names[], char *parameters[], ControlDestination destination, ...));
+	void		(*pluginPerfMonitorPtr)(PLUGIN_HANDLE handle, PerformanceMonitor *perfMonitor);
 	
 };
 
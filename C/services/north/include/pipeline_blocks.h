@@ -0,0 +1,42 @@
+#ifndef _PIPELINE_BLOCKS_H
+#define _PIPELINE_BLOCKS_H
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <cstddef>
+
+/**
+ * Account for the blocks of readings the data loader passes through the
+ * filter pipeline, so that the loader reads ahead of the block being
+ * sent without overfilling its queue.
+ *
+ * A block counts towards the read ahead depth until the ingest call of
+ * the pipeline for the block returns, however many blocks come out of
+ * the pipeline. A filter may absorb a block, hold it back to pass it on
+ * with a later block or split it into several blocks. Readings held by a
+ * filter once the ingest call has returned are not counted.
+ *
+ * The class is not thread safe, the caller must hold a lock.
+ */
+class PipelineBlocks {
+	public:
+		PipelineBlocks() : m_ingesting(0), m_lastFetched(0) {};
+		void		ingest(unsigned long lastFetched);
+		void		ingested();
+		unsigned long	outputLastId(unsigned long lastId, bool loadThread) const;
+		bool		readAhead(size_t queued, unsigned int depth) const;
+		/**
+		 * The number of pipeline ingest calls in progress
+		 */
+		unsigned int	inFlight() const { return m_ingesting; };
+	private:
+		unsigned int	m_ingesting;	// Ingest calls in progress
+		unsigned long	m_lastFetched;	// Last reading id fetched for the block being ingested
+};
+#endif
@@ -0,0 +1,51 @@
+#ifndef _SENT_BLOCKS_H
+#define _SENT_BLOCKS_H
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Track the blocks of readings passed to the north plugin, in the order
+ * they were taken from the data loader, so that the last sent id only
+ * moves past a block once that block and all the blocks before it have
+ * been sent. A block may be sent in several parts if the plugin only
+ * sends some of its readings.
+ *
+ * The class is not thread safe, the caller must hold a lock.
+ */
+class SentBlocks {
+	public:
+		SentBlocks() : m_next(0), m_sent(0), m_reported(0) {};
+		unsigned long	issue();
+		void		progress(unsigned long block, unsigned long lastId,
+					uint32_t sent, bool complete);
+		bool		pending() const;
+		unsigned long	collect(uint32_t& sent);
+		/**
+		 * The number of blocks issued that are not yet
+		 * complete or are waiting for an earlier block
+		 */
+		size_t		outstanding() const { return m_blocks.size(); };
+	private:
+		class Block {
+			public:
+				Block() : lastId(0), complete(false) {};
+				unsigned long	lastId;		// Id of the last reading of the block sent so far
+				bool		complete;	// No more readings of the block will be sent
+		};
+		std::map<unsigned long, Block>
+				m_blocks;	// The outstanding blocks by issue order
+		unsigned long	m_next;		// The next block to issue
+		uint32_t	m_sent;		// Readings sent since the last collect
+		unsigned long	m_reported;	// The last id returned by collect
+};
+#endif
@@ -417,6 +417,11 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 			else
 				m_perfMonitor->setCollecting(false);
 		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			Logger::getLogger()->setAsynchronous(
+				m_configAdvanced.getValue("asyncLogging").compare("true") == 0);
+		}
 
 		logger->debug("Initialise the asset tracker");
 		m_assetTracker = new AssetTracker(m_mgtClient, m_name);
@@ -428,6 +433,12 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 			northPlugin->pluginRegister(controlWrite, controlOperation);
 		}
 
+		// Give the plugin the performance monitor if it records its own monitors
+		if (northPlugin->hasPerfMonitor())
+		{
+			northPlugin->pluginPerfMonitor(m_perfMonitor);
+		}
+
 		// Deal with persisted data and start the plugin
 		if (!m_dryRun)
 		{
@@ -486,6 +497,18 @@ void NorthService::start(string& coreAddress, unsigned short corePort)
 		}
 		m_dataSender = new DataSender(northPlugin, m_dataLoad, this);
 		m_dataSender->setPerfMonitor(m_perfMonitor);
+		if (m_configAdvanced.itemExists("pipelineDepth"))
+		{
+			unsigned long depth = strtoul(
+						m_configAdvanced.getValue("pipelineDepth").c_str(),
+						NULL,
+						10);
+			if (depth > 0)
+			{
+				m_dataLoad->setPipelineDepth(depth);
+				m_dataSender->setPipelineDepth(depth);
+			}
+		}
 
 		if (!m_dryRun)
 		{
@@ -819,6 +842,18 @@ void NorthService::configChange(const string& categoryName, const string& catego
 				m_dataLoad->setBlockSize(newBlock);
 			}
 		}
+		if (m_configAdvanced.itemExists("pipelineDepth"))
+		{
+			unsigned long depth = strtoul(
+					m_configAdvanced.getValue("pipelineDepth").c_str(),
+					NULL,
+					10);
+			if (depth > 0)
+			{
+				m_dataLoad->setPipelineDepth(depth);
+				m_dataSender->setPipelineDepth(depth);
+			}
+		}
 		if (m_configAdvanced.itemExists("assetTrackerInterval"))
 		{
 			unsigned long interval  = strtoul(
@@ -836,6 +871,11 @@ void NorthService::configChange(const string& categoryName, const string& catego
 			else
 				m_perfMonitor->setCollecting(false);
 		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			Logger::getLogger()->setAsynchronous(
+				m_configAdvanced.getValue("asyncLogging").compare("true") == 0);
+		}
 	}
 
 	// Update the  Security category
@@ -895,6 +935,10 @@ void NorthService::restartPlugin()
 		logger->debug("Start %s plugin", m_pluginName.c_str());
 		northPlugin->start();
 	}
+	if (northPlugin->hasPerfMonitor())
+	{
+		northPlugin->pluginPerfMonitor(m_perfMonitor);
+	}
 	m_dataSender->updatePlugin(northPlugin);
 	m_dataSender->release();
 
@@ -939,6 +983,12 @@ void NorthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 		std::to_string(DEFAULT_BLOCK_SIZE),
 		std::to_string(DEFAULT_BLOCK_SIZE));
 	defaultConfig.setItemDisplayName("blockSize", "Data block size");
+	defaultConfig.addItem("pipelineDepth",
+		"The number of blocks of data to read and filter ahead of the block being sent.",
+		"integer",
+		std::to_string(DEFAULT_PIPELINE_DEPTH),
+		std::to_string(DEFAULT_PIPELINE_DEPTH));
+	defaultConfig.setItemDisplayName("pipelineDepth", "Pipeline depth");
 	defaultConfig.addItem("assetTrackerInterval",
 			"Number of milliseconds between updates of the asset tracker information",
 			"integer", std::to_string(MIN_ASSET_TRACKER_UPDATE),
@@ -948,6 +998,9 @@ void NorthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 	defaultConfig.addItem("perfmon", "Track and store performance counters",
 			"boolean", "false", "false");
 	defaultConfig.setItemDisplayName("perfmon", "Performance Counters");
+	defaultConfig.addItem("asyncLogging", "Write log messages to syslog on a background thread rather than the thread that logs them",
+			"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("asyncLogging", "Asynchronous Logging");
 }
 
 /**
@@ -65,6 +65,15 @@ NorthPlugin::NorthPlugin(PLUGIN_HANDLE handle, const ConfigCategory& category) :
 	{
 		pluginRegisterPtr = NULL;
 	}
+	if (hasPerfMonitor())
+	{
+		pluginPerfMonitorPtr = (void (*)(const PLUGIN_HANDLE, PerformanceMonitor *))
+				manager->resolveSymbol(handle, "plugin_perfmon");
+	}
+	else
+	{
+		pluginPerfMonitorPtr = NULL;
+	}
 }
 
 NorthPlugin::~NorthPlugin()
@@ -211,3 +220,17 @@ void NorthPlugin::pluginRegister(bool ( *write)(char *name, char *value, Control
 		(*pluginRegisterPtr)(m_instance, write, operation);
 	}
 }
+
+/**
+ * Call the plugin_perfmon entry point of the plugin if one has been defined,
+ * this passes the performance monitor of the service to the plugin
+ *
+ * @param perfMonitor	The performance monitor
+ */
+void NorthPlugin::pluginPerfMonitor(PerformanceMonitor *perfMonitor)
+{
+	if (hasPerfMonitor() && pluginPerfMonitorPtr)
+	{
+		(*pluginPerfMonitorPtr)(m_instance, perfMonitor);
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <pipeline_blocks.h>
+
+/**
+ * A block is about to be passed to the ingest call of the pipeline
+ *
+ * @param lastFetched	The last reading id fetched from storage for the block
+ */
+void PipelineBlocks::ingest(unsigned long lastFetched)
+{
+	m_ingesting++;
+	m_lastFetched = lastFetched;
+}
+
+/**
+ * The ingest call of the pipeline for a block has returned, whether
+ * or not anything came out of the pipeline
+ */
+void PipelineBlocks::ingested()
+{
+	if (m_ingesting > 0)
+	{
+		m_ingesting--;
+	}
+}
+
+/**
+ * Return the last reading id to record for a block that has come out of
+ * the pipeline. This is the id of the last reading of the block, as
+ * filters may hold readings back and pass them on with a later block.
+ * Only if the readings have no ids, or the block has been completely
+ * filtered out, and the block comes out of the ingest call on the
+ * loading thread is the last id fetched for the ingested block used.
+ *
+ * @param lastId	The last reading id of the block that came out
+ * @param loadThread	The block came out on the loading thread
+ * @return unsigned long	The last reading id to record for the block
+ */
+unsigned long PipelineBlocks::outputLastId(unsigned long lastId, bool loadThread) const
+{
+	if (lastId == 0 && loadThread && m_ingesting > 0)
+	{
+		return m_lastFetched;
+	}
+	return lastId;
+}
+
+/**
+ * Check if the loader should read another block
+ *
+ * @param queued	The number of blocks queued for sending
+ * @param depth		The number of blocks to read ahead of the block being sent
+ * @return bool		True if another block should be read
+ */
+bool PipelineBlocks::readAhead(size_t queued, unsigned int depth) const
+{
+	return queued + m_ingesting < depth;
+}
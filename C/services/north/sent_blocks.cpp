@@ -0,0 +1,105 @@
+/*
+ * Fledge north service.
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sent_blocks.h>
+
+using namespace std;
+
+/**
+ * Issue the sequence number of the next block taken from the loader
+ *
+ * @return unsigned long	The block sequence number
+ */
+unsigned long SentBlocks::issue()
+{
+	unsigned long block = m_next++;
+	m_blocks[block] = Block();
+	return block;
+}
+
+/**
+ * Record that some or all of the readings of a block have been sent.
+ * A block that has been completely removed by the filters is recorded
+ * as complete with no readings sent.
+ *
+ * @param block		The sequence number of the block
+ * @param lastId	The id of the last reading of the block sent, or
+ *			0 if no reading id is known for the block
+ * @param sent		The number of readings sent
+ * @param complete	No more readings of the block will be sent
+ */
+void SentBlocks::progress(unsigned long block, unsigned long lastId, uint32_t sent, bool complete)
+{
+	auto it = m_blocks.find(block);
+	if (it == m_blocks.end())
+	{
+		return;
+	}
+	if (lastId > it->second.lastId)
+	{
+		it->second.lastId = lastId;
+	}
+	it->second.complete = complete;
+	m_sent += sent;
+}
+
+/**
+ * Check if there is anything for collect to return
+ *
+ * @return bool	True if readings have been sent or the last id can move
+ */
+bool SentBlocks::pending() const
+{
+	if (m_sent)
+	{
+		return true;
+	}
+	if (m_blocks.empty())
+	{
+		return false;
+	}
+	const Block& first = m_blocks.begin()->second;
+	return first.complete || first.lastId > m_reported;
+}
+
+/**
+ * Collect the last sent id and the number of readings sent since the
+ * previous call. The last sent id is that of the last reading sent in
+ * the earliest block that is not complete, or of the last complete
+ * block if all the blocks before it are complete. The complete blocks
+ * it has moved past are forgotten.
+ *
+ * @param sent			Set to the number of readings sent
+ * @return unsigned long	The last sent id, or 0 if it has not moved
+ */
+unsigned long SentBlocks::collect(uint32_t& sent)
+{
+	unsigned long lastId = 0;
+	auto it = m_blocks.begin();
+	while (it != m_blocks.end())
+	{
+		if (it->second.lastId > lastId)
+		{
+			lastId = it->second.lastId;
+		}
+		if (!it->second.complete)
+		{
+			break;
+		}
+		it = m_blocks.erase(it);
+	}
+	sent = m_sent;
+	m_sent = 0;
+	if (lastId > m_reported)
+	{
+		m_reported = lastId;
+		return lastId;
+	}
+	return 0;
+}
@@ -26,6 +26,8 @@
 #include <service_handler.h>
 #include <set>
 #include <perfmonitors.h>
+#include <reading_block_queue.h>
+#include <atomic>
 
 #define SERVICE_NAME  "Fledge South"
 
@@ -60,6 +62,7 @@ public:
 
 	void		ingest(const Reading& reading);
 	void		ingest(const std::vector<Reading *> *vec);
+	void		ingestBlock(std::vector<Reading *> *vec);
 	void		start(long timeout, unsigned int threshold);
 	bool		running();
     	bool		isStopping();
@@ -93,11 +96,19 @@ public:
 	void		setStatistics(const std::string& option);
 
 	std::string  	getStringFromSet(const std::set<std::string> &dpSet);
-	void		setFlowControl(unsigned int lowWater, unsigned int highWater) { m_lowWater = lowWater; m_highWater = highWater; };
+	void		setFlowControl(unsigned int lowWater, unsigned int highWater)
+			{
+				m_lowWater.store(lowWater);
+				m_highWater.store(highWater);
+			};
 	void		flowControl();
 	void		setPerfMon(PerformanceMonitor *mon)
 			{
 				m_performance = mon;
+				m_queueLengthMon = mon->getMonitor("queueLength");
+				m_ingestCountMon = mon->getMonitor("ingestCount");
+				m_storedReadingsMon = mon->getMonitor("storedReadings");
+				m_readLatencyMon = mon->getMonitor("readLatency");
 			};
 
 private:
@@ -111,6 +122,7 @@ private:
 						m_discardedReadings++;
 					};
 	long				calculateWaitTime();
+	void				takeQueuedReadings();
 	int 				createServiceStatsDbEntry();
 
 	StorageClient&			m_storage;
@@ -122,8 +134,7 @@ private:
 	std::string 			m_pluginName;
 	ManagementClient		*m_mgtClient;
 	// New data: queued
-	std::vector<Reading *>*		m_queue;
-	std::mutex			m_qMutex;
+	ReadingBlockQueue		m_queue;
 	std::mutex			m_statsMutex;
 	std::mutex			m_pipelineMutex;
 	std::thread*			m_thread;
@@ -135,11 +146,10 @@ private:
 	std::vector<Reading *>*		m_data;
 	std::vector<std::vector<Reading *>*>
 					m_resendQueues;
-	std::queue<std::vector<Reading *>*>
-					m_fullQueues;
-	std::mutex			m_fqMutex;
+	std::atomic<size_t>		m_resendLength;	// Number of queues in m_resendQueues
 	unsigned int			m_discardedReadings; // discarded readings since last update to statistics table
 	FilterPipeline*			m_filterPipeline;
+	std::atomic<bool>		m_arenaReadings;	// Single readings are copied into the reading arena
 	
 	std::unordered_set<std::string> statsDbEntriesCache;  // confirmed stats table entries
 	std::map<std::string, int>	statsPendingEntries;  // pending stats table entries
@@ -152,12 +162,17 @@ private:
 	int				m_statsUpdateFails;
 	enum { STATS_BOTH, STATS_ASSET, STATS_SERVICE }
 					m_statisticsOption;
-	unsigned int			m_highWater;
-	unsigned int			m_lowWater;
+	std::atomic<unsigned int>	m_highWater;
+	std::atomic<unsigned int>	m_lowWater;
 	AssetTrackingTable		*m_deprecated;
+	AssetShapeCache			m_shapeCache;	// Reading shapes already tracked for each asset
 	time_t				m_deprecatedAgeOut;
 	time_t				m_deprecatedAgeOutStorage;
 	PerformanceMonitor		*m_performance;
+	PerfMon				*m_queueLengthMon;
+	PerfMon				*m_ingestCountMon;
+	PerfMon				*m_storedReadingsMon;
+	PerfMon				*m_readLatencyMon;
 };
 
 #endif
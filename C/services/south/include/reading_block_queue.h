@@ -0,0 +1,252 @@
+#ifndef _READING_BLOCK_QUEUE_H
+#define _READING_BLOCK_QUEUE_H
+/*
+ * Fledge south service reading queue
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <reading_arena.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A lock free, multiple producer, single consumer queue of readings
+ * and blocks of readings.
+ *
+ * Any number of threads may push readings or blocks onto the queue
+ * without taking a lock, a push is a single atomic exchange. Only a
+ * single thread, the ingest thread, may take readings from the queue
+ * or look at the oldest reading.
+ *
+ * The queue is a linked list of nodes with a dummy node at the
+ * consumer end, the consumer owns the dummy node and the producers
+ * only ever touch the node at the producer end. A newly pushed node
+ * is briefly unreachable from the consumer until the producer has
+ * linked it to its predecessor, the consumer sees the queue as
+ * ending at that point until the link is made.
+ *
+ * The number of readings in the queue is maintained in an atomic
+ * counter so that it may be read by any thread without a lock.
+ *
+ * Nodes are taken from a fixed pool owned by the queue rather than
+ * allocated for each push. The consumer returns the nodes it has
+ * finished with to a lock free free list that the producers take
+ * nodes from, the free list head carries a tag that changes on every
+ * update to avoid the ABA problem. Should the pool be exhausted nodes
+ * are allocated from the heap.
+ */
+class ReadingBlockQueue {
+	public:
+		ReadingBlockQueue() : m_free(0), m_readings(0), m_blocks(0)
+		{
+			for (uint32_t i = 0; i < POOL_SIZE; i++)
+				release(&m_pool[i]);
+			m_tail = allocate(NULL, NULL);
+			m_head.store(m_tail, std::memory_order_relaxed);
+		};
+		/**
+		 * Destroy the queue. Any readings still in the queue
+		 * are deleted.
+		 */
+		~ReadingBlockQueue()
+		{
+			std::vector<Reading *> *block;
+			while ((block = take(SIZE_MAX)) != NULL)
+			{
+				ReadingArena::destroy(*block);
+				delete block;
+			}
+			release(m_tail);
+		};
+		/**
+		 * Add a single reading to the queue. The queue takes
+		 * ownership of the reading. May be called from any thread.
+		 *
+		 * @param reading	The reading to add
+		 */
+		void		push(Reading *reading)
+		{
+			m_readings.fetch_add(1, std::memory_order_relaxed);
+			append(allocate(reading, NULL));
+		};
+		/**
+		 * Add a block of readings to the queue. The queue
+		 * takes ownership of the block and the readings.
+		 * May be called from any thread.
+		 *
+		 * @param block	The block of readings to add
+		 */
+		void		push(std::vector<Reading *> *block)
+		{
+			m_readings.fetch_add(block->size(), std::memory_order_relaxed);
+			append(allocate(NULL, block));
+		};
+		/**
+		 * Remove readings from the queue, oldest first, until
+		 * at least threshold readings have been removed or the
+		 * queue is empty. Blocks are never split, if the oldest
+		 * entry is a block large enough to satisfy the request
+		 * it is returned as is without copying the readings.
+		 * Must only be called from the consumer thread.
+		 *
+		 * @param threshold	The number of readings wanted
+		 * @return		The readings or NULL if the queue is empty
+		 */
+		std::vector<Reading *>
+				*take(size_t threshold)
+		{
+			std::vector<Reading *> *data = NULL;
+			Node *next;
+			while ((data == NULL || data->size() < threshold)
+					&& (next = m_tail->next.load(std::memory_order_acquire)) != NULL)
+			{
+				if (next->block)
+				{
+					m_readings.fetch_sub(next->block->size(), std::memory_order_relaxed);
+					if (data)
+					{
+						data->insert(data->end(), next->block->begin(), next->block->end());
+						delete next->block;
+					}
+					else
+					{
+						data = next->block;
+					}
+				}
+				else
+				{
+					m_readings.fetch_sub(1, std::memory_order_relaxed);
+					if (!data)
+					{
+						data = new std::vector<Reading *>;
+						data->reserve(std::min(threshold, size() + 1));
+					}
+					data->emplace_back(next->reading);
+				}
+				next->reading = NULL;
+				next->block = NULL;
+				release(m_tail);
+				m_tail = next;
+				m_blocks.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return data;
+		};
+		/**
+		 * Return the oldest reading in the queue without
+		 * removing it. Must only be called from the consumer thread.
+		 *
+		 * @return	The oldest reading or NULL if the queue is empty
+		 */
+		Reading		*oldest() const
+		{
+			Node *next = m_tail->next.load(std::memory_order_acquire);
+			if (!next)
+				return NULL;
+			if (next->block)
+				return next->block->empty() ? NULL : next->block->front();
+			return next->reading;
+		};
+		/**
+		 * Return the number of readings in the queue. May be
+		 * called from any thread, the value may be stale by the
+		 * time it is used if other threads are active.
+		 */
+		size_t		size() const
+		{
+			return m_readings.load(std::memory_order_relaxed);
+		};
+		/**
+		 * Return the number of readings and blocks of
+		 * readings in the queue.
+		 */
+		size_t		blocks() const
+		{
+			return m_blocks.load(std::memory_order_relaxed);
+		};
+		bool		empty() const
+		{
+			return m_tail->next.load(std::memory_order_acquire) == NULL;
+		};
+	private:
+		class Node {
+			public:
+				Node() : next(NULL), reading(NULL), block(NULL), nextFree(0) {};
+				std::atomic<Node *>	next;
+				Reading			*reading;	// A single reading or
+				std::vector<Reading *>	*block;		// a block of readings
+				std::atomic<uint32_t>	nextFree;	// Pool index + 1 of the next free node
+		};
+		/**
+		 * Take a node from the free list, or from the heap if
+		 * the pool is exhausted. May be called from any thread.
+		 */
+		Node		*allocate(Reading *reading, std::vector<Reading *> *block)
+		{
+			Node *node = NULL;
+			uint64_t head = m_free.load(std::memory_order_acquire);
+			while ((uint32_t)head != 0)
+			{
+				Node *first = &m_pool[(uint32_t)head - 1];
+				uint64_t next = ((head >> 32) + 1) << 32
+						| first->nextFree.load(std::memory_order_relaxed);
+				if (m_free.compare_exchange_weak(head, next,
+						std::memory_order_acquire, std::memory_order_acquire))
+				{
+					node = first;
+					break;
+				}
+			}
+			if (!node)
+				node = new Node();
+			node->next.store(NULL, std::memory_order_relaxed);
+			node->reading = reading;
+			node->block = block;
+			return node;
+		};
+		/**
+		 * Return a node to the free list, or to the heap if it
+		 * was not taken from the pool. Only called by the consumer.
+		 */
+		void		release(Node *node)
+		{
+			if (node < &m_pool[0] || node >= &m_pool[POOL_SIZE])
+			{
+				delete node;
+				return;
+			}
+			uint32_t index = (uint32_t)(node - &m_pool[0]) + 1;
+			uint64_t head = m_free.load(std::memory_order_relaxed);
+			do {
+				node->nextFree.store((uint32_t)head, std::memory_order_relaxed);
+			} while (!m_free.compare_exchange_weak(head, ((head >> 32) + 1) << 32 | index,
+					std::memory_order_release, std::memory_order_relaxed));
+		};
+		/**
+		 * Link a new node onto the producer end of the queue
+		 */
+		void		append(Node *node)
+		{
+			m_blocks.fetch_add(1, std::memory_order_relaxed);
+			Node *prev = m_head.exchange(node, std::memory_order_acq_rel);
+			prev->next.store(node, std::memory_order_release);
+		};
+		ReadingBlockQueue(const ReadingBlockQueue&) = delete;
+		ReadingBlockQueue& operator=(const ReadingBlockQueue&) = delete;
+
+		static const uint32_t	POOL_SIZE = 1024;
+		Node			m_pool[POOL_SIZE];
+		std::atomic<uint64_t>	m_free;		// Tag in the upper 32 bits, pool index + 1 of the first free node in the lower
+		std::atomic<Node *>	m_head;		// Producer end, the most recently pushed node
+		Node			*m_tail;	// Consumer end, the dummy node
+		std::atomic<size_t>	m_readings;
+		std::atomic<size_t>	m_blocks;
+};
+
+#endif
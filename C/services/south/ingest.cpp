@@ -9,6 +9,7 @@
  */
 #include <ingest.h>
 #include <reading.h>
+#include <reading_arena.h>
 #include <config_handler.h>
 #include <thread>
 #include <logger.h>
@@ -282,15 +283,16 @@ Ingest::Ingest(StorageClient& storage,
 			m_serviceName(serviceName),
 			m_pluginName(pluginName),
 			m_mgtClient(mgmtClient),
+			m_resendLength(0),
 			m_failCnt(0),
 			m_storageFailed(false),
 			m_storesFailed(0),
 			m_statisticsOption(STATS_BOTH),
-			m_highWater(0)
+			m_highWater(0),
+			m_lowWater(0)
 {
 	m_shutdown = false;
 	m_running = true;
-	m_queue = new vector<Reading *>();
 	m_logger = Logger::getLogger();
 	m_data = NULL;
 	m_discardedReadings = 0;
@@ -305,6 +307,7 @@ Ingest::Ingest(StorageClient& storage,
 	createServiceStatsDbEntry();
 
 	m_filterPipeline = NULL;
+	m_arenaReadings = true;
 
 	m_deprecated = NULL;
 
@@ -356,29 +359,11 @@ Ingest::~Ingest()
 	m_statsCv.notify_one();
 	m_statsThread->join();
 	updateStats();
-	// Cleanup and readings left in the various queues
-	for (auto& reading : *m_queue)
-	{
-		delete reading;
-	}
-	delete m_queue;
+	// Cleanup and readings left in the resend queues, m_queue cleans up itself
 	for (auto& q : m_resendQueues)
 	{
-		for (auto& rq : *q)
-		{
-			delete rq;
-		}
-		delete q;
-	}
-	while (m_fullQueues.size() > 0)
-	{
-		vector<Reading *> *q = m_fullQueues.front();
-		for (auto& rq : *q)
-		{
-			delete rq;
-		}
+		ReadingArena::destroy(*q);
 		delete q;
-		m_fullQueues.pop();
 	}
 	delete m_thread;
 	delete m_statsThread;
@@ -417,90 +402,78 @@ bool Ingest::isStopping()
 /**
  * Add a reading to the reading queue
  *
+ * The reading is pushed onto the lock free queue, the ingest
+ * thread will gather queued readings together before sending
+ * them to storage. Unless the service has filters, which may
+ * delete readings, the reading is copied into the reading arena
+ * as the ingest class is then the only owner of the copy.
+ *
  * @param reading	The single reading to ingest
  */
 void Ingest::ingest(const Reading& reading)
 {
-vector<Reading *> *fullQueue = 0;
-
-	{
-		lock_guard<mutex> guard(m_qMutex);
-		m_queue->emplace_back(new Reading(reading));
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
-		}
-	}
-	if (fullQueue)
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
-	}
-	if (m_fullQueues.size())
+	m_queue.push(m_arenaReadings ? ReadingArena::copy(reading) : new Reading(reading));
+	size_t qSize = m_queue.size();
+	if (qSize >= m_queueSizeThreshold || m_running == false)
 		m_cv.notify_all();
-	m_performance->collect("queueLength", (long)queueLength());
+	m_performance->collect(m_queueLengthMon, (long)queueLength());
 }
 
 /**
  * Add a set of readings to the reading queue
  *
+ * The ingest class takes ownership of the readings in the vector,
+ * but not of the vector itself. Callers that no longer need the
+ * vector should use ingestBlock to avoid copying it.
+ *
  * @param vec	A vector of readings to ingest
  */
 void Ingest::ingest(const vector<Reading *> *vec)
 {
-vector<Reading *> *fullQueue = 0;
-size_t qSize;
-unsigned int nFullQueues = 0;
+	if (vec->empty())
+		return;
+	ingestBlock(new vector<Reading *>(*vec));
+}
 
+/**
+ * Add a block of readings to the reading queue
+ *
+ * The ingest class takes ownership of the vector and the readings
+ * in it, the vector is queued as a single entry without copying.
+ *
+ * @param vec	A vector of readings to ingest
+ */
+void Ingest::ingestBlock(vector<Reading *> *vec)
+{
+	if (vec->empty())
 	{
-		lock_guard<mutex> guard(m_qMutex);
-		
-		// Get the readings in the set
-		for (auto & rdng : *vec)
-		{
-			m_queue->emplace_back(rdng);
-		}
-		if (m_queue->size() >= m_queueSizeThreshold || m_running == false)
-		{
-			fullQueue = m_queue;
-			m_queue = new vector<Reading *>;
-		}
-		qSize = m_queue->size();
-	}
-	if (fullQueue)
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		m_fullQueues.push(fullQueue);
-		nFullQueues = m_fullQueues.size();
-	}
-	else
-	{
-		lock_guard<mutex> guard(m_fqMutex);
-		nFullQueues = m_fullQueues.size();
+		delete vec;
+		return;
 	}
-	if (nFullQueues != 0 || qSize > m_queueSizeThreshold * 3 / 4)
+	size_t count = vec->size();
+	m_queue.push(vec);
+	size_t qSize = m_queue.size();
+	if (qSize > m_queueSizeThreshold * 3 / 4 || m_running == false)
 	{
 		m_cv.notify_all();
 	}
-	m_performance->collect("queueLength", (long)queueLength());
-	m_performance->collect("ingestCount", (long)vec->size());
+	m_performance->collect(m_queueLengthMon, (long)queueLength());
+	m_performance->collect(m_ingestCountMon, (long)count);
 }
 
 /**
- * Work out how long to wait based on age of oldest queued reading
- * We do this in a separate function so that we can lock the qMutex
- * to access the oldest element in the queue
+ * Work out how long to wait based on age of oldest queued reading.
+ * This must only be called from the ingest thread as it looks at
+ * the oldest element in the queue.
  *
  * @return the time to wait
  */
 long Ingest::calculateWaitTime()
 {
 	long timeout = m_timeout;
-	lock_guard<mutex> guard(m_qMutex);
-	if (!m_queue->empty())
+	Reading *reading = m_queue.oldest();
+	if (reading)
 	{
-		Reading *reading = (*m_queue)[0];
 		struct timeval tm, now;
 		reading->getUserTimestamp(&tm);
 		gettimeofday(&now, NULL);
@@ -516,9 +489,9 @@ long Ingest::calculateWaitTime()
  */
 void Ingest::waitForQueue()
 {
-	if (m_fullQueues.size() > 0 || m_resendQueues.size() > 0)
+	if (m_queue.size() >= m_queueSizeThreshold || m_resendQueues.size() > 0)
 		return;
-	if (m_running && m_queue->size() < m_queueSizeThreshold)
+	if (m_running)
 	{
 		long timeout = calculateWaitTime();
 		if (timeout > 0)
@@ -536,10 +509,11 @@ void Ingest::waitForQueue()
  * Send them to the storage layer as a block. If the append call
  * fails requeue the readings for the next transmission.
  *
- * In order not to lock the queue for an excessie time a new queue
- * is created and the old one moved to a local variable. This minimise
- * the time we hold the queue mutex to the time it takes to swap two
- * variables.
+ * The queue of new readings is lock free, the blocks of readings
+ * that have been queued are gathered together into a single block
+ * of up to the queue size threshold readings and sent to storage.
+ * If more than the threshold number of readings remain queued then
+ * the process is repeated.
  */
 void Ingest::processQueue()
 {
@@ -566,7 +540,7 @@ void Ingest::processQueue()
 						Reading *reading = q->front();
 						m_logger->info("Remove reading: %s",
 								reading->toJSON().c_str());
-						delete reading;
+						ReadingArena::destroy(reading);
 						q->erase(q->begin());
 						logDiscardedStat();
 					}
@@ -575,6 +549,7 @@ void Ingest::processQueue()
 					{
 						delete q;
 						m_resendQueues.erase(m_resendQueues.begin());
+						m_resendLength = m_resendQueues.size();
 					}
 					m_failCnt = 0;
 				}
@@ -582,7 +557,7 @@ void Ingest::processQueue()
 			else
 			{
 
-				m_performance->collect("storedReadings", (long int)(q->size()));
+				m_performance->collect(m_storedReadingsMon, (long int)(q->size()));
 				if (m_storageFailed)
 				{
 					m_logger->warn("Storage operational after %d failures", m_storesFailed);
@@ -607,31 +582,16 @@ void Ingest::processQueue()
 							 it != q->end(); ++it)
 				{
 					Reading *reading = *it;
-					string assetName = reading->getAssetName();
-                                        const std::vector<Datapoint *> dpVec = reading->getReadingData();
-					std::string temp;
-					std::set<std::string> tempSet;
-					// first sort the individual datapoints 
-					// e.g. dp2, dp3, dp1 push them in a set,to make them 
-					// dp1,dp2,dp3
-                                        for ( auto dp : dpVec)
-                                        {
-						temp.clear();
-                                                temp.append(dp->getName());
-						tempSet.insert(temp);
-                                        }
-
-					temp.clear();
+					const string& assetName = reading->getAssetName();
 
-					// Push them in a set so as to avoid duplication of datapoints
-					// a reading of d1, d2, d3 and another d2,d3,d1 , second will be discarded
-					//
-					for (auto dp: tempSet)
+					// Only a reading with a new shape for its asset can add
+					// datapoints to the storage asset tracking of the asset
+					if (m_shapeCache.isNewShape(reading))
 					{
-						set<string> &s= assetDatapointMap[assetName];
-						if (s.find(dp) == s.end())
+						set<string> &s = assetDatapointMap[assetName];
+						for (auto dp : reading->getReadingData())
 						{
-							s.insert(dp);
+							s.insert(dp->getName());
 						}
 					}
 
@@ -664,10 +624,10 @@ void Ingest::processQueue()
 					{
 						(*lastStat)++;
 					}
-					delete reading;
 				}
+				ReadingArena::destroy(*q);
 
-				for (auto itr : assetDatapointMap)
+				for (auto& itr : assetDatapointMap)
 				{
 					std::set<string> &s = itr.second;
 					unsigned int count = s.size();
@@ -687,6 +647,7 @@ void Ingest::processQueue()
 
 				delete q;
 				m_resendQueues.erase(m_resendQueues.begin());
+				m_resendLength = m_resendQueues.size();
 				unique_lock<mutex> lck(m_statsMutex);
 				for (auto &it : statsEntriesCurrQueue)
 				{
@@ -695,25 +656,7 @@ void Ingest::processQueue()
 			}
 		}
 
-		{
-			lock_guard<mutex> fqguard(m_fqMutex);
-			if (m_fullQueues.empty())
-			{
-				if (!m_shutdown)
-				{
-					// Block of code to execute holding the mutex
-					lock_guard<mutex> guard(m_qMutex);
-					std::vector<Reading *> *newQ = new vector<Reading *>;
-					m_data = m_queue;
-					m_queue = newQ;
-				}
-			}
-			else
-			{
-				m_data = m_fullQueues.front();
-				m_fullQueues.pop();
-			}
-		}
+		takeQueuedReadings();
 		
 		/*
 		 * Create a ReadingSet from m_data readings if we have filters.
@@ -725,10 +668,9 @@ void Ingest::processQueue()
 		 * ingest class where it will repopulate the m_data member.
 		 *
 		 * We lock the filter pipeline here to prevent it being reconfigured whilst we
-		 * process the data. We do this because the qMutex is not good enough here as we
-		 * do not hold it, by deliberate policy. As we copy the queue holding the qMutex
-		 * and then release it to enable more data to be queued while we process the previous
-		 * queue via the filter pipeline and up to the storage layer.
+		 * process the data. The queue of new readings is lock free, more data may be queued
+		 * while we process the previous block via the filter pipeline and up to the storage
+		 * layer.
 		 */
 		{
 			lock_guard<mutex> guard(m_pipelineMutex);
@@ -745,6 +687,13 @@ void Ingest::processQueue()
 						std::this_thread::sleep_for(std::chrono::milliseconds(150));
 					}
 
+					// Readings queued before the pipeline was set up may be
+					// held in the reading arena, the filters may keep or delete
+					// the readings so they are taken out of the arena
+					for (auto& reading : *m_data)
+					{
+						reading = ReadingArena::copyOut(reading);
+					}
 					ReadingSet *readingSet = new ReadingSet(m_data);
 					m_data->clear();
 					// Pass readingSet to filter chain
@@ -779,7 +728,7 @@ void Ingest::processQueue()
 				firstReading->getUserTimestamp(&tmFirst);
 				timersub(&tmNow, &tmFirst, &dur);
 				long latency = dur.tv_sec * 1000 + (dur.tv_usec / 1000);
-				m_performance->collect("readLatency", latency);
+				m_performance->collect(m_readLatencyMon, latency);
 				if (latency > m_timeout && m_highLatency == false)
 				{
 					m_logger->warn("Current send latency of %ldms exceeds requested maximum latency of %dmS", latency, m_timeout);
@@ -828,12 +777,13 @@ void Ingest::processQueue()
 				m_storesFailed++;
 				m_performance->collect("resendQueued", (long int)(m_data->size()));
 				m_resendQueues.push_back(m_data);
+				m_resendLength = m_resendQueues.size();
 				m_data = NULL;
 				m_failCnt = 1;
 			}
 			else
 			{
-				m_performance->collect("storedReadings", (long int)(m_data->size()));
+				m_performance->collect(m_storedReadingsMon, (long int)(m_data->size()));
 				if (m_storageFailed)
 				{
 					m_logger->warn("Storage operational after %d failures", m_storesFailed);
@@ -852,34 +802,19 @@ void Ingest::processQueue()
 
 				for (vector<Reading *>::iterator it = m_data->begin(); it != m_data->end(); ++it)
 				{
-		               	        Reading *reading = *it;
-					string	assetName = reading->getAssetName();
-					const std::vector<Datapoint *> dpVec = reading->getReadingData();
-					std::string temp;
-                                        std::set<std::string> tempSet;
-                                        // first sort the individual datapoints
-                                        // e.g. dp2, dp3, dp1 push them in a set,to make them
-                                        // dp1,dp2,dp3
-                                        for ( auto dp : dpVec)
-                                        {
-                                                temp.clear();
-                                                temp.append(dp->getName());
-                                                tempSet.insert(temp);
-                                        }
-
-                                        temp.clear();
+					Reading *reading = *it;
+					const string& assetName = reading->getAssetName();
 
-                                        // Push them in a set so as to avoid duplication of datapoints
-                                        // a reading of d1, d2, d3 and another d2,d3,d1 , second will be discarded
-                                        //
-                                        for (auto dp: tempSet)
-                                        {
-                                                set<string> &s= assetDatapointMap[assetName];
-                                                if (s.find(dp) == s.end())
-                                                {
-                                                        s.insert(dp);
-                                                }
-                                        }
+					// Only a reading with a new shape for its asset can add
+					// datapoints to the storage asset tracking of the asset
+					if (m_shapeCache.isNewShape(reading))
+					{
+						set<string> &s = assetDatapointMap[assetName];
+						for (auto dp : reading->getReadingData())
+						{
+							s.insert(dp->getName());
+						}
+					}
 
                                         if (lastAsset.compare(assetName))
                                         {
@@ -914,13 +849,9 @@ void Ingest::processQueue()
                                           // delete reading;
 
 				}
-				for( auto & rdng : *m_data)
-				{
-					delete rdng;
-				}
-				m_data->clear();
+				ReadingArena::destroy(*m_data);
 
-				for (auto itr : assetDatapointMap)
+				for (auto& itr : assetDatapointMap)
 				{
 					std::set<string> &s = itr.second;
 				        unsigned int count = s.size();
@@ -954,7 +885,19 @@ void Ingest::processQueue()
 			m_data = NULL;
 		}
 		signalStatsUpdate();
-	} while (! m_fullQueues.empty());
+	} while (m_queue.size() >= m_queueSizeThreshold || (m_shutdown && !m_queue.empty()));
+}
+
+/**
+ * Take readings from the queue of new readings into m_data, up
+ * to the queue size threshold number of readings. If the queue
+ * is empty m_data is an empty vector.
+ */
+void Ingest::takeQueuedReadings()
+{
+	m_data = m_queue.take(m_queueSizeThreshold);
+	if (!m_data)
+		m_data = new vector<Reading *>;
 }
 
 /**
@@ -997,6 +940,7 @@ bool Ingest::loadFilters(const string& categoryName)
 	if (rval)
 	{
 		m_filterPipeline = filterPipeline;
+		m_arenaReadings = false;
 	}
 	else
 	{
@@ -1129,6 +1073,7 @@ void Ingest::configChange(const string& category, const string& newConfig)
 				m_filterPipeline->cleanupFilters(m_serviceName);
 				delete m_filterPipeline;
 				m_filterPipeline = NULL;
+				m_arenaReadings = true;
 			}
 		}
 
@@ -1166,11 +1111,10 @@ void Ingest::configChange(const string& category, const string& newConfig)
  */
 size_t Ingest::queueLength()
 {
-	size_t	len = m_queue->size();
+	size_t	len = m_queue.size();
 
-	// Approximate the amount of data in the full queues
-	len += m_fullQueues.size() * m_queueSizeThreshold;
-	len += m_resendQueues.size() * m_queueSizeThreshold;
+	// Approximate the amount of data in the resend queues
+	len += m_resendLength.load() * m_queueSizeThreshold;
 
 	return len;
 }
@@ -1489,15 +1433,17 @@ std::string  Ingest::getStringFromSet(const std::set<std::string> &dpSet)
  */
 void Ingest::flowControl()
 {
-	if (m_highWater == 0)	// No flow control
+	unsigned int highWater = m_highWater.load();
+	unsigned int lowWater = m_lowWater.load();
+	if (highWater == 0)	// No flow control
 	{
 		return;
 	}
-	if (m_highWater < queueLength())
+	if (highWater < queueLength())
 	{
 		m_logger->debug("Waiting for ingest queue to drain");
 		int total = 0, delay = AFC_SLEEP_INCREMENT;
-		while (total < AFC_MAX_WAIT && queueLength() > m_lowWater)
+		while (total < AFC_MAX_WAIT && queueLength() > lowWater)
 		{
 			this_thread::sleep_for(chrono::milliseconds(delay));
 			total += delay;
@@ -1507,7 +1453,7 @@ void Ingest::flowControl()
 				delay = AFC_SLEEP_MAX;
 			}
 		}
-		m_logger->debug("Ingest queue has %s", queueLength() > m_lowWater
+		m_logger->debug("Ingest queue has %s", queueLength() > lowWater
 			       	? "failed to drain in sufficient time" : "has drained");
 		m_performance->collect("flow controlled", total);
 	}
@@ -218,8 +218,7 @@ void doIngestV2(Ingest *ingest, ReadingSet *set)
     
     Logger::getLogger()->debug("%s:%d: V2 async ingest method returned: vec->size()=%d", __FUNCTION__, __LINE__, vec->size());
 
-	ingest->ingest(vec2);
-	delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
+	ingest->ingestBlock(vec2);	// the vector and the readings in it are now owned by the Ingest class's internal queue
 	delete set;
 
 	ingest->flowControl();
@@ -454,6 +453,11 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 			else
 				m_perfMonitor->setCollecting(false);
 		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			Logger::getLogger()->setAsynchronous(
+				m_configAdvanced.getValue("asyncLogging").compare("true") == 0);
+		}
 
 		m_ingest->start(timeout, threshold);	// Start the ingest threads running
 
@@ -618,9 +622,8 @@ void SouthService::start(string& coreAddress, unsigned short corePort)
 							    }
 							    // move reading vector from set to vec2
 								std::vector<Reading *> *vec2 = set->moveAllReadings();
-								ingest.ingest(vec2);
 								pollCount += (int) vec2->size();
-								delete vec2; 	// each reading object inside vector has been allocated on heap and moved to Ingest class's internal queue
+								ingest.ingestBlock(vec2);	// the vector and the readings in it are now owned by the Ingest class's internal queue
 								delete set;
 							}
 						}
@@ -911,6 +914,11 @@ void SouthService::processConfigChange(const string& categoryName, const string&
 			else
 				m_perfMonitor->setCollecting(false);
 		}
+		if (m_configAdvanced.itemExists("asyncLogging"))
+		{
+			Logger::getLogger()->setAsynchronous(
+				m_configAdvanced.getValue("asyncLogging").compare("true") == 0);
+		}
 		if (! southPlugin->isAsync())
 		{
 			try {
@@ -1219,6 +1227,9 @@ void SouthService::addConfigDefaults(DefaultConfigCategory& defaultConfig)
 	defaultConfig.addItem("perfmon", "Track and store performance counters",
 			       "boolean", "false", "false");
 	defaultConfig.setItemDisplayName("perfmon", "Performance Counters");
+	defaultConfig.addItem("asyncLogging", "Write log messages to syslog on a background thread rather than the thread that logs them",
+			"boolean", "false", "false");
+	defaultConfig.setItemDisplayName("asyncLogging", "Asynchronous Logging");
 }
 
 /**
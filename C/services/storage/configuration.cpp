@@ -33,7 +33,7 @@ static const char *defaultConfiguration = QUOTE({
 		"default" : "Use main plugin",
 		"description" : "The storage plugin to load for readings data.",
 		"type" : "enumeration",
-		"options" : [ "Use main plugin", "sqlite", "sqlitelb", "sqlitememory", "postgres" ],
+		"options" : [ "Use main plugin", "sqlite", "sqlitelb", "sqlitememory", "ringbuffer", "postgres" ],
 		"displayName" : "Readings Plugin",
 		"order" : "2"
 		},
@@ -45,6 +45,14 @@ static const char *defaultConfiguration = QUOTE({
 		"displayName" : "Database threads",
 		"order" : "3"
 	       	},
+	"streamWriters" : {
+		"value" : "2",
+		"default" : "2",
+		"description" : "The number of threads writing the readings received on south service streams to the storage plugin",
+		"type" : "integer",
+		"displayName" : "Stream writer threads",
+		"order" : "8"
+		},
 	"managedStatus" : {
 		"value" : "false",
 		"default" : "false",
@@ -15,6 +15,7 @@
 #include <storage_stats.h>
 #include <storage_registry.h>
 #include <stream_handler.h>
+#include <chrono>
 
 using namespace std;
 using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
@@ -65,6 +66,7 @@ public:
 	void	initResources();
 	void	setPlugin(StoragePlugin *);
 	void	setReadingPlugin(StoragePlugin *);
+	void	setStreamWriters(unsigned int writers) { m_streamWriters = writers; };
 	void	start();
 	void	startServer();
 	void	wait();
@@ -122,7 +124,20 @@ private:
 	void			respond(shared_ptr<HttpServer::Response>, SimpleWeb::StatusCode, const string&);
 	void			internalError(shared_ptr<HttpServer::Response>, const exception&);
 	void			mapError(string&, PLUGIN_ERROR *);
+	bool			appendStream(ReadingStream **readings, bool commit);
+	void			notifyReadings();
+	bool			waitForReadings(unsigned long generation,
+					std::chrono::steady_clock::time_point deadline);
+	static bool		emptyReadings(const char *resultSet);
+	void			readingFetchBinary(shared_ptr<HttpServer::Response> response,
+					StoragePlugin *fetchPlugin, unsigned long id,
+					unsigned long count, unsigned long wait);
 	StreamHandler		*streamHandler;
+	unsigned int		m_streamWriters;
+	std::mutex		m_readingsMutex;
+	std::condition_variable	m_readingsCV;
+	std::atomic<unsigned long>
+				m_readingsGeneration;	// Incremented each time readings are appended
 };
 
 #endif
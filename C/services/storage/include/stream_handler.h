@@ -13,6 +13,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <vector>
+#include <deque>
 #include <map>
 #include <sys/epoll.h>
 #include <reading_stream.h>
@@ -20,14 +21,36 @@
 #define MAX_EVENTS	  40	// Number of epoll events in one epoll_wait call
 #define RDS_BLOCK	 10000	// Number of readings to insert in each call to the storage plugin
 #define BLOCK_POOL_SIZES 512	// Increments of block sizes in a block pool
+#define RDS_LARGE_READING 65536	// Readings larger than this are not allocated from a block pool
+#define MAX_PENDING_BATCHES 4	// Batches queued for a stream before it stops reading the socket
+#define DEFAULT_STREAM_WRITERS 2	// Default number of threads writing stream batches to storage
 
 class StorageApi;
 
+/**
+ * The stream handler manages the reading streams from south services.
+ *
+ * A single thread uses epoll to read the data from all the streams and
+ * frame it into batches of readings. Completed batches are handed to a
+ * pool of writer threads that pass them to the storage plugin, each
+ * call to the plugin uses its own connection from the plugin connection
+ * pool. Only one writer works on a given stream at any time, so the
+ * batches of a stream are written in the order they were received.
+ *
+ * If a stream has too many batches waiting to be written the handler
+ * stops reading from its socket until the writers catch up, the client
+ * is then held back by the TCP window rather than by blocking the
+ * epoll thread and the other streams. The sockets and their epoll
+ * registrations are only ever changed by the epoll thread, a writer
+ * that has caught up asks the epoll thread to resume reading the
+ * stream by way of an eventfd.
+ */
 class StreamHandler {
 	public:
-		StreamHandler(StorageApi *);
+		StreamHandler(StorageApi *, unsigned int writers = DEFAULT_STREAM_WRITERS);
 		~StreamHandler();
 		void			handler();
+		void			writer();
 		uint32_t		createStream(uint32_t *token);
 	private:
 		class Stream {
@@ -35,7 +58,9 @@ class StreamHandler {
 				Stream();
 				~Stream();
 				uint32_t	create(int epollfd, uint32_t *token);
-				void		handleEvent(int epollfd, StorageApi *api, uint32_t events);
+				void		handleEvent(StreamHandler *handler, uint32_t events);
+				void		write(StreamHandler *handler);
+				void		resume();
 			private:
 				/**
 				 * A simple memory pool we use to store the messages we receive.
@@ -63,7 +88,12 @@ class StreamHandler {
 					};
 					void		setNonBlocking(int fd);
 					unsigned int	available(int fd);
-					void		queueInsert(StorageApi *api, unsigned int nReadings, bool commit);
+					bool		readHeader(void *hdr, size_t len);
+					void		queueInsert(StreamHandler *handler, bool commit);
+					bool		throttle();
+					void		reclaim();
+					std::vector<ReadingStream *>
+							*newBatch();
 					void		dump(int n);
 					enum { Closed, Listen, AwaitingToken, Connected }
 				       			m_status;
@@ -76,21 +106,49 @@ class StreamHandler {
 					uint32_t	m_readingNo;
 					uint32_t	m_blockSize;
 					size_t		m_readingSize;
+					size_t		m_bodyRead;	// Bytes of the current reading read so far
+					char		m_header[sizeof(RDSReadingHeader)];	// The header being read, the largest header
+					size_t		m_headerRead;	// Bytes of the current header read so far
 					struct epoll_event
 							m_event;
-					ReadingStream	*m_readings[RDS_BLOCK+1];
+					int		m_epollfd;
+					std::vector<ReadingStream *>
+							*m_batch;	// The batch being read
 					ReadingStream	*m_currentReading;
 					MemoryPool	*m_blockPool;
 					std::string	m_lastAsset;
 					bool		m_sameAsset;
+					// Batches waiting to be written and the commit flag for each
+					std::deque<std::pair<std::vector<ReadingStream *> *, bool> >
+							m_pending;
+					// Written batches waiting to be returned to the block pool
+					std::vector<std::vector<ReadingStream *> *>
+							m_written;
+					std::vector<std::vector<ReadingStream *> *>
+							m_freeBatches;
+					std::mutex	m_batchMutex;
+					bool		m_scheduled;	// Stream is queued for, or held by, a writer
+					bool		m_paused;	// Too many batches are pending, guarded by m_batchMutex
 		};
+		void			schedule(Stream *stream);
+		void			requestResume(Stream *stream);
+		void			resumeStreams();
+
 		StorageApi		*m_api;
 		std::thread		m_handlerThread;
+		std::vector<std::thread>
+					m_writers;
+		std::deque<Stream *>	m_work;
+		std::mutex		m_workMutex;
+		std::condition_variable	m_workCV;
 		int			m_tokens;
 		std::condition_variable	m_streamsCV;
 		std::mutex		m_streamsMutex;
 		std::vector<Stream *>	m_streams;
 		bool			m_running;
 		int			m_pollfd;
+		int			m_resumefd;	// eventfd used to wake the epoll thread to resume streams
+		std::mutex		m_resumeMutex;
+		std::vector<Stream *>	m_resume;	// Streams waiting to be resumed by the epoll thread
 };
 #endif
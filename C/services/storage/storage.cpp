@@ -237,6 +237,10 @@ unsigned short servicePort;
 
 
 	api = new StorageApi(servicePort, threads);
+	if (config->hasValue("streamWriters"))
+	{
+		api->setStreamWriters((unsigned int)atoi(config->getValue("streamWriters")));
+	}
 }
 
 /**
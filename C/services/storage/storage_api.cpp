@@ -14,6 +14,7 @@
 #include "management_api.h"
 #include "logger.h"
 #include "plugin_exception.h"
+#include <reading_stream_payload.h>
 #include <rapidjson/document.h>
 #include <atomic>
 
@@ -33,6 +34,9 @@
 // Threshold for logging number of threads in use for some "readings" wrappers
 #define MAX_WORKER_THREADS	5
 
+// Upper limit in milliseconds on the time a reading fetch may wait for new readings
+#define MAX_FETCH_WAIT		5000
+
 /**
  * Definition of the Storage Service REST API
  */
@@ -385,7 +389,7 @@ void storageTableQueryWrapper(shared_ptr<HttpServer::Response> response,
 /**
  * Construct the singleton Storage API 
  */
-StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : m_thread(NULL), readingPlugin(0), streamHandler(0)
+StorageApi::StorageApi(const unsigned short port, const unsigned int threads) : m_thread(NULL), readingPlugin(0), streamHandler(0), m_streamWriters(DEFAULT_STREAM_WRITERS), m_readingsGeneration(0)
 {
 
 	m_port = port;
@@ -850,6 +854,10 @@ string  responsePayload;
 		int rval = (readingPlugin ? readingPlugin : plugin)->readingsAppend(payload);
 		if (rval != -1)
 		{
+			if (rval > 0)
+			{
+				notifyReadings();
+			}
 			registry.process(payload);
 			responsePayload = "{ \"response\" : \"appended\", \"readings_added\" : ";
 			responsePayload += to_string(rval);
@@ -871,6 +879,10 @@ string  responsePayload;
 /**
  * Fetch a block of readings.
  *
+ * The optional wait query parameter gives a time in milliseconds to wait
+ * for new readings to be appended if there are none to return. This allows
+ * the north services to wait for readings rather than poll for them.
+ *
  * @param response	The response stream to send the response on
  * @param request	The HTTP request
  */
@@ -880,6 +892,7 @@ void StorageApi::readingFetch(shared_ptr<HttpServer::Response> response,
 SimpleWeb::CaseInsensitiveMultimap query;
 unsigned long			   id = 0;
 unsigned long			   count = 0;
+unsigned long			   wait = 0;
 	stats.readingFetch++;
 	try {
 		query = request->parse_query_string();
@@ -910,9 +923,35 @@ unsigned long			   count = 0;
 		{
 			count = (unsigned)atol(search->second.c_str());
 		}
+		search = query.find("wait");
+		if (search != query.end())
+		{
+			wait = strtoul(search->second.c_str(), NULL, 10);
+			if (wait > MAX_FETCH_WAIT)
+			{
+				wait = MAX_FETCH_WAIT;
+			}
+		}
 
-		// Get plugin data
+		StoragePlugin *fetchPlugin = readingPlugin ? readingPlugin : plugin;
+		search = query.find("format");
+		if (search != query.end() && search->second.compare("binary") == 0
+				&& fetchPlugin->hasBinaryFetch())
+		{
+			readingFetchBinary(response, fetchPlugin, id, count, wait);
+			return;
+		}
+
+		// Get plugin data, waiting for new readings if there are none
+		auto deadline = chrono::steady_clock::now() + chrono::milliseconds(wait);
+		unsigned long generation = m_readingsGeneration;
 		char *responsePayload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(id, count);
+		while (wait && emptyReadings(responsePayload) && waitForReadings(generation, deadline))
+		{
+			free(responsePayload);
+			generation = m_readingsGeneration;
+			responsePayload = (readingPlugin ? readingPlugin : plugin)->readingsFetch(id, count);
+		}
 		string res = responsePayload;
 
 		// Reply to client
@@ -924,6 +963,105 @@ unsigned long			   count = 0;
 	}
 }
 
+/**
+ * Return a block of readings in the binary form described in
+ * reading_stream.h. This avoids the conversion of binary payloads to
+ * JSON, and the base64 encoding of images and data buffers that it
+ * requires, for clients that can decode the binary payloads.
+ *
+ * @param response	The response stream to send the response on
+ * @param fetchPlugin	The plugin that holds the readings
+ * @param id		The id of the first reading to return
+ * @param count		The maximum number of readings to return
+ * @param wait		The time in milliseconds to wait for readings
+ */
+void StorageApi::readingFetchBinary(shared_ptr<HttpServer::Response> response,
+				StoragePlugin *fetchPlugin, unsigned long id,
+				unsigned long count, unsigned long wait)
+{
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(wait);
+	unsigned long generation = m_readingsGeneration;
+	size_t length = 0;
+	char *responsePayload = fetchPlugin->readingsFetchBinary(id, count, &length);
+	while (wait && responsePayload && length >= sizeof(RDSFetchHeader)
+			&& ((RDSFetchHeader *)responsePayload)->count == 0
+			&& waitForReadings(generation, deadline))
+	{
+		free(responsePayload);
+		generation = m_readingsGeneration;
+		responsePayload = fetchPlugin->readingsFetchBinary(id, count, &length);
+	}
+	if (!responsePayload)
+	{
+		string payload = "{ \"error\" : \"Failed to fetch readings\" }";
+		respond(response, SimpleWeb::StatusCode::server_error_internal_server_error, payload);
+		return;
+	}
+	*response << "HTTP/1.1 200 OK\r\nContent-Length: " << length << "\r\n"
+		 <<  "Content-type: application/octet-stream\r\n\r\n";
+	response->write(responsePayload, (streamsize)length);
+	free(responsePayload);
+}
+
+/**
+ * Signal to any reading fetch that is waiting that new readings
+ * have been appended
+ */
+void StorageApi::notifyReadings()
+{
+	lock_guard<mutex> guard(m_readingsMutex);
+	m_readingsGeneration++;
+	m_readingsCV.notify_all();
+}
+
+/**
+ * Wait for new readings to be appended
+ *
+ * @param generation	The readings generation seen by the caller
+ * @param deadline	The time at which to give up waiting
+ * @return bool		True if new readings have been appended
+ */
+bool StorageApi::waitForReadings(unsigned long generation, chrono::steady_clock::time_point deadline)
+{
+	unique_lock<mutex> lck(m_readingsMutex);
+#if WORKER_THREADS
+	// A fetch that is waiting is not counted as a busy worker
+	std::atomic_fetch_sub(&m_workers_count, 1);
+#endif
+	bool rval = m_readingsCV.wait_until(lck, deadline, [this, generation] {
+				return m_readingsGeneration != generation; });
+#if WORKER_THREADS
+	std::atomic_fetch_add(&m_workers_count, 1);
+#endif
+	return rval;
+}
+
+/**
+ * Check if a reading fetch result set has no rows
+ *
+ * @param resultSet	The result set returned by the storage plugin
+ * @return bool		True if the rows array of the result set is empty
+ */
+bool StorageApi::emptyReadings(const char *resultSet)
+{
+	const char *p = strstr(resultSet, "\"rows\"");
+	if (!p)
+	{
+		return false;
+	}
+	p += strlen("\"rows\"");
+	while (isspace(*p) || *p == ':')
+		p++;
+	if (*p != '[')
+	{
+		return false;
+	}
+	p++;
+	while (isspace(*p))
+		p++;
+	return *p == ']';
+}
+
 /**
  * Perform a query on a set of readings
  *
@@ -1250,7 +1388,7 @@ string	responsePayload;
 	try {
 		if (!streamHandler)
 		{
-			streamHandler = new StreamHandler(this);
+			streamHandler = new StreamHandler(this, m_streamWriters);
 		}
 		uint32_t token;
 		uint32_t port = streamHandler->createStream(&token);
@@ -1260,6 +1398,8 @@ string	responsePayload;
 			responsePayload += to_string(port);
 			responsePayload += ", \"token\":"; 
 			responsePayload += to_string(token);
+			responsePayload += ", \"version\":"; 
+			responsePayload += to_string(RDS_PROTOCOL_VERSION);
 			responsePayload += " }";
 			respond(response, responsePayload);
 		}
@@ -1273,30 +1413,123 @@ string	responsePayload;
 		}
 }
 
+/**
+ * Create a copy of a streamed reading that has a binary payload, replacing
+ * the payload with the JSON representation of the datapoints.
+ *
+ * @param reading	The streamed reading with a binary payload
+ * @return ReadingStream*	The malloc'd copy or NULL if the payload could not be decoded
+ */
+static ReadingStream *binaryToJSONReading(const ReadingStream *reading)
+{
+	string json;
+	if (!ReadingStreamPayload::toJSON(&reading->assetCode[reading->assetCodeLength],
+				reading->payloadLength, json))
+	{
+		Logger::getLogger()->error("Unable to decode binary payload for asset %s",
+				reading->assetCode);
+		return NULL;
+	}
+	ReadingStream *copy = (ReadingStream *)malloc(sizeof(ReadingStream)
+				+ reading->assetCodeLength + json.length() + 1);
+	if (!copy)
+		return NULL;
+	copy->assetCodeLength = reading->assetCodeLength;
+	copy->payloadLength = json.length() + 1;
+	copy->userTs = reading->userTs;
+	memcpy(copy->assetCode, reading->assetCode, reading->assetCodeLength);
+	memcpy(&copy->assetCode[copy->assetCodeLength], json.c_str(), json.length() + 1);
+	return copy;
+}
+
 /**
  * Append the readings that have arrived via a stream to the storage plugin
  *
+ * Readings may have binary payloads, these are passed directly to plugins
+ * that support binary payloads and converted to JSON for all other plugins.
+ *
  * @param readings	A Null terminated array of points to ReadingStream structures
  * @param commit	A flag to commit the readings block
  */
 bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 {
-	if ((readingPlugin ? readingPlugin : plugin)->hasStreamSupport())
+	bool rval = appendStream(readings, commit);
+	if (commit)
+	{
+		notifyReadings();
+	}
+	return rval;
+}
+
+/**
+ * Pass the readings that have arrived via a stream to the storage plugin
+ *
+ * @param readings	A Null terminated array of points to ReadingStream structures
+ * @param commit	A flag to commit the readings block
+ */
+bool StorageApi::appendStream(ReadingStream **readings, bool commit)
+{
+	StoragePlugin *target = readingPlugin ? readingPlugin : plugin;
+
+	if (target->hasBinaryStreamSupport())
 	{
-		return (readingPlugin ? readingPlugin : plugin)->readingStream(readings, commit);
+		return target->readingStream(readings, commit);
+	}
+	else if (target->hasStreamSupport())
+	{
+		vector<ReadingStream *> stream;
+		vector<ReadingStream *> converted;
+		for (int i = 0; readings[i]; i++)
+		{
+			if (RDS_PAYLOAD_IS_BINARY(&readings[i]->assetCode[readings[i]->assetCodeLength]))
+			{
+				ReadingStream *copy = binaryToJSONReading(readings[i]);
+				if (copy)
+				{
+					converted.push_back(copy);
+					stream.push_back(copy);
+				}
+			}
+			else
+			{
+				stream.push_back(readings[i]);
+			}
+		}
+		if (converted.empty())
+		{
+			return target->readingStream(readings, commit);
+		}
+		stream.push_back(NULL);
+		bool rval = target->readingStream(stream.data(), commit);
+		for (auto copy : converted)
+			free(copy);
+		return rval;
 	}
 	else
 	{
 		// Plugin does not support streaming input
 		ostringstream convert;
 		char	ts[60], micro_s[10];
-		
+		string	json;
+		bool	first = true;
 
 		convert << "{\"readings\":[";
 		for (int i = 0; readings[i]; i++)
 		{
-			if (i > 0)
+			const char *payload = &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			if (RDS_PAYLOAD_IS_BINARY(payload))
+			{
+				if (!ReadingStreamPayload::toJSON(payload, readings[i]->payloadLength, json))
+				{
+					Logger::getLogger()->error("Unable to decode binary payload for asset %s",
+							readings[i]->assetCode);
+					continue;
+				}
+				payload = json.c_str();
+			}
+			if (!first)
 				convert << ",";
+			first = false;
 			convert << "{\"asset_code\":\"";
 			convert << readings[i]->assetCode;
 			convert << "\",\"user_ts\":\"";
@@ -1306,12 +1539,12 @@ bool StorageApi::readingStream(ReadingStream **readings, bool commit)
 			snprintf(micro_s, sizeof(micro_s), ".%06lu", readings[i]->userTs.tv_usec);
 			convert << ts << micro_s;
 			convert << "\",\"reading\":";
-			convert << &(readings[i]->assetCode[readings[i]->assetCodeLength]);
+			convert << payload;
 			convert << "}";
 		}
 		convert << "]}";
 		Logger::getLogger()->debug("Fallback created payload: %s", convert.str().c_str());
-		(readingPlugin ? readingPlugin : plugin)->readingsAppend(convert.str());
+		target->readingsAppend(convert.str());
 	}	
 	return false;
 }
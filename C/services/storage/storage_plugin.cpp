@@ -104,6 +104,9 @@ StoragePlugin::StoragePlugin(const string& name, PLUGIN_HANDLE handle) : Plugin(
 				manager->resolveSymbol(handle, "plugin_reading_append");
 	readingsFetchPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize))
 				manager->resolveSymbol(handle, "plugin_reading_fetch");
+	// Optional entry point, only plugins that hold readings in binary support it
+	readingsFetchBinaryPtr = (char * (*)(PLUGIN_HANDLE, unsigned long id, unsigned int blksize, size_t *))
+				manager->resolveSymbol(handle, "plugin_reading_fetch_binary");
 	readingsRetrievePtr = (char * (*)(PLUGIN_HANDLE, const char *))
 				manager->resolveSymbol(handle, "plugin_reading_retrieve");
 	readingsPurgePtr = (char * (*)(PLUGIN_HANDLE, unsigned long age, unsigned int flags, unsigned long sent))
@@ -220,6 +223,14 @@ char * StoragePlugin::readingsFetch(unsigned long id, unsigned int blksize)
 	return this->readingsFetchPtr(instance, id, blksize);
 }
 
+/**
+ * Call the binary readings fetch method in the plugin
+ */
+char * StoragePlugin::readingsFetchBinary(unsigned long id, unsigned int blksize, size_t *length)
+{
+	return this->readingsFetchBinaryPtr(instance, id, blksize, length);
+}
+
 /**
  * Call the readings retrieve method in the plugin
  */
@@ -16,6 +16,7 @@
 #include <fcntl.h>
 #include <sys/epoll.h>
 #include <sys/ioctl.h>
+#include <sys/eventfd.h>
 #include <chrono>
 #include <unistd.h>
 #include <errno.h>
@@ -34,12 +35,42 @@ static void threadWrapper(void *handler)
 	((StreamHandler *)handler)->handler();
 }
 
+/**
+ * C wrapper for the writer threads that write the batches of readings
+ * received on the streams to the storage plugin.
+ *
+ * @param handler	The StreamHandler instance that started this thread
+ */
+static void writerWrapper(void *handler)
+{
+	((StreamHandler *)handler)->writer();
+}
+
 /**
  * Constructor for the StreamHandler class
+ *
+ * @param api		The storage API instance
+ * @param writers	The number of writer threads to start
  */
-StreamHandler::StreamHandler(StorageApi *api) : m_api(api), m_running(true)
+StreamHandler::StreamHandler(StorageApi *api, unsigned int writers) : m_api(api), m_running(true)
 {
 	m_pollfd = epoll_create(1);
+	m_resumefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if (epoll_ctl(m_pollfd, EPOLL_CTL_ADD, m_resumefd, &event) < 0)
+	{
+		Logger::getLogger()->error("Failed to add the stream resume event to epoll: %s", strerror(errno));
+	}
+	if (writers == 0)
+	{
+		writers = 1;
+	}
+	for (unsigned int i = 0; i < writers; i++)
+	{
+		m_writers.push_back(thread(writerWrapper, this));
+	}
 	m_handlerThread = thread(threadWrapper, this);
 }
 
@@ -47,12 +78,23 @@ StreamHandler::StreamHandler(StorageApi *api) : m_api(api), m_running(true)
 /**
  * Destructor for the StreamHandler. Close down the epoll
  * system and wait for the handler thread to terminate.
+ * The writer threads write any batches already queued
+ * before they terminate.
  */
 StreamHandler::~StreamHandler()
 {
-	m_running = false;
+	{
+		lock_guard<mutex> guard(m_workMutex);
+		m_running = false;
+	}
+	m_workCV.notify_all();
 	close(m_pollfd);
 	m_handlerThread.join();
+	for (auto& writer : m_writers)
+	{
+		writer.join();
+	}
+	close(m_resumefd);
 }
 
 /**
@@ -92,13 +134,98 @@ void StreamHandler::handler()
 				for (int i = 0; i < nfds; i++)
 				{
 					Stream *stream = (Stream *)events[i].data.ptr;
-					stream->handleEvent(m_pollfd, m_api, events[i].events);
+					if (stream)
+						stream->handleEvent(this, events[i].events);
+					else
+						resumeStreams();
 				}
 			}
 		}
 	}
 }
 
+/**
+ * The writer method for the stream handler. A number of threads run this
+ * method, taking streams that have batches of readings to write from the
+ * work queue and writing a batch from each.
+ */
+void StreamHandler::writer()
+{
+	while (1)
+	{
+		Stream *stream;
+		{
+			unique_lock<mutex> lock(m_workMutex);
+			m_workCV.wait(lock, [this] { return !m_work.empty() || !m_running; });
+			if (m_work.empty())
+			{
+				return;
+			}
+			stream = m_work.front();
+			m_work.pop_front();
+		}
+		stream->write(this);
+	}
+}
+
+/**
+ * Add a stream that has batches of readings waiting to the work
+ * queue of the writer threads.
+ *
+ * @param stream	The stream to schedule
+ */
+void StreamHandler::schedule(Stream *stream)
+{
+	{
+		lock_guard<mutex> guard(m_workMutex);
+		m_work.push_back(stream);
+	}
+	m_workCV.notify_one();
+}
+
+/**
+ * Ask the epoll thread to resume reading from a stream that was
+ * suspended because too many of its batches were waiting to be
+ * written. Called by the writer threads.
+ *
+ * @param stream	The stream to resume
+ */
+void StreamHandler::requestResume(Stream *stream)
+{
+	{
+		lock_guard<mutex> guard(m_resumeMutex);
+		m_resume.push_back(stream);
+	}
+	uint64_t one = 1;
+	if (::write(m_resumefd, &one, sizeof(one)) != sizeof(one))
+	{
+		Logger::getLogger()->error("Failed to request the resume of a stream: %s", strerror(errno));
+	}
+}
+
+/**
+ * Resume reading from the streams the writers have caught up with.
+ * Called on the epoll thread, which is the only thread that changes
+ * or closes the stream sockets.
+ */
+void StreamHandler::resumeStreams()
+{
+	uint64_t count;
+	if (read(m_resumefd, &count, sizeof(count)) != sizeof(count))
+	{
+		return;
+	}
+	vector<Stream *> streams;
+	{
+		lock_guard<mutex> guard(m_resumeMutex);
+		streams.swap(m_resume);
+	}
+	for (auto stream : streams)
+	{
+		stream->resume();
+	}
+}
+
 /**
  * Create a new stream and add it to the epoll mechanism for the stream handler
  *
@@ -122,7 +249,7 @@ uint32_t StreamHandler::createStream(uint32_t *token)
 /**
  * Create a stream object to deal with the stream protocol
  */
-StreamHandler::Stream::Stream() : m_status(Closed)
+StreamHandler::Stream::Stream() : m_status(Closed), m_bodyRead(0), m_headerRead(0), m_batch(NULL), m_scheduled(false), m_paused(false)
 {
 }
 
@@ -131,6 +258,10 @@ StreamHandler::Stream::Stream() : m_status(Closed)
  */
 StreamHandler::Stream::~Stream() 
 {
+	reclaim();
+	delete m_batch;
+	for (auto batch : m_freeBatches)
+		delete batch;
 	delete m_blockPool;
 }
 
@@ -193,6 +324,8 @@ struct sockaddr_in	address;
 	*token = m_token;
 
 	// Add to epoll set
+	m_epollfd = epollfd;
+	m_batch = newBatch();
 	m_event.data.ptr = this;
 	m_event.events = EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLPRI | EPOLLERR;
 	if (epoll_ctl(epollfd, EPOLL_CTL_ADD, m_socket, &m_event) < 0)
@@ -224,13 +357,14 @@ void StreamHandler::Stream::setNonBlocking(int fd)
  * reading the block header the individual reading headers and the
  * readings themselves. 
  *
- * TODO Improve memory handling, use seperate threads for inserts, send acknowledgements
+ * TODO Send acknowledgements
  *
- * @param epollfd	The epoll file descriptor
+ * @param handler	The stream handler
+ * @param events	The epoll events for the stream
  */
-void StreamHandler::Stream::handleEvent(int epollfd, StorageApi *api, uint32_t events)
+void StreamHandler::Stream::handleEvent(StreamHandler *handler, uint32_t events)
 {
-ssize_t n;
+int	epollfd = m_epollfd;
 
 	if (events & EPOLLRDHUP)
 	{
@@ -295,22 +429,19 @@ ssize_t n;
 		else if (m_status == AwaitingToken)
 		{
 			RDSConnectHeader	hdr;
-			if (available(m_socket) < sizeof(hdr))
+			if (!readHeader(&hdr, sizeof(hdr)))
 			{
 				return;
 			}
-			if ((n = read(m_socket, &hdr, sizeof(hdr))) != (int)sizeof(hdr))
-			{
-				Logger::getLogger()->warn("Token exchange failed: Short read of %d bytes: %s", n, strerror(errno));
-				return;
-			}
-			if (hdr.magic == RDS_CONNECTION_MAGIC && hdr.token == m_token)
+			if ((hdr.magic == RDS_CONNECTION_MAGIC || hdr.magic == RDS_BINARY_CONNECTION_MAGIC)
+					&& hdr.token == m_token)
 			{
 				m_status = Connected;
 				m_blockNo = 0;
 				m_readingNo = 0;
 				m_protocolState = BlkHdr;
-				Logger::getLogger()->info("Token for streaming socket exchanged");
+				Logger::getLogger()->info("Token for streaming socket exchanged, client sends %s payloads",
+						hdr.magic == RDS_BINARY_CONNECTION_MAGIC ? "binary" : "JSON");
 			}
 			else
 			{
@@ -318,8 +449,15 @@ ssize_t n;
 				close(m_socket);
 			}
 		}
-		else if (m_status == Connected)
+		/*
+		 * The data socket is edge triggered, the client may send the first
+		 * block with the token so fall through to read any data that follows
+		 * the token rather than wait for an event that may not come.
+		 */
+		if (m_status == Connected)
 		{
+			// Return the readings the writers have finished with to the block pool
+			reclaim();
 			/*
 			 * We are connected so loop on the available data reading block headers,
 			 * reading headers and the readings themselves.
@@ -338,17 +476,11 @@ ssize_t n;
 				if (m_protocolState == BlkHdr)
 				{
 					RDSBlockHeader blkHdr;
-					if (available(m_socket) < sizeof(blkHdr))
+					if (!readHeader(&blkHdr, sizeof(blkHdr)))
 					{
 						Logger::getLogger()->debug("Not enough bytes for block header");
 						return;
 					}
-					if ((n = read(m_socket, &blkHdr, sizeof(blkHdr))) != (int)sizeof(blkHdr))
-					{
-						// This should never happen as avialable said we had enough data
-						Logger::getLogger()->warn("Block Header: Short read of %d bytes: %s", n, strerror(errno));
-						return;
-					}
 					if (blkHdr.magic != RDS_BLOCK_MAGIC)
 					{
 						Logger::getLogger()->error("Expected block header %d, but incorrect header found 0x%x", m_blockNo, blkHdr.magic);
@@ -371,26 +503,9 @@ ssize_t n;
 				{
 					// We are expecting a reading header
 					RDSReadingHeader rdhdr;
-					if (available(m_socket) < sizeof(rdhdr))
+					if (!readHeader(&rdhdr, sizeof(rdhdr)))
 					{
-						Logger::getLogger()->warn("Not enough bytes %d for reading header %d in block %d (socket %d)", available(m_socket), m_readingNo, m_blockNo - 1, m_socket);
-						static bool reported = false;
-						if (!reported)
-						{
-							char buf[40];
-							int i;
-							i = recv(m_socket, buf, sizeof(buf), MSG_PEEK);
-							for (int j = 0; j < i; j++)
-								Logger::getLogger()->warn("Byte at %d is %x", j, buf[j]);
-							reported = true;
-						}
-						return;
-					}
-					int n;
-					if ((n = read(m_socket, &rdhdr, sizeof(rdhdr))) < (int)sizeof(rdhdr))
-					{
-						// Should never happen
-						Logger::getLogger()->warn("Not enough bytes read %d for reading header", n);
+						Logger::getLogger()->debug("Not enough bytes for reading header %d in block %d", m_readingNo, m_blockNo - 1);
 						return;
 					}
 					if (rdhdr.magic != RDS_READING_MAGIC)
@@ -416,67 +531,87 @@ ssize_t n;
 					}
 					extra  += 2 * sizeof(uint32_t);
 					m_currentReading = (ReadingStream *)m_blockPool->allocate(m_readingSize + extra);
-					m_readings[m_readingNo % RDS_BLOCK] = m_currentReading;
+					m_batch->push_back(m_currentReading);
 					m_currentReading->assetCodeLength = rdhdr.assetLength;
 					m_currentReading->payloadLength = rdhdr.payloadLength;
 					m_protocolState = RdBody;
 				}
 				else if (m_protocolState == RdBody)
 				{
-					// We are expecting a reading body
-					if (available(m_socket) < m_readingSize)
+					/*
+					 * We are expecting a reading body. Large readings, such as
+					 * those that contain images, will not fit in the socket
+					 * buffer and arrive over a number of events, so we read
+					 * what is available and remember how much of the reading
+					 * we have.
+					 */
+					if (available(m_socket) == 0)
 					{
-						Logger::getLogger()->warn("Not enough bytes %d for reading %d in block %d", m_readingSize, m_readingNo, m_blockNo - 1);
 						return;
 					}
 					struct iovec iov[3];
+					int iovcnt = 0;
 
-					iov[0].iov_base = &m_currentReading->userTs;
-					iov[0].iov_len = sizeof(struct timeval);
-
+					iov[iovcnt].iov_base = &m_currentReading->userTs;
+					iov[iovcnt++].iov_len = sizeof(struct timeval);
 					if (!m_sameAsset)
 					{
-						iov[1].iov_base = &m_currentReading->assetCode;
-						iov[1].iov_len = m_currentReading->assetCodeLength;
-						iov[2].iov_base = &m_currentReading->assetCode[m_currentReading->assetCodeLength];
-						iov[2].iov_len = m_currentReading->payloadLength;
-						int n = readv(m_socket, iov, 3);
-						if (n != m_currentReading->assetCodeLength +
-								m_currentReading->payloadLength + sizeof(struct timeval))
-						{
-							Logger::getLogger()->error("Short red for reading");
-						}
+						iov[iovcnt].iov_base = &m_currentReading->assetCode;
+						iov[iovcnt++].iov_len = m_currentReading->assetCodeLength;
+					}
+					iov[iovcnt].iov_base = &m_currentReading->assetCode[m_currentReading->assetCodeLength];
+					iov[iovcnt++].iov_len = m_currentReading->payloadLength;
 
+					// Skip the part of the reading that has already been read
+					size_t skip = m_bodyRead;
+					int first = 0;
+					while (skip >= iov[first].iov_len)
+					{
+						skip -= iov[first].iov_len;
+						first++;
+					}
+					iov[first].iov_base = (char *)iov[first].iov_base + skip;
+					iov[first].iov_len -= skip;
+
+					int n = readv(m_socket, &iov[first], iovcnt - first);
+					if (n <= 0)
+					{
+						Logger::getLogger()->error("Failed to read reading %d in block %d: %s",
+								m_readingNo, m_blockNo - 1, strerror(errno));
+						return;
+					}
+					m_bodyRead += (size_t)n;
+					if (m_bodyRead < m_readingSize)
+					{
+						continue;
+					}
+					m_bodyRead = 0;
+
+					if (!m_sameAsset)
+					{
 						m_lastAsset = m_currentReading->assetCode;
 					}
 					else
 					{
-						iov[1].iov_base = &m_currentReading->assetCode[m_currentReading->assetCodeLength];
-						iov[1].iov_len = m_currentReading->payloadLength;
-						int n = readv(m_socket, iov, 2);
-						if (n != m_currentReading->payloadLength + sizeof(struct timeval))
-						{
-							Logger::getLogger()->error("Short red for reading");
-						}
 						memcpy(&m_currentReading->assetCode[0], m_lastAsset.c_str(), m_currentReading->assetCodeLength);
 					}
 					m_readingNo++;
 					m_protocolState = RdHdr;
-					if ((m_readingNo % RDS_BLOCK) == 0)
-					{
-						queueInsert(api, RDS_BLOCK, false);
-						for (int i = 0; i < RDS_BLOCK; i++)
-							m_blockPool->release(m_readings[i]);
-					}
-					else if (m_readingNo == m_blockSize)
+					if (m_readingNo == m_blockSize)
 					{
 						// We have completed the block, insert readings and wait
 						// for a block header
-						queueInsert(api, m_readingNo % RDS_BLOCK, true);
-						for (uint32_t i = 0; i < m_readingNo % RDS_BLOCK; i++)
-							m_blockPool->release(m_readings[i]);
+						queueInsert(handler, true);
 						m_protocolState = BlkHdr;
 						Logger::getLogger()->warn("Waiting for the next block header");
+						if (throttle())
+							return;
+					}
+					else if ((m_readingNo % RDS_BLOCK) == 0)
+					{
+						queueInsert(handler, false);
+						if (throttle())
+							return;
 					}
 					else if (m_readingNo > m_blockSize)
 					{
@@ -489,16 +624,167 @@ ssize_t n;
 }
 
 /**
- * Queue a block of readings to be inserted into the database. The readings
- * are available via the m_readings array.
+ * Queue the current batch of readings to be inserted into the database
+ * by one of the writer threads and start a new batch.
  *
- * @param nReadings	The number of readings to insert
+ * @param handler	The stream handler
  * @param commit	Perform commit at end of this block
  */
-void StreamHandler::Stream::queueInsert(StorageApi *api, unsigned int nReadings, bool commit)
+void StreamHandler::Stream::queueInsert(StreamHandler *handler, bool commit)
 {
-	m_readings[nReadings] = NULL;
-	api->readingStream(m_readings, commit);
+	m_batch->push_back(NULL);
+	bool schedule = false;
+	{
+		lock_guard<mutex> guard(m_batchMutex);
+		m_pending.push_back(make_pair(m_batch, commit));
+		if (!m_scheduled)
+		{
+			m_scheduled = true;
+			schedule = true;
+		}
+	}
+	if (schedule)
+	{
+		handler->schedule(this);
+	}
+	m_batch = newBatch();
+}
+
+/**
+ * Write the oldest pending batch of readings of the stream to the
+ * storage plugin. Called by a writer thread, only one writer thread
+ * will be writing the batches of a given stream at any time.
+ *
+ * If more batches are pending the stream is put back on the end of the
+ * work queue, so that the writers share their time between the streams.
+ *
+ * @param handler	The stream handler
+ */
+void StreamHandler::Stream::write(StreamHandler *handler)
+{
+	pair<vector<ReadingStream *> *, bool> batch;
+	{
+		lock_guard<mutex> guard(m_batchMutex);
+		batch = m_pending.front();
+	}
+
+	handler->m_api->readingStream(batch.first->data(), batch.second);
+
+	bool more;
+	bool caughtUp = false;
+	{
+		lock_guard<mutex> guard(m_batchMutex);
+		m_pending.pop_front();
+		m_written.push_back(batch.first);
+		if (m_paused && m_pending.size() < MAX_PENDING_BATCHES)
+		{
+			m_paused = false;
+			caughtUp = true;
+		}
+		more = !m_pending.empty();
+		if (!more)
+		{
+			m_scheduled = false;
+		}
+	}
+	if (caughtUp)
+	{
+		handler->requestResume(this);
+	}
+	if (more)
+	{
+		handler->schedule(this);
+	}
+}
+
+/**
+ * Check if the stream has too many batches waiting to be written. If
+ * it has, stop reading from the socket until the writers catch up. The
+ * data the client sends will back up in the socket and the TCP window
+ * will close, holding back the client.
+ *
+ * @return bool	True if reading from the stream has been suspended
+ */
+bool StreamHandler::Stream::throttle()
+{
+	lock_guard<mutex> guard(m_batchMutex);
+	if (m_pending.size() < MAX_PENDING_BATCHES)
+	{
+		return false;
+	}
+	m_paused = true;
+	// Leave out EPOLLRDHUP so that a client that closes the connection does not lose
+	// the data still waiting in the socket
+	m_event.events = EPOLLHUP | EPOLLERR | EPOLLPRI | EPOLLET;
+	if (epoll_ctl(m_epollfd, EPOLL_CTL_MOD, m_socket, &m_event) == -1)
+	{
+		Logger::getLogger()->error("Failed to suspend reading stream: %s", strerror(errno));
+	}
+	return true;
+}
+
+/**
+ * Resume reading from a stream that was suspended by throttle. Modifying
+ * the epoll events causes an event to be raised if data is already waiting
+ * on the socket. Only called on the epoll thread, so the socket can not be
+ * closed while its events are being modified.
+ */
+void StreamHandler::Stream::resume()
+{
+	{
+		lock_guard<mutex> guard(m_batchMutex);
+		if (m_paused)
+		{
+			// Suspended again since the resume was requested
+			return;
+		}
+	}
+	m_event.events = EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR | EPOLLPRI | EPOLLET;
+	if (m_status == Connected && epoll_ctl(m_epollfd, EPOLL_CTL_MOD, m_socket, &m_event) == -1)
+	{
+		Logger::getLogger()->error("Failed to resume reading stream: %s", strerror(errno));
+	}
+}
+
+/**
+ * Return the readings of the batches that have been written to the
+ * block pool and keep the batch vectors for reuse. Only called from
+ * the epoll thread, which is the only thread that uses the block pool.
+ */
+void StreamHandler::Stream::reclaim()
+{
+	vector<vector<ReadingStream *> *> written;
+	{
+		lock_guard<mutex> guard(m_batchMutex);
+		written.swap(m_written);
+	}
+	for (auto batch : written)
+	{
+		for (auto reading : *batch)
+		{
+			if (reading)
+				m_blockPool->release(reading);
+		}
+		batch->clear();
+		m_freeBatches.push_back(batch);
+	}
+}
+
+/**
+ * Return an empty batch to read readings into, reusing a previously
+ * written batch if there is one.
+ */
+vector<ReadingStream *> *StreamHandler::Stream::newBatch()
+{
+	if (m_freeBatches.empty())
+	{
+		vector<ReadingStream *> *batch = new vector<ReadingStream *>;
+		batch->reserve(RDS_BLOCK + 1);
+		return batch;
+	}
+	vector<ReadingStream *> *batch = m_freeBatches.back();
+	m_freeBatches.pop_back();
+	return batch;
 }
 
 /**
@@ -519,6 +805,45 @@ unsigned int	avail;
 	return avail;
 }
 
+/**
+ * Read a protocol header that may arrive over a number of events.
+ * Whatever part of the header is available is read rather than left
+ * in the socket until the whole header arrives, on loopback the few
+ * bytes left unread can hold a coalesced buffer that fills the receive
+ * buffer and closes the TCP window, so that the rest never arrives.
+ *
+ * @param hdr	The header to fill
+ * @param len	The length of the header
+ * @return	True if the whole header has been read
+ */
+bool StreamHandler::Stream::readHeader(void *hdr, size_t len)
+{
+	unsigned int avail = available(m_socket);
+	if (avail == 0)
+	{
+		return false;
+	}
+	size_t want = len - m_headerRead;
+	if (avail < want)
+	{
+		want = avail;
+	}
+	ssize_t n = read(m_socket, &m_header[m_headerRead], want);
+	if (n <= 0)
+	{
+		Logger::getLogger()->warn("Failed to read header: %s", strerror(errno));
+		return false;
+	}
+	m_headerRead += (size_t)n;
+	if (m_headerRead < len)
+	{
+		return false;
+	}
+	memcpy(hdr, m_header, len);
+	m_headerRead = 0;
+	return true;
+}
+
 /**
  * Block memory pool destructor. Return any memory from the memory pools
  * to the system.
@@ -544,6 +869,17 @@ StreamHandler::Stream::MemoryPool::~MemoryPool()
  */
 void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
 {
+	if (size > RDS_LARGE_READING)
+	{
+		// Large readings are rare, allocate them directly rather than pool them
+		size_t *mem = (size_t *)malloc(size + sizeof(size_t));
+		if (!mem)
+		{
+			throw runtime_error("Insufficient memory for reading");
+		}
+		mem[0] = 0;
+		return &mem[1];
+	}
 	size = rndSize(size);
 	auto blkpool = m_pool.find(size);
 	if (blkpool == m_pool.end())
@@ -572,6 +908,11 @@ void *StreamHandler::Stream::MemoryPool::allocate(size_t size)
 void StreamHandler::Stream::MemoryPool::release(void *memory)
 {
 	size_t poolSize = ((size_t *)memory)[-1];
+	if (poolSize == 0)
+	{
+		free(&((size_t *)memory)[-1]);
+		return;
+	}
 	auto blkpool = m_pool.find(poolSize);
 	if (blkpool == m_pool.end())
 	{
@@ -47,6 +47,7 @@ async def get_all(request: web.Request) -> web.Response:
     response = {}
     for c in counters:
         val = {"average": c["average"], "maximum": c["maximum"], "minimum": c["minimum"], "samples": c["samples"],
+               "p50": c.get("p50"), "p90": c.get("p90"), "p99": c.get("p99"), "p999": c.get("p999"),
                "timestamp": c["ts"], "service": c["service"]}
         monitor.setdefault(c['monitor'], []).append(val)
     monitors = [{'monitor': k, 'values': v} for k, v in monitor.items()]
@@ -62,7 +63,8 @@ async def get_by_service_name(request: web.Request) -> web.Response:
     """
     service = request.match_info.get('service', None)
     storage = connect.get_storage_async()
-    payload = PayloadBuilder().SELECT("average", "maximum", "minimum", "monitor", "samples", "ts").ALIAS(
+    payload = PayloadBuilder().SELECT("average", "maximum", "minimum", "monitor", "samples", "p50", "p90", "p99",
+                                      "p999", "ts").ALIAS(
         "return", ("ts", 'timestamp')).FORMAT("return", ("ts", "YYYY-MM-DD HH24:MI:SS.MS")).WHERE(
         ["service", '=', service]).payload()
     response = {"service": service}
@@ -71,7 +73,8 @@ async def get_by_service_name(request: web.Request) -> web.Response:
         monitor = {}
         for row in result["rows"]:
             val = {"average": row["average"], "maximum": row["maximum"], "minimum": row["minimum"],
-                   "samples": row["samples"], "timestamp": row["timestamp"]}
+                   "samples": row["samples"], "p50": row["p50"], "p90": row["p90"], "p99": row["p99"],
+                   "p999": row["p999"], "timestamp": row["timestamp"]}
             monitor.setdefault(row['monitor'], []).append(val)
         monitors = [{'monitor': k, 'values': v} for k, v in monitor.items()]
         response["monitors"] = monitors
@@ -87,7 +90,8 @@ async def get_by_service_and_counter_name(request: web.Request) -> web.Response:
     counter = request.match_info.get('counter', None)
 
     storage = connect.get_storage_async()
-    payload = PayloadBuilder().SELECT("average", "maximum", "minimum", "samples", "ts").ALIAS(
+    payload = PayloadBuilder().SELECT("average", "maximum", "minimum", "samples", "p50", "p90", "p99", "p999",
+                                      "ts").ALIAS(
         "return", ("ts", 'timestamp')).FORMAT("return", ("ts", "YYYY-MM-DD HH24:MI:SS.MS")).WHERE(
         ["service", '=', service]).AND_WHERE(["monitor", '=', counter]).payload()
     result = await storage.query_tbl_with_payload('monitors', payload)
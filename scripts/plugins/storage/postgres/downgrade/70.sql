@@ -0,0 +1,5 @@
+--Remove the percentile columns from the performance monitors
+ALTER TABLE fledge.monitors DROP COLUMN IF EXISTS p50;
+ALTER TABLE fledge.monitors DROP COLUMN IF EXISTS p90;
+ALTER TABLE fledge.monitors DROP COLUMN IF EXISTS p99;
+ALTER TABLE fledge.monitors DROP COLUMN IF EXISTS p999;
@@ -942,6 +942,10 @@ CREATE TABLE fledge.monitors (
              maximum        bigint,
              average        bigint,
              samples        bigint,
+             p50            bigint,
+             p90            bigint,
+             p99            bigint,
+             p999           bigint,
              ts             timestamp(6) with time zone NOT NULL DEFAULT now()
              );
 
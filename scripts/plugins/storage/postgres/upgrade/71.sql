@@ -0,0 +1,6 @@
+-- Add the percentile columns to the performance monitors
+
+ALTER TABLE fledge.monitors ADD COLUMN p50 bigint;
+ALTER TABLE fledge.monitors ADD COLUMN p90 bigint;
+ALTER TABLE fledge.monitors ADD COLUMN p99 bigint;
+ALTER TABLE fledge.monitors ADD COLUMN p999 bigint;
@@ -704,6 +704,10 @@ CREATE TABLE fledge.monitors (
              maximum       integer,
              average       integer,
              samples       integer,
+             p50           integer,
+             p90           integer,
+             p99           integer,
+             p999          integer,
              ts            DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW'))
              );
 
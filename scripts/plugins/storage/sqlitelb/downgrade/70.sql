@@ -0,0 +1,33 @@
+-- From: http://www.sqlite.org/faq.html:
+--    SQLite has limited ALTER TABLE support that you can use to change type of column.
+--    If you want to change the type of any column you will have to recreate the table.
+--    You can save existing data to a temporary table and then drop the old table
+--    Now, create the new table, then copy the data back in from the temporary table
+
+
+-- Remove the percentile columns from fledge.monitors
+
+-- Rename existing table into a temp one
+DROP INDEX IF EXISTS monitors_ix1;
+ALTER TABLE fledge.monitors RENAME TO monitors_old;
+
+-- Create new table
+CREATE TABLE fledge.monitors (
+             service       character varying(255) NOT NULL,
+             monitor       character varying(80) NOT NULL,
+             minimum       integer,
+             maximum       integer,
+             average       integer,
+             samples       integer,
+             ts            DATETIME DEFAULT (STRFTIME('%Y-%m-%d %H:%M:%f+00:00', 'NOW'))
+             );
+
+CREATE INDEX monitors_ix1
+    ON monitors(service, monitor);
+
+-- Copy data
+INSERT INTO fledge.monitors ( service, monitor, minimum, maximum, average, samples, ts )
+     SELECT service, monitor, minimum, maximum, average, samples, ts FROM fledge.monitors_old;
+
+-- Remove old table
+DROP TABLE IF EXISTS fledge.monitors_old;
@@ -0,0 +1,6 @@
+-- Add the percentile columns to the performance monitors
+
+ALTER TABLE fledge.monitors ADD COLUMN p50 integer;
+ALTER TABLE fledge.monitors ADD COLUMN p90 integer;
+ALTER TABLE fledge.monitors ADD COLUMN p99 integer;
+ALTER TABLE fledge.monitors ADD COLUMN p999 integer;
@@ -0,0 +1,196 @@
+/*
+ * Fledge reading allocation benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading.h>
+#include <reading_arena.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define	ITERATIONS	100000	// Number of times each operation is performed
+#define	BLOCK_SIZE	500	// Readings in each block sent to storage by the ingest class
+
+static unsigned long allocations = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+/*
+ * Count every heap allocation, including those made within the
+ * Fledge libraries and by operator new. This relies on the glibc
+ * allocator entry points.
+ */
+void *malloc(size_t size)
+{
+	allocations++;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	allocations++;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	return __libc_realloc(ptr, size);
+}
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Create a reading typical of a south plugin, a couple of numeric
+ * values, a short status string and a short array of floats
+ */
+static Reading *createReading(long i)
+{
+	vector<Datapoint *> values;
+	DatapointValue counter(i);
+	values.emplace_back(new Datapoint("counter", counter));
+	DatapointValue temperature(21.5);
+	values.emplace_back(new Datapoint("temperature", temperature));
+	DatapointValue status(string("RUNNING"));
+	values.emplace_back(new Datapoint("status", status));
+	DatapointValue position(vector<double>({ 1.0, 2.0, 3.0 }));
+	values.emplace_back(new Datapoint("position", position));
+	return new Reading("pump", values);
+}
+
+/**
+ * Copy the readings a block at a time, as the south ingest class does for
+ * single readings, and delete each block of copies as ingest does once
+ * the block has been sent to storage. The copies are made either on the
+ * heap or in the reading arena.
+ *
+ * @param readings	The readings to copy
+ * @param arena		Copy the readings into the reading arena
+ */
+static void copyBlocks(const vector<Reading *>& readings, bool arena)
+{
+	vector<Reading *> block;
+	block.reserve(BLOCK_SIZE);
+	for (size_t i = 0; i < readings.size(); i += BLOCK_SIZE)
+	{
+		for (size_t j = i; j < i + BLOCK_SIZE && j < readings.size(); j++)
+		{
+			block.push_back(arena ? ReadingArena::copy(*readings[j]) : new Reading(*readings[j]));
+		}
+		if (arena)
+		{
+			ReadingArena::destroy(block);
+		}
+		else
+		{
+			for (auto& reading : block)
+				delete reading;
+			block.clear();
+		}
+	}
+}
+
+/**
+ * Report the allocations and time per operation
+ */
+static void report(const char *name, unsigned long allocs, double elapsed)
+{
+	printf("%-24s %16.2f %16.3f\n", name, (double)allocs / ITERATIONS, elapsed * 1000.0 / ITERATIONS);
+}
+
+/**
+ * Count the heap allocations made constructing, copying, serialising
+ * and reading the values of readings. The copy and delete of the single
+ * readings of the south ingest class is measured with the copies on the
+ * heap and in the reading arena.
+ *
+ * Usage: ReadingAllocationsBenchmark
+ */
+int main(int argc, char **argv)
+{
+	vector<Reading *> readings(ITERATIONS);
+	vector<Reading *> copies(ITERATIONS);
+
+	printf("%-24s %16s %16s\n", "Operation", "Allocations", "Time us");
+
+	unsigned long start = allocations;
+	double t = now();
+	for (long i = 0; i < ITERATIONS; i++)
+		readings[i] = createReading(i);
+	report("Construct", allocations - start, now() - t);
+
+	start = allocations;
+	t = now();
+	for (long i = 0; i < ITERATIONS; i++)
+		copies[i] = new Reading(*readings[i]);
+	report("Copy", allocations - start, now() - t);
+
+	// Each of the ingest copies is run once before it is measured
+	copyBlocks(readings, false);
+	start = allocations;
+	t = now();
+	copyBlocks(readings, false);
+	report("Ingest copy, heap", allocations - start, now() - t);
+
+	copyBlocks(readings, true);
+	start = allocations;
+	t = now();
+	copyBlocks(readings, true);
+	report("Ingest copy, arena", allocations - start, now() - t);
+
+	start = allocations;
+	t = now();
+	size_t length = 0;
+	for (long i = 0; i < ITERATIONS; i++)
+		length += readings[i]->toJSON().length();
+	report("toJSON", allocations - start, now() - t);
+
+	start = allocations;
+	t = now();
+	long total = 0;
+	for (long i = 0; i < ITERATIONS; i++)
+	{
+		const Reading *reading = readings[i];
+		for (auto& dp : reading->getReadingData())
+		{
+			const Datapoint *cdp = dp;
+			if (cdp->getData().getType() == DatapointValue::T_INTEGER)
+				total += cdp->getData().toInt();
+		}
+	}
+	report("Const datapoint access", allocations - start, now() - t);
+
+	start = allocations;
+	t = now();
+	for (long i = 0; i < ITERATIONS; i++)
+	{
+		delete readings[i];
+		delete copies[i];
+	}
+	report("Delete (2 readings)", allocations - start, now() - t);
+
+	if (length == 0 || total == 0)
+		printf("Unexpected results\n");
+	return 0;
+}
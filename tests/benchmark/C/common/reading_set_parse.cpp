@@ -0,0 +1,162 @@
+/*
+ * Fledge reading set parsing benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_set.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <malloc.h>
+#include <string>
+
+using namespace std;
+
+#define	BLOCK_SIZE	5000	// Readings per storage response, as fetched by the north service
+#define	ITERATIONS	20	// Number of responses parsed by each parser
+
+static unsigned long allocations = 0;
+static size_t heap = 0;		// Bytes currently allocated
+static size_t peak = 0;		// Highest value of heap
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+/**
+ * Account for a block of memory that has been allocated
+ */
+static void *allocated(void *ptr)
+{
+	if (ptr)
+	{
+		heap += malloc_usable_size(ptr);
+		if (heap > peak)
+			peak = heap;
+	}
+	return ptr;
+}
+
+/*
+ * Count every heap allocation, and the bytes in use, including those
+ * made within the Fledge libraries and by operator new. This relies on
+ * the glibc allocator entry points.
+ */
+void *malloc(size_t size)
+{
+	allocations++;
+	return allocated(__libc_malloc(size));
+}
+
+void *calloc(size_t n, size_t size)
+{
+	allocations++;
+	return allocated(__libc_calloc(n, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocations++;
+	if (ptr)
+		heap -= malloc_usable_size(ptr);
+	return allocated(__libc_realloc(ptr, size));
+}
+
+void free(void *ptr)
+{
+	if (ptr)
+		heap -= malloc_usable_size(ptr);
+	__libc_free(ptr);
+}
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Create a storage service query response holding a block of readings
+ * with numeric, string, array and nested object datapoints
+ */
+static string createResponse()
+{
+	string response = "{ \"count\" : " + to_string(BLOCK_SIZE) + ", \"rows\" : [ ";
+	char buf[400];
+	for (int i = 0; i < BLOCK_SIZE; i++)
+	{
+		snprintf(buf, sizeof(buf), "%s{ \"id\" : %d, \"asset_code\" : \"pump%d\", "
+			"\"reading\" : { \"counter\" : %d, \"temperature\" : %.3f, "
+			"\"status\" : \"RUNNING\", \"position\" : [ 1.0, 2.0, 3.0 ], "
+			"\"motor\" : { \"speed\" : %d, \"current\" : 4.25 } }, "
+			"\"user_ts\" : \"2023-05-11 10:%02d:%02d.%06d\", "
+			"\"ts\" : \"2023-05-11 10:%02d:%02d.%06d\" }",
+			i ? ", " : "", i + 1, i % 10, i, 20.0 + i / 1000.0, 1450 + i % 50,
+			(i / 60) % 60, i % 60, i, (i / 60) % 60, i % 60, i);
+		response += buf;
+	}
+	response += " ] }";
+	return response;
+}
+
+/**
+ * Parse the response a number of times with the given parser and
+ * report the time and allocations per reading and the peak heap
+ * in use while the reading set is built, over and above the response
+ */
+static void run(const char *name, const string& response, ReadingSet::readingSetParser parser)
+{
+	double elapsed = 0;
+	unsigned long allocs = 0;
+	unsigned long readings = 0;
+	size_t maxPeak = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		string json = response;	// The parse is destructive
+		unsigned long start = allocations;
+		size_t base = heap;
+		peak = heap;
+		double t = now();
+		ReadingSet *set = new ReadingSet(json, parser);
+		elapsed += now() - t;
+		allocs += allocations - start;
+		if (peak - base > maxPeak)
+			maxPeak = peak - base;
+		readings += set->getCount();
+		delete set;
+	}
+	printf("%-12s %16.0f %16.3f %16.2f %16.2f\n", name,
+			readings * 1000.0 / elapsed,
+			elapsed / ITERATIONS,
+			(double)allocs / readings,
+			maxPeak / (1024.0 * 1024.0));
+}
+
+/**
+ * Compare the throughput of the document and streaming parsers
+ * when building a reading set from a storage service response.
+ *
+ * Usage: ReadingSetParseBenchmark
+ */
+int main(int argc, char **argv)
+{
+	string response = createResponse();
+
+	printf("%d readings per block, %lu bytes\n", BLOCK_SIZE, response.length());
+	printf("%-12s %16s %16s %16s %16s\n", "Parser", "Readings/sec", "ms/block", "Allocs/reading", "Peak heap MB");
+
+	run("Document", response, ReadingSet::PARSE_DOCUMENT);
+	run("Stream", response, ReadingSet::PARSE_STREAM);
+	return 0;
+}
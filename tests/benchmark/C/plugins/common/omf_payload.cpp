@@ -0,0 +1,221 @@
+/*
+ * Fledge OMF payload benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <omf.h>
+#include <omfbuffer.h>
+#include <omflinkeddata.h>
+#include <reading.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+#define	READINGS	10000	// Readings in each payload
+#define	ITERATIONS	20	// Number of payloads sent by each method
+
+static unsigned long allocated = 0;
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+/*
+ * Count the bytes of every heap allocation, a copy of the payload
+ * requires an allocation of the size of the payload.
+ */
+void *malloc(size_t size)
+{
+	allocated += size;
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+	allocated += n * size;
+	return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	allocated += size;
+	return __libc_realloc(ptr, size);
+}
+};
+
+/**
+ * A sender that is never used, required to create the OMF class
+ */
+class NullSender : public HttpSender {
+	public:
+		void setProxy(const string& proxy) {};
+		int sendRequest(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload) { return 204; };
+		string getHostPort() { return "localhost:0"; };
+		string getHTTPResponse() { return ""; };
+		void setAuthMethod(string& authMethod) {};
+		void setAuthBasicCredentials(string& authBasicCredentials) {};
+		void setOCSNamespace(string& OCSNamespace) {};
+		void setOCSTenantId(string& OCSTenantId) {};
+		void setOCSClientId(string& OCSClientId) {};
+		void setOCSClientSecret(string& OCSClientSecret) {};
+		void setOCSToken(string& OCSToken) {};
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Create a block of readings spread over 50 assets, each with
+ * three numeric datapoints
+ */
+static void createReadings(vector<Reading *>& readings)
+{
+	for (int i = 0; i < READINGS; i++)
+	{
+		vector<Datapoint *> values;
+		DatapointValue speed((long)(i % 1500));
+		values.emplace_back(new Datapoint("speed", speed));
+		DatapointValue temperature(20.0 + (i % 100) * 0.125);
+		values.emplace_back(new Datapoint("temperature", temperature));
+		DatapointValue pressure(1.0 + (i % 30) * 0.01);
+		values.emplace_back(new Datapoint("pressure", pressure));
+		readings.push_back(new Reading("pump" + to_string(i % 50), values));
+	}
+}
+
+/**
+ * Build the linked data payload of a block of readings as the
+ * OMF plugin does
+ */
+static void buildPayload(OMFBuffer& payload, const vector<Reading *>& readings)
+{
+	unordered_map<string, LALookup> linkedAssetState;
+	OMFLinkedData linkedData(&linkedAssetState, ENDPOINT_CR);
+	linkedData.setSendFullStructure(false);
+	linkedData.buildLookup(readings);
+
+	payload.append('[');
+	bool pendingSeparator = false;
+	for (Reading *reading : readings)
+	{
+		if (linkedData.processReading(payload, pendingSeparator, *reading))
+			pendingSeparator = true;
+	}
+	payload.append(']');
+}
+
+/**
+ * Report the bytes allocated and the time per payload of 10000 readings
+ */
+static void report(const char *name, unsigned long bytes, double elapsed, size_t sent)
+{
+	printf("%-28s %16.2f %16.3f %16.2f\n", name, (double)bytes / ITERATIONS / 1024 / 1024,
+			elapsed / ITERATIONS, (double)sent / ITERATIONS / 1024);
+}
+
+/**
+ * Compare the bytes allocated, which includes every copy of the payload,
+ * and the time taken to produce the body of an OMF data message from the
+ * buffer chain. The previous method coalesced the chain and copied the
+ * result into a string, compressing it if required. The payload is now
+ * copied, or compressed, directly from the chain.
+ *
+ * Usage: OMFPayloadBenchmark
+ */
+int main(int argc, char **argv)
+{
+	NullSender sender;
+	OMF omf("benchmark", sender, "/", 1, "token");
+	vector<Reading *> readings;
+	vector<OMFBuffer *> payloads(ITERATIONS);
+
+	createReadings(readings);
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		payloads[i] = new OMFBuffer();
+		buildPayload(*payloads[i], readings);
+	}
+	printf("Payload of %d readings: %.2f MB\n\n", READINGS, (double)payloads[0]->length() / 1024 / 1024);
+	printf("%-28s %16s %16s %16s\n", "Method", "Allocated MB", "Time ms", "Body KB");
+
+	unsigned long start = allocated;
+	double t = now();
+	size_t sent = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		const char *omfData = payloads[i]->coalesce();
+		string body(omfData);
+		sent += body.length();
+		delete[] omfData;
+	}
+	report("Coalesce", allocated - start, now() - t, sent);
+
+	start = allocated;
+	t = now();
+	sent = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		string body;
+		payloads[i]->coalesce(body);
+		sent += body.length();
+	}
+	report("String from chain", allocated - start, now() - t, sent);
+
+	start = allocated;
+	t = now();
+	sent = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		const char *omfData = payloads[i]->coalesce();
+		string body = omf.compress_string(omfData);
+		sent += body.length();
+		delete[] omfData;
+	}
+	report("Coalesce and compress", allocated - start, now() - t, sent);
+
+	start = allocated;
+	t = now();
+	sent = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		string body = payloads[i]->compress();
+		sent += body.length();
+	}
+	report("Compress from chain", allocated - start, now() - t, sent);
+
+	OMFCompressor compressor;
+	start = allocated;
+	t = now();
+	sent = 0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		string body = compressor.compress(*payloads[i]);
+		sent += body.length();
+	}
+	report("Compressor, reused stream", allocated - start, now() - t, sent);
+
+	for (int i = 0; i < ITERATIONS; i++)
+		delete payloads[i];
+	for (Reading *reading : readings)
+		delete reading;
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Fledge SQLite storage plugin readings fetch benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace rapidjson;
+
+#define	N_ASSETS	10	// Number of assets, and hence readings tables, the backlog is spread over
+#define	APPEND_BLOCK	1000	// Number of readings in each append call
+#define	FETCH_BLOCK	100	// Number of readings requested by each fetch
+#define	REPEAT		10	// Number of times each fetch is timed
+
+extern "C" {
+PLUGIN_INFORMATION *plugin_info();
+PLUGIN_HANDLE plugin_init(ConfigCategory *category);
+int plugin_reading_append(PLUGIN_HANDLE handle, char *readings);
+char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize);
+void plugin_release(PLUGIN_HANDLE handle, char *results);
+bool plugin_shutdown(PLUGIN_HANDLE handle);
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Create a database by running one of the storage plugin init scripts
+ *
+ * @param dataDir	The data directory to create the database in
+ * @param name		The name of the database
+ * @param script	The SQL script to run
+ */
+static bool createDatabase(const string& dataDir, const string& name, const string& script)
+{
+	ifstream in(script);
+	if (!in)
+	{
+		fprintf(stderr, "Unable to read %s, set FLEDGE_ROOT to the source tree\n", script.c_str());
+		return false;
+	}
+	stringstream sql;
+	sql << "PRAGMA page_size = 4096; ATTACH DATABASE '" << dataDir << "/" << name << ".db' AS '" << name << "';";
+	sql << in.rdbuf();
+
+	sqlite3 *db;
+	string path = dataDir + "/" + name + ".db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		fprintf(stderr, "Unable to create %s\n", path.c_str());
+		return false;
+	}
+	char *errMsg = NULL;
+	bool rval = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, &errMsg) == SQLITE_OK;
+	if (!rval)
+	{
+		fprintf(stderr, "Failed to initialise %s: %s\n", path.c_str(), errMsg);
+		sqlite3_free(errMsg);
+	}
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Append readings to the plugin until the backlog reaches the
+ * given number of readings
+ */
+static void fillBacklog(PLUGIN_HANDLE handle, unsigned long& count, unsigned long target)
+{
+	while (count < target)
+	{
+		string payload = "{\"readings\":[";
+		for (int i = 0; i < APPEND_BLOCK && count < target; i++, count++)
+		{
+			char reading[200];
+			snprintf(reading, sizeof(reading),
+				"%s{\"asset_code\":\"asset_%lu\",\"user_ts\":\"2023-01-01 00:00:00.%06lu+00:00\",\"reading\":{\"value\":%lu}}",
+				i ? "," : "", count % N_ASSETS, count % 1000000, count);
+			payload += reading;
+		}
+		payload += "]}";
+		plugin_reading_append(handle, (char *)payload.c_str());
+	}
+}
+
+/**
+ * Time a fetch through the storage plugin and check the block returned
+ * is complete and ordered.
+ */
+static double timeFetch(PLUGIN_HANDLE handle, unsigned long id)
+{
+	double total = 0;
+	for (int i = 0; i < REPEAT; i++)
+	{
+		double start = now();
+		char *result = plugin_reading_fetch(handle, id, FETCH_BLOCK);
+		total += now() - start;
+
+		Document doc;
+		doc.Parse(result);
+		if (doc.HasParseError() || doc["count"].GetInt() != FETCH_BLOCK ||
+				doc["rows"][0]["id"].GetInt64() != (int64_t)id ||
+				doc["rows"][FETCH_BLOCK - 1]["id"].GetInt64() != (int64_t)(id + FETCH_BLOCK - 1))
+		{
+			fprintf(stderr, "Unexpected fetch result for id %lu\n", id);
+			exit(1);
+		}
+		plugin_release(handle, result);
+	}
+	return total / REPEAT;
+}
+
+/**
+ * Time the single UNION ALL query over all the readings tables, ordered
+ * and limited as a whole, that the plugin previously used to fetch readings.
+ */
+static double timeUnion(const string& dataDir, unsigned long id)
+{
+	sqlite3 *db;
+	string path = dataDir + "/fledge.db";
+	sqlite3_open(path.c_str(), &db);
+
+	string tables;
+	for (int dbId = 1; ; dbId++)
+	{
+		string file = dataDir + "/readings_" + to_string(dbId) + ".db";
+		if (access(file.c_str(), F_OK) != 0)
+			break;
+		string alias = "readings_" + to_string(dbId);
+		string attach = "ATTACH DATABASE '" + file + "' AS " + alias + ";";
+		sqlite3_exec(db, attach.c_str(), NULL, NULL, NULL);
+
+		sqlite3_stmt *stmt;
+		string list = "SELECT name FROM " + alias + ".sqlite_master WHERE type = 'table' AND name LIKE 'readings_%'";
+		sqlite3_prepare_v2(db, list.c_str(), -1, &stmt, NULL);
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+		{
+			string name = (const char *)sqlite3_column_text(stmt, 0);
+			bool overflow = name.find("overflow") != string::npos;
+			if (!tables.empty())
+				tables += " UNION ALL ";
+			tables += " SELECT id, " + string(overflow ? "asset_code" : "'" + name + "'") +
+				" asset_code, reading, user_ts, ts FROM " + alias + "." + name +
+				" WHERE id >= " + to_string(id);
+		}
+		sqlite3_finalize(stmt);
+	}
+	string sql = "SELECT id, asset_code, reading, "
+		"strftime('%Y-%m-%d %H:%M:%S', user_ts, 'utc') || substr(user_ts, instr(user_ts, '.'), 7) AS user_ts, "
+		"strftime('%Y-%m-%d %H:%M:%f', ts, 'utc') AS ts FROM (" + tables +
+		") AS tb ORDER BY id ASC LIMIT " + to_string(FETCH_BLOCK);
+
+	double total = 0;
+	for (int i = 0; i < REPEAT; i++)
+	{
+		double start = now();
+		sqlite3_stmt *stmt;
+		sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL);
+		while (sqlite3_step(stmt) == SQLITE_ROW)
+			;
+		sqlite3_finalize(stmt);
+		total += now() - start;
+	}
+	sqlite3_close(db);
+	return total / REPEAT;
+}
+
+/**
+ * Measure the latency of fetching a block of readings from the start
+ * and the middle of a growing backlog of readings.
+ *
+ * Usage: FetchReadingsBenchmark [backlog ...]
+ */
+int main(int argc, char **argv)
+{
+	vector<unsigned long> backlogs;
+	for (int i = 1; i < argc; i++)
+		backlogs.push_back(strtoul(argv[i], NULL, 10));
+	if (backlogs.empty())
+		backlogs = { 1000, 10000, 100000, 1000000 };
+
+	const char *root = getenv("FLEDGE_ROOT");
+	string scripts = string(root ? root : ".") + "/scripts/plugins/storage/sqlite/";
+
+	char dataDir[] = "/tmp/fetch_benchmark_XXXXXX";
+	if (!mkdtemp(dataDir))
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("FLEDGE_DATA", dataDir, 1);
+	Logger::getLogger()->setMinLevel("warning");
+
+	if (!createDatabase(dataDir, "fledge", scripts + "init.sql") ||
+			!createDatabase(dataDir, "readings_1", scripts + "init_readings.sql"))
+	{
+		return 1;
+	}
+
+	ConfigCategory config("sqlite", plugin_info()->config);
+	config.setItemsValueFromDefault();
+	PLUGIN_HANDLE handle = plugin_init(&config);
+
+	printf("%-10s %14s %14s %14s\n", "Backlog", "Fetch head ms", "Fetch mid ms", "Union head ms");
+	unsigned long count = 0;
+	for (auto backlog : backlogs)
+	{
+		fillBacklog(handle, count, backlog);
+		double head = timeFetch(handle, 1);
+		double mid = timeFetch(handle, count / 2);
+		double legacy = timeUnion(dataDir, 1);
+		printf("%-10lu %14.3f %14.3f %14.3f\n", count, head, mid, legacy);
+	}
+
+	plugin_shutdown(handle);
+	string cleanup = string("rm -rf ") + dataDir;
+	system(cleanup.c_str());
+	return 0;
+}
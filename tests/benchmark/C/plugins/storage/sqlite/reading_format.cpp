@@ -0,0 +1,257 @@
+/*
+ * Fledge SQLite storage plugin reading format benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace rapidjson;
+
+#define	N_DATAPOINTS	10	// Number of datapoints in each reading
+#define	APPEND_BLOCK	1000	// Number of readings in each append call
+#define	FETCH_BLOCK	1000	// Number of readings requested by each fetch
+
+extern "C" {
+PLUGIN_INFORMATION *plugin_info();
+PLUGIN_HANDLE plugin_init(ConfigCategory *category);
+int plugin_reading_append(PLUGIN_HANDLE handle, char *readings);
+char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize);
+char *plugin_reading_retrieve(PLUGIN_HANDLE handle, char *condition);
+void plugin_release(PLUGIN_HANDLE handle, char *results);
+bool plugin_shutdown(PLUGIN_HANDLE handle);
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Create a database by running one of the storage plugin init scripts
+ *
+ * @param dataDir	The data directory to create the database in
+ * @param name		The name of the database
+ * @param script	The SQL script to run
+ */
+static bool createDatabase(const string& dataDir, const string& name, const string& script)
+{
+	ifstream in(script);
+	if (!in)
+	{
+		fprintf(stderr, "Unable to read %s, set FLEDGE_ROOT to the source tree\n", script.c_str());
+		return false;
+	}
+	stringstream sql;
+	sql << "PRAGMA page_size = 4096; ATTACH DATABASE '" << dataDir << "/" << name << ".db' AS '" << name << "';";
+	sql << in.rdbuf();
+
+	sqlite3 *db;
+	string path = dataDir + "/" + name + ".db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		fprintf(stderr, "Unable to create %s\n", path.c_str());
+		return false;
+	}
+	char *errMsg = NULL;
+	bool rval = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, &errMsg) == SQLITE_OK;
+	if (!rval)
+	{
+		fprintf(stderr, "Failed to initialise %s: %s\n", path.c_str(), errMsg);
+		sqlite3_free(errMsg);
+	}
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Build an append payload of a block of readings, each with a set
+ * of numeric datapoints typical of a south sensor
+ */
+static string appendPayload(unsigned long first)
+{
+	string payload = "{\"readings\":[";
+	for (unsigned long i = 0; i < APPEND_BLOCK; i++)
+	{
+		char reading[100];
+		unsigned long n = first + i;
+		snprintf(reading, sizeof(reading),
+			"%s{\"asset_code\":\"sensor\",\"user_ts\":\"2023-01-01 00:00:00.%06lu+00:00\",\"reading\":{",
+			i ? "," : "", n % 1000000);
+		payload += reading;
+		for (int dp = 0; dp < N_DATAPOINTS; dp++)
+		{
+			snprintf(reading, sizeof(reading), "%s\"dp%d\":%s", dp ? "," : "", dp,
+				dp % 2 ? to_string(n * dp).c_str() : to_string((n % 1000) * 0.25 + dp).c_str());
+			payload += reading;
+		}
+		payload += "}}";
+	}
+	payload += "]}";
+	return payload;
+}
+
+/**
+ * Return the size of the readings database files in the data directory.
+ * The write ahead log of each database is checkpointed first so that
+ * the readings appended are included in the size of the database.
+ */
+static long databaseSize(const string& dataDir)
+{
+	long size = 0;
+	for (int dbId = 1; ; dbId++)
+	{
+		struct stat st;
+		string file = dataDir + "/readings_" + to_string(dbId) + ".db";
+		if (stat(file.c_str(), &st) != 0)
+			break;
+		sqlite3 *db;
+		if (sqlite3_open(file.c_str(), &db) == SQLITE_OK)
+			sqlite3_exec(db, "PRAGMA wal_checkpoint(TRUNCATE);", NULL, NULL, NULL);
+		sqlite3_close(db);
+		stat(file.c_str(), &st);
+		size += st.st_size;
+	}
+	return size;
+}
+
+/**
+ * Run the benchmark for one reading format and report a row of results.
+ * Each format is run in a child process with its own data directory as
+ * the storage plugin connection manager is a singleton.
+ *
+ * @param format	The readingFormat configuration value
+ * @param readings	The number of readings to store
+ */
+static int runFormat(const string& format, unsigned long readings)
+{
+	const char *root = getenv("FLEDGE_ROOT");
+	string scripts = string(root ? root : ".") + "/scripts/plugins/storage/sqlite/";
+
+	char dataDir[] = "/tmp/format_benchmark_XXXXXX";
+	if (!mkdtemp(dataDir))
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("FLEDGE_DATA", dataDir, 1);
+	Logger::getLogger()->setMinLevel("warning");
+
+	if (!createDatabase(dataDir, "fledge", scripts + "init.sql") ||
+			!createDatabase(dataDir, "readings_1", scripts + "init_readings.sql"))
+	{
+		return 1;
+	}
+
+	ConfigCategory config("sqlite", plugin_info()->config);
+	config.setItemsValueFromDefault();
+	config.setValue("readingFormat", format);
+	PLUGIN_HANDLE handle = plugin_init(&config);
+
+	long empty = databaseSize(dataDir);
+	double append = 0;
+	for (unsigned long count = 0; count < readings; count += APPEND_BLOCK)
+	{
+		string payload = appendPayload(count);
+		double start = now();
+		plugin_reading_append(handle, (char *)payload.c_str());
+		append += now() - start;
+	}
+	long size = databaseSize(dataDir) - empty;
+
+	double fetch = 0;
+	for (unsigned long id = 1; id <= readings; id += FETCH_BLOCK)
+	{
+		double start = now();
+		char *result = plugin_reading_fetch(handle, id, FETCH_BLOCK);
+		fetch += now() - start;
+
+		Document doc;
+		doc.Parse(result);
+		if (doc.HasParseError() || doc["count"].GetInt() != FETCH_BLOCK ||
+				doc["rows"][0]["reading"]["dp1"].GetInt64() != (int64_t)(id - 1))
+		{
+			fprintf(stderr, "Unexpected fetch result for id %lu\n", id);
+			exit(1);
+		}
+		plugin_release(handle, result);
+	}
+
+	const char *query = "{ \"aggregate\" : [ "
+		"{ \"operation\" : \"avg\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"dp1\" }, \"alias\" : \"avg\" }, "
+		"{ \"operation\" : \"max\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"dp2\" }, \"alias\" : \"max\" } ], "
+		"\"where\" : { \"column\" : \"asset_code\", \"condition\" : \"=\", \"value\" : \"sensor\" } }";
+	double start = now();
+	char *result = plugin_reading_retrieve(handle, (char *)query);
+	double aggregate = now() - start;
+	Document doc;
+	doc.Parse(result);
+	if (doc.HasParseError() || doc["count"].GetInt() != 1)
+	{
+		fprintf(stderr, "Unexpected aggregate result %s\n", result);
+		exit(1);
+	}
+	plugin_release(handle, result);
+
+	printf("%-8s %14ld %14.1f %14.3f %14.3f %14.3f\n", format.c_str(), size,
+			(double)size / readings, append * 1000 / readings, fetch * 1000 / readings, aggregate);
+
+	plugin_shutdown(handle);
+	string cleanup = string("rm -rf ") + dataDir;
+	system(cleanup.c_str());
+	return 0;
+}
+
+/**
+ * Compare the on disk size and the CPU time to append, fetch and
+ * aggregate readings stored in the JSON and binary reading formats.
+ *
+ * Usage: ReadingFormatBenchmark [readings]
+ */
+int main(int argc, char **argv)
+{
+	unsigned long readings = 100000;
+	if (argc > 1)
+		readings = strtoul(argv[1], NULL, 10);
+	readings = ((readings + APPEND_BLOCK - 1) / APPEND_BLOCK) * APPEND_BLOCK;
+
+	printf("%-8s %14s %14s %14s %14s %14s\n", "Format", "DB bytes", "Bytes/reading",
+			"Append us", "Fetch us", "Aggregate ms");
+	fflush(stdout);
+	for (const char *format : { "JSON", "Binary" })
+	{
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			exit(runFormat(format, readings));
+		}
+		int status;
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			return 1;
+	}
+	return 0;
+}
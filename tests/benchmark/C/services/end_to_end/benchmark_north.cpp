@@ -0,0 +1,106 @@
+/*
+ * Fledge end to end benchmark north plugin
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <plugin_api.h>
+#include <config_category.h>
+#include <reading.h>
+#include <benchmark_north.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#define QUOTE(...) #__VA_ARGS__
+
+/**
+ * A north plugin that discards the readings it is sent, having recorded
+ * the end to end latency of each of them, used as the destination of
+ * the end to end benchmark.
+ */
+static const char *defaultConfig = QUOTE({
+		"plugin" : {
+			"description" : "Discard readings, recording the end to end latency of each",
+			"type" : "string",
+			"default" : "benchmark",
+			"readonly" : "true"
+		}
+	});
+
+static BenchmarkNorthResults results;
+
+extern "C" {
+
+static PLUGIN_INFORMATION info = {
+	BENCHMARK_NORTH_PLUGIN,		// Name
+	"1.0.0",			// Version
+	0,				// Flags
+	PLUGIN_TYPE_NORTH,		// Type
+	"1.0.0",			// Interface version
+	defaultConfig			// Configuration
+};
+
+/**
+ * Return the information about this plugin
+ */
+PLUGIN_INFORMATION *plugin_info()
+{
+	return &info;
+}
+
+/**
+ * Initialise the plugin
+ */
+PLUGIN_HANDLE plugin_init(ConfigCategory *configData)
+{
+	return (PLUGIN_HANDLE)&results;
+}
+
+/**
+ * Record the latency of each of the readings and discard them
+ *
+ * @param handle	The plugin handle
+ * @param readings	The readings to send
+ * @return uint32_t	The number of readings sent
+ */
+uint32_t plugin_send(const PLUGIN_HANDLE handle, const vector<Reading *>& readings)
+{
+	BenchmarkNorthResults *res = (BenchmarkNorthResults *)handle;
+	struct timeval now, ts;
+	gettimeofday(&now, NULL);
+	{
+		lock_guard<mutex> guard(res->mutex);
+		for (auto reading : readings)
+		{
+			reading->getUserTimestamp(&ts);
+			long latency = (now.tv_sec - ts.tv_sec) * 1000000 + (now.tv_usec - ts.tv_usec);
+			res->latencies.push_back(latency > 0 ? (uint32_t)latency : 0);
+		}
+		res->last = now;
+	}
+	res->blocks++;
+	res->received += readings.size();
+	return readings.size();
+}
+
+/**
+ * Shutdown the plugin, the results are kept for the benchmark to report
+ */
+void plugin_shutdown(PLUGIN_HANDLE handle)
+{
+}
+
+/**
+ * Return the readings received by the plugin
+ */
+BenchmarkNorthResults *benchmark_results()
+{
+	return &results;
+}
+
+};
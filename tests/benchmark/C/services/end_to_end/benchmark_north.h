@@ -0,0 +1,42 @@
+#ifndef _BENCHMARK_NORTH_H
+#define _BENCHMARK_NORTH_H
+/*
+ * Fledge end to end benchmark north plugin
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <sys/time.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define	BENCHMARK_NORTH_PLUGIN	"benchmark"
+#define	BENCHMARK_RESULTS_ENTRY	"benchmark_results"	// Extra entry point that returns the results
+
+/**
+ * The readings received by the benchmark north plugin. The plugin
+ * records the end to end latency of every reading it is sent, that is
+ * the time between the user timestamp given to the reading when it was
+ * ingested and the time the reading reached the plugin.
+ */
+class BenchmarkNorthResults {
+	public:
+		BenchmarkNorthResults() : received(0), blocks(0)
+		{
+			last.tv_sec = 0;
+			last.tv_usec = 0;
+		};
+		std::atomic<unsigned long>	received;	// Number of readings sent to the plugin
+		std::atomic<unsigned long>	blocks;		// Number of calls to plugin_send
+		std::mutex			mutex;		// Guards latencies and last
+		std::vector<uint32_t>		latencies;	// Latency of each reading in microseconds
+		struct timeval			last;		// The time the last reading was received
+};
+
+typedef BenchmarkNorthResults *(*BENCHMARK_RESULTS_FN)();
+
+#endif
@@ -0,0 +1,952 @@
+/*
+ * Fledge end to end benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <storage_api.h>
+#include <storage_plugin.h>
+#include <plugin_manager.h>
+#include <storage_client.h>
+#include <management_api.h>
+#include <management_client.h>
+#include <asset_tracking.h>
+#include <ingest.h>
+#include <data_load.h>
+#include <data_sender.h>
+#include <north_service.h>
+#include <north_plugin.h>
+#include <perfmonitors.h>
+#include <logger.h>
+#include <mock_core.h>
+#include <benchmark_north.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace rapidjson;
+
+#define	SOUTH_SERVICE	"e2e-south"
+#define	NORTH_SERVICE	"e2e-north"
+#define	CPU_SAMPLE_TIME	100	// Milliseconds between samples of the CPU time of each thread
+
+/**
+ * The stages of the pipeline, each thread is accounted to the stage
+ * that created it. Threads inherit the name of the thread that creates
+ * them, the main thread takes the name of each stage as it starts it.
+ */
+static const char *stages[] = { "core", "storage", "south", "north", "source", "benchmark" };
+
+/**
+ * The parameters of a benchmark run
+ */
+class Options {
+	public:
+		Options() : storage("sqlite"), assets(10), datapoints(10),
+			types("integer,float,string"), rate(10000), duration(10),
+			block(100), threshold(100), latency(5000),
+			northBlock(DEFAULT_BLOCK_SIZE), storageThreads(1),
+			drain(60), imageWidth(1280), imageHeight(720), imageDepth(16),
+			jsonTransport(false), keep(false), verbose(false)
+		{
+		};
+		string		storage;	// The main storage plugin
+		string		readingsPlugin;	// The readings storage plugin, if not the main plugin
+		unsigned int	assets;		// The number of distinct assets
+		unsigned int	datapoints;	// The number of datapoints in each reading
+		string		types;		// The datapoint types, used in turn
+		unsigned long	rate;		// Readings per second, 0 for as fast as possible
+		unsigned int	duration;	// Seconds to generate readings for
+		unsigned int	block;		// Readings in each call to ingest
+		unsigned int	threshold;	// South buffer threshold
+		long		latency;	// South maximum send latency in milliseconds
+		unsigned int	northBlock;	// North block size
+		unsigned int	storageThreads;	// Storage service threads
+		unsigned int	drain;		// Seconds to wait for the north to catch up
+		unsigned int	imageWidth;	// Width of image datapoints
+		unsigned int	imageHeight;	// Height of image datapoints
+		unsigned int	imageDepth;	// Bits per pixel of image datapoints
+		string		readingFormat;	// The readingFormat of the storage plugin, if not the default
+		bool		jsonTransport;	// Send images as base64 JSON rather than binary
+		string		output;		// File to write the results to
+		string		compare;	// File of earlier results to compare with
+		string		label;		// Label recorded with the results
+		bool		keep;		// Keep the data directory
+		bool		verbose;	// Report requests to the core
+};
+
+/**
+ * A north service that allows the benchmark to set the management
+ * client the north service classes use, rather than registering with
+ * a core. The service takes ownership of the management client.
+ */
+class BenchmarkNorthService : public NorthService {
+	public:
+		BenchmarkNorthService(const string& name) : NorthService(name) {};
+		void	setManagementClient(ManagementClient *client) { m_mgtClient = client; };
+};
+
+/**
+ * The CPU time used by the threads of each stage. The threads are
+ * sampled regularly so that threads that exit during the run are
+ * accounted for up to their last sample.
+ */
+class StageCPU {
+	public:
+		StageCPU() : m_running(false), m_thread(NULL) {};
+		~StageCPU() { stop(); };
+		void	start();
+		void	stop();
+		void	sample(bool baseline = false);
+		double	milliseconds(const string& stage);
+	private:
+		class ThreadCPU {
+			public:
+				string		stage;
+				unsigned long	base;	// Ticks used before the run
+				unsigned long	ticks;	// Ticks at the last sample
+		};
+		map<pid_t, ThreadCPU>	m_threads;
+		mutex			m_mutex;
+		atomic<bool>		m_running;
+		thread			*m_thread;
+};
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * Name the calling thread, the threads it creates inherit the name
+ */
+static void setStage(const char *stage)
+{
+	pthread_setname_np(pthread_self(), stage);
+}
+
+/**
+ * Take a sample of the CPU time of every thread in the process
+ *
+ * @param baseline	The sample is the baseline the run is measured from
+ */
+void StageCPU::sample(bool baseline)
+{
+	DIR *dir = opendir("/proc/self/task");
+	if (!dir)
+		return;
+	lock_guard<mutex> guard(m_mutex);
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (entry->d_name[0] == '.')
+			continue;
+		string task = string("/proc/self/task/") + entry->d_name;
+		ifstream statFile(task + "/stat");
+		string stat;
+		getline(statFile, stat);
+		// The fields following the name, which may contain spaces, start with the state
+		size_t end = stat.rfind(')');
+		if (end == string::npos)
+			continue;
+		istringstream fields(stat.substr(end + 2));
+		string field;
+		unsigned long utime = 0, stime = 0;
+		for (int i = 3; i <= 15 && fields >> field; i++)
+		{
+			if (i == 14)
+				utime = strtoul(field.c_str(), NULL, 10);
+			else if (i == 15)
+				stime = strtoul(field.c_str(), NULL, 10);
+		}
+		pid_t tid = (pid_t)strtol(entry->d_name, NULL, 10);
+		auto it = m_threads.find(tid);
+		if (it == m_threads.end())
+		{
+			ifstream commFile(task + "/comm");
+			ThreadCPU cpu;
+			getline(commFile, cpu.stage);
+			cpu.base = baseline ? utime + stime : 0;
+			cpu.ticks = utime + stime;
+			m_threads[tid] = cpu;
+		}
+		else
+		{
+			it->second.ticks = utime + stime;
+			if (baseline)
+				it->second.base = it->second.ticks;
+		}
+	}
+	closedir(dir);
+}
+
+/**
+ * Start sampling the threads
+ */
+void StageCPU::start()
+{
+	sample(true);
+	m_running = true;
+	m_thread = new thread([this]() {
+		while (m_running)
+		{
+			this_thread::sleep_for(chrono::milliseconds(CPU_SAMPLE_TIME));
+			sample();
+		}
+	});
+}
+
+/**
+ * Stop sampling the threads, having taken a final sample
+ */
+void StageCPU::stop()
+{
+	if (m_thread)
+	{
+		m_running = false;
+		m_thread->join();
+		delete m_thread;
+		m_thread = NULL;
+		sample();
+	}
+}
+
+/**
+ * Return the CPU time used by the threads of a stage during the run
+ *
+ * @param stage	The stage name
+ * @return double	The CPU time in milliseconds
+ */
+double StageCPU::milliseconds(const string& stage)
+{
+	lock_guard<mutex> guard(m_mutex);
+	unsigned long ticks = 0;
+	for (auto& t : m_threads)
+	{
+		if (t.second.stage.compare(stage) == 0)
+			ticks += t.second.ticks - t.second.base;
+	}
+	return ticks * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+/**
+ * Create a database by running one of the storage plugin init scripts
+ *
+ * @param dataDir	The data directory to create the database in
+ * @param name		The name of the database
+ * @param script	The SQL script to run
+ */
+static bool createDatabase(const string& dataDir, const string& name, const string& script)
+{
+	ifstream in(script);
+	if (!in)
+	{
+		fprintf(stderr, "Unable to read %s, set FLEDGE_ROOT to the source tree\n", script.c_str());
+		return false;
+	}
+	stringstream sql;
+	sql << "PRAGMA page_size = 4096; ATTACH DATABASE '" << dataDir << "/" << name << ".db' AS '" << name << "';";
+	sql << in.rdbuf();
+
+	sqlite3 *db;
+	string path = dataDir + "/" + name + ".db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		fprintf(stderr, "Unable to create %s\n", path.c_str());
+		return false;
+	}
+	char *errMsg = NULL;
+	bool rval = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, &errMsg) == SQLITE_OK;
+	if (!rval)
+	{
+		fprintf(stderr, "Failed to initialise %s: %s\n", path.c_str(), errMsg);
+		sqlite3_free(errMsg);
+	}
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Create the databases the SQLite based storage plugins expect. Other
+ * plugins, such as postgres, must have been set up beforehand.
+ *
+ * @param dataDir	The data directory
+ * @param options	The benchmark options
+ */
+static bool createDatabases(const string& dataDir, const Options& options)
+{
+	const char *root = getenv("FLEDGE_ROOT");
+	string scripts = string(root ? root : ".") + "/scripts/plugins/storage/";
+
+	if (options.storage.compare("sqlite") == 0 || options.storage.compare("sqlitelb") == 0)
+	{
+		if (!createDatabase(dataDir, "fledge", scripts + options.storage + "/init.sql"))
+			return false;
+	}
+	string readings = options.readingsPlugin.empty() ? options.storage : options.readingsPlugin;
+	if (readings.compare("sqlite") == 0)
+		return createDatabase(dataDir, "readings_1", scripts + "sqlite/init_readings.sql");
+	if (readings.compare("sqlitelb") == 0)
+		return createDatabase(dataDir, "readings", scripts + "sqlitelb/init_readings.sql");
+	return true;
+}
+
+/**
+ * Return the number of bytes in the files below a directory
+ *
+ * @param path	The directory
+ */
+static unsigned long diskUsage(const string& path)
+{
+	unsigned long size = 0;
+	DIR *dir = opendir(path.c_str());
+	if (!dir)
+		return 0;
+	struct dirent *entry;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+			continue;
+		string file = path + "/" + entry->d_name;
+		struct stat st;
+		if (lstat(file.c_str(), &st) != 0)
+			continue;
+		if (S_ISDIR(st.st_mode))
+			size += diskUsage(file);
+		else
+			size += st.st_size;
+	}
+	closedir(dir);
+	return size;
+}
+
+/**
+ * Wait for the storage API to start listening and return its port
+ *
+ * @param api	The storage API
+ */
+static unsigned short listenerPort(StorageApi *api)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		try {
+			unsigned short port = api->getListenerPort();
+			if (port)
+				return port;
+		} catch (exception& e) {
+			// The listener is not yet open
+		}
+		usleep(10000);
+	}
+	return 0;
+}
+
+/**
+ * Load a storage plugin
+ *
+ * @param name		The name of the plugin
+ * @param readingFormat	The reading format to configure, if not empty
+ * @return StoragePlugin*	The plugin or NULL if it could not be loaded
+ */
+static StoragePlugin *loadStoragePlugin(const string& name, const string& readingFormat)
+{
+	PluginManager *manager = PluginManager::getInstance();
+	manager->setPluginType(PLUGIN_TYPE_ID_STORAGE);
+	PLUGIN_HANDLE handle = manager->loadPlugin(name, PLUGIN_TYPE_STORAGE);
+	if (!handle)
+	{
+		fprintf(stderr, "Unable to load the %s storage plugin, check FLEDGE_PLUGIN_PATH\n",
+				name.c_str());
+		return NULL;
+	}
+	if (!readingFormat.empty())
+	{
+		// Write the configuration cache the plugin configuration is read from
+		ConfigCategory config(name, manager->getInfo(handle)->config);
+		config.setItemsValueFromDefault();
+		if (!config.itemExists("readingFormat") || !config.setValue("readingFormat", readingFormat))
+		{
+			fprintf(stderr, "The %s storage plugin has no reading format\n", name.c_str());
+			return NULL;
+		}
+		ofstream cache(string(getenv("FLEDGE_DATA")) + "/etc/" + name + ".json");
+		cache << config.itemsToJSON();
+	}
+	return new StoragePlugin(name, handle);
+}
+
+/**
+ * Generate readings at the requested rate and pass them to the ingest
+ * class, as a south plugin would. Each reading has the configured
+ * number of datapoints, taking each of the configured types in turn,
+ * and readings cycle through the assets.
+ *
+ * @param ingest	The ingest class to pass the readings to
+ * @param options	The benchmark options
+ * @param running	Readings are generated while this is true
+ * @param generated	The number of readings generated
+ */
+static void generateReadings(Ingest *ingest, const Options& options, atomic<bool> *running,
+		atomic<unsigned long> *generated)
+{
+	vector<string> types;
+	stringstream list(options.types);
+	string type;
+	while (getline(list, type, ','))
+		types.push_back(type);
+	vector<string> assets;
+	for (unsigned int i = 0; i < options.assets; i++)
+		assets.push_back("e2e_asset_" + to_string(i));
+	vector<double> array = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+	vector<uint8_t> pixels(options.imageWidth * options.imageHeight * (options.imageDepth / 8));
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = i * 31;
+
+	double start = now();
+	unsigned long n = 0;
+	while (*running)
+	{
+		vector<Reading *> readings;
+		for (unsigned int r = 0; r < options.block; r++, n++)
+		{
+			vector<Datapoint *> values;
+			for (unsigned int d = 0; d < options.datapoints; d++)
+			{
+				const string& dpType = types[d % types.size()];
+				string name = "dp" + to_string(d);
+				if (dpType.compare("integer") == 0)
+				{
+					DatapointValue value((long)(n + d));
+					values.push_back(new Datapoint(name, value));
+				}
+				else if (dpType.compare("float") == 0)
+				{
+					DatapointValue value((n % 1000) * 0.25 + d);
+					values.push_back(new Datapoint(name, value));
+				}
+				else if (dpType.compare("string") == 0)
+				{
+					DatapointValue value("value " + to_string(n % 100));
+					values.push_back(new Datapoint(name, value));
+				}
+				else if (dpType.compare("image") == 0)
+				{
+					DPImage *image = new DPImage(options.imageWidth, options.imageHeight,
+							options.imageDepth, pixels.data());
+					values.push_back(new Datapoint(name, DatapointValue(image)));
+				}
+				else
+				{
+					DatapointValue value(array);
+					values.push_back(new Datapoint(name, value));
+				}
+			}
+			readings.push_back(new Reading(assets[n % assets.size()], values));
+		}
+		if (options.block == 1)
+		{
+			ingest->ingest(*readings[0]);
+			delete readings[0];
+		}
+		else
+		{
+			ingest->ingest(&readings);
+		}
+		*generated += options.block;
+
+		if (options.rate)
+		{
+			double due = start + (n * 1000.0) / options.rate;
+			double wait = due - now();
+			if (wait > 0)
+				this_thread::sleep_for(chrono::microseconds((long)(wait * 1000)));
+		}
+	}
+}
+
+/**
+ * Return a percentile of a sorted set of latencies
+ */
+static double percentile(const vector<uint32_t>& sorted, double pct)
+{
+	if (sorted.empty())
+		return 0;
+	size_t index = (size_t)(sorted.size() * pct / 100);
+	if (index >= sorted.size())
+		index = sorted.size() - 1;
+	return sorted[index] / 1000.0;
+}
+
+/**
+ * Write the parameters and results as a JSON document
+ *
+ * @param file		The file to write
+ * @param options	The benchmark options
+ * @param results	The named results
+ */
+static bool writeResults(const string& file, const Options& options,
+		const vector<pair<string, double>>& results)
+{
+	FILE *fp = fopen(file.c_str(), "w");
+	if (!fp)
+	{
+		perror(file.c_str());
+		return false;
+	}
+	char date[40];
+	time_t t = time(0);
+	strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", gmtime(&t));
+	fprintf(fp, "{\n  \"benchmark\" : \"EndToEndBenchmark\",\n");
+	fprintf(fp, "  \"label\" : \"%s\",\n  \"date\" : \"%s\",\n", options.label.c_str(), date);
+	fprintf(fp, "  \"parameters\" : {\n");
+	fprintf(fp, "    \"storage\" : \"%s\",\n    \"readingsPlugin\" : \"%s\",\n",
+			options.storage.c_str(),
+			options.readingsPlugin.empty() ? options.storage.c_str() : options.readingsPlugin.c_str());
+	fprintf(fp, "    \"assets\" : %u,\n    \"datapoints\" : %u,\n    \"types\" : \"%s\",\n",
+			options.assets, options.datapoints, options.types.c_str());
+	fprintf(fp, "    \"rate\" : %lu,\n    \"duration\" : %u,\n    \"block\" : %u,\n",
+			options.rate, options.duration, options.block);
+	fprintf(fp, "    \"threshold\" : %u,\n    \"latency\" : %ld,\n    \"northBlock\" : %u,\n",
+			options.threshold, options.latency, options.northBlock);
+	fprintf(fp, "    \"storageThreads\" : %u,\n", options.storageThreads);
+	fprintf(fp, "    \"image\" : \"%ux%ux%u\",\n    \"readingFormat\" : \"%s\",\n",
+			options.imageWidth, options.imageHeight, options.imageDepth,
+			options.readingFormat.c_str());
+	fprintf(fp, "    \"transport\" : \"%s\"\n  },\n", options.jsonTransport ? "json" : "binary");
+	fprintf(fp, "  \"results\" : {\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		fprintf(fp, "    \"%s\" : %.3f%s\n", results[i].first.c_str(), results[i].second,
+				i + 1 < results.size() ? "," : "");
+	}
+	fprintf(fp, "  }\n}\n");
+	fclose(fp);
+	return true;
+}
+
+/**
+ * Compare the results with those of an earlier run
+ *
+ * @param file		The results file of the earlier run
+ * @param results	The results of this run
+ */
+static bool compareResults(const string& file, const vector<pair<string, double>>& results)
+{
+	ifstream in(file);
+	if (!in)
+	{
+		fprintf(stderr, "Unable to read %s\n", file.c_str());
+		return false;
+	}
+	stringstream json;
+	json << in.rdbuf();
+	Document doc;
+	doc.Parse(json.str().c_str());
+	if (doc.HasParseError() || !doc.HasMember("results") || !doc["results"].IsObject())
+	{
+		fprintf(stderr, "%s is not a results file\n", file.c_str());
+		return false;
+	}
+	const Value& previous = doc["results"];
+	printf("\nCompared with %s", file.c_str());
+	if (doc.HasMember("label") && doc["label"].IsString() && doc["label"].GetStringLength())
+		printf(" (%s)", doc["label"].GetString());
+	printf("\n%-24s %16s %16s %10s\n", "Result", "Previous", "Current", "Change %");
+	for (auto& result : results)
+	{
+		if (!previous.HasMember(result.first.c_str()) || !previous[result.first.c_str()].IsNumber())
+			continue;
+		double before = previous[result.first.c_str()].GetDouble();
+		printf("%-24s %16.3f %16.3f", result.first.c_str(), before, result.second);
+		if (before != 0)
+			printf(" %10.1f", (result.second - before) * 100 / before);
+		printf("\n");
+	}
+	return true;
+}
+
+/**
+ * Print the usage of the benchmark
+ */
+static void usage()
+{
+	Options d;
+	printf("Usage: EndToEndBenchmark [options]\n\n");
+	printf("  --storage=PLUGIN          Main storage plugin (%s)\n", d.storage.c_str());
+	printf("  --readings-plugin=PLUGIN  Readings storage plugin (the main plugin)\n");
+	printf("  --assets=N                Number of assets (%u)\n", d.assets);
+	printf("  --datapoints=N            Datapoints per reading (%u)\n", d.datapoints);
+	printf("  --types=LIST              Datapoint types from integer, float, string, array and image (%s)\n", d.types.c_str());
+	printf("  --rate=N                  Readings per second, 0 for as fast as possible (%lu)\n", d.rate);
+	printf("  --duration=SECONDS        Time to generate readings for (%u)\n", d.duration);
+	printf("  --block=N                 Readings in each call to ingest (%u)\n", d.block);
+	printf("  --threshold=N             South buffer threshold (%u)\n", d.threshold);
+	printf("  --latency=MS              South maximum send latency (%ld)\n", d.latency);
+	printf("  --north-block=N           North block size (%u)\n", d.northBlock);
+	printf("  --storage-threads=N       Storage service threads (%u)\n", d.storageThreads);
+	printf("  --drain=SECONDS           Time to wait for the north to catch up (%u)\n", d.drain);
+	printf("  --image=WxHxD             Width, height and bits per pixel of images (%ux%ux%u)\n",
+			d.imageWidth, d.imageHeight, d.imageDepth);
+	printf("  --reading-format=FORMAT   Reading format of the storage plugin, JSON or Binary\n");
+	printf("  --json-transport          Send images to and from storage as base64 JSON\n");
+	printf("  --output=FILE             Write the results as JSON\n");
+	printf("  --compare=FILE            Compare the results with an earlier results file\n");
+	printf("  --label=TEXT              Label to record with the results, such as a commit\n");
+	printf("  --keep                    Keep the data directory\n");
+	printf("  --verbose                 Report requests to the core that are not handled\n");
+}
+
+/**
+ * Parse the command line options
+ *
+ * @param argc		The number of arguments
+ * @param argv		The arguments
+ * @param options	The options to populate
+ * @return bool		True if the options are valid
+ */
+static bool parseOptions(int argc, char **argv, Options& options)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		string value;
+		size_t eq = arg.find('=');
+		if (eq != string::npos)
+		{
+			value = arg.substr(eq + 1);
+			arg = arg.substr(0, eq);
+		}
+		if (arg == "--storage")
+			options.storage = value;
+		else if (arg == "--readings-plugin")
+			options.readingsPlugin = value;
+		else if (arg == "--assets")
+			options.assets = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--datapoints")
+			options.datapoints = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--types")
+			options.types = value;
+		else if (arg == "--rate")
+			options.rate = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--duration")
+			options.duration = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--block")
+			options.block = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--threshold")
+			options.threshold = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--latency")
+			options.latency = strtol(value.c_str(), NULL, 10);
+		else if (arg == "--north-block")
+			options.northBlock = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--storage-threads")
+			options.storageThreads = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--drain")
+			options.drain = strtoul(value.c_str(), NULL, 10);
+		else if (arg == "--image")
+		{
+			if (sscanf(value.c_str(), "%ux%ux%u", &options.imageWidth,
+					&options.imageHeight, &options.imageDepth) != 3)
+				return false;
+		}
+		else if (arg == "--reading-format")
+			options.readingFormat = value;
+		else if (arg == "--json-transport")
+			options.jsonTransport = true;
+		else if (arg == "--output")
+			options.output = value;
+		else if (arg == "--compare")
+			options.compare = value;
+		else if (arg == "--label")
+			options.label = value;
+		else if (arg == "--keep")
+			options.keep = true;
+		else if (arg == "--verbose")
+			options.verbose = true;
+		else
+			return false;
+	}
+	return options.assets > 0 && options.datapoints > 0 && !options.types.empty() &&
+		options.block > 0 && options.threshold > 0 && options.northBlock > 0 &&
+		options.storageThreads > 0 && options.imageWidth > 0 && options.imageHeight > 0 &&
+		options.imageDepth >= 8 && options.imageDepth % 8 == 0;
+}
+
+/**
+ * Measure the throughput, end to end latency, disk use and CPU use of
+ * the south to storage to north path of Fledge. The storage service,
+ * south ingest and north data loading and sending run within the
+ * benchmark, without the Python core, with synthetic readings
+ * generated as the south plugin and a north plugin that discards the
+ * readings it is sent.
+ *
+ * Usage: EndToEndBenchmark [options]
+ */
+int main(int argc, char **argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options))
+	{
+		usage();
+		return 1;
+	}
+
+	char dataDir[] = "/tmp/end_to_end_XXXXXX";
+	if (!mkdtemp(dataDir))
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+	setenv("FLEDGE_DATA", dataDir, 1);
+	mkdir((string(dataDir) + "/etc").c_str(), 0755);
+
+	// The storage plugins and the benchmark north plugin are found in
+	// the benchmark build, after any given by the caller
+	const char *pluginPath = getenv("FLEDGE_PLUGIN_PATH");
+	string path = pluginPath ? string(pluginPath) + ";" BENCHMARK_PLUGIN_DIR : BENCHMARK_PLUGIN_DIR;
+	setenv("FLEDGE_PLUGIN_PATH", path.c_str(), 1);
+
+	Logger *logger = new Logger("EndToEndBenchmark");
+	logger->setMinLevel("warning");
+
+	if (!createDatabases(dataDir, options))
+		return 1;
+
+	// The management API the services talk to in place of the core
+	setStage("core");
+	MockCore *core = new MockCore();
+	core->setVerbose(options.verbose);
+	unsigned short corePort = core->getListenerPort();
+
+	// The storage service
+	setStage("storage");
+	StoragePlugin *storagePlugin = loadStoragePlugin(options.storage,
+			options.readingsPlugin.empty() ? options.readingFormat : "");
+	if (!storagePlugin)
+		return 1;
+	StoragePlugin *readingPlugin = NULL;
+	if (!options.readingsPlugin.empty() && options.readingsPlugin.compare(options.storage))
+	{
+		if ((readingPlugin = loadStoragePlugin(options.readingsPlugin, options.readingFormat)) == NULL)
+			return 1;
+	}
+	// The storage API registers its statistics with the management API instance,
+	// which is never started and so is left for process exit to release
+	ManagementApi *storageManagement = new ManagementApi("Fledge Storage", 0);
+	StorageApi *api = new StorageApi(0, options.storageThreads);
+	api->setPlugin(storagePlugin);
+	if (readingPlugin)
+		api->setReadingPlugin(readingPlugin);
+	api->initResources();
+	api->start();
+	unsigned short storagePort = listenerPort(api);
+	core->setStoragePort(storagePort);
+
+	StorageClient storage("127.0.0.1", storagePort);
+	if (options.jsonTransport)
+	{
+		storage.streamBinaryData(false);
+		storage.setBinaryFetch(false);
+	}
+	ManagementClient *management = new ManagementClient("127.0.0.1", corePort);
+
+	// The south service ingest
+	setStage("south");
+	AssetTracker *tracker = new AssetTracker(management, SOUTH_SERVICE);
+	PerformanceMonitor southMonitor(SOUTH_SERVICE, &storage);
+	Ingest *ingest = new Ingest(storage, SOUTH_SERVICE, "benchmark", management);
+	ingest->setPerfMon(&southMonitor);
+	ingest->start(options.latency, options.threshold);
+
+	// The north service data loading and sending
+	setStage("north");
+	BenchmarkNorthService *north = new BenchmarkNorthService(NORTH_SERVICE);
+	north->setManagementClient(management);
+	logger->setMinLevel("warning");
+	PluginManager *manager = PluginManager::getInstance();
+	manager->setPluginType(PLUGIN_TYPE_ID_OTHER);
+	PLUGIN_HANDLE handle = manager->loadPlugin(BENCHMARK_NORTH_PLUGIN, PLUGIN_TYPE_NORTH);
+	if (!handle)
+	{
+		fprintf(stderr, "Unable to load the benchmark north plugin\n");
+		return 1;
+	}
+	ConfigCategory northConfig(NORTH_SERVICE, manager->getInfo(handle)->config);
+	northConfig.setItemsValueFromDefault();
+	NorthPlugin *northPlugin = new NorthPlugin(handle, northConfig);
+	northPlugin->start();
+	BenchmarkNorthResults *received = ((BENCHMARK_RESULTS_FN)
+				manager->resolveSymbol(handle, BENCHMARK_RESULTS_ENTRY))();
+	DataLoad *dataLoad = new DataLoad(north->getName(), 0, &storage);
+	dataLoad->setBlockSize(options.northBlock);
+	DataSender *dataSender = new DataSender(northPlugin, dataLoad, north);
+
+	// Generate readings for the duration of the run
+	setStage("benchmark");
+	StageCPU cpu;
+	cpu.start();
+	atomic<bool> running(true);
+	atomic<unsigned long> generated(0);
+	double start = now();
+	setStage("source");
+	thread source(generateReadings, ingest, options, &running, &generated);
+	setStage("benchmark");
+	while (now() - start < options.duration * 1000.0)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+	}
+	running = false;
+	source.join();
+	double generateTime = now() - start;
+
+	// Wait for the north to receive every reading, or stop making progress
+	unsigned long last = 0;
+	double progress = now();
+	while (received->received < generated && now() - progress < options.drain * 1000.0)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+		if (received->received != last)
+		{
+			last = received->received;
+			progress = now();
+		}
+	}
+	cpu.stop();
+
+	vector<uint32_t> latencies;
+	double end;
+	{
+		lock_guard<mutex> guard(received->mutex);
+		latencies = received->latencies;
+		end = received->last.tv_sec * 1000.0 + received->last.tv_usec / 1000.0;
+	}
+	sort(latencies.begin(), latencies.end());
+	unsigned long count = latencies.size();
+	double elapsed = count ? end - start : generateTime;
+	unsigned long disk = diskUsage(dataDir);
+
+	vector<pair<string, double>> results;
+	results.push_back(make_pair("generated", (double)generated));
+	results.push_back(make_pair("received", (double)count));
+	results.push_back(make_pair("elapsedSeconds", elapsed / 1000));
+	results.push_back(make_pair("readingsPerSec", count * 1000.0 / elapsed));
+	// Datapoints take the types in turn, count those that are images
+	vector<string> types;
+	stringstream typeList(options.types);
+	string type;
+	while (getline(typeList, type, ','))
+		types.push_back(type);
+	unsigned int images = 0;
+	for (unsigned int d = 0; d < options.datapoints; d++)
+	{
+		if (types[d % types.size()].compare("image") == 0)
+			images++;
+	}
+	double imageBytes = (double)options.imageWidth * options.imageHeight * (options.imageDepth / 8);
+	if (images)
+	{
+		results.push_back(make_pair("framesPerSec", count * images * 1000.0 / elapsed));
+		results.push_back(make_pair("imageMBPerSec", count * images * imageBytes / (elapsed * 1000)));
+	}
+	results.push_back(make_pair("latencyP50Ms", percentile(latencies, 50)));
+	results.push_back(make_pair("latencyP99Ms", percentile(latencies, 99)));
+	results.push_back(make_pair("latencyMaxMs", percentile(latencies, 100)));
+	results.push_back(make_pair("diskBytes", (double)disk));
+	results.push_back(make_pair("diskBytesPerReading", count ? (double)disk / count : 0));
+	for (const char *stage : stages)
+	{
+		double ms = cpu.milliseconds(stage);
+		results.push_back(make_pair(string("cpu.") + stage + ".ms", ms));
+		results.push_back(make_pair(string("cpu.") + stage + ".usPerReading",
+					count ? ms * 1000 / count : 0));
+	}
+
+	printf("Storage %s", options.storage.c_str());
+	if (!options.readingsPlugin.empty())
+		printf(", readings %s", options.readingsPlugin.c_str());
+	printf(", %u assets, %u datapoints (%s), %lu readings/sec for %us\n",
+			options.assets, options.datapoints, options.types.c_str(),
+			options.rate, options.duration);
+	printf("Readings generated %lu, received %lu in %.3fs\n", (unsigned long)generated,
+			count, elapsed / 1000);
+	printf("Throughput %.0f readings/sec\n", count * 1000.0 / elapsed);
+	if (images)
+	{
+		printf("Images %ux%ux%u via %s transport, %.1f frames/sec, %.1f MB/sec\n",
+				options.imageWidth, options.imageHeight, options.imageDepth,
+				options.jsonTransport ? "JSON" : "binary",
+				count * images * 1000.0 / elapsed,
+				count * images * imageBytes / (elapsed * 1000));
+	}
+	printf("Latency p50 %.3fms, p99 %.3fms, max %.3fms\n", percentile(latencies, 50),
+			percentile(latencies, 99), percentile(latencies, 100));
+	printf("Disk %lu bytes, %.1f bytes/reading\n", disk, count ? (double)disk / count : 0);
+	printf("\n%-10s %12s %12s %14s\n", "Stage", "CPU ms", "CPU %", "CPU us/reading");
+	for (const char *stage : stages)
+	{
+		double ms = cpu.milliseconds(stage);
+		printf("%-10s %12.0f %12.1f %14.2f\n", stage, ms, ms * 100 / elapsed,
+				count ? ms * 1000 / count : 0);
+	}
+
+	bool ok = count == generated;
+	if (!ok)
+		fprintf(stderr, "Only %lu of the %lu readings reached the north\n", count,
+				(unsigned long)generated);
+	if (!options.output.empty() && !writeResults(options.output, options, results))
+		ok = false;
+	if (!options.compare.empty() && !compareResults(options.compare, results))
+		ok = false;
+
+	// Shutdown in the order the services would
+	dataLoad->shutdown();
+	delete dataSender;
+	delete dataLoad;
+	northPlugin->shutdown();
+	delete northPlugin;
+	delete ingest;
+	delete tracker;
+	api->stopServer();
+	api->wait();
+	storagePlugin->pluginShutdown();
+	if (readingPlugin)
+		readingPlugin->pluginShutdown();
+	delete north;
+	delete core;
+
+	if (options.keep)
+	{
+		printf("Data kept in %s\n", dataDir);
+	}
+	else
+	{
+		string cleanup = string("rm -rf ") + dataDir;
+		system(cleanup.c_str());
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * Fledge end to end benchmark core management API
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <mock_core.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+ * Wrapper for thread creation that is used to start the API
+ */
+static void startCore(MockCore *core)
+{
+	core->startServer();
+}
+
+/**
+ * Construct the management API and start listening on a free port
+ */
+MockCore::MockCore() : m_port(0), m_storagePort(0), m_verbose(false)
+{
+	m_server = new HttpServer();
+	m_server->config.port = 0;
+	m_server->config.thread_pool_size = 1;
+
+	// The storage service record, whatever the service asked for
+	m_server->resource["^/fledge/service$"]["GET"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		respond(response, "{ \"services\" : [ { \"name\" : \"Fledge Storage\", "
+				"\"type\" : \"Storage\", \"address\" : \"127.0.0.1\", "
+				"\"service_port\" : " + to_string(m_storagePort) + ", "
+				"\"management_port\" : 0, \"protocol\" : \"http\" } ] }");
+	};
+
+	// No asset tracking records are held, every tuple is new to the services
+	m_server->resource["^/fledge/track$"]["GET"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		respond(response, "{ \"track\" : [] }");
+	};
+	m_server->resource["^/fledge/track$"]["POST"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		respond(response, "{ \"fledge\" : \"added\" }");
+	};
+
+	// Categories have no items, so that no filters are loaded
+	m_server->resource["^/fledge/service/category/[^/]*$"]["GET"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		respond(response, "{}");
+	};
+	m_server->resource["^/fledge/service/category/[^/]*/[^/]*$"]["PUT"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		respond(response, request->content.string());
+	};
+
+	m_server->default_resource["GET"] = [this](shared_ptr<HttpServer::Response> response,
+							shared_ptr<HttpServer::Request> request) {
+		unknown(response, request);
+	};
+	m_server->default_resource["POST"] = m_server->default_resource["GET"];
+	m_server->default_resource["PUT"] = m_server->default_resource["GET"];
+	m_server->default_resource["DELETE"] = m_server->default_resource["GET"];
+
+	m_thread = new thread(startCore, this);
+}
+
+/**
+ * Stop the management API
+ */
+MockCore::~MockCore()
+{
+	m_server->stop();
+	m_thread->join();
+	delete m_thread;
+	delete m_server;
+}
+
+/**
+ * Called on the API thread. Start the listener for HTTP requests
+ */
+void MockCore::startServer()
+{
+	m_server->start([this](unsigned short port) { m_port = port; });
+}
+
+/**
+ * Return the port the management API is listening on
+ */
+unsigned short MockCore::getListenerPort()
+{
+	int max_wait = 100;
+	// Need to make sure the server is listening
+	while (m_port == 0 && max_wait-- > 0)
+		usleep(10000);
+	return m_port;
+}
+
+/**
+ * Send a good HTTP response
+ *
+ * @param response	The HTTP response
+ * @param payload	The JSON payload of the response
+ */
+void MockCore::respond(shared_ptr<HttpServer::Response> response, const string& payload)
+{
+	*response << "HTTP/1.1 200 OK\r\n"
+		<< "Content-Length: " << payload.length() << "\r\n"
+		<<  "Content-type: application/json\r\n\r\n"
+		<< payload;
+}
+
+/**
+ * Accept any other request with an empty response, the services
+ * treat a failure to reach the core as a warning
+ *
+ * @param response	The HTTP response
+ * @param request	The HTTP request
+ */
+void MockCore::unknown(shared_ptr<HttpServer::Response> response, shared_ptr<HttpServer::Request> request)
+{
+	if (m_verbose)
+	{
+		fprintf(stderr, "Core: %s %s %s\n", request->method.c_str(),
+				request->path.c_str(), request->query_string.c_str());
+	}
+	respond(response, "{}");
+}
@@ -0,0 +1,49 @@
+#ifndef _MOCK_CORE_H
+#define _MOCK_CORE_H
+/*
+ * Fledge end to end benchmark core management API
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <server_http.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+/**
+ * A minimal stand in for the management API of the Fledge core, that
+ * allows the services to be run within the benchmark without the
+ * Python core. It answers the requests the services make for the
+ * storage service record, configuration and asset tracking with just
+ * enough for them to proceed.
+ */
+class MockCore {
+	public:
+		MockCore();
+		~MockCore();
+		void		setStoragePort(unsigned short port) { m_storagePort = port; };
+		void		setVerbose(bool verbose) { m_verbose = verbose; };
+		unsigned short	getListenerPort();
+		void		startServer();
+	private:
+		void		respond(std::shared_ptr<HttpServer::Response> response,
+					const std::string& payload);
+		void		unknown(std::shared_ptr<HttpServer::Response> response,
+					std::shared_ptr<HttpServer::Request> request);
+	private:
+		HttpServer		*m_server;
+		std::thread		*m_thread;
+		std::atomic<unsigned short>
+					m_port;
+		std::atomic<unsigned short>
+					m_storagePort;
+		bool			m_verbose;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * Fledge south service ingest queue benchmark
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+#include <reading_block_queue.h>
+#include <reading.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <atomic>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+#define	READINGS	2000000	// Total number of readings pushed by all producers
+#define	THRESHOLD	5000	// Queue size threshold, as used by the ingest class
+
+/**
+ * Return the time in milliseconds
+ */
+static double now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/**
+ * The mutex protected queue previously used by the ingest class.
+ * Readings are appended to a vector under one mutex, when the vector
+ * reaches the threshold it is moved to a queue of full vectors
+ * protected by a second mutex.
+ */
+class MutexQueue {
+	public:
+		MutexQueue() : m_queue(new vector<Reading *>) {};
+		~MutexQueue() { delete m_queue; };
+		void	push(Reading *reading)
+		{
+			vector<Reading *> *fullQueue = NULL;
+			{
+				lock_guard<mutex> guard(m_qMutex);
+				m_queue->emplace_back(reading);
+				if (m_queue->size() >= THRESHOLD)
+				{
+					fullQueue = m_queue;
+					m_queue = new vector<Reading *>;
+				}
+			}
+			if (fullQueue)
+			{
+				lock_guard<mutex> guard(m_fqMutex);
+				m_fullQueues.push(fullQueue);
+			}
+		};
+		void	push(vector<Reading *> *block)
+		{
+			vector<Reading *> *fullQueue = NULL;
+			{
+				lock_guard<mutex> guard(m_qMutex);
+				for (auto& reading : *block)
+					m_queue->emplace_back(reading);
+				if (m_queue->size() >= THRESHOLD)
+				{
+					fullQueue = m_queue;
+					m_queue = new vector<Reading *>;
+				}
+			}
+			delete block;
+			if (fullQueue)
+			{
+				lock_guard<mutex> guard(m_fqMutex);
+				m_fullQueues.push(fullQueue);
+			}
+		};
+		vector<Reading *> *pop()
+		{
+			lock_guard<mutex> fqguard(m_fqMutex);
+			if (!m_fullQueues.empty())
+			{
+				vector<Reading *> *data = m_fullQueues.front();
+				m_fullQueues.pop();
+				return data;
+			}
+			lock_guard<mutex> guard(m_qMutex);
+			if (m_queue->empty())
+				return NULL;
+			vector<Reading *> *data = m_queue;
+			m_queue = new vector<Reading *>;
+			return data;
+		};
+	private:
+		vector<Reading *>		*m_queue;
+		mutex				m_qMutex;
+		queue<vector<Reading *> *>	m_fullQueues;
+		mutex				m_fqMutex;
+};
+
+/**
+ * The lock free queue used by the ingest class, with the consumer
+ * gathering blocks up to the threshold as the ingest thread does.
+ */
+class LockFreeQueue {
+	public:
+		~LockFreeQueue()
+		{
+			// The readings are not owned by the queue, stop it deleting them
+			vector<Reading *> *data;
+			while ((data = m_queue.take(THRESHOLD)) != NULL)
+				delete data;
+		};
+		void	push(Reading *reading)
+		{
+			m_queue.push(reading);
+		};
+		void	push(vector<Reading *> *block)
+		{
+			m_queue.push(block);
+		};
+		vector<Reading *> *pop()
+		{
+			return m_queue.take(THRESHOLD);
+		};
+	private:
+		ReadingBlockQueue	m_queue;
+};
+
+/**
+ * Push readings from a number of producer threads, either singly or in
+ * blocks, and drain them from a single consumer thread.
+ *
+ * The readings pushed are all pointers to the same reading, the consumer
+ * does not delete them, so that the cost measured is that of the queue.
+ *
+ * @return The number of readings per second passed through the queue
+ */
+template<class Q> static double run(int producers, size_t blockSize)
+{
+	Q queue;
+	DatapointValue value(1L);
+	Reading *reading = new Reading("benchmark", new Datapoint("value", value));
+	size_t perProducer = READINGS / producers;
+	size_t total = perProducer * producers;
+
+	double start = now();
+	vector<thread> threads;
+	for (int i = 0; i < producers; i++)
+	{
+		threads.emplace_back([&queue, reading, perProducer, blockSize]() {
+			for (size_t n = 0; n < perProducer; n += blockSize)
+			{
+				if (blockSize == 1)
+				{
+					queue.push(reading);
+				}
+				else
+				{
+					queue.push(new vector<Reading *>(blockSize, reading));
+				}
+			}
+		});
+	}
+	size_t received = 0;
+	while (received < total)
+	{
+		vector<Reading *> *data = queue.pop();
+		if (data)
+		{
+			received += data->size();
+			delete data;
+		}
+		else
+		{
+			this_thread::yield();
+		}
+	}
+	for (auto& t : threads)
+		t.join();
+	double elapsed = now() - start;
+	delete reading;
+	return total / elapsed * 1000.0;
+}
+
+/**
+ * Compare the throughput of the mutex protected queue previously used by
+ * the ingest class with the lock free queue as the number of producer
+ * threads grows.
+ *
+ * Usage: IngestQueueBenchmark [producers ...]
+ */
+int main(int argc, char **argv)
+{
+	vector<int> producers;
+	for (int i = 1; i < argc; i++)
+		producers.push_back(atoi(argv[i]));
+	if (producers.empty())
+		producers = { 1, 2, 4, 8 };
+
+	printf("%d hardware threads\n", thread::hardware_concurrency());
+	printf("%-10s %16s %16s %16s %16s\n", "Producers", "Mutex single/s", "Lockfree single/s",
+			"Mutex block/s", "Lockfree block/s");
+	for (auto p : producers)
+	{
+		double mutexSingle = run<MutexQueue>(p, 1);
+		double lockfreeSingle = run<LockFreeQueue>(p, 1);
+		double mutexBlock = run<MutexQueue>(p, 100);
+		double lockfreeBlock = run<LockFreeQueue>(p, 100);
+		printf("%-10d %16.0f %16.0f %16.0f %16.0f\n", p, mutexSingle, lockfreeSingle,
+				mutexBlock, lockfreeBlock);
+	}
+	return 0;
+}
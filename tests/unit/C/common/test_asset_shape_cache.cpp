@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <asset_tracking.h>
+#include <reading.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Create a reading with integer datapoints of the given names
+ */
+static Reading *makeReading(const string& asset, const vector<string>& names)
+{
+	vector<Datapoint *> values;
+	for (auto& name : names)
+	{
+		DatapointValue value((long)1);
+		values.push_back(new Datapoint(name, value));
+	}
+	return new Reading(asset, values);
+}
+
+TEST(AssetShapeCacheTest, SameShape)
+{
+	AssetShapeCache cache;
+	Reading *r1 = makeReading("pump", {"speed", "temperature"});
+	Reading *r2 = makeReading("pump", {"speed", "temperature"});
+	ASSERT_TRUE(cache.isNewShape(r1));
+	ASSERT_FALSE(cache.isNewShape(r1));
+	ASSERT_FALSE(cache.isNewShape(r2));
+	delete r1;
+	delete r2;
+}
+
+TEST(AssetShapeCacheTest, NewShapes)
+{
+	AssetShapeCache cache;
+	Reading *r1 = makeReading("pump", {"speed", "temperature"});
+	Reading *r2 = makeReading("pump", {"speed"});
+	Reading *r3 = makeReading("pump", {"temperature", "speed"});
+	Reading *r4 = makeReading("fan", {"speed", "temperature"});
+	ASSERT_TRUE(cache.isNewShape(r1));
+	ASSERT_TRUE(cache.isNewShape(r2));
+	ASSERT_TRUE(cache.isNewShape(r3));
+	ASSERT_TRUE(cache.isNewShape(r4));
+	// All of the shapes of an asset are remembered, not just the last
+	ASSERT_FALSE(cache.isNewShape(r1));
+	ASSERT_FALSE(cache.isNewShape(r2));
+	ASSERT_FALSE(cache.isNewShape(r4));
+	cache.clear();
+	ASSERT_TRUE(cache.isNewShape(r1));
+	delete r1;
+	delete r2;
+	delete r3;
+	delete r4;
+}
+
+TEST(AssetShapeCacheTest, NameBoundaries)
+{
+	Reading *r1 = makeReading("pump", {"ab", "c"});
+	Reading *r2 = makeReading("pump", {"a", "bc"});
+	ASSERT_NE(AssetShapeCache::shapeHash(r1->getReadingData()),
+			AssetShapeCache::shapeHash(r2->getReadingData()));
+	AssetShapeCache cache;
+	ASSERT_TRUE(cache.isNewShape(r1));
+	ASSERT_TRUE(cache.isNewShape(r2));
+	delete r1;
+	delete r2;
+}
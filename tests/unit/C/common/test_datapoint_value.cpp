@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+TEST(DatapointValueTest, ShortString)
+{
+	DatapointValue value("OK");
+	ASSERT_EQ(value.getType(), DatapointValue::T_STRING);
+	ASSERT_EQ(value.toStringValue(), "OK");
+	ASSERT_EQ(value.toString(), "\"OK\"");
+}
+
+TEST(DatapointValueTest, Size)
+{
+	// The value is no larger than a pointer and the tag
+	ASSERT_LE(sizeof(DatapointValue), 2 * sizeof(void *));
+}
+
+TEST(DatapointValueTest, InlineStringLimits)
+{
+	string inlined(DPV_INLINE_STRING, 'x');
+	string heap(DPV_INLINE_STRING + 1, 'y');
+	DatapointValue empty("");
+	DatapointValue a(inlined);
+	DatapointValue b(heap);
+	ASSERT_EQ(empty.toStringValue(), "");
+	ASSERT_EQ(a.toStringValue(), inlined);
+	ASSERT_EQ(b.toStringValue(), heap);
+
+	// Copies and moves between inline and heap strings
+	DatapointValue c(a);
+	ASSERT_EQ(c.toStringValue(), inlined);
+	c = b;
+	ASSERT_EQ(c.toStringValue(), heap);
+	c = std::move(a);
+	ASSERT_EQ(c.toStringValue(), inlined);
+	c.setValue(heap);
+	ASSERT_EQ(c.toStringValue(), heap);
+	c.setValue(string("z"));
+	ASSERT_EQ(c.toString(), "\"z\"");
+
+	// Strings may hold any character
+	string nul("a\0b", 3);
+	DatapointValue d(nul);
+	ASSERT_EQ(d.toStringValue(), nul);
+}
+
+TEST(DatapointValueTest, CopyString)
+{
+	DatapointValue value(string("a string that is longer than the small string buffer"));
+	DatapointValue copy(value);
+	ASSERT_EQ(copy.toStringValue(), value.toStringValue());
+	value.setValue(string("changed"));
+	ASSERT_EQ(copy.toStringValue(), "a string that is longer than the small string buffer");
+}
+
+TEST(DatapointValueTest, MoveString)
+{
+	DatapointValue value(string("a string that is longer than the small string buffer"));
+	DatapointValue moved(std::move(value));
+	ASSERT_EQ(moved.getType(), DatapointValue::T_STRING);
+	ASSERT_EQ(moved.toStringValue(), "a string that is longer than the small string buffer");
+	ASSERT_EQ(value.getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(value.toInt(), 0);
+}
+
+TEST(DatapointValueTest, MoveArray)
+{
+	vector<double> values = { 1.0, 2.0, 3.0 };
+	DatapointValue value(values);
+	vector<double> *array = value.getDpArr();
+	DatapointValue moved(std::move(value));
+	ASSERT_EQ(moved.getDpArr(), array);
+	ASSERT_EQ(moved.toString(), "[1, 2, 3]");
+	ASSERT_EQ(value.getType(), DatapointValue::T_INTEGER);
+}
+
+TEST(DatapointValueTest, MoveAssign)
+{
+	DatapointValue value(string("moved"));
+	DatapointValue target(3.5);
+	target = std::move(value);
+	ASSERT_EQ(target.toStringValue(), "moved");
+	target = DatapointValue(42L);
+	ASSERT_EQ(target.getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(target.toInt(), 42);
+}
+
+TEST(DatapointValueTest, AssignDict)
+{
+	DatapointValue inner(10L);
+	vector<Datapoint *> *children = new vector<Datapoint *>;
+	children->emplace_back(new Datapoint("x", inner));
+	DatapointValue dict(children, true);
+	DatapointValue copy(string("replaced"));
+	copy = dict;
+	ASSERT_EQ(copy.getType(), DatapointValue::T_DP_DICT);
+	ASSERT_NE(copy.getDpVec(), dict.getDpVec());
+	ASSERT_NE((*copy.getDpVec())[0], (*dict.getDpVec())[0]);
+	ASSERT_EQ(copy.toString(), dict.toString());
+}
+
+TEST(DatapointValueTest, SetValueChangesType)
+{
+	DatapointValue value(string("a string that is longer than the small string buffer"));
+	value.setValue(5L);
+	ASSERT_EQ(value.getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(value.toInt(), 5);
+	value.setValue(string("again"));
+	ASSERT_EQ(value.toStringValue(), "again");
+	value.setValue(2.5);
+	ASSERT_EQ(value.getType(), DatapointValue::T_FLOAT);
+}
+
+TEST(DatapointValueTest, DatapointMove)
+{
+	DatapointValue value(string("status"));
+	Datapoint dp("state", std::move(value));
+	const Datapoint& cdp = dp;
+	ASSERT_EQ(cdp.getData().toStringValue(), "status");
+	ASSERT_EQ(&cdp.getData(), &dp.getData());
+}
+
+TEST(DatapointValueTest, StringValueOfNumber)
+{
+	DatapointValue value(42L);
+	ASSERT_EQ(value.toStringValue(), "42");
+	DatapointValue real(2.5);
+	ASSERT_EQ(real.toStringValue(), real.toString());
+}
+
+TEST(DatapointValueTest, SetValueKeepsDict)
+{
+	DatapointValue inner(10L);
+	vector<Datapoint *> *children = new vector<Datapoint *>;
+	children->emplace_back(new Datapoint("x", inner));
+	DatapointValue dict(children, true);
+
+	// The caller has taken the datapoints, setting a number must
+	// not delete them
+	vector<Datapoint *> *taken = dict.getDpVec();
+	dict.setValue(5L);
+	ASSERT_EQ(dict.getType(), DatapointValue::T_INTEGER);
+	ASSERT_EQ(dict.toInt(), 5);
+	ASSERT_EQ((*taken)[0]->getData().toInt(), 10);
+	for (auto& dp : *taken)
+		delete dp;
+	delete taken;
+}
@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <logger.h>
+#include <syslog.h>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+
+using namespace std;
+
+TEST(LoggerTest, Levels)
+{
+	Logger *logger = Logger::getLogger();
+	string level = logger->getMinLevel();
+	logger->setMinLevel("info");
+	ASSERT_TRUE(logger->isEnabled(LOG_ERR));
+	ASSERT_TRUE(logger->isEnabled(LOG_INFO));
+	ASSERT_FALSE(logger->isEnabled(LOG_DEBUG));
+	logger->setMinLevel("error");
+	ASSERT_TRUE(logger->isEnabled(LOG_ERR));
+	ASSERT_FALSE(logger->isEnabled(LOG_WARNING));
+	logger->setMinLevel(level.empty() ? "warning" : level);
+}
+
+TEST(LoggerTest, Asynchronous)
+{
+	Logger *logger = Logger::getLogger();
+	ASSERT_FALSE(logger->isAsynchronous());
+	logger->setAsynchronous(true);
+	ASSERT_TRUE(logger->isAsynchronous());
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([logger, t]() {
+			for (int i = 0; i < 500; i++)
+				logger->warn("Logger test thread %d message %d", t, i);
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	string msg("Logger test with a string format %d");
+	logger->error(msg, 1);
+	logger->flush();
+	logger->setAsynchronous(false);
+	ASSERT_FALSE(logger->isAsynchronous());
+	logger->warn("Logger test after asynchronous logging");
+}
+
+TEST(LoggerTest, ToggleWhileLogging)
+{
+	Logger *logger = Logger::getLogger();
+	atomic<int> running(4);
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([logger, t, &running]() {
+			for (int i = 0; i < 200; i++)
+				logger->warn("Logger toggle test thread %d message %d", t, i);
+			running--;
+		});
+	}
+	// Switch the mode while the threads log, returning to synchronous
+	// logging must not leave messages queued by the threads unwritten
+	while (running > 0)
+	{
+		logger->setAsynchronous(true);
+		this_thread::sleep_for(chrono::milliseconds(1));
+		logger->setAsynchronous(false);
+		EXPECT_FALSE(logger->isAsynchronous());
+	}
+	for (auto& t : threads)
+		t.join();
+}
@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_arena.h>
+#include <malloc.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static Reading *makeReading(const string& asset, long val)
+{
+	DatapointValue value(val);
+	DatapointValue name("a string longer than the short string buffer");
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("x", value));
+	values.push_back(new Datapoint("name", name));
+	return new Reading(asset, values);
+}
+
+TEST(ReadingArenaTest, Copy)
+{
+	Reading *reading = makeReading("arena", 1);
+	reading->setId(10);
+	Reading *copy = ReadingArena::copy(*reading);
+	ASSERT_TRUE(ReadingArena::owns(copy));
+	ASSERT_FALSE(ReadingArena::owns(reading));
+	ASSERT_EQ(copy->getAssetName(), "arena");
+	ASSERT_EQ(copy->getId(), 10);
+	ASSERT_EQ(copy->getUserTimestamp(), reading->getUserTimestamp());
+	ASSERT_EQ(copy->getDatapointsJSON(), reading->getDatapointsJSON());
+	delete reading;
+	ReadingArena::destroy(copy);
+}
+
+TEST(ReadingArenaTest, ReadingsContiguous)
+{
+	Reading *reading = makeReading("arena", 0);
+	vector<Reading *> readings;
+	for (int i = 0; i < 10; i++)
+		readings.push_back(ReadingArena::copy(*reading));
+	delete reading;
+	// Consecutive readings are carved from the same chunk, other
+	// than where the chunk of the arena fills up
+	int contiguous = 0;
+	for (int i = 1; i < 10; i++)
+	{
+		long gap = (char *)readings[i] - (char *)readings[i - 1];
+		if (gap > 0 && gap < 1024)
+			contiguous++;
+	}
+	for (auto& r : readings)
+		ReadingArena::destroy(r);
+	ASSERT_GE(contiguous, 8);
+}
+
+TEST(ReadingArenaTest, DestroyHeapReading)
+{
+	Reading *reading = makeReading("heap", 1);
+	ASSERT_FALSE(ReadingArena::owns(reading));
+	ReadingArena::destroy(reading);
+	ReadingArena::destroy(NULL);
+}
+
+TEST(ReadingArenaTest, CopyOut)
+{
+	Reading *reading = makeReading("arena", 1);
+	Reading *copy = ReadingArena::copy(*reading);
+	Reading *heap = ReadingArena::copyOut(copy);
+	ASSERT_FALSE(ReadingArena::owns(heap));
+	ASSERT_EQ(heap->getDatapointsJSON(), reading->getDatapointsJSON());
+	// A reading taken out of the arena may be modified and deleted
+	DatapointValue value(2L);
+	heap->addDatapoint(new Datapoint("y", value));
+	delete heap;
+	ASSERT_EQ(ReadingArena::copyOut(reading), reading);
+	delete reading;
+}
+
+TEST(ReadingArenaTest, DestroyBlock)
+{
+	Reading *reading = makeReading("arena", 0);
+	vector<Reading *> readings;
+	// Enough readings to fill several arenas, with heap readings among them
+	for (int i = 0; i < 3 * ARENA_BLOCK_READINGS; i++)
+	{
+		if (i % 100 == 0)
+			readings.push_back(new Reading(*reading));
+		else
+			readings.push_back(ReadingArena::copy(*reading));
+	}
+	delete reading;
+	ReadingArena::destroy(readings);
+	ASSERT_TRUE(readings.empty());
+}
+
+TEST(ReadingArenaTest, KeptReading)
+{
+	Reading *reading = makeReading("arena", 0);
+	vector<Reading *> readings;
+	for (int i = 0; i < 2 * ARENA_BLOCK_READINGS; i++)
+	{
+		reading->setId(i);
+		readings.push_back(ReadingArena::copy(*reading));
+	}
+	delete reading;
+
+	// A reading kept while the rest of its block is destroyed keeps
+	// its arena alive until it too is destroyed
+	Reading *kept = readings[10];
+	readings.erase(readings.begin() + 10);
+	ReadingArena::destroy(readings);
+	ASSERT_TRUE(ReadingArena::owns(kept));
+	ASSERT_EQ(kept->getId(), 10);
+	ASSERT_EQ(kept->getDatapoint("x")->getData().toInt(), 0);
+	ReadingArena::destroy(kept);
+}
+
+TEST(ReadingArenaTest, DestroyOnOtherThread)
+{
+	vector<Reading *> readings;
+	thread producer([&readings]() {
+		Reading *reading = makeReading("arena", 0);
+		for (int i = 0; i < 1000; i++)
+		{
+			reading->setId(i);
+			readings.push_back(ReadingArena::copy(*reading));
+		}
+		delete reading;
+	});
+	producer.join();
+	// Keep one reading beyond the others, the arena of the exited
+	// thread is freed once its last reading is destroyed
+	Reading *kept = readings.back();
+	readings.pop_back();
+	thread consumer([&readings]() {
+		ReadingArena::destroy(readings);
+	});
+	consumer.join();
+	ASSERT_EQ(kept->getAssetName(), "arena");
+	ASSERT_EQ(kept->getId(), 999);
+	ReadingArena::destroy(kept);
+}
+
+/**
+ * Copy a reading into the arena of a new thread, add heap datapoints
+ * to the copy and destroy it. The arena is disposed of when the thread
+ * exits.
+ */
+static void addToCopy(const Reading& reading)
+{
+	thread worker([&reading]() {
+		Reading *copy = ReadingArena::copy(reading);
+		for (int i = 0; i < 100; i++)
+		{
+			DatapointValue value("a string longer than the short string buffer");
+			copy->addDatapoint(new Datapoint("added", value));
+		}
+		ASSERT_TRUE(ReadingArena::holds(copy, copy->getReadingData()[0]));
+		ASSERT_FALSE(ReadingArena::holds(copy, copy->getReadingData()[2]));
+		ReadingArena::destroy(copy);
+	});
+	worker.join();
+}
+
+TEST(ReadingArenaTest, AddedDatapointsDeleted)
+{
+	Reading *reading = makeReading("arena", 0);
+	// The first run leaves the chunk of the arena with the spare chunks
+	addToCopy(*reading);
+	size_t before = mallinfo2().uordblks;
+	addToCopy(*reading);
+	size_t after = mallinfo2().uordblks;
+	delete reading;
+	// The 100 datapoints added would leak several KB
+	ASSERT_LT(after, before + 1024);
+}
+
+TEST(ReadingArenaTest, RemoveDatapoint)
+{
+	Reading *reading = makeReading("arena", 1);
+	Reading *copy = ReadingArena::copy(*reading);
+	delete reading;
+	DatapointValue value(2L);
+	copy->addDatapoint(new Datapoint("y", value));
+
+	// Datapoints removed from the reading are given on the heap
+	Datapoint *x = copy->removeDatapoint("x");
+	ASSERT_FALSE(ReadingArena::holds(copy, x));
+	ASSERT_EQ(x->getData().toInt(), 1);
+	delete x;
+	Datapoint *y = copy->removeDatapoint("y");
+	ASSERT_EQ(y->getData().toInt(), 2);
+	delete y;
+	ASSERT_EQ(copy->getDatapointCount(), 1);
+
+	copy->addDatapoint(new Datapoint("y", value));
+	copy->removeAllDatapoints();
+	ASSERT_EQ(copy->getDatapointCount(), 0);
+	ReadingArena::destroy(copy);
+}
@@ -1,5 +1,7 @@
 #include <gtest/gtest.h>
 #include <reading_set.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
 #include <string.h>
 #include <string>
 #include <rapidjson/document.h>
@@ -28,15 +30,41 @@ const char *asset_notification = "{ \"readings\" : [ "
             "\"user_ts\": \"2017-09-21 15:00:09.32958\", "
             "\"ts\": \"2017-09-22 14:48:18.72708\" }"
 	    "] }";
-TEST(ReadingSet, Count)
+
+const char *complex_rows = "{ \"count\" : 3, \"rows\" : [ "
+	    "{ \"id\": 10, \"asset_code\": \"pump\", "
+            "\"reading\": { \"counter\": 12, \"big\": 12345678901, \"temperature\": 21.5, "
+            "\"status\": \"say \\\"hi\\\"\", \"position\": [ 1, 2.5, \"x\", 3 ], "
+            "\"motor\": { \"speed\": 1450, \"state\": { \"on\": true } }, "
+            "\"__internal\": \"ignored\" }, "
+            "\"user_ts\": \"2017-09-21 15:00:08.532958\" }, "
+	    "{ \"id\": 11, \"asset_code\": \"meter\", \"value\": 42, "
+            "\"reading\": { \"lux\": 1.5 }, "
+            "\"user_ts\": \"2017-09-21 15:00:09.32958\", "
+            "\"ts\": \"2017-09-22 14:48:18.72708\" }, "
+	    "{ \"id\": 12, \"asset_code\": \"broken\", \"extra\": { \"a\": [ 1 ] }, "
+            "\"reading\": \"a \\\"quoted\\\" value\", "
+            "\"user_ts\": \"2017-09-21 15:00:10.5\" }"
+	    "] }";
+
+/**
+ * Run the tests against both the document and the streaming parser
+ */
+class ReadingSetParser : public ::testing::TestWithParam<ReadingSet::readingSetParser> {
+};
+
+INSTANTIATE_TEST_CASE_P(Parsers, ReadingSetParser,
+		::testing::Values(ReadingSet::PARSE_DOCUMENT, ReadingSet::PARSE_STREAM));
+
+TEST_P(ReadingSetParser, Count)
 {
-	ReadingSet readingSet(input);
+	ReadingSet readingSet(input, GetParam());
 	ASSERT_EQ(2, readingSet.getCount());
 }
 
-TEST(ReadingSet, Index)
+TEST_P(ReadingSetParser, Index)
 {
-	ReadingSet readingSet(input);
+	ReadingSet readingSet(input, GetParam());
 	const Reading *reading = readingSet[0];
 	string json = reading->toJSON();
 	ASSERT_NE(json.find(string("\"asset_code\" : \"luxmeter\"")), 0);
@@ -44,15 +72,15 @@ TEST(ReadingSet, Index)
 	ASSERT_NE(json.find(string("\"user_ts\" : \"2017-09-22 14:47:18.872708\"")), 0);
 }
 
-TEST(ReadingSet, NotificationCount)
+TEST_P(ReadingSetParser, NotificationCount)
 {
-	ReadingSet readingSet(asset_notification);
+	ReadingSet readingSet(asset_notification, GetParam());
 	ASSERT_EQ(2, readingSet.getCount());
 }
 
-TEST(ReadingSet, NotificationIndex)
+TEST_P(ReadingSetParser, NotificationIndex)
 {
-	ReadingSet readingSet(asset_notification);
+	ReadingSet readingSet(asset_notification, GetParam());
 	const Reading *reading = readingSet[0];
 	string json = reading->toJSON();
 	ASSERT_NE(json.find(string("\"asset_code\" : \"luxmeter\"")), 0);
@@ -60,3 +88,104 @@ TEST(ReadingSet, NotificationIndex)
 	ASSERT_NE(json.find(string("\"readkey\" : ")), 0);
 	ASSERT_NE(json.find(string("\"user_ts\" : \"2017-09-22 14:47:18.872708\"")), 0);
 }
+
+TEST_P(ReadingSetParser, LastId)
+{
+	ReadingSet readingSet(complex_rows, GetParam());
+	ASSERT_EQ(3, readingSet.getCount());
+	ASSERT_EQ(3, readingSet.getAllReadings().size());
+	ASSERT_EQ(12, readingSet.getLastId());
+}
+
+TEST_P(ReadingSetParser, NoRows)
+{
+	ReadingSet readingSet("{ \"count\" : 0, \"rows\" : [] }", GetParam());
+	ASSERT_EQ(0, readingSet.getCount());
+	ASSERT_EQ(0, readingSet.getAllReadings().size());
+}
+
+TEST_P(ReadingSetParser, MissingRows)
+{
+	ASSERT_THROW(ReadingSet("{ \"count\" : 2 }", GetParam()), ReadingSetException *);
+}
+
+TEST_P(ReadingSetParser, RowsNotArray)
+{
+	ASSERT_THROW(ReadingSet("{ \"count\" : 2, \"rows\" : { } }", GetParam()), ReadingSetException *);
+}
+
+TEST_P(ReadingSetParser, MissingAsset)
+{
+	ASSERT_THROW(ReadingSet("{ \"count\" : 1, \"rows\" : [ { \"id\": 1, "
+				"\"reading\": { \"a\": 1 }, \"user_ts\": \"2017-09-21 15:00:08\" } ] }",
+				GetParam()), ReadingSetException *);
+}
+
+TEST_P(ReadingSetParser, BadJSON)
+{
+	ASSERT_THROW(ReadingSet("{ \"count\" : 1, \"rows\" : [ { ", GetParam()), ReadingSetException *);
+}
+
+TEST(ReadingSet, ParsersAgree)
+{
+	ReadingSet document(complex_rows, ReadingSet::PARSE_DOCUMENT);
+	ReadingSet stream(complex_rows, ReadingSet::PARSE_STREAM);
+	const vector<Reading *>& expected = document.getAllReadings();
+	const vector<Reading *>& actual = stream.getAllReadings();
+	ASSERT_EQ(expected.size(), actual.size());
+	for (int i = 0; i < expected.size(); i++)
+	{
+		ASSERT_EQ(expected[i]->getId(), actual[i]->getId());
+		ASSERT_EQ(expected[i]->getAssetName(), actual[i]->getAssetName());
+		ASSERT_EQ(expected[i]->getDatapointCount(), actual[i]->getDatapointCount());
+		ASSERT_EQ(expected[i]->toJSON(), actual[i]->toJSON());
+	}
+	ASSERT_EQ(0, actual[1]->getAssetName().compare("meter"));
+	ASSERT_EQ(1, actual[1]->getDatapointCount());
+	ASSERT_EQ(0, actual[2]->getAssetName().compare("error_invalid_reading_broken"));
+}
+
+/**
+ * Append a reading to a binary reading fetch result
+ */
+static void binaryRow(string& result, uint64_t id, const string& asset,
+		const string& userTs, const string& ts, const string& payload)
+{
+	RDSFetchReading row;
+	row.id = id;
+	row.assetLength = asset.length();
+	row.userTsLength = userTs.length();
+	row.tsLength = ts.length();
+	row.payloadLength = payload.length();
+	result.append((const char *)&row, sizeof(row));
+	result += asset + userTs + ts + payload;
+}
+
+TEST(ReadingSet, BinaryMatchesJSON)
+{
+	ReadingSet document(input, ReadingSet::PARSE_DOCUMENT);
+	const vector<Reading *>& expected = document.getAllReadings();
+
+	RDSFetchHeader header;
+	header.magic = RDS_FETCH_MAGIC;
+	header.count = 2;
+	string result((const char *)&header, sizeof(header));
+	string payload;
+	ASSERT_TRUE(ReadingStreamPayload::encode(expected[0]->getReadingData(), payload));
+	binaryRow(result, 1, "luxometer", "2017-09-21 15:00:08.532958", "2017-09-22 14:47:18.872708", payload);
+	binaryRow(result, 2, "luxometer", "2017-09-21 15:00:09.32958", "2017-09-22 14:48:18.72708",
+			"{ \"lux\": 76834.361 }");
+
+	ReadingSet binary(result, ReadingSet::PARSE_BINARY);
+	const vector<Reading *>& actual = binary.getAllReadings();
+	ASSERT_EQ(2, binary.getCount());
+	ASSERT_EQ(2, binary.getLastId());
+	for (int i = 0; i < expected.size(); i++)
+	{
+		ASSERT_EQ(expected[i]->getId(), actual[i]->getId());
+		ASSERT_EQ(expected[i]->toJSON(), actual[i]->toJSON());
+	}
+
+	ASSERT_THROW(ReadingSet(result.substr(0, result.length() - 4), ReadingSet::PARSE_BINARY),
+			ReadingSetException *);
+}
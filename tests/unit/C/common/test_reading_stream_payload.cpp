@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+#include <reading.h>
+#include <reading_stream_payload.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static Reading *complexReading()
+{
+	vector<Datapoint *> values;
+	DatapointValue i((long) -42);
+	values.push_back(new Datapoint("int", i));
+	DatapointValue f(3.1415);
+	values.push_back(new Datapoint("float", f));
+	DatapointValue s("a \"quoted\" string");
+	values.push_back(new Datapoint("str", s));
+	vector<double> a {3.1415, -128, 0, -0.0021, 0.2345};
+	DatapointValue av(a);
+	values.push_back(new Datapoint("array", av));
+
+	vector<Datapoint *> *dict = new vector<Datapoint *>;
+	DatapointValue x((long) 1);
+	dict->push_back(new Datapoint("x", x));
+	DatapointValue y(2.5);
+	dict->push_back(new Datapoint("y", y));
+	DatapointValue dv(dict, true);
+	values.push_back(new Datapoint("dict", dv));
+
+	vector<Datapoint *> *list = new vector<Datapoint *>;
+	DatapointValue l1("one");
+	list->push_back(new Datapoint("l1", l1));
+	DatapointValue l2((long) 2);
+	list->push_back(new Datapoint("l2", l2));
+	DatapointValue lv(list, false);
+	values.push_back(new Datapoint("list", lv));
+
+	return new Reading("complex", values);
+}
+
+TEST(ReadingStreamPayloadTest, IsBinary)
+{
+	Reading *reading = complexReading();
+	string payload;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	ASSERT_TRUE(RDS_PAYLOAD_IS_BINARY(payload.c_str()));
+	ASSERT_FALSE(RDS_PAYLOAD_IS_BINARY(reading->getDatapointsJSON().c_str()));
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, JSONMatchesReading)
+{
+	Reading *reading = complexReading();
+	string payload, json;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json.compare(reading->getDatapointsJSON()), 0);
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, Datapoints)
+{
+	Reading *reading = complexReading();
+	string payload;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	vector<Datapoint *> *datapoints = ReadingStreamPayload::toDatapoints(payload.data(), payload.length());
+	ASSERT_TRUE(datapoints != NULL);
+	ASSERT_EQ(datapoints->size(), 6);
+	Reading decoded("complex", *datapoints);
+	delete datapoints;
+	ASSERT_EQ(decoded.getDatapointsJSON().compare(reading->getDatapointsJSON()), 0);
+	ASSERT_EQ(decoded.getDatapoint("dict")->getData().getType(), DatapointValue::T_DP_DICT);
+	ASSERT_EQ(decoded.getDatapoint("int")->getData().toInt(), -42);
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, Array2D)
+{
+	vector<double> row1 {1.0, 2.0};
+	vector<double> row2 {3.0, 4.5};
+	vector<vector<double> *> array {&row1, &row2};
+	DatapointValue value(array);
+	Reading reading("array2d", new Datapoint("a", value));
+	string payload, json;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading.getReadingData(), payload));
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json.compare(reading.getDatapointsJSON()), 0);
+}
+
+TEST(ReadingStreamPayloadTest, Truncated)
+{
+	Reading *reading = complexReading();
+	string payload, json;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	for (size_t len = 0; len < payload.length(); len += 7)
+	{
+		ASSERT_FALSE(ReadingStreamPayload::toJSON(payload.data(), len, json));
+		ASSERT_TRUE(ReadingStreamPayload::toDatapoints(payload.data(), len) == NULL);
+	}
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, Layout)
+{
+	vector<Datapoint *> values;
+	DatapointValue i((long) -2);
+	values.push_back(new Datapoint("i", i));
+	DatapointValue f(1.0);
+	values.push_back(new Datapoint("f", f));
+	Reading reading("layout", values);
+	string payload;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading.getReadingData(), payload));
+	// Counts, lengths and integers are varints, doubles are little endian
+	const unsigned char expected[] = {
+		RDS_BINARY_PAYLOAD_MARKER, RDS_BINARY_PAYLOAD_VERSION, 2,
+		DatapointValue::T_INTEGER, 1, 'i', 3,
+		DatapointValue::T_FLOAT, 1, 'f', 0, 0, 0, 0, 0, 0, 0xf0, 0x3f };
+	ASSERT_EQ(payload, string((const char *)expected, sizeof(expected)));
+}
+
+TEST(ReadingStreamPayloadTest, Version1)
+{
+	// Version 1 payloads held counts and lengths as uint32 and integers as int64
+	string payload;
+	payload += (char)RDS_BINARY_PAYLOAD_MARKER;
+	payload += (char)1;
+	uint32_t count = 2, nameLength = 1;
+	int64_t i = -300;
+	double f = 2.5;
+	payload.append((char *)&count, sizeof(count));
+	payload += (char)DatapointValue::T_INTEGER;
+	payload.append((char *)&nameLength, sizeof(nameLength));
+	payload += 'i';
+	payload.append((char *)&i, sizeof(i));
+	payload += (char)DatapointValue::T_FLOAT;
+	payload.append((char *)&nameLength, sizeof(nameLength));
+	payload += 'f';
+	payload.append((char *)&f, sizeof(f));
+	string json;
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json, "{\"i\":-300,\"f\":2.5}");
+	double value;
+	ASSERT_TRUE(ReadingStreamPayload::number(payload.data(), payload.length(), {"f"}, value));
+	ASSERT_EQ(value, 2.5);
+
+	payload[1] = (char)(RDS_BINARY_PAYLOAD_VERSION + 1);
+	ASSERT_FALSE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+}
+
+TEST(ReadingStreamPayloadTest, Numbers)
+{
+	Reading *reading = complexReading();
+	string payload;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	double value;
+	ASSERT_TRUE(ReadingStreamPayload::number(payload.data(), payload.length(), {"int"}, value));
+	ASSERT_EQ(value, -42);
+	ASSERT_TRUE(ReadingStreamPayload::number(payload.data(), payload.length(), {"dict", "y"}, value));
+	ASSERT_EQ(value, 2.5);
+	ASSERT_FALSE(ReadingStreamPayload::number(payload.data(), payload.length(), {"str"}, value));
+	ASSERT_FALSE(ReadingStreamPayload::number(payload.data(), payload.length(), {"list", "l2"}, value));
+	ASSERT_FALSE(ReadingStreamPayload::number(payload.data(), payload.length(), {"missing"}, value));
+
+	vector<string> names;
+	double sum = 0;
+	ASSERT_TRUE(ReadingStreamPayload::numbers(payload.data(), payload.length(),
+			[&](const char *name, uint32_t length, double value) {
+				names.push_back(string(name, length));
+				sum += value;
+			}));
+	ASSERT_EQ(names.size(), 2);
+	ASSERT_EQ(names[0], "int");
+	ASSERT_EQ(names[1], "float");
+	ASSERT_DOUBLE_EQ(sum, -42 + 3.1415);
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, FromJSON)
+{
+	Reading *reading = complexReading();
+	string json = reading->getDatapointsJSON();
+	rapidjson::Document doc;
+	ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+	string payload, decoded;
+	ASSERT_TRUE(ReadingStreamPayload::fromJSON(doc, payload));
+	ASSERT_TRUE(RDS_PAYLOAD_IS_BINARY(payload.c_str()));
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), decoded));
+	ASSERT_EQ(decoded.compare(json), 0);
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, FromJSONNoEncoding)
+{
+	const char *unencodable[] = {
+		"{\"flag\":true}",
+		"{\"empty\":null}",
+		"{\"precise\":0.123456789012345}",
+		"{\"str\":\"line\\nbreak\"}",
+		"{\"array\":[true]}",
+		"[1,2]"
+	};
+	for (auto json : unencodable)
+	{
+		rapidjson::Document doc;
+		ASSERT_FALSE(doc.Parse(json).HasParseError());
+		string payload;
+		ASSERT_FALSE(ReadingStreamPayload::fromJSON(doc, payload)) << json;
+	}
+}
+
+static Reading *binaryReading()
+{
+	unsigned char pixels[4 * 3];
+	for (int i = 0; i < sizeof(pixels); i++)
+		pixels[i] = i * 17;
+	vector<Datapoint *> values;
+	DatapointValue image(new DPImage(4, 3, 8, pixels));
+	values.push_back(new Datapoint("image", image));
+	DatapointValue count(42L);
+	values.push_back(new Datapoint("count", count));
+	DataBuffer *buffer = new DataBuffer(sizeof(uint16_t), 5);
+	uint16_t *items = (uint16_t *)buffer->getData();
+	for (int i = 0; i < 5; i++)
+		items[i] = i * 1000;
+	DatapointValue data(buffer);
+	values.push_back(new Datapoint("buffer", data));
+	return new Reading("camera", values);
+}
+
+TEST(ReadingStreamPayloadTest, ImageAndDataBuffer)
+{
+	Reading *reading = binaryReading();
+	string payload, json;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload));
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), json));
+	ASSERT_EQ(json.compare(reading->getDatapointsJSON()), 0);
+
+	vector<Datapoint *> *datapoints = ReadingStreamPayload::toDatapoints(payload.data(), payload.length());
+	ASSERT_TRUE(datapoints != NULL);
+	ASSERT_EQ(datapoints->size(), 3);
+	DPImage *image = (*datapoints)[0]->getData().getImage();
+	ASSERT_EQ(image->getWidth(), 4);
+	ASSERT_EQ(image->getHeight(), 3);
+	ASSERT_EQ(image->getDepth(), 8);
+	ASSERT_EQ(memcmp(image->getData(),
+			reading->getReadingData()[0]->getData().getImage()->getData(), 12), 0);
+	DataBuffer *buffer = (*datapoints)[2]->getData().getDataBuffer();
+	ASSERT_EQ(buffer->getItemSize(), sizeof(uint16_t));
+	ASSERT_EQ(buffer->getItemCount(), 5);
+	ASSERT_EQ(((uint16_t *)buffer->getData())[4], 4000);
+	for (auto dp : *datapoints)
+		delete dp;
+	delete datapoints;
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, References)
+{
+	Reading *reading = binaryReading();
+	string inlined, payload;
+	vector<PayloadReference> references;
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), inlined));
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), payload, &references));
+	ASSERT_EQ(references.size(), 2);
+	ASSERT_EQ(references[0].data, reading->getReadingData()[0]->getData().getImage()->getData());
+
+	// Interleaving the references with the payload gives the inline payload
+	string assembled;
+	size_t sent = 0;
+	for (auto& reference : references)
+	{
+		assembled.append(payload, sent, reference.offset - sent);
+		assembled.append((const char *)reference.data, reference.length);
+		sent = reference.offset;
+	}
+	assembled.append(payload, sent, string::npos);
+	ASSERT_EQ(assembled.compare(inlined), 0);
+	delete reading;
+}
+
+TEST(ReadingStreamPayloadTest, FromJSONImage)
+{
+	Reading *reading = binaryReading();
+	string json = reading->getDatapointsJSON();
+	rapidjson::Document doc;
+	ASSERT_FALSE(doc.Parse(json.c_str()).HasParseError());
+	string payload, expected, decoded;
+	ASSERT_TRUE(ReadingStreamPayload::fromJSON(doc, payload));
+	ASSERT_TRUE(ReadingStreamPayload::encode(reading->getReadingData(), expected));
+	ASSERT_EQ(payload.compare(expected), 0);
+	ASSERT_TRUE(ReadingStreamPayload::toJSON(payload.data(), payload.length(), decoded));
+	ASSERT_EQ(decoded.compare(json), 0);
+	delete reading;
+}
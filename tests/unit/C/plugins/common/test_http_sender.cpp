@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <http_sender.h>
+#include <libcurl_multi.h>
+#include <server_http.hpp>
+#include <thread>
+#include <chrono>
+#include <atomic>
+
+/*
+ * Fledge HTTP senders unit tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+using namespace std;
+
+using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
+
+/**
+ * A sender that replies to each path with a fixed outcome
+ */
+class FixedSender : public HttpSender {
+	public:
+		void setProxy(const string& proxy) {};
+		int sendRequest(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload)
+		{
+			if (path == "/bad")
+				throw BadRequest("bad " + payload);
+			if (path == "/conflict")
+				throw Conflict("conflict");
+			if (path == "/down")
+				throw runtime_error("down");
+			m_response = "ok " + payload;
+			return 204;
+		};
+		string getHostPort() { return "localhost:0"; };
+		string getHTTPResponse() { return m_response; };
+		void setAuthMethod(string& authMethod) {};
+		void setAuthBasicCredentials(string& authBasicCredentials) {};
+		void setOCSNamespace(string& OCSNamespace) {};
+		void setOCSTenantId(string& OCSTenantId) {};
+		void setOCSClientId(string& OCSClientId) {};
+		void setOCSClientSecret(string& OCSClientSecret) {};
+		void setOCSToken(string& OCSToken) {};
+	private:
+		string	m_response;
+};
+
+TEST(HttpSender, SendRequestsSequential)
+{
+	FixedSender sender;
+	vector<HttpRequest> requests;
+	requests.emplace_back("POST", "/ok", vector<pair<string, string>>(), "1");
+	requests.emplace_back("POST", "/bad", vector<pair<string, string>>(), "2");
+	requests.emplace_back("POST", "/conflict", vector<pair<string, string>>(), "3");
+	requests.emplace_back("POST", "/down", vector<pair<string, string>>(), "4");
+	sender.sendRequests(requests);
+	ASSERT_EQ(204, requests[0].httpCode);
+	ASSERT_EQ(0, requests[0].response.compare("ok 1"));
+	ASSERT_EQ(400, requests[1].httpCode);
+	ASSERT_EQ(0, requests[1].response.compare("bad 2"));
+	ASSERT_EQ(409, requests[2].httpCode);
+	ASSERT_EQ(0, requests[3].httpCode);
+	ASSERT_EQ(0, requests[3].response.compare("down"));
+}
+
+TEST(LibcurlMulti, ConnectionRefused)
+{
+	LibcurlMulti sender("http", "127.0.0.1:1", 2, 2, 0, 1, 4);
+	vector<HttpRequest> requests;
+	for (int i = 0; i < 3; i++)
+		requests.emplace_back("POST", "/data", vector<pair<string, string>>(), "[]");
+	sender.sendRequests(requests);
+	for (auto& request : requests)
+	{
+		ASSERT_EQ(0, request.httpCode);
+		ASSERT_FALSE(request.response.empty());
+	}
+	ASSERT_THROW(sender.sendRequest("POST", "/data", {}, "[]"), runtime_error);
+}
+
+TEST(LibcurlMulti, Concurrent)
+{
+	HttpServer server;
+	server.config.port = 0;
+	server.config.thread_pool_size = 8;
+	atomic<int> received(0);
+	server.resource["^/data$"]["POST"] = [&received](shared_ptr<HttpServer::Response> response,
+						shared_ptr<HttpServer::Request> request) {
+		string content = request->content.string();
+		received++;
+		this_thread::sleep_for(chrono::milliseconds(25));
+		if (content.compare("bad") == 0)
+			response->write(SimpleWeb::StatusCode::client_error_bad_request, "rejected");
+		else
+			response->write(SimpleWeb::StatusCode::success_ok, "accepted " + content);
+	};
+	unsigned short port = 0;
+	thread serverThread([&server, &port]() {
+		server.start([&port](unsigned short p) { port = p; });
+	});
+	for (int i = 0; i < 100 && port == 0; i++)
+		this_thread::sleep_for(chrono::milliseconds(20));
+	ASSERT_NE(0, port);
+
+	LibcurlMulti sender("http", "127.0.0.1:" + to_string(port), 5, 5, 0, 1, 8);
+	vector<HttpRequest> requests;
+	for (int i = 0; i < 8; i++)
+		requests.emplace_back("POST", "/data", vector<pair<string, string>>(), i == 5 ? "bad" : to_string(i));
+
+	auto start = chrono::steady_clock::now();
+	sender.sendRequests(requests);
+	auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+
+	server.stop();
+	serverThread.join();
+
+	ASSERT_EQ(8, received);
+	// Sent one after another the requests take 200ms
+	ASSERT_LT(elapsed, 150);
+	for (int i = 0; i < 8; i++)
+	{
+		if (i == 5)
+		{
+			ASSERT_EQ(400, requests[i].httpCode);
+			ASSERT_EQ(0, requests[i].response.compare("rejected"));
+		}
+		else
+		{
+			ASSERT_EQ(200, requests[i].httpCode);
+			ASSERT_EQ(0, requests[i].response.compare("accepted " + to_string(i)));
+		}
+	}
+}
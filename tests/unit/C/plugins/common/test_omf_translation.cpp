@@ -788,3 +788,274 @@ TEST(OMF_hints, variableExtract)
 	ASSERT_EQ (value, "Orange");
 	ASSERT_EQ (deafult, "unknown12");
 }
+
+TEST(OMF_hints, cache)
+{
+	OMFHintCache cache(2);
+	string number = "{\"number\":\"float32\"}";
+	string integer = "{\"integer\":\"int32\"}";
+	string tag = "{\"tagName\":\"pump\"}";
+
+	shared_ptr<OMFHints> hints = cache.find(number);
+	ASSERT_EQ(hints->getHints().size(), 1);
+	ASSERT_EQ(hints->getHints()[0]->getHint(), "float32");
+	ASSERT_EQ(cache.find(number), hints);
+	ASSERT_EQ(cache.getHits(), 1);
+	ASSERT_EQ(cache.getMisses(), 1);
+
+	// The least recently used hint is evicted, a hint still in use remains valid
+	cache.find(integer);
+	cache.find(number);
+	cache.find(tag);
+	ASSERT_EQ(cache.find(number), hints);
+	ASSERT_EQ(cache.getMisses(), 3);
+	cache.find(integer);
+	ASSERT_EQ(cache.getMisses(), 4);
+
+	cache.clear();
+	ASSERT_NE(cache.find(number), hints);
+	ASSERT_EQ(hints->getHints()[0]->getHint(), "float32");
+}
+
+TEST(OMF_hints, cacheGrows)
+{
+	OMFHintCache cache(4, 64);
+	vector<string> tags;
+	for (int i = 0; i < 40; i++)
+	{
+		tags.push_back("{\"tagName\":\"pump" + to_string(i) + "\"}");
+	}
+
+	// Round robin through more distinct hints than the initial size
+	for (int round = 0; round < 10; round++)
+	{
+		for (auto& tag : tags)
+		{
+			cache.find(tag);
+		}
+	}
+	ASSERT_GE(cache.getSize(), tags.size());
+	ASSERT_GT(cache.getHits(), 7 * tags.size());
+
+	// Once grown every hint hits
+	unsigned long misses = cache.getMisses();
+	for (auto& tag : tags)
+	{
+		ASSERT_EQ(cache.find(tag)->getHints()[0]->getHint(), tag.substr(12, tag.size() - 14));
+	}
+	ASSERT_EQ(cache.getMisses(), misses);
+
+	// The cache does not grow beyond its maximum
+	OMFHintCache bounded(4, 6);
+	for (int round = 0; round < 3; round++)
+	{
+		for (int i = 0; i < 6; i++)
+		{
+			bounded.find(tags[i]);
+		}
+	}
+	ASSERT_EQ(bounded.getSize(), 6);
+	ASSERT_EQ(bounded.getHits(), 10);
+}
+
+/**
+ * A sender that rejects data messages as a bad request while m_reject is set
+ */
+class RejectingSender : public HttpSender {
+	public:
+		void setProxy(const string& proxy) {};
+		int sendRequest(const string& method, const string& path,
+				const vector<pair<string, string>>& headers,
+				const string& payload)
+		{
+			for (auto& header : headers)
+			{
+				if (header.first == "messagetype" && header.second == "Data")
+				{
+					m_dataRequests++;
+					if (m_reject)
+						throw BadRequest("{\"Messages\": []}");
+				}
+			}
+			return 204;
+		};
+		string getHostPort() { return "localhost:0"; };
+		string getHTTPResponse() { return "{\"Messages\": []}"; };
+		void setAuthMethod(string& authMethod) {};
+		void setAuthBasicCredentials(string& authBasicCredentials) {};
+		void setOCSNamespace(string& OCSNamespace) {};
+		void setOCSTenantId(string& OCSTenantId) {};
+		void setOCSClientId(string& OCSClientId) {};
+		void setOCSClientSecret(string& OCSClientSecret) {};
+		void setOCSToken(string& OCSToken) {};
+		int	m_dataRequests = 0;
+		bool	m_reject = true;
+};
+
+TEST(OMF_linkedState, restore)
+{
+	LALookup restored(LAL_CONTAINER_SENT | LAL_LINK_SENT, OMFBT_INTEGER64, "pump.speed");
+	ASSERT_TRUE(restored.containerState("pump.speed"));
+	ASSERT_TRUE(restored.linkState("pump.speed"));
+	ASSERT_FALSE(restored.containerState("pump.flow"));
+	ASSERT_EQ(restored.getBaseTypeString(), "Integer64");
+
+	string version("1.2");
+	unordered_map<string, LALookup> state;
+	state.emplace("pump.", LALookup(LAL_ASSET_SENT, OMFBT_UNKNOWN, "pump"));
+	state.emplace("pump.speed", restored);
+
+	RejectingSender sender;
+	map<string, OMFDataTypes> types;
+	vector<pair<string, string>> staticData;
+	OMF omf("test", sender, "/", types, "ABC");
+	omf.setSendFullStructure(false);
+	omf.setStaticData(&staticData);
+	omf.setPIServerEndpoint(ENDPOINT_CR);
+	omf.setNamingScheme(NAMINGSCHEME_CONCISE);
+	omf.setOMFVersion(version);
+	omf.setLinkedState(state, true);
+	ASSERT_TRUE(omf.getBaseTypesSent());
+	ASSERT_EQ(omf.getLinkedState().size(), 2);
+	ASSERT_EQ(omf.getLinkedState().at("pump.speed").getSentState(), LAL_CONTAINER_SENT | LAL_LINK_SENT);
+	ASSERT_EQ(omf.getLinkedState().at("pump.speed").getTagName(), "pump.speed");
+
+	// The first rejection of data discards the restored state
+	DatapointValue value((long)10);
+	Reading reading("pump", new Datapoint("speed", value));
+	vector<Reading *> readings = { &reading };
+	ASSERT_EQ(omf.sendToServer(readings, false), 0);
+	ASSERT_EQ(sender.m_dataRequests, 1);
+	ASSERT_FALSE(omf.getBaseTypesSent());
+	ASSERT_TRUE(omf.getLinkedState().empty());
+}
+
+TEST(OMF_linkedState, rejectAsset)
+{
+	string version("1.2");
+	unordered_map<string, LALookup> state;
+	state.emplace("pump.", LALookup(LAL_ASSET_SENT, OMFBT_UNKNOWN, "pump"));
+	state.emplace("pump.speed", LALookup(LAL_CONTAINER_SENT | LAL_LINK_SENT, OMFBT_INTEGER64, "pump.speed"));
+	state.emplace("pump.inlet.", LALookup(LAL_ASSET_SENT, OMFBT_UNKNOWN, "pump.inlet"));
+	state.emplace("pump.inlet.flow", LALookup(LAL_CONTAINER_SENT | LAL_LINK_SENT, OMFBT_INTEGER64, "pump.inlet.flow"));
+
+	RejectingSender sender;
+	map<string, OMFDataTypes> types;
+	vector<pair<string, string>> staticData;
+	OMF omf("test", sender, "/", types, "ABC");
+	omf.setSendFullStructure(false);
+	omf.setStaticData(&staticData);
+	omf.setPIServerEndpoint(ENDPOINT_CR);
+	omf.setNamingScheme(NAMINGSCHEME_CONCISE);
+	omf.setOMFVersion(version);
+	omf.setLinkedState(state, true);
+
+	// Data of the first asset is accepted, confirming its state and the base types
+	DatapointValue value((long)10);
+	Reading speed("pump", new Datapoint("speed", value));
+	vector<Reading *> readings = { &speed };
+	sender.m_reject = false;
+	ASSERT_EQ(omf.sendToServer(readings, false), 1);
+
+	// A later rejection of the second asset only discards the state of that asset
+	Reading flow("pump.inlet", new Datapoint("flow", value));
+	readings = { &flow, &speed };
+	sender.m_reject = true;
+	ASSERT_EQ(omf.sendToServer(readings, false), 0);
+	ASSERT_EQ(sender.m_dataRequests, 2);
+	ASSERT_TRUE(omf.getBaseTypesSent());
+	ASSERT_EQ(omf.getLinkedState().size(), 2);
+	ASSERT_EQ(omf.getLinkedState().at("pump.speed").getSentState(), LAL_CONTAINER_SENT | LAL_LINK_SENT);
+	ASSERT_EQ(omf.getLinkedState().count("pump.inlet.flow"), 0);
+}
+
+TEST(OMF_buffer, coalesceAndCompress)
+{
+	OMFBuffer payload;
+	string expected;
+	payload.append('[');
+	expected.append("[");
+	for (int i = 0; i < 2000; i++)
+	{
+		string item = "{\"containerid\": \"pump." + to_string(i) + "\"},";
+		payload.append(item);
+		expected.append(item);
+	}
+	payload.append(']');
+	expected.append("]");
+	ASSERT_EQ(payload.length(), expected.length());
+
+	string coalesced;
+	payload.coalesce(coalesced);
+	ASSERT_EQ(coalesced, expected);
+
+	string compressed = payload.compress();
+	ASSERT_LT(compressed.length(), expected.length());
+
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	ASSERT_EQ(inflateInit2(&zs, 15 + 16), Z_OK);
+	string inflated(expected.length() + 1, 0);
+	zs.next_in = (Bytef *)compressed.data();
+	zs.avail_in = compressed.length();
+	zs.next_out = (Bytef *)&inflated[0];
+	zs.avail_out = inflated.length();
+	ASSERT_EQ(inflate(&zs, Z_FINISH), Z_STREAM_END);
+	inflated.resize(zs.total_out);
+	inflateEnd(&zs);
+	ASSERT_EQ(inflated, expected);
+}
+
+/**
+ * Decompress a single gzip payload
+ */
+static string gunzip(const string& compressed, size_t length)
+{
+	z_stream zs;
+	memset(&zs, 0, sizeof(zs));
+	inflateInit2(&zs, 15 + 16);
+	string inflated(length + 1, 0);
+	zs.next_in = (Bytef *)compressed.data();
+	zs.avail_in = compressed.length();
+	zs.next_out = (Bytef *)&inflated[0];
+	zs.avail_out = inflated.length();
+	int ret = inflate(&zs, Z_FINISH);
+	inflated.resize(ret == Z_STREAM_END ? zs.total_out : 0);
+	inflateEnd(&zs);
+	return inflated;
+}
+
+TEST(OMF_compressor, reuse)
+{
+	OMFCompressor compressor;
+	size_t uncompressed = 0, compressed = 0;
+	for (int block = 0; block < 3; block++)
+	{
+		OMFBuffer payload;
+		string expected;
+		payload.append('[');
+		expected.append("[");
+		for (int i = 0; i < 500 * (block + 1); i++)
+		{
+			string item = "{\"containerid\": \"pump." + to_string(i) + "\"},";
+			payload.append(item);
+			expected.append(item);
+		}
+		payload.append(']');
+		expected.append("]");
+
+		// Each payload of the reused stream must decompress alone
+		string body = compressor.compress(payload);
+		ASSERT_EQ(gunzip(body, expected.length()), expected);
+		uncompressed += expected.length();
+		compressed += body.length();
+
+		body = compressor.compress(expected);
+		ASSERT_EQ(gunzip(body, expected.length()), expected);
+		uncompressed += expected.length();
+		compressed += body.length();
+	}
+	ASSERT_EQ(compressor.getUncompressedBytes(), uncompressed);
+	ASSERT_EQ(compressor.getCompressedBytes(), compressed);
+	ASSERT_LT(compressed, uncompressed);
+}
@@ -86,3 +86,50 @@ INSTANTIATE_TEST_CASE_P(
 		RowFormatDate("2019-50-50 10:01:01.0",  "", false)
 	)
 );
+
+class RowTimestamp  {
+	public:
+		const char *test_case;
+		int64_t expected;
+		bool result;
+
+		RowTimestamp(const char *p1, int64_t p2, bool p3) {
+			test_case = p1;
+			expected = p2;
+			result = p3;
+		};
+};
+
+class TestPostgresTimestamp : public ::testing::TestWithParam<RowTimestamp> {
+};
+
+TEST_P(TestPostgresTimestamp, TestConversions)
+{
+	RowTimestamp const& p = GetParam();
+
+	int64_t timestamp = 0;
+	bool result = Connection::postgresTimestamp(p.test_case, timestamp);
+
+	ASSERT_EQ(result, p.result);
+	if (result)
+	{
+		ASSERT_EQ(timestamp, p.expected);
+	}
+}
+
+INSTANTIATE_TEST_CASE_P(
+	TestConversions,
+	TestPostgresTimestamp,
+	::testing::Values(
+		// Test cases                                      Microseconds since 2000-01-01 UTC
+		RowTimestamp("2000-01-01 00:00:00.000000+00:00" , 0L, true),
+		RowTimestamp("1999-12-31 23:59:59.000001+00:00" , -999999L, true),
+		RowTimestamp("2023-06-01 12:00:00.500000+00:00" , 738936000500000L, true),
+		RowTimestamp("2023-06-01 12:00:00.5+00:00"      , 738936000500000L, true),
+		RowTimestamp("2019-03-04 10:03:04.123456+02:30" , 604999984123456L, true),
+		RowTimestamp("2019-03-05 10:03:05.123456-02:30" , 605104385123456L, true),
+
+		// Bad cases
+		RowTimestamp("xxx",                    0L, false)
+	)
+);
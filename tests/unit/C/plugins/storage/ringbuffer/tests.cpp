@@ -0,0 +1,383 @@
+#include <gtest/gtest.h>
+#include <reading_ring.h>
+#include <ring_snapshot.h>
+#include <ring_query.h>
+#include <ring_manager.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <rapidjson/document.h>
+#include <logger.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+
+using namespace std;
+using namespace rapidjson;
+
+int main(int argc, char **argv) {
+    testing::InitGoogleTest(&argc, argv);
+
+    testing::GTEST_FLAG(repeat) = 5;
+    testing::GTEST_FLAG(shuffle) = true;
+
+    return RUN_ALL_TESTS();
+}
+
+#define TS_BASE	1672531200000000LL	// 2023-01-01 00:00:00 UTC in microseconds
+
+/**
+ * Append a reading to the ring, held as a binary payload as the plugin
+ * holds them if the datapoints allow it
+ */
+static void append(ReadingRing& ring, const string& asset, const string& reading, int64_t userTs)
+{
+	Document doc;
+	string payload;
+	doc.Parse(reading.c_str());
+	if (ReadingStreamPayload::fromJSON(doc, payload))
+		ring.append(asset.c_str(), asset.length(), payload.data(), payload.length(), userTs);
+	else
+		ring.append(asset.c_str(), asset.length(), reading.c_str(), reading.length(), userTs);
+}
+
+static void populate(ReadingRing& ring, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		string reading = "{\"value\":" + to_string(i) + "}";
+		append(ring, i % 2 ? "odd" : "even", reading, TS_BASE + (int64_t)i * 1000000);
+	}
+}
+
+static string snapshotName()
+{
+	char name[80];
+	snprintf(name, sizeof(name), "/tmp/ringbuffer_test_%d.ring", getpid());
+	return string(name);
+}
+
+TEST(RingBufferTest, AppendFetch)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	ASSERT_EQ(ring.readings(), 10);
+
+	string result;
+	ASSERT_TRUE(ring.fetch(3, 4, result));
+	Document doc;
+	ASSERT_FALSE(doc.Parse(result.c_str()).HasParseError());
+	ASSERT_EQ(doc["count"].GetInt(), 4);
+	const Value& rows = doc["rows"];
+	ASSERT_EQ(rows[0]["id"].GetInt(), 3);
+	ASSERT_STREQ(rows[0]["asset_code"].GetString(), "even");
+	ASSERT_EQ(rows[0]["reading"]["value"].GetInt(), 2);
+	ASSERT_STREQ(rows[0]["user_ts"].GetString(), "2023-01-01 00:00:02.000000");
+	ASSERT_EQ(rows[3]["id"].GetInt(), 6);
+}
+
+TEST(RingBufferTest, DiscardWhenFull)
+{
+	ReadingRing ring(4096);
+	populate(ring, 1000);
+	ASSERT_LT(ring.readings(), 1000);
+	ASSERT_LE(ring.used(), ring.capacity());
+
+	// The newest readings are retained and remain in id order
+	string result;
+	ring.fetch(1, 1000, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	const Value& rows = doc["rows"];
+	ASSERT_EQ(rows.Size(), ring.readings());
+	ASSERT_EQ(rows[rows.Size() - 1]["id"].GetInt(), 1000);
+	for (SizeType i = 1; i < rows.Size(); i++)
+	{
+		ASSERT_EQ(rows[i]["id"].GetInt(), rows[i - 1]["id"].GetInt() + 1);
+	}
+}
+
+TEST(RingBufferTest, PurgeByAge)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingPurgeResult result;
+	ring.purge(TS_BASE + 4000000, 0, 2, false, result);
+	ASSERT_EQ(result.removed, 4);
+	ASSERT_EQ(result.unsentPurged, 2);
+	ASSERT_EQ(result.unsentRetained, 6);
+	ASSERT_EQ(result.readings, 6);
+}
+
+TEST(RingBufferTest, PurgeByRowsRetain)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingPurgeResult result;
+	ring.purge(0, 3, 5, true, result);
+	ASSERT_EQ(result.removed, 5);
+	ASSERT_EQ(result.unsentPurged, 0);
+	ASSERT_EQ(result.readings, 5);
+
+	ring.purge(0, 3, 5, false, result);
+	ASSERT_EQ(result.removed, 2);
+	ASSERT_EQ(result.unsentPurged, 2);
+	ASSERT_EQ(result.readings, 3);
+}
+
+TEST(RingBufferTest, RemoveAsset)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	ASSERT_EQ(ring.removeAsset("odd"), 5);
+	ASSERT_EQ(ring.removeAsset("unknown"), 0);
+	ASSERT_EQ(ring.readings(), 5);
+
+	string result;
+	ring.fetch(1, 100, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 5);
+	for (auto& row : doc["rows"].GetArray())
+	{
+		ASSERT_STREQ(row["asset_code"].GetString(), "even");
+	}
+}
+
+TEST(RingBufferTest, SnapshotRoundTrip)
+{
+	string filename = snapshotName();
+	unlink(filename.c_str());
+	{
+		ReadingRing ring(1024 * 1024);
+		RingSnapshot snapshot(filename);
+		ASSERT_FALSE(snapshot.load(ring));
+		populate(ring, 10);
+		ASSERT_TRUE(snapshot.save(ring));
+
+		// Incremental changes are appended to the journal
+		populate(ring, 4);
+		ring.removeAsset("odd");
+		RingPurgeResult result;
+		ring.purge(0, 5, 100, false, result);
+		ASSERT_TRUE(snapshot.save(ring));
+	}
+
+	ReadingRing ring(1024 * 1024);
+	RingSnapshot snapshot(filename);
+	ASSERT_TRUE(snapshot.load(ring));
+	ASSERT_EQ(ring.readings(), 5);
+
+	string result;
+	ring.fetch(1, 100, result);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 5);
+	ASSERT_EQ(doc["rows"][0]["id"].GetInt(), 5);
+	ASSERT_STREQ(doc["rows"][0]["asset_code"].GetString(), "even");
+
+	// New readings continue the sequence of ids
+	append(ring, "new", "{\"a\":1}", TS_BASE);
+	ring.fetch(15, 1, result);
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 1);
+	ASSERT_STREQ(doc["rows"][0]["asset_code"].GetString(), "new");
+	unlink(filename.c_str());
+}
+
+TEST(RingBufferTest, Timestamps)
+{
+	int64_t ts;
+	char buffer[40];
+
+	ASSERT_TRUE(ReadingRing::parseTimestamp("2023-01-01 00:00:01.5", ts));
+	ASSERT_EQ(ts, TS_BASE + 1500000);
+	ASSERT_TRUE(ReadingRing::parseTimestamp("2023-01-01T01:00:00.000001+01:00", ts));
+	ASSERT_EQ(ts, TS_BASE + 1);
+	ASSERT_FALSE(ReadingRing::parseTimestamp("not a date", ts));
+
+	ReadingRing::formatTimestamp(TS_BASE + 123456, buffer, sizeof(buffer));
+	ASSERT_STREQ(buffer, "2023-01-01 00:00:00.123456");
+}
+
+TEST(RingBufferTest, QueryWhereSortLimit)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"where\" : { \"column\" : \"asset_code\", \"condition\" : \"=\", \"value\" : \"odd\" }, "
+				"\"sort\" : { \"column\" : \"id\", \"direction\" : \"desc\" }, \"limit\" : 2 }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 2);
+	ASSERT_EQ(doc["rows"][0]["id"].GetInt(), 10);
+	ASSERT_EQ(doc["rows"][1]["id"].GetInt(), 8);
+	ASSERT_EQ(doc["rows"][1]["reading"]["value"].GetInt(), 7);
+}
+
+TEST(RingBufferTest, QueryReturnProperties)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"return\" : [ \"user_ts\", { \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"v\" } ], "
+				"\"where\" : { \"column\" : \"id\", \"condition\" : \">\", \"value\" : 8 } }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 2);
+	ASSERT_EQ(doc["rows"][0]["v"].GetInt(), 8);
+	ASSERT_STREQ(doc["rows"][0]["user_ts"].GetString(), "2023-01-01 00:00:08.000000");
+}
+
+TEST(RingBufferTest, QueryGroupCount)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 9);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"aggregate\" : { \"operation\" : \"count\", \"column\" : \"*\" }, \"group\" : \"asset_code\" }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 2);
+	ASSERT_STREQ(doc["rows"][0]["asset_code"].GetString(), "even");
+	ASSERT_EQ(doc["rows"][0]["count_*"].GetInt(), 5);
+	ASSERT_EQ(doc["rows"][1]["count_*"].GetInt(), 4);
+}
+
+TEST(RingBufferTest, QueryPropertyAggregates)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"aggregate\" : [ "
+				"{ \"operation\" : \"min\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"min\" }, "
+				"{ \"operation\" : \"max\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"max\" }, "
+				"{ \"operation\" : \"avg\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"avg\" } ], "
+				"\"where\" : { \"column\" : \"asset_code\", \"condition\" : \"=\", \"value\" : \"even\" } }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 1);
+	ASSERT_EQ(doc["rows"][0]["min"].GetDouble(), 0.0);
+	ASSERT_EQ(doc["rows"][0]["max"].GetDouble(), 8.0);
+	ASSERT_EQ(doc["rows"][0]["avg"].GetDouble(), 4.0);
+}
+
+TEST(RingBufferTest, QueryTimebucket)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"aggregate\" : [ "
+				"{ \"operation\" : \"min\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"min\" }, "
+				"{ \"operation\" : \"avg\", \"json\" : { \"column\" : \"reading\", \"properties\" : \"value\" }, \"alias\" : \"average\" } ], "
+				"\"timebucket\" : { \"timestamp\" : \"user_ts\", \"size\" : \"5\", \"format\" : \"YYYY-MM-DD HH24:MI:SS\", \"alias\" : \"timestamp\" }, "
+				"\"limit\" : 10 }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["count"].GetInt(), 2);
+	// Buckets start at multiples of the size and are returned newest first
+	ASSERT_STREQ(doc["rows"][0]["timestamp"].GetString(), "2023-01-01 00:00:05");
+	ASSERT_EQ(doc["rows"][0]["min"].GetDouble(), 5.0);
+	ASSERT_EQ(doc["rows"][0]["average"].GetDouble(), 7.0);
+	ASSERT_STREQ(doc["rows"][1]["timestamp"].GetString(), "2023-01-01 00:00:00");
+	ASSERT_EQ(doc["rows"][1]["average"].GetDouble(), 2.0);
+}
+
+TEST(RingBufferTest, QueryAggregateAll)
+{
+	ReadingRing ring(1024 * 1024);
+	populate(ring, 10);
+	RingQuery query(ring);
+	string result;
+	ASSERT_TRUE(query.execute("{ \"aggregate\" : { \"operation\" : \"all\" }, "
+				"\"where\" : { \"column\" : \"asset_code\", \"condition\" : \"in\", \"value\" : [ \"even\" ] }, "
+				"\"timebucket\" : { \"timestamp\" : \"user_ts\", \"size\" : \"10\" } }", result));
+	Document doc;
+	doc.Parse(result.c_str());
+	// Buckets are centred on multiples of the size, the even readings
+	// at 0, 2 and 4 seconds fall in the first and those at 6 and 8 in
+	// the second
+	ASSERT_EQ(doc["count"].GetInt(), 2);
+	const Value& newest = doc["rows"][0];
+	ASSERT_STREQ(newest["asset_code"].GetString(), "even");
+	ASSERT_STREQ(newest["timestamp"].GetString(), "2023-01-01 00:00:10");
+	ASSERT_EQ(newest["reading"]["value"]["min"].GetDouble(), 6.0);
+	ASSERT_EQ(newest["reading"]["value"]["max"].GetDouble(), 8.0);
+	ASSERT_EQ(newest["reading"]["value"]["count"].GetInt(), 2);
+	const Value& oldest = doc["rows"][1];
+	ASSERT_EQ(oldest["reading"]["value"]["sum"].GetDouble(), 6.0);
+	ASSERT_EQ(oldest["reading"]["value"]["average"].GetDouble(), 2.0);
+}
+
+TEST(RingBufferTest, QueryUnsupported)
+{
+	ReadingRing ring(1024 * 1024);
+	RingQuery query(ring);
+	string result;
+	ASSERT_FALSE(query.execute("{ \"aggregate\" : { \"operation\" : \"count\", \"column\" : \"*\" }, "
+				"\"timebucket\" : { \"timestamp\" : \"user_ts\", \"size\" : \"1\" }, "
+				"\"sort\" : { \"column\" : \"id\" } }", result));
+	ASSERT_FALSE(query.error().empty());
+	RingQuery join(ring);
+	ASSERT_FALSE(join.execute("{ \"join\" : { } }", result));
+}
+
+TEST(RingBufferTest, TypedRecords)
+{
+	RingManager manager(1024 * 1024);
+	ASSERT_EQ(manager.appendReadings("{ \"readings\" : [ "
+				"{ \"asset_code\" : \"typed\", \"user_ts\" : \"2023-01-01 00:00:00\", \"reading\" : { \"x\" : 1, \"y\" : 2.5, \"s\" : \"str\" } }, "
+				"{ \"asset_code\" : \"text\", \"user_ts\" : \"2023-01-01 00:00:01\", \"reading\" : { \"x\" : 3, \"flag\" : true } } ] }"), 2);
+
+	// Readings are held as binary payloads unless they have no binary encoding
+	string result;
+	ASSERT_TRUE(manager.fetchReadingsBinary(1, 10, result));
+	ASSERT_GE(result.length(), sizeof(RDSFetchHeader));
+	RDSFetchHeader header;
+	memcpy(&header, result.data(), sizeof(header));
+	ASSERT_EQ(header.magic, RDS_FETCH_MAGIC);
+	ASSERT_EQ(header.count, 2);
+	const char *p = result.data() + sizeof(header);
+	RDSFetchReading reading;
+	memcpy(&reading, p, sizeof(reading));
+	const char *payload = p + sizeof(reading) + reading.assetLength + reading.userTsLength + reading.tsLength;
+	ASSERT_TRUE(RDS_PAYLOAD_IS_BINARY(payload));
+	p = payload + reading.payloadLength;
+	memcpy(&reading, p, sizeof(reading));
+	payload = p + sizeof(reading) + reading.assetLength + reading.userTsLength + reading.tsLength;
+	ASSERT_EQ(string(payload, reading.payloadLength), "{\"x\":3,\"flag\":true}");
+
+	// Both forms are returned as JSON and may be aggregated
+	ASSERT_TRUE(manager.fetchReadings(1, 10, result));
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["rows"][0]["reading"]["y"].GetDouble(), 2.5);
+	ASSERT_STREQ(doc["rows"][0]["reading"]["s"].GetString(), "str");
+	ASSERT_TRUE(doc["rows"][1]["reading"]["flag"].GetBool());
+	ASSERT_TRUE(manager.retrieveReadings("{ \"aggregate\" : { \"operation\" : \"sum\", "
+				"\"json\" : { \"column\" : \"reading\", \"properties\" : \"x\" }, \"alias\" : \"sum\" } }", result));
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["rows"][0]["sum"].GetDouble(), 4.0);
+}
+
+TEST(RingBufferTest, ManagerAppendPurge)
+{
+	RingManager manager(1024 * 1024);
+	ASSERT_EQ(manager.appendReadings("{ \"readings\" : [ "
+				"{ \"asset_code\" : \"a\", \"user_ts\" : \"2023-01-01 00:00:00.000000+00:00\", \"reading\" : { \"x\" : 1 } }, "
+				"{ \"asset_code\" : \"\", \"user_ts\" : \"now()\", \"reading\" : { \"x\" : 2 } }, "
+				"{ \"asset_code\" : \"b\", \"user_ts\" : \"now()\", \"reading\" : { \"x\" : 3 } } ] }"), 2);
+	ASSERT_EQ(manager.appendReadings("not json"), -1);
+	ASSERT_STREQ(manager.getError()->entryPoint, "appendReadings");
+
+	string result;
+	ASSERT_EQ(manager.purgeReadings(1, 0, 0, result), 1);
+	Document doc;
+	doc.Parse(result.c_str());
+	ASSERT_EQ(doc["removed"].GetInt(), 1);
+	ASSERT_EQ(doc["readings"].GetInt(), 1);
+	ASSERT_STREQ(doc["method"].GetString(), "age");
+}
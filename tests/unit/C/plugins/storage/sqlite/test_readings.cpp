@@ -0,0 +1,689 @@
+#include <gtest/gtest.h>
+#include <plugin_api.h>
+#include <config_category.h>
+#include <connection.h>
+#include <connection_manager.h>
+#include <readings_catalogue.h>
+#include <readings_rollup.h>
+#include <reading_stream.h>
+#include <reading_stream_payload.h>
+#include <logger.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <thread>
+#include "rapidjson/document.h"
+
+using namespace std;
+using namespace rapidjson;
+
+extern "C" {
+PLUGIN_INFORMATION *plugin_info();
+PLUGIN_HANDLE plugin_init(ConfigCategory *category);
+int plugin_reading_append(PLUGIN_HANDLE handle, char *readings);
+char *plugin_reading_fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize);
+char *plugin_reading_purge(PLUGIN_HANDLE handle, unsigned long param, unsigned int flags, unsigned long sent);
+void plugin_release(PLUGIN_HANDLE handle, char *results);
+};
+
+/*
+ * The tests in this file use a readings database created in a temporary
+ * data directory by the storage plugin init scripts, which are found via
+ * FLEDGE_ROOT. Each test runs in a process of its own, as the threadsafe
+ * death tests do, since the storage plugin is a set of singletons that
+ * may only be initialised once.
+ */
+#define CHECK(cond)	if (!(cond)) { cerr << __FILE__ << ":" << __LINE__ << ": " << #cond << endl; return false; }
+
+#define SKIP_WITHOUT_FLEDGE_ROOT()	if (!getenv("FLEDGE_ROOT")) { GTEST_SKIP() << "FLEDGE_ROOT is not set"; }
+
+/**
+ * Create a database by running one of the storage plugin init scripts
+ */
+static bool createDatabase(const string& dataDir, const string& name, const string& script)
+{
+	ifstream in(script);
+	if (!in)
+	{
+		cerr << "Unable to read " << script << endl;
+		return false;
+	}
+	stringstream sql;
+	sql << "PRAGMA page_size = 4096; ATTACH DATABASE '" << dataDir << "/" << name << ".db' AS '" << name << "';";
+	sql << in.rdbuf();
+
+	sqlite3 *db;
+	string path = dataDir + "/" + name + ".db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		return false;
+	}
+	char *errMsg = NULL;
+	bool rval = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, &errMsg) == SQLITE_OK;
+	if (!rval)
+	{
+		cerr << "Failed to initialise " << path << ": " << errMsg << endl;
+		sqlite3_free(errMsg);
+	}
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Create a readings database, initialise the storage plugin with the
+ * given configuration items and run a test against it
+ *
+ * @param test		The test to run
+ * @param items		Configuration items that differ from the defaults
+ * @param setup		Called with the data directory before the plugin is initialised
+ * @return int		The exit status of the test process
+ */
+static int runWithDatabase(const function<bool(PLUGIN_HANDLE, const string&)>& test,
+		const map<string, string>& items = {},
+		const function<bool(const string&)>& setup = nullptr)
+{
+	string scripts = string(getenv("FLEDGE_ROOT")) + "/scripts/plugins/storage/sqlite/";
+	char dataDir[] = "/tmp/sqlite_tests_XXXXXX";
+	if (!mkdtemp(dataDir))
+	{
+		return 1;
+	}
+	setenv("FLEDGE_DATA", dataDir, 1);
+	Logger::getLogger()->setMinLevel("warning");
+
+	bool ok = false;
+	if (createDatabase(dataDir, "fledge", scripts + "init.sql") &&
+			createDatabase(dataDir, "readings_1", scripts + "init_readings.sql") &&
+			(!setup || setup(dataDir)))
+	{
+		ConfigCategory config("sqlite", plugin_info()->config);
+		config.setItemsValueFromDefault();
+		for (auto& item : items)
+		{
+			config.setValue(item.first, item.second);
+		}
+		// The plugin is not shutdown, the process exits once the test
+		// is complete and shutdown waits for the background thread of
+		// the connection manager
+		PLUGIN_HANDLE handle = plugin_init(&config);
+		ok = test(handle, dataDir);
+	}
+
+	string cleanup = string("rm -rf ") + dataDir;
+	system(cleanup.c_str());
+	return ok ? 0 : 1;
+}
+
+/**
+ * Return the readings append payload for a number of readings spread
+ * over a number of assets, one reading per second from a given time
+ *
+ * @param first		The value of the first reading
+ * @param count		The number of readings
+ * @param assets	The number of assets
+ * @param start		The user timestamp of the first reading
+ */
+static string readingsPayload(long first, int count, int assets, const string& start = "2023-01-01 00:00:00")
+{
+	struct tm tm;
+	memset(&tm, 0, sizeof(tm));
+	strptime(start.c_str(), "%Y-%m-%d %H:%M:%S", &tm);
+	time_t base = timegm(&tm);
+
+	string payload = "{\"readings\":[";
+	for (int i = 0; i < count; i++)
+	{
+		time_t when = base + i;
+		char ts[40], reading[200];
+		strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S", gmtime_r(&when, &tm));
+		snprintf(reading, sizeof(reading),
+			"%s{\"asset_code\":\"asset_%ld\",\"user_ts\":\"%s.000000+00:00\",\"reading\":{\"value\":%ld}}",
+			i ? "," : "", (first + i) % assets, ts, first + i);
+		payload += reading;
+	}
+	payload += "]}";
+	return payload;
+}
+
+/**
+ * Fetch a block of readings through the storage plugin
+ *
+ * @param handle	The storage plugin handle
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param doc		Populated with the parsed result
+ */
+static bool fetch(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize, Document& doc)
+{
+	char *result = plugin_reading_fetch(handle, id, blksize);
+	if (!result)
+	{
+		return false;
+	}
+	doc.Parse(result);
+	plugin_release(handle, result);
+	return !doc.HasParseError() && doc.HasMember("rows") && doc["rows"].IsArray();
+}
+
+/**
+ * Return the number of readings insert statements prepared on a connection
+ */
+static int insertStatements(sqlite3 *db)
+{
+	int count = 0;
+	for (sqlite3_stmt *stmt = sqlite3_next_stmt(db, NULL); stmt; stmt = sqlite3_next_stmt(db, stmt))
+	{
+		if (strncmp(sqlite3_sql(stmt), "INSERT INTO  readings_", 22) == 0)
+		{
+			count++;
+		}
+	}
+	return count;
+}
+
+/**
+ * Trace callback that records the number of statements still prepared
+ * when the connection is closed
+ */
+static int closeTrace(unsigned int type, void *ctx, void *p, void *x)
+{
+	if (type == SQLITE_TRACE_CLOSE)
+	{
+		int *open = (int *)ctx;
+		*open = 0;
+		for (sqlite3_stmt *stmt = sqlite3_next_stmt((sqlite3 *)p, NULL); stmt;
+				stmt = sqlite3_next_stmt((sqlite3 *)p, stmt))
+		{
+			(*open)++;
+		}
+	}
+	return 0;
+}
+
+/**
+ * The insert statements are prepared once per table and reused, they
+ * are prepared again after a change to the attached databases and are
+ * finalised when the connection is closed.
+ */
+static bool statementCache(PLUGIN_HANDLE handle, const string& dataDir)
+{
+	Connection *connection = new Connection();
+	sqlite3 *db = connection->getDbHandle();
+
+	CHECK(connection->appendReadings(readingsPayload(0, 10, 2).c_str()) == 10);
+	CHECK(insertStatements(db) == 2);
+	CHECK(connection->appendReadings(readingsPayload(10, 10, 2).c_str()) == 10);
+	CHECK(insertStatements(db) == 2);
+
+	// Detach and reattach the readings database, the statements
+	// prepared against it are replaced rather than added to
+	ReadingsCatalogue *catalogue = ReadingsCatalogue::getInstance();
+	string alias = catalogue->generateDbAlias(1);
+	string path = dataDir + "/" + catalogue->generateDbFileName(1);
+	unsigned long generation = catalogue->getGeneration();
+	catalogue->detachDb(db, alias);
+	CHECK(catalogue->attachDb(db, path, alias, 1));
+	CHECK(catalogue->getGeneration() != generation);
+	CHECK(connection->appendReadings(readingsPayload(20, 10, 2).c_str()) == 10);
+	CHECK(insertStatements(db) == 2);
+
+	Document doc;
+	CHECK(fetch(handle, 1, 100, doc));
+	CHECK(doc["count"].GetInt() == 30);
+
+	int open = -1;
+	sqlite3_trace_v2(db, SQLITE_TRACE_CLOSE, closeTrace, &open);
+	delete connection;
+	CHECK(open == 0);
+	return true;
+}
+
+TEST(SQLiteReadings, StatementCache)
+{
+	SKIP_WITHOUT_FLEDGE_ROOT();
+	EXPECT_EXIT({ exit(runWithDatabase(statementCache)); }, ::testing::ExitedWithCode(0), "");
+}
+
+/**
+ * Check that a fetch returns a block of consecutive readings
+ *
+ * @param handle	The storage plugin handle
+ * @param id		The id of the first reading to fetch
+ * @param blksize	The maximum number of readings to fetch
+ * @param expected	The number of readings expected
+ */
+static bool fetchBlock(PLUGIN_HANDLE handle, unsigned long id, unsigned int blksize, int expected)
+{
+	Document doc;
+	CHECK(fetch(handle, id, blksize, doc));
+	CHECK(doc["count"].GetInt() == expected);
+	const Value& rows = doc["rows"];
+	CHECK(rows.Size() == (unsigned int)expected);
+	for (unsigned int i = 0; i < rows.Size(); i++)
+	{
+		long value = rows[i]["reading"]["value"].GetInt64();
+		CHECK(rows[i]["id"].GetInt64() == (long)(id + i));
+		CHECK(value == (long)(id + i - 1));
+		CHECK(string(rows[i]["asset_code"].GetString()) == "asset_" + to_string(value % 5));
+	}
+	return true;
+}
+
+/**
+ * The readings of several asset tables are merged in id order and the
+ * block size limits the merged result, not the readings of each table.
+ * Tables that only hold older readings are omitted from a fetch and
+ * included again once readings are appended to them.
+ */
+static bool fetchMerge(PLUGIN_HANDLE handle, const string& dataDir)
+{
+	Connection *connection = new Connection();
+
+	// Readings 0 to 99 have the ids 1 to 100
+	CHECK(connection->appendReadings(readingsPayload(0, 100, 5).c_str()) == 100);
+
+	CHECK(fetchBlock(handle, 1, 100, 100));
+	CHECK(fetchBlock(handle, 1, 7, 7));
+	CHECK(fetchBlock(handle, 13, 1, 1));
+	CHECK(fetchBlock(handle, 13, 30, 30));
+	CHECK(fetchBlock(handle, 95, 30, 6));
+	CHECK(fetchBlock(handle, 101, 30, 0));
+
+	// All the tables are now known to hold no readings from 101
+	CHECK(connection->appendReadings(readingsPayload(100, 3, 5).c_str()) == 3);
+	CHECK(fetchBlock(handle, 101, 30, 3));
+	CHECK(fetchBlock(handle, 99, 30, 5));
+	CHECK(connection->appendReadings(readingsPayload(103, 7, 5).c_str()) == 7);
+	CHECK(fetchBlock(handle, 101, 30, 10));
+	CHECK(fetchBlock(handle, 1, 1000, 110));
+
+	delete connection;
+	return true;
+}
+
+TEST(SQLiteReadings, FetchMerge)
+{
+	SKIP_WITHOUT_FLEDGE_ROOT();
+	EXPECT_EXIT({ exit(runWithDatabase(fetchMerge)); }, ::testing::ExitedWithCode(0), "");
+}
+
+/**
+ * Format a time as a reading timestamp
+ */
+static string readingTime(time_t when)
+{
+	struct tm tm;
+	char ts[40];
+	strftime(ts, sizeof(ts), "%Y-%m-%d %H:%M:%S.000000+00:00", gmtime_r(&when, &tm));
+	return ts;
+}
+
+/**
+ * Run a query that returns a single integer against a database file
+ */
+static long queryInt(const string& path, const string& sql)
+{
+	sqlite3 *db;
+	long rval = -1;
+	if (sqlite3_open(path.c_str(), &db) == SQLITE_OK)
+	{
+		sqlite3_stmt *stmt;
+		if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL) == SQLITE_OK)
+		{
+			if (sqlite3_step(stmt) == SQLITE_ROW)
+			{
+				rval = sqlite3_column_int64(stmt, 0);
+			}
+			sqlite3_finalize(stmt);
+		}
+	}
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Create the partition database as left by an earlier run of the plugin,
+ * with a partition of readings from three hours ago and one from thirty
+ * minutes ago. The global id is calculated
+ * from the readings when the plugin starts.
+ */
+static bool seedPartitions(const string& dataDir)
+{
+	time_t now = time(0);
+	time_t starts[] = { now - 3 * 60 * 60, now - 30 * 60 };
+	string padding(1000, 'x');
+
+	stringstream sql;
+	sql << "PRAGMA auto_vacuum = INCREMENTAL;";
+	sql << "CREATE TABLE partitions (id INTEGER PRIMARY KEY, start_ts INTEGER NOT NULL, "
+		"max_id INTEGER, max_user_ts TEXT, rows INTEGER);";
+	for (int p = 0; p < 2; p++)
+	{
+		sql << "CREATE TABLE readings_0_" << p + 1 << " (id INTEGER PRIMARY KEY, "
+			"asset_code CHARACTER varying(50) NOT NULL, reading JSON NOT NULL DEFAULT '{}', "
+			"user_ts DATETIME, ts DATETIME);";
+		sql << "INSERT INTO partitions (id, start_ts) VALUES (" << p + 1 << ", "
+			<< starts[p] - starts[p] % 60 << ");";
+		for (int i = 0; i < 10; i++)
+		{
+			long value = p * 10 + i;
+			sql << "INSERT INTO readings_0_" << p + 1 << " VALUES (" << value + 1
+				<< ", 'asset_" << value % 5 << "', '{\"value\":" << value
+				<< ",\"pad\":\"" << padding << "\"}', '" << readingTime(starts[p] + i)
+				<< "', '" << readingTime(starts[p] + i) << "');";
+		}
+	}
+
+	sqlite3 *db;
+	string path = dataDir + "/readings_0.db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		return false;
+	}
+	bool rval = sqlite3_exec(db, sql.str().c_str(), NULL, NULL, NULL) == SQLITE_OK;
+	sqlite3_close(db);
+	if (!rval)
+	{
+		return false;
+	}
+
+	path = dataDir + "/readings_1.db";
+	if (sqlite3_open(path.c_str(), &db) != SQLITE_OK)
+	{
+		return false;
+	}
+	rval = sqlite3_exec(db, "INSERT INTO configuration_readings VALUES (-1, 0, 15, 3);",
+			NULL, NULL, NULL) == SQLITE_OK;
+	sqlite3_close(db);
+	return rval;
+}
+
+/**
+ * Readings are appended to the time partition of the current interval and
+ * the next partition is created ahead of time. A purge by age drops the
+ * partitions that only hold older readings and returns their space.
+ */
+static bool partitions(PLUGIN_HANDLE handle, const string& dataDir)
+{
+	string partitionDb = dataDir + "/readings_0.db";
+	ReadingsCatalogue *catalogue = ReadingsCatalogue::getInstance();
+
+	// A partition is created for the current interval
+	CHECK(queryInt(partitionDb, "SELECT COUNT(*) FROM partitions;") == 3);
+
+	// Readings 20 to 29 have the ids 21 to 30 and go to the current partition
+	unsigned long generation = catalogue->getGeneration();
+	Connection *connection = new Connection();
+	CHECK(connection->appendReadings(readingsPayload(20, 10, 5, readingTime(time(0)).substr(0, 19)).c_str()) == 10);
+	CHECK(fetchBlock(handle, 1, 100, 30));
+
+	// The next partition is created by the partition thread
+	for (int i = 0; i < 100 && queryInt(partitionDb, "SELECT COUNT(*) FROM partitions;") < 4; i++)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+	}
+	CHECK(queryInt(partitionDb, "SELECT COUNT(*) FROM partitions;") == 4);
+	CHECK(catalogue->getGeneration() > generation);
+
+	// Only the partition from three hours ago is older than an hour
+	long pages = queryInt(partitionDb, "PRAGMA page_count;");
+	char *result = plugin_reading_purge(handle, 1, 0, 0);
+	CHECK(result);
+	Document doc;
+	doc.Parse(result);
+	free(result);
+	CHECK(!doc.HasParseError());
+	CHECK(doc["removed"].GetInt() == 10);
+	CHECK(doc["unsentPurged"].GetInt() == 10);
+	CHECK(doc["readings"].GetInt() == 20);
+	CHECK(string(doc["method"].GetString()) == "age");
+	CHECK(doc["duration"].GetInt64() > 0);
+
+	CHECK(queryInt(partitionDb, "SELECT COUNT(*) FROM sqlite_master WHERE name = 'readings_0_1';") == 0);
+
+	// The space of the dropped partition is reclaimed by the partition thread
+	for (int i = 0; i < 100 && queryInt(partitionDb, "PRAGMA freelist_count;") != 0; i++)
+	{
+		this_thread::sleep_for(chrono::milliseconds(100));
+	}
+	CHECK(queryInt(partitionDb, "PRAGMA freelist_count;") == 0);
+	CHECK(queryInt(partitionDb, "PRAGMA page_count;") < pages);
+	CHECK(fetchBlock(handle, 11, 100, 20));
+
+	delete connection;
+	catalogue->shutdownPartitions();
+	return true;
+}
+
+/**
+ * The partition database is created so that the space of dropped partitions
+ * can be reclaimed incrementally
+ */
+static bool partitionDatabase(PLUGIN_HANDLE handle, const string& dataDir)
+{
+	string partitionDb = dataDir + "/readings_0.db";
+	CHECK(queryInt(partitionDb, "PRAGMA auto_vacuum;") == 2);
+	CHECK(queryInt(partitionDb, "SELECT COUNT(*) FROM partitions;") == 1);
+	ReadingsCatalogue::getInstance()->shutdownPartitions();
+	return true;
+}
+
+TEST(SQLiteReadings, PartitionDatabase)
+{
+	SKIP_WITHOUT_FLEDGE_ROOT();
+	EXPECT_EXIT({ exit(runWithDatabase(partitionDatabase, {{"partitionInterval", "1"}})); },
+			::testing::ExitedWithCode(0), "");
+}
+
+TEST(SQLiteReadings, Partitions)
+{
+	SKIP_WITHOUT_FLEDGE_ROOT();
+	EXPECT_EXIT({ exit(runWithDatabase(partitions, {{"partitionInterval", "1"}}, seedPartitions)); },
+			::testing::ExitedWithCode(0), "");
+}
+
+/**
+ * Run a timebucket query with all the aggregates and return each aggregate
+ * keyed by its bucket, datapoint and aggregate name
+ *
+ * @param connection	The connection to query
+ * @param query		The query
+ * @param aggregates	Populated with the aggregates
+ */
+static bool timebucket(Connection *connection, const string& query, map<string, double>& aggregates)
+{
+	string result;
+	CHECK(connection->retrieveReadings(query, result));
+	Document doc;
+	doc.Parse(result.c_str());
+	CHECK(!doc.HasParseError() && doc.HasMember("rows"));
+	for (auto& row : doc["rows"].GetArray())
+	{
+		Document reading;
+		if (row["reading"].IsString())
+		{
+			reading.Parse(row["reading"].GetString());
+		}
+		else
+		{
+			reading.CopyFrom(row["reading"], reading.GetAllocator());
+		}
+		CHECK(!reading.HasParseError() && reading.IsObject());
+		for (auto& datapoint : reading.GetObject())
+		{
+			for (auto& aggregate : datapoint.value.GetObject())
+			{
+				string key = string(row["timestamp"].GetString()) + "/" +
+					datapoint.name.GetString() + "/" + aggregate.name.GetString();
+				aggregates[key] = aggregate.value.GetDouble();
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Run a timebucket query of the minimum, maximum and average of a datapoint,
+ * as used for the series of an asset, and return each aggregate keyed by its
+ * bucket and aggregate name
+ *
+ * @param connection	The connection to query
+ * @param query		The query
+ * @param aggregates	Populated with the aggregates
+ */
+static bool series(Connection *connection, const string& query, map<string, double>& aggregates)
+{
+	string result;
+	CHECK(connection->retrieveReadings(query, result));
+	Document doc;
+	doc.Parse(result.c_str());
+	CHECK(!doc.HasParseError() && doc.HasMember("rows"));
+	for (auto& row : doc["rows"].GetArray())
+	{
+		for (auto& column : row.GetObject())
+		{
+			if (column.value.IsNumber())
+			{
+				aggregates[string(row["timestamp"].GetString()) + "/" + column.name.GetString()] =
+					column.value.GetDouble();
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Readings written through the reading stream, as JSON and as binary
+ * payloads, are added to the rollups in the transaction that writes them.
+ * A timebucket query answered from the rollups matches the answer of the
+ * same query over the raw readings.
+ */
+static bool streamRollups(PLUGIN_HANDLE handle, const string& dataDir)
+{
+	// The rollups are valid from the time the plugin started, the readings
+	// start on a later minute and span partial and whole buckets. They are
+	// half a second into each second so that none lies on a bucket boundary,
+	// where the julianday rounding of the raw query may place it either side.
+	time_t base = (time(0) / 60 + 2) * 60;
+	const int count = 150;
+	string asset = "stream";
+
+	vector<char *> buffers;
+	ReadingStream *readings[count + 1];
+	for (int i = 0; i < count; i++)
+	{
+		string payload = "{\"value\":" + to_string(i) + ",\"temperature\":" + to_string(i * 0.5) + "}";
+		if (i % 2 == 0)
+		{
+			Document doc;
+			doc.Parse(payload.c_str());
+			string binary;
+			CHECK(ReadingStreamPayload::fromJSON(doc, binary));
+			payload = binary;
+		}
+		else
+		{
+			payload.push_back(0);
+		}
+		char *buffer = new char[sizeof(ReadingStream) + asset.length() + 1 + payload.length()];
+		ReadingStream *reading = (ReadingStream *)buffer;
+		reading->assetCodeLength = asset.length() + 1;
+		reading->payloadLength = payload.length();
+		reading->userTs.tv_sec = base + i;
+		reading->userTs.tv_usec = 500000;
+		memcpy(reading->assetCode, asset.c_str(), asset.length() + 1);
+		memcpy(reading->assetCode + asset.length() + 1, payload.data(), payload.length());
+		readings[i] = reading;
+		buffers.push_back(buffer);
+	}
+	readings[count] = NULL;
+
+	Connection *connection = new Connection();
+	CHECK(connection->readingStream(readings, true) == count);
+	for (auto& buffer : buffers)
+	{
+		delete[] buffer;
+	}
+	CHECK(queryInt(dataDir + "/readings_1.db",
+		"SELECT SUM(readings) FROM rollup_" + to_string(ROLLUP_MINUTE_GRANULE) + " WHERE datapoint = 'value';") == count);
+
+	string query = "{\"where\":{\"column\":\"asset_code\",\"condition\":\"=\",\"value\":\"stream\","
+		"\"and\":{\"column\":\"user_ts\",\"condition\":\">=\",\"value\":\"" + readingTime(base) + "\","
+		"\"and\":{\"column\":\"user_ts\",\"condition\":\"<\",\"value\":\"" + readingTime(base + 180) + "\"}}},"
+		"\"timebucket\":{\"timestamp\":\"user_ts\",\"size\":\"60\"},"
+		"\"aggregate\":{\"operation\":\"all\"}}";
+	map<string, double> rollup, raw;
+	CHECK(timebucket(connection, query, rollup));
+
+	// The series of a datapoint, the first and last buckets are partial
+	string seriesQuery = "{\"aggregate\":["
+		"{\"operation\":\"min\",\"json\":{\"column\":\"reading\",\"properties\":\"temperature\"},\"alias\":\"min\"},"
+		"{\"operation\":\"max\",\"json\":{\"column\":\"reading\",\"properties\":\"temperature\"},\"alias\":\"max\"},"
+		"{\"operation\":\"avg\",\"json\":{\"column\":\"reading\",\"properties\":\"temperature\"},\"alias\":\"average\"}],"
+		"\"where\":{\"column\":\"asset_code\",\"condition\":\"=\",\"value\":\"stream\","
+		"\"and\":{\"column\":\"user_ts\",\"condition\":\">=\",\"value\":\"" + readingTime(base + 10).substr(0, 19) + "\","
+		"\"and\":{\"column\":\"user_ts\",\"condition\":\"<=\",\"value\":\"" + readingTime(base + 170).substr(0, 19) + "\"}}},"
+		"\"timebucket\":{\"timestamp\":\"user_ts\",\"size\":\"60\",\"format\":\"YYYY-MM-DD HH24:MI:SS\",\"alias\":\"timestamp\"},"
+		"\"limit\":3}";
+	map<string, double> rollupSeries, rawSeries, alteredSeries;
+	CHECK(series(connection, seriesQuery, rollupSeries));
+
+	// Only the whole bucket is taken from the rollups
+	CHECK(queryInt(dataDir + "/readings_1.db",
+		"SELECT COUNT(*) FROM rollup_" + to_string(ROLLUP_MINUTE_GRANULE) + " WHERE datapoint = 'temperature';") > 0);
+	char *errmsg = NULL;
+	CHECK(sqlite3_exec(connection->getDbHandle(), ("UPDATE readings_1.rollup_" + to_string(ROLLUP_MINUTE_GRANULE) +
+		" SET maximum = maximum + 1000 WHERE datapoint = 'temperature';").c_str(), NULL, NULL, &errmsg) == SQLITE_OK);
+	CHECK(series(connection, seriesQuery, alteredSeries));
+
+	// Disabling the rollups answers the same queries from the raw readings
+	CHECK(ReadingsRollup::getInstance()->init(connection->getDbHandle(), false));
+	CHECK(timebucket(connection, query, raw));
+	CHECK(series(connection, seriesQuery, rawSeries));
+
+	CHECK(rollup.size() == raw.size());
+	CHECK(rollup.size() == 3 * 2 * 5);
+	for (auto& aggregate : raw)
+	{
+		CHECK(rollup.count(aggregate.first) == 1);
+		CHECK(fabs(rollup[aggregate.first] - aggregate.second) < 1e-9);
+	}
+
+	CHECK(rollupSeries.size() == rawSeries.size());
+	CHECK(rollupSeries.size() == 3 * 3);
+	for (auto& aggregate : rawSeries)
+	{
+		CHECK(rollupSeries.count(aggregate.first) == 1);
+		CHECK(fabs(rollupSeries[aggregate.first] - aggregate.second) < 1e-9);
+	}
+	int altered = 0;
+	for (auto& aggregate : alteredSeries)
+	{
+		if (fabs(aggregate.second - rollupSeries[aggregate.first]) > 1e-9)
+		{
+			CHECK(aggregate.first.compare(readingTime(base + 60).substr(0, 19) + "/max") == 0);
+			CHECK(fabs(aggregate.second - rollupSeries[aggregate.first] - 1000) < 1e-9);
+			altered++;
+		}
+	}
+	CHECK(altered == 1);
+
+	delete connection;
+	return true;
+}
+
+TEST(SQLiteReadings, StreamRollups)
+{
+	SKIP_WITHOUT_FLEDGE_ROOT();
+	EXPECT_EXIT({ exit(runWithDatabase(streamRollups, {{"rollups", "true"}, {"readingFormat", "Binary"}})); },
+			::testing::ExitedWithCode(0), "");
+}
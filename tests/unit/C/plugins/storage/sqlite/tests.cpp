@@ -4,6 +4,7 @@
 #include <string.h>
 #include <string>
 #include <readings_catalogue.h>
+#include <readings_rollup.h>
 
 using namespace std;
 
@@ -116,3 +117,38 @@ INSTANTIATE_TEST_CASE_P(
 		RowFormatDate("2019-50-50 10:01:01.0",  "", false)
 	)
 );
+
+TEST(ReadingsRollup, parseTimestamp) {
+
+	time_t seconds;
+	bool fraction;
+
+	ASSERT_TRUE(ReadingsRollup::parseTimestamp("2023-01-01 00:00:30", seconds, fraction));
+	ASSERT_EQ(seconds, 1672531230);
+	ASSERT_FALSE(fraction);
+
+	ASSERT_TRUE(ReadingsRollup::parseTimestamp("2023-01-01 00:00:30.000000+00:00", seconds, fraction));
+	ASSERT_EQ(seconds, 1672531230);
+	ASSERT_FALSE(fraction);
+
+	ASSERT_TRUE(ReadingsRollup::parseTimestamp("2023-01-01 00:00:30.000370+00:00", seconds, fraction));
+	ASSERT_EQ(seconds, 1672531230);
+	ASSERT_TRUE(fraction);
+
+	ASSERT_TRUE(ReadingsRollup::parseTimestamp("2023-01-01T01:00:30.5+01:00", seconds, fraction));
+	ASSERT_EQ(seconds, 1672531230);
+
+	ASSERT_FALSE(ReadingsRollup::parseTimestamp("2023-01-01", seconds, fraction));
+	ASSERT_FALSE(ReadingsRollup::parseTimestamp("2023-01-01 00:00:30 junk", seconds, fraction));
+}
+
+TEST(ReadingsRollup, granule) {
+
+	ASSERT_EQ(ReadingsRollup::granule(1), 0);
+	ASSERT_EQ(ReadingsRollup::granule(90), 0);
+	ASSERT_EQ(ReadingsRollup::granule(60.5), 0);
+	ASSERT_EQ(ReadingsRollup::granule(60), ROLLUP_MINUTE_GRANULE);
+	ASSERT_EQ(ReadingsRollup::granule(300), ROLLUP_MINUTE_GRANULE);
+	ASSERT_EQ(ReadingsRollup::granule(3600), ROLLUP_HOUR_GRANULE);
+	ASSERT_EQ(ReadingsRollup::granule(86400), ROLLUP_HOUR_GRANULE);
+}
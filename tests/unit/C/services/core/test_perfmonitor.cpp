@@ -0,0 +1,133 @@
+/*
+ * unit tests - Fledge performance monitor histograms
+ *
+ * Copyright (c) 2026 Dianomic Systems, Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+#include <gtest/gtest.h>
+#include <perfmonitors.h>
+#include <rapidjson/document.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace rapidjson;
+
+/**
+ * Return the values of a performance monitor as a JSON document
+ */
+static void monitorValues(PerfMon& mon, Document& doc)
+{
+	InsertValues values;
+	mon.getValues(values);
+	doc.Parse(values.toJSON().c_str());
+}
+
+TEST(PerfMonitorTest, BucketsExact)
+{
+	for (long value = 0; value < PERFMON_SUB_BUCKETS; value++)
+	{
+		ASSERT_EQ(PerfHistogram::bucketValue(PerfHistogram::bucket(value)), value);
+	}
+	ASSERT_EQ(PerfHistogram::bucket(-10), 0);
+}
+
+TEST(PerfMonitorTest, BucketsRelativeError)
+{
+	unsigned int last = 0;
+	for (long value = PERFMON_SUB_BUCKETS; value < 10000000; value += value / 100 + 1)
+	{
+		unsigned int bucket = PerfHistogram::bucket(value);
+		long upper = PerfHistogram::bucketValue(bucket);
+		ASSERT_GE(bucket, last);
+		ASSERT_GE(upper, value);
+		ASSERT_LE(upper - value, value / PERFMON_SUB_BUCKETS);
+		last = bucket;
+	}
+	ASSERT_EQ(PerfHistogram::bucket(LONG_MAX), PERFMON_BUCKETS - 1);
+}
+
+TEST(PerfMonitorTest, Percentiles)
+{
+	PerfMon mon("test");
+	for (long value = 1000; value >= 1; value--)
+		mon.addValue(value);
+	Document doc;
+	monitorValues(mon, doc);
+	ASSERT_FALSE(doc.HasParseError());
+	ASSERT_EQ(doc["samples"].GetInt(), 1000);
+	ASSERT_EQ(doc["minimum"].GetInt(), 1);
+	ASSERT_EQ(doc["maximum"].GetInt(), 1000);
+	ASSERT_EQ(doc["average"].GetInt(), 501);
+	ASSERT_NEAR(doc["p50"].GetInt(), 500, 500 / PERFMON_SUB_BUCKETS);
+	ASSERT_NEAR(doc["p90"].GetInt(), 900, 900 / PERFMON_SUB_BUCKETS);
+	ASSERT_NEAR(doc["p99"].GetInt(), 990, 990 / PERFMON_SUB_BUCKETS);
+	ASSERT_NEAR(doc["p999"].GetInt(), 999, 999 / PERFMON_SUB_BUCKETS);
+}
+
+TEST(PerfMonitorTest, Tail)
+{
+	PerfMon mon("test");
+	for (int i = 0; i < 990; i++)
+		mon.addValue(10);
+	for (int i = 0; i < 10; i++)
+		mon.addValue(5000);
+	Document doc;
+	monitorValues(mon, doc);
+	ASSERT_EQ(doc["p50"].GetInt(), 10);
+	ASSERT_EQ(doc["p99"].GetInt(), 10);
+	ASSERT_EQ(doc["p999"].GetInt(), 5000);
+	ASSERT_EQ(doc["maximum"].GetInt(), 5000);
+}
+
+TEST(PerfMonitorTest, Reset)
+{
+	PerfMon mon("test");
+	mon.addValue(42);
+	InsertValues values;
+	ASSERT_EQ(mon.getValues(values), 1);
+	InsertValues empty;
+	ASSERT_EQ(mon.getValues(empty), 0);
+	ASSERT_EQ(empty.size(), 0);
+	mon.addValue(7);
+	Document doc;
+	monitorValues(mon, doc);
+	ASSERT_EQ(doc["samples"].GetInt(), 1);
+	ASSERT_EQ(doc["minimum"].GetInt(), 7);
+	ASSERT_EQ(doc["maximum"].GetInt(), 7);
+}
+
+TEST(PerfMonitorTest, Threads)
+{
+	PerfMon mon("test");
+	vector<thread> threads;
+	for (int t = 0; t < 4; t++)
+	{
+		threads.emplace_back([&mon, t]() {
+			for (int i = 0; i < 1000; i++)
+				mon.addValue(t * 1000 + i);
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	Document doc;
+	monitorValues(mon, doc);
+	ASSERT_EQ(doc["samples"].GetInt(), 4000);
+	ASSERT_EQ(doc["minimum"].GetInt(), 0);
+	ASSERT_EQ(doc["maximum"].GetInt(), 3999);
+}
+
+TEST(PerfMonitorTest, Handles)
+{
+	PerformanceMonitor monitors("test", NULL);
+	PerfMon *mon = monitors.getMonitor("latency");
+	ASSERT_EQ(monitors.getMonitor("latency"), mon);
+	ASSERT_NE(monitors.getMonitor("other"), mon);
+	monitors.collect(mon, 10);	// Not collecting
+	InsertValues values;
+	ASSERT_EQ(mon->getValues(values), 0);
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <pipeline_blocks.h>
+#include <functional>
+#include <vector>
+
+/*
+ * Fledge north service filter pipeline block accounting tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+using namespace std;
+
+#define DEPTH	3
+
+/**
+ * Pass a block through a filter pipeline as the data loader does. The
+ * filter is given a function that queues a block that comes out of
+ * the pipeline, as the pipeline end callback of the loader does.
+ */
+static void ingest(PipelineBlocks& blocks, vector<unsigned long>& queue,
+		unsigned long lastFetched,
+		function<void (function<void (unsigned long)>)> filter)
+{
+	blocks.ingest(lastFetched);
+	filter([&blocks, &queue](unsigned long lastId) {
+			queue.push_back(blocks.outputLastId(lastId, true));
+		});
+	blocks.ingested();
+}
+
+TEST(PipelineBlocks, PassThrough)
+{
+	PipelineBlocks blocks;
+	vector<unsigned long> queue;
+
+	for (unsigned long i = 1; i <= DEPTH; i++)
+	{
+		ASSERT_TRUE(blocks.readAhead(queue.size(), DEPTH));
+		ingest(blocks, queue, i * 100, [i](function<void (unsigned long)> output) {
+				output(i * 100);
+			});
+	}
+	ASSERT_EQ(queue.size(), DEPTH);
+	ASSERT_EQ(blocks.inFlight(), 0);
+	ASSERT_FALSE(blocks.readAhead(queue.size(), DEPTH));
+}
+
+TEST(PipelineBlocks, AbsorbingFilter)
+{
+	PipelineBlocks blocks;
+	vector<unsigned long> queue;
+
+	// Nothing comes out of the pipeline, the read ahead is not reduced
+	for (unsigned long i = 1; i <= 2 * DEPTH; i++)
+	{
+		ingest(blocks, queue, i * 100, [](function<void (unsigned long)>) {});
+		ASSERT_EQ(blocks.inFlight(), 0);
+		ASSERT_TRUE(blocks.readAhead(queue.size(), DEPTH));
+	}
+	ASSERT_TRUE(queue.empty());
+
+	// A block held back is passed on later with the id of its readings
+	blocks.ingest(700);
+	blocks.ingested();
+	queue.push_back(blocks.outputLastId(650, false));
+	ASSERT_EQ(queue.back(), 650);
+	ASSERT_TRUE(blocks.readAhead(queue.size(), DEPTH));
+}
+
+TEST(PipelineBlocks, SplittingFilter)
+{
+	PipelineBlocks blocks;
+	vector<unsigned long> queue;
+
+	// Each block comes out of the pipeline as two blocks, the block in
+	// the ingest call counts towards the depth until the call returns
+	ingest(blocks, queue, 100, [&blocks, &queue](function<void (unsigned long)> output) {
+			output(50);
+			ASSERT_EQ(blocks.inFlight(), 1);
+			ASSERT_FALSE(blocks.readAhead(queue.size() + 1, DEPTH));
+			output(100);
+		});
+	ASSERT_EQ(blocks.inFlight(), 0);
+	ASSERT_EQ(queue.size(), 2);
+	ASSERT_TRUE(blocks.readAhead(queue.size(), DEPTH));
+
+	// Once the queue is drained the read ahead is back to the full depth
+	queue.clear();
+	for (unsigned long i = 0; i < DEPTH; i++)
+	{
+		ASSERT_TRUE(blocks.readAhead(i, DEPTH));
+	}
+	ASSERT_FALSE(blocks.readAhead(DEPTH, DEPTH));
+}
+
+TEST(PipelineBlocks, FilteredOut)
+{
+	PipelineBlocks blocks;
+	vector<unsigned long> queue;
+
+	// A block with no readings left takes the last id fetched for the
+	// block if it comes out of the ingest call
+	ingest(blocks, queue, 300, [](function<void (unsigned long)> output) {
+			output(0);
+		});
+	ASSERT_EQ(queue.back(), 300);
+
+	// but not if it comes out on another thread or after the call
+	blocks.ingest(400);
+	ASSERT_EQ(blocks.outputLastId(0, false), 0);
+	blocks.ingested();
+	ASSERT_EQ(blocks.outputLastId(0, true), 0);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <sent_blocks.h>
+
+/*
+ * Fledge north service sent block tracking tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+using namespace std;
+
+TEST(SentBlocks, InOrder)
+{
+	SentBlocks blocks;
+	uint32_t sent;
+
+	unsigned long b1 = blocks.issue();
+	unsigned long b2 = blocks.issue();
+	ASSERT_EQ(blocks.outstanding(), 2);
+	ASSERT_FALSE(blocks.pending());
+
+	blocks.progress(b1, 100, 100, true);
+	ASSERT_TRUE(blocks.pending());
+	ASSERT_EQ(blocks.collect(sent), 100);
+	ASSERT_EQ(sent, 100);
+	ASSERT_EQ(blocks.outstanding(), 1);
+	ASSERT_FALSE(blocks.pending());
+
+	blocks.progress(b2, 200, 100, true);
+	ASSERT_EQ(blocks.collect(sent), 200);
+	ASSERT_EQ(sent, 100);
+	ASSERT_EQ(blocks.outstanding(), 0);
+	ASSERT_FALSE(blocks.pending());
+}
+
+TEST(SentBlocks, Partial)
+{
+	SentBlocks blocks;
+	uint32_t sent;
+
+	unsigned long b1 = blocks.issue();
+	unsigned long b2 = blocks.issue();
+	blocks.progress(b2, 200, 100, true);
+
+	// Part of the first block is sent, the last sent id moves to the
+	// last reading sent but not past the end of the first block
+	blocks.progress(b1, 40, 40, false);
+	ASSERT_EQ(blocks.collect(sent), 40);
+	ASSERT_EQ(sent, 140);
+	ASSERT_FALSE(blocks.pending());
+	ASSERT_EQ(blocks.outstanding(), 2);
+
+	blocks.progress(b1, 100, 60, true);
+	ASSERT_EQ(blocks.collect(sent), 200);
+	ASSERT_EQ(sent, 60);
+	ASSERT_EQ(blocks.outstanding(), 0);
+}
+
+TEST(SentBlocks, FilteredOut)
+{
+	SentBlocks blocks;
+	uint32_t sent;
+
+	unsigned long b1 = blocks.issue();
+	unsigned long b2 = blocks.issue();
+	unsigned long b3 = blocks.issue();
+
+	// A block removed by the filters moves the last sent id with no
+	// readings sent, a block with no known id only releases the blocks
+	// after it
+	blocks.progress(b1, 100, 0, true);
+	blocks.progress(b2, 0, 0, true);
+	blocks.progress(b3, 300, 50, true);
+	ASSERT_EQ(blocks.collect(sent), 300);
+	ASSERT_EQ(sent, 50);
+	ASSERT_EQ(blocks.outstanding(), 0);
+}
+
+TEST(SentBlocks, NeverMovesBack)
+{
+	SentBlocks blocks;
+	uint32_t sent;
+
+	unsigned long b1 = blocks.issue();
+	blocks.progress(b1, 100, 100, true);
+	ASSERT_EQ(blocks.collect(sent), 100);
+
+	// A later block with lower ids, as can come out of the filters,
+	// does not move the last sent id back
+	unsigned long b2 = blocks.issue();
+	blocks.progress(b2, 50, 10, true);
+	ASSERT_EQ(blocks.collect(sent), 0);
+	ASSERT_EQ(sent, 10);
+	ASSERT_EQ(blocks.outstanding(), 0);
+}
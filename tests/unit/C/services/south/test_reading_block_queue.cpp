@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include <reading_block_queue.h>
+#include <thread>
+#include <vector>
+
+/*
+ * Fledge south service reading queue tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+using namespace std;
+
+#define PRODUCERS	4
+#define PER_PRODUCER	5000
+
+/**
+ * Create a reading with a value that identifies it
+ */
+static Reading *makeReading(long producer, long value)
+{
+	DatapointValue p(producer), v(value);
+	vector<Datapoint *> values;
+	values.push_back(new Datapoint("producer", p));
+	values.push_back(new Datapoint("value", v));
+	return new Reading("test", values);
+}
+
+static long valueOf(Reading *reading, const string& name)
+{
+	return reading->getDatapoint(name)->getData().toInt();
+}
+
+static void deleteAll(vector<Reading *> *block)
+{
+	for (auto& reading : *block)
+		delete reading;
+	delete block;
+}
+
+TEST(ReadingBlockQueue, Empty)
+{
+	ReadingBlockQueue queue;
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.size(), 0);
+	ASSERT_EQ(queue.oldest(), (Reading *)NULL);
+	ASSERT_EQ(queue.take(10), (vector<Reading *> *)NULL);
+}
+
+TEST(ReadingBlockQueue, SingleThreadFIFO)
+{
+	ReadingBlockQueue queue;
+	long next = 0;
+	// Mix single readings and blocks, more than the node pool holds
+	for (int i = 0; i < 1500; i++)
+	{
+		if (i % 3 == 0)
+		{
+			vector<Reading *> *block = new vector<Reading *>;
+			for (int j = 0; j < 4; j++)
+				block->push_back(makeReading(0, next++));
+			queue.push(block);
+		}
+		else
+		{
+			queue.push(makeReading(0, next++));
+		}
+	}
+	ASSERT_EQ(queue.size(), next);
+	ASSERT_EQ(queue.blocks(), 1500);
+	ASSERT_EQ(valueOf(queue.oldest(), "value"), 0);
+
+	long expected = 0;
+	vector<Reading *> *data;
+	while ((data = queue.take(7)) != NULL)
+	{
+		ASSERT_GE(data->size(), 1);
+		for (auto& reading : *data)
+			ASSERT_EQ(valueOf(reading, "value"), expected++);
+		deleteAll(data);
+	}
+	ASSERT_EQ(expected, next);
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.size(), 0);
+	ASSERT_EQ(queue.blocks(), 0);
+}
+
+TEST(ReadingBlockQueue, BlockNotCopied)
+{
+	ReadingBlockQueue queue;
+	vector<Reading *> *block = new vector<Reading *>;
+	for (int i = 0; i < 10; i++)
+		block->push_back(makeReading(0, i));
+	queue.push(block);
+	queue.push(makeReading(0, 10));
+
+	// A block large enough for the request is returned as is
+	vector<Reading *> *data = queue.take(5);
+	ASSERT_EQ(data, block);
+	ASSERT_EQ(queue.size(), 1);
+	deleteAll(data);
+}
+
+TEST(ReadingBlockQueue, MultipleProducers)
+{
+	ReadingBlockQueue queue;
+	vector<thread> producers;
+	for (long p = 0; p < PRODUCERS; p++)
+	{
+		producers.push_back(thread([&queue, p]() {
+			for (long i = 0; i < PER_PRODUCER; )
+			{
+				if (i % 10 == 0)
+				{
+					vector<Reading *> *block = new vector<Reading *>;
+					for (int j = 0; j < 5; j++)
+						block->push_back(makeReading(p, i++));
+					queue.push(block);
+				}
+				else
+				{
+					queue.push(makeReading(p, i++));
+				}
+			}
+		}));
+	}
+
+	// Consume while the producers are running, the readings of each
+	// producer must arrive in the order that producer pushed them
+	vector<long> next(PRODUCERS, 0);
+	long total = 0;
+	while (total < PRODUCERS * PER_PRODUCER)
+	{
+		vector<Reading *> *data = queue.take(100);
+		if (!data)
+		{
+			this_thread::yield();
+			continue;
+		}
+		for (auto& reading : *data)
+		{
+			long producer = valueOf(reading, "producer");
+			EXPECT_EQ(valueOf(reading, "value"), next[producer]++);
+		}
+		total += data->size();
+		deleteAll(data);
+	}
+	for (auto& producer : producers)
+		producer.join();
+
+	ASSERT_EQ(total, PRODUCERS * PER_PRODUCER);
+	for (long p = 0; p < PRODUCERS; p++)
+		ASSERT_EQ(next[p], PER_PRODUCER);
+	ASSERT_TRUE(queue.empty());
+	ASSERT_EQ(queue.size(), 0);
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env bash
+
+#
+# Tests of the wait parameter of the readings fetch. These need a reading
+# to be appended while a fetch is waiting, so they can not be run from the
+# testset. The storage service must already be running.
+#
+# Failures are added to the file failed in the format of testRunner.sh
+#
+url=http://localhost:8080/storage/reading
+
+# Time in milliseconds since the epoch
+now_ms () {
+	echo $(( $(date +%s%N) / 1000000 ))
+}
+
+# Number of rows in a fetch result
+row_count () {
+	python3 -c 'import json,sys; print(len(json.load(sys.stdin)["rows"]))'
+}
+
+fail () {
+	echo Failed
+	echo Test Fetch Readings wait "$1" >> failed
+	echo "   " "$2" >> failed
+	echo >> failed
+	status=1
+}
+
+status=0
+
+# The id after the last reading in the storage
+next_id=$(curl -s "$url?id=1&count=1000000" | \
+	python3 -c 'import json,sys; r=json.load(sys.stdin)["rows"]; print(r[-1]["id"] + 1 if r else 1)')
+
+echo -n "Test Fetch Readings wait timeout: "
+start=$(now_ms)
+rows=$(curl -s "$url?id=$next_id&count=10&wait=500" | row_count)
+elapsed=$(( $(now_ms) - start ))
+if [ "$rows" != "0" ]; then
+	fail timeout "Expected no readings, got $rows"
+elif [ $elapsed -lt 500 ]; then
+	fail timeout "Returned after $elapsed ms, expected to wait 500 ms"
+else
+	echo Passed
+fi
+
+echo -n "Test Fetch Readings wait append: "
+start=$(now_ms)
+( sleep 1; curl -s -X POST $url -d@payloads/asset.json > /dev/null ) &
+rows=$(curl -s "$url?id=$next_id&count=10&wait=5000" | row_count)
+elapsed=$(( $(now_ms) - start ))
+wait
+if [ "$rows" = "0" -o "$rows" = "" ]; then
+	fail append "Expected the appended readings, got none"
+elif [ $elapsed -ge 4000 ]; then
+	fail append "Returned after $elapsed ms, expected to return once the readings were appended"
+else
+	echo Passed
+fi
+
+exit $status
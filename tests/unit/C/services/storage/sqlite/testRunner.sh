@@ -156,6 +156,7 @@ echo $n_failed Tests Failed 		>  tests.result
 echo $n_passed Tests Passed 		>> tests.result
 echo $n_unchecked Tests Unchecked	>> tests.result
 done
+./testFetchWait.sh
 ./testCleanup.sh > /dev/null
 cat tests.result
 rm -f tests.result
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <storage_api.h>
+#include <stream_handler.h>
+#include <reading_stream.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * Fledge storage service stream handler tests
+ *
+ * Copyright (c) 2026 Dianomic Systems Inc.
+ *
+ * Released under the Apache 2.0 Licence
+ *
+ * Author: Mark Riddoch
+ */
+
+using namespace std;
+
+#define STREAM_READINGS		(RDS_BLOCK * 12)	// Readings sent in the test block
+#define STREAM_PAYLOAD		400			// Bytes of padding in each reading payload
+
+/*
+ * The storage API entry point called by the stream handler writers. The
+ * writes are held back until the test opens the gate, so that the batches
+ * of the stream back up.
+ */
+static mutex			writeMutex;
+static condition_variable	writeCV;
+static bool			gateOpen;
+static int			writeCalls;
+static long			readingsWritten;
+static bool			committed;
+
+bool StorageApi::readingStream(ReadingStream **readings, bool commit)
+{
+	unique_lock<mutex> lock(writeMutex);
+	writeCalls++;
+	writeCV.notify_all();
+	writeCV.wait(lock, [] { return gateOpen; });
+	for (int i = 0; readings[i]; i++)
+		readingsWritten++;
+	if (commit)
+		committed = true;
+	writeCV.notify_all();
+	return true;
+}
+
+/**
+ * Build the bytes a client sends for the connection and a single block
+ * of readings, all of the same asset
+ *
+ * @param token	The stream connection token
+ */
+static string streamData(uint32_t token)
+{
+	string data;
+	RDSConnectHeader conn = { RDS_CONNECTION_MAGIC, token };
+	data.append((char *)&conn, sizeof(conn));
+	RDSBlockHeader block = { RDS_BLOCK_MAGIC, 0, STREAM_READINGS };
+	data.append((char *)&block, sizeof(block));
+
+	string asset = "stream";
+	string padding(STREAM_PAYLOAD, 'x');
+	for (uint32_t i = 0; i < STREAM_READINGS; i++)
+	{
+		string payload = "{\"value\":" + to_string(i) + ",\"pad\":\"" + padding + "\"}";
+		RDSReadingHeader hdr = { RDS_READING_MAGIC, i,
+			i == 0 ? (uint32_t)asset.length() + 1 : 0, (uint32_t)payload.length() + 1 };
+		data.append((char *)&hdr, sizeof(hdr));
+		struct timeval tv = { 1672531200, (suseconds_t)(i % 1000000) };
+		data.append((char *)&tv, sizeof(tv));
+		if (i == 0)
+			data.append(asset.c_str(), asset.length() + 1);
+		data.append(payload.c_str(), payload.length() + 1);
+	}
+	return data;
+}
+
+/**
+ * A client that sends more readings than the writers can hold is held
+ * back while the writers are blocked and completes once they resume.
+ */
+TEST(StreamHandler, BackpressureAndResume)
+{
+	{
+		lock_guard<mutex> guard(writeMutex);
+		gateOpen = false;
+		writeCalls = 0;
+		readingsWritten = 0;
+		committed = false;
+	}
+
+	// The test entry point above does not use the storage API object
+	static char api[sizeof(StorageApi)];
+	StreamHandler *handler = new StreamHandler((StorageApi *)api, 1);
+	uint32_t token;
+	uint32_t port = handler->createStream(&token);
+	ASSERT_NE(port, 0);
+
+	int sock = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	ASSERT_EQ(connect(sock, (struct sockaddr *)&addr, sizeof(addr)), 0);
+
+	string data = streamData(token);
+	atomic<bool> sent(false);
+	size_t offset = 0;
+	thread sender([&]() {
+		while (offset < data.length())
+		{
+			ssize_t n = send(sock, data.data() + offset, data.length() - offset, 0);
+			if (n <= 0)
+				break;
+			offset += n;
+		}
+		sent = true;
+	});
+
+	// The first batch is held by the writer, further batches back up until
+	// the stream stops reading and the TCP window holds back the client
+	{
+		unique_lock<mutex> lock(writeMutex);
+		EXPECT_TRUE(writeCV.wait_for(lock, chrono::seconds(10), [] { return writeCalls > 0; }));
+	}
+	this_thread::sleep_for(chrono::seconds(1));
+	EXPECT_FALSE(sent);
+	{
+		lock_guard<mutex> guard(writeMutex);
+		EXPECT_EQ(writeCalls, 1);
+		EXPECT_EQ(readingsWritten, 0);
+	}
+
+	// Once the writers catch up the stream is resumed and the rest of
+	// the block is read and written
+	{
+		lock_guard<mutex> guard(writeMutex);
+		gateOpen = true;
+	}
+	writeCV.notify_all();
+	bool complete;
+	{
+		unique_lock<mutex> lock(writeMutex);
+		complete = writeCV.wait_for(lock, chrono::seconds(30),
+					[] { return committed && readingsWritten == STREAM_READINGS; });
+		EXPECT_EQ(readingsWritten, STREAM_READINGS);
+	}
+	EXPECT_TRUE(complete);
+	if (!complete)
+		shutdown(sock, SHUT_RDWR);
+	sender.join();
+	EXPECT_EQ(offset, data.length());
+
+	close(sock);
+	delete handler;
+}